@@ -68,19 +68,91 @@ EXTERN_C NTSTATUS KmsrDeviceIoControl(
 				break;
 			}
 
-			// 3.1.3 Call the assembly routine to get the data
+			// 3.1.3 Call the assembly routine to get the data, a MSR the processor does not implement raises #GP
 			KdPrint(("[K_MSR] _rdmsr\n"));
-			_rdmsr(pTargetMsr, (PRDMSR_OUT)Irp->AssociatedIrp.SystemBuffer);
+			__try {
+				_rdmsr(pTargetMsr, (PRDMSR_OUT)Irp->AssociatedIrp.SystemBuffer);
+			}
+			__except (EXCEPTION_EXECUTE_HANDLER) {
+				Status = STATUS_INVALID_PARAMETER;
+				break;
+			}
 
 			// 3.1.4 Update size of data to return and exit
 			Irp->IoStatus.Information = sizeof(RDMSR_OUT);
 			break;
 		}
-		
-		// 3.3 An invalid or at least an unknown IOCTL has been provided 
-		default: {
-			KdPrint(("[K_MSR] Invalid value has been provided\n"));
-			Status = STATUS_INVALID_DEVICE_REQUEST;
+
+		// 3.2 Will handle the IOCTL_KMSR_WRITE IOCTL
+		case IOCTL_KMSR_WRITE: {
+			// 3.2.1 Ensure that the input buffer is large enough
+			if (Stack->Parameters.DeviceIoControl.InputBufferLength < sizeof(WRMSR_IN)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 3.2.2 Check the data provided, only a few MSRs can be written
+			PWRMSR_IN pDataIn = (PWRMSR_IN)Irp->AssociatedIrp.SystemBuffer;
+			if (pDataIn == NULL) {
+				Status = STATUS_INVALID_DEVICE_REQUEST;
+				break;
+			}
+			if (!KmsrIsWritable(pDataIn->Msr)) {
+				KdPrint(("[K_MSR] MSR 0x%08x cannot be written\n", pDataIn->Msr));
+				Status = STATUS_ACCESS_DENIED;
+				break;
+			}
+
+			// 3.2.3 Write the data. The allow-list covers whole ranges and the value is not checked, so a
+			// reserved bit, a non-contiguous CAT mask or an unimplemented COS raises #GP.
+			KdPrint(("[K_MSR] _wrmsr\n"));
+			__try {
+				_wrmsr(pDataIn);
+			}
+			__except (EXCEPTION_EXECUTE_HANDLER) {
+				Status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+			Irp->IoStatus.Information = 0x00;
+			break;
+		}
+		
+		// 3.3 Will handle the IOCTL_KMSR_READ_BATCH IOCTL
+		case IOCTL_KMSR_READ_BATCH: {
+			// 3.3.1 One address in, one value out, for at most KMSR_BATCH_MAX MSRs
+			ULONG Count = Stack->Parameters.DeviceIoControl.InputBufferLength / sizeof(RDMSR_IN);
+			if (Count == 0x00 || Count > KMSR_BATCH_MAX
+				|| Stack->Parameters.DeviceIoControl.OutputBufferLength < Count * sizeof(RDMSR_OUT)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+			if (Irp->AssociatedIrp.SystemBuffer == NULL) {
+				Status = STATUS_INVALID_DEVICE_REQUEST;
+				break;
+			}
+
+			// 3.3.2 The values overwrite the addresses in the system buffer, hence the copy
+			RDMSR_IN Msrs[KMSR_BATCH_MAX] = { 0x00 };
+			RtlCopyMemory(Msrs, Irp->AssociatedIrp.SystemBuffer, Count * sizeof(RDMSR_IN));
+			PRDMSR_OUT pDataOut = (PRDMSR_OUT)Irp->AssociatedIrp.SystemBuffer;
+
+			// 3.3.3 Read every MSR without leaving the processor
+			__try {
+				for (ULONG Index = 0x00; Index < Count; Index++)
+					_rdmsr(&Msrs[Index], &pDataOut[Index]);
+			}
+			__except (EXCEPTION_EXECUTE_HANDLER) {
+				Status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+			Irp->IoStatus.Information = Count * sizeof(RDMSR_OUT);
+			break;
+		}
+
+		// 3.4 An invalid or at least an unknown IOCTL has been provided 
+		default: {
+			KdPrint(("[K_MSR] Invalid value has been provided\n"));
+			Status = STATUS_INVALID_DEVICE_REQUEST;
 			break;
 		}
 	}
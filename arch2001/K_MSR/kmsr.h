@@ -17,7 +17,23 @@
 #define KMSR_DEVICE_PATH_USERMODE L"\\??\\KMsr"
 
 /// List of IOCTL exposed by this driver
-#define IOCTL_KMSR_READ CTL_CODE(KMSR_DEVICE_TYPE, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KMSR_READ       CTL_CODE(KMSR_DEVICE_TYPE, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KMSR_WRITE      CTL_CODE(KMSR_DEVICE_TYPE, 0x801, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_KMSR_READ_BATCH CTL_CODE(KMSR_DEVICE_TYPE, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/// Largest number of MSRs read by IOCTL_KMSR_READ_BATCH
+#define KMSR_BATCH_MAX 64
+
+/// MSRs that IOCTL_KMSR_WRITE accepts. Writing an arbitrary MSR from user mode is a privilege escalation.
+#define IA32_QM_EVTSEL           0x00000C8D
+#define IA32_PQR_ASSOC           0x00000C8F
+#define IA32_L3_MASK_0           0x00000C90 // Up to 128 classes of service.
+#define IA32_L2_MASK_0           0x00000D10 // Up to 64 classes of service.
+#define IA32_MBA_THRTL_0         0x00000D50 // Up to 64 classes of service.
+#define MSR_MISC_FEATURE_CONTROL 0x000001A4 // Intel hardware prefetchers.
+#define MSR_AMD_PREFETCH_CONTROL 0xC0000108 // AMD hardware prefetchers.
+#define IA32_PERF_CTL            0x00000199 // Legacy P-state request.
+#define IA32_HWP_REQUEST         0x00000774 // HWP request, IA32_PM_ENABLE is deliberately left out.
 
 typedef UINT32 RDMSR_IN;
 typedef PUINT32 PRDMSR_IN;
@@ -27,6 +43,12 @@ typedef struct _RDMSR_OUT {
 	UINT32 EDX;
 } RDMSR_OUT, * PRDMSR_OUT;
 
+typedef struct _WRMSR_IN {
+	UINT32 Msr;
+	UINT32 EAX;
+	UINT32 EDX;
+} WRMSR_IN, * PWRMSR_IN;
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 EXTERN_C NTSTATUS KmsrClose(
 	_In_ PDEVICE_OBJECT DeviceObject,
@@ -45,11 +67,66 @@ EXTERN_C NTSTATUS KmsrDeviceIoControl(
 	_In_ PIRP           Irp
 );
 
+#if defined(KMSR_USE_MASM)
 EXTERN_C VOID _rdmsr(
 	_In_ PRDMSR_IN  pDataIn,
 	_In_ PRDMSR_OUT pDataOut
 );
 
+EXTERN_C VOID _wrmsr(
+	_In_ PWRMSR_IN pDataIn
+);
+#else
+/// <summary>
+/// Inline version of the rwmsr.asm procedure. Input and output may share the same buffer.
+/// </summary>
+FORCEINLINE VOID _rdmsr(
+	_In_ PRDMSR_IN  pDataIn,
+	_In_ PRDMSR_OUT pDataOut
+) {
+	UINT64 Value = __readmsr(*pDataIn);
+	pDataOut->EAX = (UINT32)Value;
+	pDataOut->EDX = (UINT32)(Value >> 32);
+}
+
+/// <summary>
+/// Inline version of the rwmsr.asm procedure.
+/// </summary>
+FORCEINLINE VOID _wrmsr(
+	_In_ PWRMSR_IN pDataIn
+) {
+	__writemsr(pDataIn->Msr, (UINT64)pDataIn->EDX << 32 | pDataIn->EAX);
+}
+#endif
+
+/// <summary>
+/// Check whether IOCTL_KMSR_WRITE may write a MSR.
+/// </summary>
+/// <param name="Msr">Address of the MSR.</param>
+/// <returns>Whether the MSR is in the list of writable MSRs.</returns>
+FORCEINLINE BOOLEAN KmsrIsWritable(
+	_In_ UINT32 Msr
+) {
+	if (Msr >= IA32_L3_MASK_0 && Msr < IA32_L2_MASK_0)
+		return TRUE;
+	if (Msr >= IA32_L2_MASK_0 && Msr < IA32_MBA_THRTL_0)
+		return TRUE;
+	if (Msr >= IA32_MBA_THRTL_0 && Msr < IA32_MBA_THRTL_0 + 0x40)
+		return TRUE;
+
+	switch (Msr) {
+	case IA32_QM_EVTSEL:
+	case IA32_PQR_ASSOC:
+	case MSR_MISC_FEATURE_CONTROL:
+	case MSR_AMD_PREFETCH_CONTROL:
+	case IA32_PERF_CTL:
+	case IA32_HWP_REQUEST:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
 
 #endif // !__KMSR_H_GUARD__
 
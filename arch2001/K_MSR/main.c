@@ -6,8 +6,14 @@
 ///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
 /// 
 #include <ntddk.h>
+#include <wdmsec.h>
 #include "kmsr.h"
 
+/// <summary>
+/// Class of the device object, under which an administrator can override its security descriptor.
+/// </summary>
+static const GUID KmsrClassGuid = { 0x2a9d4f61, 0x7c3b, 0x4d08, { 0xb5, 0x1e, 0x6e, 0x90, 0x47, 0xa2, 0xd3, 0x1c } };
+
 /// <summary>
 /// IRQL 0 - Executed when the driver is unloaded.
 /// </summary>
@@ -55,17 +61,20 @@ EXTERN_C NTSTATUS DriverEntry(
 	DriverObject->MajorFunction[IRP_MJ_CREATE] = KmsrCreate;
 	DriverObject->MajorFunction[IRP_MJ_CLOSE] = KmsrClose;
 
-	// 3. Create device object
+	// 3. Create device object. The driver writes MSRs, only SYSTEM and the administrators can open it,
+	// including via its namespace.
 	UNICODE_STRING DeviceName = RTL_CONSTANT_STRING(KMSR_DEVICE_PATH);
 	PDEVICE_OBJECT DeviceObject = NULL;
 
-	NTSTATUS Status = IoCreateDevice(
+	NTSTATUS Status = IoCreateDeviceSecure(
 		DriverObject,
 		0x00,
 		&DeviceName,
 		FILE_DEVICE_UNKNOWN,
-		0x00,
+		FILE_DEVICE_SECURE_OPEN,
 		FALSE,
+		&SDDL_DEVOBJ_SYS_ALL_ADM_ALL,
+		&KmsrClassGuid,
 		&DeviceObject
 	);
 	if (!NT_SUCCESS(Status)) {
@@ -19,5 +19,17 @@ _rdmsr PROC PUBLIC
 	ret
 _rdmsr ENDP
 
+_wrmsr PROC PUBLIC
+	; 1. Get the address and the data out of the structure
+	mov r10, rcx
+	mov ecx, dword ptr [r10 + 0]
+	mov eax, dword ptr [r10 + 4]
+	mov edx, dword ptr [r10 + 8]
+
+	; 2. Write the data in the MSR
+	wrmsr
+	ret
+_wrmsr ENDP
+
 ;; End of file
 end
\ No newline at end of file
@@ -22,6 +22,64 @@ VOID(STDMETHODCALLTYPE* KsegReadFunctions[6])(
 		_read_gs
 };
 
+/// <summary>
+/// Read the control registers, XCR0 and IA32_EFER of the current processor.
+/// </summary>
+static VOID KsegReadControl(
+	_Out_ PKSEG_CONTROL_OUT pControl,
+	_In_  ULONG             Index
+) {
+	RtlZeroMemory(pControl, sizeof(KSEG_CONTROL_OUT));
+	pControl->Cpu = Index;
+	pControl->Cr0 = __readcr0();
+	pControl->Cr2 = __readcr2();
+	pControl->Cr3 = __readcr3();
+	pControl->Cr4 = __readcr4();
+	pControl->Cr8 = __readcr8();
+	pControl->Efer = __readmsr(0xC0000080);
+	pControl->Valid = KSEG_CONTROL_VALID_CR | KSEG_CONTROL_VALID_EFER;
+
+	// XGETBV raises #UD unless CR4.OSXSAVE is set
+	if (pControl->Cr4 & (1ULL << 18)) {
+		pControl->Xcr0 = _xgetbv(0x00);
+		pControl->Valid |= KSEG_CONTROL_VALID_XCR0;
+	}
+}
+
+/// <summary>
+/// Whether a physical address is in one of the paging structures walked to translate a virtual address of
+/// the current process. The IOCTL is dispatched in the context of the caller, so CR3 is that of its process.
+/// </summary>
+static BOOLEAN KsegIsPagingStructure(
+	_In_ UINT64 Address,
+	_In_ UINT64 VirtualAddress
+) {
+	// 1. CR4.LA57 adds the PML5, bits 11:0 of CR3 hold the PCID and flags
+	ULONG Level = (__readcr4() & (1ULL << 12)) ? 0x05 : 0x04;
+	UINT64 Table = __readcr3() & KSEG_ADDRESS_MASK;
+
+	// 2. Walk down until the table holding the address, or the page mapping the virtual address
+	for (;;) {
+		if ((Address & KSEG_ADDRESS_MASK) == Table)
+			return TRUE;
+		if (Level == 0x01)
+			return FALSE;
+
+		MM_COPY_ADDRESS Source = { 0x00 };
+		Source.PhysicalAddress.QuadPart = (LONGLONG)(Table + ((VirtualAddress >> (12 + 9 * (Level - 1))) & 0x1FF) * sizeof(UINT64));
+		UINT64 Entry = 0x00;
+		SIZE_T Copied = 0x00;
+		if (!NT_SUCCESS(MmCopyMemory(&Entry, Source, sizeof(UINT64), MM_COPY_MEMORY_PHYSICAL, &Copied)) || Copied != sizeof(UINT64))
+			return FALSE;
+
+		// 3. Not present, or PS set in a PDPTE or a PDE
+		if ((Entry & 0x01) == 0x00 || (Level <= 0x03 && (Entry & 0x80)))
+			return FALSE;
+		Table = Entry & KSEG_ADDRESS_MASK;
+		Level--;
+	}
+}
+
 _Use_decl_annotations_
 EXTERN_C VOID KsegUnload(
 	_In_ PDRIVER_OBJECT DriverObject
@@ -85,7 +143,7 @@ EXTERN_C NTSTATUS KsegDeviceIoControl(
 
 	// 2. Check that the valid IRQL has been provided
 	switch (Stack->Parameters.DeviceIoControl.IoControlCode) {
-		// 2.1 If the only IOCTL is provided.
+		// 2.1 If a segment register and its descriptor are requested.
 		case IOCTL_KSEG_QUERY: {
 			// 2.1.2 Check the size of the buffers
 			if (Stack->Parameters.DeviceIoControl.InputBufferLength < sizeof(UINT16)
@@ -135,10 +193,149 @@ EXTERN_C NTSTATUS KsegDeviceIoControl(
 			break;
 		}
 
-		// 2.2 If any other IOCTL is provided.
-		default: {
-			KdPrint(("[K_SEG] Invalid IRQL has been provided.\n"));
-			Status = STATUS_INVALID_DEVICE_REQUEST;
+		// 2.2 If the descriptor table registers are requested.
+		case IOCTL_KSEG_QUERY_DTR: {
+			// 2.2.1 Check the size of the output buffer
+			if (Stack->Parameters.DeviceIoControl.OutputBufferLength < sizeof(KSEG_DTR_OUT)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 2.2.2 Get the registers of the current processor
+			SGDT_OUT Gdtr = { 0x00 };
+			SGDT_OUT Idtr = { 0x00 };
+			Segment Ldtr = { 0x00 };
+			Segment Tr = { 0x00 };
+			_read_gdtr(&Gdtr);
+			_read_idtr(&Idtr);
+			_read_ldtr(&Ldtr);
+			_read_tr(&Tr);
+			KdPrint(("[K_SEG] GDT address 0x%p, IDT address 0x%p\n", Gdtr.Address, Idtr.Address));
+
+			// 2.2.3 Return data back to the caller
+			PKSEG_DTR_OUT DataOut = (PKSEG_DTR_OUT)Irp->AssociatedIrp.SystemBuffer;
+			DataOut->GdtBase = (UINT64)Gdtr.Address;
+			DataOut->IdtBase = (UINT64)Idtr.Address;
+			DataOut->GdtLimit = Gdtr.Limit;
+			DataOut->IdtLimit = Idtr.Limit;
+			DataOut->Ldtr = Ldtr;
+			DataOut->Tr = Tr;
+			Irp->IoStatus.Information = sizeof(KSEG_DTR_OUT);
+			break;
+		}
+
+		// 2.3 If the descriptor of an arbitrary GDT selector is requested, e.g. those of IA32_STAR.
+		case IOCTL_KSEG_QUERY_DESCRIPTOR: {
+			// 2.3.1 Check the size of the buffers
+			if (Stack->Parameters.DeviceIoControl.InputBufferLength < sizeof(UINT16)
+				|| Stack->Parameters.DeviceIoControl.OutputBufferLength < sizeof(KSEG_OUT)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 2.3.2 Only the GDT of the current processor is looked up
+			Segment Seg = { .value = *(PUINT16)Irp->AssociatedIrp.SystemBuffer };
+			SGDT_OUT Table = { 0x00 };
+			_read_gdtr(&Table);
+			ULONG Offset = (ULONG)Seg.elem.Index * 0x08;
+			if (Seg.elem.TableIndicator != 0x00 || Table.Address == 0x00 || Offset + 0x07 > Table.Limit) {
+				KdPrint(("[K_SEG] Selector 0x%04x outside of the GDT (limit 0x%04x)\n", Seg.value, Table.Limit));
+				Status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+
+			// 2.3.3 Descriptors are 8 bytes apart, system descriptors span two of them
+			PKSEG_OUT DataOut = (PKSEG_OUT)Irp->AssociatedIrp.SystemBuffer;
+			RtlZeroMemory(DataOut, sizeof(KSEG_OUT));
+			DataOut->Seg = Seg;
+			RtlCopyMemory(&DataOut->Descriptor, (PUINT8)Table.Address + Offset, Offset + 0x0F <= Table.Limit ? 0x10 : 0x08);
+			Irp->IoStatus.Information = sizeof(KSEG_OUT);
+			break;
+		}
+
+		// 2.4 If physical memory is requested, e.g. paging structures.
+		case IOCTL_KSEG_READ_PHYSICAL: {
+			// 2.4.1 Check the size of the buffers
+			if (Stack->Parameters.DeviceIoControl.InputBufferLength < sizeof(KSEG_PHYSICAL_IN)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 2.4.2 The input and output share the system buffer, copy the request first
+			KSEG_PHYSICAL_IN Request = *(PKSEG_PHYSICAL_IN)Irp->AssociatedIrp.SystemBuffer;
+			if (Request.Size == 0x00 || (Request.Address & (PAGE_SIZE - 1)) + Request.Size > PAGE_SIZE) {
+				Status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+			if (Stack->Parameters.DeviceIoControl.OutputBufferLength < Request.Size) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 2.4.3 Any other physical page could hold secrets of other processes or of the kernel
+			if (!KsegIsPagingStructure(Request.Address, Request.VirtualAddress)) {
+				KdPrint(("[K_SEG] 0x%llx is not a paging structure of 0x%llx\n", Request.Address, Request.VirtualAddress));
+				Status = STATUS_ACCESS_DENIED;
+				break;
+			}
+
+			// 2.4.4 MmCopyMemory does not fault on physical addresses without memory behind them
+			MM_COPY_ADDRESS Source = { 0x00 };
+			Source.PhysicalAddress.QuadPart = (LONGLONG)Request.Address;
+			SIZE_T Copied = 0x00;
+			Status = MmCopyMemory(Irp->AssociatedIrp.SystemBuffer, Source, Request.Size, MM_COPY_MEMORY_PHYSICAL, &Copied);
+			if (!NT_SUCCESS(Status) || Copied != Request.Size) {
+				KdPrint(("[K_SEG] Unable to read physical address 0x%llx: 0x%08x\n", Request.Address, Status));
+				Status = NT_SUCCESS(Status) ? STATUS_PARTIAL_COPY : Status;
+				break;
+			}
+			Irp->IoStatus.Information = Copied;
+			break;
+		}
+
+		// 2.5 If the control registers of one or all processors are requested.
+		case IOCTL_KSEG_QUERY_CONTROL: {
+			// 2.5.1 Check the size of the input buffer
+			if (Stack->Parameters.DeviceIoControl.InputBufferLength < sizeof(UINT32)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 2.5.2 Get the range of processors
+			UINT32 Cpu = *(PUINT32)Irp->AssociatedIrp.SystemBuffer;
+			ULONG Count = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+			ULONG First = Cpu == KSEG_CPU_ALL ? 0x00 : Cpu == KSEG_CPU_CURRENT ? KeGetCurrentProcessorIndex() : Cpu;
+			ULONG Last = Cpu == KSEG_CPU_ALL ? Count : First + 0x01;
+			if (First >= Count) {
+				Status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+			if (Stack->Parameters.DeviceIoControl.OutputBufferLength < (Last - First) * sizeof(KSEG_CONTROL_OUT)) {
+				Status = STATUS_BUFFER_TOO_SMALL;
+				break;
+			}
+
+			// 2.5.3 Run on each processor in turn, at PASSIVE_LEVEL hence CR8 is zero
+			PKSEG_CONTROL_OUT DataOut = (PKSEG_CONTROL_OUT)Irp->AssociatedIrp.SystemBuffer;
+			for (ULONG Index = First; Index < Last; Index++) {
+				PROCESSOR_NUMBER Number = { 0x00 };
+				GROUP_AFFINITY Affinity = { 0x00 };
+				GROUP_AFFINITY Previous = { 0x00 };
+				KeGetProcessorNumberFromIndex(Index, &Number);
+				Affinity.Group = Number.Group;
+				Affinity.Mask = (KAFFINITY)1 << Number.Number;
+				KeSetSystemGroupAffinityThread(&Affinity, &Previous);
+				KsegReadControl(&DataOut[Index - First], Index);
+				KeRevertToUserGroupAffinityThread(&Previous);
+			}
+			Irp->IoStatus.Information = (Last - First) * sizeof(KSEG_CONTROL_OUT);
+			break;
+		}
+
+		// 2.6 If any other IOCTL is provided.
+		default: {
+			KdPrint(("[K_SEG] Invalid IRQL has been provided.\n"));
+			Status = STATUS_INVALID_DEVICE_REQUEST;
 			break;
 		}
 	}
@@ -19,7 +19,23 @@
 #define KSEG_DEVICE_PATH_USERMODE L"\\??\\KSeg"
 
 /// List of IOCTL exposed by this driver
-#define IOCTL_KSEG_QUERY CTL_CODE(KSEG_DEVICE_TYPE, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KSEG_QUERY            CTL_CODE(KSEG_DEVICE_TYPE, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KSEG_QUERY_DTR        CTL_CODE(KSEG_DEVICE_TYPE, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KSEG_QUERY_DESCRIPTOR CTL_CODE(KSEG_DEVICE_TYPE, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KSEG_READ_PHYSICAL    CTL_CODE(KSEG_DEVICE_TYPE, 0x803, METHOD_BUFFERED, FILE_READ_ACCESS)
+#define IOCTL_KSEG_QUERY_CONTROL    CTL_CODE(KSEG_DEVICE_TYPE, 0x804, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/// Processors of the control registers query besides an index
+#define KSEG_CPU_CURRENT 0xFFFFFFFF
+#define KSEG_CPU_ALL     0xFFFFFFFE
+
+/// Bits 51:12 of CR3 and of the paging structure entries
+#define KSEG_ADDRESS_MASK 0x000FFFFFFFFFF000ULL
+
+/// Bits of KSEG_CONTROL_OUT.Valid
+#define KSEG_CONTROL_VALID_CR   0x00000001
+#define KSEG_CONTROL_VALID_XCR0 0x00000002
+#define KSEG_CONTROL_VALID_EFER 0x00000004
 
 /// <summary>
 /// C data structure to store the visible part of a segment register.
@@ -137,6 +153,44 @@ typedef struct _KSEG_OUT {
 	SegmentDescriptor Descriptor;
 } KSEG_OUT, *PKSEG_OUT;
 
+/// <summary>
+/// Data returned by the descriptor table registers query
+/// </summary>
+typedef struct _KSEG_DTR_OUT {
+	UINT64  GdtBase;
+	UINT64  IdtBase;
+	UINT16  GdtLimit;
+	UINT16  IdtLimit;
+	Segment Ldtr;
+	Segment Tr;
+} KSEG_DTR_OUT, *PKSEG_DTR_OUT;
+
+/// <summary>
+/// Data sent with the physical memory read, the data read is returned in the output buffer. Only the paging
+/// structures walked by the caller's CR3 to translate the virtual address can be read.
+/// </summary>
+typedef struct _KSEG_PHYSICAL_IN {
+	UINT64 Address;
+	UINT32 Size;           // At most one page, without crossing a page boundary.
+	UINT32 Reserved;
+	UINT64 VirtualAddress; // Address whose translation reads the page.
+} KSEG_PHYSICAL_IN, *PKSEG_PHYSICAL_IN;
+
+/// <summary>
+/// Data returned by the control registers query, one entry per processor
+/// </summary>
+typedef struct _KSEG_CONTROL_OUT {
+	UINT32 Cpu;
+	UINT32 Valid;
+	UINT64 Cr0;
+	UINT64 Cr2;
+	UINT64 Cr3;
+	UINT64 Cr4;
+	UINT64 Cr8;
+	UINT64 Xcr0;
+	UINT64 Efer;
+} KSEG_CONTROL_OUT, *PKSEG_CONTROL_OUT;
+
 /// <summary>
 /// C data structure representing the returned value of RDMSR instruction.
 /// </summary>
@@ -190,7 +244,9 @@ EXTERN_C VOID STDMETHODCALLTYPE _read_fs(PSegment fs);
 EXTERN_C VOID STDMETHODCALLTYPE _read_gs(PSegment gs);
 
 EXTERN_C VOID STDMETHODCALLTYPE _read_gdtr(PSGDT_OUT gdtr);
+EXTERN_C VOID STDMETHODCALLTYPE _read_idtr(PSGDT_OUT idtr);
 EXTERN_C VOID STDMETHODCALLTYPE _read_ldtr(PSegment seg);
+EXTERN_C VOID STDMETHODCALLTYPE _read_tr(PSegment seg);
 EXTERN_C VOID STDMETHODCALLTYPE _get_pkpcr(PKPCR pKpcr);
 
 #endif // !__KSEG_H_GUARD__
@@ -6,8 +6,14 @@
 ///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
 /// 
 #include <ntddk.h>
+#include <wdmsec.h>
 #include "kseg.h"
 
+/// <summary>
+/// Class of the device object, under which an administrator can override its security descriptor.
+/// </summary>
+static const GUID KsegClassGuid = { 0x5c3e6b0a, 0x8f2d, 0x4e7b, { 0x9a, 0x41, 0x2d, 0x6f, 0x13, 0xc8, 0x7e, 0x55 } };
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 EXTERN_C NTSTATUS DriverEntry(
 	_In_ PDRIVER_OBJECT  DriverObject,
@@ -24,17 +30,20 @@ EXTERN_C NTSTATUS DriverEntry(
 	DriverObject->MajorFunction[IRP_MJ_CREATE] = KsegCreate;
 	DriverObject->MajorFunction[IRP_MJ_CLOSE] = KsegClose;
 
-	// 3. Create device object
+	// 3. Create device object. The driver reads physical memory, only SYSTEM and the administrators can
+	// open it, including via its namespace.
 	UNICODE_STRING DeviceName = RTL_CONSTANT_STRING(KSEG_DEVICE_PATH);
 	PDEVICE_OBJECT DeviceObject = NULL;
 
-	NTSTATUS Status = IoCreateDevice(
+	NTSTATUS Status = IoCreateDeviceSecure(
 		DriverObject,
 		0x00,
 		&DeviceName,
 		FILE_DEVICE_UNKNOWN,
-		0x00,
+		FILE_DEVICE_SECURE_OPEN,
 		FALSE,
+		&SDDL_DEVOBJ_SYS_ALL_ADM_ALL,
+		&KsegClassGuid,
 		&DeviceObject
 	);
 	if (!NT_SUCCESS(Status)) {
@@ -42,5 +42,20 @@ _read_gdtr PROC PUBLIC
 	ret
 _read_gdtr ENDP
 
+_read_idtr PROC PUBLIC
+	sidt tbyte ptr [rcx]
+	ret
+_read_idtr ENDP
+
+_read_ldtr PROC PUBLIC
+	sldt word ptr [rcx]
+	ret
+_read_ldtr ENDP
+
+_read_tr PROC PUBLIC
+	str word ptr [rcx]
+	ret
+_read_tr ENDP
+
 ;; End of file
 end
\ No newline at end of file
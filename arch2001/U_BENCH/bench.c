@@ -0,0 +1,39 @@
+/// @file    bench.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <time.h>
+#endif
+#include "bench.h"
+
+UINT64 BenchGetTime() {
+#if defined(_WIN32)
+	static LARGE_INTEGER Frequency = { 0x00 };
+	if (Frequency.QuadPart == 0x00)
+		QueryPerformanceFrequency(&Frequency);
+
+	LARGE_INTEGER Counter = { 0x00 };
+	QueryPerformanceCounter(&Counter);
+	return (UINT64)((Counter.QuadPart / Frequency.QuadPart) * 1000000000
+		+ ((Counter.QuadPart % Frequency.QuadPart) * 1000000000) / Frequency.QuadPart);
+#else
+	struct timespec Time = { 0x00 };
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (UINT64)Time.tv_sec * 1000000000 + (UINT64)Time.tv_nsec;
+#endif
+}
+
+_Use_decl_annotations_
+VOID BenchReport(
+	_In_ LPCSTR szName,
+	_In_ UINT64 Iterations,
+	_In_ UINT64 Elapsed
+) {
+	double NsPerIteration = Iterations == 0x00 ? 0.0 : (double)Elapsed / (double)Iterations;
+	printf("    - %-48s %12.2f ns/op (%llu iterations)\n", szName, NsPerIteration, (unsigned long long)Iterations);
+}
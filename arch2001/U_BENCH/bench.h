@@ -0,0 +1,70 @@
+/// @file    bench.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __BENCH_H_GUARD__
+#define __BENCH_H_GUARD__
+#include "ost.h"
+#include <stdio.h>
+
+/// Default number of iterations for user mode and kernel round trip measurements
+#define BENCH_ITERATIONS_FAST 10000000
+#define BENCH_ITERATIONS_SLOW 100000
+
+/// <summary>
+/// Measure the time taken by a statement executed in a tight loop and print the time per iteration.
+/// The statement is expanded inline so that the measure does not include an indirect call.
+/// </summary>
+#define BENCH_RUN(Name, Iterations, Statement) \
+	do { \
+		UINT64 _Start = BenchGetTime(); \
+		for (UINT64 _Index = 0x00; _Index < (UINT64)(Iterations); _Index++) { Statement; } \
+		BenchReport(Name, (Iterations), BenchGetTime() - _Start); \
+	} while (0)
+
+/// <summary>
+/// Entry of the list of benchmarks.
+/// </summary>
+typedef struct _BENCH_ENTRY {
+	LPCSTR Name;
+	LPCSTR Description;
+	VOID(*Routine)();
+} BENCH_ENTRY, * PBENCH_ENTRY;
+
+/// <summary>
+/// Get a monotonic timestamp.
+/// </summary>
+/// <returns>Timestamp in nanoseconds.</returns>
+UINT64 BenchGetTime();
+
+/// <summary>
+/// Print the result of a measure.
+/// </summary>
+/// <param name="szName">Name of the measure.</param>
+/// <param name="Iterations">Number of iterations executed.</param>
+/// <param name="Elapsed">Elapsed time in nanoseconds.</param>
+VOID BenchReport(
+	_In_ LPCSTR szName,
+	_In_ UINT64 Iterations,
+	_In_ UINT64 Elapsed
+);
+
+/// List of benchmarks
+VOID BenchDtr();
+VOID BenchSegBase();
+VOID BenchCpuNum();
+VOID BenchIntrin();
+VOID BenchCollector();
+VOID BenchPool();
+VOID BenchArena();
+VOID BenchTagPtr();
+VOID BenchWait();
+VOID BenchPmc();
+VOID BenchHypervisor();
+VOID BenchMitigation();
+VOID BenchOutput();
+
+#endif // !__BENCH_H_GUARD__
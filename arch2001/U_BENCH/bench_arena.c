@@ -0,0 +1,110 @@
+/// @file    bench_arena.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "bench.h"
+#include "arena.h"
+
+/// Size of the index and number of dependent loads
+#define BENCH_ARENA_SIZE  ((SIZE_T)256 << 20)
+#define BENCH_ARENA_LINE  64
+#define BENCH_ARENA_LOADS (4 * 1024 * 1024)
+
+/// <summary>
+/// Link every cache line of the arena in a random cycle, the worst case of an index lookup.
+/// </summary>
+static PVOID* BenchArenaLink(
+	_In_ PARENA pArena
+) {
+	SIZE_T Lines = BENCH_ARENA_SIZE / BENCH_ARENA_LINE;
+	PBYTE Base = (PBYTE)ArenaAlloc(pArena, BENCH_ARENA_SIZE, BENCH_ARENA_LINE);
+	if (Base == NULL)
+		return NULL;
+
+	// 1. Identity permutation, stored in the second word of the lines, the first one receiving the pointers
+	for (SIZE_T Index = 0x00; Index < Lines; Index++)
+		*(SIZE_T*)(Base + Index * BENCH_ARENA_LINE + sizeof(PVOID)) = Index;
+
+	// 2. Shuffle
+	UINT64 State = 0x9E3779B97F4A7C15ULL;
+	for (SIZE_T Index = Lines - 1; Index > 0; Index--) {
+		State ^= State << 13;
+		State ^= State >> 7;
+		State ^= State << 17;
+		SIZE_T Other = (SIZE_T)(State % (Index + 1));
+		SIZE_T Swap = *(SIZE_T*)(Base + Index * BENCH_ARENA_LINE + sizeof(PVOID));
+		*(SIZE_T*)(Base + Index * BENCH_ARENA_LINE + sizeof(PVOID)) = *(SIZE_T*)(Base + Other * BENCH_ARENA_LINE + sizeof(PVOID));
+		*(SIZE_T*)(Base + Other * BENCH_ARENA_LINE + sizeof(PVOID)) = Swap;
+	}
+
+	// 3. Turn the permutation into a cycle of pointers
+	SIZE_T First = *(SIZE_T*)(Base + sizeof(PVOID));
+	SIZE_T Current = First;
+	for (SIZE_T Index = 1; Index < Lines; Index++) {
+		SIZE_T Next = *(SIZE_T*)(Base + Index * BENCH_ARENA_LINE + sizeof(PVOID));
+		*(PVOID*)(Base + Current * BENCH_ARENA_LINE) = Base + Next * BENCH_ARENA_LINE;
+		Current = Next;
+	}
+	*(PVOID*)(Base + Current * BENCH_ARENA_LINE) = Base + First * BENCH_ARENA_LINE;
+	return (PVOID*)(Base + First * BENCH_ARENA_LINE);
+}
+
+/// <summary>
+/// Chase the pointers of an arena backed by pages of a given size at most.
+/// </summary>
+static VOID BenchArenaRun(
+	_In_ const ARENA_SUPPORT* pSupport,
+	_In_ UINT32               uiLargestPage
+) {
+	ARENA Arena = { 0x00 };
+	if (!ArenaCreate(&Arena, pSupport, BENCH_ARENA_SIZE, uiLargestPage)) {
+		printf("    - Unable to create the arena.\n");
+		return;
+	}
+	PVOID* Pointer = BenchArenaLink(&Arena);
+	if (Pointer == NULL) {
+		ArenaDestroy(&Arena);
+		return;
+	}
+
+	CHAR szName[0x80] = { 0x00 };
+	snprintf(szName, sizeof(szName), "random load, %s", Arena.Backing);
+	UINT64 Start = BenchGetTime();
+	for (UINT32 Index = 0x00; Index < BENCH_ARENA_LOADS; Index++)
+		Pointer = (PVOID*)*Pointer;
+	UINT64 Elapsed = BenchGetTime() - Start;
+	BenchReport(szName, BENCH_ARENA_LOADS, Elapsed + (Pointer == NULL));
+	ArenaDestroy(&Arena);
+}
+
+VOID BenchArena() {
+	// 1. Get the page sizes and the TLB reach
+	CPUID_BACKEND Backend = { 0x00 };
+	ARENA_SUPPORT Support = { 0x00 };
+	if (!CpuidOpen(&Backend) || !ArenaQuerySupport(&Backend, &Support)) {
+		printf("    - Unable to get the page sizes.\n");
+		CpuidClose(&Backend);
+		return;
+	}
+	CpuidClose(&Backend);
+
+	static const LPCSTR Names[ARENA_PAGE_COUNT] = { "4 KiB", "2 MiB", "1 GiB" };
+	for (UINT32 Page = 0x00; Page < ARENA_PAGE_COUNT; Page++) {
+		printf("    - %s pages: processor %s, OS %s", Names[Page], Support.Cpu[Page] ? "yes" : "no",
+			Support.Os[Page] ? "yes" : Page == ARENA_PAGE_2M && Support.Transparent ? "THP" : "no");
+		if (ArenaGetTlbReach(&Support, Page) != 0x00) {
+			printf(", dTLB %u + %u entries, reach %llu MiB\n", Support.Tlb.L1Entries[Page], Support.Tlb.L2Entries[Page],
+				(unsigned long long)(ArenaGetTlbReach(&Support, Page) >> 20));
+		}
+		else {
+			printf(", TLB sizes not reported\n");
+		}
+	}
+
+	// 2. Same index on regular pages and on the largest pages available
+	BenchArenaRun(&Support, ARENA_PAGE_4K);
+	BenchArenaRun(&Support, ARENA_PAGE_1G);
+}
@@ -0,0 +1,128 @@
+/// @file    bench_collector.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "collector.h"
+#include <stdlib.h>
+#include "atomic.h"
+#include "bench.h"
+
+/// Socket used by the benchmark and number of queries sent by each client
+#if defined(_WIN32)
+#define BENCH_COLLECTOR_PATH "ost-collector-bench.sock"
+#else
+#define BENCH_COLLECTOR_PATH "/tmp/ost-collector-bench.sock"
+#endif
+#define BENCH_COLLECTOR_QUERIES 20000
+
+/// <summary>
+/// State of a client of the load test.
+/// </summary>
+typedef struct _BENCH_COLLECTOR_CLIENT {
+	THREAD          Thread;
+	volatile INT32* pReady;
+	UINT32          uiFailed;
+} BENCH_COLLECTOR_CLIENT, * PBENCH_COLLECTOR_CLIENT;
+
+static VOID BenchCollectorServer(
+	_In_ PVOID Parameter
+) {
+	CollectorServerRun((PCOLLECTOR_SERVER)Parameter);
+}
+
+static VOID BenchCollectorClient(
+	_In_ PVOID Parameter
+) {
+	PBENCH_COLLECTOR_CLIENT Client = (PBENCH_COLLECTOR_CLIENT)Parameter;
+	COLLECTOR_CLIENT Connection = { 0x00 };
+	SNAPSHOT_RECORD Record = { 0x00 };
+	BOOL bConnected = CollectorConnect(BENCH_COLLECTOR_PATH, &Connection);
+
+	// Start all the clients at the same time
+	AtomicAdd32(Client->pReady, -1);
+	while (AtomicLoad32(Client->pReady) > 0x00)
+		AtomicPause();
+
+	if (!bConnected) {
+		Client->uiFailed = BENCH_COLLECTOR_QUERIES;
+		return;
+	}
+	for (UINT32 Index = 0x00; Index < BENCH_COLLECTOR_QUERIES; Index++) {
+		if (CollectorQuery(&Connection, COLLECTOR_QUERY_SNAPSHOT, 0x00, &Record, sizeof(Record), NULL) != COLLECTOR_STATUS_SUCCESS)
+			Client->uiFailed++;
+	}
+	CollectorDisconnect(&Connection);
+}
+
+/// <summary>
+/// Run a number of concurrent clients against the collector and print the throughput.
+/// </summary>
+static VOID BenchCollectorLoad(
+	_In_ UINT32 uiClients
+) {
+	PBENCH_COLLECTOR_CLIENT Clients = (PBENCH_COLLECTOR_CLIENT)calloc(uiClients, sizeof(BENCH_COLLECTOR_CLIENT));
+	volatile INT32 Ready = (INT32)uiClients;
+	if (Clients == NULL)
+		return;
+
+	// 1. Start the clients
+	UINT64 Start = BenchGetTime();
+	UINT32 uiStarted = 0x00;
+	for (; uiStarted < uiClients; uiStarted++) {
+		Clients[uiStarted].pReady = &Ready;
+		if (!ThreadCreate(&Clients[uiStarted].Thread, BenchCollectorClient, &Clients[uiStarted])) {
+			AtomicAdd32(&Ready, -(INT32)(uiClients - uiStarted));
+			break;
+		}
+	}
+
+	// 2. Wait for all of them
+	UINT32 uiFailed = 0x00;
+	for (UINT32 Index = 0x00; Index < uiStarted; Index++) {
+		ThreadJoin(&Clients[Index].Thread);
+		uiFailed += Clients[Index].uiFailed;
+	}
+	UINT64 Elapsed = BenchGetTime() - Start;
+	UINT64 Queries = (UINT64)uiStarted * BENCH_COLLECTOR_QUERIES;
+
+	printf("    - %4u client(s) : %10.0f queries/s, %8.2f us/query per client, %u failed\n",
+		uiStarted,
+		(double)Queries * 1e9 / (double)(Elapsed ? Elapsed : 1),
+		(double)Elapsed / 1000.0 / (double)BENCH_COLLECTOR_QUERIES,
+		uiFailed);
+	free(Clients);
+}
+
+VOID BenchCollector() {
+	static COLLECTOR_SERVER Server;
+	THREAD ServerThread = { 0x00 };
+
+	// 1. Start a collector in the process
+	if (!CollectorServerStart(&Server, BENCH_COLLECTOR_PATH, COLLECTOR_DEFAULT_REFRESH)) {
+		printf("    - Unable to start the collector.\n");
+		return;
+	}
+	if (!ThreadCreate(&ServerThread, BenchCollectorServer, &Server)) {
+		CollectorServerClose(&Server);
+		return;
+	}
+
+	// 2. Latency of a single client, then load with many concurrent clients
+	COLLECTOR_CLIENT Client = { 0x00 };
+	SNAPSHOT_RECORD Record = { 0x00 };
+	if (CollectorConnect(BENCH_COLLECTOR_PATH, &Client)) {
+		BENCH_RUN("ping round trip", BENCH_ITERATIONS_SLOW, (VOID)CollectorQuery(&Client, COLLECTOR_QUERY_PING, 0x00, NULL, 0x00, NULL));
+		BENCH_RUN("snapshot of one processor", BENCH_ITERATIONS_SLOW, (VOID)CollectorQuery(&Client, COLLECTOR_QUERY_SNAPSHOT, 0x00, &Record, sizeof(Record), NULL));
+		CollectorDisconnect(&Client);
+	}
+	for (UINT32 uiClients = 0x01; uiClients <= 256; uiClients *= 4)
+		BenchCollectorLoad(uiClients);
+
+	// 3. Stop the collector
+	CollectorServerStop(&Server);
+	ThreadJoin(&ServerThread);
+	CollectorServerClose(&Server);
+}
@@ -0,0 +1,132 @@
+/// @file    bench_cpunum.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "bench.h"
+#include "cpuid.h"
+#include "cpunum.h"
+#include "percpu.h"
+#include "thread.h"
+
+/// Number of increments executed by each thread of the scaling benchmark
+#define BENCH_CPUNUM_INCREMENTS 5000000
+
+/// <summary>
+/// State of a thread of the scaling benchmark.
+/// </summary>
+typedef struct _BENCH_CPUNUM_WORKER {
+	THREAD          Thread;
+	UINT32          Cpu;
+	BOOL            bPerCpu;
+	volatile INT64* pShared;
+	PPERCPU_COUNTER pCounter;
+	volatile INT32* pReady;
+} BENCH_CPUNUM_WORKER, * PBENCH_CPUNUM_WORKER;
+
+static VOID BenchCpuNumWorker(
+	_In_ PVOID Parameter
+) {
+	PBENCH_CPUNUM_WORKER Worker = (PBENCH_CPUNUM_WORKER)Parameter;
+	(VOID)ThreadPin(Worker->Cpu, NULL);
+
+	// Start all the threads at the same time
+	AtomicAdd32(Worker->pReady, -1);
+	while (AtomicLoad32(Worker->pReady) > 0x00)
+		AtomicPause();
+
+	if (Worker->bPerCpu) {
+		for (UINT32 Index = 0x00; Index < BENCH_CPUNUM_INCREMENTS; Index++)
+			PerCpuCounterAdd(Worker->pCounter, 1);
+	}
+	else {
+		for (UINT32 Index = 0x00; Index < BENCH_CPUNUM_INCREMENTS; Index++)
+			AtomicAdd64(Worker->pShared, 1);
+	}
+}
+
+/// <summary>
+/// Increment a counter from a number of pinned threads and print the throughput.
+/// </summary>
+static BOOL BenchCpuNumScale(
+	_In_ UINT32 uiThreads,
+	_In_ BOOL   bPerCpu
+) {
+	PBENCH_CPUNUM_WORKER Workers = (PBENCH_CPUNUM_WORKER)calloc(uiThreads, sizeof(BENCH_CPUNUM_WORKER));
+	DECLSPEC_ALIGN(CACHE_LINE_SIZE) volatile INT64 Shared = 0x00;
+	volatile INT32 Ready = (INT32)uiThreads;
+	PERCPU_COUNTER Counter = { 0x00 };
+	if (Workers == NULL || !PerCpuCounterCreate(&Counter)) {
+		free(Workers);
+		return FALSE;
+	}
+
+	// 1. Start one thread per processor
+	UINT64 Start = BenchGetTime();
+	UINT32 uiStarted = 0x00;
+	for (; uiStarted < uiThreads; uiStarted++) {
+		Workers[uiStarted].Cpu = uiStarted;
+		Workers[uiStarted].bPerCpu = bPerCpu;
+		Workers[uiStarted].pShared = &Shared;
+		Workers[uiStarted].pCounter = &Counter;
+		Workers[uiStarted].pReady = &Ready;
+		if (!ThreadCreate(&Workers[uiStarted].Thread, BenchCpuNumWorker, &Workers[uiStarted])) {
+			AtomicAdd32(&Ready, -(INT32)(uiThreads - uiStarted));
+			break;
+		}
+	}
+
+	// 2. Wait for all of them and check the total
+	for (UINT32 Index = 0x00; Index < uiStarted; Index++)
+		ThreadJoin(&Workers[Index].Thread);
+	UINT64 Elapsed = BenchGetTime() - Start;
+	INT64 Total = bPerCpu ? PerCpuCounterSum(&Counter) : Shared;
+
+	printf("    - %-9s %3u thread(s) : %8.2f Mops/s%s\n",
+		bPerCpu ? "per-CPU" : "shared",
+		uiStarted,
+		(double)Total * 1000.0 / (double)(Elapsed ? Elapsed : 1),
+		Total == (INT64)uiStarted * BENCH_CPUNUM_INCREMENTS ? "" : " (lost updates)");
+
+	PerCpuCounterDestroy(&Counter);
+	free(Workers);
+	return uiStarted == uiThreads;
+}
+
+VOID BenchCpuNum() {
+	volatile UINT32 Cpu = 0x00;
+	CPUNUM CpuNum = { 0x00 };
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+
+	// 1. Selected path
+	CPUNUM_SOURCE Source = CpuNumInitialise();
+	printf("    - Source: %u, processor mask: 0x%08X, node shift: %u\n", Source, g_CpuNumEncoding.CpuMask, g_CpuNumEncoding.NodeShift);
+	BENCH_RUN("CpuNumCurrent", BENCH_ITERATIONS_FAST, Cpu = CpuNumCurrent());
+	BENCH_RUN("CpuNumCurrentEx", BENCH_ITERATIONS_FAST, CpuNumCurrentEx(&CpuNum));
+
+	// 2. Each source individually
+	if (Cpuid->ExtendedEcx.elem.RDPID)
+		BENCH_RUN("RDPID", BENCH_ITERATIONS_FAST, Cpu = _rdpid());
+	if (Cpuid->ExtendedInfoEdx.elem.RDTSCP)
+		BENCH_RUN("RDTSCP", BENCH_ITERATIONS_FAST, Cpu = _rdtscp_aux());
+#if !defined(_WIN32)
+	if (Source == CpuNumSourceRseq)
+		BENCH_RUN("rseq cpu_id", BENCH_ITERATIONS_FAST, Cpu = _rseq_cpu_id());
+#endif
+	BENCH_RUN("ThreadGetCurrentCpu (OS)", BENCH_ITERATIONS_SLOW, Cpu = ThreadGetCurrentCpu());
+
+	// 3. Shared atomic versus per-CPU counter
+	UINT32 uiCount = ThreadGetCpuCount();
+	for (UINT32 uiThreads = 0x01; ; uiThreads *= 2) {
+		if (uiThreads > uiCount)
+			uiThreads = uiCount;
+		if (!BenchCpuNumScale(uiThreads, FALSE) || !BenchCpuNumScale(uiThreads, TRUE))
+			break;
+		if (uiThreads == uiCount)
+			break;
+	}
+	(VOID)Cpu;
+}
@@ -0,0 +1,47 @@
+/// @file    bench_dtr.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include "bench.h"
+#include "dtr.h"
+
+VOID BenchDtr() {
+	DTR_INFORMATION Information = { 0x00 };
+	DTR_SOURCE Source = DtrInitialise();
+
+	// 1. User mode fast path. Under UMIP emulation every instruction traps into the kernel.
+	if (Source == DtrSourceInstruction || Source == DtrSourceEmulated) {
+		BENCH_RUN(
+			Source == DtrSourceInstruction ? "SGDT/SIDT/SLDT/STR in user mode" : "SGDT/SIDT/SLDT/STR emulated by the kernel",
+			Source == DtrSourceInstruction ? BENCH_ITERATIONS_FAST : BENCH_ITERATIONS_SLOW,
+			DtrReadInstruction(&Information)
+		);
+	}
+	else {
+		printf("    - UMIP is enforced, the user mode fast path is unavailable.\n");
+	}
+
+	// 2. Round trip to the kernel.
+#if defined(_WIN32)
+	if (DtrReadDriver(&Information)) {
+		BENCH_RUN("\\\\.\\KSeg IOCTL_KSEG_QUERY_DTR round trip", BENCH_ITERATIONS_SLOW, (VOID)DtrReadDriver(&Information));
+	}
+	else {
+		printf("    - Unable to query the \\\\.\\KSeg driver: %d\n", GetLastError());
+	}
+#else
+	BENCH_RUN("null system call round trip (reference)", BENCH_ITERATIONS_SLOW, syscall(SYS_getppid));
+#endif
+
+	// 3. Selected path
+	BENCH_RUN("DtrRead", BENCH_ITERATIONS_SLOW, (VOID)DtrRead(&Information));
+	DtrUninitialise();
+}
@@ -0,0 +1,38 @@
+/// @file    bench_hypervisor.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "bench.h"
+#include "hypervisor.h"
+
+VOID BenchHypervisor() {
+	// 1. Which hypervisor, if any
+	HYPERVISOR_INFORMATION Information = { 0x00 };
+	MSR_BACKEND Msr = { 0x00 };
+	BOOL bMsr = MsrOpen(&Msr);
+	if (HypervisorQuery(NULL, bMsr ? &Msr : NULL, &Information)) {
+		printf("    - Hypervisor: %s", Information.bPresent ? HypervisorGetVendorName(Information.Vendor) : "none");
+		if (Information.TscFrequency != 0x00)
+			printf(", TSC at %llu kHz", (unsigned long long)(Information.TscFrequency / 1000));
+		printf("\n");
+	}
+
+	// 2. Cost of the probes, per execution
+	HYPERVISOR_PROFILE Profile = { 0x00 };
+	HypervisorProfile(bMsr ? &Msr : NULL, 0x00, &Profile);
+	if (bMsr)
+		MsrClose(&Msr);
+	for (UINT32 Probe = 0x00; Probe < HypervisorProbeCount; Probe++) {
+		const HYPERVISOR_COST* pCost = &Profile.Costs[Probe];
+		if (!pCost->bMeasured) {
+			printf("    - %-20s not available\n", HypervisorGetProbeName((HYPERVISOR_PROBE)Probe));
+			continue;
+		}
+		printf("    - %-20s median %8llu ticks, minimum %8llu ticks%s\n", HypervisorGetProbeName((HYPERVISOR_PROBE)Probe),
+			(unsigned long long)pCost->Median, (unsigned long long)pCost->Minimum,
+			pCost->bExits ? ", exits to the hypervisor: keep off hot paths" : "");
+	}
+}
@@ -0,0 +1,45 @@
+/// @file    bench_intrin.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "bench.h"
+#include "cpuid.h"
+#include "intrinsics.h"
+#include "selector.h"
+
+#if !defined(_WIN32)
+/// <summary>
+/// Out-of-line equivalent of the MASM procedure, which only exists on Windows.
+/// </summary>
+static __attribute__((noinline)) VOID _read_cs(PUINT16 cs) { *cs = _get_cs(); }
+#endif
+
+VOID BenchIntrin() {
+	volatile UINT16 Selector = 0x00;
+	UINT16 Selectors[SELECTOR_COUNT] = { 0x00 };
+	UINT Registers[4] = { 0x00 };
+
+	// 1. Single segment register read, where the call dominates
+	UINT16 Cs = 0x00;
+	BENCH_RUN("_read_cs (out-of-line)", BENCH_ITERATIONS_FAST, _read_cs(&Cs); Selector = Cs);
+	BENCH_RUN("_get_cs (inline)", BENCH_ITERATIONS_FAST, Selector = _get_cs());
+
+	// 2. All the segment registers
+	BENCH_RUN("SelectorReadAll (out-of-line)", BENCH_ITERATIONS_FAST, SelectorReadAll(Selectors));
+	BENCH_RUN("_get_cs .. _get_gs (inline)", BENCH_ITERATIONS_FAST,
+		Selectors[SELECTOR_CS] = _get_cs(); Selectors[SELECTOR_SS] = _get_ss();
+		Selectors[SELECTOR_DS] = _get_ds(); Selectors[SELECTOR_ES] = _get_es();
+		Selectors[SELECTOR_FS] = _get_fs(); Selectors[SELECTOR_GS] = _get_gs());
+
+	// 3. CPUID, where the instruction dominates, and even more so under a hypervisor
+	UINT eax = 0x00;
+	UINT ecx = 0x00;
+	UINT ebx = 0x00;
+	UINT edx = 0x00;
+	BENCH_RUN("CPUIDEX (out-of-line)", BENCH_ITERATIONS_SLOW, eax = 0x00; ecx = 0x00; (VOID)CPUIDEX(&eax, &ecx, &ebx, &edx));
+	BENCH_RUN("_cpuid_query (inline)", BENCH_ITERATIONS_SLOW, _cpuid_query(0x00, 0x00, Registers));
+	(VOID)Selector;
+}
@@ -0,0 +1,146 @@
+/// @file    bench_mitigation.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/syscall.h>
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+#include "bench.h"
+#include "atomic.h"
+#include "mitigation.h"
+#include "thread.h"
+#include "wait.h"
+
+/// Number of indirect call targets and length of the sequence of targets, a power of two
+#define BENCH_MITIGATION_TARGETS  8
+#define BENCH_MITIGATION_SEQUENCE 4096
+
+/// Number of hand-overs between the two threads sharing a processor
+#define BENCH_MITIGATION_SWITCHES 20000
+
+typedef UINT64(*BENCH_MITIGATION_TARGET)(UINT64);
+
+static BENCH_NOINLINE UINT64 BenchMitigationTarget0(UINT64 Value) { return Value + 1; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget1(UINT64 Value) { return Value + 2; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget2(UINT64 Value) { return Value + 3; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget3(UINT64 Value) { return Value + 4; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget4(UINT64 Value) { return Value ^ 1; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget5(UINT64 Value) { return Value ^ 2; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget6(UINT64 Value) { return Value ^ 3; }
+static BENCH_NOINLINE UINT64 BenchMitigationTarget7(UINT64 Value) { return Value ^ 4; }
+
+static BENCH_MITIGATION_TARGET volatile g_BenchMitigationTargets[BENCH_MITIGATION_TARGETS] = {
+	BenchMitigationTarget0, BenchMitigationTarget1, BenchMitigationTarget2, BenchMitigationTarget3,
+	BenchMitigationTarget4, BenchMitigationTarget5, BenchMitigationTarget6, BenchMitigationTarget7
+};
+
+/// <summary>
+/// Counter handed over between two threads pinned on the same processor.
+/// </summary>
+typedef struct _BENCH_MITIGATION_SHARED {
+	DECLSPEC_ALIGN(64) volatile INT32 Ping;
+	DECLSPEC_ALIGN(64) volatile INT32 Pong;
+} BENCH_MITIGATION_SHARED, * PBENCH_MITIGATION_SHARED;
+
+static VOID BenchMitigationPong(
+	_In_ PVOID Parameter
+) {
+	PBENCH_MITIGATION_SHARED Shared = (PBENCH_MITIGATION_SHARED)Parameter;
+	(VOID)ThreadPin(0x00, NULL);
+	for (INT32 Index = 0x01; Index <= BENCH_MITIGATION_SWITCHES; Index++) {
+		WaitForChange(&Shared->Ping, Index - 1, 0x00, NULL);
+		AtomicStore32(&Shared->Pong, Index);
+		WaitWake(&Shared->Pong, FALSE);
+	}
+}
+
+/// <summary>
+/// Hand a counter back and forth between two threads parked on the same processor, so that every hand-over
+/// goes through the scheduler and a switch between two address space contexts of the same process, i.e.
+/// where the OS flushes or stuffs the branch predictors.
+/// </summary>
+static VOID BenchMitigationSwitch() {
+	static BENCH_MITIGATION_SHARED Shared;
+	RtlZeroMemory(&Shared, sizeof(Shared));
+	WAIT_METHOD Selected = WaitInitialise(NULL);
+	if (!WaitSetMethod(WaitMethodPark)) {
+		printf("    - Unable to park threads, the thread switch is skipped.\n");
+		return;
+	}
+
+	THREAD Thread = { 0x00 };
+	THREAD_AFFINITY Previous = { 0x00 };
+	BOOL bPinned = ThreadPin(0x00, &Previous);
+	if (!ThreadCreate(&Thread, BenchMitigationPong, &Shared)) {
+		printf("    - Unable to start the second thread.\n");
+		if (bPinned)
+			ThreadRestore(&Previous);
+		(VOID)WaitSetMethod(Selected);
+		return;
+	}
+
+	UINT64 Start = BenchGetTime();
+	for (INT32 Index = 0x01; Index <= BENCH_MITIGATION_SWITCHES; Index++) {
+		AtomicStore32(&Shared.Ping, Index);
+		WaitWake(&Shared.Ping, FALSE);
+		WaitForChange(&Shared.Pong, Index - 1, 0x00, NULL);
+	}
+	UINT64 Elapsed = BenchGetTime() - Start;
+	ThreadJoin(&Thread);
+	if (bPinned)
+		ThreadRestore(&Previous);
+	(VOID)WaitSetMethod(Selected);
+	BenchReport("thread switch on the same processor", BENCH_MITIGATION_SWITCHES * 2ULL, Elapsed);
+}
+
+VOID BenchMitigation() {
+	// 1. Key of the results, they are only comparable for the same processor and microcode
+	MITIGATION_AUDIT Audit = { 0x00 };
+	MSR_BACKEND Msr = { 0x00 };
+	BOOL bMsr = MsrOpen(&Msr);
+	if (MitigationAudit(bMsr ? &Msr : NULL, &Audit)) {
+		CHAR szKey[0x40] = { 0x00 };
+		MitigationFormatKey(&Audit.Key, szKey, sizeof(szKey));
+		printf("    - Key: %s%s\n", szKey, Audit.Key.bMicrocodeMixed ? " (mixed microcode)" : "");
+		if (Audit.bSpecCtrl)
+			printf("    - IA32_SPEC_CTRL: 0x%llx\n", (unsigned long long)Audit.SpecCtrl);
+	}
+	if (bMsr)
+		MsrClose(&Msr);
+
+	// 2. Kernel entry and exit, where most of the mitigations are paid
+#if defined(_WIN32)
+	BENCH_RUN("null system call round trip", BENCH_ITERATIONS_SLOW, (VOID)WaitForSingleObject(GetCurrentProcess(), 0x00));
+#else
+	BENCH_RUN("null system call round trip", BENCH_ITERATIONS_SLOW, syscall(SYS_getppid));
+#endif
+
+	// 3. Indirect calls, which retpolines and IBRS make slower in the kernel and, with STIBP or
+	// IPRED_DIS_U, in user mode too
+	static UINT8 Sequence[BENCH_MITIGATION_SEQUENCE];
+	UINT32 Seed = 0x2545F491;
+	for (UINT32 Index = 0x00; Index < BENCH_MITIGATION_SEQUENCE; Index++) {
+		Seed ^= Seed << 13;
+		Seed ^= Seed >> 17;
+		Seed ^= Seed << 5;
+		Sequence[Index] = (UINT8)(Seed % BENCH_MITIGATION_TARGETS);
+	}
+	volatile UINT64 Sink = 0x00;
+	BENCH_RUN("direct call", BENCH_ITERATIONS_FAST, Sink = BenchMitigationTarget0(Sink));
+	BENCH_RUN("indirect call, single target", BENCH_ITERATIONS_FAST, Sink = g_BenchMitigationTargets[0](Sink));
+	BENCH_RUN("indirect call, targets in turn", BENCH_ITERATIONS_FAST,
+		Sink = g_BenchMitigationTargets[_Index % BENCH_MITIGATION_TARGETS](Sink));
+	BENCH_RUN("indirect call, random targets", BENCH_ITERATIONS_FAST,
+		Sink = g_BenchMitigationTargets[Sequence[_Index % BENCH_MITIGATION_SEQUENCE]](Sink));
+
+	// 4. Scheduler round trip
+	BenchMitigationSwitch();
+}
@@ -0,0 +1,164 @@
+/// @file    bench_output.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "bench.h"
+#include "ctlreg.h"
+#include "output.h"
+#include "snapshot.h"
+
+/// Number of records emitted by each measure, and number of distinct decoded states cycled through
+#define BENCH_OUTPUT_RECORDS   2000000
+#define BENCH_OUTPUT_SNAPSHOTS 200000
+#define BENCH_OUTPUT_STATES    64
+
+/// <summary>
+/// Sink discarding the bytes, so that only the formatting is measured.
+/// </summary>
+static BOOL BenchOutputDiscard(
+	_In_ PVOID                    Context,
+	_In_reads_bytes_(Size) const VOID* pData,
+	_In_ SIZE_T                   Size
+) {
+	(VOID)pData;
+	*(volatile UINT64*)Context += Size;
+	return TRUE;
+}
+
+/// <summary>
+/// Write the control registers of a processor with the features they enable, decoded from the raw values.
+/// </summary>
+static VOID BenchOutputDecoded(
+	_Inout_ POUTPUT             pOutput,
+	_In_    const CTLREG_STATE* pState
+) {
+	CTLREG_CR4 Cr4 = { .value = pState->Cr4 };
+	CTLREG_EFER Efer = { .value = pState->Efer };
+
+	OutputBegin(pOutput, "ctlreg");
+	OutputUnsigned(pOutput, "cpu", pState->Cpu);
+	OutputHex(pOutput, "cr0", pState->Cr0, 16);
+	OutputHex(pOutput, "cr3", pState->Cr3, 16);
+	OutputHex(pOutput, "cr4", pState->Cr4, 16);
+	OutputHex(pOutput, "efer", pState->Efer, 16);
+	OutputBool(pOutput, "smep", (BOOL)Cr4.elem.SMEP);
+	OutputBool(pOutput, "smap", (BOOL)Cr4.elem.SMAP);
+	OutputBool(pOutput, "umip", (BOOL)Cr4.elem.UMIP);
+	OutputBool(pOutput, "la57", (BOOL)Cr4.elem.LA57);
+	OutputBool(pOutput, "nxe", (BOOL)Efer.elem.NXE);
+	(VOID)OutputEnd(pOutput);
+}
+
+/// <summary>
+/// Same record formatted with snprintf into a buffer, as the tools do with printf.
+/// </summary>
+static VOID BenchOutputSnprintf(
+	_Inout_ PCHAR               Buffer,
+	_Inout_ volatile UINT64*    pBytes,
+	_In_    const CTLREG_STATE* pState
+) {
+	CTLREG_CR4 Cr4 = { .value = pState->Cr4 };
+	CTLREG_EFER Efer = { .value = pState->Efer };
+
+	INT Length = snprintf(Buffer, OUTPUT_HEADER_SIZE,
+		"{\"record\":\"ctlreg\",\"cpu\":%u,\"cr0\":\"0x%016llx\",\"cr3\":\"0x%016llx\",\"cr4\":\"0x%016llx\",\"efer\":\"0x%016llx\","
+		"\"smep\":%s,\"smap\":%s,\"umip\":%s,\"la57\":%s,\"nxe\":%s}\n",
+		pState->Cpu, (unsigned long long)pState->Cr0, (unsigned long long)pState->Cr3, (unsigned long long)pState->Cr4,
+		(unsigned long long)pState->Efer, Cr4.elem.SMEP ? "true" : "false", Cr4.elem.SMAP ? "true" : "false",
+		Cr4.elem.UMIP ? "true" : "false", Cr4.elem.LA57 ? "true" : "false", Efer.elem.NXE ? "true" : "false");
+	*pBytes += (UINT64)Length;
+}
+
+/// <summary>
+/// Print the throughput of a measure.
+/// </summary>
+static VOID BenchOutputReport(
+	_In_ LPCSTR szName,
+	_In_ UINT64 Records,
+	_In_ UINT64 Bytes,
+	_In_ UINT64 Elapsed
+) {
+	Elapsed = Elapsed != 0x00 ? Elapsed : 0x01;
+	BenchReport(szName, Records, Elapsed);
+	printf("      %8.2f million records/s, %8.1f MiB/s\n",
+		(double)Records * 1e3 / (double)Elapsed, (double)Bytes * 1e9 / (double)Elapsed / 1048576.0);
+}
+
+VOID BenchOutput() {
+	static CHAR s_Buffer[OUTPUT_DEFAULT_BUFFER];
+	static CHAR s_Line[OUTPUT_HEADER_SIZE];
+	static LPCSTR s_Names[OutputFormatCount] = { "text", "JSON Lines", "CSV", "binary" };
+
+	// 1. Decoded states of typical Linux and Windows kernels, with varying processors and CR3
+	CTLREG_STATE States[BENCH_OUTPUT_STATES] = { 0x00 };
+	for (UINT32 Index = 0x00; Index < BENCH_OUTPUT_STATES; Index++) {
+		States[Index].Cpu = Index;
+		States[Index].Valid = CTLREG_VALID_CR | CTLREG_VALID_EFER;
+		States[Index].Cr0 = 0x80050033;
+		States[Index].Cr3 = 0x1AD000 + (UINT64)Index * 0x1000;
+		States[Index].Cr4 = (Index & 0x01) ? 0x3726F0 : 0xB50EF8;
+		States[Index].Efer = 0xD01;
+	}
+
+	// 2. Primitives
+	volatile UINT64 Sink = 0x00;
+	UINT64 Value = 0x00;
+	BENCH_RUN("OutputFormatUnsigned, 64-bit timestamp", BENCH_OUTPUT_RECORDS, Sink += OutputFormatUnsigned(Value += 0x9E3779B97F4A7C15, s_Line));
+	BENCH_RUN("snprintf %llu, 64-bit timestamp", BENCH_OUTPUT_RECORDS, Sink += (UINT64)snprintf(s_Line, sizeof(s_Line), "%llu", (unsigned long long)(Value += 0x9E3779B97F4A7C15)));
+	BENCH_RUN("OutputFormatHex, 16 digits", BENCH_OUTPUT_RECORDS, Sink += OutputFormatHex(Value += 0x9E3779B97F4A7C15, 16, s_Line));
+	BENCH_RUN("snprintf %016llx", BENCH_OUTPUT_RECORDS, Sink += (UINT64)snprintf(s_Line, sizeof(s_Line), "%016llx", (unsigned long long)(Value += 0x9E3779B97F4A7C15)));
+
+	// 3. Decoded records of 10 fields through every format, then the same JSON line with snprintf
+	for (UINT32 Format = 0x00; Format < OutputFormatCount; Format++) {
+		OUTPUT Output = { 0x00 };
+		UINT64 Bytes = 0x00;
+		if (!OutputOpen(&Output, (OUTPUT_FORMAT)Format, s_Buffer, sizeof(s_Buffer), BenchOutputDiscard, &Bytes))
+			continue;
+
+		CHAR szName[0x40] = { 0x00 };
+		snprintf(szName, sizeof(szName), "decoded record, %s", s_Names[Format]);
+		UINT64 Start = BenchGetTime();
+		for (UINT32 Index = 0x00; Index < BENCH_OUTPUT_RECORDS; Index++)
+			BenchOutputDecoded(&Output, &States[Index % BENCH_OUTPUT_STATES]);
+		(VOID)OutputClose(&Output);
+		BenchOutputReport(szName, Output.Records, Output.Bytes, BenchGetTime() - Start);
+	}
+
+	UINT64 Bytes = 0x00;
+	UINT64 Start = BenchGetTime();
+	for (UINT32 Index = 0x00; Index < BENCH_OUTPUT_RECORDS; Index++)
+		BenchOutputSnprintf(s_Line, &Bytes, &States[Index % BENCH_OUTPUT_STATES]);
+	BenchOutputReport("decoded record, JSON Lines with snprintf", BENCH_OUTPUT_RECORDS, Bytes, BenchGetTime() - Start);
+
+	// 4. Snapshot records of 89 fields, the largest records of the tree
+	SNAPSHOT_RECORD Record = { 0x00 };
+	Record.Magic = SNAPSHOT_RECORD_MAGIC;
+	Record.Valid = SNAPSHOT_VALID_SELECTORS | SNAPSHOT_VALID_CPUID;
+	Record.Selectors[SELECTOR_CS] = 0x33;
+	Record.Selectors[SELECTOR_SS] = 0x2B;
+	memcpy(Record.HostName, "bench", 6);
+	for (UINT32 Index = 0x00; Index < SNAPSHOT_CPUID_LEAVES; Index++)
+		Record.Cpuid[Index].Eax = 0x000C06F2 * (Index + 1);
+
+	OUTPUT_FORMAT Formats[2] = { OutputJsonLines, OutputBinary };
+	for (UINT32 Format = 0x00; Format < (UINT32)ARRAYSIZE(Formats); Format++) {
+		OUTPUT Output = { 0x00 };
+		Bytes = 0x00;
+		if (!OutputOpen(&Output, Formats[Format], s_Buffer, sizeof(s_Buffer), BenchOutputDiscard, &Bytes))
+			continue;
+
+		CHAR szName[0x40] = { 0x00 };
+		snprintf(szName, sizeof(szName), "snapshot record, %s", s_Names[Formats[Format]]);
+		Start = BenchGetTime();
+		for (UINT32 Index = 0x00; Index < BENCH_OUTPUT_SNAPSHOTS; Index++) {
+			Record.Cpu = Index;
+			Record.Timestamp = Start + Index;
+			(VOID)SnapshotWrite(&Output, &Record);
+		}
+		(VOID)OutputClose(&Output);
+		BenchOutputReport(szName, Output.Records, Output.Bytes, BenchGetTime() - Start);
+	}
+}
@@ -0,0 +1,110 @@
+/// @file    bench_pmc.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "bench.h"
+#include "pmc.h"
+
+/// Size of the array walked by the regions and number of walks
+#define BENCH_PMC_SIZE  (32 * 1024 * 1024)
+#define BENCH_PMC_WALKS 8
+
+static VOID BenchPmcPrint(
+	_In_opt_ PVOID             Context,
+	_In_     LPCSTR            szRegion,
+	_In_     const PMC_TOTALS* pDelta
+) {
+	const PMC_SESSION* pSession = (const PMC_SESSION*)Context;
+	printf("    - region %-16s %llu calls", szRegion, (unsigned long long)pDelta->Calls);
+	if (pDelta->Values[PMC_EVENT_CYCLES] != 0x00 && (pSession->Events & PMC_EVENT_BIT(PMC_EVENT_INSTRUCTIONS))) {
+		printf(", IPC %.2f", (double)pDelta->Values[PMC_EVENT_INSTRUCTIONS] / (double)pDelta->Values[PMC_EVENT_CYCLES]);
+	}
+	if (pSession->Events & PMC_EVENT_BIT(PMC_EVENT_LLC_MISSES)) {
+		printf(", %llu LLC misses per call", (unsigned long long)(pDelta->Values[PMC_EVENT_LLC_MISSES] / pDelta->Calls));
+	}
+	if (pDelta->Running < pDelta->Enabled) {
+		printf(", multiplexed: counted %.1f%% of the time", pDelta->Enabled != 0x00 ? 100.0 * (double)pDelta->Running / (double)pDelta->Enabled : 0.0);
+	}
+	printf("\n");
+}
+
+/// <summary>
+/// Sum an array in order or with a stride defeating the prefetchers.
+/// </summary>
+static UINT64 BenchPmcWalk(
+	_In_ const UINT32* pArray,
+	_In_ UINT32        uiStride
+) {
+	UINT64 Sum = 0x00;
+	UINT32 Count = BENCH_PMC_SIZE / sizeof(UINT32);
+	for (UINT32 Start = 0x00; Start < uiStride; Start++) {
+		for (UINT32 Index = Start; Index < Count; Index += uiStride)
+			Sum += pArray[Index];
+	}
+	return Sum;
+}
+
+VOID BenchPmc() {
+	// 1. Get the architectural performance monitoring of the processor
+	CPUID_BACKEND Backend = { 0x00 };
+	PMC_SESSION Session = { 0x00 };
+	if (!CpuidOpen(&Backend)) {
+		printf("    - Unable to open the CPUID backend.\n");
+		return;
+	}
+	UINT32 Events = PMC_EVENT_BIT(PMC_EVENT_CYCLES) | PMC_EVENT_BIT(PMC_EVENT_INSTRUCTIONS) | PMC_EVENT_BIT(PMC_EVENT_LLC_MISSES);
+	BOOL bSession = PmcSessionCreate(&Session, &Backend, Events, 0x00, BenchPmcPrint, &Session);
+	CpuidClose(&Backend);
+	if (!bSession) {
+		printf("    - Unable to create the session.\n");
+		return;
+	}
+	const PMC_CAPABILITIES* pCapabilities = &Session.Capabilities;
+	printf("    - Architectural PMU version %u: %u counters of %u bits, %u fixed counters of %u bits\n", pCapabilities->Version,
+		pCapabilities->Counters, pCapabilities->CounterWidth, pCapabilities->FixedCounters, pCapabilities->FixedCounterWidth);
+	for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++) {
+		if (pCapabilities->Version != 0x00 && (pCapabilities->Unavailable & PMC_EVENT_BIT(Event)))
+			printf("    - Event %s not available\n", PmcGetEventName(Event));
+	}
+
+	// 2. Open the counters of this thread
+	PMC_THREAD Thread = { 0x00 };
+	if (!PmcThreadAttach(&Session, &Thread)) {
+		printf("    - No performance counter available to this thread.\n");
+		PmcSessionDestroy(&Session);
+		return;
+	}
+	printf("    - User-mode RDPMC %s\n", Thread.bRdpmc ? "enabled" : "disabled, reads fall back to the kernel");
+
+	// 3. Cost of a read of every counter
+	PMC_SAMPLE Sample = { 0x00 };
+	BENCH_RUN("RDPMC via perf mmap page", BENCH_ITERATIONS_FAST, PmcRead(&Thread, &Sample));
+	BENCH_RUN("perf read syscall", BENCH_ITERATIONS_SLOW, PmcReadSyscall(&Thread, &Sample));
+
+	// 4. Two regions with very different memory behaviours
+	PUINT32 pArray = (PUINT32)calloc(BENCH_PMC_SIZE / sizeof(UINT32), sizeof(UINT32));
+	if (pArray != NULL) {
+		UINT32 Sequential = PmcRegionRegister(&Session, "sequential");
+		UINT32 Strided = PmcRegionRegister(&Session, "strided");
+		UINT64 Sum = 0x00;
+		for (UINT32 Walk = 0x00; Walk < BENCH_PMC_WALKS; Walk++) {
+			PMC_SAMPLE Start = { 0x00 };
+			PmcRegionEnter(&Thread, &Start);
+			Sum += BenchPmcWalk(pArray, 0x01);
+			PmcRegionLeave(&Thread, Sequential, &Start);
+
+			PmcRegionEnter(&Thread, &Start);
+			Sum += BenchPmcWalk(pArray, 4099);
+			PmcRegionLeave(&Thread, Strided, &Start);
+		}
+		PmcFlush(&Session);
+		free(pArray);
+		if (Sum != 0x00)
+			printf("    - Unexpected sum\n");
+	}
+	PmcSessionDestroy(&Session);
+}
@@ -0,0 +1,118 @@
+/// @file    bench_pool.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "bench.h"
+#include "pool.h"
+
+/// Size of a tile, about the size of a L2 cache, number of tiles per worker and passes over each tile
+#define BENCH_POOL_TILE_SIZE   (512 * 1024)
+#define BENCH_POOL_TILES       4
+#define BENCH_POOL_PASSES      64
+
+/// <summary>
+/// Tile of the cache-sensitive workload. Each pass over the tile respawns the next one, which stays hot
+/// in the caches of the worker unless it is stolen.
+/// </summary>
+typedef struct _BENCH_POOL_TILE {
+	POOL_TASK Task;
+	PUINT64   Data;
+	UINT32    Pass;
+	UINT64    Checksum;
+} BENCH_POOL_TILE, * PBENCH_POOL_TILE;
+
+static VOID BenchPoolPass(
+	_In_ PPOOL_WORKER Worker,
+	_In_ PPOOL_TASK   Task
+) {
+	PBENCH_POOL_TILE Tile = (PBENCH_POOL_TILE)Task->Parameter;
+
+	// Read and write every line of the tile
+	UINT64 Sum = 0x00;
+	for (UINT32 Index = 0x00; Index < BENCH_POOL_TILE_SIZE / sizeof(UINT64); Index += 8) {
+		Tile->Data[Index] += Index ^ Tile->Pass;
+		Sum += Tile->Data[Index];
+	}
+	Tile->Checksum += Sum;
+
+	if (++Tile->Pass < BENCH_POOL_PASSES)
+		PoolSpawn(Worker, Task);
+}
+
+/// <summary>
+/// Run the workload on a pool and print the time per pass and where the stolen tasks came from.
+/// </summary>
+static VOID BenchPoolRun(
+	_In_     LPCSTR           szName,
+	_In_opt_ const TOPOLOGY*  pTopology,
+	_In_     PBENCH_POOL_TILE Tiles,
+	_In_     UINT32           uiTiles
+) {
+	POOL Pool = { 0x00 };
+	if (!PoolCreate(&Pool, pTopology, 0x00)) {
+		printf("    - Unable to start the %s pool.\n", szName);
+		return;
+	}
+
+	// 1. Submit every tile from outside the pool, the workers spread them by stealing
+	UINT64 Start = BenchGetTime();
+	for (UINT32 Index = 0x00; Index < uiTiles; Index++) {
+		Tiles[Index].Pass = 0x00;
+		Tiles[Index].Task.Routine = BenchPoolPass;
+		Tiles[Index].Task.Parameter = &Tiles[Index];
+		PoolSubmit(&Pool, &Tiles[Index].Task);
+	}
+	PoolWait(&Pool);
+	UINT64 Elapsed = BenchGetTime() - Start;
+
+	// 2. Report
+	UINT64 Steals[POOL_DISTANCE_COUNT] = { 0x00 };
+	for (UINT32 Index = 0x00; Index < Pool.WorkerCount; Index++) {
+		for (UINT32 Distance = 0x00; Distance < POOL_DISTANCE_COUNT; Distance++)
+			Steals[Distance] += Pool.Workers[Index].Steals[Distance];
+	}
+	BenchReport(szName, (UINT64)uiTiles * BENCH_POOL_PASSES, Elapsed);
+	printf("      steals: %llu same L2, %llu same LLC, %llu same package, %llu remote\n",
+		(unsigned long long)Steals[0], (unsigned long long)Steals[1], (unsigned long long)Steals[2], (unsigned long long)Steals[3]);
+	PoolDestroy(&Pool);
+}
+
+VOID BenchPool() {
+	// 1. Get the cache topology of the machine
+	CPUID_BACKEND Backend = { 0x00 };
+	TOPOLOGY Topology = { 0x00 };
+	if (!CpuidOpen(&Backend) || !TopologyBuild(&Backend, &Topology)) {
+		printf("    - Unable to get the cache topology.\n");
+		CpuidClose(&Backend);
+		return;
+	}
+	CpuidClose(&Backend);
+	printf("    - %u logical processor(s), %u L%u cache(s), %u package(s)\n",
+		Topology.CpuCount, Topology.LlcCount, Topology.LlcLevel, Topology.PackageCount);
+
+	// 2. Allocate the tiles
+	UINT32 uiTiles = Topology.CpuCount * BENCH_POOL_TILES;
+	PBENCH_POOL_TILE Tiles = (PBENCH_POOL_TILE)calloc(uiTiles, sizeof(BENCH_POOL_TILE));
+	UINT32 uiAllocated = 0x00;
+	for (; Tiles != NULL && uiAllocated < uiTiles; uiAllocated++) {
+		Tiles[uiAllocated].Data = (PUINT64)calloc(0x01, BENCH_POOL_TILE_SIZE);
+		if (Tiles[uiAllocated].Data == NULL)
+			break;
+	}
+
+	// 3. Same workload on both pools, twice to leave the first page faults out
+	if (Tiles != NULL && uiAllocated == uiTiles) {
+		BenchPoolRun("flat pool (warm-up)", NULL, Tiles, uiTiles);
+		BenchPoolRun("flat pool, pass over a tile", NULL, Tiles, uiTiles);
+		BenchPoolRun("topology-aware pool, pass over a tile", &Topology, Tiles, uiTiles);
+	}
+
+	for (UINT32 Index = 0x00; Tiles != NULL && Index < uiAllocated; Index++)
+		free(Tiles[Index].Data);
+	free(Tiles);
+	TopologyFree(&Topology);
+}
@@ -0,0 +1,51 @@
+/// @file    bench_segbase.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include "bench.h"
+#include "segbase.h"
+#include "msr.h"
+
+VOID BenchSegBase() {
+	volatile UINT64 Base = 0x00;
+	SegBaseInitialise();
+
+	// 1. Selected path
+	printf("    - FS source: %u, GS source: %u\n", g_SegBaseSource[SEGBASE_FS], g_SegBaseSource[SEGBASE_GS]);
+	if (g_SegBaseSource[SEGBASE_FS] == SegBaseSourceInstruction) {
+		BENCH_RUN("RDFSBASE", BENCH_ITERATIONS_FAST, Base = SegBaseReadFs());
+		BENCH_RUN("RDGSBASE", BENCH_ITERATIONS_FAST, Base = SegBaseReadGs());
+	}
+	else {
+		printf("    - RDFSBASE/RDGSBASE are not enabled by the OS.\n");
+	}
+
+	// 2. OS interface
+#if defined(_WIN32)
+	BENCH_RUN("NtCurrentTeb", BENCH_ITERATIONS_FAST, Base = (UINT64)NtCurrentTeb());
+#else
+	UINT64 Value = 0x00;
+	BENCH_RUN("arch_prctl(ARCH_GET_FS)", BENCH_ITERATIONS_SLOW, syscall(SYS_arch_prctl, 0x1003, &Value));
+#endif
+
+	// 3. MSR path
+	MSR_BACKEND Backend = { 0x00 };
+	if (MsrOpen(&Backend)) {
+		UINT64 Msr = 0x00;
+		BENCH_RUN("IA32_FS_BASE via the MSR backend", BENCH_ITERATIONS_SLOW, (VOID)MsrRead(&Backend, MSR_CURRENT_CPU, IA32_FS_BASE, &Msr));
+		MsrClose(&Backend);
+	}
+	else {
+		printf("    - MSR backend not available.\n");
+	}
+	SegBaseUninitialise();
+	(VOID)Base;
+}
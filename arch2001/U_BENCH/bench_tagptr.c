@@ -0,0 +1,147 @@
+/// @file    bench_tagptr.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "bench.h"
+#include "atomic.h"
+#include "arena.h"
+#include "tagptr.h"
+
+/// Tag bits required by the stack, number of stack operations and nodes of the lists
+#define BENCH_TAGPTR_BITS       8
+#define BENCH_TAGPTR_OPERATIONS (16 * 1024 * 1024)
+#define BENCH_TAGPTR_NODES      (4 * 1024 * 1024)
+
+/// <summary>
+/// Node of a lock-free stack whose head carries an ABA counter.
+/// </summary>
+typedef struct _BENCH_STACK_NODE {
+	struct _BENCH_STACK_NODE* Next;
+} BENCH_STACK_NODE, * PBENCH_STACK_NODE;
+TAGPTR_DEFINE(BENCH_STACK_HEAD, BENCH_STACK_NODE)
+
+/// <summary>
+/// Nodes of the same list with full and compressed links.
+/// </summary>
+typedef struct _BENCH_LIST_NODE {
+	struct _BENCH_LIST_NODE* Next;
+	UINT64                   Value;
+} BENCH_LIST_NODE, * PBENCH_LIST_NODE;
+
+typedef struct _BENCH_LIST_NODE32 BENCH_LIST_NODE32;
+COMPPTR_DEFINE(BENCH_LIST_LINK, BENCH_LIST_NODE32)
+struct _BENCH_LIST_NODE32 {
+	BENCH_LIST_LINK Next;
+	UINT32          Value;
+};
+
+static VOID BenchTagPtrPush(
+	_Inout_ volatile INT64*   pHead,
+	_In_    PBENCH_STACK_NODE Node
+) {
+	BENCH_STACK_HEAD Head = { 0x00 };
+	do {
+		Head.Value = (TAGPTR)AtomicLoad64(pHead);
+		Node->Next = BENCH_STACK_HEADGet(Head);
+	} while (!AtomicCompareExchange64(pHead, (INT64)Head.Value, (INT64)BENCH_STACK_HEADNext(Head, Node).Value));
+}
+
+static PBENCH_STACK_NODE BenchTagPtrPop(
+	_Inout_ volatile INT64* pHead
+) {
+	BENCH_STACK_HEAD Head = { 0x00 };
+	PBENCH_STACK_NODE Node = NULL;
+	do {
+		Head.Value = (TAGPTR)AtomicLoad64(pHead);
+		Node = BENCH_STACK_HEADGet(Head);
+		if (Node == NULL)
+			return NULL;
+	} while (!AtomicCompareExchange64(pHead, (INT64)Head.Value, (INT64)BENCH_STACK_HEADNext(Head, Node->Next).Value));
+	return Node;
+}
+
+/// <summary>
+/// Shuffle the order in which the nodes of a list are linked.
+/// </summary>
+static VOID BenchTagPtrShuffle(
+	_Out_ PUINT32 Order,
+	_In_  UINT32  uiCount
+) {
+	for (UINT32 Index = 0x00; Index < uiCount; Index++)
+		Order[Index] = Index;
+	UINT64 State = 0x9E3779B97F4A7C15ULL;
+	for (UINT32 Index = uiCount - 1; Index > 0; Index--) {
+		State ^= State << 13;
+		State ^= State >> 7;
+		State ^= State << 17;
+		UINT32 Other = (UINT32)(State % (Index + 1));
+		UINT32 Swap = Order[Index];
+		Order[Index] = Order[Other];
+		Order[Other] = Swap;
+	}
+}
+
+VOID BenchTagPtr() {
+	// 1. Get the tag budget of the host
+	if (!TagPtrInitialise(NULL, BENCH_TAGPTR_BITS)) {
+		printf("    - Only %u free pointer bits, %u required.\n", g_TagPtrLayout.TagBits, BENCH_TAGPTR_BITS);
+		return;
+	}
+	printf("    - Linear address %u bits (LA57 %s), physical address %u bits\n", g_TagPtrLayout.LinearBits,
+		g_TagPtrLayout.La57 ? "yes" : "no", g_TagPtrLayout.PhysicalBits);
+	printf("    - User-mode pointers %u bits, %u bits free for tags\n", g_TagPtrLayout.AddressBits, g_TagPtrLayout.TagBits);
+
+	// 2. Cost of a push and pop on an uncontended tagged stack
+	static BENCH_STACK_NODE Nodes[0x40];
+	volatile INT64 Head = 0x00;
+	for (UINT32 Index = 0x00; Index < ARRAYSIZE(Nodes); Index++)
+		BenchTagPtrPush(&Head, &Nodes[Index]);
+	BENCH_RUN("tagged stack pop + push", BENCH_TAGPTR_OPERATIONS, BenchTagPtrPush(&Head, BenchTagPtrPop(&Head)));
+	printf("    - ABA counter after the run: %llu\n", (unsigned long long)TagPtrGetTag((TAGPTR)Head));
+
+	// 3. Same random list with 64-bit and 32-bit links
+	CPUID_BACKEND Backend = { 0x00 };
+	ARENA_SUPPORT Support = { 0x00 };
+	BOOL bSupport = CpuidOpen(&Backend) && ArenaQuerySupport(&Backend, &Support);
+	CpuidClose(&Backend);
+	ARENA Arena = { 0x00 };
+	SIZE_T Size = (SIZE_T)BENCH_TAGPTR_NODES * (sizeof(BENCH_LIST_NODE) + sizeof(BENCH_LIST_NODE32) + sizeof(UINT32));
+	if (!bSupport || !ArenaCreate(&Arena, &Support, Size, ARENA_PAGE_4K)) {
+		printf("    - Unable to create the arena.\n");
+		return;
+	}
+	PUINT32 Order = (PUINT32)ArenaAlloc(&Arena, BENCH_TAGPTR_NODES * sizeof(UINT32), sizeof(UINT32));
+	PBENCH_LIST_NODE List64 = (PBENCH_LIST_NODE)ArenaAlloc(&Arena, BENCH_TAGPTR_NODES * sizeof(BENCH_LIST_NODE), sizeof(BENCH_LIST_NODE));
+	BENCH_LIST_NODE32* List32 = (BENCH_LIST_NODE32*)ArenaAlloc(&Arena, BENCH_TAGPTR_NODES * sizeof(BENCH_LIST_NODE32), sizeof(BENCH_LIST_NODE32));
+	COMPPTR_REGION Region = { 0x00 };
+	if (Order == NULL || List64 == NULL || List32 == NULL
+		|| !CompPtrRegionInitialise(&Region, List32, BENCH_TAGPTR_NODES * sizeof(BENCH_LIST_NODE32), sizeof(BENCH_LIST_NODE32))) {
+		printf("    - Unable to compress the list.\n");
+		ArenaDestroy(&Arena);
+		return;
+	}
+	BenchTagPtrShuffle(Order, BENCH_TAGPTR_NODES);
+	for (UINT32 Index = 0x00; Index < BENCH_TAGPTR_NODES; Index++) {
+		UINT32 Next = Order[(Index + 1) % BENCH_TAGPTR_NODES];
+		List64[Order[Index]].Next = &List64[Next];
+		List64[Order[Index]].Value = Index;
+		List32[Order[Index]].Next = BENCH_LIST_LINKCompress(&Region, &List32[Next]);
+		List32[Order[Index]].Value = Index;
+	}
+
+	UINT64 Sum64 = 0x00;
+	UINT64 Sum32 = 0x00;
+	PBENCH_LIST_NODE Node64 = &List64[Order[0x00]];
+	BENCH_LIST_NODE32* Node32 = &List32[Order[0x00]];
+	printf("    - List of %u nodes: %llu MiB with 64-bit links, %llu MiB with 32-bit links\n", BENCH_TAGPTR_NODES,
+		(unsigned long long)((BENCH_TAGPTR_NODES * sizeof(BENCH_LIST_NODE)) >> 20),
+		(unsigned long long)((BENCH_TAGPTR_NODES * sizeof(BENCH_LIST_NODE32)) >> 20));
+	BENCH_RUN("random list walk, 64-bit links", BENCH_TAGPTR_NODES, Sum64 += Node64->Value; Node64 = Node64->Next);
+	BENCH_RUN("random list walk, 32-bit links", BENCH_TAGPTR_NODES, Sum32 += Node32->Value; Node32 = BENCH_LIST_LINKDecompress(&Region, Node32->Next));
+	if (Sum64 != Sum32)
+		printf("    - Checksums differ: %llu versus %llu\n", (unsigned long long)Sum64, (unsigned long long)Sum32);
+	ArenaDestroy(&Arena);
+}
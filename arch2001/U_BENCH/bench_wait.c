@@ -0,0 +1,189 @@
+/// @file    bench_wait.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "bench.h"
+#include "atomic.h"
+#include "thread.h"
+#include "wait.h"
+
+/// Number of round trips and of lock acquisitions per thread
+#define BENCH_WAIT_ROUND_TRIPS 100000
+#define BENCH_WAIT_LOCKS       200000
+
+/// Spin budget meaning never park
+#define BENCH_WAIT_FOREVER (~0ULL >> 1)
+
+/// <summary>
+/// Values written by each side of the ping-pong, on their own cache line.
+/// </summary>
+typedef struct _BENCH_WAIT_SHARED {
+	DECLSPEC_ALIGN(64) volatile INT32 Ping;
+	DECLSPEC_ALIGN(64) volatile INT32 Pong;
+	DECLSPEC_ALIGN(64) WAIT_LOCK      Lock;
+	UINT64                            Counter;
+	UINT64                            Ticks;
+	UINT32                            Cpu;
+	WAIT_STATISTICS                   Statistics;
+} BENCH_WAIT_SHARED, * PBENCH_WAIT_SHARED;
+
+/// <summary>
+/// Thread taking the lock of the shared structure.
+/// </summary>
+typedef struct _BENCH_WAIT_CONTENDER {
+	THREAD             Thread;
+	PBENCH_WAIT_SHARED Shared;
+	UINT32             Cpu;
+} BENCH_WAIT_CONTENDER, * PBENCH_WAIT_CONTENDER;
+
+/// <summary>
+/// Method of a run and whether the waiters may park.
+/// </summary>
+typedef struct _BENCH_WAIT_RUN {
+	LPCSTR      Name;
+	WAIT_METHOD Method;
+	BOOL        bForever;
+} BENCH_WAIT_RUN, * PBENCH_WAIT_RUN;
+
+static const BENCH_WAIT_RUN g_BenchWaitRuns[] = {
+	{ "plain PAUSE loop", WaitMethodPause, TRUE },
+	{ "UMWAIT", WaitMethodUmwait, FALSE },
+	{ "MWAITX", WaitMethodMwaitx, FALSE },
+	{ "PAUSE backoff then park", WaitMethodPause, FALSE },
+	{ "park", WaitMethodPark, FALSE }
+};
+
+static VOID BenchWaitPong(
+	_In_ PVOID Parameter
+) {
+	PBENCH_WAIT_SHARED Shared = (PBENCH_WAIT_SHARED)Parameter;
+	(VOID)ThreadPin(Shared->Cpu, NULL);
+	for (INT32 Index = 0x01; Index <= BENCH_WAIT_ROUND_TRIPS; Index++) {
+		WaitForChange(&Shared->Ping, Index - 1, Shared->Ticks, &Shared->Statistics);
+		AtomicStore32(&Shared->Pong, Index);
+		if (Shared->Ticks != BENCH_WAIT_FOREVER)
+			WaitWake(&Shared->Pong, FALSE);
+	}
+}
+
+static VOID BenchWaitContend(
+	_In_ PVOID Parameter
+) {
+	PBENCH_WAIT_CONTENDER Contender = (PBENCH_WAIT_CONTENDER)Parameter;
+	PBENCH_WAIT_SHARED Shared = Contender->Shared;
+	(VOID)ThreadPin(Contender->Cpu, NULL);
+	for (UINT32 Index = 0x00; Index < BENCH_WAIT_LOCKS; Index++) {
+		WaitLockAcquire(&Shared->Lock);
+		Shared->Counter++;
+		WaitLockRelease(&Shared->Lock);
+	}
+}
+
+/// <summary>
+/// Hand a value back and forth between two threads and print the one-way latency and where the waiter spent its time.
+/// </summary>
+static VOID BenchWaitPingPong(
+	_In_ const BENCH_WAIT_RUN* pRun,
+	_In_ UINT32                uiCpus
+) {
+	static BENCH_WAIT_SHARED Shared;
+	RtlZeroMemory(&Shared, sizeof(Shared));
+	Shared.Ticks = pRun->bForever ? BENCH_WAIT_FOREVER : WAIT_SPIN_TICKS;
+	Shared.Cpu = uiCpus > 0x01 ? 0x01 : 0x00;
+
+	THREAD Thread = { 0x00 };
+	THREAD_AFFINITY Previous = { 0x00 };
+	BOOL bPinned = ThreadPin(0x00, &Previous);
+	if (!ThreadCreate(&Thread, BenchWaitPong, &Shared)) {
+		printf("    - Unable to start the waiter.\n");
+		if (bPinned)
+			ThreadRestore(&Previous);
+		return;
+	}
+
+	CHAR szName[0x80] = { 0x00 };
+	snprintf(szName, sizeof(szName), "wake-up, %s", pRun->Name);
+	WAIT_STATISTICS Statistics = { 0x00 };
+	UINT64 Start = BenchGetTime();
+	for (INT32 Index = 0x01; Index <= BENCH_WAIT_ROUND_TRIPS; Index++) {
+		AtomicStore32(&Shared.Ping, Index);
+		if (Shared.Ticks != BENCH_WAIT_FOREVER)
+			WaitWake(&Shared.Ping, FALSE);
+		WaitForChange(&Shared.Pong, Index - 1, Shared.Ticks, &Statistics);
+	}
+	UINT64 Elapsed = BenchGetTime() - Start;
+	ThreadJoin(&Thread);
+	if (bPinned)
+		ThreadRestore(&Previous);
+
+	BenchReport(szName, BENCH_WAIT_ROUND_TRIPS * 2ULL, Elapsed);
+	UINT64 Total = Shared.Statistics.SleepTicks + Shared.Statistics.SpinTicks;
+	printf("      waiter: %5.1f%% of the spin time in an optimised state, %llu of %llu waits parked\n",
+		Total == 0x00 ? 0.0 : 100.0 * (double)Shared.Statistics.SleepTicks / (double)Total,
+		(unsigned long long)Shared.Statistics.Parks, (unsigned long long)Shared.Statistics.Waits);
+}
+
+/// <summary>
+/// Increment a counter under a lock from two threads.
+/// </summary>
+static VOID BenchWaitLock(
+	_In_ const BENCH_WAIT_RUN* pRun,
+	_In_ UINT32                uiCpus
+) {
+	static BENCH_WAIT_SHARED Shared;
+	RtlZeroMemory(&Shared, sizeof(Shared));
+
+	BENCH_WAIT_CONTENDER Contenders[2] = { 0x00 };
+	UINT32 uiStarted = 0x00;
+	UINT64 Start = BenchGetTime();
+	for (; uiStarted < ARRAYSIZE(Contenders); uiStarted++) {
+		Contenders[uiStarted].Shared = &Shared;
+		Contenders[uiStarted].Cpu = uiCpus > uiStarted ? uiStarted : 0x00;
+		if (!ThreadCreate(&Contenders[uiStarted].Thread, BenchWaitContend, &Contenders[uiStarted]))
+			break;
+	}
+	for (UINT32 Index = 0x00; Index < uiStarted; Index++)
+		ThreadJoin(&Contenders[Index].Thread);
+	UINT64 Elapsed = BenchGetTime() - Start;
+	if (Shared.Counter != (UINT64)BENCH_WAIT_LOCKS * uiStarted)
+		printf("    - Lost updates: %llu instead of %llu\n", (unsigned long long)Shared.Counter, (unsigned long long)BENCH_WAIT_LOCKS * uiStarted);
+
+	CHAR szName[0x80] = { 0x00 };
+	snprintf(szName, sizeof(szName), "contended lock, %s", pRun->Name);
+	BenchReport(szName, (UINT64)BENCH_WAIT_LOCKS * uiStarted, Elapsed);
+}
+
+VOID BenchWait() {
+	// 1. Get the wait instructions and the limits of the OS
+	WAIT_METHOD Selected = WaitInitialise(NULL);
+	static const LPCSTR Names[] = { "none", "UMWAIT", "MWAITX", "PAUSE", "park" };
+	printf("    - WAITPKG %s, MONITORX %s, MONITOR %s (ring 0 only), monitor line %u-%u bytes\n",
+		g_WaitCapabilities.bWaitpkg ? "yes" : "no", g_WaitCapabilities.bMonitorx ? "yes" : "no",
+		g_WaitCapabilities.bMonitor ? "yes" : "no", g_WaitCapabilities.LineMin, g_WaitCapabilities.LineMax);
+	if (g_WaitCapabilities.bControl) {
+		printf("    - IA32_UMWAIT_CONTROL: C0.2 %s, maximum time %u ticks\n", g_WaitCapabilities.bC02 ? "allowed" : "disabled",
+			g_WaitCapabilities.MaxTicks);
+	}
+	printf("    - Method selected: %s\n", Names[Selected]);
+
+	// 2. Plain PAUSE loops never give the processor back, which only makes sense with a processor per thread
+	UINT32 uiCpus = ThreadGetCpuCount();
+	if (uiCpus < 0x02)
+		printf("    - Single processor: the plain PAUSE loop is skipped.\n");
+	for (SIZE_T Index = 0x00; Index < ARRAYSIZE(g_BenchWaitRuns); Index++) {
+		if ((g_BenchWaitRuns[Index].bForever && uiCpus < 0x02) || !WaitSetMethod(g_BenchWaitRuns[Index].Method))
+			continue;
+		BenchWaitPingPong(&g_BenchWaitRuns[Index], uiCpus);
+	}
+
+	// 3. Spin-then-park lock with each method
+	for (SIZE_T Index = 0x00; Index < ARRAYSIZE(g_BenchWaitRuns); Index++) {
+		if (g_BenchWaitRuns[Index].bForever || !WaitSetMethod(g_BenchWaitRuns[Index].Method))
+			continue;
+		BenchWaitLock(&g_BenchWaitRuns[Index], uiCpus);
+	}
+	(VOID)WaitSetMethod(Selected);
+}
@@ -0,0 +1,63 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+/// <summary>
+/// List of the benchmarks that can be executed.
+/// </summary>
+static const BENCH_ENTRY g_Benchmarks[] = {
+	{ "dtr", "Descriptor table registers: user mode instructions versus kernel round trip", BenchDtr },
+	{ "segbase", "FS/GS base address: RDFSBASE/RDGSBASE versus OS interface and MSR backend", BenchSegBase },
+	{ "cpunum", "Current processor: RDPID/RDTSCP/rseq versus OS, and per-CPU counters versus a shared atomic", BenchCpuNum },
+	{ "intrin", "Inline intrinsics versus out-of-line procedures: segment registers and CPUID", BenchIntrin },
+	{ "collector", "Collector socket: round trip latency and load with many concurrent clients", BenchCollector },
+	{ "pool", "Work-stealing pool: flat versus cache-topology-aware stealing on a cache-sensitive workload", BenchPool },
+	{ "arena", "Huge-page arena: dependent random loads on regular pages versus the largest pages available", BenchArena },
+	{ "tagptr", "Tagged and compressed pointers: ABA-tagged stack and list walk with 64-bit versus 32-bit links", BenchTagPtr },
+	{ "wait", "Wait primitives: wake-up latency and spin time of UMWAIT/MWAITX versus PAUSE loops and OS parking", BenchWait },
+	{ "pmc", "Performance counters: RDPMC through the perf mmap page versus the read syscall, and region profiling", BenchPmc },
+	{ "hypervisor", "Virtualization cost: RDTSC, RDTSCP, CPUID and RDMSR versus the cost of an exit to the hypervisor", BenchHypervisor },
+	{ "mitigation", "Speculative execution mitigations: system call, indirect calls and thread switch, keyed by processor and microcode", BenchMitigation },
+	{ "output", "Output layer: decoded records through the text, JSON Lines, CSV and binary sinks versus snprintf", BenchOutput }
+};
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Name of the benchmarks to run. All of them are executed if none is provided.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	BOOL bFound = FALSE;
+
+	for (SIZE_T Index = 0x00; Index < ARRAYSIZE(g_Benchmarks); Index++) {
+		// 1. Check whether the benchmark has been requested
+		BOOL bRequested = argc < 2;
+		for (INT Argument = 1; Argument < argc && !bRequested; Argument++)
+			bRequested = strcmp(argv[Argument], g_Benchmarks[Index].Name) == 0x00;
+		if (!bRequested)
+			continue;
+
+		// 2. Run it
+		printf("[*] %s: %s\n", g_Benchmarks[Index].Name, g_Benchmarks[Index].Description);
+		g_Benchmarks[Index].Routine();
+		printf("\n");
+		bFound = TRUE;
+	}
+
+	if (!bFound) {
+		printf("Usage: %s [", argv[0]);
+		for (SIZE_T Index = 0x00; Index < ARRAYSIZE(g_Benchmarks); Index++)
+			printf("%s%s", Index == 0x00 ? "" : "|", g_Benchmarks[Index].Name);
+		printf("]...\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
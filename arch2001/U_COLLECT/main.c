@@ -0,0 +1,134 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "collector.h"
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// <summary>
+/// Collector stopped by Ctrl+C.
+/// </summary>
+static PCOLLECTOR_SERVER g_Server = NULL;
+
+#if defined(_WIN32)
+static BOOL WINAPI CollectStopHandler(DWORD dwCtrlType) {
+	(VOID)dwCtrlType;
+	CollectorServerStop(g_Server);
+	return TRUE;
+}
+#else
+static void CollectStopHandler(int Signal) {
+	(VOID)Signal;
+	CollectorServerStop(g_Server);
+}
+#endif
+
+/// <summary>
+/// Run the collector until Ctrl+C is pressed.
+/// </summary>
+/// <param name="szPath">Path of the socket.</param>
+/// <param name="uiRefresh">Interval between two refreshes of the MSRs in milliseconds.</param>
+/// <returns>Process exit status code.</returns>
+static INT CollectServe(
+	_In_ LPCSTR szPath,
+	_In_ UINT32 uiRefresh
+) {
+	static COLLECTOR_SERVER Server;
+	if (!CollectorServerStart(&Server, szPath, uiRefresh)) {
+		printf("Unable to start the collector on %s.\n", szPath);
+		return EXIT_FAILURE;
+	}
+	printf("[*] Collecting %u processor(s) on %s, MSRs refreshed every %u ms (backend: %s).\n",
+		Server.Info.CpuCount, szPath, uiRefresh, Server.Context.bMsr ? Server.Context.Msr.Name : "none");
+
+	g_Server = &Server;
+#if defined(_WIN32)
+	SetConsoleCtrlHandler(CollectStopHandler, TRUE);
+#else
+	signal(SIGINT, CollectStopHandler);
+	signal(SIGTERM, CollectStopHandler);
+#endif
+
+	CollectorServerRun(&Server);
+	CollectorServerClose(&Server);
+	printf("[*] Collector stopped.\n");
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Query a collector and print the record of a processor.
+/// </summary>
+/// <param name="szPath">Path of the socket.</param>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <returns>Process exit status code.</returns>
+static INT CollectQuery(
+	_In_ LPCSTR szPath,
+	_In_ UINT32 uiCpu
+) {
+	COLLECTOR_CLIENT Client = { 0x00 };
+	if (!CollectorConnect(szPath, &Client)) {
+		printf("Unable to connect to the collector on %s.\n", szPath);
+		return EXIT_FAILURE;
+	}
+
+	// 1. General information
+	COLLECTOR_INFO Info = { 0x00 };
+	UINT8 Status = CollectorQuery(&Client, COLLECTOR_QUERY_INFO, 0x00, &Info, sizeof(Info), NULL);
+	if (Status != COLLECTOR_STATUS_SUCCESS) {
+		printf("Query failed with status %u.\n", Status);
+		CollectorDisconnect(&Client);
+		return EXIT_FAILURE;
+	}
+	printf("[*] %u processor(s), refreshed every %u ms, generation %llu\n",
+		Info.CpuCount, Info.RefreshInterval, (unsigned long long)Info.Generation);
+
+	// 2. Record of the processor
+	SNAPSHOT_RECORD Record = { 0x00 };
+	Status = CollectorQuery(&Client, COLLECTOR_QUERY_SNAPSHOT, uiCpu, &Record, sizeof(Record), NULL);
+	if (Status == COLLECTOR_STATUS_SUCCESS) {
+		printf("[*] Processor %u captured at %llu ns, valid 0x%08x\n", Record.Cpu, (unsigned long long)Record.Timestamp, Record.Valid);
+		printf("    - CS=0x%02x SS=0x%02x GDTR=0x%016llx IDTR=0x%016llx\n",
+			Record.Selectors[SELECTOR_CS], Record.Selectors[SELECTOR_SS], (unsigned long long)Record.GdtBase, (unsigned long long)Record.IdtBase);
+		if (Record.Valid & SNAPSHOT_VALID_SYSCALL)
+			printf("    - IA32_LSTAR=0x%016llx\n", (unsigned long long)Record.Lstar);
+	}
+	else {
+		printf("Query failed with status %u.\n", Status);
+	}
+
+	CollectorDisconnect(&Client);
+	return Status == COLLECTOR_STATUS_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command, either serve or query, followed by its optional arguments.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	CHAR szDefault[108] = { 0x00 };
+	LPCSTR szPath = argc > 2 ? argv[2] : szDefault;
+	if (argc <= 2 && !CollectorGetDefaultPath(szDefault, sizeof(szDefault))) {
+		printf("The default path of the socket is too long, pass one.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "serve") == 0x00)
+		return CollectServe(szPath, argc > 3 ? (UINT32)strtoul(argv[3], NULL, 10) : COLLECTOR_DEFAULT_REFRESH);
+	if (argc >= 2 && strcmp(argv[1], "query") == 0x00)
+		return CollectQuery(szPath, argc > 3 ? (UINT32)strtoul(argv[3], NULL, 10) : 0x00);
+
+	printf("Usage: %s serve [socket] [refresh ms]\n", argv[0]);
+	printf("       %s query [socket] [processor]\n", argv[0]);
+	printf("The socket defaults to ost-collector.sock in XDG_RUNTIME_DIR, or to %s without it.\n", COLLECTOR_DEFAULT_PATH);
+	return EXIT_FAILURE;
+}
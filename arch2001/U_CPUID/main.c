@@ -2,157 +2,108 @@
 /// @author  Paul L. (@am0nsec)
 /// @version 1.0
 /// @link    https://github.com/am0nsec/ost
-/// @brief   Windows specific code for the OpenSecurityTraining2 Architecture 2001 class
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
 ///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
 /// 
-#include <Windows.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "cpuid.h"
+#include "hybrid.h"
+#include "hypervisor.h"
 
 #define SUCCESS(x) (x != 0x00)
 #define FAILED(x) !(x != 0x00)
 
-typedef union _BasicInformationEcx {
-	struct {
-		UINT SSE3 : 1;
-		UINT PCLMULQDQ : 1;
-		UINT ReserveF : 1;
-		UINT MONITOR : 1;
-		UINT ReserveE : 1;
-		UINT ReserveD : 1;
-		UINT ReserveC : 1;
-		UINT ReserveB : 1;
-		UINT SSSE3 : 1;
-		UINT ReserveA : 1;
-		UINT Reserve9 : 1;
-		UINT FMA : 1;
-		UINT CMPXCHG16B : 1;
-		UINT Reserve8 : 1;
-		UINT Reserve7 : 1;
-		UINT Reserve6 : 1;
-		UINT Reserve5 : 1;
-		UINT Reserve4 : 1;
-		UINT SSE41 : 1;
-		UINT SSE42 : 1;
-		UINT Reserved3 : 1;
-		UINT Reserved2 : 1;
-		UINT POPCNT : 1;
-		UINT Reserved1 : 1;
-		UINT AES : 1;
-		UINT XSAVE : 1;
-		UINT OSXSAVE : 1;
-		UINT AVX : 1;
-		UINT F16C : 1;
-		UINT Reserved0 : 1;
-		UINT RAZ : 1;
-	} elem;
-	UINT value;
-} BasicInformationEcx, * PBasicInformationEcx;
-
-typedef union _BasicInformationEdx {
-	struct {
-		UINT FPU : 1;
-		UINT VME : 1;
-		UINT DE : 1;
-		UINT PSE : 1;
-		UINT TSC : 1;
-		UINT MSR : 1;
-		UINT PAE : 1;
-		UINT MCE : 1;
-		UINT CMPXCHG8B : 1;
-		UINT APIC : 1;
-		UINT Reserve9 : 1;
-		UINT SysEnterSysExit : 1;
-		UINT MTRR : 1;
-		UINT PGE : 1;
-		UINT MCA : 1;
-		UINT CMOV : 1;
-		UINT PAT : 1;
-		UINT PSE36 : 1;
-		UINT Reserve8 : 1;
-		UINT CLFSH : 1;
-		UINT Reserve7 : 1;
-		UINT Reserve6 : 1;
-		UINT Reserve5 : 1;
-		UINT MMX : 1;
-		UINT FXSR : 1;
-		UINT SSE : 1;
-		UINT SSE2 : 1;
-		UINT HTT : 1;
-		UINT Reserve4 : 1;
-		UINT Reserve3 : 1;
-		UINT Reserve2 : 1;
-		UINT Reserve1 : 1;
-	} elem;
-	UINT value;
-} BasicInformationEdx, * PBasicInformationEdx;
-
-typedef union _StructuredExtendedFeatureEbx {
-	struct {
-		UINT FSGSBASE : 1;
-		UINT IA32_TSC_ADJUST : 1;
-		UINT SGX : 1;
-		UINT BMI1 : 1;
-		UINT HLE : 1;
-		UINT AVX2 : 1;
-		UINT FDP_EXCPTN_ONLY : 1;
-		UINT SMEP : 1;
-		UINT BMI2 : 1;
-		UINT EnhancedREP : 1;
-		UINT INVPCID : 1;
-		UINT RTM : 1;
-		UINT RDTM : 1;
-		UINT DeprecatesFPUCS : 1;
-		UINT MPX : 1;
-		UINT RDTA : 1;
-		UINT AVX512F : 1;
-		UINT AVX512DQ : 1;
-		UINT RDSEED : 1;
-		UINT ADX : 1;
-		UINT SMAP : 1;
-		UINT AVX512_IFMA : 1;
-		UINT Reserved0 : 1;
-		UINT CLFLUSHOPT : 1;
-		UINT CLWB : 1;
-		UINT IntelProcessorTrace : 1;
-		UINT AVX512PF : 1;
-		UINT AVX512ER : 1;
-		UINT AVX512CD : 1;
-		UINT SHA : 1;
-		UINT AVX512BW : 1;
-		UINT AVX512VL : 1;
-	} elem;
-	UINT value;
-} StructuredExtendedFeatureEbx, * PStructuredExtendedFeatureEbx;
-
-
 /// <summary>
-/// Check whether CPUID instruction is supported.
+/// Print the core type of every processor and the processors used by each placement.
 /// </summary>
-/// <returns>True if CPUID instruction is supported.</returns>
-_Success_(return != 0x00) _Must_inspect_result_
-EXTERN_C BYTE STDMETHODCALLTYPE IsCPUIDSupported();
+/// <param name="pTopology">Pointer to the topology.</param>
+static VOID PrintHybridTopology(
+	_In_ const HYBRID_TOPOLOGY* pTopology
+) {
+	printf("Hybrid Information Enumeration Leaf:\n");
+	printf("   - Hybrid: processor is identified as a hybrid part (%s)\n", pTopology->Hybrid ? "true" : "false");
+	printf("   - %u performance core(s), %u efficiency core(s), %u logical processor(s)\n",
+		pTopology->PerformanceCount, pTopology->EfficiencyCount, pTopology->CpuCount);
+	for (UINT32 Index = 0x00; pTopology->Hybrid && Index < pTopology->CpuCount; Index++) {
+		printf("   - CPU %3u: %-11s (core type 0x%02x, native model 0x%06x)\n", Index,
+			HybridGetCoreTypeName(pTopology->Cpus[Index].CoreType), pTopology->Cpus[Index].CoreType, pTopology->Cpus[Index].NativeModel);
+	}
+
+	UINT32 Placements[2] = { HYBRID_PLACE_PERFORMANCE, HYBRID_PLACE_EFFICIENCY };
+	for (UINT32 Placement = 0x00; Placement < ARRAYSIZE(Placements); Placement++) {
+		UINT32 Cpus[64] = { 0x00 };
+		UINT32 uiCount = HybridGetCpus(pTopology, Placements[Placement], Cpus, ARRAYSIZE(Cpus));
+		printf("   - %s placement:", Placements[Placement] == HYBRID_PLACE_PERFORMANCE ? "Latency-critical" : "Batch");
+		for (UINT32 Index = 0x00; Index < uiCount && Index < ARRAYSIZE(Cpus); Index++)
+			printf(" %u", Cpus[Index]);
+		printf(uiCount > ARRAYSIZE(Cpus) ? " ...\n" : "\n");
+	}
+}
 
 /// <summary>
-/// Execute the CPUID instruction to get information about the system.
+/// Print the interfaces exposed by the hypervisor, its clock sources and the TSC frequency it reports.
 /// </summary>
-/// <param name="pEAX">Pointer to the EAX register.</param>
-/// <param name="pECX">Pointer to the ECX register.</param>
-/// <param name="pEBX">Pointer to the EBX register.</param>
-/// <param name="pEDX">Pointer to the EDX register.</param>
-/// <returns>Whether the CPUID instruction has been executed successfully.</returns>
-_Success_(return != 0x00) _Must_inspect_result_
-EXTERN_C UINT STDMETHODCALLTYPE CPUIDEX(
-	_Inout_ PUINT pEAX,
-	_Inout_ PUINT pECX,
-	_Inout_ PUINT pEBX,
-	_Inout_ PUINT pEDX
-);
+/// <param name="pInformation">Pointer to the decoded hypervisor leaves.</param>
+static VOID PrintHypervisor(
+	_In_ const HYPERVISOR_INFORMATION* pInformation
+) {
+	printf("Hypervisor Information:\n");
+	for (UINT32 Index = 0x00; Index < pInformation->InterfaceCount; Index++) {
+		const HYPERVISOR_INTERFACE* pInterface = &pInformation->Interfaces[Index];
+		printf("   - Leaves 0x%08x-0x%08x: %s (\"%s\")\n", pInterface->Base, pInterface->MaximumLeaf,
+			HypervisorGetVendorName(pInterface->Vendor), pInterface->Signature);
+	}
+	if (pInformation->KvmFeatures != 0x00)
+		printf("   - KVM features 0x%08x: steal time (%s), PV EOI (%s), PV TLB flush (%s), PV send IPI (%s)\n", pInformation->KvmFeatures,
+			(pInformation->KvmFeatures & KVM_FEATURE_STEAL_TIME) ? "true" : "false", (pInformation->KvmFeatures & KVM_FEATURE_PV_EOI) ? "true" : "false",
+			(pInformation->KvmFeatures & KVM_FEATURE_PV_TLB_FLUSH) ? "true" : "false", (pInformation->KvmFeatures & KVM_FEATURE_PV_SEND_IPI) ? "true" : "false");
+	if (pInformation->HvPrivileges != 0x00)
+		printf("   - Hyper-V %u.%u build %u, partition privileges 0x%08x\n", pInformation->HvMajor, pInformation->HvMinor, pInformation->HvBuild, pInformation->HvPrivileges);
+	if (pInformation->XenMajor != 0x00)
+		printf("   - Xen %u.%u, TSC mode %u, RDTSC emulated (%s)\n", pInformation->XenMajor, pInformation->XenMinor, pInformation->XenTscMode,
+			(pInformation->XenTscFlags & XEN_TSC_EMULATED) ? "true" : "false");
+
+	printf("   - kvmclock (%s), stable across vCPUs (%s)\n", (pInformation->Clocks & HYPERVISOR_CLOCK_KVMCLOCK) ? "true" : "false",
+		(pInformation->Clocks & HYPERVISOR_CLOCK_KVMCLOCK_STABLE) ? "true" : "false");
+	printf("   - Hyper-V reference counter (%s), reference TSC page (%s)\n", (pInformation->Clocks & HYPERVISOR_CLOCK_HV_COUNTER) ? "true" : "false",
+		(pInformation->Clocks & HYPERVISOR_CLOCK_HV_TSC_PAGE) ? "true" : "false");
+	printf("   - Xen pvclock (%s)\n", (pInformation->Clocks & HYPERVISOR_CLOCK_XEN_PVCLOCK) ? "true" : "false");
+	printf("   - TSC invariant across migrations (%s)\n", (pInformation->Clocks & HYPERVISOR_CLOCK_TSC_INVARIANT) ? "true" : "false");
+	if (pInformation->TscFrequency != 0x00)
+		printf("   - TSC frequency: %llu kHz, APIC bus frequency: %llu kHz\n", (unsigned long long)(pInformation->TscFrequency / 1000),
+			(unsigned long long)(pInformation->ApicFrequency / 1000));
+	else if (pInformation->bPresent)
+		printf("   - TSC frequency: not reported by the hypervisor\n");
+}
 
 /// <summary>
 /// Entry point of the application.
 /// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Optional path of a "cpuid -r" dump to replay instead of the local processors.</param>
 /// <returns>Process exit status code.</returns>
-INT main() {
+INT main(INT argc, CHAR* argv[]) {
+	// 0. Replay the core types of the processors of another machine
+	if (argc > 1) {
+		CPUID_BACKEND Backend = { 0x00 };
+		HYBRID_TOPOLOGY Topology = { 0x00 };
+		if (!CpuidReplayOpen(argv[1], &Backend)) {
+			printf("Unable to load the CPUID dump %s.\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+		BOOL bSuccess = HybridBuild(&Backend, &Topology);
+		CpuidClose(&Backend);
+		if (!bSuccess) {
+			printf("Unable to build the topology.\n");
+			return EXIT_FAILURE;
+		}
+		PrintHybridTopology(&Topology);
+		HybridFree(&Topology);
+		return EXIT_SUCCESS;
+	}
+
 	UINT eax = 0x00;
 	UINT ecx = 0x00;
 	UINT ebx = 0x00;
@@ -171,9 +122,7 @@ INT main() {
 		return EXIT_FAILURE;
 	}
 
-	LPCSTR szVendorName = (LPCSTR)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, eax);
-	if (szVendorName == NULL)
-		return EXIT_FAILURE;
+	CHAR szVendorName[13] = { 0x00 };
 	RtlCopyMemory(&(szVendorName[0]), &ebx, sizeof(UINT));
 	RtlCopyMemory(&(szVendorName[4]), &edx, sizeof(UINT));
 	RtlCopyMemory(&(szVendorName[8]), &ecx, sizeof(UINT));
@@ -190,6 +139,8 @@ INT main() {
 	BasicInformationEdx Feature2 = { .value = edx };
 
 	printf("Basic CPUID Information:\n");
+	printf("   - Hypervisor: running under a hypervisor (%s)\n", Feature1.elem.Hypervisor == 1 ? "true" : "false");
+	printf("   - RDRAND: RDRAND instruction support (%s)\n", Feature1.elem.RDRAND == 1 ? "true" : "false");
 	printf("   - F16C: half-precision convert instruction support (%s)\n", Feature1.elem.F16C == 1 ? "true" : "false");
 	printf("   - AVX: AVX instruction support (%s)\n", Feature1.elem.AVX == 1 ? "true" : "false");
 	printf("   - OSXSAVE: XSAVE (and related) instructions are enabled (%s)\n", Feature1.elem.OSXSAVE == 1 ? "true" : "false");
@@ -237,6 +188,7 @@ INT main() {
 		return EXIT_FAILURE;
 	}
 	StructuredExtendedFeatureEbx ExtendedFeatures = { .value = ebx };
+	StructuredExtendedFeatureEcx ExtendedFeatures2 = { .value = ecx };
 
 	printf("Structured Extended Feature Flags Enumeration Leaf:\n");
 	printf("   - FSGSBASE: Supports RDFSBASE/RDGSBASE/WRFSBASE/WRGSBASE (%s)\n", ExtendedFeatures.elem.FSGSBASE == 1 ? "true" : "false");
@@ -270,6 +222,47 @@ INT main() {
 	printf("   - SHA: supports Intel Secure Hash Algorithm Extensions (Intel SHA Extensions) (%s)\n", ExtendedFeatures.elem.SHA == 1 ? "true" : "false");
 	printf("   - AVX512BW (%s)\n", ExtendedFeatures.elem.AVX512BW == 1 ? "true" : "false");
 	printf("   - AVX512VL (%s)\n", ExtendedFeatures.elem.AVX512VL == 1 ? "true" : "false");
+	printf("   - UMIP: Supports user-mode instruction prevention (%s)\n", ExtendedFeatures2.elem.UMIP == 1 ? "true" : "false");
+	printf("   - PKU: Supports protection keys for user-mode pages (%s)\n", ExtendedFeatures2.elem.PKU == 1 ? "true" : "false");
+	printf("   - WAITPKG: Supports TPAUSE, UMONITOR and UMWAIT (%s)\n", ExtendedFeatures2.elem.WAITPKG == 1 ? "true" : "false");
+	printf("   - LA57: Supports 57-bit linear addresses and five-level paging (%s)\n", ExtendedFeatures2.elem.LA57 == 1 ? "true" : "false");
+	printf("   - RDPID: RDPID and IA32_TSC_AUX are available (%s)\n", ExtendedFeatures2.elem.RDPID == 1 ? "true" : "false");
+	printf("   - CLDEMOTE: Supports cache line demote (%s)\n", ExtendedFeatures2.elem.CLDEMOTE == 1 ? "true" : "false");
+
+	// 5. Get the Extended Processor Signature and Feature Bits
+	ecx = 0x00;
+	eax = CPUID_LEAF_EXTENDED_MAXIMUM;
+	if (SUCCESS(CPUIDEX(&eax, &ecx, &ebx, &edx)) && eax >= CPUID_LEAF_EXTENDED_INFORMATION) {
+		ecx = 0x00;
+		eax = CPUID_LEAF_EXTENDED_INFORMATION;
+		if (FAILED(CPUIDEX(&eax, &ecx, &ebx, &edx))) {
+			printf("Unable to get the extended processor feature identifiers.\n");
+			return EXIT_FAILURE;
+		}
+		ExtendedInformationEcx ExtendedInformation2 = { .value = ecx };
+		ExtendedInformationEdx ExtendedInformation = { .value = edx };
+
+		printf("Extended Processor Signature and Feature Bits:\n");
+		printf("   - SYSCALL/SYSRET available in 64-bit mode (%s)\n", ExtendedInformation.elem.SYSCALL == 1 ? "true" : "false");
+		printf("   - Execute Disable Bit available (%s)\n", ExtendedInformation.elem.NX == 1 ? "true" : "false");
+		printf("   - 1-GByte pages are available (%s)\n", ExtendedInformation.elem.Page1GB == 1 ? "true" : "false");
+		printf("   - RDTSCP and IA32_TSC_AUX are available (%s)\n", ExtendedInformation.elem.RDTSCP == 1 ? "true" : "false");
+		printf("   - Intel 64 Architecture available (%s)\n", ExtendedInformation.elem.LM == 1 ? "true" : "false");
+		printf("   - MONITORX/MWAITX available, AMD only (%s)\n", ExtendedInformation2.elem.MONITORX == 1 ? "true" : "false");
+	}
+
+	// 6. Get the hypervisor leaves
+	HYPERVISOR_INFORMATION Hypervisor = { 0x00 };
+	if (HypervisorQuery(NULL, NULL, &Hypervisor))
+		PrintHypervisor(&Hypervisor);
+
+	// 7. Get the core type of every processor
+	const HYBRID_TOPOLOGY* pTopology = HybridGetTopology();
+	if (pTopology == NULL) {
+		printf("Unable to get the core type of the processors.\n");
+		return EXIT_FAILURE;
+	}
+	PrintHybridTopology(pTopology);
 
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
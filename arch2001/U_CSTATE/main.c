@@ -0,0 +1,307 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atomic.h"
+#include "cstate.h"
+#include "thread.h"
+
+/// Number of processors emulated by the mock backend
+#define CSTATE_MOCK_CPUS 4
+
+/// TSC ticks per nanosecond of the emulated processor
+#define CSTATE_MOCK_TSC_RATE 3
+
+/// Sleep of the built-in wake-up probe
+#define CSTATE_PROBE_MS 1
+
+/// <summary>
+/// Emulate the residency counters: the deeper states alternate between 10% and 70% of the time every
+/// second, with an offset per processor. The package C8 to C10 counters do not exist, as on servers.
+/// </summary>
+static BOOL CstateMockHandler(
+	_In_    PVOID   Context,
+	_In_    UINT32  Cpu,
+	_In_    UINT32  Msr,
+	_In_    BOOL    bWrite,
+	_Inout_ PUINT64 pValue
+) {
+	UINT64 Start = *(PUINT64)Context;
+	if (bWrite)
+		return FALSE;
+
+	UINT64 Period = 1000000000ULL * CSTATE_MOCK_TSC_RATE;
+	UINT64 Tsc = (ThreadGetTime() - Start) * CSTATE_MOCK_TSC_RATE + Cpu * Period / 4;
+	UINT64 Cycle = Tsc % (2 * Period);
+	UINT64 Deep = (Tsc / (2 * Period)) * (Period * 8 / 10) + (Cycle < Period ? Cycle / 10 : Period / 10 + (Cycle - Period) * 7 / 10);
+	switch (Msr) {
+	case IA32_TSC_MSR:
+		*pValue = Tsc;
+		return TRUE;
+	case MSR_CORE_C3_RESIDENCY:
+		*pValue = Tsc / 20;
+		return TRUE;
+	case MSR_CORE_C6_RESIDENCY:
+		*pValue = Deep;
+		return TRUE;
+	case MSR_CORE_C7_RESIDENCY:
+		*pValue = Deep / 2;
+		return TRUE;
+	case MSR_PKG_C2_RESIDENCY:
+		*pValue = Tsc / 10;
+		return TRUE;
+	case MSR_PKG_C3_RESIDENCY:
+		*pValue = Tsc / 50;
+		return TRUE;
+	case MSR_PKG_C6_RESIDENCY:
+		*pValue = Deep / 3;
+		return TRUE;
+	case MSR_PKG_C7_RESIDENCY:
+		*pValue = 0x00;
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/// <summary>
+/// Wake-up latency probe: a thread sleeping again and again on a monitored processor, measuring by how
+/// much every sleep overshoots. Deep C-states show up directly as longer overshoots.
+/// </summary>
+typedef struct _CSTATE_PROBE {
+	THREAD         Thread;
+	UINT32         Cpu;
+	volatile INT32 Stop;
+	volatile INT64 Sum;       // Nanoseconds of overshoot since the last collection.
+	volatile INT64 Count;
+} CSTATE_PROBE, * PCSTATE_PROBE;
+
+static VOID CstateProbeRoutine(
+	_In_ PVOID Parameter
+) {
+	PCSTATE_PROBE pProbe = (PCSTATE_PROBE)Parameter;
+	(VOID)ThreadPin(pProbe->Cpu, NULL);
+	while (AtomicLoad32(&pProbe->Stop) == 0x00) {
+		UINT64 Start = ThreadGetTime();
+		ThreadSleep(CSTATE_PROBE_MS);
+		UINT64 Elapsed = ThreadGetTime() - Start;
+		UINT64 Expected = CSTATE_PROBE_MS * 1000000ULL;
+		AtomicAdd64(&pProbe->Sum, Elapsed > Expected ? (INT64)(Elapsed - Expected) : 0x00);
+		AtomicAdd64(&pProbe->Count, 1);
+	}
+}
+
+/// <summary>
+/// Get the latency of the interval: the average overshoot of the probe in microseconds, or the last number
+/// written in the file of the user.
+/// </summary>
+static BOOL CstateGetLatency(
+	_In_opt_ PCSTATE_PROBE pProbe,
+	_In_opt_ LPCSTR        szPath,
+	_Out_    double*       pLatency
+) {
+	*pLatency = 0.0;
+	if (pProbe != NULL) {
+		INT64 Sum = AtomicExchange64(&pProbe->Sum, 0x00);
+		INT64 Count = AtomicExchange64(&pProbe->Count, 0x00);
+		*pLatency = Count != 0x00 ? (double)Sum / (double)Count / 1000.0 : 0.0;
+		return Count != 0x00;
+	}
+
+	FILE* pFile = fopen(szPath, "r");
+	if (pFile == NULL)
+		return FALSE;
+	BOOL bRead = FALSE;
+	double Value = 0.0;
+	while (fscanf(pFile, "%lf", &Value) == 0x01) {
+		*pLatency = Value;
+		bRead = TRUE;
+	}
+	fclose(pFile);
+	return bRead;
+}
+
+/// <summary>
+/// Parse "all" or a comma separated list of processors.
+/// </summary>
+static BOOL CstateParseCpus(
+	_In_  LPCSTR   szArgument,
+	_In_  UINT32   uiCpuCount,
+	_Out_ PUINT32* ppCpus,
+	_Out_ PUINT32  pCount
+) {
+	*pCount = 0x00;
+	BOOL bAll = strcmp(szArgument, "all") == 0x00;
+	UINT32 uiCount = bAll ? uiCpuCount : 0x01;
+	for (LPCSTR szChar = szArgument; !bAll && *szChar != '\0'; szChar++)
+		uiCount += *szChar == ',';
+	*ppCpus = (PUINT32)calloc(uiCount, sizeof(UINT32));
+	if (*ppCpus == NULL)
+		return FALSE;
+
+	for (LPSTR szEnd = (LPSTR)szArgument; *pCount < uiCount; szArgument = szEnd + 1) {
+		UINT32 Cpu = bAll ? *pCount : (UINT32)strtoul(szArgument, &szEnd, 10);
+		if (!bAll && (szEnd == szArgument || (*szEnd != ',' && *szEnd != '\0')))
+			return FALSE;
+		if (Cpu >= uiCpuCount)
+			return FALSE;
+		(*ppCpus)[(*pCount)++] = Cpu;
+		if (!bAll && *szEnd == '\0')
+			break;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Monitor the residencies interval after interval, then correlate every counter with the latency.
+/// </summary>
+static INT CstateMonitor(
+	_In_     PCSTATE_MONITOR pMonitor,
+	_In_     UINT32          uiInterval,
+	_In_     UINT32          uiIntervals,
+	_In_opt_ LPCSTR          szLatencyPath
+) {
+	// 1. Latency signal
+	static CSTATE_PROBE Probe;
+	PCSTATE_PROBE pProbe = szLatencyPath == NULL ? &Probe : NULL;
+	if (pProbe != NULL) {
+		pProbe->Cpu = pMonitor->Cpus[0];
+		if (!ThreadCreate(&pProbe->Thread, CstateProbeRoutine, pProbe)) {
+			printf("Unable to start the wake-up probe.\n");
+			return EXIT_FAILURE;
+		}
+	}
+	printf("Latency: %s.\n", pProbe != NULL ? "average oversleep of a 1 ms sleep on the first processor, in microseconds" : szLatencyPath);
+
+	// 2. Header, only the counters the processor implements
+	printf("%8s", "time ms");
+	for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++) {
+		if (pMonitor->Present & (1U << Counter))
+			printf(" %6s", CstateGetName((CSTATE_COUNTER)Counter));
+	}
+	printf(" %10s\n", "latency");
+
+	// 3. One row per interval
+	double* pSeries = (double*)calloc((SIZE_T)uiIntervals * (CstateCounterCount + 1), sizeof(double));
+	UINT32 Collected = 0x00;
+	UINT64 Start = ThreadGetTime();
+	for (UINT32 Interval = 0x00; pSeries != NULL && Interval < uiIntervals; Interval++) {
+		ThreadSleep(uiInterval);
+		CSTATE_INTERVAL Residency = { 0x00 };
+		double Latency = 0.0;
+		BOOL bSampled = CstateSample(pMonitor, NULL, &Residency);
+		BOOL bLatency = CstateGetLatency(pProbe, szLatencyPath, &Latency);
+		if (!bSampled) {
+			printf("%8llu unable to read the counters\n", (unsigned long long)((ThreadGetTime() - Start) / 1000000));
+			continue;
+		}
+
+		printf("%8llu", (unsigned long long)((ThreadGetTime() - Start) / 1000000));
+		for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++) {
+			if (pMonitor->Present & (1U << Counter))
+				printf(" %5.1f%%", Residency.Percent[Counter]);
+		}
+		if (bLatency)
+			printf(" %10.2f\n", Latency);
+		else
+			printf(" %10s\n", "-");
+
+		// Only the intervals with both signals are correlated
+		if (bLatency) {
+			for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++)
+				pSeries[Counter * uiIntervals + Collected] = Residency.Percent[Counter];
+			pSeries[CstateCounterCount * uiIntervals + Collected] = Latency;
+			Collected++;
+		}
+	}
+	if (pProbe != NULL) {
+		AtomicStore32(&pProbe->Stop, 1);
+		ThreadJoin(&pProbe->Thread);
+	}
+
+	// 4. Correlation of every counter with the latency
+	printf("\nCorrelation with the latency over %u interval(s):\n", Collected);
+	for (UINT32 Counter = 0x00; pSeries != NULL && Counter < CstateCounterCount; Counter++) {
+		if ((pMonitor->Present & (1U << Counter)) == 0x00)
+			continue;
+		double Correlation = 0.0;
+		if (CstateCorrelate(&pSeries[Counter * uiIntervals], &pSeries[CstateCounterCount * uiIntervals], Collected, &Correlation))
+			printf("  - %-4s %+.3f%s\n", CstateGetName((CSTATE_COUNTER)Counter), Correlation, Correlation > 0.5 ? "  deeper sleep, slower wake-ups" : "");
+		else
+			printf("  - %-4s undefined, constant residency or latency\n", CstateGetName((CSTATE_COUNTER)Counter));
+	}
+	free(pSeries);
+	return pSeries != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command followed by its arguments.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	BOOL bMock = argc >= 2 && strcmp(argv[1], "mock") == 0x00;
+	if ((argc != 4 + bMock && argc != 5 + bMock) || (!bMock && argc >= 2 && strcmp(argv[1], "mock") == 0x00)) {
+		printf("Usage: %s [mock] <cpu,cpu,...|all> <interval ms> <intervals> [latency file]\n", argv[0]);
+		printf("Without a latency file, the wake-up latency of the first processor is measured.\n");
+		printf("With one, the last number written in the file is read every interval.\n");
+		return EXIT_FAILURE;
+	}
+	CHAR** pArguments = &argv[1 + bMock];
+	UINT32 uiInterval = (UINT32)strtoul(pArguments[1], NULL, 10);
+	UINT32 uiIntervals = (UINT32)strtoul(pArguments[2], NULL, 10);
+	LPCSTR szLatencyPath = argc == 5 + bMock ? pArguments[3] : NULL;
+
+	// 1. Backend and topology, the package counters are read once per package
+	static UINT64 MockStart;
+	MSR_BACKEND Msr = { 0x00 };
+	CPUID_BACKEND Cpuid = { 0x00 };
+	TOPOLOGY Topology = { 0x00 };
+	BOOL bTopology = FALSE;
+	UINT32 uiCpuCount = CSTATE_MOCK_CPUS;
+	if (bMock) {
+		MockStart = ThreadGetTime();
+		if (!MsrMockOpen(&Msr, CSTATE_MOCK_CPUS, CstateMockHandler, &MockStart))
+			return EXIT_FAILURE;
+	}
+	else {
+		if (!MsrOpen(&Msr)) {
+			printf("Unable to open the MSR backend.\n");
+			return EXIT_FAILURE;
+		}
+		uiCpuCount = ThreadGetCpuCount();
+		if (CpuidOpen(&Cpuid)) {
+			bTopology = TopologyBuild(&Cpuid, &Topology);
+			CpuidClose(&Cpuid);
+		}
+	}
+
+	// 2. Monitor
+	INT Status = EXIT_FAILURE;
+	PUINT32 pCpus = NULL;
+	UINT32 uiCount = 0x00;
+	CSTATE_MONITOR Monitor = { 0x00 };
+	if (uiInterval == 0x00 || uiIntervals == 0x00 || !CstateParseCpus(pArguments[0], uiCpuCount, &pCpus, &uiCount)) {
+		printf("Invalid processors, interval or number of intervals.\n");
+	}
+	else if (!CstateOpen(&Monitor, &Msr, bTopology ? &Topology : NULL, pCpus, uiCount)) {
+		printf("No residency counter can be read on this processor.\n");
+	}
+	else {
+		printf("Monitoring %u processor(s) through %s, one batch of MSRs per processor and interval.\n", uiCount, Msr.Name);
+		Status = CstateMonitor(&Monitor, uiInterval, uiIntervals, szLatencyPath);
+		CstateClose(&Monitor);
+	}
+	free(pCpus);
+	if (bTopology)
+		TopologyFree(&Topology);
+	MsrClose(&Msr);
+	return Status;
+}
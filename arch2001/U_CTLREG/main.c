@@ -0,0 +1,152 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ctlreg.h"
+#include "thread.h"
+
+/// <summary>
+/// Print the registers of a processor with the names of their flags, then the features they enable.
+/// </summary>
+static VOID CtlregPrintState(
+	_In_ const CTLREG_STATE* pState
+) {
+	CHAR szFlags[0x200] = { 0x00 };
+	for (UINT32 Index = 0x00; Index < CtlregRegisterCount; Index++) {
+		CTLREG_REGISTER Register = (CTLREG_REGISTER)Index;
+		UINT64 Value = 0x00;
+		if (!CtlregGetValue(pState, Register, &Value))
+			continue;
+
+		CtlregFormat(Register, Value, szFlags, sizeof(szFlags));
+		printf("  %-5s %016llx  %s", CtlregGetName(Register), (unsigned long long)Value, szFlags);
+		if (Register == CtlregCr3) {
+			CTLREG_CR3 Cr3 = { .value = Value };
+			CTLREG_CR4 Cr4 = { .value = pState->Cr4 };
+			printf("%sBase=%llx", szFlags[0] != '\0' ? " " : "", (unsigned long long)Cr3.elem.Base << 12);
+			if (Cr4.elem.PCIDE)
+				printf(" PCID=%03llx", (unsigned long long)Cr3.pcid.PCID);
+		}
+		else if (Register == CtlregCr8) {
+			printf("TPR=%llu", (unsigned long long)(Value & 0x0F));
+		}
+		printf("\n");
+	}
+
+	printf("  Features:\n");
+	for (UINT32 Index = 0x00; Index < CtlregFeatureCount; Index++) {
+		BOOL bEnabled = FALSE;
+		if (CtlregIsEnabled(pState, (CTLREG_FEATURE)Index, &bEnabled))
+			printf("    [%c] %s\n", bEnabled ? 'x' : ' ', CtlregGetFeatureName((CTLREG_FEATURE)Index));
+	}
+}
+
+/// <summary>
+/// Decode values given on the command line as register and value pairs.
+/// </summary>
+static INT CtlregDecode(
+	_In_reads_(uiCount) CHAR** ppArguments,
+	_In_ UINT32                uiCount
+) {
+	CTLREG_STATE State = { 0x00 };
+	if (uiCount == 0x00 || (uiCount % 2) != 0x00)
+		return EXIT_FAILURE;
+
+	// 1. Match every name with a register and mark its group as captured
+	for (UINT32 Index = 0x00; Index < uiCount; Index += 2) {
+		for (LPSTR szName = ppArguments[Index]; *szName != '\0'; szName++)
+			*szName = (CHAR)toupper((unsigned char)*szName);
+
+		CTLREG_REGISTER Register = CtlregRegisterCount;
+		for (UINT32 Candidate = 0x00; Candidate < CtlregRegisterCount; Candidate++) {
+			if (strcmp(ppArguments[Index], CtlregGetName((CTLREG_REGISTER)Candidate)) == 0x00)
+				Register = (CTLREG_REGISTER)Candidate;
+		}
+
+		LPSTR szEnd = NULL;
+		UINT64 Value = strtoull(ppArguments[Index + 1], &szEnd, 16);
+		if (Register == CtlregRegisterCount || szEnd == ppArguments[Index + 1] || *szEnd != '\0') {
+			printf("Invalid register or value: %s %s\n", ppArguments[Index], ppArguments[Index + 1]);
+			return EXIT_FAILURE;
+		}
+
+		switch (Register) {
+		case CtlregCr0:  State.Cr0 = Value;  State.Valid |= CTLREG_VALID_CR; break;
+		case CtlregCr2:  State.Cr2 = Value;  State.Valid |= CTLREG_VALID_CR; break;
+		case CtlregCr3:  State.Cr3 = Value;  State.Valid |= CTLREG_VALID_CR; break;
+		case CtlregCr4:  State.Cr4 = Value;  State.Valid |= CTLREG_VALID_CR; break;
+		case CtlregCr8:  State.Cr8 = Value;  State.Valid |= CTLREG_VALID_CR; break;
+		case CtlregXcr0: State.Xcr0 = Value; State.Valid |= CTLREG_VALID_XCR0; break;
+		case CtlregEfer: State.Efer = Value; State.Valid |= CTLREG_VALID_EFER; break;
+		default: break;
+		}
+	}
+
+	// 2. Same output as a capture
+	printf("Decoded values:\n");
+	CtlregPrintState(&State);
+	return EXIT_SUCCESS;
+}
+
+INT main(INT argc, CHAR* argv[]) {
+	if (argc >= 2 && strcmp(argv[1], "decode") == 0x00) {
+		INT Status = CtlregDecode(&argv[2], (UINT32)argc - 2);
+		if (Status == EXIT_SUCCESS)
+			return Status;
+	}
+	else if (argc <= 2) {
+		// 1. Open the driver, or XGETBV and the MSR backend
+		MSR_BACKEND Msr = { 0x00 };
+		BOOL bMsr = MsrOpen(&Msr);
+		CTLREG_SOURCE Source = { 0x00 };
+		if (!CtlregOpen(&Source, bMsr ? &Msr : NULL)) {
+			printf("Neither the \\\\.\\KSeg driver, XGETBV nor the MSR backend is available.\n");
+			if (bMsr)
+				MsrClose(&Msr);
+			return EXIT_FAILURE;
+		}
+
+		// 2. Capture the processors requested
+		UINT32 uiCpu = CTLREG_ALL_CPUS;
+		UINT32 uiCount = ThreadGetCpuCount();
+		if (argc == 2 && strcmp(argv[1], "all") != 0x00) {
+			uiCpu = (UINT32)strtoul(argv[1], NULL, 10);
+			uiCount = 0x01;
+		}
+		PCTLREG_STATE pStates = (PCTLREG_STATE)calloc(uiCount, sizeof(CTLREG_STATE));
+		UINT32 uiCaptured = 0x00;
+		INT Status = EXIT_FAILURE;
+		if (pStates != NULL && CtlregCapture(&Source, uiCpu, pStates, uiCount, &uiCaptured)) {
+			printf("Source: %s\n", Source.Name);
+			for (UINT32 Index = 0x00; Index < uiCaptured; Index++) {
+				printf("CPU %u:\n", pStates[Index].Cpu);
+				CtlregPrintState(&pStates[Index]);
+			}
+			if ((pStates[0x00].Valid & CTLREG_VALID_CR) == 0x00)
+				printf("CR0 to CR8 require the \\\\.\\KSeg driver, use \"decode\" with values captured elsewhere.\n");
+			Status = EXIT_SUCCESS;
+		}
+		else {
+			printf("Unable to capture the registers.\n");
+		}
+
+		// 3. Cleanup
+		free(pStates);
+		CtlregClose(&Source);
+		if (bMsr)
+			MsrClose(&Msr);
+		return Status;
+	}
+
+	printf("Usage: %s [cpu|all]\n", argv[0]);
+	printf("       %s decode <cr0|cr2|cr3|cr4|cr8|xcr0|efer> <hex value> [...]\n", argv[0]);
+	printf("Control registers not given to \"decode\" are taken as zero.\n");
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,289 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hwp.h"
+#include "thread.h"
+
+/// Number of processors emulated by the mock backend, the upper half being efficiency cores
+#define HWP_MOCK_CPUS 8
+
+/// TSC ratio of the emulated processor, 3 GHz
+#define HWP_MOCK_TSC_RATIO 30
+
+/// Interval over which the frequencies are observed
+#define HWP_OBSERVE_MS 250
+
+/// <summary>
+/// State of the emulated processor.
+/// </summary>
+typedef struct _HWP_MOCK {
+	UINT64 Start;
+	UINT64 Request[HWP_MOCK_CPUS];
+} HWP_MOCK, * PHWP_MOCK;
+
+/// <summary>
+/// Performance levels of an emulated processor.
+/// </summary>
+static UINT64 HwpMockCapabilities(
+	_In_ UINT32 Cpu
+) {
+	return Cpu < HWP_MOCK_CPUS / 2 ? 0x080F2332 : 0x050A1926;
+}
+
+/// <summary>
+/// Emulate HWP: the processor runs at the desired level when there is one, otherwise it idles 60% of
+/// the time and picks a level between the most efficient and the maximum one according to the EPP.
+/// </summary>
+static BOOL HwpMockHandler(
+	_In_    PVOID   Context,
+	_In_    UINT32  Cpu,
+	_In_    UINT32  Msr,
+	_In_    BOOL    bWrite,
+	_Inout_ PUINT64 pValue
+) {
+	PHWP_MOCK Mock = (PHWP_MOCK)Context;
+	if (bWrite) {
+		// Reserved bits raise #GP
+		if (Msr == IA32_HWP_REQUEST && (*pValue & ~HWP_REQUEST_KNOWN) == 0x00)
+			Mock->Request[Cpu] = *pValue;
+		return Msr == IA32_HWP_REQUEST && (*pValue & ~HWP_REQUEST_KNOWN) == 0x00;
+	}
+
+	HWP_REQUEST Request = { 0x00 };
+	HwpDecodeRequest(Mock->Request[Cpu], &Request);
+	UINT64 Capabilities = HwpMockCapabilities(Cpu);
+	UINT64 Efficient = (Capabilities >> 16) & 0xFF;
+	UINT64 Ratio = Request.Desired != 0x00 ? Request.Desired : Efficient + (Request.Maximum - Efficient) * (0xFF - Request.Epp) / 0xFF;
+	Ratio = Ratio < Request.Minimum ? Request.Minimum : Ratio > Request.Maximum ? Request.Maximum : Ratio;
+	UINT64 Tsc = (ThreadGetTime() - Mock->Start) * HWP_MOCK_TSC_RATIO / 10;
+	UINT64 Mperf = Request.Desired != 0x00 ? Tsc : Tsc * 4 / 10;
+	switch (Msr) {
+	case IA32_PM_ENABLE:
+		*pValue = HWP_PM_ENABLE;
+		return TRUE;
+	case IA32_HWP_CAP_MSR:
+		*pValue = Capabilities;
+		return TRUE;
+	case IA32_TSC_MSR:
+		*pValue = Tsc;
+		return TRUE;
+	case IA32_MPERF:
+		*pValue = Mperf;
+		return TRUE;
+	case IA32_APERF:
+		*pValue = Mperf * Ratio / HWP_MOCK_TSC_RATIO;
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/// <summary>
+/// Parse "all" or a comma separated list of processors into a mask of classes.
+/// </summary>
+static BOOL HwpParseCpus(
+	_In_    LPCSTR     szArgument,
+	_In_    UINT32     uiCpuCount,
+	_In_    HWP_CLASS  Class,
+	_Inout_ HWP_CLASS* pClasses
+) {
+	if (strcmp(szArgument, "all") == 0x00) {
+		for (UINT32 Cpu = 0x00; Cpu < uiCpuCount; Cpu++)
+			pClasses[Cpu] = Class;
+		return TRUE;
+	}
+	for (LPSTR szEnd = (LPSTR)szArgument;; szArgument = szEnd + 1) {
+		UINT32 Cpu = (UINT32)strtoul(szArgument, &szEnd, 10);
+		if (szEnd == szArgument || (*szEnd != ',' && *szEnd != '\0') || Cpu >= uiCpuCount)
+			return FALSE;
+		pClasses[Cpu] = Class;
+		if (*szEnd == '\0')
+			return TRUE;
+	}
+}
+
+/// <summary>
+/// Print the levels, the request and the observed frequency of every processor.
+/// </summary>
+static VOID HwpPrintState(
+	_In_ PHWP_CONTROL     pControl,
+	_In_opt_ const HWP_CLASS* pClasses
+) {
+	PHWP_FREQUENCY pFrequencies = (PHWP_FREQUENCY)calloc(pControl->CpuCount, sizeof(HWP_FREQUENCY));
+	BOOL bObserved = pFrequencies != NULL && pControl->Features.AperfMperf && HwpObserve(pControl, HWP_OBSERVE_MS, pFrequencies);
+
+	static const LPCSTR Classes[] = { "", "latency", "batch" };
+	printf("  CPU class    lowest eff guar high   min max desired epp   busy   active MHz  check\n");
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++) {
+		HWP_CAPABILITIES Capabilities = { 0x00 };
+		HWP_REQUEST Request = { 0x00 };
+		if (!HwpGetCapabilities(pControl, Cpu, &Capabilities) || !HwpGetRequest(pControl, Cpu, &Request)) {
+			printf("  %3u unable to read the MSRs\n", Cpu);
+			continue;
+		}
+		printf("  %3u %-8s %6u %3u %4u %4u   %3u %3u %7u %3u", Cpu, Classes[pClasses != NULL ? pClasses[Cpu] : HwpClassUnmanaged],
+			Capabilities.Lowest, Capabilities.Efficient, Capabilities.Guaranteed, Capabilities.Highest,
+			Request.Minimum, Request.Maximum, Request.Desired, Request.Epp);
+		if (!bObserved || !pFrequencies[Cpu].bValid) {
+			printf("      -            -\n");
+			continue;
+		}
+
+		// A busy processor under its minimum is being throttled, by the package limits or the temperature
+		const HWP_FREQUENCY* pFrequency = &pFrequencies[Cpu];
+		UINT32 Floor = (pControl->Mode == HwpModeHwp ? Request.Minimum : Request.Desired) * HWP_BUS_CLOCK_MHZ;
+		LPCSTR szCheck = pFrequency->Busy < 50.0 ? "mostly idle" : pFrequency->ActiveMhz < Floor * 0.95 ? "BELOW REQUEST" : "ok";
+		printf(" %5.1f%% %12.0f  %s\n", pFrequency->Busy, pFrequency->ActiveMhz, szCheck);
+	}
+	if (bObserved)
+		printf("  Observed over %u ms, TSC at %.0f MHz.\n", HWP_OBSERVE_MS, pFrequencies[0].TscMhz);
+	free(pFrequencies);
+}
+
+/// <summary>
+/// Run a command on an opened backend.
+/// </summary>
+static INT HwpRun(
+	_In_ PMSR_BACKEND        pMsr,
+	_In_ const HWP_FEATURES* pFeatures,
+	_In_ UINT32              uiCpuCount,
+	_In_ LPCSTR              szCommand,
+	_In_ CHAR**              pArguments,
+	_In_ UINT32              uiCount
+) {
+	HWP_CONTROL Control = { 0x00 };
+	if (!HwpOpen(&Control, pMsr, pFeatures, uiCpuCount)) {
+		printf("Unable to read the performance requests.\n");
+		return EXIT_FAILURE;
+	}
+	printf("Performance controlled through %s (EPP %s, activity window %s, package request %s, turbo %s, APERF/MPERF %s).\n",
+		Control.Mode == HwpModeHwp ? "HWP, IA32_HWP_REQUEST" : "legacy P-states, IA32_PERF_CTL",
+		pFeatures->Epp ? "yes" : "no", pFeatures->ActivityWindow ? "yes" : "no", pFeatures->PackageRequest ? "yes" : "no",
+		pFeatures->Turbo ? "yes" : "no", pFeatures->AperfMperf ? "yes" : "no");
+	if (pFeatures->Hwp && Control.Mode != HwpModeHwp)
+		printf("HWP is supported but not enabled by the OS, it is left that way as it cannot be disabled before reset.\n");
+
+	// 1. The state as found
+	INT Status = EXIT_FAILURE;
+	HWP_CLASS* pClasses = (HWP_CLASS*)calloc(uiCpuCount, sizeof(HWP_CLASS));
+	if (pClasses == NULL || strcmp(szCommand, "status") == 0x00) {
+		printf("\nCurrent state:\n");
+		HwpPrintState(&Control, NULL);
+		HwpClose(&Control);
+		free(pClasses);
+		return pClasses == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	// 2. Either an explicit request or a policy
+	BOOL bApplied = FALSE;
+	if (strcmp(szCommand, "set") == 0x00 && uiCount == 5 && HwpParseCpus(pArguments[0], uiCpuCount, HwpClassLatency, pClasses)) {
+		HWP_REQUEST Request = {
+			.Minimum = (UINT8)strtoul(pArguments[1], NULL, 0),
+			.Maximum = (UINT8)strtoul(pArguments[2], NULL, 0),
+			.Desired = (UINT8)strtoul(pArguments[3], NULL, 0),
+			.Epp = (UINT8)strtoul(pArguments[4], NULL, 0)
+		};
+		bApplied = TRUE;
+		for (UINT32 Cpu = 0x00; bApplied && Cpu < uiCpuCount; Cpu++) {
+			if (pClasses[Cpu] != HwpClassUnmanaged)
+				bApplied = HwpSetRequest(&Control, &Cpu, 0x01, &Request);
+		}
+		RtlZeroMemory(pClasses, uiCpuCount * sizeof(HWP_CLASS));
+	}
+	else if (strcmp(szCommand, "policy") == 0x00 && uiCount >= 1 && uiCount <= 3) {
+		HWP_POLICY Policy = {
+			.LatencyEpp = uiCount >= 2 ? (UINT8)strtoul(pArguments[1], NULL, 0) : HWP_EPP_PERFORMANCE,
+			.BatchEpp = uiCount >= 3 ? (UINT8)strtoul(pArguments[2], NULL, 0) : HWP_EPP_BALANCE_POWER
+		};
+		for (UINT32 Cpu = 0x00; Cpu < uiCpuCount; Cpu++)
+			pClasses[Cpu] = HwpClassBatch;
+		bApplied = HwpParseCpus(pArguments[0], uiCpuCount, HwpClassLatency, pClasses) && HwpApplyPolicy(&Control, pClasses, &Policy);
+	}
+	else {
+		printf("Invalid command or processors.\n");
+		HwpClose(&Control);
+		free(pClasses);
+		return EXIT_FAILURE;
+	}
+
+	// 3. Let the processors settle, show the outcome, and put everything back when asked to
+	if (bApplied) {
+		printf("\nApplied:\n");
+		HwpPrintState(&Control, pClasses);
+		printf("Press Enter to restore the original requests.\n");
+		(VOID)getchar();
+		Status = EXIT_SUCCESS;
+	}
+	else {
+		printf("Unable to write the requests, restoring them.\n");
+	}
+	HwpClose(&Control);
+	free(pClasses);
+	return Status;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command followed by its arguments.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	BOOL bMock = argc >= 2 && strncmp(argv[1], "mock-", 5) == 0x00;
+	LPCSTR szCommand = argc >= 2 ? argv[1] + (bMock ? 5 : 0) : "";
+	if (strcmp(szCommand, "status") != 0x00 && strcmp(szCommand, "set") != 0x00 && strcmp(szCommand, "policy") != 0x00) {
+		printf("Usage: %s [mock-]status\n", argv[0]);
+		printf("       %s [mock-]set <cpu,cpu,...|all> <minimum> <maximum> <desired> <epp>\n", argv[0]);
+		printf("       %s [mock-]policy <latency cpu,cpu,...> [latency epp] [batch epp]\n", argv[0]);
+		printf("Requests are restored when the tool exits. The mock backend emulates %u HWP processors.\n", HWP_MOCK_CPUS);
+		printf("The MSRs are accessed via the \\\\.\\KMsr driver on Windows and the msr module on Linux, run as administrator or root.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 1. Emulated processor
+	MSR_BACKEND Msr = { 0x00 };
+	if (bMock) {
+		static HWP_MOCK Mock;
+		HWP_FEATURES Features = { TRUE, TRUE, TRUE, TRUE, TRUE, TRUE, TRUE };
+		Mock.Start = ThreadGetTime();
+		if (!MsrMockOpen(&Msr, HWP_MOCK_CPUS, HwpMockHandler, &Mock))
+			return EXIT_FAILURE;
+		for (UINT32 Cpu = 0x00; Cpu < HWP_MOCK_CPUS; Cpu++) {
+			UINT64 Capabilities = HwpMockCapabilities(Cpu);
+			HWP_REQUEST Request = { (UINT8)(Capabilities >> 24), (UINT8)Capabilities, 0x00, HWP_EPP_BALANCE_PERFORMANCE, 0x00, FALSE };
+			(VOID)MsrWrite(&Msr, Cpu, IA32_HWP_REQUEST, HwpEncodeRequest(&Request, 0x00));
+		}
+		INT Status = HwpRun(&Msr, &Features, HWP_MOCK_CPUS, szCommand, &argv[2], (UINT32)argc - 2);
+		MsrClose(&Msr);
+		return Status;
+	}
+
+	// 2. Real processor
+	CPUID_BACKEND Cpuid = { 0x00 };
+	HWP_FEATURES Features = { 0x00 };
+	if (!CpuidOpen(&Cpuid)) {
+		printf("Unable to open the CPUID backend.\n");
+		return EXIT_FAILURE;
+	}
+	BOOL bSupported = HwpQuery(&Cpuid, &Features);
+	UINT32 uiCpuCount = Cpuid.CpuCount;
+	CpuidClose(&Cpuid);
+	if (!bSupported) {
+		printf("Neither HWP nor Enhanced SpeedStep is supported by this processor.\n");
+		return EXIT_FAILURE;
+	}
+	if (!MsrOpen(&Msr)) {
+		printf("Unable to open the MSR backend, run as administrator or root.\n");
+		return EXIT_FAILURE;
+	}
+	INT Status = HwpRun(&Msr, &Features, uiCpuCount, szCommand, &argv[2], (UINT32)argc - 2);
+	MsrClose(&Msr);
+	return Status;
+}
@@ -0,0 +1,164 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid.h"
+#include "mtrr.h"
+
+/// <summary>
+/// Get the width of the physical addresses.
+/// </summary>
+static UINT32 MtrrGetPhysicalBits() {
+	CPUID_BACKEND Backend = { 0x00 };
+	UINT Registers[4] = { 0x00 };
+	UINT32 uiPhysicalBits = 0x00;
+	if (CpuidOpen(&Backend)) {
+		if (CpuidBackendQuery(&Backend, 0x00, CPUID_LEAF_EXTENDED_MAXIMUM, 0x00, Registers) && Registers[0] >= CPUID_LEAF_ADDRESS_SIZES
+			&& CpuidBackendQuery(&Backend, 0x00, CPUID_LEAF_ADDRESS_SIZES, 0x00, Registers))
+			uiPhysicalBits = Registers[0] & 0xFF;
+		CpuidClose(&Backend);
+	}
+	return uiPhysicalBits;
+}
+
+/// <summary>
+/// Fill a mock backend with the MTRRs a typical firmware programs: WB by default, an UC hole below 4 GiB for the
+/// devices and the Linux layout of the PAT, where entry 1 is WC.
+/// </summary>
+static BOOL MtrrMockOpen(
+	_Out_ PMSR_BACKEND pMsr
+) {
+	if (!MsrMockOpen(pMsr, 0x01, NULL, NULL))
+		return FALSE;
+	BOOL bSuccess = MsrWrite(pMsr, 0x00, IA32_MTRRCAP, 0x0D0A)  // 10 variable MTRRs, fixed, WC, SMRR
+		&& MsrWrite(pMsr, 0x00, IA32_MTRR_DEF_TYPE, 0x0C06)      // Enabled, fixed enabled, WB
+		&& MsrWrite(pMsr, 0x00, IA32_PAT, 0x0007010600070106ULL)
+		&& MsrWrite(pMsr, 0x00, IA32_MTRR_FIX64K, 0x0606060606060606ULL)
+		&& MsrWrite(pMsr, 0x00, IA32_MTRR_FIX16K, 0x0606060606060606ULL)
+		&& MsrWrite(pMsr, 0x00, IA32_MTRR_FIX16K + 1, 0x0000000000000000ULL);
+	for (UINT32 Index = 0x00; bSuccess && Index < 8; Index++)
+		bSuccess = MsrWrite(pMsr, 0x00, IA32_MTRR_FIX4K + Index, Index < 4 ? 0x0505050505050505ULL : 0x0606060606060606ULL);
+
+	// 3 GiB to 4 GiB is UC, a 256 MiB frame buffer inside it is left to the PAT
+	bSuccess = bSuccess
+		&& MsrWrite(pMsr, 0x00, IA32_MTRR_PHYSBASE0, 0xC0000000ULL | MEMORY_TYPE_UC)
+		&& MsrWrite(pMsr, 0x00, IA32_MTRR_PHYSBASE0 + 1, 0x7FC0000800ULL);
+	for (UINT32 Index = 1; bSuccess && Index < 10; Index++)
+		bSuccess = MsrWrite(pMsr, 0x00, IA32_MTRR_PHYSBASE0 + Index * 2, 0x00) && MsrWrite(pMsr, 0x00, IA32_MTRR_PHYSBASE0 + Index * 2 + 1, 0x00);
+	if (!bSuccess)
+		MsrClose(pMsr);
+	return bSuccess;
+}
+
+/// <summary>
+/// Print the MTRRs, the map of the physical address space and the PAT.
+/// </summary>
+static VOID MtrrPrint(
+	_In_ const MTRR_MAP* pMap
+) {
+	printf("[*] MTRRs %s, fixed ranges %s, default type %s, %u variable range(s), %u-bit physical addresses\n",
+		pMap->DefaultType.elem.Enable ? "enabled" : "disabled",
+		pMap->Capabilities.elem.Fixed && pMap->DefaultType.elem.FixedEnable ? "enabled" : "disabled",
+		MtrrGetTypeName((UINT8)pMap->DefaultType.elem.Type), pMap->VariableCount, pMap->PhysicalBits);
+
+	for (UINT32 Index = 0x00; Index < pMap->VariableCount; Index++) {
+		const MTRR_VARIABLE* pVariable = &pMap->Variables[Index];
+		if (pVariable->Valid) {
+			printf("    - Variable %-2u base 0x%012llx mask 0x%012llx %s%s\n", Index, (unsigned long long)pVariable->Base,
+				(unsigned long long)pVariable->Mask, MtrrGetTypeName(pVariable->Type), pVariable->Contiguous ? "" : " (non-contiguous)");
+		}
+	}
+
+	printf("\n[*] Physical address space%s\n", pMap->bIrregular ? " (irregular MTRRs, overlaps resolved as UC)" : "");
+	for (UINT32 Index = 0x00; Index < pMap->RangeCount; Index++) {
+		printf("    - 0x%012llx-0x%012llx %s\n", (unsigned long long)pMap->Ranges[Index].Start,
+			(unsigned long long)pMap->Ranges[Index].End - 1, MtrrGetTypeName(pMap->Ranges[Index].Type));
+	}
+
+	printf("\n[*] PAT 0x%016llx:", (unsigned long long)pMap->Pat);
+	for (UINT32 Index = 0x00; Index < 8; Index++)
+		printf(" %u=%s", Index, MtrrGetTypeName(MtrrGetPatType(pMap->Pat, Index)));
+	printf("\n");
+}
+
+/// <summary>
+/// Print the effective memory type of a range for one or every PAT entry.
+/// </summary>
+static BOOL MtrrPrintRange(
+	_In_ const MTRR_MAP* pMap,
+	_In_ UINT64          Start,
+	_In_ UINT64          End,
+	_In_ UINT32          uiPatIndex
+) {
+	UINT8 Type = MEMORY_TYPE_MIXED;
+	if (!MtrrLookup(pMap, Start, End, &Type)) {
+		printf("Invalid range 0x%llx-0x%llx.\n", (unsigned long long)Start, (unsigned long long)End);
+		return FALSE;
+	}
+	printf("\n[*] Range 0x%012llx-0x%012llx, MTRR type %s\n", (unsigned long long)Start, (unsigned long long)End - 1, MtrrGetTypeName(Type));
+	for (UINT32 Index = 0x00; Type == MEMORY_TYPE_MIXED && Index < pMap->RangeCount; Index++) {
+		if (pMap->Ranges[Index].End > Start && pMap->Ranges[Index].Start < End) {
+			printf("    - Covers 0x%012llx-0x%012llx %s\n", (unsigned long long)pMap->Ranges[Index].Start,
+				(unsigned long long)pMap->Ranges[Index].End - 1, MtrrGetTypeName(pMap->Ranges[Index].Type));
+		}
+	}
+	for (UINT32 Index = 0x00; Index < 8; Index++) {
+		if (uiPatIndex < 8 && Index != uiPatIndex)
+			continue;
+		UINT8 PatType = MtrrGetPatType(pMap->Pat, Index);
+		printf("    - PAT entry %u (PAT=%u PCD=%u PWT=%u) %-3s -> effective %s\n", Index, (Index >> 2) & 1, (Index >> 1) & 1, Index & 1,
+			MtrrGetTypeName(PatType), MtrrGetTypeName(MtrrCombine(Type, PatType)));
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Optional "mock", then an optional range and PAT index.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	BOOL bMock = argc >= 2 && strcmp(argv[1], "mock") == 0x00;
+	INT First = bMock ? 2 : 1;
+	if (argc - First != 0 && argc - First != 2 && argc - First != 3) {
+		printf("Usage: %s [mock] [<start> <end> [PAT index]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// 1. Open the backend
+	MSR_BACKEND Msr = { 0x00 };
+	if (bMock ? !MtrrMockOpen(&Msr) : !MsrOpen(&Msr)) {
+		printf("Unable to open the MSR backend.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 2. Build the map
+	MTRR_MAP Map = { 0x00 };
+	if (!MtrrBuild(&Msr, 0x00, bMock ? 39 : MtrrGetPhysicalBits(), &Map)) {
+		printf("Unable to read the MTRRs (backend: %s).\n", Msr.Name);
+		MsrClose(&Msr);
+		return EXIT_FAILURE;
+	}
+	MtrrPrint(&Map);
+
+	// 3. Resolve the range
+	INT Status = EXIT_SUCCESS;
+	if (argc - First >= 2) {
+		UINT64 Start = strtoull(argv[First], NULL, 0);
+		UINT64 End = strtoull(argv[First + 1], NULL, 0);
+		UINT32 uiPatIndex = argc - First == 3 ? (UINT32)strtoul(argv[First + 2], NULL, 0) : 8;
+		if (!MtrrPrintRange(&Map, Start, End, uiPatIndex))
+			Status = EXIT_FAILURE;
+	}
+
+	MtrrFree(&Map);
+	MsrClose(&Msr);
+	return Status;
+}
@@ -0,0 +1,418 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid.h"
+#include "ctlreg.h"
+#include "msr.h"
+#include "mtrr.h"
+#include "paging.h"
+#include "thread.h"
+
+/// Value of IA32_PAT at reset, used when the MSR cannot be read
+#define PAGING_DEFAULT_PAT 0x0007040600070406ULL
+
+/// Layout of the address space of the mock: a 64 MiB heap of 4 KiB pages, 2 MiB pages, a hole and 4 KiB pages
+#define MOCK_IMAGE_SIZE  (4 * 1024 * 1024)
+#define MOCK_HEAP        0x00007F0000000000ULL
+#define MOCK_HEAP_SIZE   (64ULL * 1024 * 1024)
+#define MOCK_SMALL_END   (8ULL * 1024 * 1024)
+#define MOCK_LARGE_END   (56ULL * 1024 * 1024)
+#define MOCK_HOLE_END    (58ULL * 1024 * 1024)
+#define MOCK_HEAP_FRAME  0x0000000100000000ULL
+#define MOCK_KERNEL      0xFFFF800040000000ULL
+#define MOCK_KERNEL_FRAME 0x0000000040000000ULL
+
+/// Number of random addresses translated by the mock
+#define MOCK_BATCH 0x10000
+
+/// <summary>
+/// Print the coverage of a range by size of page.
+/// </summary>
+static VOID PagingPrintCoverage(
+	_In_ const PAGING_COVERAGE* pCoverage,
+	_In_ UINT64 Length
+) {
+	const struct {
+		LPCSTR Name;
+		UINT64 Bytes;
+	} Rows[] = {
+		{ "1 GiB pages", pCoverage->Bytes1G },
+		{ "2 MiB pages", pCoverage->Bytes2M },
+		{ "4 KiB pages", pCoverage->Bytes4K },
+		{ "Unknown size", pCoverage->BytesUnknown },
+		{ "Not present", pCoverage->BytesNotPresent },
+		{ "Unreadable", pCoverage->BytesFailed }
+	};
+	for (UINT32 Index = 0x00; Index < (UINT32)ARRAYSIZE(Rows); Index++) {
+		if (Rows[Index].Bytes != 0x00 || Index < 0x03)
+			printf("  - %-13s %10.2f MiB %6.2f%%\n", Rows[Index].Name, Rows[Index].Bytes / 1048576.0, Length ? 100.0 * Rows[Index].Bytes / Length : 0.0);
+	}
+}
+
+/// <summary>
+/// Print the counters of a walker.
+/// </summary>
+static VOID PagingPrintStatistics(
+	_In_ const PAGING_STATISTICS* pStatistics,
+	_In_ UINT64 Nanoseconds
+) {
+	printf("  %llu translation(s) in %.3f ms: %llu TLB hit(s), %llu paging-structure cache hit(s), %llu entry read(s), %llu table read(s), %llu fault(s)\n",
+		(unsigned long long)pStatistics->Translations,
+		Nanoseconds / 1000000.0,
+		(unsigned long long)pStatistics->TlbHits,
+		(unsigned long long)pStatistics->StructureHits,
+		(unsigned long long)pStatistics->EntryReads,
+		(unsigned long long)pStatistics->TableReads,
+		(unsigned long long)pStatistics->Faults);
+}
+
+/// <summary>
+/// Print a translation.
+/// </summary>
+static VOID PagingPrintTranslation(
+	_In_ const PAGING_TRANSLATION* pTranslation,
+	_In_ UINT64 Pat
+) {
+	if (pTranslation->Status == PagingStatusNotPresent || pTranslation->Status == PagingStatusReserved) {
+		printf("  0x%016llx %s at level %u\n", (unsigned long long)pTranslation->VirtualAddress, PagingGetStatusName(pTranslation->Status), pTranslation->Level);
+		return;
+	}
+	if (pTranslation->Status != PagingStatusOk) {
+		printf("  0x%016llx %s\n", (unsigned long long)pTranslation->VirtualAddress, PagingGetStatusName(pTranslation->Status));
+		return;
+	}
+
+	// Sources translating themselves do not report the leaf entry, hence neither the rights nor the PAT index
+	if (pTranslation->Entry == 0x00) {
+		printf("  0x%016llx -> 0x%013llx %4llu KiB\n",
+			(unsigned long long)pTranslation->VirtualAddress,
+			(unsigned long long)pTranslation->PhysicalAddress,
+			(unsigned long long)(pTranslation->PageSize / 1024));
+		return;
+	}
+	printf("  0x%016llx -> 0x%013llx %4llu KiB %s %s %s %s %s\n",
+		(unsigned long long)pTranslation->VirtualAddress,
+		(unsigned long long)pTranslation->PhysicalAddress,
+		(unsigned long long)(pTranslation->PageSize / 1024),
+		(pTranslation->Flags & PAGING_WRITABLE) ? "RW" : "R-",
+		(pTranslation->Flags & PAGING_USER) ? "user" : "supv",
+		(pTranslation->Flags & PAGING_NX) ? "NX" : "X ",
+		(pTranslation->Flags & PAGING_GLOBAL) ? "G" : "-",
+		MtrrGetTypeName(MtrrGetPatType(Pat, pTranslation->PatIndex)));
+}
+
+/// <summary>
+/// Expected physical address of an address of the mock heap, zero in the hole.
+/// </summary>
+static UINT64 PagingMockExpected(
+	_In_ UINT64 VirtualAddress
+) {
+	UINT64 Offset = VirtualAddress - MOCK_HEAP;
+	if (Offset >= MOCK_LARGE_END && Offset < MOCK_HOLE_END)
+		return 0x00;
+	return MOCK_HEAP_FRAME + Offset;
+}
+
+/// <summary>
+/// Build a synthetic address space, audit the heap and translate random addresses one by one and in a batch.
+/// </summary>
+static INT PagingMock(
+	_In_ BOOL bFiveLevel
+) {
+	// 1. Heap of mixed pages, a cacheable-disabled page and a supervisor 1 GiB page
+	PAGING_IMAGE Image = { 0x00 };
+	if (!PagingImageCreate(&Image, MOCK_IMAGE_SIZE, bFiveLevel))
+		return EXIT_FAILURE;
+	BOOL bMapped = TRUE;
+	for (UINT64 Offset = 0x00; Offset < MOCK_HEAP_SIZE; ) {
+		UINT64 Size = Offset >= MOCK_SMALL_END && Offset < MOCK_HOLE_END ? PAGING_SIZE_2M : PAGING_SIZE_4K;
+		UINT64 Flags = PAGING_WRITABLE | PAGING_USER | PAGING_NX | PAGING_ACCESSED;
+		if (Offset == MOCK_HOLE_END)
+			Flags |= PAGING_PCD;
+		if (Offset < MOCK_LARGE_END || Offset >= MOCK_HOLE_END)
+			bMapped &= PagingImageMap(&Image, MOCK_HEAP + Offset, MOCK_HEAP_FRAME + Offset, Size, Flags);
+		Offset += Size;
+	}
+	bMapped &= PagingImageMap(&Image, MOCK_KERNEL, MOCK_KERNEL_FRAME, PAGING_SIZE_1G, PAGING_WRITABLE | PAGING_GLOBAL);
+	if (!bMapped) {
+		printf("Unable to build the synthetic image.\n");
+		PagingImageFree(&Image);
+		return EXIT_FAILURE;
+	}
+	printf("Synthetic %u-level address space, %llu KiB of paging structures.\n\n", bFiveLevel ? 5 : 4, (unsigned long long)((Image.Next - PAGING_SIZE_4K) / 1024));
+
+	PAGING_MEMORY Memory = { 0x00 };
+	PPAGING_WALKER pWalker = (PPAGING_WALKER)malloc(sizeof(PAGING_WALKER));
+	PUINT64 pAddresses = (PUINT64)malloc(MOCK_BATCH * sizeof(UINT64));
+	PPAGING_TRANSLATION pTranslations = (PPAGING_TRANSLATION)malloc(MOCK_BATCH * sizeof(PAGING_TRANSLATION));
+	PagingImageOpen(&Memory, &Image);
+	if (pWalker == NULL || pAddresses == NULL || pTranslations == NULL || !PagingOpen(pWalker, &Memory, Image.Cr3, bFiveLevel)) {
+		free(pWalker);
+		free(pAddresses);
+		free(pTranslations);
+		PagingImageFree(&Image);
+		return EXIT_FAILURE;
+	}
+
+	// 2. A few translations
+	const UINT64 Samples[] = { MOCK_HEAP + 0x1234, MOCK_HEAP + MOCK_SMALL_END + 0x12345, MOCK_HEAP + MOCK_LARGE_END, MOCK_HEAP + MOCK_HOLE_END + 0x10, MOCK_KERNEL + 0x123456, 0x0000800000000000ULL };
+	printf("Translations:\n");
+	for (UINT32 Index = 0x00; Index < (UINT32)ARRAYSIZE(Samples); Index++) {
+		PAGING_TRANSLATION Translation = { 0x00 };
+		(VOID)PagingTranslate(pWalker, Samples[Index], &Translation);
+		PagingPrintTranslation(&Translation, PAGING_DEFAULT_PAT);
+	}
+
+	// 3. Coverage of the heap
+	PAGING_COVERAGE Coverage = { 0x00 };
+	PagingFlush(pWalker);
+	RtlZeroMemory(&pWalker->Statistics, sizeof(PAGING_STATISTICS));
+	UINT64 Start = ThreadGetTime();
+	PagingCoverage(pWalker, MOCK_HEAP, MOCK_HEAP_SIZE, &Coverage);
+	UINT64 Elapsed = ThreadGetTime() - Start;
+	printf("\nCoverage of the %llu MiB heap:\n", (unsigned long long)(MOCK_HEAP_SIZE >> 20));
+	PagingPrintCoverage(&Coverage, MOCK_HEAP_SIZE);
+	PagingPrintStatistics(&pWalker->Statistics, Elapsed);
+
+	// 4. Random addresses of the heap, one by one then in a batch, both checked against the layout
+	UINT64 Seed = 0x2545F4914F6CDD1DULL;
+	for (UINT32 Index = 0x00; Index < MOCK_BATCH; Index++) {
+		Seed ^= Seed << 13;
+		Seed ^= Seed >> 7;
+		Seed ^= Seed << 17;
+		pAddresses[Index] = MOCK_HEAP + Seed % MOCK_HEAP_SIZE;
+	}
+	for (UINT32 Pass = 0x00; Pass < 0x02; Pass++) {
+		PagingFlush(pWalker);
+		RtlZeroMemory(&pWalker->Statistics, sizeof(PAGING_STATISTICS));
+		Start = ThreadGetTime();
+		if (Pass == 0x00) {
+			for (UINT32 Index = 0x00; Index < MOCK_BATCH; Index++)
+				(VOID)PagingTranslate(pWalker, pAddresses[Index], &pTranslations[Index]);
+		}
+		else {
+			(VOID)PagingTranslateBatch(pWalker, pAddresses, MOCK_BATCH, pTranslations);
+		}
+		Elapsed = ThreadGetTime() - Start;
+
+		UINT32 Mismatches = 0x00;
+		for (UINT32 Index = 0x00; Index < MOCK_BATCH; Index++) {
+			UINT64 Expected = PagingMockExpected(pAddresses[Index]);
+			UINT64 Actual = pTranslations[Index].Status == PagingStatusOk ? pTranslations[Index].PhysicalAddress : 0x00;
+			Mismatches += Actual != Expected;
+		}
+		printf("\n%u random address(es) of the heap, %s, %u mismatch(es):\n", MOCK_BATCH, Pass == 0x00 ? "one by one" : "in a batch", Mismatches);
+		PagingPrintStatistics(&pWalker->Statistics, Elapsed);
+	}
+
+	free(pWalker);
+	free(pAddresses);
+	free(pTranslations);
+	PagingMemoryClose(&Memory);
+	PagingImageFree(&Image);
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Allocate and touch a heap, with huge or large pages if requested.
+/// </summary>
+static PVOID PagingAllocate(
+	_In_ SIZE_T Size,
+	_In_ BOOL   bLarge
+) {
+	PUINT8 pHeap = NULL;
+#if defined(_WIN32)
+	// Large pages need SeLockMemoryPrivilege, fall back to the default pages without it
+	SIZE_T Minimum = GetLargePageMinimum();
+	if (bLarge && Minimum != 0x00)
+		pHeap = (PUINT8)VirtualAlloc(NULL, (Size + Minimum - 1) & ~(Minimum - 1), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	if (pHeap == NULL)
+		pHeap = (PUINT8)VirtualAlloc(NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	pHeap = (PUINT8)mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0x00);
+	if (pHeap == MAP_FAILED)
+		return NULL;
+	if (bLarge)
+		(VOID)madvise(pHeap, Size, MADV_HUGEPAGE);
+#endif
+	for (SIZE_T Offset = 0x00; pHeap != NULL && Offset < Size; Offset += PAGING_SIZE_4K)
+		pHeap[Offset] = 0x01;
+	return pHeap;
+}
+
+/// <summary>
+/// Release a heap of PagingAllocate.
+/// </summary>
+static VOID PagingRelease(
+	_In_ PVOID  pHeap,
+	_In_ SIZE_T Size
+) {
+#if defined(_WIN32)
+	(VOID)Size;
+	VirtualFree(pHeap, 0x00, MEM_RELEASE);
+#else
+	munmap(pHeap, Size);
+#endif
+}
+
+#if !defined(_WIN32)
+/// <summary>
+/// Bytes of transparent huge pages of the mappings overlapping a range, from /proc/self/smaps. Readable without
+/// privilege, but only per mapping: a mapping partly inside the range is counted whole.
+/// </summary>
+static BOOL PagingGetAnonHugePages(
+	_In_  UINT64  Start,
+	_In_  UINT64  Length,
+	_Out_ PUINT64 pBytes
+) {
+	*pBytes = 0x00;
+	FILE* pFile = fopen("/proc/self/smaps", "r");
+	if (pFile == NULL)
+		return FALSE;
+
+	// 1. A mapping header is followed by its fields, one per line
+	CHAR szLine[0x200] = { 0x00 };
+	BOOL bOverlap = FALSE;
+	while (fgets(szLine, sizeof(szLine), pFile) != NULL) {
+		unsigned long long Begin = 0x00;
+		unsigned long long End = 0x00;
+		unsigned long long Kib = 0x00;
+		if (sscanf(szLine, "%llx-%llx ", &Begin, &End) == 2)
+			bOverlap = Begin < Start + Length && End > Start;
+		else if (bOverlap && sscanf(szLine, "AnonHugePages: %llu kB", &Kib) == 1)
+			*pBytes += (UINT64)Kib * 1024;
+	}
+	fclose(pFile);
+	return TRUE;
+}
+#endif
+
+/// <summary>
+/// Audit a range of the current process.
+/// </summary>
+static INT PagingAudit(
+	_In_ UINT64 Start,
+	_In_ UINT64 Length
+) {
+	PAGING_MEMORY Memory = { 0x00 };
+	if (!PagingMemoryOpen(&Memory)) {
+		printf("Unable to open the source of the paging structures.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 1. Linux and Windows enable 5-level paging whenever the processor supports it. The driver also
+	// provides CR4.LA57 and the CR3 of this process, the only address space whose paging structures it reads.
+	BOOL bFiveLevel = CpuidGetInformation()->ExtendedEcx.elem.LA57;
+	UINT64 Cr3 = 0x00;
+	CTLREG_SOURCE Ctlreg = { 0x00 };
+	if (Memory.Read != NULL && CtlregOpen(&Ctlreg, NULL)) {
+		CTLREG_STATE Control = { 0x00 };
+		UINT32 uiCaptured = 0x00;
+		if (CtlregCapture(&Ctlreg, CTLREG_CURRENT_CPU, &Control, 0x01, &uiCaptured) && (Control.Valid & CTLREG_VALID_CR)) {
+			CTLREG_CR3 Current = { .value = Control.Cr3 };
+			CTLREG_CR4 Cr4 = { .value = Control.Cr4 };
+			bFiveLevel = (BOOL)Cr4.elem.LA57;
+			Cr3 = (UINT64)Current.elem.Base << 12;
+		}
+		CtlregClose(&Ctlreg);
+	}
+	if (Memory.Read != NULL && Cr3 == 0x00) {
+		printf("Unable to get the CR3 of this process from the %s.\n", Memory.Name);
+		PagingMemoryClose(&Memory);
+		return EXIT_FAILURE;
+	}
+	PPAGING_WALKER pWalker = (PPAGING_WALKER)malloc(sizeof(PAGING_WALKER));
+	if (pWalker == NULL || !PagingOpen(pWalker, &Memory, Cr3, bFiveLevel)) {
+		free(pWalker);
+		PagingMemoryClose(&Memory);
+		return EXIT_FAILURE;
+	}
+
+	// 2. Coverage
+	PAGING_COVERAGE Coverage = { 0x00 };
+	UINT64 Begin = ThreadGetTime();
+	PagingCoverage(pWalker, Start, Length, &Coverage);
+	UINT64 Elapsed = ThreadGetTime() - Begin;
+	printf("Coverage of 0x%016llx-0x%016llx via %s, %u-level paging:\n", (unsigned long long)Start, (unsigned long long)(Start + Length), Memory.Name, bFiveLevel ? 5 : 4);
+	PagingPrintCoverage(&Coverage, Length);
+	PagingPrintStatistics(&pWalker->Statistics, Elapsed);
+	if (Coverage.BytesUnknown != 0x00) {
+		printf("The page sizes are only reported to root, via /proc/kpageflags: without CAP_SYS_ADMIN every page is unknown.\n");
+#if !defined(_WIN32)
+		UINT64 HugeBytes = 0x00;
+		if (PagingGetAnonHugePages(Start, Length, &HugeBytes))
+			printf("The mapping(s) overlapping the range hold %.2f MiB of transparent huge pages, per /proc/self/smaps.\n", HugeBytes / 1048576.0);
+#endif
+	}
+
+	// 3. First page, with its memory type if IA32_PAT can be read
+	MSR_BACKEND Msr = { 0x00 };
+	UINT64 Pat = PAGING_DEFAULT_PAT;
+	if (MsrOpen(&Msr)) {
+		if (!MsrRead(&Msr, MSR_CURRENT_CPU, IA32_PAT, &Pat))
+			Pat = PAGING_DEFAULT_PAT;
+		MsrClose(&Msr);
+	}
+	PAGING_TRANSLATION Translation = { 0x00 };
+	(VOID)PagingTranslate(pWalker, Start, &Translation);
+	printf("\nFirst page:\n");
+	PagingPrintTranslation(&Translation, Pat);
+
+	free(pWalker);
+	PagingMemoryClose(&Memory);
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command followed by its arguments.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	LPCSTR szCommand = argc >= 2 ? argv[1] : "";
+
+	// 1. Synthetic address space
+	if (strcmp(szCommand, "mock") == 0x00 && (argc == 2 || (argc == 3 && strcmp(argv[2], "la57") == 0x00)))
+		return PagingMock(argc == 3);
+
+	// 2. Heap of this process
+	if (strcmp(szCommand, "heap") == 0x00 && (argc == 3 || (argc == 4 && strcmp(argv[3], "large") == 0x00))) {
+		BOOL bLarge = argc == 4;
+		SIZE_T Size = (SIZE_T)strtoull(argv[2], NULL, 10) * 1024 * 1024;
+		PVOID pHeap = Size != 0x00 ? PagingAllocate(Size, bLarge) : NULL;
+		if (pHeap == NULL) {
+			printf("Unable to allocate the heap.\n");
+			return EXIT_FAILURE;
+		}
+		INT Status = PagingAudit((UINT64)(ULONG_PTR)pHeap, Size);
+		PagingRelease(pHeap, Size);
+		return Status;
+	}
+
+	// 3. Any range
+	if (strcmp(szCommand, "range") == 0x00 && argc == 4) {
+		UINT64 Start = strtoull(argv[2], NULL, 16);
+		UINT64 Length = strtoull(argv[3], NULL, 0);
+		return PagingAudit(Start, Length);
+	}
+
+	printf("Usage: %s mock [la57]\n", argv[0]);
+	printf("       %s heap <MiB> [large]\n", argv[0]);
+	printf("       %s range <start> <length>\n", argv[0]);
+	printf("On Windows, the paging structures of this process are read via the \\\\.\\KSeg driver, run as administrator.\n");
+	printf("On Linux, the translations of this process come from /proc/self/pagemap, the page sizes from /proc/kpageflags as root.\n");
+	printf("The batch of the mock saves table reads, which pays off with the driver: each read is an IOCTL.\n");
+	return EXIT_FAILURE;
+}
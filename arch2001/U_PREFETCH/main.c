@@ -0,0 +1,328 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prefetch.h"
+#include "thread.h"
+
+/// Memory walked by every thread of the built-in workloads, larger than any last level cache
+#define PREFETCH_WORKLOAD_SIZE (64 * 1024 * 1024)
+
+/// Runs per configuration of the comparison
+#define PREFETCH_RUNS 5
+
+/// Largest number of configurations compared at once
+#define PREFETCH_MAX_CONFIGURATIONS 16
+
+/// <summary>
+/// Memory of the built-in workloads, one buffer per thread.
+/// </summary>
+typedef struct _PREFETCH_BUFFERS {
+	PUINT64* Buffers;
+	UINT32   Count;
+	UINT64   Elements;   // UINT64 elements per buffer.
+} PREFETCH_BUFFERS, * PPREFETCH_BUFFERS;
+
+/// <summary>
+/// Dependent loads in a random cycle: no prefetcher can guess the next line, only waste bandwidth.
+/// </summary>
+static UINT64 PrefetchWorkloadRandom(
+	_In_ PVOID  Context,
+	_In_ UINT32 uiThread
+) {
+	PPREFETCH_BUFFERS pBuffers = (PPREFETCH_BUFFERS)Context;
+	PUINT64 pBuffer = pBuffers->Buffers[uiThread];
+	UINT64 Next = 0x00;
+	for (UINT64 Index = 0x00; Index < pBuffers->Elements; Index++)
+		Next = pBuffer[Next];
+
+	// Keep the chain alive
+	pBuffer[0] += Next == (UINT64)-1;
+	return pBuffers->Elements;
+}
+
+/// <summary>
+/// Sequential loads: the case the stream and adjacent line prefetchers exist for.
+/// </summary>
+static UINT64 PrefetchWorkloadStream(
+	_In_ PVOID  Context,
+	_In_ UINT32 uiThread
+) {
+	PPREFETCH_BUFFERS pBuffers = (PPREFETCH_BUFFERS)Context;
+	volatile UINT64* pBuffer = pBuffers->Buffers[uiThread];
+	UINT64 Sum = 0x00;
+	for (UINT64 Index = 0x00; Index < pBuffers->Elements; Index++)
+		Sum += pBuffer[Index];
+	pBuffer[0] += Sum == (UINT64)-1;
+	return pBuffers->Elements;
+}
+
+/// <summary>
+/// Built-in workload of the comparison.
+/// </summary>
+typedef struct _PREFETCH_BUILTIN {
+	LPCSTR            Name;
+	LPCSTR            Description;
+	PREFETCH_WORKLOAD Routine;
+	BOOL              bRandom;   // The buffer holds a random cycle of indices.
+} PREFETCH_BUILTIN;
+
+static const PREFETCH_BUILTIN g_Workloads[] = {
+	{ "random", "pointer chase through a random cycle", PrefetchWorkloadRandom, TRUE },
+	{ "stream", "sequential sum",                       PrefetchWorkloadStream, FALSE }
+};
+
+/// <summary>
+/// Allocate the memory of every thread, as a random cycle when chasing pointers.
+/// </summary>
+static BOOL PrefetchAllocateBuffers(
+	_Out_ PPREFETCH_BUFFERS pBuffers,
+	_In_  UINT32            uiCount,
+	_In_  BOOL              bRandom
+) {
+	RtlZeroMemory(pBuffers, sizeof(PREFETCH_BUFFERS));
+	pBuffers->Elements = PREFETCH_WORKLOAD_SIZE / sizeof(UINT64);
+	pBuffers->Buffers = (PUINT64*)calloc(uiCount, sizeof(PUINT64));
+	if (pBuffers->Buffers == NULL)
+		return FALSE;
+	pBuffers->Count = uiCount;
+
+	UINT64 Seed = 0x9E3779B97F4A7C15;
+	for (UINT32 Thread = 0x00; Thread < uiCount; Thread++) {
+		PUINT64 pBuffer = (PUINT64)malloc(PREFETCH_WORKLOAD_SIZE);
+		if (pBuffer == NULL)
+			return FALSE;
+		pBuffers->Buffers[Thread] = pBuffer;
+		for (UINT64 Index = 0x00; Index < pBuffers->Elements; Index++)
+			pBuffer[Index] = Index;
+		if (!bRandom)
+			continue;
+
+		// Sattolo's algorithm, a single cycle through every element
+		for (UINT64 Index = pBuffers->Elements - 1; Index > 0x00; Index--) {
+			Seed ^= Seed << 13;
+			Seed ^= Seed >> 7;
+			Seed ^= Seed << 17;
+			UINT64 Other = Seed % Index;
+			UINT64 Value = pBuffer[Index];
+			pBuffer[Index] = pBuffer[Other];
+			pBuffer[Other] = Value;
+		}
+	}
+	return TRUE;
+}
+
+static VOID PrefetchFreeBuffers(
+	_Inout_ PPREFETCH_BUFFERS pBuffers
+) {
+	for (UINT32 Thread = 0x00; pBuffers->Buffers != NULL && Thread < pBuffers->Count; Thread++)
+		free(pBuffers->Buffers[Thread]);
+	free(pBuffers->Buffers);
+	RtlZeroMemory(pBuffers, sizeof(PREFETCH_BUFFERS));
+}
+
+/// <summary>
+/// Parse "all" or a comma separated list of processors.
+/// </summary>
+static BOOL PrefetchParseCpus(
+	_In_  const PREFETCH_CONTROL* pControl,
+	_In_  LPCSTR                  szArgument,
+	_Out_ PUINT32*                ppCpus,
+	_Out_ PUINT32                 pCount
+) {
+	*pCount = 0x00;
+	UINT32 uiCount = strcmp(szArgument, "all") == 0x00 ? pControl->CpuCount : 0x01;
+	for (LPCSTR szChar = szArgument; uiCount != pControl->CpuCount && *szChar != '\0'; szChar++)
+		uiCount += *szChar == ',';
+	*ppCpus = (PUINT32)calloc(uiCount, sizeof(UINT32));
+	if (*ppCpus == NULL)
+		return FALSE;
+
+	if (strcmp(szArgument, "all") == 0x00) {
+		for (; *pCount < uiCount; (*pCount)++)
+			(*ppCpus)[*pCount] = *pCount;
+		return TRUE;
+	}
+	for (LPSTR szEnd = (LPSTR)szArgument; *pCount < uiCount; szArgument = szEnd + 1) {
+		UINT32 Cpu = (UINT32)strtoul(szArgument, &szEnd, 10);
+		if (szEnd == szArgument || (*szEnd != ',' && *szEnd != '\0') || Cpu >= pControl->CpuCount)
+			return FALSE;
+		(*ppCpus)[(*pCount)++] = Cpu;
+		if (*szEnd == '\0')
+			break;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Print the prefetchers of the vendor and the configuration of every processor.
+/// </summary>
+static INT PrefetchList(
+	_In_ PPREFETCH_CONTROL pControl
+) {
+	printf("Prefetchers controlled by MSR 0x%08x:\n", pControl->Address);
+	for (UINT32 Index = 0x00; Index < pControl->Count; Index++) {
+		UINT32 Bit = 0x00;
+		while ((pControl->Prefetchers[Index].Bit >> Bit) > 0x01)
+			Bit++;
+		printf("  - %-12s bit %2u  %s\n", pControl->Prefetchers[Index].Name, Bit, pControl->Prefetchers[Index].Description);
+	}
+
+	printf("\nDisabled prefetchers per processor:\n");
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++) {
+		UINT32 Disabled = 0x00;
+		CHAR szConfiguration[0x100] = { 0x00 };
+		if (!PrefetchGet(pControl, Cpu, &Disabled)) {
+			printf("  CPU %3u: unable to read the MSR\n", Cpu);
+			continue;
+		}
+		PrefetchFormat(pControl, Disabled, szConfiguration, sizeof(szConfiguration));
+		printf("  CPU %3u: 0x%016llx %s\n", Cpu, (unsigned long long)pControl->Original[Cpu], szConfiguration);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Apply a configuration until Enter is pressed, then put the original settings back.
+/// </summary>
+static INT PrefetchApply(
+	_In_ PPREFETCH_CONTROL pControl,
+	_In_ LPCSTR            szCpus,
+	_In_ LPCSTR            szConfiguration
+) {
+	PUINT32 pCpus = NULL;
+	UINT32 uiCpuCount = 0x00;
+	UINT32 Disabled = 0x00;
+	if (!PrefetchParseCpus(pControl, szCpus, &pCpus, &uiCpuCount) || !PrefetchParse(pControl, szConfiguration, &Disabled)) {
+		printf("Invalid processors or configuration.\n");
+		free(pCpus);
+		return EXIT_FAILURE;
+	}
+	if (!PrefetchSet(pControl, pCpus, uiCpuCount, Disabled)) {
+		printf("Unable to write the MSR.\n");
+		free(pCpus);
+		return EXIT_FAILURE;
+	}
+
+	// Restored by PrefetchClose, or by the exit handlers when interrupted
+	printf("Applied to %u processor(s), press Enter to restore the original settings.\n", uiCpuCount);
+	(VOID)getchar();
+	free(pCpus);
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Run a built-in workload under each configuration and print the deltas.
+/// </summary>
+static INT PrefetchRunComparison(
+	_In_ PPREFETCH_CONTROL pControl,
+	_In_ LPCSTR            szCpus,
+	_In_ LPCSTR            szWorkload,
+	_In_ CHAR**            pArguments,
+	_In_ UINT32            uiCount
+) {
+	// 1. Arguments
+	const PREFETCH_BUILTIN* pWorkload = NULL;
+	for (UINT32 Index = 0x00; Index < ARRAYSIZE(g_Workloads); Index++) {
+		if (strcmp(g_Workloads[Index].Name, szWorkload) == 0x00)
+			pWorkload = &g_Workloads[Index];
+	}
+	UINT32 Configurations[PREFETCH_MAX_CONFIGURATIONS] = { 0x00 };
+	BOOL bValid = pWorkload != NULL && uiCount > 0x00 && uiCount <= PREFETCH_MAX_CONFIGURATIONS;
+	for (UINT32 Index = 0x00; bValid && Index < uiCount; Index++)
+		bValid = PrefetchParse(pControl, pArguments[Index], &Configurations[Index]);
+	PUINT32 pCpus = NULL;
+	UINT32 uiCpuCount = 0x00;
+	if (!bValid || !PrefetchParseCpus(pControl, szCpus, &pCpus, &uiCpuCount)) {
+		printf("Invalid workload, configuration or processors.\n");
+		free(pCpus);
+		return EXIT_FAILURE;
+	}
+
+	// 2. Allocated once, so that every configuration walks the same memory
+	PREFETCH_BUFFERS Buffers = { 0x00 };
+	PPREFETCH_RESULT pResults = (PPREFETCH_RESULT)calloc(uiCount, sizeof(PREFETCH_RESULT));
+	INT Status = EXIT_FAILURE;
+	if (pResults != NULL && PrefetchAllocateBuffers(&Buffers, uiCpuCount, pWorkload->bRandom)) {
+		printf("Workload %s (%s), %u MiB per thread on %u processor(s), median of %u runs:\n", pWorkload->Name, pWorkload->Description,
+			PREFETCH_WORKLOAD_SIZE / (1024 * 1024), uiCpuCount, PREFETCH_RUNS);
+		if (PrefetchCompare(pControl, pWorkload->Routine, &Buffers, pCpus, uiCpuCount, Configurations, uiCount, PREFETCH_RUNS, pResults)) {
+			printf("  %-40s %14s %9s %10s %9s\n", "disabled", "loads/s", "delta", "ns/load", "delta");
+			for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+				CHAR szConfiguration[0x100] = { 0x00 };
+				PrefetchFormat(pControl, pResults[Index].Disabled, szConfiguration, sizeof(szConfiguration));
+				printf("  %-40s %14.0f %+8.1f%% %10.2f %+8.1f%%\n", szConfiguration, pResults[Index].Throughput, pResults[Index].ThroughputDelta,
+					pResults[Index].Latency, pResults[Index].LatencyDelta);
+			}
+			Status = EXIT_SUCCESS;
+		}
+		else {
+			printf("Unable to run the comparison: the MSR could not be written or a thread could not be pinned.\n");
+		}
+	}
+	PrefetchFreeBuffers(&Buffers);
+	free(pResults);
+	free(pCpus);
+	return Status;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command followed by its arguments.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	BOOL bMock = argc >= 2 && strncmp(argv[1], "mock-", 5) == 0x00;
+	LPCSTR szCommand = argc >= 2 ? argv[1] + (bMock ? 5 : 0) : "";
+	BOOL bList = strcmp(szCommand, "list") == 0x00 && argc == 2;
+	BOOL bSet = strcmp(szCommand, "set") == 0x00 && argc == 4;
+	BOOL bCompare = strcmp(szCommand, "compare") == 0x00 && argc >= 5;
+	if (!bList && !bSet && !bCompare) {
+		printf("Usage: %s [mock-]list\n", argv[0]);
+		printf("       %s [mock-]set <cpu,cpu,...|all> <configuration>\n", argv[0]);
+		printf("       %s [mock-]compare <cpu,cpu,...|all> <random|stream> <configuration> [...]\n", argv[0]);
+		printf("Configurations: none, all, original, or a comma separated list of prefetchers to disable.\n");
+		printf("The MSRs are accessed via the \\\\.\\KMsr driver on Windows and the msr module on Linux, run as administrator or root.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 1. The mock backend starts with every prefetcher enabled, on the processors of the machine
+	MSR_BACKEND Msr = { 0x00 };
+	UINT32 uiCpuCount = ThreadGetCpuCount();
+	BOOL bOpened = bMock ? MsrMockOpen(&Msr, uiCpuCount, NULL, NULL) : MsrOpen(&Msr);
+	for (UINT32 Cpu = 0x00; bOpened && bMock && Cpu < uiCpuCount; Cpu++) {
+		(VOID)MsrWrite(&Msr, Cpu, MSR_MISC_FEATURE_CONTROL, 0x00);
+		(VOID)MsrWrite(&Msr, Cpu, MSR_AMD_PREFETCH_CONTROL, 0x00);
+	}
+	if (!bOpened) {
+		printf("Unable to open the MSR backend, run as administrator or root.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 2. Save the settings of every processor
+	PREFETCH_CONTROL Control = { 0x00 };
+	if (!PrefetchOpen(&Control, &Msr)) {
+		printf("Unable to control the prefetchers: unknown vendor, or MSR missing on this model.\n");
+		MsrClose(&Msr);
+		return EXIT_FAILURE;
+	}
+
+	// 3. Command
+	INT Status = EXIT_FAILURE;
+	if (bList)
+		Status = PrefetchList(&Control);
+	else if (bSet)
+		Status = PrefetchApply(&Control, argv[2], argv[3]);
+	else
+		Status = PrefetchRunComparison(&Control, argv[2], argv[3], &argv[4], (UINT32)argc - 4);
+	PrefetchClose(&Control);
+	MsrClose(&Msr);
+	return Status;
+}
@@ -0,0 +1,435 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rdt.h"
+#include "thread.h"
+
+/// Number of processors emulated by the mock backend
+#define RDT_MOCK_CPUS 8
+
+/// <summary>
+/// State of the emulated monitoring hardware.
+/// </summary>
+typedef struct _RDT_MOCK {
+	UINT64 EventSelect[RDT_MOCK_CPUS];
+	UINT64 Start;
+} RDT_MOCK, * PRDT_MOCK;
+
+/// <summary>
+/// Emulate IA32_QM_EVTSEL and IA32_QM_CTR. Each RMID fills the cache and moves data proportionally to
+/// its number, the bandwidth counters wrapping at 24 bits.
+/// </summary>
+static BOOL RdtMockHandler(
+	_In_    PVOID   Context,
+	_In_    UINT32  Cpu,
+	_In_    UINT32  Msr,
+	_In_    BOOL    bWrite,
+	_Inout_ PUINT64 pValue
+) {
+	PRDT_MOCK Mock = (PRDT_MOCK)Context;
+	if (bWrite) {
+		if (Msr == IA32_QM_EVTSEL)
+			Mock->EventSelect[Cpu] = *pValue;
+		return Msr == IA32_QM_EVTSEL || Msr == IA32_PQR_ASSOC;
+	}
+	if (Msr != IA32_QM_CTR)
+		return FALSE;
+
+	UINT64 Rmid = (Mock->EventSelect[Cpu] >> 32) & RDT_PQR_RMID_MASK;
+	UINT64 Microseconds = (ThreadGetTime() - Mock->Start) / 1000;
+	switch (Mock->EventSelect[Cpu] & 0xFF) {
+	case RDT_EVENT_L3_OCCUPANCY:
+		*pValue = Rmid * 0x4000;
+		break;
+	case RDT_EVENT_TOTAL_BANDWIDTH:
+		*pValue = (Microseconds * Rmid * 2) & 0xFFFFFF;
+		break;
+	case RDT_EVENT_LOCAL_BANDWIDTH:
+		*pValue = (Microseconds * Rmid) & 0xFFFFFF;
+		break;
+	default:
+		*pValue = RDT_CTR_ERROR;
+		break;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Emulate the allocation MSRs the way the hardware checks them: writing an invalid capacity mask or throttling
+/// value raises #GP, reported as a failed write.
+/// </summary>
+static BOOL RdtMockAllocationHandler(
+	_In_    PVOID   Context,
+	_In_    UINT32  Cpu,
+	_In_    UINT32  Msr,
+	_In_    BOOL    bWrite,
+	_Inout_ PUINT64 pValue
+) {
+	const RDT_ALLOCATION_CAPABILITIES* pCapabilities = (const RDT_ALLOCATION_CAPABILITIES*)Context;
+	(VOID)Cpu;
+	if (!bWrite)
+		return FALSE;
+
+	if (Msr >= IA32_L3_MASK_0 && Msr <= IA32_L3_MASK_0 + pCapabilities->Cache[RDT_RESOURCE_L3].MaximumCos) {
+		UINT64 Mask = *pValue;
+		while (Mask != 0x00 && (Mask & 0x01) == 0x00)
+			Mask >>= 1;
+		return Mask != 0x00 && (Mask & (Mask + 1)) == 0x00 && (*pValue >> pCapabilities->Cache[RDT_RESOURCE_L3].MaskLength) == 0x00;
+	}
+	if (Msr >= IA32_MBA_THRTL_0 && Msr <= IA32_MBA_THRTL_0 + pCapabilities->MbaMaximumCos)
+		return *pValue <= pCapabilities->MbaMaximumDelay;
+	return Msr == IA32_PQR_ASSOC;
+}
+
+/// <summary>
+/// Parse a workload given as name=cpu,cpu,...
+/// </summary>
+static BOOL RdtParseWorkload(
+	_In_  LPSTR         szArgument,
+	_Out_ PRDT_WORKLOAD pWorkload
+) {
+	RtlZeroMemory(pWorkload, sizeof(RDT_WORKLOAD));
+	LPSTR szCpus = strchr(szArgument, '=');
+	if (szCpus == NULL || szCpus == szArgument)
+		return FALSE;
+	*szCpus++ = '\0';
+	pWorkload->Name = szArgument;
+
+	UINT32 uiCount = 0x01;
+	for (LPCSTR szChar = szCpus; *szChar != '\0'; szChar++)
+		uiCount += *szChar == ',';
+	pWorkload->Cpus = (PUINT32)calloc(uiCount, sizeof(UINT32));
+	if (pWorkload->Cpus == NULL)
+		return FALSE;
+
+	for (LPSTR szEnd = szCpus; pWorkload->CpuCount < uiCount; szCpus = szEnd + 1) {
+		pWorkload->Cpus[pWorkload->CpuCount++] = (UINT32)strtoul(szCpus, &szEnd, 10);
+		if (szEnd == szCpus || (*szEnd != ',' && *szEnd != '\0'))
+			return FALSE;
+		if (*szEnd == '\0')
+			break;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Parse a tenant given as name=cpu,cpu,...[:ways[:bandwidth]]
+/// </summary>
+static BOOL RdtParseTenant(
+	_In_  LPSTR       szArgument,
+	_Out_ PRDT_TENANT pTenant
+) {
+	RtlZeroMemory(pTenant, sizeof(RDT_TENANT));
+	LPSTR szWays = strchr(szArgument, ':');
+	if (szWays != NULL) {
+		*szWays++ = '\0';
+		LPSTR szBandwidth = strchr(szWays, ':');
+		if (szBandwidth != NULL) {
+			*szBandwidth++ = '\0';
+			pTenant->Bandwidth = (UINT32)strtoul(szBandwidth, NULL, 10);
+		}
+		pTenant->Ways = (UINT32)strtoul(szWays, NULL, 10);
+	}
+
+	RDT_WORKLOAD Workload = { 0x00 };
+	BOOL bSuccess = RdtParseWorkload(szArgument, &Workload);
+	pTenant->Name = Workload.Name;
+	pTenant->Cpus = Workload.Cpus;
+	pTenant->CpuCount = Workload.CpuCount;
+	return bSuccess;
+}
+
+/// <summary>
+/// Print the allocation capabilities.
+/// </summary>
+static VOID RdtPrintAllocation(
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_ LPCSTR                             szBackend
+) {
+	for (UINT32 Resource = RDT_RESOURCE_L3; Resource <= RDT_RESOURCE_L2; Resource++) {
+		const RDT_CACHE_CAPABILITIES* pCache = &pCapabilities->Cache[Resource];
+		if (pCache->Supported) {
+			printf("[*] L%u CAT: %u-bit masks, COS 0-%u, shareable 0x%x%s\n", Resource == RDT_RESOURCE_L3 ? 3 : 2,
+				pCache->MaskLength, pCache->MaximumCos, pCache->ShareableMask, pCache->Cdp ? ", CDP" : "");
+		}
+	}
+	if (pCapabilities->Mba) {
+		printf("[*] MBA: delay 0-%u (%s), COS 0-%u\n", pCapabilities->MbaMaximumDelay,
+			pCapabilities->MbaLinear ? "linear" : "non-linear", pCapabilities->MbaMaximumCos);
+	}
+	printf("[*] Backend: %s\n", szBackend);
+}
+
+/// <summary>
+/// Apply a policy and print what each tenant got.
+/// </summary>
+static INT RdtApply(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_ PRDT_TENANT                        pTenants,
+	_In_ UINT32                             uiCount
+) {
+	RdtPrintAllocation(pCapabilities, pMsr->Name);
+	if (!RdtAllocationApply(pMsr, pCapabilities, pTenants, uiCount)) {
+		printf("Unable to apply the policy.\n");
+		return EXIT_FAILURE;
+	}
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		printf("    - %-16s COS %-3u LLC mask 0x%05llx  delay %u\n", pTenants[Index].Name, pTenants[Index].Cos,
+			(unsigned long long)pTenants[Index].Mask, pTenants[Index].Delay);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Apply a policy on the hardware, or reset the allocation when there is no tenant.
+/// </summary>
+static INT RdtAllocate(
+	_In_ PRDT_TENANT pTenants,
+	_In_ UINT32      uiCount
+) {
+	CPUID_BACKEND Cpuid = { 0x00 };
+	RDT_ALLOCATION_CAPABILITIES Capabilities = { 0x00 };
+	if (!CpuidOpen(&Cpuid)) {
+		printf("Unable to open the CPUID backend.\n");
+		return EXIT_FAILURE;
+	}
+	BOOL bSupported = RdtAllocationQuery(&Cpuid, &Capabilities);
+	UINT32 uiCpuCount = Cpuid.CpuCount;
+	CpuidClose(&Cpuid);
+	if (!bSupported) {
+		printf("Cache allocation is not supported by this processor.\n");
+		return EXIT_FAILURE;
+	}
+
+	MSR_BACKEND Msr = { 0x00 };
+	if (!MsrOpen(&Msr)) {
+		printf("Unable to open the MSR backend, run as administrator or root.\n");
+		return EXIT_FAILURE;
+	}
+	INT Status = EXIT_SUCCESS;
+	if (uiCount == 0x00) {
+		RdtAllocationReset(&Msr, &Capabilities, uiCpuCount);
+		printf("[*] Allocation reset on %u processor(s).\n", uiCpuCount);
+	}
+	else {
+		Status = RdtApply(&Msr, &Capabilities, pTenants, uiCount);
+	}
+	MsrClose(&Msr);
+	return Status;
+}
+
+/// <summary>
+/// Apply a policy on emulated hardware with a 20-way L3 cache and linear bandwidth allocation.
+/// </summary>
+static INT RdtMockAllocate(
+	_In_ PRDT_TENANT pTenants,
+	_In_ UINT32      uiCount
+) {
+	static RDT_ALLOCATION_CAPABILITIES Capabilities = {
+		.Cache = { {.Supported = TRUE, .MaskLength = 20, .ShareableMask = 0xC0000, .MaximumCos = 15, .MinimumWidth = 1 } },
+		.Mba = TRUE,
+		.MbaMaximumDelay = 90,
+		.MbaMaximumCos = 7,
+		.MbaLinear = TRUE
+	};
+
+	MSR_BACKEND Msr = { 0x00 };
+	if (!MsrMockOpen(&Msr, RDT_MOCK_CPUS, RdtMockAllocationHandler, &Capabilities))
+		return EXIT_FAILURE;
+	INT Status = RdtApply(&Msr, &Capabilities, pTenants, uiCount);
+
+	// Read back what the emulated hardware holds
+	for (UINT32 Cpu = 0x00; Status == EXIT_SUCCESS && Cpu < RDT_MOCK_CPUS; Cpu++) {
+		UINT64 Association = 0x00;
+		if (MsrRead(&Msr, Cpu, IA32_PQR_ASSOC, &Association))
+			printf("    - CPU %u: IA32_PQR_ASSOC 0x%016llx\n", Cpu, (unsigned long long)Association);
+	}
+	MsrClose(&Msr);
+	return Status;
+}
+
+/// <summary>
+/// Sample the workloads at a regular interval and print their occupancy and bandwidth.
+/// </summary>
+static INT RdtRun(
+	_In_     PMSR_BACKEND                    pMsr,
+	_In_     const RDT_MONITOR_CAPABILITIES* pCapabilities,
+	_In_opt_ const TOPOLOGY*                 pTopology,
+	_In_     PRDT_WORKLOAD                   pWorkloads,
+	_In_     UINT32                          uiCount,
+	_In_     UINT32                          uiInterval,
+	_In_     UINT32                          uiSamples
+) {
+	printf("[*] RMIDs 0-%u, counters of %u bits, %u bytes per unit (backend: %s)\n",
+		pCapabilities->MaximumRmid, pCapabilities->CounterWidth, pCapabilities->Scale, pMsr->Name);
+
+	RDT_MONITOR Monitor = { 0x00 };
+	if (!RdtMonitorStart(&Monitor, pMsr, pCapabilities, pTopology, pWorkloads, uiCount)) {
+		printf("Unable to associate the workloads with their RMID.\n");
+		return EXIT_FAILURE;
+	}
+
+	for (UINT32 Sample = 0x00; Sample < uiSamples; Sample++) {
+		ThreadSleep(uiInterval);
+		BOOL bComplete = RdtMonitorSample(&Monitor);
+		printf("[*] Sample %u%s\n", Sample + 1, bComplete ? "" : " (some counters unavailable)");
+		for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+			printf("    - %-16s RMID %-3u LLC %8llu KiB  total %10.1f MB/s  local %10.1f MB/s\n",
+				pWorkloads[Index].Name, pWorkloads[Index].Rmid,
+				(unsigned long long)(pWorkloads[Index].Occupancy / 1024),
+				(double)pWorkloads[Index].TotalRate / 1e6, (double)pWorkloads[Index].LocalRate / 1e6);
+		}
+	}
+
+	RdtMonitorStop(&Monitor);
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Monitor workloads on the hardware.
+/// </summary>
+static INT RdtMonitor(
+	_In_ UINT32        uiInterval,
+	_In_ UINT32        uiSamples,
+	_In_ PRDT_WORKLOAD pWorkloads,
+	_In_ UINT32        uiCount
+) {
+	// 1. Get the capabilities and the cache topology
+	CPUID_BACKEND Cpuid = { 0x00 };
+	RDT_MONITOR_CAPABILITIES Capabilities = { 0x00 };
+	TOPOLOGY Topology = { 0x00 };
+	if (!CpuidOpen(&Cpuid)) {
+		printf("Unable to open the CPUID backend.\n");
+		return EXIT_FAILURE;
+	}
+	if (!RdtMonitorQuery(&Cpuid, &Capabilities)) {
+		printf("L3 cache monitoring is not supported by this processor.\n");
+		CpuidClose(&Cpuid);
+		return EXIT_FAILURE;
+	}
+	BOOL bTopology = TopologyBuild(&Cpuid, &Topology);
+	CpuidClose(&Cpuid);
+
+	// 2. Monitor through the driver or the msr module
+	MSR_BACKEND Msr = { 0x00 };
+	INT Status = EXIT_FAILURE;
+	if (MsrOpen(&Msr)) {
+		Status = RdtRun(&Msr, &Capabilities, bTopology ? &Topology : NULL, pWorkloads, uiCount, uiInterval, uiSamples);
+		MsrClose(&Msr);
+	}
+	else {
+		printf("Unable to open the MSR backend, run as administrator or root.\n");
+	}
+	TopologyFree(&Topology);
+	return Status;
+}
+
+/// <summary>
+/// Monitor workloads on emulated hardware.
+/// </summary>
+static INT RdtMock(
+	_In_ UINT32        uiInterval,
+	_In_ UINT32        uiSamples,
+	_In_ PRDT_WORKLOAD pWorkloads,
+	_In_ UINT32        uiCount
+) {
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		for (UINT32 Cpu = 0x00; Cpu < pWorkloads[Index].CpuCount; Cpu++) {
+			if (pWorkloads[Index].Cpus[Cpu] >= RDT_MOCK_CPUS) {
+				printf("The mock backend emulates %u processors.\n", RDT_MOCK_CPUS);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	static RDT_MOCK Mock;
+	Mock.Start = ThreadGetTime();
+	RDT_MONITOR_CAPABILITIES Capabilities = {
+		.Supported = TRUE,
+		.MaximumRmid = 0x7F,
+		.Scale = 64,
+		.CounterWidth = 24,
+		.Occupancy = TRUE,
+		.TotalBandwidth = TRUE,
+		.LocalBandwidth = TRUE
+	};
+
+	MSR_BACKEND Msr = { 0x00 };
+	if (!MsrMockOpen(&Msr, RDT_MOCK_CPUS, RdtMockHandler, &Mock))
+		return EXIT_FAILURE;
+	INT Status = RdtRun(&Msr, &Capabilities, NULL, pWorkloads, uiCount, uiInterval, uiSamples);
+	MsrClose(&Msr);
+	return Status;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command followed by its arguments.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	BOOL bMock = argc >= 2 && strncmp(argv[1], "mock", 4) == 0x00;
+	LPCSTR szCommand = argc >= 2 ? argv[1] + (bMock ? 4 : 0) : "";
+	if (bMock && *szCommand == '-')
+		szCommand++;
+	BOOL bMonitor = strcmp(szCommand, bMock ? "" : "monitor") == 0x00 && argc >= 5;
+	BOOL bAllocate = strcmp(szCommand, "allocate") == 0x00 && argc >= 3;
+	BOOL bReset = !bMock && strcmp(szCommand, "reset") == 0x00;
+	if (!bMonitor && !bAllocate && !bReset) {
+		printf("Usage: %s monitor <interval ms> <samples> <name=cpu,cpu,...> [...]\n", argv[0]);
+		printf("       %s allocate <name=cpu,cpu,...[:ways[:bandwidth %%]]> [...]\n", argv[0]);
+		printf("       %s reset\n", argv[0]);
+		printf("       %s mock <interval ms> <samples> <name=cpu,cpu,...> [...]\n", argv[0]);
+		printf("       %s mock-allocate <name=cpu,cpu,...[:ways[:bandwidth %%]]> [...]\n", argv[0]);
+		printf("The MSRs are accessed via the \\\\.\\KMsr driver on Windows and the msr module on Linux, run as administrator or root.\n");
+		return EXIT_FAILURE;
+	}
+	if (bReset)
+		return RdtAllocate(NULL, 0x00);
+
+	// 1. Parse the workloads or the tenants
+	UINT32 uiFirst = bMonitor ? 4 : 2;
+	UINT32 uiCount = (UINT32)argc - uiFirst;
+	PRDT_WORKLOAD Workloads = (PRDT_WORKLOAD)calloc(uiCount, sizeof(RDT_WORKLOAD));
+	PRDT_TENANT Tenants = (PRDT_TENANT)calloc(uiCount, sizeof(RDT_TENANT));
+	INT Status = EXIT_FAILURE;
+	UINT32 Index = 0x00;
+	for (; Workloads != NULL && Tenants != NULL && Index < uiCount; Index++) {
+		BOOL bParsed = bMonitor
+			? RdtParseWorkload(argv[Index + uiFirst], &Workloads[Index])
+			: RdtParseTenant(argv[Index + uiFirst], &Tenants[Index]);
+		if (!bParsed) {
+			printf("Invalid argument: %s\n", argv[Index + uiFirst]);
+			break;
+		}
+	}
+
+	// 2. Monitor the workloads or apply the policy
+	if (Workloads != NULL && Tenants != NULL && Index == uiCount) {
+		if (bMonitor) {
+			UINT32 uiInterval = (UINT32)strtoul(argv[2], NULL, 10);
+			UINT32 uiSamples = (UINT32)strtoul(argv[3], NULL, 10);
+			Status = bMock ? RdtMock(uiInterval, uiSamples, Workloads, uiCount) : RdtMonitor(uiInterval, uiSamples, Workloads, uiCount);
+		}
+		else {
+			Status = bMock ? RdtMockAllocate(Tenants, uiCount) : RdtAllocate(Tenants, uiCount);
+		}
+	}
+
+	for (Index = 0x00; Index < uiCount; Index++) {
+		free(Workloads != NULL ? Workloads[Index].Cpus : NULL);
+		free(Tenants != NULL ? Tenants[Index].Cpus : NULL);
+	}
+	free(Workloads);
+	free(Tenants);
+	return Status;
+}
@@ -8,6 +8,8 @@
 #include <Windows.h>
 #include <stdio.h>
 
+#include "dtr.h"
+
 #pragma warning(disable: 4201)
 
 /// Helps making the code less bloated
@@ -245,8 +247,27 @@ INT main() {
 	PRINT_SEGMENT_INFO(FS, fs);
 	PRINT_SEGMENT_INFO(GS, gs);
 
-	// 3. Query the driver to get the kernel segment registers and their descriptors
-	// 3.1 Get an handle to the device
+	// 3. Get the descriptor table registers. Only goes through the driver if UMIP is enforced.
+	printf("\n[*] Descriptor table registers:\n");
+	DTR_INFORMATION Dtr = { 0x00 };
+	if (DtrRead(&Dtr)) {
+		Segment ldtr = { .value = Dtr.Ldtr };
+		Segment tr = { .value = Dtr.Tr };
+		printf("    - GDTR = 0x%p | Limit=0x%04x\n", (PVOID)Dtr.Gdtr.Base, Dtr.Gdtr.Limit);
+		printf("    - IDTR = 0x%p | Limit=0x%04x\n", (PVOID)Dtr.Idtr.Base, Dtr.Idtr.Limit);
+		PRINT_SEGMENT_INFO(LDTR, ldtr);
+		PRINT_SEGMENT_INFO(TR, tr);
+		printf("    - Source: %s\n",
+			Dtr.Source == DtrSourceInstruction ? "user mode instructions"
+			: Dtr.Source == DtrSourceEmulated ? "UMIP emulation (dummy values)" : "driver");
+	}
+	else {
+		printf("    - Unable to read the descriptor table registers.\n");
+	}
+	DtrUninitialise();
+
+	// 4. Query the driver to get the kernel segment registers and their descriptors
+	// 4.1 Get an handle to the device
 	printf("\n[*] Kernel mode segment registers:\n");
 	HANDLE hDevice = CreateFileW(
 		KSEG_DEVICE_PATH,
@@ -262,7 +283,7 @@ INT main() {
 		return EXIT_FAILURE;
 	}
 
-	// 3.2. Query the device for all 6 segment registers
+	// 4.2. Query the device for all 6 segment registers
 	CALL_AND_CHECK(QueryDevice(&hDevice, "CS", SEGMENT_CS));
 	CALL_AND_CHECK(QueryDevice(&hDevice, "SS", SEGMENT_SS));
 	CALL_AND_CHECK(QueryDevice(&hDevice, "DS", SEGMENT_DS));
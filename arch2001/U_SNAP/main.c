@@ -0,0 +1,171 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "snapshot.h"
+#include "thread.h"
+
+/// <summary>
+/// Capture every processor and append one record per processor to the file.
+/// </summary>
+/// <param name="szPath">Path of the snapshot file.</param>
+/// <returns>Process exit status code.</returns>
+static INT SnapCapture(
+	_In_ LPCSTR szPath
+) {
+	// 1. Open the file and the sources
+	SNAPSHOT_FILE File = { 0x00 };
+	if (!SnapshotFileOpen(szPath, &File)) {
+		printf("Unable to open %s or it is not a version %u snapshot file.\n", szPath, SNAPSHOT_VERSION);
+		return EXIT_FAILURE;
+	}
+	SNAPSHOT_CONTEXT Context = { 0x00 };
+	SnapshotOpen(&Context);
+
+	// 2. Capture all the processors, then write them at once
+	UINT32 uiCount = ThreadGetCpuCount();
+	PSNAPSHOT_RECORD Records = (PSNAPSHOT_RECORD)calloc(uiCount, sizeof(SNAPSHOT_RECORD));
+	UINT32 uiCaptured = 0x00;
+	for (UINT32 Index = 0x00; Records != NULL && Index < uiCount; Index++) {
+		if (SnapshotCapture(&Context, Index, &Records[uiCaptured]))
+			uiCaptured++;
+	}
+
+	BOOL bSuccess = uiCaptured != 0x00 && SnapshotFileAppend(&File, Records, uiCaptured);
+	if (bSuccess)
+		printf("[*] %u record(s) appended to %s (MSR backend: %s).\n", uiCaptured, szPath, Context.bMsr ? Context.Msr.Name : "none");
+	else
+		printf("Unable to capture or write the records.\n");
+
+	// 3. Cleanup
+	free(Records);
+	SnapshotClose(&Context);
+	SnapshotFileClose(&File);
+	return bSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// <summary>
+/// Print the records of a snapshot file, read in place from the mapping.
+/// </summary>
+/// <param name="szPath">Path of the snapshot file.</param>
+/// <returns>Process exit status code.</returns>
+static INT SnapDump(
+	_In_ LPCSTR szPath
+) {
+	SNAPSHOT_VIEW View = { 0x00 };
+	if (!SnapshotViewOpen(szPath, &View)) {
+		printf("Unable to map %s or it is not a snapshot file.\n", szPath);
+		return EXIT_FAILURE;
+	}
+	printf("[*] %s: version %u, %llu record(s) of %u bytes\n", szPath, View.Header->Version, (unsigned long long)View.Count, View.Header->RecordSize);
+
+	for (UINT64 Index = 0x00; Index < View.Count; Index++) {
+		const SNAPSHOT_RECORD* Record = SnapshotViewAt(&View, Index);
+		if (Record->Magic != SNAPSHOT_RECORD_MAGIC)
+			continue;
+
+		printf("\n[*] %.64s, processor %u, %llu ns, valid 0x%08x\n", Record->HostName, Record->Cpu, (unsigned long long)Record->Timestamp, Record->Valid);
+		if (Record->Valid & SNAPSHOT_VALID_SELECTORS)
+			printf("    - CS=0x%02x SS=0x%02x DS=0x%02x ES=0x%02x FS=0x%02x GS=0x%02x\n",
+				Record->Selectors[SELECTOR_CS], Record->Selectors[SELECTOR_SS], Record->Selectors[SELECTOR_DS],
+				Record->Selectors[SELECTOR_ES], Record->Selectors[SELECTOR_FS], Record->Selectors[SELECTOR_GS]);
+		if (Record->Valid & SNAPSHOT_VALID_DTR)
+			printf("    - GDTR=0x%016llx/0x%04x IDTR=0x%016llx/0x%04x LDTR=0x%02x TR=0x%02x%s\n",
+				(unsigned long long)Record->GdtBase, Record->GdtLimit, (unsigned long long)Record->IdtBase, Record->IdtLimit,
+				Record->Ldtr, Record->Tr, Record->Valid & SNAPSHOT_VALID_DTR_EMULATED ? " (emulated)" : "");
+		if (Record->Valid & SNAPSHOT_VALID_CR)
+			printf("    - CR0=0x%016llx CR3=0x%016llx CR4=0x%016llx\n",
+				(unsigned long long)Record->Cr0, (unsigned long long)Record->Cr3, (unsigned long long)Record->Cr4);
+		if (Record->Valid & SNAPSHOT_VALID_EFER)
+			printf("    - IA32_EFER=0x%016llx\n", (unsigned long long)Record->Efer);
+		if (Record->Valid & SNAPSHOT_VALID_SYSCALL)
+			printf("    - IA32_STAR=0x%016llx IA32_LSTAR=0x%016llx IA32_CSTAR=0x%016llx IA32_FMASK=0x%016llx\n",
+				(unsigned long long)Record->Star, (unsigned long long)Record->Lstar, (unsigned long long)Record->Cstar, (unsigned long long)Record->Fmask);
+		if (Record->Valid & SNAPSHOT_VALID_SEGBASE)
+			printf("    - IA32_FS_BASE=0x%016llx IA32_GS_BASE=0x%016llx IA32_KERNEL_GS_BASE=0x%016llx\n",
+				(unsigned long long)Record->FsBase, (unsigned long long)Record->GsBase, (unsigned long long)Record->KernelGsBase);
+		if (Record->Valid & SNAPSHOT_VALID_TSC_AUX)
+			printf("    - IA32_TSC_AUX=0x%016llx\n", (unsigned long long)Record->TscAux);
+		if (Record->Valid & SNAPSHOT_VALID_CPUID) {
+			for (UINT32 Leaf = 0x00; Leaf < SNAPSHOT_CPUID_LEAVES; Leaf++) {
+				printf("    - CPUID %08x.%02x: %08x %08x %08x %08x\n",
+					Record->Cpuid[Leaf].Leaf, Record->Cpuid[Leaf].SubLeaf,
+					Record->Cpuid[Leaf].Eax, Record->Cpuid[Leaf].Ebx, Record->Cpuid[Leaf].Ecx, Record->Cpuid[Leaf].Edx);
+			}
+		}
+	}
+
+	SnapshotViewClose(&View);
+	return EXIT_SUCCESS;
+}
+
+/// <summary>
+/// Write the records of a snapshot file to the standard output in a format meant for other programs.
+/// </summary>
+/// <param name="szPath">Path of the snapshot file.</param>
+/// <param name="Format">Format of the records.</param>
+/// <returns>Process exit status code.</returns>
+static INT SnapExport(
+	_In_ LPCSTR        szPath,
+	_In_ OUTPUT_FORMAT Format
+) {
+	static CHAR s_Buffer[OUTPUT_DEFAULT_BUFFER];
+	SNAPSHOT_VIEW View = { 0x00 };
+	if (!SnapshotViewOpen(szPath, &View)) {
+		fprintf(stderr, "Unable to map %s or it is not a snapshot file.\n", szPath);
+		return EXIT_FAILURE;
+	}
+
+	// 1. Records are formatted in a single buffer and written when it is full
+#if defined(_WIN32)
+	(VOID)_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	OUTPUT Output = { 0x00 };
+	if (!OutputOpen(&Output, Format, s_Buffer, sizeof(s_Buffer), OutputFileSink, stdout)) {
+		SnapshotViewClose(&View);
+		return EXIT_FAILURE;
+	}
+	for (UINT64 Index = 0x00; Index < View.Count; Index++) {
+		const SNAPSHOT_RECORD* Record = SnapshotViewAt(&View, Index);
+		if (Record->Magic == SNAPSHOT_RECORD_MAGIC)
+			(VOID)SnapshotWrite(&Output, Record);
+	}
+
+	// 2. Cleanup
+	BOOL bSuccess = OutputClose(&Output) && Output.Dropped == 0x00;
+	fflush(stdout);
+	SnapshotViewClose(&View);
+	return bSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Command, either capture or dump, followed by the path of the snapshot file and the format of the dump.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	if (argc == 3 && strcmp(argv[1], "capture") == 0x00)
+		return SnapCapture(argv[2]);
+	if (argc == 3 && strcmp(argv[1], "dump") == 0x00)
+		return SnapDump(argv[2]);
+
+	OUTPUT_FORMAT Format = OutputText;
+	if (argc == 4 && strcmp(argv[1], "dump") == 0x00 && OutputGetFormat(argv[3], &Format))
+		return SnapExport(argv[2], Format);
+
+	printf("Usage: %s capture <file>\n", argv[0]);
+	printf("       %s dump <file> [text|jsonl|csv|binary]\n", argv[0]);
+	return EXIT_FAILURE;
+}
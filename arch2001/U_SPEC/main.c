@@ -0,0 +1,75 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include "mitigation.h"
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <returns>Process exit status code.</returns>
+INT main() {
+	// 1. MSRs are optional, CPUID alone tells what is enumerated
+	MSR_BACKEND Msr = { 0x00 };
+	BOOL bMsr = MsrOpen(&Msr);
+	if (!bMsr)
+		printf("Unable to open the MSR backend, only what CPUID enumerates will be reported.\n\n");
+
+	static MITIGATION_AUDIT Audit;
+	BOOL bAudit = MitigationAudit(bMsr ? &Msr : NULL, &Audit);
+	if (bMsr)
+		MsrClose(&Msr);
+	if (!bAudit) {
+		printf("Unable to identify the processor.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 2. Key the results are compared by
+	CHAR szKey[0x40] = { 0x00 };
+	MitigationFormatKey(&Audit.Key, szKey, sizeof(szKey));
+	printf("Processor:      %s family 0x%02X model 0x%02X stepping %u\n", Audit.Key.Vendor, Audit.Key.Family, Audit.Key.Model, Audit.Key.Stepping);
+	if (Audit.Key.bMicrocode)
+		printf("Microcode:      0x%x%s\n", Audit.Key.Microcode, Audit.Key.bMicrocodeMixed ? ", NOT the same on every processor" : "");
+	else
+		printf("Microcode:      unknown\n");
+	printf("Key:            %s\n", szKey);
+
+	// 3. Controls
+	if (Audit.bSpecCtrl)
+		printf("\nIA32_SPEC_CTRL: 0x%016llx\n", (unsigned long long)Audit.SpecCtrl);
+	else
+		printf("\nIA32_SPEC_CTRL: not read\n");
+	printf("%-12s %-10s %-8s %s\n", "Control", "Enumerated", "Active", "Description");
+	for (UINT32 Index = 0x00; Index < Audit.ControlCount; Index++) {
+		const MITIGATION_CONTROL* pControl = &Audit.Controls[Index];
+		LPCSTR szActive = "-";
+		if (pControl->SpecCtrlMask != 0x00 && Audit.bSpecCtrl)
+			szActive = pControl->bActive ? "yes" : "no";
+		printf("%-12s %-10s %-8s %s\n", pControl->Name, pControl->bEnumerated ? "yes" : "no", szActive, pControl->Description);
+	}
+
+	// 4. Immunities
+	if (Audit.bArchCapabilities) {
+		printf("\nIA32_ARCH_CAPABILITIES: 0x%016llx\n", (unsigned long long)Audit.ArchCapabilities);
+		for (UINT32 Index = 0x00; Index < Audit.CapabilityCount; Index++) {
+			const MITIGATION_CAPABILITY* pCapability = &Audit.Capabilities[Index];
+			printf("  [%c] %-15s %s\n", pCapability->bSet ? 'x' : ' ', pCapability->Name, pCapability->Description);
+		}
+	}
+	else {
+		printf("\nIA32_ARCH_CAPABILITIES: not read\n");
+	}
+
+	// 5. What the OS did with them
+	if (Audit.VulnerabilityCount != 0x00) {
+		printf("\nReported by the OS:\n");
+		for (UINT32 Index = 0x00; Index < Audit.VulnerabilityCount; Index++)
+			printf("  %-28s %s\n", Audit.Vulnerabilities[Index].Name, Audit.Vulnerabilities[Index].Status);
+	}
+	return EXIT_SUCCESS;
+}
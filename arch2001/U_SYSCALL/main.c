@@ -0,0 +1,194 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include "sysentry.h"
+#include "thread.h"
+
+/// Width of the longest bar of the histogram
+#define SYSCALL_BAR_WIDTH 50
+
+/// Relative distance to the median of the medians above which a processor is reported, in percent
+#define SYSCALL_OUTLIER_PERCENT 10
+
+/// <summary>
+/// Print the decoded SYSCALL MSRs of a processor.
+/// </summary>
+static VOID SyscallPrintEntry(
+	_In_ const SYSENTRY_INFORMATION* pInformation
+) {
+	CHAR szFlags[0x100] = { 0x00 };
+	SysEntryFormatFlags(pInformation->MaskedFlags, szFlags, sizeof(szFlags));
+	printf("IA32_STAR:  0x%016llx\n", (unsigned long long)pInformation->Star);
+	printf("IA32_LSTAR: 0x%016llx (64-bit entry point)\n", (unsigned long long)pInformation->Lstar);
+	printf("IA32_CSTAR: 0x%016llx (compatibility mode entry point)\n", (unsigned long long)pInformation->Cstar);
+	printf("IA32_FMASK: 0x%016llx (cleared on entry: %s)\n", (unsigned long long)pInformation->Fmask, szFlags[0] != '\0' ? szFlags : "none");
+
+	static const LPCSTR Checks[] = { "not read", "matches", "MISMATCH", "DPL 0, not visible from user mode" };
+	printf("\nSelectors, checked against the GDT via %s:\n", pInformation->bDescriptors ? pInformation->Source : "nothing");
+	for (UINT32 Index = 0x00; Index < SYSENTRY_SELECTOR_COUNT; Index++) {
+		const SYSENTRY_SELECTOR* pSelector = &pInformation->Selectors[Index];
+		printf("  - %-17s 0x%04x index %2u RPL %u", SysEntryGetSelectorName(Index), pSelector->Selector, pSelector->Selector >> 3, pSelector->Selector & 0x03);
+		if (pInformation->bDescriptors) {
+			printf(": %s", Checks[pSelector->Check]);
+			if (pSelector->Check == SysEntryCheckMatch || pSelector->Check == SysEntryCheckMismatch)
+				printf(" (access rights 0x%08x, expected 0x%08x under mask 0x%08x)", pSelector->Access, pSelector->Expected, pSelector->Mask);
+		}
+		printf("\n");
+	}
+	printf("  - Current CS 0x%04x and SS 0x%04x %s the selectors SYSRET loads\n", pInformation->CurrentCs, pInformation->CurrentSs,
+		pInformation->bCurrentMatch ? "match" : "do NOT match");
+}
+
+/// <summary>
+/// Print the SYSCALL MSRs of the first processor and the processors whose MSRs differ.
+/// </summary>
+static VOID SyscallPrintEntries(
+	_In_ PMSR_BACKEND pMsr,
+	_In_ UINT32       uiCpuCount
+) {
+	SYSENTRY_INFORMATION First = { 0x00 };
+	if (!SysEntryQuery(pMsr, 0x00, &First)) {
+		printf("Unable to read the SYSCALL MSRs.\n");
+		return;
+	}
+	printf("SYSCALL configuration of CPU 0:\n");
+	SyscallPrintEntry(&First);
+
+	// The OS programs every processor the same way, anything else is worth a look
+	UINT32 Differences = 0x00;
+	for (UINT32 Cpu = 0x01; Cpu < uiCpuCount; Cpu++) {
+		SYSENTRY_INFORMATION Information = { 0x00 };
+		if (!SysEntryQuery(pMsr, Cpu, &Information)) {
+			printf("  - CPU %u: unable to read the MSRs\n", Cpu);
+			continue;
+		}
+		if (Information.Star == First.Star && Information.Lstar == First.Lstar && Information.Cstar == First.Cstar && Information.Fmask == First.Fmask)
+			continue;
+		printf("\nSYSCALL configuration of CPU %u differs:\n", Cpu);
+		SyscallPrintEntry(&Information);
+		Differences++;
+	}
+	if (uiCpuCount > 0x01 && Differences == 0x00)
+		printf("  - Same configuration on the %u processors\n", uiCpuCount);
+}
+
+/// <summary>
+/// Print the latencies of every processor, the processors far from the others, and the histogram of all of them.
+/// </summary>
+static VOID SyscallPrintProfiles(
+	_In_ const SYSENTRY_PROFILE* pProfiles,
+	_In_ UINT32                  uiCpuCount
+) {
+	// 1. Summary per processor
+	printf("\nNull system call round trip in TSC ticks (fenced RDTSC overhead of %llu ticks excluded):\n", (unsigned long long)pProfiles[0].Overhead);
+	printf("  CPU %10s %10s %10s %10s\n", "minimum", "median", "p99", "maximum");
+	UINT64 Merged[SYSENTRY_BUCKETS] = { 0x00 };
+	PUINT64 pMedians = (PUINT64)calloc(uiCpuCount, sizeof(UINT64));
+	UINT32 Measured = 0x00;
+	for (UINT32 Cpu = 0x00; Cpu < uiCpuCount; Cpu++) {
+		const SYSENTRY_PROFILE* pProfile = &pProfiles[Cpu];
+		if (!pProfile->bMeasured) {
+			printf("  %3u not measured, unable to pin the thread\n", Cpu);
+			continue;
+		}
+		printf("  %3u %10llu %10llu %10llu %10llu\n", Cpu, (unsigned long long)pProfile->Minimum, (unsigned long long)pProfile->Median,
+			(unsigned long long)pProfile->P99, (unsigned long long)pProfile->Maximum);
+		for (UINT32 Bucket = 0x00; Bucket < SYSENTRY_BUCKETS; Bucket++)
+			Merged[Bucket] += pProfile->Buckets[Bucket];
+		if (pMedians != NULL)
+			pMedians[Measured] = pProfile->Median;
+		Measured++;
+	}
+	if (Measured == 0x00) {
+		free(pMedians);
+		return;
+	}
+
+	// 2. Processors whose median is far from the median of the medians, e.g. another core type or a noisy neighbour
+	if (pMedians != NULL && Measured > 0x01) {
+		for (UINT32 i = 0x01; i < Measured; i++) {
+			UINT64 Current = pMedians[i];
+			UINT32 j = i;
+			for (; j > 0x00 && pMedians[j - 1] > Current; j--)
+				pMedians[j] = pMedians[j - 1];
+			pMedians[j] = Current;
+		}
+		UINT64 Reference = pMedians[Measured / 2];
+		UINT32 Outliers = 0x00;
+		for (UINT32 Cpu = 0x00; Cpu < uiCpuCount; Cpu++) {
+			if (!pProfiles[Cpu].bMeasured || Reference == 0x00)
+				continue;
+			INT64 Distance = (INT64)pProfiles[Cpu].Median - (INT64)Reference;
+			if ((Distance < 0 ? -Distance : Distance) * 100 > (INT64)Reference * SYSCALL_OUTLIER_PERCENT) {
+				printf("  - CPU %u is %+.1f%% away from the median of %llu ticks\n", Cpu, 100.0 * (double)Distance / (double)Reference, (unsigned long long)Reference);
+				Outliers++;
+			}
+		}
+		if (Outliers == 0x00)
+			printf("  - Every processor is within %u%% of the median of %llu ticks\n", SYSCALL_OUTLIER_PERCENT, (unsigned long long)Reference);
+	}
+	free(pMedians);
+
+	// 3. Histogram of every round trip
+	UINT64 Highest = 0x00;
+	UINT32 First = SYSENTRY_BUCKETS;
+	UINT32 Last = 0x00;
+	for (UINT32 Bucket = 0x00; Bucket < SYSENTRY_BUCKETS; Bucket++) {
+		if (Merged[Bucket] == 0x00)
+			continue;
+		if (Merged[Bucket] > Highest)
+			Highest = Merged[Bucket];
+		if (First == SYSENTRY_BUCKETS)
+			First = Bucket;
+		Last = Bucket;
+	}
+	printf("\nHistogram of every round trip:\n");
+	for (UINT32 Bucket = First; Bucket <= Last; Bucket++) {
+		UINT32 Width = (UINT32)(Merged[Bucket] * SYSCALL_BAR_WIDTH / Highest);
+		printf("  >= %8llu %8llu ", (unsigned long long)SysEntryGetBucketFloor(Bucket), (unsigned long long)Merged[Bucket]);
+		for (UINT32 Index = 0x00; Index < Width; Index++)
+			printf("#");
+		printf("\n");
+	}
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Optional number of round trips per processor.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	if (argc > 2) {
+		printf("Usage: %s [round trips per processor]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	UINT32 uiSamples = argc == 2 ? (UINT32)strtoul(argv[1], NULL, 0) : 0x00;
+	UINT32 uiCpuCount = ThreadGetCpuCount();
+
+	// 1. The MSRs need the driver or root, the latencies need neither
+	MSR_BACKEND Msr = { 0x00 };
+	if (MsrOpen(&Msr)) {
+		SyscallPrintEntries(&Msr, uiCpuCount);
+		MsrClose(&Msr);
+	}
+	else {
+		printf("Unable to open the MSR backend, the SYSCALL MSRs will not be decoded.\n");
+	}
+
+	// 2. One processor at a time, so that they do not compete for the kernel
+	PSYSENTRY_PROFILE pProfiles = (PSYSENTRY_PROFILE)calloc(uiCpuCount, sizeof(SYSENTRY_PROFILE));
+	if (pProfiles == NULL)
+		return EXIT_FAILURE;
+	for (UINT32 Cpu = 0x00; Cpu < uiCpuCount; Cpu++)
+		(VOID)SysEntryProfile(Cpu, uiSamples, &pProfiles[Cpu]);
+	SyscallPrintProfiles(pProfiles, uiCpuCount);
+	free(pProfiles);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+/// @file    main.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include "tscsync.h"
+
+/// Largest machine whose whole matrix is printed
+#define TSC_MATRIX_MAX_CPUS 16
+
+/// Number of pairs listed on larger machines
+#define TSC_WORST_PAIRS 10
+
+/// <summary>
+/// Convert TSC ticks to nanoseconds.
+/// </summary>
+static double TscToNanoseconds(
+	_In_ const TSC_SYNC* pSync,
+	_In_ INT64           Ticks
+) {
+	return pSync->Frequency != 0x00 ? (double)Ticks * 1e9 / (double)pSync->Frequency : 0.0;
+}
+
+/// <summary>
+/// Print the offset of every processor relative to every other one: the middle of the bounds, and the
+/// half width of the bounds as the uncertainty.
+/// </summary>
+static VOID TscPrintMatrix(
+	_In_ const TSC_SYNC* pSync
+) {
+	printf("\nOffset of the column relative to the row in ticks (+/- uncertainty):\n      ");
+	for (UINT32 Column = 0x00; Column < pSync->CpuCount; Column++)
+		printf(" %14u", Column);
+	printf("\n");
+
+	for (UINT32 Row = 0x00; Row < pSync->CpuCount; Row++) {
+		printf("  %3u ", Row);
+		for (UINT32 Column = 0x00; Column < pSync->CpuCount; Column++) {
+			const TSC_PAIR* pPair = TscSyncGetPair(pSync, Row, Column);
+			if (Row == Column)
+				printf(" %14s", "-");
+			else if (pPair->Lower > pPair->Upper)
+				printf(" %14s", "inconsistent");
+			else
+				printf(" %7lld+/-%-4lld", (long long)(pPair->Lower / 2 + pPair->Upper / 2), (long long)((pPair->Upper - pPair->Lower) / 2));
+		}
+		printf("\n");
+	}
+}
+
+/// <summary>
+/// Print the pairs with the largest offsets proven, for machines too large for the matrix.
+/// </summary>
+static VOID TscPrintWorstPairs(
+	_In_ const TSC_SYNC* pSync
+) {
+	printf("\nPairs with the largest offsets:\n");
+	INT64 Previous = INT64_MAX;
+	UINT32 Printed = 0x00;
+
+	// Repeatedly pick the largest skew below the previous one, enough for a handful of lines
+	while (Printed < TSC_WORST_PAIRS) {
+		INT64 Best = -1;
+		for (UINT32 Row = 0x00; Row < pSync->CpuCount; Row++) {
+			for (UINT32 Column = Row + 1; Column < pSync->CpuCount; Column++) {
+				INT64 Skew = TscSyncGetSkew(TscSyncGetPair(pSync, Row, Column));
+				if (Skew < Previous && Skew > Best)
+					Best = Skew;
+			}
+		}
+		if (Best <= 0x00)
+			break;
+		for (UINT32 Row = 0x00; Row < pSync->CpuCount && Printed < TSC_WORST_PAIRS; Row++) {
+			for (UINT32 Column = Row + 1; Column < pSync->CpuCount && Printed < TSC_WORST_PAIRS; Column++) {
+				const TSC_PAIR* pPair = TscSyncGetPair(pSync, Row, Column);
+				if (TscSyncGetSkew(pPair) != Best)
+					continue;
+				printf("  - CPU %u -> CPU %u: [%lld, %lld] ticks\n", Row, Column, (long long)pPair->Lower, (long long)pPair->Upper);
+				Printed++;
+			}
+		}
+		Previous = Best;
+	}
+	if (Printed == 0x00)
+		printf("  - None, every pair may be synchronised\n");
+}
+
+/// <summary>
+/// Entry point of the application.
+/// </summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Optional round trips per pair and tolerance in nanoseconds.</param>
+/// <returns>Process exit status code.</returns>
+INT main(INT argc, CHAR* argv[]) {
+	if (argc > 3) {
+		printf("Usage: %s [samples per pair] [tolerance in ns]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	UINT32 uiSamples = argc >= 2 ? (UINT32)strtoul(argv[1], NULL, 0) : 0x00;
+	UINT32 uiToleranceNs = argc >= 3 ? (UINT32)strtoul(argv[2], NULL, 0) : 0x00;
+
+	// 1. IA32_TSC_ADJUST is optional, the offsets are measured either way
+	MSR_BACKEND Msr = { 0x00 };
+	BOOL bMsr = MsrOpen(&Msr);
+	if (!bMsr)
+		printf("Unable to open the MSR backend, IA32_TSC_ADJUST will not be read.\n");
+
+	// 2. Measure
+	TSC_SYNC Sync = { 0x00 };
+	BOOL bMeasured = TscSyncMeasure(&Sync, bMsr ? &Msr : NULL, uiSamples, uiToleranceNs);
+	if (bMsr)
+		MsrClose(&Msr);
+	if (!bMeasured) {
+		printf("Unable to measure the TSC offsets, a thread could not be pinned on every processor.\n");
+		return EXIT_FAILURE;
+	}
+
+	// 3. Processor
+	printf("Processors:           %u\n", Sync.CpuCount);
+	printf("Invariant TSC:        %s\n", Sync.bInvariant ? "yes" : "no");
+	printf("TSC frequency:        %.3f MHz\n", (double)Sync.Frequency / 1e6);
+	if (!Sync.bAdjust) {
+		printf("IA32_TSC_ADJUST:      not available\n");
+	}
+	else if (Sync.bAdjustEqual) {
+		printf("IA32_TSC_ADJUST:      %lld on every processor\n", (long long)Sync.Adjust[0]);
+	}
+	else {
+		printf("IA32_TSC_ADJUST:      differs between processors\n");
+		for (UINT32 Cpu = 0x00; Cpu < Sync.CpuCount; Cpu++)
+			printf("  - CPU %3u: %lld\n", Cpu, (long long)Sync.Adjust[Cpu]);
+	}
+
+	// 4. Offsets
+	if (Sync.CpuCount < 2) {
+		printf("\nA single processor, there is no pair to measure.\n");
+	}
+	else {
+		printf("Round trips per pair: %u\n", Sync.Samples);
+		if (Sync.CpuCount <= TSC_MATRIX_MAX_CPUS)
+			TscPrintMatrix(&Sync);
+		else
+			TscPrintWorstPairs(&Sync);
+		printf("\nLargest offset proven: %lld ticks (%.1f ns)", (long long)Sync.MaxSkew, TscToNanoseconds(&Sync, Sync.MaxSkew));
+		if (Sync.MaxSkew != 0x00)
+			printf(" between CPU %u and CPU %u", Sync.WorstRow, Sync.WorstColumn);
+		printf("\nLargest uncertainty:   %lld ticks (%.1f ns)\n", (long long)Sync.MaxUncertainty, TscToNanoseconds(&Sync, Sync.MaxUncertainty));
+		if (Sync.Inconsistent != 0x00)
+			printf("Inconsistent pairs:    %u\n", Sync.Inconsistent);
+	}
+
+	// 5. Verdict
+	printf("\nTSC as a global clock: %s\n", Sync.bSafe ? "safe" : "NOT safe");
+	if (!Sync.bInvariant)
+		printf("  - The TSC rate may change with the P-states and C-states.\n");
+	if (Sync.bAdjust && !Sync.bAdjustEqual)
+		printf("  - IA32_TSC_ADJUST was written on some processors only.\n");
+	if (Sync.MaxSkew > Sync.Tolerance)
+		printf("  - Timestamps of different processors are off by more than %u ns.\n", uiToleranceNs);
+	TscSyncFree(&Sync);
+	return Sync.bSafe ? EXIT_SUCCESS : EXIT_FAILURE;
+}
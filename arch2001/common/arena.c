@@ -0,0 +1,338 @@
+/// @file    arena.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
+
+#if !defined(_WIN32)
+#if !defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_SHIFT 26
+#endif
+#define ARENA_MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#define ARENA_MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+/// <summary>
+/// Get the TLB sizes from the deterministic address translation leaf of Intel processors.
+/// </summary>
+static VOID ArenaQueryIntelTlb(
+	_In_    PCPUID_BACKEND pBackend,
+	_Inout_ PARENA_TLB     pTlb
+) {
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_TLB_PARAMETERS, 0x00, Registers))
+		return;
+
+	UINT MaximumSubLeaf = Registers[0];
+	for (UINT SubLeaf = 0x00; SubLeaf <= MaximumSubLeaf && SubLeaf < 0x20; SubLeaf++) {
+		if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_TLB_PARAMETERS, SubLeaf, Registers))
+			break;
+		TlbParametersEbx Pages = { .value = Registers[1] };
+		TlbParametersEdx Tlb = { .value = Registers[3] };
+
+		// Data, unified and load-only TLBs of the first two levels
+		if (Tlb.elem.Type != 0x01 && Tlb.elem.Type != 0x03 && Tlb.elem.Type != 0x04)
+			continue;
+		if (Tlb.elem.Level != 0x01 && Tlb.elem.Level != 0x02)
+			continue;
+		PUINT32 Entries = Tlb.elem.Level == 0x01 ? pTlb->L1Entries : pTlb->L2Entries;
+		UINT32 uiEntries = Pages.elem.Ways * Registers[2];
+		if (Pages.elem.Page4K && uiEntries > Entries[ARENA_PAGE_4K])
+			Entries[ARENA_PAGE_4K] = uiEntries;
+		if (Pages.elem.Page2M && uiEntries > Entries[ARENA_PAGE_2M])
+			Entries[ARENA_PAGE_2M] = uiEntries;
+		if (Pages.elem.Page1G && uiEntries > Entries[ARENA_PAGE_1G])
+			Entries[ARENA_PAGE_1G] = uiEntries;
+	}
+}
+
+/// <summary>
+/// Get the TLB sizes from the L1 and L2 cache and TLB leaves of AMD processors.
+/// </summary>
+static VOID ArenaQueryAmdTlb(
+	_In_    PCPUID_BACKEND pBackend,
+	_In_    UINT           MaximumExtendedLeaf,
+	_Inout_ PARENA_TLB     pTlb
+) {
+	UINT Registers[4] = { 0x00 };
+	if (MaximumExtendedLeaf >= CPUID_LEAF_L1_CACHE_TLB && CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_L1_CACHE_TLB, 0x00, Registers)) {
+		pTlb->L1Entries[ARENA_PAGE_2M] = (Registers[0] >> 16) & 0xFF;
+		pTlb->L1Entries[ARENA_PAGE_4K] = (Registers[1] >> 16) & 0xFF;
+	}
+	if (MaximumExtendedLeaf >= CPUID_LEAF_L2_CACHE_TLB && CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_L2_CACHE_TLB, 0x00, Registers)) {
+		pTlb->L2Entries[ARENA_PAGE_2M] = (Registers[0] >> 16) & 0xFFF;
+		pTlb->L2Entries[ARENA_PAGE_4K] = (Registers[1] >> 16) & 0xFFF;
+	}
+	if (MaximumExtendedLeaf >= CPUID_LEAF_TLB_1GB && CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_TLB_1GB, 0x00, Registers)) {
+		pTlb->L1Entries[ARENA_PAGE_1G] = (Registers[0] >> 16) & 0xFFF;
+		pTlb->L2Entries[ARENA_PAGE_1G] = (Registers[1] >> 16) & 0xFFF;
+	}
+}
+
+#if defined(_WIN32)
+/// <summary>
+/// Enable SeLockMemoryPrivilege, needed to allocate large pages.
+/// </summary>
+static BOOL ArenaEnableLargePages() {
+	HANDLE hToken = NULL;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+		return FALSE;
+
+	TOKEN_PRIVILEGES Privileges = { 0x00 };
+	Privileges.PrivilegeCount = 0x01;
+	Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	BOOL bSuccess = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &Privileges.Privileges[0].Luid)
+		&& AdjustTokenPrivileges(hToken, FALSE, &Privileges, 0x00, NULL, NULL)
+		&& GetLastError() == ERROR_SUCCESS;
+	CloseHandle(hToken);
+	return bSuccess;
+}
+#else
+/// <summary>
+/// Read a number from a file of sysfs.
+/// </summary>
+static UINT64 ArenaReadNumber(
+	_In_ LPCSTR szPath
+) {
+	unsigned long long Value = 0x00;
+	FILE* pFile = fopen(szPath, "r");
+	if (pFile == NULL)
+		return 0x00;
+	if (fscanf(pFile, "%llu", &Value) != 0x01)
+		Value = 0x00;
+	fclose(pFile);
+	return (UINT64)Value;
+}
+#endif
+
+_Use_decl_annotations_
+BOOL ArenaQuerySupport(
+	_In_  PCPUID_BACKEND pBackend,
+	_Out_ PARENA_SUPPORT pSupport
+) {
+	if (pBackend == NULL || pSupport == NULL)
+		return FALSE;
+	RtlZeroMemory(pSupport, sizeof(ARENA_SUPPORT));
+
+	// 1. 2 MiB pages are architectural in IA-32e mode, 1 GiB pages are enumerated by CPUID.80000001H:EDX[26]
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers))
+		return FALSE;
+	UINT MaximumLeaf = Registers[0];
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_MAXIMUM, 0x00, Registers))
+		return FALSE;
+	UINT MaximumExtendedLeaf = Registers[0];
+
+	pSupport->Cpu[ARENA_PAGE_4K] = TRUE;
+	if (CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_BASIC_INFORMATION, 0x00, Registers)) {
+		BasicInformationEdx Features = { .value = Registers[3] };
+		pSupport->Cpu[ARENA_PAGE_2M] = Features.elem.PSE || Features.elem.PAE;
+	}
+	if (MaximumExtendedLeaf >= CPUID_LEAF_EXTENDED_INFORMATION && CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_INFORMATION, 0x00, Registers)) {
+		ExtendedInformationEdx Features = { .value = Registers[3] };
+		pSupport->Cpu[ARENA_PAGE_1G] = Features.elem.Page1GB;
+	}
+
+	// 2. Get the TLB sizes, the AMD leaves are empty on Intel processors
+	if (MaximumLeaf >= CPUID_LEAF_TLB_PARAMETERS)
+		ArenaQueryIntelTlb(pBackend, &pSupport->Tlb);
+	if (pSupport->Tlb.L1Entries[ARENA_PAGE_4K] == 0x00 && pSupport->Tlb.L2Entries[ARENA_PAGE_4K] == 0x00)
+		ArenaQueryAmdTlb(pBackend, MaximumExtendedLeaf, &pSupport->Tlb);
+
+	// 3. Check what the OS provides
+	pSupport->Os[ARENA_PAGE_4K] = TRUE;
+#if defined(_WIN32)
+	pSupport->Os[ARENA_PAGE_2M] = pSupport->Cpu[ARENA_PAGE_2M] && GetLargePageMinimum() != 0x00 && ArenaEnableLargePages();
+#else
+	pSupport->FreePages[ARENA_PAGE_2M] = ArenaReadNumber("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages");
+	pSupport->FreePages[ARENA_PAGE_1G] = ArenaReadNumber("/sys/kernel/mm/hugepages/hugepages-1048576kB/free_hugepages");
+	pSupport->Os[ARENA_PAGE_2M] = pSupport->Cpu[ARENA_PAGE_2M] && pSupport->FreePages[ARENA_PAGE_2M] != 0x00;
+	pSupport->Os[ARENA_PAGE_1G] = pSupport->Cpu[ARENA_PAGE_1G] && pSupport->FreePages[ARENA_PAGE_1G] != 0x00;
+
+	CHAR szMode[0x80] = { 0x00 };
+	FILE* pFile = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (pFile != NULL) {
+		if (fgets(szMode, sizeof(szMode), pFile) != NULL)
+			pSupport->Transparent = pSupport->Cpu[ARENA_PAGE_2M] && (strstr(szMode, "[always]") != NULL || strstr(szMode, "[madvise]") != NULL);
+		fclose(pFile);
+	}
+#endif
+	return TRUE;
+}
+
+_Use_decl_annotations_
+SIZE_T ArenaGetPageSize(
+	_In_ UINT32 uiPage
+) {
+	switch (uiPage) {
+	case ARENA_PAGE_2M: return (SIZE_T)2 << 20;
+	case ARENA_PAGE_1G: return (SIZE_T)1 << 30;
+	default:            return (SIZE_T)4 << 10;
+	}
+}
+
+_Use_decl_annotations_
+UINT64 ArenaGetTlbReach(
+	_In_ const ARENA_SUPPORT* pSupport,
+	_In_ UINT32               uiPage
+) {
+	if (uiPage >= ARENA_PAGE_COUNT)
+		return 0x00;
+	UINT32 uiEntries = pSupport->Tlb.L1Entries[uiPage] > pSupport->Tlb.L2Entries[uiPage] ? pSupport->Tlb.L1Entries[uiPage] : pSupport->Tlb.L2Entries[uiPage];
+	return (UINT64)uiEntries * ArenaGetPageSize(uiPage);
+}
+
+/// <summary>
+/// Map memory with a given page size.
+/// </summary>
+static PVOID ArenaMap(
+	_In_ SIZE_T Size,
+	_In_ UINT32 uiPage
+) {
+#if defined(_WIN32)
+	// 1 GiB pages need VirtualAlloc2 and MEM_EXTENDED_PARAMETER_NONPAGED_HUGE, only 2 MiB pages are requested
+	if (uiPage == ARENA_PAGE_1G)
+		return NULL;
+	DWORD dwType = MEM_RESERVE | MEM_COMMIT | (uiPage == ARENA_PAGE_2M ? MEM_LARGE_PAGES : 0x00);
+	return VirtualAlloc(NULL, Size, dwType, PAGE_READWRITE);
+#else
+	INT Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if (uiPage != ARENA_PAGE_4K)
+		Flags |= MAP_HUGETLB | (uiPage == ARENA_PAGE_1G ? ARENA_MAP_HUGE_1GB : ARENA_MAP_HUGE_2MB);
+	PVOID Address = mmap(NULL, Size, PROT_READ | PROT_WRITE, Flags, -1, 0x00);
+	return Address != MAP_FAILED ? Address : NULL;
+#endif
+}
+
+#if !defined(_WIN32)
+/// <summary>
+/// Map memory aligned on 2 MiB and ask the kernel for transparent huge pages.
+/// </summary>
+static PVOID ArenaMapTransparent(
+	_In_ SIZE_T Size
+) {
+	SIZE_T Alignment = ArenaGetPageSize(ARENA_PAGE_2M);
+	PBYTE Address = (PBYTE)ArenaMap(Size + Alignment, ARENA_PAGE_4K);
+	if (Address == NULL)
+		return NULL;
+
+	// Trim the mapping to the aligned range
+	PBYTE Aligned = (PBYTE)(((ULONG_PTR)Address + Alignment - 1) & ~(ULONG_PTR)(Alignment - 1));
+	if (Aligned != Address)
+		munmap(Address, (SIZE_T)(Aligned - Address));
+	if (Aligned + Size != Address + Size + Alignment)
+		munmap(Aligned + Size, (SIZE_T)(Address + Size + Alignment - (Aligned + Size)));
+
+	if (madvise(Aligned, Size, MADV_HUGEPAGE) != 0x00) {
+		munmap(Aligned, Size);
+		return NULL;
+	}
+	return Aligned;
+}
+#endif
+
+_Use_decl_annotations_
+BOOL ArenaCreate(
+	_Out_ PARENA               pArena,
+	_In_  const ARENA_SUPPORT* pSupport,
+	_In_  SIZE_T               Size,
+	_In_  UINT32               uiLargestPage
+) {
+	if (pArena == NULL || pSupport == NULL || Size == 0x00)
+		return FALSE;
+	RtlZeroMemory(pArena, sizeof(ARENA));
+	static const LPCSTR Names[ARENA_PAGE_COUNT] = { "4 KiB pages", "2 MiB huge pages", "1 GiB huge pages" };
+
+	// 1. Reserved huge pages, from the largest size worth using for the arena
+	for (INT Page = uiLargestPage < ARENA_PAGE_COUNT ? (INT)uiLargestPage : ARENA_PAGE_1G; Page > ARENA_PAGE_4K; Page--) {
+		SIZE_T PageSize = ArenaGetPageSize((UINT32)Page);
+		SIZE_T Rounded = (Size + PageSize - 1) & ~(PageSize - 1);
+		if (!pSupport->Os[Page] || Size < PageSize)
+			continue;
+#if !defined(_WIN32)
+		if (pSupport->FreePages[Page] < Rounded / PageSize)
+			continue;
+#endif
+		pArena->Base = (PBYTE)ArenaMap(Rounded, (UINT32)Page);
+		if (pArena->Base != NULL) {
+			pArena->Size = Rounded;
+			pArena->Page = (UINT32)Page;
+			pArena->Backing = Names[Page];
+			return TRUE;
+		}
+	}
+
+	// 2. Transparent huge pages, granted by the kernel when it finds contiguous memory
+	SIZE_T PageSize = ArenaGetPageSize(ARENA_PAGE_2M);
+	SIZE_T Rounded = (Size + PageSize - 1) & ~(PageSize - 1);
+#if !defined(_WIN32)
+	if (uiLargestPage >= ARENA_PAGE_2M && pSupport->Transparent && Size >= PageSize) {
+		pArena->Base = (PBYTE)ArenaMapTransparent(Rounded);
+		if (pArena->Base != NULL) {
+			pArena->Size = Rounded;
+			pArena->Page = ARENA_PAGE_2M;
+			pArena->bTransparent = TRUE;
+			pArena->Backing = "transparent huge pages";
+			return TRUE;
+		}
+	}
+#endif
+
+	// 3. Regular pages
+	PageSize = ArenaGetPageSize(ARENA_PAGE_4K);
+	Rounded = (Size + PageSize - 1) & ~(PageSize - 1);
+	pArena->Base = (PBYTE)ArenaMap(Rounded, ARENA_PAGE_4K);
+	if (pArena->Base == NULL)
+		return FALSE;
+	pArena->Size = Rounded;
+	pArena->Page = ARENA_PAGE_4K;
+	pArena->Backing = Names[ARENA_PAGE_4K];
+	return TRUE;
+}
+
+_Use_decl_annotations_
+PVOID ArenaAlloc(
+	_Inout_ PARENA pArena,
+	_In_    SIZE_T Size,
+	_In_    SIZE_T Alignment
+) {
+	if (Alignment == 0x00)
+		Alignment = sizeof(PVOID);
+	SIZE_T Offset = (pArena->Used + Alignment - 1) & ~(Alignment - 1);
+	if (Offset > pArena->Size || Size > pArena->Size - Offset)
+		return NULL;
+	pArena->Used = Offset + Size;
+	return pArena->Base + Offset;
+}
+
+_Use_decl_annotations_
+VOID ArenaReset(
+	_Inout_ PARENA pArena
+) {
+	pArena->Used = 0x00;
+}
+
+_Use_decl_annotations_
+VOID ArenaDestroy(
+	_Inout_ PARENA pArena
+) {
+	if (pArena == NULL || pArena->Base == NULL)
+		return;
+#if defined(_WIN32)
+	VirtualFree(pArena->Base, 0x00, MEM_RELEASE);
+#else
+	munmap(pArena->Base, pArena->Size);
+#endif
+	RtlZeroMemory(pArena, sizeof(ARENA));
+}
@@ -0,0 +1,128 @@
+/// @file    arena.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __ARENA_H_GUARD__
+#define __ARENA_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+
+/// Page sizes
+#define ARENA_PAGE_4K    0x00
+#define ARENA_PAGE_2M    0x01
+#define ARENA_PAGE_1G    0x02
+#define ARENA_PAGE_COUNT 0x03
+
+/// <summary>
+/// Number of data TLB entries for each page size, from CPUID.18H on Intel and CPUID.80000005H, 80000006H and
+/// 80000019H on AMD. Zero when the processor does not report them.
+/// </summary>
+typedef struct _ARENA_TLB {
+	UINT32 L1Entries[ARENA_PAGE_COUNT];
+	UINT32 L2Entries[ARENA_PAGE_COUNT];
+} ARENA_TLB, * PARENA_TLB;
+
+/// <summary>
+/// Page sizes usable by the arenas.
+/// </summary>
+typedef struct _ARENA_SUPPORT {
+	BOOL      Cpu[ARENA_PAGE_COUNT];       // Supported by the processor.
+	BOOL      Os[ARENA_PAGE_COUNT];        // Huge pages reserved by the OS: hugetlbfs pools or Windows large pages.
+	UINT64    FreePages[ARENA_PAGE_COUNT]; // Free pages of the hugetlbfs pools, unknown on Windows.
+	BOOL      Transparent;                 // Transparent huge pages can be requested with madvise.
+	ARENA_TLB Tlb;
+} ARENA_SUPPORT, * PARENA_SUPPORT;
+
+/// <summary>
+/// Bump allocator over a single mapping backed by the largest page size available.
+/// </summary>
+typedef struct _ARENA {
+	PBYTE  Base;
+	SIZE_T Size;
+	SIZE_T Used;
+	UINT32 Page;         // ARENA_PAGE_* value of the backing pages.
+	BOOL   bTransparent; // Backed by transparent huge pages, which the kernel may not grant.
+	LPCSTR Backing;      // Description of the backing pages, for display purpose.
+} ARENA, * PARENA;
+
+/// <summary>
+/// Get the page sizes supported by the processor and the OS, and the TLB sizes.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pSupport">Pointer to the structure receiving the support.</param>
+/// <returns>Whether the processor has been queried.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL ArenaQuerySupport(
+	_In_  PCPUID_BACKEND pBackend,
+	_Out_ PARENA_SUPPORT pSupport
+);
+
+/// <summary>
+/// Get the size of a page.
+/// </summary>
+/// <param name="uiPage">ARENA_PAGE_* value.</param>
+/// <returns>Size in bytes.</returns>
+SIZE_T ArenaGetPageSize(
+	_In_ UINT32 uiPage
+);
+
+/// <summary>
+/// Get the memory a data TLB maps without a miss with a given page size.
+/// </summary>
+/// <param name="pSupport">Pointer to the support returned by ArenaQuerySupport.</param>
+/// <param name="uiPage">ARENA_PAGE_* value.</param>
+/// <returns>Reach in bytes of the largest TLB level, or 0 if unknown.</returns>
+UINT64 ArenaGetTlbReach(
+	_In_ const ARENA_SUPPORT* pSupport,
+	_In_ UINT32               uiPage
+);
+
+/// <summary>
+/// Create an arena backed by the largest page size available, falling back to smaller pages.
+/// </summary>
+/// <param name="pArena">Pointer to the arena.</param>
+/// <param name="pSupport">Pointer to the support returned by ArenaQuerySupport.</param>
+/// <param name="Size">Size of the arena, rounded up to the page size.</param>
+/// <param name="uiLargestPage">Largest ARENA_PAGE_* value to try.</param>
+/// <returns>Whether the arena has been created.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL ArenaCreate(
+	_Out_ PARENA               pArena,
+	_In_  const ARENA_SUPPORT* pSupport,
+	_In_  SIZE_T               Size,
+	_In_  UINT32               uiLargestPage
+);
+
+/// <summary>
+/// Allocate memory from an arena.
+/// </summary>
+/// <param name="pArena">Pointer to the arena.</param>
+/// <param name="Size">Number of bytes.</param>
+/// <param name="Alignment">Alignment, a power of two.</param>
+/// <returns>Pointer to the memory, or NULL if the arena is full.</returns>
+PVOID ArenaAlloc(
+	_Inout_ PARENA pArena,
+	_In_    SIZE_T Size,
+	_In_    SIZE_T Alignment
+);
+
+/// <summary>
+/// Release every allocation of an arena at once.
+/// </summary>
+/// <param name="pArena">Pointer to the arena.</param>
+VOID ArenaReset(
+	_Inout_ PARENA pArena
+);
+
+/// <summary>
+/// Release the mapping of an arena.
+/// </summary>
+/// <param name="pArena">Pointer to the arena.</param>
+VOID ArenaDestroy(
+	_Inout_ PARENA pArena
+);
+
+#endif // !__ARENA_H_GUARD__
@@ -0,0 +1,58 @@
+/// @file    atomic.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __ATOMIC_H_GUARD__
+#define __ATOMIC_H_GUARD__
+#include "ost.h"
+#if defined(_WIN32)
+#include <intrin.h>
+#endif
+
+/// Size of a cache line, used to keep data written by different processors apart
+#define CACHE_LINE_SIZE 64
+
+/// <summary>
+/// Atomic operations on 64-bit and 32-bit integers. Loads have acquire semantics and stores have
+/// release semantics, which on x86-64 only requires preventing the compiler from reordering.
+/// </summary>
+#if defined(_WIN32)
+FORCEINLINE INT64 AtomicLoad64(_In_ volatile INT64* p) { INT64 v = *p; _ReadWriteBarrier(); return v; }
+FORCEINLINE VOID AtomicStore64(_Out_ volatile INT64* p, _In_ INT64 v) { _ReadWriteBarrier(); *p = v; }
+FORCEINLINE INT64 AtomicAdd64(_Inout_ volatile INT64* p, _In_ INT64 v) { return InterlockedExchangeAdd64(p, v) + v; }
+FORCEINLINE INT64 AtomicExchange64(_Inout_ volatile INT64* p, _In_ INT64 v) { return InterlockedExchange64(p, v); }
+FORCEINLINE BOOL AtomicCompareExchange64(_Inout_ volatile INT64* p, _In_ INT64 Expected, _In_ INT64 Desired) {
+	return InterlockedCompareExchange64(p, Desired, Expected) == Expected;
+}
+FORCEINLINE INT32 AtomicLoad32(_In_ volatile INT32* p) { INT32 v = *p; _ReadWriteBarrier(); return v; }
+FORCEINLINE VOID AtomicStore32(_Out_ volatile INT32* p, _In_ INT32 v) { _ReadWriteBarrier(); *p = v; }
+FORCEINLINE INT32 AtomicAdd32(_Inout_ volatile INT32* p, _In_ INT32 v) { return (INT32)InterlockedExchangeAdd((volatile LONG*)p, v) + v; }
+FORCEINLINE INT32 AtomicExchange32(_Inout_ volatile INT32* p, _In_ INT32 v) { return (INT32)InterlockedExchange((volatile LONG*)p, v); }
+FORCEINLINE BOOL AtomicCompareExchange32(_Inout_ volatile INT32* p, _In_ INT32 Expected, _In_ INT32 Desired) {
+	return InterlockedCompareExchange((volatile LONG*)p, Desired, Expected) == Expected;
+}
+FORCEINLINE VOID AtomicFence() { MemoryBarrier(); }
+FORCEINLINE VOID AtomicPause() { _mm_pause(); }
+#else
+FORCEINLINE INT64 AtomicLoad64(_In_ volatile INT64* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+FORCEINLINE VOID AtomicStore64(_Out_ volatile INT64* p, _In_ INT64 v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+FORCEINLINE INT64 AtomicAdd64(_Inout_ volatile INT64* p, _In_ INT64 v) { return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST); }
+FORCEINLINE INT64 AtomicExchange64(_Inout_ volatile INT64* p, _In_ INT64 v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+FORCEINLINE BOOL AtomicCompareExchange64(_Inout_ volatile INT64* p, _In_ INT64 Expected, _In_ INT64 Desired) {
+	return __atomic_compare_exchange_n(p, &Expected, Desired, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+FORCEINLINE INT32 AtomicLoad32(_In_ volatile INT32* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+FORCEINLINE VOID AtomicStore32(_Out_ volatile INT32* p, _In_ INT32 v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+FORCEINLINE INT32 AtomicAdd32(_Inout_ volatile INT32* p, _In_ INT32 v) { return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST); }
+FORCEINLINE INT32 AtomicExchange32(_Inout_ volatile INT32* p, _In_ INT32 v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+FORCEINLINE BOOL AtomicCompareExchange32(_Inout_ volatile INT32* p, _In_ INT32 Expected, _In_ INT32 Desired) {
+	return __atomic_compare_exchange_n(p, &Expected, Desired, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+FORCEINLINE VOID AtomicFence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+FORCEINLINE VOID AtomicPause() { __builtin_ia32_pause(); }
+#endif
+
+#endif // !__ATOMIC_H_GUARD__
@@ -0,0 +1,567 @@
+/// @file    collector.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include "collector.h"
+#include "atomic.h"
+#include "percpu.h"
+
+#if defined(_WIN32)
+typedef WSAPOLLFD COLLECTOR_POLLFD;
+#define CollectorPoll(Fds, Count, Timeout) WSAPoll((Fds), (ULONG)(Count), (Timeout))
+#define CollectorWouldBlock() (WSAGetLastError() == WSAEWOULDBLOCK)
+#define COLLECTOR_SEND_FLAGS 0x00
+#else
+typedef struct pollfd COLLECTOR_POLLFD;
+#define CollectorPoll(Fds, Count, Timeout) poll((Fds), (nfds_t)(Count), (Timeout))
+#define CollectorWouldBlock() (errno == EAGAIN || errno == EWOULDBLOCK)
+#define COLLECTOR_SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+/// <summary>
+/// Load the socket library. Calls are reference counted on Windows.
+/// </summary>
+static BOOL CollectorSocketInitialise() {
+#if defined(_WIN32)
+	WSADATA Data = { 0x00 };
+	return WSAStartup(MAKEWORD(2, 2), &Data) == 0x00;
+#else
+	return TRUE;
+#endif
+}
+
+static VOID CollectorSocketUninitialise() {
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+}
+
+static VOID CollectorCloseSocket(
+	_In_ COLLECTOR_SOCKET Socket
+) {
+#if defined(_WIN32)
+	closesocket(Socket);
+#else
+	close(Socket);
+#endif
+}
+
+static BOOL CollectorSetNonBlocking(
+	_In_ COLLECTOR_SOCKET Socket
+) {
+#if defined(_WIN32)
+	u_long ulMode = 0x01;
+	return ioctlsocket(Socket, FIONBIO, &ulMode) == 0x00;
+#else
+	INT Flags = fcntl(Socket, F_GETFL, 0x00);
+	return Flags >= 0x00 && fcntl(Socket, F_SETFL, Flags | O_NONBLOCK) == 0x00;
+#endif
+}
+
+/// <summary>
+/// Build the address of the socket.
+/// </summary>
+static BOOL CollectorGetAddress(
+	_In_  LPCSTR              szPath,
+	_Out_ struct sockaddr_un* pAddress
+) {
+	RtlZeroMemory(pAddress, sizeof(struct sockaddr_un));
+	pAddress->sun_family = AF_UNIX;
+	SIZE_T Length = strlen(szPath);
+	if (Length == 0x00 || Length >= sizeof(pAddress->sun_path))
+		return FALSE;
+	RtlCopyMemory(pAddress->sun_path, szPath, Length);
+	return TRUE;
+}
+
+/// <summary>
+/// Remove the socket left by a previous collector. In a shared directory such as /tmp, the path may be
+/// anything created by anyone: only a socket of the user is removed.
+/// </summary>
+static VOID CollectorRemoveSocket(
+	_In_ LPCSTR szPath
+) {
+#if defined(_WIN32)
+	DeleteFileA(szPath);
+#else
+	struct stat Stat = { 0x00 };
+	if (lstat(szPath, &Stat) == 0x00 && S_ISSOCK(Stat.st_mode) && Stat.st_uid == getuid())
+		unlink(szPath);
+#endif
+}
+
+/// <summary>
+/// Send a buffer entirely on a blocking socket.
+/// </summary>
+static BOOL CollectorSendAll(
+	_In_ COLLECTOR_SOCKET Socket,
+	_In_ const UINT8*     pBuffer,
+	_In_ SIZE_T           Size
+) {
+	while (Size != 0x00) {
+		INT iSent = (INT)send(Socket, (const char*)pBuffer, (INT)Size, COLLECTOR_SEND_FLAGS);
+		if (iSent <= 0x00)
+			return FALSE;
+		pBuffer += iSent;
+		Size -= (SIZE_T)iSent;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Send as much of a buffer as a non-blocking socket accepts.
+/// </summary>
+/// <returns>FALSE if the connection failed.</returns>
+static BOOL CollectorSendSome(
+	_In_  COLLECTOR_SOCKET Socket,
+	_In_  const UINT8*     pBuffer,
+	_In_  UINT32           Size,
+	_Out_ PUINT32          pSent
+) {
+	*pSent = 0x00;
+	while (*pSent < Size) {
+		INT iSent = (INT)send(Socket, (const char*)pBuffer + *pSent, (INT)(Size - *pSent), COLLECTOR_SEND_FLAGS);
+		if (iSent <= 0x00)
+			return iSent < 0x00 && CollectorWouldBlock();
+		*pSent += (UINT32)iSent;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Send the rest of the response of a client.
+/// </summary>
+/// <returns>FALSE if the client must be disconnected.</returns>
+static BOOL CollectorFlushPeer(
+	_Inout_ PCOLLECTOR_PEER pPeer
+) {
+	UINT32 uiSent = 0x00;
+	if (!CollectorSendSome(pPeer->Socket, pPeer->Pending + pPeer->PendingOffset, pPeer->PendingSize - pPeer->PendingOffset, &uiSent))
+		return FALSE;
+	pPeer->PendingOffset += uiSent;
+	if (pPeer->PendingOffset == pPeer->PendingSize) {
+		free(pPeer->Pending);
+		pPeer->Pending = NULL;
+		pPeer->PendingOffset = 0x00;
+		pPeer->PendingSize = 0x00;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Disconnect a client.
+/// </summary>
+static VOID CollectorClosePeer(
+	_Inout_ PCOLLECTOR_PEER pPeer
+) {
+	CollectorCloseSocket(pPeer->Socket);
+	free(pPeer->Pending);
+	pPeer->Pending = NULL;
+}
+
+/// <summary>
+/// Receive a buffer entirely from a blocking socket.
+/// </summary>
+static BOOL CollectorReceiveAll(
+	_In_ COLLECTOR_SOCKET Socket,
+	_In_ PUINT8           pBuffer,
+	_In_ SIZE_T           Size
+) {
+	while (Size != 0x00) {
+		INT iReceived = (INT)recv(Socket, (char*)pBuffer, (INT)Size, 0x00);
+		if (iReceived <= 0x00)
+			return FALSE;
+		pBuffer += iReceived;
+		Size -= (SIZE_T)iReceived;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Publish the record of a processor.
+/// </summary>
+static VOID CollectorPublish(
+	_Inout_ PCOLLECTOR_SLOT        pSlot,
+	_In_    const SNAPSHOT_RECORD* pRecord
+) {
+	AtomicAdd64(&pSlot->Sequence, 1);
+	RtlCopyMemory(&pSlot->Record, pRecord, sizeof(SNAPSHOT_RECORD));
+	AtomicAdd64(&pSlot->Sequence, 1);
+}
+
+/// <summary>
+/// Copy the record of a processor without blocking the refresh thread.
+/// </summary>
+static VOID CollectorRead(
+	_In_  PCOLLECTOR_SLOT  pSlot,
+	_Out_ PSNAPSHOT_RECORD pRecord
+) {
+	for (;;) {
+		INT64 Sequence = AtomicLoad64(&pSlot->Sequence);
+		if ((Sequence & 0x01) == 0x00) {
+			RtlCopyMemory(pRecord, &pSlot->Record, sizeof(SNAPSHOT_RECORD));
+			AtomicFence();
+			if (AtomicLoad64(&pSlot->Sequence) == Sequence)
+				return;
+		}
+		AtomicPause();
+	}
+}
+
+/// <summary>
+/// Routine of the thread refreshing the MSRs.
+/// </summary>
+static VOID CollectorRefresh(
+	_In_ PVOID Parameter
+) {
+	PCOLLECTOR_SERVER pServer = (PCOLLECTOR_SERVER)Parameter;
+	SNAPSHOT_RECORD Record = { 0x00 };
+
+	while (!AtomicLoad32(&pServer->bStop)) {
+		// 1. Wait for the next refresh, checking regularly whether the collector is stopping
+		for (UINT32 uiWaited = 0x00; uiWaited < pServer->Info.RefreshInterval && !AtomicLoad32(&pServer->bStop); uiWaited += 50)
+			ThreadSleep(50);
+		if (AtomicLoad32(&pServer->bStop))
+			break;
+
+		// 2. Read the MSRs of every processor captured at start
+		for (UINT32 Index = 0x00; Index < pServer->Info.CpuCount; Index++) {
+			CollectorRead(&pServer->Slots[Index], &Record);
+			if (Record.Magic == SNAPSHOT_RECORD_MAGIC && SnapshotRefresh(&pServer->Context, &Record))
+				CollectorPublish(&pServer->Slots[Index], &Record);
+		}
+		AtomicAdd64((volatile INT64*)&pServer->Info.Generation, 1);
+	}
+}
+
+/// <summary>
+/// Answer a complete request.
+/// </summary>
+static BOOL CollectorAnswer(
+	_In_ PCOLLECTOR_SERVER  pServer,
+	_In_ PCOLLECTOR_PEER    pPeer
+) {
+	PCOLLECTOR_RESPONSE Response = (PCOLLECTOR_RESPONSE)pServer->Buffer;
+	PUINT8 Payload = pServer->Buffer + sizeof(COLLECTOR_RESPONSE);
+	PCOLLECTOR_REQUEST Request = &pPeer->Request;
+
+	Response->Magic = COLLECTOR_MAGIC;
+	Response->Version = COLLECTOR_VERSION;
+	Response->Status = COLLECTOR_STATUS_SUCCESS;
+	Response->Length = 0x00;
+
+	if (Request->Magic != COLLECTOR_MAGIC || Request->Version != COLLECTOR_VERSION) {
+		Response->Status = COLLECTOR_STATUS_INVALID_QUERY;
+	}
+	else if (Request->Query == COLLECTOR_QUERY_PING) {
+		// Nothing to return
+	}
+	else if (Request->Query == COLLECTOR_QUERY_INFO) {
+		COLLECTOR_INFO Info = pServer->Info;
+		Info.Generation = (UINT64)AtomicLoad64((volatile INT64*)&pServer->Info.Generation);
+		RtlCopyMemory(Payload, &Info, sizeof(COLLECTOR_INFO));
+		Response->Length = sizeof(COLLECTOR_INFO);
+	}
+	else if (Request->Query == COLLECTOR_QUERY_SNAPSHOT && Request->Cpu == COLLECTOR_ALL_CPUS) {
+		for (UINT32 Index = 0x00; Index < pServer->Info.CpuCount; Index++)
+			CollectorRead(&pServer->Slots[Index], &((PSNAPSHOT_RECORD)Payload)[Index]);
+		Response->Length = pServer->Info.CpuCount * sizeof(SNAPSHOT_RECORD);
+	}
+	else if (Request->Query == COLLECTOR_QUERY_SNAPSHOT) {
+		if (Request->Cpu < pServer->Info.CpuCount) {
+			CollectorRead(&pServer->Slots[Request->Cpu], (PSNAPSHOT_RECORD)Payload);
+			Response->Length = sizeof(SNAPSHOT_RECORD);
+		}
+		else {
+			Response->Status = COLLECTOR_STATUS_INVALID_CPU;
+		}
+	}
+	else {
+		Response->Status = COLLECTOR_STATUS_INVALID_QUERY;
+	}
+
+	// A client slow to read must not hold up the others: what it cannot take now is kept and sent when its
+	// socket becomes writable.
+	UINT32 uiSize = sizeof(COLLECTOR_RESPONSE) + Response->Length;
+	UINT32 uiSent = 0x00;
+	if (!CollectorSendSome(pPeer->Socket, pServer->Buffer, uiSize, &uiSent))
+		return FALSE;
+	if (uiSent == uiSize)
+		return TRUE;
+
+	pPeer->Pending = (PUINT8)malloc(uiSize - uiSent);
+	if (pPeer->Pending == NULL)
+		return FALSE;
+	RtlCopyMemory(pPeer->Pending, pServer->Buffer + uiSent, uiSize - uiSent);
+	pPeer->PendingOffset = 0x00;
+	pPeer->PendingSize = uiSize - uiSent;
+	return TRUE;
+}
+
+/// <summary>
+/// Complete the response of a client, then read its pending requests and answer them. The requests are
+/// left in the socket while a response is incomplete, so at most one response per client is kept.
+/// </summary>
+/// <returns>FALSE if the client must be disconnected.</returns>
+static BOOL CollectorServePeer(
+	_In_ PCOLLECTOR_SERVER pServer,
+	_In_ PCOLLECTOR_PEER   pPeer
+) {
+	if (pPeer->Pending != NULL && !CollectorFlushPeer(pPeer))
+		return FALSE;
+
+	while (pPeer->Pending == NULL) {
+		PUINT8 pBuffer = (PUINT8)&pPeer->Request + pPeer->Received;
+		INT iReceived = (INT)recv(pPeer->Socket, (char*)pBuffer, (INT)(sizeof(COLLECTOR_REQUEST) - pPeer->Received), 0x00);
+		if (iReceived == 0x00)
+			return FALSE;
+		if (iReceived < 0x00)
+			return CollectorWouldBlock();
+
+		pPeer->Received += (UINT32)iReceived;
+		if (pPeer->Received < sizeof(COLLECTOR_REQUEST))
+			continue;
+		pPeer->Received = 0x00;
+		if (!CollectorAnswer(pServer, pPeer))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL CollectorGetDefaultPath(
+	_Out_writes_(uiSize) PCHAR szPath,
+	_In_  UINT32 uiSize
+) {
+#if !defined(_WIN32)
+	LPCSTR szDirectory = getenv("XDG_RUNTIME_DIR");
+	if (szDirectory != NULL && szDirectory[0] != 0x00)
+		return snprintf(szPath, uiSize, "%s/ost-collector.sock", szDirectory) < (INT)uiSize;
+#endif
+	return snprintf(szPath, uiSize, "%s", COLLECTOR_DEFAULT_PATH) < (INT)uiSize;
+}
+
+_Use_decl_annotations_
+BOOL CollectorServerStart(
+	_Out_ PCOLLECTOR_SERVER pServer,
+	_In_  LPCSTR            szPath,
+	_In_  UINT32            uiRefresh
+) {
+	RtlZeroMemory(pServer, sizeof(COLLECTOR_SERVER));
+	pServer->Listen = COLLECTOR_INVALID_SOCKET;
+	struct sockaddr_un Address;
+	if (!CollectorGetAddress(szPath, &Address) || !CollectorSocketInitialise())
+		return FALSE;
+	RtlCopyMemory(pServer->Path, Address.sun_path, sizeof(pServer->Path) - 1);
+
+	// 1. Capture all the processors once
+	SnapshotOpen(&pServer->Context);
+	pServer->Info.CpuCount = ThreadGetCpuCount();
+	pServer->Info.RefreshInterval = uiRefresh;
+	pServer->Slots = (PCOLLECTOR_SLOT)PerCpuAlloc(pServer->Info.CpuCount * sizeof(COLLECTOR_SLOT));
+	pServer->Peers = (PCOLLECTOR_PEER)calloc(COLLECTOR_MAX_CLIENTS, sizeof(COLLECTOR_PEER));
+	pServer->Buffer = (PUINT8)malloc(sizeof(COLLECTOR_RESPONSE) + pServer->Info.CpuCount * sizeof(SNAPSHOT_RECORD));
+	if (pServer->Slots == NULL || pServer->Peers == NULL || pServer->Buffer == NULL)
+		goto error;
+
+	RtlZeroMemory(pServer->Slots, pServer->Info.CpuCount * sizeof(COLLECTOR_SLOT));
+	for (UINT32 Index = 0x00; Index < pServer->Info.CpuCount; Index++) {
+		if (!SnapshotCapture(&pServer->Context, Index, &pServer->Slots[Index].Record))
+			pServer->Slots[Index].Record.Cpu = Index;
+	}
+	pServer->Info.Started = pServer->Slots[0].Record.Timestamp;
+
+	// 2. Listen on the socket
+	pServer->Listen = socket(AF_UNIX, SOCK_STREAM, 0x00);
+	if (pServer->Listen == COLLECTOR_INVALID_SOCKET)
+		goto error;
+	CollectorRemoveSocket(pServer->Path);
+	if (bind(pServer->Listen, (struct sockaddr*)&Address, sizeof(Address)) != 0x00
+		|| listen(pServer->Listen, SOMAXCONN) != 0x00
+		|| !CollectorSetNonBlocking(pServer->Listen))
+		goto error;
+
+	// 3. Start refreshing the MSRs
+	if (!ThreadCreate(&pServer->Refresher, CollectorRefresh, pServer))
+		goto error;
+	return TRUE;
+
+error:
+	CollectorServerClose(pServer);
+	return FALSE;
+}
+
+_Use_decl_annotations_
+VOID CollectorServerRun(
+	_Inout_ PCOLLECTOR_SERVER pServer
+) {
+	COLLECTOR_POLLFD* Fds = (COLLECTOR_POLLFD*)calloc(COLLECTOR_MAX_CLIENTS + 1, sizeof(COLLECTOR_POLLFD));
+	if (Fds == NULL)
+		return;
+
+	while (!AtomicLoad32(&pServer->bStop)) {
+		// 1. Wait for a new client, a request or room for the rest of a response. Pending connections are left in the backlog while the table
+		// of clients is full, the listening socket would otherwise be reported as readable at once.
+		UINT32 First = pServer->PeerCount < COLLECTOR_MAX_CLIENTS ? 0x00 : 0x01;
+		Fds[0].fd = pServer->Listen;
+		Fds[0].events = POLLIN;
+		Fds[0].revents = 0x00;
+		for (UINT32 Index = 0x00; Index < pServer->PeerCount; Index++) {
+			Fds[Index + 1].fd = pServer->Peers[Index].Socket;
+			Fds[Index + 1].events = pServer->Peers[Index].Pending != NULL ? POLLOUT : POLLIN;
+			Fds[Index + 1].revents = 0x00;
+		}
+		if (CollectorPoll(Fds + First, pServer->PeerCount + 1 - First, 100) <= 0x00)
+			continue;
+
+		// 2. Serve the clients. Walked backwards so that a disconnected client can be replaced by the last one.
+		for (UINT32 Index = pServer->PeerCount; Index-- > 0x00; ) {
+			if (Fds[Index + 1].revents == 0x00)
+				continue;
+			if (!CollectorServePeer(pServer, &pServer->Peers[Index])) {
+				CollectorClosePeer(&pServer->Peers[Index]);
+				pServer->Peers[Index] = pServer->Peers[--pServer->PeerCount];
+			}
+		}
+
+		// 3. Accept the new clients
+		while ((Fds[0].revents & POLLIN) && pServer->PeerCount < COLLECTOR_MAX_CLIENTS) {
+			COLLECTOR_SOCKET Socket = accept(pServer->Listen, NULL, NULL);
+			if (Socket == COLLECTOR_INVALID_SOCKET)
+				break;
+			if (!CollectorSetNonBlocking(Socket)) {
+				CollectorCloseSocket(Socket);
+				continue;
+			}
+			RtlZeroMemory(&pServer->Peers[pServer->PeerCount], sizeof(COLLECTOR_PEER));
+			pServer->Peers[pServer->PeerCount++].Socket = Socket;
+		}
+	}
+	free(Fds);
+}
+
+_Use_decl_annotations_
+VOID CollectorServerStop(
+	_Inout_ PCOLLECTOR_SERVER pServer
+) {
+	AtomicStore32(&pServer->bStop, TRUE);
+}
+
+_Use_decl_annotations_
+VOID CollectorServerClose(
+	_Inout_ PCOLLECTOR_SERVER pServer
+) {
+	// 1. Stop the refresh thread
+	CollectorServerStop(pServer);
+#if defined(_WIN32)
+	if (pServer->Refresher.hThread != NULL)
+#else
+	if (pServer->Refresher.Thread != 0x00)
+#endif
+		ThreadJoin(&pServer->Refresher);
+
+	// 2. Disconnect the clients and remove the socket
+	for (UINT32 Index = 0x00; Index < pServer->PeerCount; Index++)
+		CollectorClosePeer(&pServer->Peers[Index]);
+	pServer->PeerCount = 0x00;
+	if (pServer->Listen != COLLECTOR_INVALID_SOCKET) {
+		CollectorCloseSocket(pServer->Listen);
+		CollectorRemoveSocket(pServer->Path);
+		pServer->Listen = COLLECTOR_INVALID_SOCKET;
+	}
+
+	// 3. Release the memory and the sources
+	PerCpuFree(pServer->Slots);
+	free(pServer->Peers);
+	free(pServer->Buffer);
+	pServer->Slots = NULL;
+	pServer->Peers = NULL;
+	pServer->Buffer = NULL;
+	SnapshotClose(&pServer->Context);
+	CollectorSocketUninitialise();
+}
+
+_Use_decl_annotations_
+BOOL CollectorConnect(
+	_In_  LPCSTR            szPath,
+	_Out_ PCOLLECTOR_CLIENT pClient
+) {
+	pClient->Socket = COLLECTOR_INVALID_SOCKET;
+	struct sockaddr_un Address;
+	if (!CollectorGetAddress(szPath, &Address) || !CollectorSocketInitialise())
+		return FALSE;
+
+	pClient->Socket = socket(AF_UNIX, SOCK_STREAM, 0x00);
+	if (pClient->Socket != COLLECTOR_INVALID_SOCKET
+		&& connect(pClient->Socket, (struct sockaddr*)&Address, sizeof(Address)) == 0x00)
+		return TRUE;
+
+	if (pClient->Socket != COLLECTOR_INVALID_SOCKET)
+		CollectorCloseSocket(pClient->Socket);
+	pClient->Socket = COLLECTOR_INVALID_SOCKET;
+	CollectorSocketUninitialise();
+	return FALSE;
+}
+
+_Use_decl_annotations_
+UINT8 CollectorQuery(
+	_In_      PCOLLECTOR_CLIENT pClient,
+	_In_      UINT8             uiQuery,
+	_In_      UINT32            uiCpu,
+	_Out_opt_ PVOID             pBuffer,
+	_In_      UINT32            uiSize,
+	_Out_opt_ PUINT32           pReturned
+) {
+	// 1. Send the request
+	COLLECTOR_REQUEST Request = { COLLECTOR_MAGIC, COLLECTOR_VERSION, uiQuery, uiCpu };
+	COLLECTOR_RESPONSE Response = { 0x00 };
+	if (!CollectorSendAll(pClient->Socket, (const UINT8*)&Request, sizeof(Request))
+		|| !CollectorReceiveAll(pClient->Socket, (PUINT8)&Response, sizeof(Response))
+		|| Response.Magic != COLLECTOR_MAGIC)
+		return COLLECTOR_STATUS_DISCONNECTED;
+
+	// 2. Receive the payload, dropping what does not fit in the buffer
+	UINT32 uiCopied = pBuffer == NULL ? 0x00 : (Response.Length < uiSize ? Response.Length : uiSize);
+	if (!CollectorReceiveAll(pClient->Socket, (PUINT8)pBuffer, uiCopied))
+		return COLLECTOR_STATUS_DISCONNECTED;
+	for (UINT32 uiLeft = Response.Length - uiCopied; uiLeft != 0x00; ) {
+		UINT8 Discard[256];
+		UINT32 uiChunk = uiLeft < sizeof(Discard) ? uiLeft : sizeof(Discard);
+		if (!CollectorReceiveAll(pClient->Socket, Discard, uiChunk))
+			return COLLECTOR_STATUS_DISCONNECTED;
+		uiLeft -= uiChunk;
+	}
+
+	if (pReturned != NULL)
+		*pReturned = uiCopied;
+	return Response.Status;
+}
+
+_Use_decl_annotations_
+VOID CollectorDisconnect(
+	_Inout_ PCOLLECTOR_CLIENT pClient
+) {
+	if (pClient->Socket == COLLECTOR_INVALID_SOCKET)
+		return;
+	CollectorCloseSocket(pClient->Socket);
+	pClient->Socket = COLLECTOR_INVALID_SOCKET;
+	CollectorSocketUninitialise();
+}
@@ -0,0 +1,224 @@
+/// @file    collector.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __COLLECTOR_H_GUARD__
+#define __COLLECTOR_H_GUARD__
+#if defined(_WIN32)
+#include <winsock2.h>
+#endif
+#include "ost.h"
+#include "snapshot.h"
+#include "thread.h"
+
+/// Path of the socket when XDG_RUNTIME_DIR is not set, see CollectorGetDefaultPath
+#if defined(_WIN32)
+#define COLLECTOR_DEFAULT_PATH "ost-collector.sock"
+#else
+#define COLLECTOR_DEFAULT_PATH "/tmp/ost-collector.sock"
+#endif
+
+/// Protocol identification
+#define COLLECTOR_MAGIC   0x4F43 // "CO"
+#define COLLECTOR_VERSION 0x01
+
+/// Default interval between two refreshes of the MSRs and maximum number of clients
+#define COLLECTOR_DEFAULT_REFRESH 1000
+#define COLLECTOR_MAX_CLIENTS     1024
+
+/// Processor index meaning "all the processors"
+#define COLLECTOR_ALL_CPUS 0xFFFFFFFF
+
+/// List of the queries
+#define COLLECTOR_QUERY_PING     0x00 // No payload.
+#define COLLECTOR_QUERY_INFO     0x01 // COLLECTOR_INFO.
+#define COLLECTOR_QUERY_SNAPSHOT 0x02 // One SNAPSHOT_RECORD, or one per processor for COLLECTOR_ALL_CPUS.
+
+/// Status of a response
+#define COLLECTOR_STATUS_SUCCESS       0x00
+#define COLLECTOR_STATUS_INVALID_QUERY 0x01
+#define COLLECTOR_STATUS_INVALID_CPU   0x02
+#define COLLECTOR_STATUS_DISCONNECTED  0xFF // Returned by CollectorQuery when the connection failed.
+
+#if defined(_WIN32)
+typedef SOCKET COLLECTOR_SOCKET;
+#define COLLECTOR_INVALID_SOCKET INVALID_SOCKET
+#else
+typedef INT COLLECTOR_SOCKET;
+#define COLLECTOR_INVALID_SOCKET (-1)
+#endif
+
+/// <summary>
+/// Request sent by a client. Requests and responses are little-endian and use a fixed layout.
+/// </summary>
+typedef struct _COLLECTOR_REQUEST {
+	UINT16 Magic;   // COLLECTOR_MAGIC
+	UINT8  Version; // COLLECTOR_VERSION
+	UINT8  Query;   // COLLECTOR_QUERY_*
+	UINT32 Cpu;     // Index of the processor, or COLLECTOR_ALL_CPUS.
+} COLLECTOR_REQUEST, * PCOLLECTOR_REQUEST;
+
+/// <summary>
+/// Header of the response, followed by Length bytes of payload.
+/// </summary>
+typedef struct _COLLECTOR_RESPONSE {
+	UINT16 Magic;   // COLLECTOR_MAGIC
+	UINT8  Version; // COLLECTOR_VERSION
+	UINT8  Status;  // COLLECTOR_STATUS_*
+	UINT32 Length;  // Size of the payload in bytes.
+} COLLECTOR_RESPONSE, * PCOLLECTOR_RESPONSE;
+
+/// <summary>
+/// Payload of COLLECTOR_QUERY_INFO.
+/// </summary>
+typedef struct _COLLECTOR_INFO {
+	UINT32 CpuCount;
+	UINT32 RefreshInterval; // Milliseconds.
+	UINT64 Generation;      // Number of refreshes since the collector started.
+	UINT64 Started;         // Nanoseconds since the Unix epoch.
+} COLLECTOR_INFO, * PCOLLECTOR_INFO;
+
+C_ASSERT(sizeof(COLLECTOR_REQUEST) == 8);
+C_ASSERT(sizeof(COLLECTOR_RESPONSE) == 8);
+C_ASSERT(sizeof(COLLECTOR_INFO) == 24);
+
+/// <summary>
+/// Record of a processor published by the refresh thread. Readers retry while Sequence is odd or
+/// changed during their copy.
+/// </summary>
+typedef struct DECLSPEC_ALIGN(64) _COLLECTOR_SLOT {
+	volatile INT64  Sequence;
+	SNAPSHOT_RECORD Record;
+} COLLECTOR_SLOT, * PCOLLECTOR_SLOT;
+
+/// <summary>
+/// State of a connected client.
+/// </summary>
+typedef struct _COLLECTOR_PEER {
+	COLLECTOR_SOCKET  Socket;
+	UINT32            Received;
+	COLLECTOR_REQUEST Request;
+	PUINT8            Pending;       // Rest of a response the client was not ready for, NULL if none.
+	UINT32            PendingOffset;
+	UINT32            PendingSize;
+} COLLECTOR_PEER, * PCOLLECTOR_PEER;
+
+/// <summary>
+/// Long-running collector. Sources are opened once, the CPUID leaves and descriptor tables are
+/// captured once and the MSRs are refreshed periodically by a background thread.
+/// </summary>
+typedef struct _COLLECTOR_SERVER {
+	CHAR             Path[108];
+	COLLECTOR_SOCKET Listen;
+	SNAPSHOT_CONTEXT Context;
+	COLLECTOR_INFO   Info;
+	PCOLLECTOR_SLOT  Slots;
+	PCOLLECTOR_PEER  Peers;
+	UINT32           PeerCount;
+	PUINT8           Buffer;
+	THREAD           Refresher;
+	volatile INT32   bStop;
+} COLLECTOR_SERVER, * PCOLLECTOR_SERVER;
+
+/// <summary>
+/// Connection to a collector.
+/// </summary>
+typedef struct _COLLECTOR_CLIENT {
+	COLLECTOR_SOCKET Socket;
+} COLLECTOR_CLIENT, * PCOLLECTOR_CLIENT;
+
+/// <summary>
+/// Get the default path of the socket: in XDG_RUNTIME_DIR, private to the user, when it is set and
+/// COLLECTOR_DEFAULT_PATH otherwise.
+/// </summary>
+/// <param name="szPath">Buffer receiving the path.</param>
+/// <param name="uiSize">Size of the buffer in bytes.</param>
+/// <returns>Whether the path fits in the buffer.</returns>
+_Success_(return != 0x00)
+BOOL CollectorGetDefaultPath(
+	_Out_writes_(uiSize) PCHAR szPath,
+	_In_  UINT32 uiSize
+);
+
+/// <summary>
+/// Capture all the processors, start the refresh thread and listen on the socket.
+/// </summary>
+/// <param name="pServer">Pointer to the collector.</param>
+/// <param name="szPath">Path of the socket. An existing socket of the user is replaced, any other file is
+/// left in place and the collector does not start.</param>
+/// <param name="uiRefresh">Interval between two refreshes of the MSRs in milliseconds.</param>
+/// <returns>Whether the collector is ready to serve.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CollectorServerStart(
+	_Out_ PCOLLECTOR_SERVER pServer,
+	_In_  LPCSTR            szPath,
+	_In_  UINT32            uiRefresh
+);
+
+/// <summary>
+/// Serve the clients until CollectorServerStop is called.
+/// </summary>
+/// <param name="pServer">Pointer to the collector.</param>
+VOID CollectorServerRun(
+	_Inout_ PCOLLECTOR_SERVER pServer
+);
+
+/// <summary>
+/// Ask the collector to stop. May be called from any thread.
+/// </summary>
+/// <param name="pServer">Pointer to the collector.</param>
+VOID CollectorServerStop(
+	_Inout_ PCOLLECTOR_SERVER pServer
+);
+
+/// <summary>
+/// Stop the refresh thread and release all the resources of the collector.
+/// </summary>
+/// <param name="pServer">Pointer to the collector.</param>
+VOID CollectorServerClose(
+	_Inout_ PCOLLECTOR_SERVER pServer
+);
+
+/// <summary>
+/// Connect to a collector.
+/// </summary>
+/// <param name="szPath">Path of the socket.</param>
+/// <param name="pClient">Pointer to the structure receiving the connection.</param>
+/// <returns>Whether the connection has been established.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CollectorConnect(
+	_In_  LPCSTR            szPath,
+	_Out_ PCOLLECTOR_CLIENT pClient
+);
+
+/// <summary>
+/// Send a query and wait for its response.
+/// </summary>
+/// <param name="pClient">Pointer to the connection.</param>
+/// <param name="uiQuery">COLLECTOR_QUERY_* value.</param>
+/// <param name="uiCpu">Index of the processor, or COLLECTOR_ALL_CPUS.</param>
+/// <param name="pBuffer">Buffer receiving the payload.</param>
+/// <param name="uiSize">Size of the buffer. A larger payload is truncated.</param>
+/// <param name="pReturned">Pointer receiving the size of the payload.</param>
+/// <returns>The COLLECTOR_STATUS_* value of the response.</returns>
+UINT8 CollectorQuery(
+	_In_      PCOLLECTOR_CLIENT pClient,
+	_In_      UINT8             uiQuery,
+	_In_      UINT32            uiCpu,
+	_Out_opt_ PVOID             pBuffer,
+	_In_      UINT32            uiSize,
+	_Out_opt_ PUINT32           pReturned
+);
+
+/// <summary>
+/// Close the connection to a collector.
+/// </summary>
+/// <param name="pClient">Pointer to the connection.</param>
+VOID CollectorDisconnect(
+	_Inout_ PCOLLECTOR_CLIENT pClient
+);
+
+#endif // !__COLLECTOR_H_GUARD__
@@ -8,40 +8,36 @@
 
 .code
 IsCPUIDSupported PROC PUBLIC
-	; 1. Get the RFLAG value and store copy
+	; 1. Get the RFLAGS value and keep a copy in a volatile register
 	pushfq
-	mov rbx, qword ptr [rsp]
+	pop rax
+	mov rcx, rax
 
-	; 2. Check if we can get the bit value
-check_bit:
-	bts qword ptr [rsp], 21
-	jnc skip
-	btr qword ptr [rsp], 21
-
-	; 3. Check if we can change the value
-skip:
+	; 2. Try to flip the ID bit
+	xor rax, 200000h
+	push rax
 	popfq
-	xor eax, eax
-	inc eax
 
+	; 3. Check if the value has changed
 	pushfq
-	test qword ptr [rsp], rbx
-	jne done
-	xor eax, eax
+	pop rax
+	xor eax, ecx
+	shr eax, 21
+	and eax, 1
 
 	; 4. Finally reset back to original value and return
-done:
-	mov qword ptr [rsp], rbx
+	push rcx
 	popfq
 	ret
 IsCPUIDSupported ENDP
 
-CPUIDEX PROC PUBLIC
-	; 1. Save all registers
+CPUIDEX PROC PUBLIC FRAME
+	; 1. Save RBX, non-volatile and overwritten by CPUID. R8 and R9 are left untouched by CPUID.
+	push rbx
+	.pushreg rbx
+	.endprolog
 	mov r10, rcx
 	mov r11, rdx
-	mov r12, r8
-	mov r13, r9
 
 	; 2. Get the branche and leaf to query
 	mov eax, dword ptr [r10]
@@ -51,14 +47,15 @@ CPUIDEX PROC PUBLIC
 	; 3. return the data
 	mov dword ptr[r10], eax
 	mov dword ptr[r11], ecx
-	mov dword ptr[r12], ebx
-	mov dword ptr[r13], edx
+	mov dword ptr[r8], ebx
+	mov dword ptr[r9], edx
 
-	; 4. Return success
+	; 4. Restore RBX and return success
+	pop rbx
 	xor eax, eax
 	inc eax
 	ret
 CPUIDEX ENDP
 
 ;; End of file.
-end 
\ No newline at end of file
+end 
\ No newline at end of file
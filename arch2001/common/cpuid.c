@@ -0,0 +1,174 @@
+/// @file    cpuid.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "cpuid.h"
+#include "intrinsics.h"
+#include "thread.h"
+
+/// <summary>
+/// Cached copy of the decoded CPUID leaves.
+/// </summary>
+static CPUID_INFORMATION g_CpuidInformation = { 0x00 };
+static volatile BOOL g_CpuidInitialised = FALSE;
+
+#if !defined(_WIN32)
+/// On Windows both routines are provided by cpuid.asm.
+_Use_decl_annotations_
+BYTE STDMETHODCALLTYPE IsCPUIDSupported() {
+	// The ID flag in RFLAGS is always writable in long mode.
+	return TRUE;
+}
+
+_Use_decl_annotations_
+UINT STDMETHODCALLTYPE CPUIDEX(
+	_Inout_ PUINT pEAX,
+	_Inout_ PUINT pECX,
+	_Inout_ PUINT pEBX,
+	_Inout_ PUINT pEDX
+) {
+	UINT Registers[4] = { 0x00 };
+	_cpuid_query(*pEAX, *pECX, Registers);
+	*pEAX = Registers[0];
+	*pEBX = Registers[1];
+	*pECX = Registers[2];
+	*pEDX = Registers[3];
+	return TRUE;
+}
+#endif // !_WIN32
+
+_Use_decl_annotations_
+BOOL CpuidQuery(
+	_In_  UINT  uiLeaf,
+	_In_  UINT  uiSubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+) {
+	if (pRegisters == NULL)
+		return FALSE;
+	_cpuid_query(uiLeaf, uiSubLeaf, pRegisters);
+	return TRUE;
+}
+
+const CPUID_INFORMATION* CpuidGetInformation() {
+	if (g_CpuidInitialised)
+		return &g_CpuidInformation;
+
+	// 1. Check if CPUID is supported. Concurrent first calls write the same values.
+	CPUID_INFORMATION Information = { 0x00 };
+	UINT Registers[4] = { 0x00 };
+	Information.Supported = IsCPUIDSupported() && CpuidQuery(CPUID_LEAF_VENDOR, 0x00, Registers);
+	if (!Information.Supported)
+		goto done;
+
+	// 2. Get the microprocessor vendor and the highest basic leaf
+	Information.MaximumLeaf = Registers[0];
+	RtlCopyMemory(&Information.Vendor[0], &Registers[1], sizeof(UINT));
+	RtlCopyMemory(&Information.Vendor[4], &Registers[3], sizeof(UINT));
+	RtlCopyMemory(&Information.Vendor[8], &Registers[2], sizeof(UINT));
+
+	// 3. Get the basic feature identifiers
+	if (Information.MaximumLeaf >= CPUID_LEAF_BASIC_INFORMATION
+		&& CpuidQuery(CPUID_LEAF_BASIC_INFORMATION, 0x00, Registers)) {
+		Information.BasicEcx.value = Registers[2];
+		Information.BasicEdx.value = Registers[3];
+	}
+
+	// 4. Get the structured extended feature flags
+	if (Information.MaximumLeaf >= CPUID_LEAF_EXTENDED_FEATURES
+		&& CpuidQuery(CPUID_LEAF_EXTENDED_FEATURES, 0x00, Registers)) {
+		Information.ExtendedEbx.value = Registers[1];
+		Information.ExtendedEcx.value = Registers[2];
+		Information.ExtendedEdx.value = Registers[3];
+	}
+
+	// 5. Get the extended processor information
+	if (CpuidQuery(CPUID_LEAF_EXTENDED_MAXIMUM, 0x00, Registers))
+		Information.MaximumExtendedLeaf = Registers[0];
+	if (Information.MaximumExtendedLeaf >= CPUID_LEAF_EXTENDED_INFORMATION
+		&& CpuidQuery(CPUID_LEAF_EXTENDED_INFORMATION, 0x00, Registers)) {
+		Information.ExtendedInfoEcx.value = Registers[2];
+		Information.ExtendedInfoEdx.value = Registers[3];
+	}
+
+done:
+	g_CpuidInformation = Information;
+	g_CpuidInitialised = TRUE;
+	return &g_CpuidInformation;
+}
+
+/// <summary>
+/// Execute CPUID on a given processor.
+/// </summary>
+static BOOL CpuidLiveQuery(
+	_In_  PCPUID_BACKEND Backend,
+	_In_  UINT32         Cpu,
+	_In_  UINT           Leaf,
+	_In_  UINT           SubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+) {
+	(VOID)Backend;
+	if (Cpu == CPUID_CURRENT_CPU)
+		return CpuidQuery(Leaf, SubLeaf, pRegisters);
+
+	// 1. Move to the requested processor
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (!ThreadPin(Cpu, &Previous))
+		return FALSE;
+
+	// 2. Execute the instruction and move back
+	BOOL bSuccess = CpuidQuery(Leaf, SubLeaf, pRegisters);
+	ThreadRestore(&Previous);
+	return bSuccess;
+}
+
+static VOID CpuidLiveClose(
+	_In_ PCPUID_BACKEND Backend
+) {
+	(VOID)Backend;
+}
+
+_Use_decl_annotations_
+BOOL CpuidOpen(
+	_Out_ PCPUID_BACKEND pBackend
+) {
+	if (pBackend == NULL)
+		return FALSE;
+	RtlZeroMemory(pBackend, sizeof(CPUID_BACKEND));
+	if (!IsCPUIDSupported())
+		return FALSE;
+
+	pBackend->Name = "cpuid";
+	pBackend->CpuCount = ThreadGetCpuCount();
+	pBackend->Query = CpuidLiveQuery;
+	pBackend->Close = CpuidLiveClose;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL CpuidBackendQuery(
+	_In_  PCPUID_BACKEND pBackend,
+	_In_  UINT32         uiCpu,
+	_In_  UINT           uiLeaf,
+	_In_  UINT           uiSubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+) {
+	if (pBackend == NULL || pBackend->Query == NULL || pRegisters == NULL)
+		return FALSE;
+	RtlZeroMemory(pRegisters, sizeof(UINT) * 4);
+	if (uiCpu != CPUID_CURRENT_CPU && uiCpu >= pBackend->CpuCount)
+		return FALSE;
+	return pBackend->Query(pBackend, uiCpu, uiLeaf, uiSubLeaf, pRegisters);
+}
+
+_Use_decl_annotations_
+VOID CpuidClose(
+	_In_ PCPUID_BACKEND pBackend
+) {
+	if (pBackend == NULL || pBackend->Close == NULL)
+		return;
+	pBackend->Close(pBackend);
+	RtlZeroMemory(pBackend, sizeof(CPUID_BACKEND));
+}
@@ -0,0 +1,502 @@
+/// @file    cpuid.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __CPUID_H_GUARD__
+#define __CPUID_H_GUARD__
+#include "ost.h"
+
+/// List of CPUID leaves used by the tools
+#define CPUID_LEAF_VENDOR               0x00
+#define CPUID_LEAF_BASIC_INFORMATION    0x01
+#define CPUID_LEAF_CACHE_PARAMETERS     0x04
+#define CPUID_LEAF_MONITOR_MWAIT        0x05
+#define CPUID_LEAF_THERMAL_POWER        0x06 // HWP, APERF/MPERF and EPB, see hwp.h.
+#define CPUID_LEAF_EXTENDED_FEATURES    0x07
+#define CPUID_LEAF_PERF_MONITORING      0x0A
+#define CPUID_LEAF_EXTENDED_TOPOLOGY    0x0B
+#define CPUID_LEAF_RDT_MONITORING       0x0F
+#define CPUID_LEAF_RDT_ALLOCATION       0x10
+#define CPUID_LEAF_TLB_PARAMETERS       0x18
+#define CPUID_LEAF_HYBRID_INFORMATION   0x1A
+#define CPUID_LEAF_HYPERVISOR           0x40000000 // First leaf of the hypervisor ranges, see hypervisor.h.
+#define CPUID_LEAF_EXTENDED_MAXIMUM     0x80000000
+#define CPUID_LEAF_EXTENDED_INFORMATION 0x80000001
+#define CPUID_LEAF_L1_CACHE_TLB         0x80000005 // AMD only.
+#define CPUID_LEAF_L2_CACHE_TLB         0x80000006
+#define CPUID_LEAF_ADVANCED_POWER       0x80000007 // Invariant TSC in EDX[8].
+#define CPUID_LEAF_ADDRESS_SIZES        0x80000008
+#define CPUID_LEAF_TLB_1GB              0x80000019 // AMD only.
+#define CPUID_LEAF_CACHE_TOPOLOGY       0x8000001D // AMD equivalent of CPUID_LEAF_CACHE_PARAMETERS.
+#define CPUID_LEAF_EXTENDED_FEATURES_2  0x80000021 // AMD only.
+
+typedef union _BasicInformationEcx {
+	struct {
+		UINT SSE3 : 1;
+		UINT PCLMULQDQ : 1;
+		UINT DTES64 : 1;
+		UINT MONITOR : 1;
+		UINT DSCPL : 1;
+		UINT VMX : 1;
+		UINT SMX : 1;
+		UINT EIST : 1;
+		UINT TM2 : 1;
+		UINT SSSE3 : 1;
+		UINT CNXTID : 1;
+		UINT SDBG : 1;
+		UINT FMA : 1;
+		UINT CMPXCHG16B : 1;
+		UINT xTPR : 1;
+		UINT PDCM : 1;
+		UINT Reserved1 : 1;
+		UINT PCID : 1;
+		UINT DCA : 1;
+		UINT SSE41 : 1;
+		UINT SSE42 : 1;
+		UINT x2APIC : 1;
+		UINT MOVBE : 1;
+		UINT POPCNT : 1;
+		UINT TSCDeadline : 1;
+		UINT AES : 1;
+		UINT XSAVE : 1;
+		UINT OSXSAVE : 1;
+		UINT AVX : 1;
+		UINT F16C : 1;
+		UINT RDRAND : 1;
+		UINT Hypervisor : 1; // Set by hypervisors, always clear on bare metal.
+	} elem;
+	UINT value;
+} BasicInformationEcx, * PBasicInformationEcx;
+
+typedef union _BasicInformationEdx {
+	struct {
+		UINT FPU : 1;
+		UINT VME : 1;
+		UINT DE : 1;
+		UINT PSE : 1;
+		UINT TSC : 1;
+		UINT MSR : 1;
+		UINT PAE : 1;
+		UINT MCE : 1;
+		UINT CMPXCHG8B : 1;
+		UINT APIC : 1;
+		UINT Reserve9 : 1;
+		UINT SysEnterSysExit : 1;
+		UINT MTRR : 1;
+		UINT PGE : 1;
+		UINT MCA : 1;
+		UINT CMOV : 1;
+		UINT PAT : 1;
+		UINT PSE36 : 1;
+		UINT Reserve8 : 1;
+		UINT CLFSH : 1;
+		UINT Reserve7 : 1;
+		UINT Reserve6 : 1;
+		UINT Reserve5 : 1;
+		UINT MMX : 1;
+		UINT FXSR : 1;
+		UINT SSE : 1;
+		UINT SSE2 : 1;
+		UINT SS : 1;
+		UINT HTT : 1;
+		UINT TM : 1;
+		UINT Reserve2 : 1;
+		UINT PBE : 1;
+	} elem;
+	UINT value;
+} BasicInformationEdx, * PBasicInformationEdx;
+
+typedef union _StructuredExtendedFeatureEbx {
+	struct {
+		UINT FSGSBASE : 1;
+		UINT IA32_TSC_ADJUST : 1;
+		UINT SGX : 1;
+		UINT BMI1 : 1;
+		UINT HLE : 1;
+		UINT AVX2 : 1;
+		UINT FDP_EXCPTN_ONLY : 1;
+		UINT SMEP : 1;
+		UINT BMI2 : 1;
+		UINT EnhancedREP : 1;
+		UINT INVPCID : 1;
+		UINT RTM : 1;
+		UINT RDTM : 1;
+		UINT DeprecatesFPUCS : 1;
+		UINT MPX : 1;
+		UINT RDTA : 1;
+		UINT AVX512F : 1;
+		UINT AVX512DQ : 1;
+		UINT RDSEED : 1;
+		UINT ADX : 1;
+		UINT SMAP : 1;
+		UINT AVX512_IFMA : 1;
+		UINT Reserved0 : 1;
+		UINT CLFLUSHOPT : 1;
+		UINT CLWB : 1;
+		UINT IntelProcessorTrace : 1;
+		UINT AVX512PF : 1;
+		UINT AVX512ER : 1;
+		UINT AVX512CD : 1;
+		UINT SHA : 1;
+		UINT AVX512BW : 1;
+		UINT AVX512VL : 1;
+	} elem;
+	UINT value;
+} StructuredExtendedFeatureEbx, * PStructuredExtendedFeatureEbx;
+
+
+typedef union _StructuredExtendedFeatureEcx {
+	struct {
+		UINT PREFETCHWT1 : 1;
+		UINT AVX512_VBMI : 1;
+		UINT UMIP : 1;
+		UINT PKU : 1;
+		UINT OSPKE : 1;
+		UINT WAITPKG : 1;
+		UINT AVX512_VBMI2 : 1;
+		UINT CET_SS : 1;
+		UINT GFNI : 1;
+		UINT VAES : 1;
+		UINT VPCLMULQDQ : 1;
+		UINT AVX512_VNNI : 1;
+		UINT AVX512_BITALG : 1;
+		UINT TME_EN : 1;
+		UINT AVX512_VPOPCNTDQ : 1;
+		UINT Reserved2 : 1;
+		UINT LA57 : 1;
+		UINT MAWAU : 5;
+		UINT RDPID : 1;
+		UINT KL : 1;
+		UINT BUS_LOCK_DETECT : 1;
+		UINT CLDEMOTE : 1;
+		UINT Reserved1 : 1;
+		UINT MOVDIRI : 1;
+		UINT MOVDIR64B : 1;
+		UINT ENQCMD : 1;
+		UINT SGX_LC : 1;
+		UINT PKS : 1;
+	} elem;
+	UINT value;
+} StructuredExtendedFeatureEcx, * PStructuredExtendedFeatureEcx;
+
+typedef union _StructuredExtendedFeatureEdx {
+	struct {
+		UINT Reserved5 : 2;
+		UINT AVX512_4VNNIW : 1;
+		UINT AVX512_4FMAPS : 1;
+		UINT FSRM : 1;
+		UINT UINTR : 1;
+		UINT Reserved4 : 2;
+		UINT AVX512_VP2INTERSECT : 1;
+		UINT SRBDS_CTRL : 1;
+		UINT MD_CLEAR : 1;
+		UINT RTM_ALWAYS_ABORT : 1;
+		UINT Reserved3 : 1;
+		UINT RTM_FORCE_ABORT : 1;
+		UINT SERIALIZE : 1;
+		UINT Hybrid : 1;
+		UINT TSXLDTRK : 1;
+		UINT Reserved2 : 1;
+		UINT PCONFIG : 1;
+		UINT ArchitecturalLBR : 1;
+		UINT CET_IBT : 1;
+		UINT Reserved1 : 1;
+		UINT AMX_BF16 : 1;
+		UINT AVX512_FP16 : 1;
+		UINT AMX_TILE : 1;
+		UINT AMX_INT8 : 1;
+		UINT IBRS_IBPB : 1;
+		UINT STIBP : 1;
+		UINT L1D_FLUSH : 1;
+		UINT IA32_ARCH_CAPABILITIES : 1;
+		UINT IA32_CORE_CAPABILITIES : 1;
+		UINT SSBD : 1;
+	} elem;
+	UINT value;
+} StructuredExtendedFeatureEdx, * PStructuredExtendedFeatureEdx;
+
+typedef union _CacheParametersEax {
+	struct {
+		UINT CacheType : 5;
+		UINT CacheLevel : 3;
+		UINT SelfInitializing : 1;
+		UINT FullyAssociative : 1;
+		UINT Reserved : 4;
+		UINT MaximumSharing : 12;
+		UINT MaximumCores : 6;
+	} elem;
+	UINT value;
+} CacheParametersEax, * PCacheParametersEax;
+
+typedef union _ExtendedTopologyEax {
+	struct {
+		UINT Shift : 5;
+		UINT Reserved : 27;
+	} elem;
+	UINT value;
+} ExtendedTopologyEax, * PExtendedTopologyEax;
+
+typedef union _ExtendedTopologyEcx {
+	struct {
+		UINT Level : 8;
+		UINT LevelType : 8;
+		UINT Reserved : 16;
+	} elem;
+	UINT value;
+} ExtendedTopologyEcx, * PExtendedTopologyEcx;
+
+typedef union _PerformanceMonitoringEax {
+	struct {
+		UINT Version : 8;
+		UINT Counters : 8;
+		UINT CounterWidth : 8;
+		UINT EventsLength : 8;
+	} elem;
+	UINT value;
+} PerformanceMonitoringEax, * PPerformanceMonitoringEax;
+
+/// A bit set means the architectural event is NOT available
+typedef union _PerformanceMonitoringEbx {
+	struct {
+		UINT CoreCycles : 1;
+		UINT InstructionsRetired : 1;
+		UINT ReferenceCycles : 1;
+		UINT LlcReferences : 1;
+		UINT LlcMisses : 1;
+		UINT BranchesRetired : 1;
+		UINT BranchMissesRetired : 1;
+		UINT TopdownSlots : 1;
+		UINT Reserved : 24;
+	} elem;
+	UINT value;
+} PerformanceMonitoringEbx, * PPerformanceMonitoringEbx;
+
+typedef union _PerformanceMonitoringEdx {
+	struct {
+		UINT FixedCounters : 5;
+		UINT FixedCounterWidth : 8;
+		UINT Reserved2 : 2;
+		UINT AnyThreadDeprecation : 1;
+		UINT Reserved1 : 16;
+	} elem;
+	UINT value;
+} PerformanceMonitoringEdx, * PPerformanceMonitoringEdx;
+
+typedef union _TlbParametersEbx {
+	struct {
+		UINT Page4K : 1;
+		UINT Page2M : 1;
+		UINT Page4M : 1;
+		UINT Page1G : 1;
+		UINT Reserved1 : 4;
+		UINT Partitioning : 3;
+		UINT Reserved2 : 5;
+		UINT Ways : 16;
+	} elem;
+	UINT value;
+} TlbParametersEbx, * PTlbParametersEbx;
+
+typedef union _TlbParametersEdx {
+	struct {
+		UINT Type : 5;
+		UINT Level : 3;
+		UINT FullyAssociative : 1;
+		UINT Reserved1 : 5;
+		UINT MaximumSharing : 12;
+		UINT Reserved2 : 6;
+	} elem;
+	UINT value;
+} TlbParametersEdx, * PTlbParametersEdx;
+
+typedef union _HybridInformationEax {
+	struct {
+		UINT NativeModelId : 24;
+		UINT CoreType : 8;
+	} elem;
+	UINT value;
+} HybridInformationEax, * PHybridInformationEax;
+
+typedef union _ExtendedInformationEcx {
+	struct {
+		UINT LAHF_SAHF : 1;
+		UINT Reserved4 : 4;
+		UINT LZCNT : 1;
+		UINT Reserved3 : 2;
+		UINT PREFETCHW : 1;
+		UINT Reserved2 : 20;
+		UINT MONITORX : 1; // AMD only.
+		UINT Reserved1 : 2;
+	} elem;
+	UINT value;
+} ExtendedInformationEcx, * PExtendedInformationEcx;
+
+typedef union _ExtendedInformationEdx {
+	struct {
+		UINT Reserved5 : 11;
+		UINT SYSCALL : 1;
+		UINT Reserved4 : 8;
+		UINT NX : 1;
+		UINT Reserved3 : 5;
+		UINT Page1GB : 1;
+		UINT RDTSCP : 1;
+		UINT Reserved2 : 1;
+		UINT LM : 1;
+		UINT Reserved1 : 2;
+	} elem;
+	UINT value;
+} ExtendedInformationEdx, * PExtendedInformationEdx;
+
+/// <summary>
+/// Decoded CPUID leaves of the current microprocessor. Queried once and cached for the lifetime of the process.
+/// </summary>
+typedef struct _CPUID_INFORMATION {
+	BOOL                         Supported;
+	CHAR                         Vendor[13];
+	UINT                         MaximumLeaf;
+	BasicInformationEcx          BasicEcx;
+	BasicInformationEdx          BasicEdx;
+	StructuredExtendedFeatureEbx ExtendedEbx;
+	StructuredExtendedFeatureEcx ExtendedEcx;
+	StructuredExtendedFeatureEdx ExtendedEdx;
+	UINT                         MaximumExtendedLeaf;
+	ExtendedInformationEcx       ExtendedInfoEcx;
+	ExtendedInformationEdx       ExtendedInfoEdx;
+} CPUID_INFORMATION, * PCPUID_INFORMATION;
+
+/// Processor index meaning "the processor the caller is running on"
+#define CPUID_CURRENT_CPU 0xFFFFFFFF
+
+typedef struct _CPUID_BACKEND CPUID_BACKEND, * PCPUID_BACKEND;
+
+/// <summary>
+/// Source of CPUID leaves. The default backend executes the instruction on the requested processor,
+/// the replay backend answers from a dump captured on another machine.
+/// </summary>
+struct _CPUID_BACKEND {
+	/// <summary>
+	/// Name of the backend, for display purpose.
+	/// </summary>
+	LPCSTR Name;
+	/// <summary>
+	/// Number of logical processors described by the backend.
+	/// </summary>
+	UINT32 CpuCount;
+	/// <summary>
+	/// Query a leaf on a given processor.
+	/// </summary>
+	BOOL(*Query)(
+		_In_  PCPUID_BACKEND Backend,
+		_In_  UINT32         Cpu,
+		_In_  UINT           Leaf,
+		_In_  UINT           SubLeaf,
+		_Out_writes_(4) PUINT pRegisters
+	);
+	/// <summary>
+	/// Release the resources of the backend.
+	/// </summary>
+	VOID(*Close)(
+		_In_ PCPUID_BACKEND Backend
+	);
+	/// <summary>
+	/// Backend specific data.
+	/// </summary>
+	PVOID Context;
+};
+
+/// <summary>
+/// Check whether CPUID instruction is supported.
+/// </summary>
+/// <returns>True if CPUID instruction is supported.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+EXTERN_C BYTE STDMETHODCALLTYPE IsCPUIDSupported();
+
+/// <summary>
+/// Execute the CPUID instruction to get information about the system.
+/// </summary>
+/// <param name="pEAX">Pointer to the EAX register.</param>
+/// <param name="pECX">Pointer to the ECX register.</param>
+/// <param name="pEBX">Pointer to the EBX register.</param>
+/// <param name="pEDX">Pointer to the EDX register.</param>
+/// <returns>Whether the CPUID instruction has been executed successfully.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+EXTERN_C UINT STDMETHODCALLTYPE CPUIDEX(
+	_Inout_ PUINT pEAX,
+	_Inout_ PUINT pECX,
+	_Inout_ PUINT pEBX,
+	_Inout_ PUINT pEDX
+);
+
+/// <summary>
+/// Execute the CPUID instruction for a given leaf and sub-leaf.
+/// </summary>
+/// <param name="uiLeaf">Leaf to query (EAX).</param>
+/// <param name="uiSubLeaf">Sub-leaf to query (ECX).</param>
+/// <param name="pRegisters">Array receiving EAX, EBX, ECX and EDX in that order.</param>
+/// <returns>Whether the CPUID instruction has been executed successfully.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CpuidQuery(
+	_In_  UINT  uiLeaf,
+	_In_  UINT  uiSubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+);
+
+/// <summary>
+/// Get the decoded CPUID leaves of the current microprocessor. The first call executes CPUID and following
+/// calls return the cached copy.
+/// </summary>
+/// <returns>Pointer to the cached information. Never NULL.</returns>
+const CPUID_INFORMATION* CpuidGetInformation();
+
+/// <summary>
+/// Open the backend executing the CPUID instruction on the processors of this machine.
+/// </summary>
+/// <param name="pBackend">Pointer to the backend to initialise.</param>
+/// <returns>Whether the backend can be used.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CpuidOpen(
+	_Out_ PCPUID_BACKEND pBackend
+);
+
+/// <summary>
+/// Open a backend replaying a raw dump in the format of "cpuid -r": a "CPU N:" line per processor followed
+/// by "0xLEAF 0xSUBLEAF: eax=0x.. ebx=0x.. ecx=0x.. edx=0x.." lines.
+/// </summary>
+/// <param name="szPath">Path of the dump.</param>
+/// <param name="pBackend">Pointer to the backend to initialise.</param>
+/// <returns>Whether the dump has been loaded.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CpuidReplayOpen(
+	_In_  LPCSTR         szPath,
+	_Out_ PCPUID_BACKEND pBackend
+);
+
+/// <summary>
+/// Query a leaf via a backend.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened backend.</param>
+/// <param name="uiCpu">Index of the processor or CPUID_CURRENT_CPU.</param>
+/// <param name="uiLeaf">Leaf to query (EAX).</param>
+/// <param name="uiSubLeaf">Sub-leaf to query (ECX).</param>
+/// <param name="pRegisters">Array receiving EAX, EBX, ECX and EDX in that order.</param>
+/// <returns>Whether the leaf has been queried.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CpuidBackendQuery(
+	_In_  PCPUID_BACKEND pBackend,
+	_In_  UINT32         uiCpu,
+	_In_  UINT           uiLeaf,
+	_In_  UINT           uiSubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+);
+
+/// <summary>
+/// Close a backend.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened backend.</param>
+VOID CpuidClose(
+	_In_ PCPUID_BACKEND pBackend
+);
+
+#endif // !__CPUID_H_GUARD__
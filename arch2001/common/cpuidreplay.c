@@ -0,0 +1,149 @@
+/// @file    cpuidreplay.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid.h"
+#include "thread.h"
+
+/// <summary>
+/// Leaf of a processor read from the dump.
+/// </summary>
+typedef struct _CPUID_REPLAY_ENTRY {
+	UINT32 Cpu;
+	UINT   Leaf;
+	UINT   SubLeaf;
+	UINT   Registers[4];
+} CPUID_REPLAY_ENTRY, * PCPUID_REPLAY_ENTRY;
+
+/// <summary>
+/// Content of the dump.
+/// </summary>
+typedef struct _CPUID_REPLAY {
+	PCPUID_REPLAY_ENTRY Entries;
+	UINT32              Count;
+	UINT32              Capacity;
+} CPUID_REPLAY, * PCPUID_REPLAY;
+
+/// <summary>
+/// Answer from the dump. Leaves without sub-leaves are dumped with sub-leaf 0 only, the same way the
+/// processor ignores ECX for them.
+/// </summary>
+static BOOL CpuidReplayQuery(
+	_In_  PCPUID_BACKEND Backend,
+	_In_  UINT32         Cpu,
+	_In_  UINT           Leaf,
+	_In_  UINT           SubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+) {
+	PCPUID_REPLAY Replay = (PCPUID_REPLAY)Backend->Context;
+	if (Cpu == CPUID_CURRENT_CPU)
+		Cpu = 0x00;
+
+	PCPUID_REPLAY_ENTRY Fallback = NULL;
+	for (UINT32 Index = 0x00; Index < Replay->Count; Index++) {
+		PCPUID_REPLAY_ENTRY Entry = &Replay->Entries[Index];
+		if (Entry->Cpu != Cpu || Entry->Leaf != Leaf)
+			continue;
+		if (Entry->SubLeaf == SubLeaf) {
+			Fallback = Entry;
+			break;
+		}
+		if (Entry->SubLeaf == 0x00)
+			Fallback = Entry;
+	}
+	if (Fallback == NULL)
+		return FALSE;
+	RtlCopyMemory(pRegisters, Fallback->Registers, sizeof(Fallback->Registers));
+	return TRUE;
+}
+
+static VOID CpuidReplayClose(
+	_In_ PCPUID_BACKEND Backend
+) {
+	PCPUID_REPLAY Replay = (PCPUID_REPLAY)Backend->Context;
+	if (Replay == NULL)
+		return;
+	free(Replay->Entries);
+	free(Replay);
+}
+
+/// <summary>
+/// Append a leaf to the dump.
+/// </summary>
+static BOOL CpuidReplayAppend(
+	_Inout_ PCPUID_REPLAY       pReplay,
+	_In_    PCPUID_REPLAY_ENTRY pEntry
+) {
+	if (pReplay->Count == pReplay->Capacity) {
+		UINT32 uiCapacity = pReplay->Capacity ? pReplay->Capacity * 2 : 256;
+		PCPUID_REPLAY_ENTRY Entries = (PCPUID_REPLAY_ENTRY)realloc(pReplay->Entries, uiCapacity * sizeof(CPUID_REPLAY_ENTRY));
+		if (Entries == NULL)
+			return FALSE;
+		pReplay->Entries = Entries;
+		pReplay->Capacity = uiCapacity;
+	}
+	pReplay->Entries[pReplay->Count++] = *pEntry;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL CpuidReplayOpen(
+	_In_  LPCSTR         szPath,
+	_Out_ PCPUID_BACKEND pBackend
+) {
+	if (szPath == NULL || pBackend == NULL)
+		return FALSE;
+	RtlZeroMemory(pBackend, sizeof(CPUID_BACKEND));
+
+	FILE* pFile = fopen(szPath, "r");
+	if (pFile == NULL)
+		return FALSE;
+	PCPUID_REPLAY Replay = (PCPUID_REPLAY)calloc(0x01, sizeof(CPUID_REPLAY));
+	if (Replay == NULL) {
+		fclose(pFile);
+		return FALSE;
+	}
+
+	// 1. Parse the dump. A dump without "CPU N:" lines describes processor 0.
+	CHAR szLine[256] = { 0x00 };
+	UINT32 uiCpu = 0x00;
+	UINT32 uiCpuCount = 0x00;
+	BOOL bSuccess = TRUE;
+	while (bSuccess && fgets(szLine, sizeof(szLine), pFile) != NULL) {
+		CPUID_REPLAY_ENTRY Entry = { 0x00 };
+		if (sscanf(szLine, " CPU %u:", &uiCpu) == 0x01)
+			continue;
+		if (sscanf(szLine, " %x %x: eax=%x ebx=%x ecx=%x edx=%x", &Entry.Leaf, &Entry.SubLeaf,
+			&Entry.Registers[0], &Entry.Registers[1], &Entry.Registers[2], &Entry.Registers[3]) != 0x06)
+			continue;
+
+		Entry.Cpu = uiCpu;
+		if (uiCpu >= uiCpuCount)
+			uiCpuCount = uiCpu + 1;
+		bSuccess = CpuidReplayAppend(Replay, &Entry);
+	}
+	fclose(pFile);
+
+	// 2. An empty dump is most likely in the wrong format
+	if (!bSuccess || Replay->Count == 0x00) {
+		free(Replay->Entries);
+		free(Replay);
+		return FALSE;
+	}
+
+	pBackend->Name = "replay";
+	pBackend->CpuCount = uiCpuCount;
+	pBackend->Query = CpuidReplayQuery;
+	pBackend->Close = CpuidReplayClose;
+	pBackend->Context = Replay;
+	return TRUE;
+}
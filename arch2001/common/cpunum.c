@@ -0,0 +1,206 @@
+/// @file    cpunum.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <stdlib.h>
+#include "cpunum.h"
+#include "cpuid.h"
+#include "thread.h"
+
+#if !defined(_WIN32)
+/// Exported by glibc 2.35 and later when it registers a restartable sequence area for each thread.
+extern const ptrdiff_t __rseq_offset __attribute__((weak));
+extern const unsigned int __rseq_size __attribute__((weak));
+#endif
+
+CPUNUM_SOURCE   g_CpuNumSource = CpuNumSourceNone;
+CPUNUM_ENCODING g_CpuNumEncoding = { 0x00 };
+INT64           g_CpuNumRseqOffset = 0x00;
+
+/// <summary>
+/// NUMA node of each processor, as reported by the OS.
+/// </summary>
+static PUINT32 g_CpuNumNodes = NULL;
+static UINT32  g_CpuNumCount = 0x00;
+
+/// <summary>
+/// Candidate encodings of IA32_TSC_AUX, tested in order.
+/// </summary>
+static const CPUNUM_ENCODING g_Encodings[] = {
+	{ CPUNUM_LINUX_CPU_MASK, CPUNUM_LINUX_NODE_SHIFT, 0x000FFFFF },
+	{ 0xFFFFFFFF, 0x00, 0x00 }
+};
+
+/// <summary>
+/// Ask the OS for the current processor and node.
+/// </summary>
+static VOID CpuNumGetFromOs(
+	_Out_ PCPUNUM pCpuNum
+) {
+#if defined(_WIN32)
+	PROCESSOR_NUMBER Number = { 0x00 };
+	USHORT usNode = 0x00;
+	GetCurrentProcessorNumberEx(&Number);
+	GetNumaProcessorNodeEx(&Number, &usNode);
+
+	pCpuNum->Cpu = Number.Number;
+	for (WORD wGroup = 0x00; wGroup < Number.Group; wGroup++)
+		pCpuNum->Cpu += GetActiveProcessorCount(wGroup);
+	pCpuNum->Node = usNode == 0xFFFF ? 0x00 : usNode;
+#else
+	unsigned int uiCpu = 0x00;
+	unsigned int uiNode = 0x00;
+	syscall(SYS_getcpu, &uiCpu, &uiNode, NULL);
+	pCpuNum->Cpu = uiCpu;
+	pCpuNum->Node = uiNode;
+#endif
+}
+
+/// <summary>
+/// Check whether an encoding decodes the IA32_TSC_AUX of every processor into what the OS reports.
+/// </summary>
+static BOOL CpuNumCheckEncoding(
+	_In_ const CPUNUM_ENCODING* pEncoding,
+	_In_ PUINT32                pTscAux,
+	_In_ PCPUNUM                pExpected,
+	_In_ UINT32                 uiCount
+) {
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		if (pExpected[Index].Cpu == 0xFFFFFFFF)
+			continue;
+		if ((pTscAux[Index] & pEncoding->CpuMask) != pExpected[Index].Cpu)
+			return FALSE;
+		if (pEncoding->NodeShift != 0x00
+			&& ((pTscAux[Index] >> pEncoding->NodeShift) & pEncoding->NodeMask) != pExpected[Index].Node)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+CPUNUM_SOURCE CpuNumInitialise() {
+	if (g_CpuNumSource != CpuNumSourceNone)
+		return g_CpuNumSource;
+
+	// 1. Get the instructions supported by the processor
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	BOOL bRdpid = Cpuid->ExtendedEcx.elem.RDPID;
+	BOOL bRdtscp = Cpuid->ExtendedInfoEdx.elem.RDTSCP;
+
+	// 2. Visit every processor to get what the OS and IA32_TSC_AUX say
+	UINT32 uiCount = ThreadGetCpuCount();
+	PUINT32 pNodes = (PUINT32)calloc(uiCount, sizeof(UINT32));
+	PCPUNUM pExpected = (PCPUNUM)calloc(uiCount, sizeof(CPUNUM));
+	PUINT32 pTscAux = (PUINT32)calloc(uiCount, sizeof(UINT32));
+	if (pNodes == NULL || pExpected == NULL || pTscAux == NULL) {
+		free(pNodes);
+		free(pExpected);
+		free(pTscAux);
+		g_CpuNumSource = CpuNumSourceOs;
+		return g_CpuNumSource;
+	}
+
+	THREAD_AFFINITY Previous = { 0x00 };
+	BOOL bSaved = FALSE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		if (!ThreadPin(Index, bSaved ? NULL : &Previous)) {
+			pExpected[Index].Cpu = 0xFFFFFFFF;
+			continue;
+		}
+		bSaved = TRUE;
+
+		CpuNumGetFromOs(&pExpected[Index]);
+		pNodes[Index] = pExpected[Index].Node;
+		pTscAux[Index] = bRdpid ? _rdpid() : bRdtscp ? _rdtscp_aux() : 0x00;
+	}
+	if (bSaved)
+		ThreadRestore(&Previous);
+
+	// 3. Select the first encoding matching on every processor
+	CPUNUM_SOURCE Source = CpuNumSourceOs;
+	if (bRdpid || bRdtscp) {
+		for (SIZE_T Index = 0x00; Index < ARRAYSIZE(g_Encodings); Index++) {
+			if (CpuNumCheckEncoding(&g_Encodings[Index], pTscAux, pExpected, uiCount)) {
+				g_CpuNumEncoding = g_Encodings[Index];
+				Source = bRdpid ? CpuNumSourceRdpid : CpuNumSourceRdtscp;
+				break;
+			}
+		}
+	}
+
+#if !defined(_WIN32)
+	// 4. Otherwise use the restartable sequence area if the C library registered one
+	if (Source == CpuNumSourceOs && &__rseq_size != NULL && __rseq_size != 0x00) {
+		g_CpuNumRseqOffset = (INT64)__rseq_offset;
+		CPUNUM Current = { 0x00 };
+		CpuNumGetFromOs(&Current);
+		if (_rseq_cpu_id() == Current.Cpu)
+			Source = CpuNumSourceRseq;
+	}
+#endif
+
+	free(pExpected);
+	free(pTscAux);
+	g_CpuNumNodes = pNodes;
+	g_CpuNumCount = uiCount;
+	g_CpuNumSource = Source;
+	return g_CpuNumSource;
+}
+
+VOID CpuNumUninitialise() {
+	g_CpuNumSource = CpuNumSourceNone;
+	free(g_CpuNumNodes);
+	g_CpuNumNodes = NULL;
+	g_CpuNumCount = 0x00;
+}
+
+_Use_decl_annotations_
+VOID CpuNumDecode(
+	_In_  UINT32  TscAux,
+	_Out_ PCPUNUM pCpuNum
+) {
+	pCpuNum->Cpu = TscAux & g_CpuNumEncoding.CpuMask;
+	if (g_CpuNumEncoding.NodeShift != 0x00)
+		pCpuNum->Node = (TscAux >> g_CpuNumEncoding.NodeShift) & g_CpuNumEncoding.NodeMask;
+	else
+		pCpuNum->Node = pCpuNum->Cpu < g_CpuNumCount ? g_CpuNumNodes[pCpuNum->Cpu] : 0x00;
+}
+
+UINT32 CpuNumCurrentSlow() {
+	if (g_CpuNumSource == CpuNumSourceNone) {
+		CpuNumInitialise();
+		return CpuNumCurrent();
+	}
+
+	CPUNUM CpuNum = { 0x00 };
+	CpuNumGetFromOs(&CpuNum);
+	return CpuNum.Cpu;
+}
+
+_Use_decl_annotations_
+VOID CpuNumCurrentEx(
+	_Out_ PCPUNUM pCpuNum
+) {
+	switch (CpuNumInitialise()) {
+		case CpuNumSourceRdpid:
+			CpuNumDecode(_rdpid(), pCpuNum);
+			break;
+		case CpuNumSourceRdtscp:
+			CpuNumDecode(_rdtscp_aux(), pCpuNum);
+			break;
+		case CpuNumSourceRseq:
+			pCpuNum->Cpu = CpuNumCurrent();
+			pCpuNum->Node = pCpuNum->Cpu < g_CpuNumCount ? g_CpuNumNodes[pCpuNum->Cpu] : 0x00;
+			break;
+		default:
+			CpuNumGetFromOs(pCpuNum);
+			break;
+	}
+}
@@ -0,0 +1,118 @@
+/// @file    cpunum.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __CPUNUM_H_GUARD__
+#define __CPUNUM_H_GUARD__
+#include "ost.h"
+#include "intrinsics.h"
+
+/// <summary>
+/// How the index of the current processor is obtained.
+/// </summary>
+typedef enum _CPUNUM_SOURCE {
+	CpuNumSourceNone   = 0x00, // Not initialised yet.
+	CpuNumSourceRdpid  = 0x01, // RDPID returns IA32_TSC_AUX.
+	CpuNumSourceRdtscp = 0x02, // RDTSCP returns IA32_TSC_AUX in ECX, along with the TSC.
+	CpuNumSourceRseq   = 0x03, // Linux restartable sequence area registered by the C library.
+	CpuNumSourceOs     = 0x04  // getcpu on Linux, GetCurrentProcessorNumberEx on Windows.
+} CPUNUM_SOURCE;
+
+/// <summary>
+/// Processor and NUMA node the caller is running on.
+/// </summary>
+typedef struct _CPUNUM {
+	UINT32 Cpu;
+	UINT32 Node;
+} CPUNUM, * PCPUNUM;
+
+/// <summary>
+/// How the OS stores the processor and node in IA32_TSC_AUX. Linux stores (node << 12) | cpu.
+/// </summary>
+typedef struct _CPUNUM_ENCODING {
+	UINT32 CpuMask;
+	UINT32 NodeShift;
+	UINT32 NodeMask;
+} CPUNUM_ENCODING, * PCPUNUM_ENCODING;
+
+/// Linux encoding of IA32_TSC_AUX
+#define CPUNUM_LINUX_CPU_MASK   0x00000FFF
+#define CPUNUM_LINUX_NODE_SHIFT 12
+
+/// <summary>
+/// Source and encoding selected by CpuNumInitialise.
+/// </summary>
+EXTERN_C CPUNUM_SOURCE   g_CpuNumSource;
+EXTERN_C CPUNUM_ENCODING g_CpuNumEncoding;
+EXTERN_C INT64           g_CpuNumRseqOffset;
+
+/// <summary>
+/// Select the fastest way to get the current processor. IA32_TSC_AUX is only trusted once its value has
+/// been checked against the OS on every processor, which also builds the processor to node table.
+/// </summary>
+/// <returns>The source selected.</returns>
+CPUNUM_SOURCE CpuNumInitialise();
+
+/// <summary>
+/// Release the processor to node table.
+/// </summary>
+VOID CpuNumUninitialise();
+
+/// <summary>
+/// Decode a IA32_TSC_AUX value with the encoding selected.
+/// </summary>
+/// <param name="TscAux">Value returned by RDPID or RDTSCP.</param>
+/// <param name="pCpuNum">Pointer to the structure receiving the processor and node.</param>
+VOID CpuNumDecode(
+	_In_  UINT32  TscAux,
+	_Out_ PCPUNUM pCpuNum
+);
+
+/// <summary>
+/// Get the current processor when no instruction can be used, initialising the module if needed.
+/// </summary>
+/// <returns>Index of the processor.</returns>
+UINT32 CpuNumCurrentSlow();
+
+/// <summary>
+/// Get both the current processor and its NUMA node.
+/// </summary>
+/// <param name="pCpuNum">Pointer to the structure receiving the processor and node.</param>
+VOID CpuNumCurrentEx(
+	_Out_ PCPUNUM pCpuNum
+);
+
+#if !defined(_WIN32)
+FORCEINLINE UINT32 _rseq_cpu_id() {
+	// struct rseq starts with cpu_id_start followed by cpu_id, at __rseq_offset from the thread pointer.
+	PUINT8 ThreadPointer;
+	__asm__ ("mov %%fs:0, %0" : "=r" (ThreadPointer));
+	return *(volatile UINT32*)(ThreadPointer + g_CpuNumRseqOffset + sizeof(UINT32));
+}
+#endif
+
+/// <summary>
+/// Get the index of the processor the caller is running on, without entering the kernel when possible.
+/// The thread may be migrated as soon as the value is returned, so it must only be used as a hint,
+/// e.g. to select the per-processor shard to update.
+/// </summary>
+/// <returns>Index of the processor.</returns>
+FORCEINLINE UINT32 CpuNumCurrent() {
+	switch (g_CpuNumSource) {
+		case CpuNumSourceRdpid:
+			return _rdpid() & g_CpuNumEncoding.CpuMask;
+		case CpuNumSourceRdtscp:
+			return _rdtscp_aux() & g_CpuNumEncoding.CpuMask;
+#if !defined(_WIN32)
+		case CpuNumSourceRseq:
+			return _rseq_cpu_id();
+#endif
+		default:
+			return CpuNumCurrentSlow();
+	}
+}
+
+#endif // !__CPUNUM_H_GUARD__
@@ -0,0 +1,215 @@
+/// @file    cstate.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <math.h>
+#include <stdlib.h>
+#include "cstate.h"
+#include "thread.h"
+
+/// Address and name of every counter, in the order of CSTATE_COUNTER
+static const struct {
+	UINT32 Msr;
+	LPCSTR Name;
+} g_CstateCounters[CstateCounterCount] = {
+	{ MSR_CORE_C3_RESIDENCY, "CC3" },
+	{ MSR_CORE_C6_RESIDENCY, "CC6" },
+	{ MSR_CORE_C7_RESIDENCY, "CC7" },
+	{ MSR_PKG_C2_RESIDENCY,  "PC2" },
+	{ MSR_PKG_C3_RESIDENCY,  "PC3" },
+	{ MSR_PKG_C6_RESIDENCY,  "PC6" },
+	{ MSR_PKG_C7_RESIDENCY,  "PC7" },
+	{ MSR_PKG_C8_RESIDENCY,  "PC8" },
+	{ MSR_PKG_C9_RESIDENCY,  "PC9" },
+	{ MSR_PKG_C10_RESIDENCY, "PC10" }
+};
+
+/// <summary>
+/// Read the counters of a processor in a single batch: the TSC, the core counters, and the package counters
+/// when the processor reads them for its package.
+/// </summary>
+static BOOL CstateRead(
+	_In_  PCSTATE_MONITOR pMonitor,
+	_In_  UINT32          uiIndex,
+	_Out_ PCSTATE_SAMPLE  pSample
+) {
+	UINT32 Msrs[1 + CstateCounterCount] = { IA32_TSC_MSR };
+	UINT64 Values[1 + CstateCounterCount] = { 0x00 };
+	UINT32 Count = 0x01;
+	for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++) {
+		if ((pMonitor->Present & (1U << Counter)) && (Counter < CSTATE_FIRST_PACKAGE || pMonitor->PackageReader[uiIndex]))
+			Msrs[Count++] = g_CstateCounters[Counter].Msr;
+	}
+
+	RtlZeroMemory(pSample, sizeof(CSTATE_SAMPLE));
+	if (!MsrReadBatch(pMonitor->Msr, pMonitor->Cpus[uiIndex], Msrs, Count, Values))
+		return FALSE;
+	pSample->Tsc = Values[0];
+	for (UINT32 Counter = 0x00, Index = 0x01; Counter < CstateCounterCount; Counter++) {
+		if ((pMonitor->Present & (1U << Counter)) && (Counter < CSTATE_FIRST_PACKAGE || pMonitor->PackageReader[uiIndex]))
+			pSample->Values[Counter] = Values[Index++];
+	}
+	pSample->bValid = TRUE;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL CstateOpen(
+	_Out_    PCSTATE_MONITOR pMonitor,
+	_In_     PMSR_BACKEND    pMsr,
+	_In_opt_ const TOPOLOGY* pTopology,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_     UINT32          uiCpuCount
+) {
+	RtlZeroMemory(pMonitor, sizeof(CSTATE_MONITOR));
+	if (uiCpuCount == 0x00)
+		return FALSE;
+	pMonitor->Msr = pMsr;
+	pMonitor->CpuCount = uiCpuCount;
+	pMonitor->Cpus = (PUINT32)calloc(uiCpuCount, sizeof(UINT32));
+	pMonitor->PackageReader = (PBOOL)calloc(uiCpuCount, sizeof(BOOL));
+	pMonitor->Previous = (PCSTATE_SAMPLE)calloc(uiCpuCount, sizeof(CSTATE_SAMPLE));
+	if (pMonitor->Cpus == NULL || pMonitor->PackageReader == NULL || pMonitor->Previous == NULL) {
+		CstateClose(pMonitor);
+		return FALSE;
+	}
+
+	// 1. The counters vary from one model to the next, a read failing means the MSR is not implemented
+	for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++) {
+		UINT64 Value = 0x00;
+		if (MsrRead(pMsr, pCpus[0], g_CstateCounters[Counter].Msr, &Value))
+			pMonitor->Present |= 1U << Counter;
+	}
+	if (pMonitor->Present == 0x00) {
+		CstateClose(pMonitor);
+		return FALSE;
+	}
+
+	// 2. The package counters are the same on every processor of the package, read them once
+	for (UINT32 Index = 0x00; Index < uiCpuCount; Index++) {
+		pMonitor->Cpus[Index] = pCpus[Index];
+		BOOL bFirst = TRUE;
+		for (UINT32 Other = 0x00; bFirst && Other < Index; Other++) {
+			bFirst = pTopology != NULL && pCpus[Index] < pTopology->CpuCount && pCpus[Other] < pTopology->CpuCount
+				&& pTopology->Cpus[pCpus[Index]].PackageId != pTopology->Cpus[pCpus[Other]].PackageId;
+		}
+		pMonitor->PackageReader[Index] = bFirst;
+	}
+
+	// 3. Reference of the first interval
+	pMonitor->PreviousTime = ThreadGetTime();
+	for (UINT32 Index = 0x00; Index < uiCpuCount; Index++)
+		(VOID)CstateRead(pMonitor, Index, &pMonitor->Previous[Index]);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL CstateSample(
+	_Inout_   PCSTATE_MONITOR   pMonitor,
+	_Out_writes_opt_(pMonitor->CpuCount) PCSTATE_RESIDENCY pResidencies,
+	_Out_     PCSTATE_INTERVAL  pInterval
+) {
+	RtlZeroMemory(pInterval, sizeof(CSTATE_INTERVAL));
+	UINT64 Now = ThreadGetTime();
+	pInterval->Nanoseconds = Now - pMonitor->PreviousTime;
+	pMonitor->PreviousTime = Now;
+
+	for (UINT32 Index = 0x00; Index < pMonitor->CpuCount; Index++) {
+		CSTATE_RESIDENCY Residency = { 0x00 };
+		CSTATE_SAMPLE Sample = { 0x00 };
+		PCSTATE_SAMPLE pPrevious = &pMonitor->Previous[Index];
+		Residency.bPackage = pMonitor->PackageReader[Index];
+
+		// 1. Ticks of every counter over the TSC ticks of the interval
+		if (CstateRead(pMonitor, Index, &Sample) && pPrevious->bValid && Sample.Tsc > pPrevious->Tsc) {
+			double Ticks = (double)(Sample.Tsc - pPrevious->Tsc);
+			for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++) {
+				if ((pMonitor->Present & (1U << Counter)) == 0x00 || (Counter >= CSTATE_FIRST_PACKAGE && !Residency.bPackage))
+					continue;
+				double Percent = 100.0 * (double)(Sample.Values[Counter] - pPrevious->Values[Counter]) / Ticks;
+				Residency.Percent[Counter] = Percent > 100.0 ? 100.0 : Percent;
+			}
+			Residency.bValid = TRUE;
+		}
+		*pPrevious = Sample;
+
+		// 2. Sums, averaged below
+		if (Residency.bValid) {
+			pInterval->CpuCount++;
+			pInterval->PackageCount += Residency.bPackage;
+			for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++)
+				pInterval->Percent[Counter] += Residency.Percent[Counter];
+		}
+		if (pResidencies != NULL)
+			pResidencies[Index] = Residency;
+	}
+
+	for (UINT32 Counter = 0x00; Counter < CstateCounterCount; Counter++) {
+		UINT32 Divisor = Counter < CSTATE_FIRST_PACKAGE ? pInterval->CpuCount : pInterval->PackageCount;
+		pInterval->Percent[Counter] = Divisor != 0x00 ? pInterval->Percent[Counter] / Divisor : 0.0;
+	}
+	return pInterval->CpuCount != 0x00;
+}
+
+_Use_decl_annotations_
+VOID CstateClose(
+	_Inout_ PCSTATE_MONITOR pMonitor
+) {
+	free(pMonitor->Cpus);
+	free(pMonitor->PackageReader);
+	free(pMonitor->Previous);
+	RtlZeroMemory(pMonitor, sizeof(CSTATE_MONITOR));
+}
+
+_Use_decl_annotations_
+LPCSTR CstateGetName(
+	_In_ CSTATE_COUNTER Counter
+) {
+	return (UINT32)Counter < CstateCounterCount ? g_CstateCounters[Counter].Name : "?";
+}
+
+_Use_decl_annotations_
+BOOL CstateCorrelate(
+	_In_reads_(uiCount) const double* pX,
+	_In_reads_(uiCount) const double* pY,
+	_In_  UINT32  uiCount,
+	_Out_ double* pCorrelation
+) {
+	*pCorrelation = 0.0;
+	if (uiCount < 0x02)
+		return FALSE;
+
+	// Two passes, the one pass formula loses too much precision on long series of close values
+	double MeanX = 0.0;
+	double MeanY = 0.0;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		MeanX += pX[Index];
+		MeanY += pY[Index];
+	}
+	MeanX /= uiCount;
+	MeanY /= uiCount;
+
+	double Covariance = 0.0;
+	double VarianceX = 0.0;
+	double VarianceY = 0.0;
+	double SquaresX = 0.0;
+	double SquaresY = 0.0;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		double dX = pX[Index] - MeanX;
+		double dY = pY[Index] - MeanY;
+		Covariance += dX * dY;
+		VarianceX += dX * dX;
+		VarianceY += dY * dY;
+		SquaresX += pX[Index] * pX[Index];
+		SquaresY += pY[Index] * pY[Index];
+	}
+
+	// A series varying by less than 0.01% of its magnitude only shows the jitter of the reads
+	if (VarianceX <= 1e-8 * SquaresX || VarianceY <= 1e-8 * SquaresY || VarianceX <= 0.0 || VarianceY <= 0.0)
+		return FALSE;
+	*pCorrelation = Covariance / sqrt(VarianceX * VarianceY);
+	return TRUE;
+}
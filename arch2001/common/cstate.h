@@ -0,0 +1,154 @@
+/// @file    cstate.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __CSTATE_H_GUARD__
+#define __CSTATE_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+#include "topology.h"
+
+/// Model specific residency counters of Intel processors, counting at the TSC rate
+#define MSR_PKG_C3_RESIDENCY  0x000003F8
+#define MSR_PKG_C6_RESIDENCY  0x000003F9
+#define MSR_PKG_C7_RESIDENCY  0x000003FA
+#define MSR_CORE_C3_RESIDENCY 0x000003FC
+#define MSR_CORE_C6_RESIDENCY 0x000003FD
+#define MSR_CORE_C7_RESIDENCY 0x000003FE
+#define MSR_PKG_C2_RESIDENCY  0x0000060D
+#define MSR_PKG_C8_RESIDENCY  0x00000630 // Client processors only, as are C9 and C10.
+#define MSR_PKG_C9_RESIDENCY  0x00000631
+#define MSR_PKG_C10_RESIDENCY 0x00000632
+
+/// <summary>
+/// Residency counters, core counters first.
+/// </summary>
+typedef enum _CSTATE_COUNTER {
+	CstateCoreC3      = 0x00,
+	CstateCoreC6      = 0x01,
+	CstateCoreC7      = 0x02,
+	CstatePackageC2   = 0x03,
+	CstatePackageC3   = 0x04,
+	CstatePackageC6   = 0x05,
+	CstatePackageC7   = 0x06,
+	CstatePackageC8   = 0x07,
+	CstatePackageC9   = 0x08,
+	CstatePackageC10  = 0x09,
+	CstateCounterCount
+} CSTATE_COUNTER;
+
+/// First package counter
+#define CSTATE_FIRST_PACKAGE CstatePackageC2
+
+/// <summary>
+/// Counters of a processor at the end of the previous interval.
+/// </summary>
+typedef struct _CSTATE_SAMPLE {
+	BOOL   bValid;
+	UINT64 Tsc;
+	UINT64 Values[CstateCounterCount];
+} CSTATE_SAMPLE, * PCSTATE_SAMPLE;
+
+/// <summary>
+/// Residency of one interval, in percent of the TSC ticks. Package counters are only set on the processor
+/// reading them for its package.
+/// </summary>
+typedef struct _CSTATE_RESIDENCY {
+	BOOL   bValid;
+	BOOL   bPackage;                        // Whether this processor reads the package counters.
+	double Percent[CstateCounterCount];
+} CSTATE_RESIDENCY, * PCSTATE_RESIDENCY;
+
+/// <summary>
+/// Residency of one interval averaged over the processors (core counters) and the packages (package counters).
+/// </summary>
+typedef struct _CSTATE_INTERVAL {
+	UINT64 Nanoseconds;
+	UINT32 CpuCount;                        // Processors read successfully.
+	UINT32 PackageCount;
+	double Percent[CstateCounterCount];
+} CSTATE_INTERVAL, * PCSTATE_INTERVAL;
+
+/// <summary>
+/// Monitor of a set of processors.
+/// </summary>
+typedef struct _CSTATE_MONITOR {
+	PMSR_BACKEND   Msr;
+	UINT32         CpuCount;
+	PUINT32        Cpus;
+	PBOOL          PackageReader;   // Per processor, first monitored processor of its package.
+	UINT32         Present;         // Mask of the counters implemented, 1 << CSTATE_COUNTER.
+	PCSTATE_SAMPLE Previous;
+	UINT64         PreviousTime;
+} CSTATE_MONITOR, * PCSTATE_MONITOR;
+
+/// <summary>
+/// Start monitoring processors: find the counters the processor implements, elect one processor per
+/// package to read the package counters, and take the first sample.
+/// </summary>
+/// <param name="pMonitor">Pointer to the monitor to initialise.</param>
+/// <param name="pMsr">Pointer to an opened MSR backend.</param>
+/// <param name="pTopology">Optional topology, without it every processor is assumed in the same package.</param>
+/// <param name="pCpus">Indices of the processors.</param>
+/// <param name="uiCpuCount">Number of processors.</param>
+/// <returns>Whether at least one counter can be read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CstateOpen(
+	_Out_    PCSTATE_MONITOR pMonitor,
+	_In_     PMSR_BACKEND    pMsr,
+	_In_opt_ const TOPOLOGY* pTopology,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_     UINT32          uiCpuCount
+);
+
+/// <summary>
+/// Read every processor with one batch of MSRs each and compute the residency since the previous call.
+/// </summary>
+/// <param name="pMonitor">Pointer to the monitor.</param>
+/// <param name="pResidencies">Optional array receiving the residency of every processor.</param>
+/// <param name="pInterval">Pointer receiving the averaged residency.</param>
+/// <returns>Whether at least one processor has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CstateSample(
+	_Inout_   PCSTATE_MONITOR   pMonitor,
+	_Out_writes_opt_(pMonitor->CpuCount) PCSTATE_RESIDENCY pResidencies,
+	_Out_     PCSTATE_INTERVAL  pInterval
+);
+
+/// <summary>
+/// Release a monitor.
+/// </summary>
+/// <param name="pMonitor">Pointer to the monitor.</param>
+VOID CstateClose(
+	_Inout_ PCSTATE_MONITOR pMonitor
+);
+
+/// <summary>
+/// Get the name of a counter, e.g. "CC6" or "PC10".
+/// </summary>
+/// <param name="Counter">Counter.</param>
+/// <returns>Name of the counter.</returns>
+LPCSTR CstateGetName(
+	_In_ CSTATE_COUNTER Counter
+);
+
+/// <summary>
+/// Compute the Pearson correlation coefficient of two series, e.g. the residency of a state and a latency.
+/// </summary>
+/// <param name="pX">First series.</param>
+/// <param name="pY">Second series.</param>
+/// <param name="uiCount">Number of values in each series.</param>
+/// <param name="pCorrelation">Pointer receiving the coefficient, from -1 to 1.</param>
+/// <returns>Whether the coefficient is defined, i.e. neither series is constant.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CstateCorrelate(
+	_In_reads_(uiCount) const double* pX,
+	_In_reads_(uiCount) const double* pY,
+	_In_  UINT32  uiCount,
+	_Out_ double* pCorrelation
+);
+
+#endif // !__CSTATE_H_GUARD__
@@ -0,0 +1,339 @@
+/// @file    ctlreg.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdio.h>
+#include "ctlreg.h"
+#include "cpuid.h"
+#include "intrinsics.h"
+#include "thread.h"
+
+#if defined(_WIN32)
+/// General information about the driver
+#define KSEG_DEVICE_TYPE 0x8000
+#define KSEG_DEVICE_PATH L"\\\\.\\KSeg"
+
+/// List of IOCTL exposed by this driver
+#define IOCTL_KSEG_QUERY_CONTROL CTL_CODE(KSEG_DEVICE_TYPE, 0x804, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
+
+/// Flags of CR0
+static const CTLREG_BIT g_CtlregCr0[] = {
+	{ 0,  "PE", "Protection Enable" },
+	{ 1,  "MP", "Monitor Coprocessor" },
+	{ 2,  "EM", "x87 Emulation" },
+	{ 3,  "TS", "Task Switched" },
+	{ 4,  "ET", "Extension Type" },
+	{ 5,  "NE", "Numeric Error" },
+	{ 16, "WP", "Write Protect" },
+	{ 18, "AM", "Alignment Mask" },
+	{ 29, "NW", "Not Write-through" },
+	{ 30, "CD", "Cache Disable" },
+	{ 31, "PG", "Paging" }
+};
+
+/// Flags of CR3, the PCID or PWT and PCD being decoded with CR4.PCIDE
+static const CTLREG_BIT g_CtlregCr3[] = {
+	{ 61, "LAM_U57", "Linear Address Masking, user bits 62:57" },
+	{ 62, "LAM_U48", "Linear Address Masking, user bits 62:48" }
+};
+
+/// Flags of CR4
+static const CTLREG_BIT g_CtlregCr4[] = {
+	{ 0,  "VME",        "Virtual-8086 Mode Extensions" },
+	{ 1,  "PVI",        "Protected-Mode Virtual Interrupts" },
+	{ 2,  "TSD",        "Time Stamp Disable, RDTSC privileged" },
+	{ 3,  "DE",         "Debugging Extensions" },
+	{ 4,  "PSE",        "Page Size Extensions" },
+	{ 5,  "PAE",        "Physical Address Extension" },
+	{ 6,  "MCE",        "Machine-Check Enable" },
+	{ 7,  "PGE",        "Page Global Enable" },
+	{ 8,  "PCE",        "RDPMC in user mode" },
+	{ 9,  "OSFXSR",     "FXSAVE and FXRSTOR support" },
+	{ 10, "OSXMMEXCPT", "Unmasked SIMD floating-point exceptions" },
+	{ 11, "UMIP",       "User-Mode Instruction Prevention" },
+	{ 12, "LA57",       "5-level paging" },
+	{ 13, "VMXE",       "VMX Enable" },
+	{ 14, "SMXE",       "SMX Enable" },
+	{ 16, "FSGSBASE",   "RDFSBASE and WRFSBASE in user mode" },
+	{ 17, "PCIDE",      "Process-Context Identifiers" },
+	{ 18, "OSXSAVE",    "XSAVE and extended states" },
+	{ 19, "KL",         "Key Locker" },
+	{ 20, "SMEP",       "Supervisor-Mode Execution Prevention" },
+	{ 21, "SMAP",       "Supervisor-Mode Access Prevention" },
+	{ 22, "PKE",        "Protection Keys, user pages" },
+	{ 23, "CET",        "Control-flow Enforcement" },
+	{ 24, "PKS",        "Protection Keys, supervisor pages" },
+	{ 25, "UINTR",      "User Interrupts" },
+	{ 28, "LAM_SUP",    "Linear Address Masking, supervisor" },
+	{ 32, "FRED",       "Flexible Return and Event Delivery" }
+};
+
+/// Flags of XCR0
+static const CTLREG_BIT g_CtlregXcr0[] = {
+	{ 0,  "X87",       "x87 state" },
+	{ 1,  "SSE",       "SSE state" },
+	{ 2,  "AVX",       "AVX state" },
+	{ 3,  "BNDREGS",   "MPX bounds registers" },
+	{ 4,  "BNDCSR",    "MPX configuration" },
+	{ 5,  "OPMASK",    "AVX-512 opmask registers" },
+	{ 6,  "ZMM_HI256", "AVX-512 upper ZMM0-15" },
+	{ 7,  "HI16_ZMM",  "AVX-512 ZMM16-31" },
+	{ 9,  "PKRU",      "Protection key rights" },
+	{ 17, "TILECFG",   "AMX tile configuration" },
+	{ 18, "TILEDATA",  "AMX tile data" },
+	{ 19, "APX",       "APX extended registers" }
+};
+
+/// Flags of IA32_EFER
+static const CTLREG_BIT g_CtlregEfer[] = {
+	{ 0,  "SCE",    "SYSCALL Enable" },
+	{ 8,  "LME",    "IA-32e Mode Enable" },
+	{ 10, "LMA",    "IA-32e Mode Active" },
+	{ 11, "NXE",    "Execute Disable Enable" },
+	{ 12, "SVME",   "Secure Virtual Machine Enable" },
+	{ 13, "LMSLE",  "Long Mode Segment Limit Enable" },
+	{ 14, "FFXSR",  "Fast FXSAVE and FXRSTOR" },
+	{ 15, "TCE",    "Translation Cache Extension" },
+	{ 21, "AIBRSE", "Automatic IBRS Enable" }
+};
+
+/// Name, flags and multi-bit fields of every register, in the order of CTLREG_REGISTER
+static const struct {
+	LPCSTR            Name;
+	const CTLREG_BIT* Bits;
+	UINT32            Count;
+	UINT64            Fields;   // Bits holding values rather than flags.
+} g_CtlregRegisters[CtlregRegisterCount] = {
+	{ "CR0",  g_CtlregCr0,  (UINT32)ARRAYSIZE(g_CtlregCr0),  0x00 },
+	{ "CR2",  NULL,         0x00,                            ~0x00ULL },
+	{ "CR3",  g_CtlregCr3,  (UINT32)ARRAYSIZE(g_CtlregCr3),  0x000FFFFFFFFFFFFFULL },
+	{ "CR4",  g_CtlregCr4,  (UINT32)ARRAYSIZE(g_CtlregCr4),  0x00 },
+	{ "CR8",  NULL,         0x00,                            0x000000000000000FULL },
+	{ "XCR0", g_CtlregXcr0, (UINT32)ARRAYSIZE(g_CtlregXcr0), 0x00 },
+	{ "EFER", g_CtlregEfer, (UINT32)ARRAYSIZE(g_CtlregEfer), 0x00 }
+};
+
+/// Bits deciding every feature, in the order of CTLREG_FEATURE. A feature is enabled if all the bits of
+/// Mask and Mask2 are set, or if they are all clear for the inverted ones.
+static const struct {
+	LPCSTR          Name;
+	CTLREG_REGISTER Register;
+	UINT64          Mask;
+	BOOL            bInverted;
+	CTLREG_REGISTER Register2;
+	UINT64          Mask2;
+} g_CtlregFeatures[CtlregFeatureCount] = {
+	{ "RDTSC in user mode",            CtlregCr4,  1ULL << 2,  TRUE,  CtlregCr4,  0x00 },
+	{ "RDPMC in user mode",            CtlregCr4,  1ULL << 8,  FALSE, CtlregCr4,  0x00 },
+	{ "SGDT and SIDT in user mode",    CtlregCr4,  1ULL << 11, TRUE,  CtlregCr4,  0x00 },
+	{ "RDFSBASE and WRFSBASE",         CtlregCr4,  1ULL << 16, FALSE, CtlregCr4,  0x00 },
+	{ "5-level paging",                CtlregCr4,  1ULL << 12, FALSE, CtlregCr4,  0x00 },
+	{ "Process-context identifiers",   CtlregCr4,  1ULL << 17, FALSE, CtlregCr4,  0x00 },
+	{ "SMEP",                          CtlregCr4,  1ULL << 20, FALSE, CtlregCr4,  0x00 },
+	{ "SMAP",                          CtlregCr4,  1ULL << 21, FALSE, CtlregCr4,  0x00 },
+	{ "Protection keys, WRPKRU",       CtlregCr4,  1ULL << 22, FALSE, CtlregXcr0, 1ULL << 9 },
+	{ "SYSCALL and SYSRET",            CtlregEfer, 1ULL << 0,  FALSE, CtlregEfer, 0x00 },
+	{ "Execute-disable pages",         CtlregEfer, 1ULL << 11, FALSE, CtlregEfer, 0x00 },
+	{ "AVX",                           CtlregXcr0, 0x06,       FALSE, CtlregXcr0, 0x00 },
+	{ "AVX-512",                       CtlregXcr0, 0xE6,       FALSE, CtlregXcr0, 0x00 },
+	{ "AMX",                           CtlregXcr0, 0x60000,    FALSE, CtlregXcr0, 0x00 }
+};
+
+_Use_decl_annotations_
+BOOL CtlregOpen(
+	_Out_    PCTLREG_SOURCE pSource,
+	_In_opt_ PMSR_BACKEND   pMsr
+) {
+	RtlZeroMemory(pSource, sizeof(CTLREG_SOURCE));
+	pSource->hDevice = INVALID_HANDLE_VALUE;
+	pSource->Msr = pMsr;
+	pSource->bXgetbv = CpuidGetInformation()->BasicEcx.elem.OSXSAVE;
+#if defined(_WIN32)
+	pSource->hDevice = CreateFileW(
+		KSEG_DEVICE_PATH,
+		GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL,
+		OPEN_EXISTING,
+		0x00,
+		NULL
+	);
+	if (pSource->hDevice != INVALID_HANDLE_VALUE) {
+		pSource->Name = "\\\\.\\KSeg";
+		return TRUE;
+	}
+#endif
+	pSource->Name = pMsr != NULL ? "XGETBV and MSR backend" : "XGETBV";
+	return pSource->bXgetbv || pMsr != NULL;
+}
+
+_Use_decl_annotations_
+BOOL CtlregCapture(
+	_In_  PCTLREG_SOURCE pSource,
+	_In_  UINT32         uiCpu,
+	_Out_writes_(uiCount) PCTLREG_STATE pStates,
+	_In_  UINT32         uiCount,
+	_Out_ PUINT32        pCaptured
+) {
+	RtlZeroMemory(pStates, uiCount * sizeof(CTLREG_STATE));
+	*pCaptured = 0x00;
+
+#if defined(_WIN32)
+	// 1. One request for every processor, the driver moves from one to the next
+	if (pSource->hDevice != INVALID_HANDLE_VALUE) {
+		DWORD dwBytesReturned = 0x00;
+		if (!DeviceIoControl(pSource->hDevice, IOCTL_KSEG_QUERY_CONTROL, &uiCpu, sizeof(UINT32), pStates, uiCount * sizeof(CTLREG_STATE), &dwBytesReturned, NULL))
+			return FALSE;
+		*pCaptured = dwBytesReturned / sizeof(CTLREG_STATE);
+		return *pCaptured != 0x00;
+	}
+#endif
+
+	// 2. Otherwise only XCR0 and IA32_EFER, from each processor in turn. The current processor is pinned as
+	//    well, otherwise the thread could migrate between XCR0 and IA32_EFER.
+	UINT32 First = uiCpu == CTLREG_ALL_CPUS ? 0x00 : uiCpu == CTLREG_CURRENT_CPU ? ThreadGetCurrentCpu() : uiCpu;
+	UINT32 Count = uiCpu == CTLREG_ALL_CPUS ? ThreadGetCpuCount() : 0x01;
+	if (Count > uiCount)
+		return FALSE;
+	BOOL bCaptured = FALSE;
+	for (UINT32 Index = 0x00; Index < Count; Index++) {
+		PCTLREG_STATE pState = &pStates[Index];
+		THREAD_AFFINITY Previous = { 0x00 };
+		if (!ThreadPin(First + Index, &Previous))
+			return FALSE;
+
+		pState->Cpu = First + Index;
+		if (pSource->bXgetbv) {
+			pState->Xcr0 = _read_xcr(0x00);
+			pState->Valid |= CTLREG_VALID_XCR0;
+		}
+		if (pSource->Msr != NULL && MsrRead(pSource->Msr, MSR_CURRENT_CPU, IA32_EFER, &pState->Efer))
+			pState->Valid |= CTLREG_VALID_EFER;
+		bCaptured |= pState->Valid != 0x00;
+		ThreadRestore(&Previous);
+	}
+	*pCaptured = Count;
+	return bCaptured;
+}
+
+_Use_decl_annotations_
+VOID CtlregClose(
+	_Inout_ PCTLREG_SOURCE pSource
+) {
+#if defined(_WIN32)
+	if (pSource->hDevice != INVALID_HANDLE_VALUE)
+		CloseHandle(pSource->hDevice);
+#endif
+	RtlZeroMemory(pSource, sizeof(CTLREG_SOURCE));
+	pSource->hDevice = INVALID_HANDLE_VALUE;
+}
+
+_Use_decl_annotations_
+LPCSTR CtlregGetName(
+	_In_ CTLREG_REGISTER Register
+) {
+	return (UINT32)Register < CtlregRegisterCount ? g_CtlregRegisters[Register].Name : "?";
+}
+
+_Use_decl_annotations_
+BOOL CtlregGetValue(
+	_In_  const CTLREG_STATE* pState,
+	_In_  CTLREG_REGISTER     Register,
+	_Out_ PUINT64             pValue
+) {
+	*pValue = 0x00;
+	switch (Register) {
+		case CtlregCr0:  *pValue = pState->Cr0; return (pState->Valid & CTLREG_VALID_CR) != 0x00;
+		case CtlregCr2:  *pValue = pState->Cr2; return (pState->Valid & CTLREG_VALID_CR) != 0x00;
+		case CtlregCr3:  *pValue = pState->Cr3; return (pState->Valid & CTLREG_VALID_CR) != 0x00;
+		case CtlregCr4:  *pValue = pState->Cr4; return (pState->Valid & CTLREG_VALID_CR) != 0x00;
+		case CtlregCr8:  *pValue = pState->Cr8; return (pState->Valid & CTLREG_VALID_CR) != 0x00;
+		case CtlregXcr0: *pValue = pState->Xcr0; return (pState->Valid & CTLREG_VALID_XCR0) != 0x00;
+		case CtlregEfer: *pValue = pState->Efer; return (pState->Valid & CTLREG_VALID_EFER) != 0x00;
+		default:         return FALSE;
+	}
+}
+
+_Use_decl_annotations_
+const CTLREG_BIT* CtlregGetBits(
+	_In_  CTLREG_REGISTER Register,
+	_Out_ PUINT32         pCount
+) {
+	*pCount = 0x00;
+	if ((UINT32)Register >= CtlregRegisterCount)
+		return NULL;
+	*pCount = g_CtlregRegisters[Register].Count;
+	return g_CtlregRegisters[Register].Bits;
+}
+
+_Use_decl_annotations_
+VOID CtlregFormat(
+	_In_ CTLREG_REGISTER Register,
+	_In_ UINT64          Value,
+	_Out_writes_(uiSize) LPSTR szBuffer,
+	_In_ UINT32          uiSize
+) {
+	if (uiSize == 0x00)
+		return;
+	szBuffer[0] = '\0';
+	if ((UINT32)Register >= CtlregRegisterCount)
+		return;
+
+	// 1. Every bit set outside of the fields, by name if defined
+	UINT32 Length = 0x00;
+	UINT64 Flags = Value & ~g_CtlregRegisters[Register].Fields;
+	for (UINT32 Bit = 0x00; Bit < 64 && Length < uiSize; Bit++) {
+		if ((Flags & (1ULL << Bit)) == 0x00)
+			continue;
+		LPCSTR szName = NULL;
+		for (UINT32 Index = 0x00; szName == NULL && Index < g_CtlregRegisters[Register].Count; Index++) {
+			if (g_CtlregRegisters[Register].Bits[Index].Bit == Bit)
+				szName = g_CtlregRegisters[Register].Bits[Index].Name;
+		}
+
+		// 2. snprintf truncates, the length stops the loop once the buffer is full
+		INT Written = szName != NULL
+			? snprintf(szBuffer + Length, uiSize - Length, "%s%s", Length ? " " : "", szName)
+			: snprintf(szBuffer + Length, uiSize - Length, "%sbit%u", Length ? " " : "", Bit);
+		if (Written < 0)
+			break;
+		Length += (UINT32)Written;
+	}
+}
+
+_Use_decl_annotations_
+BOOL CtlregIsEnabled(
+	_In_  const CTLREG_STATE* pState,
+	_In_  CTLREG_FEATURE      Feature,
+	_Out_ PBOOL               pEnabled
+) {
+	*pEnabled = FALSE;
+	if ((UINT32)Feature >= CtlregFeatureCount)
+		return FALSE;
+
+	UINT64 Value = 0x00;
+	UINT64 Value2 = 0x00;
+	if (!CtlregGetValue(pState, g_CtlregFeatures[Feature].Register, &Value))
+		return FALSE;
+	if (g_CtlregFeatures[Feature].Mask2 != 0x00 && !CtlregGetValue(pState, g_CtlregFeatures[Feature].Register2, &Value2))
+		return FALSE;
+
+	UINT64 Mask = g_CtlregFeatures[Feature].Mask;
+	UINT64 Mask2 = g_CtlregFeatures[Feature].Mask2;
+	if (g_CtlregFeatures[Feature].bInverted)
+		*pEnabled = (Value & Mask) == 0x00;
+	else
+		*pEnabled = (Value & Mask) == Mask && (Value2 & Mask2) == Mask2;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+LPCSTR CtlregGetFeatureName(
+	_In_ CTLREG_FEATURE Feature
+) {
+	return (UINT32)Feature < CtlregFeatureCount ? g_CtlregFeatures[Feature].Name : "?";
+}
@@ -0,0 +1,336 @@
+/// @file    ctlreg.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __CTLREG_H_GUARD__
+#define __CTLREG_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// Processors of CtlregCapture besides an index
+#define CTLREG_CURRENT_CPU MSR_CURRENT_CPU
+#define CTLREG_ALL_CPUS    0xFFFFFFFE
+
+/// Bits of CTLREG_STATE.Valid, set for each group of registers that has been captured
+#define CTLREG_VALID_CR   0x00000001 // CR0, CR2, CR3, CR4 and CR8. Requires the \\.\KSeg driver.
+#define CTLREG_VALID_XCR0 0x00000002 // Requires CR4.OSXSAVE.
+#define CTLREG_VALID_EFER 0x00000004
+
+/// <summary>
+/// Registers known to the decoders.
+/// </summary>
+typedef enum _CTLREG_REGISTER {
+	CtlregCr0      = 0x00,
+	CtlregCr2      = 0x01,
+	CtlregCr3      = 0x02,
+	CtlregCr4      = 0x03,
+	CtlregCr8      = 0x04,
+	CtlregXcr0     = 0x05,
+	CtlregEfer     = 0x06,
+	CtlregRegisterCount
+} CTLREG_REGISTER;
+
+/// <summary>
+/// Bits of CR0.
+/// </summary>
+typedef union _CTLREG_CR0 {
+	struct {
+		UINT64 PE : 1;          // Protection Enable.
+		UINT64 MP : 1;          // Monitor Coprocessor.
+		UINT64 EM : 1;          // Emulation, x87 instructions raise #NM.
+		UINT64 TS : 1;          // Task Switched, lazy x87 and SSE state saving.
+		UINT64 ET : 1;          // Extension Type, always 1.
+		UINT64 NE : 1;          // Numeric Error, native x87 error reporting.
+		UINT64 Reserved1 : 10;
+		UINT64 WP : 1;          // Write Protect, supervisor writes honour read-only pages.
+		UINT64 Reserved2 : 1;
+		UINT64 AM : 1;          // Alignment Mask, with EFLAGS.AC.
+		UINT64 Reserved3 : 10;
+		UINT64 NW : 1;          // Not Write-through.
+		UINT64 CD : 1;          // Cache Disable.
+		UINT64 PG : 1;          // Paging.
+		UINT64 Reserved4 : 32;
+	} elem;
+	UINT64 value;
+} CTLREG_CR0;
+
+/// <summary>
+/// Bits of CR3. The low 12 bits are the PCID if CR4.PCIDE is set, PWT and PCD otherwise.
+/// </summary>
+typedef union _CTLREG_CR3 {
+	struct {
+		UINT64 Reserved1 : 3;
+		UINT64 PWT : 1;
+		UINT64 PCD : 1;
+		UINT64 Reserved2 : 7;
+		UINT64 Base : 40;       // Physical address of the PML4 or PML5 table, bits 51:12.
+		UINT64 Reserved3 : 9;
+		UINT64 LAM_U57 : 1;     // Linear Address Masking of user pointers, bits 62:57.
+		UINT64 LAM_U48 : 1;     // Linear Address Masking of user pointers, bits 62:48.
+		UINT64 Reserved4 : 1;
+	} elem;
+	struct {
+		UINT64 PCID : 12;
+		UINT64 Reserved : 52;
+	} pcid;
+	UINT64 value;
+} CTLREG_CR3;
+
+/// <summary>
+/// Bits of CR4.
+/// </summary>
+typedef union _CTLREG_CR4 {
+	struct {
+		UINT64 VME : 1;         // Virtual-8086 Mode Extensions.
+		UINT64 PVI : 1;         // Protected-Mode Virtual Interrupts.
+		UINT64 TSD : 1;         // Time Stamp Disable, RDTSC is privileged.
+		UINT64 DE : 1;          // Debugging Extensions.
+		UINT64 PSE : 1;         // Page Size Extensions.
+		UINT64 PAE : 1;         // Physical Address Extension.
+		UINT64 MCE : 1;         // Machine-Check Enable.
+		UINT64 PGE : 1;         // Page Global Enable.
+		UINT64 PCE : 1;         // Performance-Monitoring Counter Enable, RDPMC in user mode.
+		UINT64 OSFXSR : 1;      // FXSAVE and FXRSTOR support.
+		UINT64 OSXMMEXCPT : 1;  // Unmasked SIMD floating-point exceptions.
+		UINT64 UMIP : 1;        // User-Mode Instruction Prevention, SGDT, SIDT, SLDT, SMSW and STR are privileged.
+		UINT64 LA57 : 1;        // 57-bit linear addresses, 5-level paging.
+		UINT64 VMXE : 1;        // VMX Enable.
+		UINT64 SMXE : 1;        // SMX Enable.
+		UINT64 Reserved1 : 1;
+		UINT64 FSGSBASE : 1;    // RDFSBASE, RDGSBASE, WRFSBASE and WRGSBASE in user mode.
+		UINT64 PCIDE : 1;       // PCID Enable.
+		UINT64 OSXSAVE : 1;     // XSAVE and processor extended states, XGETBV in user mode.
+		UINT64 KL : 1;          // Key Locker Enable.
+		UINT64 SMEP : 1;        // Supervisor-Mode Execution Prevention.
+		UINT64 SMAP : 1;        // Supervisor-Mode Access Prevention.
+		UINT64 PKE : 1;         // Protection Keys for user-mode pages.
+		UINT64 CET : 1;         // Control-flow Enforcement Technology.
+		UINT64 PKS : 1;         // Protection Keys for supervisor-mode pages.
+		UINT64 UINTR : 1;       // User Interrupts Enable.
+		UINT64 Reserved2 : 2;
+		UINT64 LAM_SUP : 1;     // Linear Address Masking of supervisor pointers.
+		UINT64 Reserved3 : 3;
+		UINT64 FRED : 1;        // Flexible Return and Event Delivery.
+		UINT64 Reserved4 : 31;
+	} elem;
+	UINT64 value;
+} CTLREG_CR4;
+
+/// <summary>
+/// Bits of IA32_EFER.
+/// </summary>
+typedef union _CTLREG_EFER {
+	struct {
+		UINT64 SCE : 1;         // SYSCALL Enable.
+		UINT64 Reserved1 : 7;
+		UINT64 LME : 1;         // IA-32e Mode Enable.
+		UINT64 Reserved2 : 1;
+		UINT64 LMA : 1;         // IA-32e Mode Active.
+		UINT64 NXE : 1;         // Execute Disable Bit Enable.
+		UINT64 SVME : 1;        // Secure Virtual Machine Enable, AMD.
+		UINT64 LMSLE : 1;       // Long Mode Segment Limit Enable, AMD.
+		UINT64 FFXSR : 1;       // Fast FXSAVE and FXRSTOR, AMD.
+		UINT64 TCE : 1;         // Translation Cache Extension, AMD.
+		UINT64 Reserved3 : 5;
+		UINT64 AIBRSE : 1;      // Automatic IBRS Enable, AMD.
+		UINT64 Reserved4 : 42;
+	} elem;
+	UINT64 value;
+} CTLREG_EFER;
+
+/// <summary>
+/// Bits of XCR0, the user state components enabled for XSAVE.
+/// </summary>
+typedef union _CTLREG_XCR0 {
+	struct {
+		UINT64 X87 : 1;
+		UINT64 SSE : 1;
+		UINT64 AVX : 1;
+		UINT64 BNDREGS : 1;     // MPX bounds registers.
+		UINT64 BNDCSR : 1;      // MPX configuration and status.
+		UINT64 OPMASK : 1;      // AVX-512 k0 to k7.
+		UINT64 ZMM_HI256 : 1;   // AVX-512 upper halves of ZMM0 to ZMM15.
+		UINT64 HI16_ZMM : 1;    // AVX-512 ZMM16 to ZMM31.
+		UINT64 Reserved1 : 1;
+		UINT64 PKRU : 1;
+		UINT64 Reserved2 : 7;
+		UINT64 TILECFG : 1;     // AMX tile configuration.
+		UINT64 TILEDATA : 1;    // AMX tile data.
+		UINT64 APX : 1;         // APX extended general purpose registers.
+		UINT64 Reserved3 : 44;
+	} elem;
+	UINT64 value;
+} CTLREG_XCR0;
+
+/// <summary>
+/// Definition of a bit of a register.
+/// </summary>
+typedef struct _CTLREG_BIT {
+	UINT32 Bit;
+	LPCSTR Name;
+	LPCSTR Description;
+} CTLREG_BIT, * PCTLREG_BIT;
+
+/// <summary>
+/// Features the fast paths depend on, each decided by one or more bits.
+/// </summary>
+typedef enum _CTLREG_FEATURE {
+	CtlregUserRdtsc       = 0x00, // !CR4.TSD
+	CtlregUserRdpmc       = 0x01, // CR4.PCE
+	CtlregUserSgdt        = 0x02, // !CR4.UMIP
+	CtlregUserFsGsBase    = 0x03, // CR4.FSGSBASE
+	CtlregFiveLevelPaging = 0x04, // CR4.LA57
+	CtlregPcid            = 0x05, // CR4.PCIDE
+	CtlregSmep            = 0x06, // CR4.SMEP
+	CtlregSmap            = 0x07, // CR4.SMAP
+	CtlregProtectionKeys  = 0x08, // CR4.PKE and XCR0.PKRU
+	CtlregSyscall         = 0x09, // EFER.SCE
+	CtlregNoExecute       = 0x0A, // EFER.NXE
+	CtlregAvx             = 0x0B, // XCR0.SSE and XCR0.AVX
+	CtlregAvx512          = 0x0C, // XCR0.OPMASK, XCR0.ZMM_HI256 and XCR0.HI16_ZMM
+	CtlregAmx             = 0x0D, // XCR0.TILECFG and XCR0.TILEDATA
+	CtlregFeatureCount
+} CTLREG_FEATURE;
+
+/// <summary>
+/// Registers of a processor. The layout is that of the output of IOCTL_KSEG_QUERY_CONTROL.
+/// </summary>
+typedef struct _CTLREG_STATE {
+	UINT32 Cpu;
+	UINT32 Valid;   // CTLREG_VALID_* bits.
+	UINT64 Cr0;
+	UINT64 Cr2;
+	UINT64 Cr3;     // Kernel CR3 of the calling process on Windows.
+	UINT64 Cr4;
+	UINT64 Cr8;     // IRQL of the driver, PASSIVE_LEVEL.
+	UINT64 Xcr0;
+	UINT64 Efer;
+} CTLREG_STATE, * PCTLREG_STATE;
+
+C_ASSERT(sizeof(CTLREG_STATE) == 64);
+
+/// <summary>
+/// Sources of the registers: the \\.\KSeg driver for everything on Windows, otherwise XGETBV for XCR0
+/// and the MSR backend for IA32_EFER.
+/// </summary>
+typedef struct _CTLREG_SOURCE {
+	LPCSTR       Name;
+	HANDLE       hDevice;
+	PMSR_BACKEND Msr;
+	BOOL         bXgetbv;
+} CTLREG_SOURCE, * PCTLREG_SOURCE;
+
+/// <summary>
+/// Open the sources of the registers.
+/// </summary>
+/// <param name="pSource">Pointer to the source to initialise.</param>
+/// <param name="pMsr">Optional MSR backend, for IA32_EFER without the driver.</param>
+/// <returns>Whether at least one register can be captured.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CtlregOpen(
+	_Out_    PCTLREG_SOURCE pSource,
+	_In_opt_ PMSR_BACKEND   pMsr
+);
+
+/// <summary>
+/// Capture the registers of one or all processors. The driver captures every processor in a single request.
+/// </summary>
+/// <param name="pSource">Pointer to the source.</param>
+/// <param name="uiCpu">Index of the processor, CTLREG_CURRENT_CPU or CTLREG_ALL_CPUS.</param>
+/// <param name="pStates">Array receiving the registers, one entry per processor.</param>
+/// <param name="uiCount">Number of entries of the array.</param>
+/// <param name="pCaptured">Pointer receiving the number of entries filled.</param>
+/// <returns>Whether at least one register of one processor has been captured.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CtlregCapture(
+	_In_  PCTLREG_SOURCE pSource,
+	_In_  UINT32         uiCpu,
+	_Out_writes_(uiCount) PCTLREG_STATE pStates,
+	_In_  UINT32         uiCount,
+	_Out_ PUINT32        pCaptured
+);
+
+/// <summary>
+/// Release the sources opened by CtlregOpen. The MSR backend is left open.
+/// </summary>
+/// <param name="pSource">Pointer to the source.</param>
+VOID CtlregClose(
+	_Inout_ PCTLREG_SOURCE pSource
+);
+
+/// <summary>
+/// Get the name of a register, e.g. "CR4" or "EFER".
+/// </summary>
+/// <param name="Register">Register.</param>
+/// <returns>Name of the register.</returns>
+LPCSTR CtlregGetName(
+	_In_ CTLREG_REGISTER Register
+);
+
+/// <summary>
+/// Get the value of a register from a capture.
+/// </summary>
+/// <param name="pState">Pointer to the registers.</param>
+/// <param name="Register">Register.</param>
+/// <param name="pValue">Pointer receiving the value.</param>
+/// <returns>Whether the register has been captured.</returns>
+_Success_(return != 0x00)
+BOOL CtlregGetValue(
+	_In_  const CTLREG_STATE* pState,
+	_In_  CTLREG_REGISTER     Register,
+	_Out_ PUINT64             pValue
+);
+
+/// <summary>
+/// Get the definitions of the single-bit flags of a register, ordered by bit.
+/// </summary>
+/// <param name="Register">Register.</param>
+/// <param name="pCount">Pointer receiving the number of definitions.</param>
+/// <returns>Array of definitions, NULL for the registers without flags such as CR2.</returns>
+const CTLREG_BIT* CtlregGetBits(
+	_In_  CTLREG_REGISTER Register,
+	_Out_ PUINT32         pCount
+);
+
+/// <summary>
+/// Write the names of the flags set in a value, e.g. "PE MP ET NE WP AM PG". Bits set without a definition
+/// are written as "bitN", the address and PCID fields of CR3 and the TPR of CR8 are left out.
+/// </summary>
+/// <param name="Register">Register.</param>
+/// <param name="Value">Value of the register.</param>
+/// <param name="szBuffer">Buffer receiving the names.</param>
+/// <param name="uiSize">Size of the buffer in characters.</param>
+VOID CtlregFormat(
+	_In_ CTLREG_REGISTER Register,
+	_In_ UINT64          Value,
+	_Out_writes_(uiSize) LPSTR szBuffer,
+	_In_ UINT32          uiSize
+);
+
+/// <summary>
+/// Decide whether a feature is enabled by the operating system.
+/// </summary>
+/// <param name="pState">Pointer to the registers.</param>
+/// <param name="Feature">Feature.</param>
+/// <param name="pEnabled">Pointer receiving whether the feature is enabled.</param>
+/// <returns>Whether the registers deciding the feature have been captured.</returns>
+_Success_(return != 0x00)
+BOOL CtlregIsEnabled(
+	_In_  const CTLREG_STATE* pState,
+	_In_  CTLREG_FEATURE      Feature,
+	_Out_ PBOOL               pEnabled
+);
+
+/// <summary>
+/// Get the description of a feature.
+/// </summary>
+/// <param name="Feature">Feature.</param>
+/// <returns>Description of the feature.</returns>
+LPCSTR CtlregGetFeatureName(
+	_In_ CTLREG_FEATURE Feature
+);
+
+#endif // !__CTLREG_H_GUARD__
@@ -0,0 +1,31 @@
+;; @file    dtr.asm
+;; @author  Paul L. (@am0nsec)
+;; @version 1.0
+;; @link    https://github.com/am0nsec/ost
+;; @brief   Windows specific code for the OpenSecurityTraining2 Architecture 2001 class
+;;          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+;; 
+.code
+
+_read_gdtr PROC PUBLIC
+	sgdt tbyte ptr [rcx]
+	ret
+_read_gdtr ENDP
+
+_read_idtr PROC PUBLIC
+	sidt tbyte ptr [rcx]
+	ret
+_read_idtr ENDP
+
+_read_ldtr PROC PUBLIC
+	sldt word ptr [rcx]
+	ret
+_read_ldtr ENDP
+
+_read_tr PROC PUBLIC
+	str word ptr [rcx]
+	ret
+_read_tr ENDP
+
+;; End of file
+end
@@ -0,0 +1,230 @@
+/// @file    dtr.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <setjmp.h>
+#include <signal.h>
+#endif
+#include "dtr.h"
+#include "cpuid.h"
+#include "intrinsics.h"
+
+#if defined(_WIN32)
+/// General information about the driver
+#define KSEG_DEVICE_TYPE 0x8000
+#define KSEG_DEVICE_PATH L"\\\\.\\KSeg"
+
+/// List of IOCTL exposed by this driver
+#define IOCTL_KSEG_QUERY_DTR CTL_CODE(KSEG_DEVICE_TYPE, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/// <summary>
+/// Data returned by the descriptor table registers query
+/// </summary>
+typedef struct _KSEG_DTR_OUT {
+	UINT64 GdtBase;
+	UINT64 IdtBase;
+	UINT16 GdtLimit;
+	UINT16 IdtLimit;
+	UINT16 Ldtr;
+	UINT16 Tr;
+} KSEG_DTR_OUT, * PKSEG_DTR_OUT;
+
+/// <summary>
+/// Handle to the \\.\KSeg device, opened on first use.
+/// </summary>
+static HANDLE g_hDevice = INVALID_HANDLE_VALUE;
+#else
+/// <summary>
+/// Context used to recover from the fault raised by the probe when UMIP is enforced without emulation.
+/// </summary>
+static sigjmp_buf g_ProbeContext;
+
+static void DtrProbeHandler(int Signal) {
+	siglongjmp(g_ProbeContext, Signal);
+}
+#endif
+
+/// <summary>
+/// Source selected by DtrInitialise.
+/// </summary>
+static DTR_SOURCE g_Source = DtrSourceNone;
+static BOOL g_Initialised = FALSE;
+
+/// <summary>
+/// Execute the instructions once while catching the fault raised if UMIP is enforced by the OS.
+/// </summary>
+/// <param name="pInformation">Pointer to the structure receiving the registers.</param>
+/// <returns>Whether the instructions can be executed in user mode.</returns>
+static BOOL DtrProbeInstruction(
+	_Out_ PDTR_INFORMATION pInformation
+) {
+#if defined(_WIN32)
+	__try {
+		DtrReadInstruction(pInformation);
+	}
+	__except (EXCEPTION_EXECUTE_HANDLER) {
+		return FALSE;
+	}
+	return TRUE;
+#else
+	// 1. Temporarily install the handlers. This only runs once, from DtrInitialise.
+	struct sigaction Action = { 0x00 };
+	struct sigaction OldSegv = { 0x00 };
+	struct sigaction OldIll = { 0x00 };
+	Action.sa_handler = DtrProbeHandler;
+	sigemptyset(&Action.sa_mask);
+	sigaction(SIGSEGV, &Action, &OldSegv);
+	sigaction(SIGILL, &Action, &OldIll);
+
+	// 2. Execute the instructions
+	volatile BOOL bResult = FALSE;
+	if (sigsetjmp(g_ProbeContext, 1) == 0x00) {
+		DtrReadInstruction(pInformation);
+		bResult = TRUE;
+	}
+
+	// 3. Restore the original handlers
+	sigaction(SIGSEGV, &OldSegv, NULL);
+	sigaction(SIGILL, &OldIll, NULL);
+	return bResult;
+#endif
+}
+
+DTR_SOURCE DtrInitialise() {
+	if (g_Initialised)
+		return g_Source;
+	g_Initialised = TRUE;
+
+	// 1. Without UMIP the instructions are never trapped.
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	if (!Cpuid->ExtendedEcx.elem.UMIP) {
+		g_Source = DtrSourceInstruction;
+		return g_Source;
+	}
+
+	// 2. The processor supports UMIP but the OS may not enable it: probe once.
+	DTR_INFORMATION Information = { 0x00 };
+	if (DtrProbeInstruction(&Information)) {
+		g_Source = Information.Gdtr.Base == DTR_LINUX_UMIP_DUMMY_GDT_BASE
+			&& Information.Idtr.Base == DTR_LINUX_UMIP_DUMMY_IDT_BASE ? DtrSourceEmulated : DtrSourceInstruction;
+		return g_Source;
+	}
+
+	// 3. UMIP is enforced: only the driver can get the real values.
+#if defined(_WIN32)
+	g_Source = DtrSourceDriver;
+#else
+	g_Source = DtrSourceNone;
+#endif
+	return g_Source;
+}
+
+VOID DtrUninitialise() {
+#if defined(_WIN32)
+	if (g_hDevice != INVALID_HANDLE_VALUE) {
+		CloseHandle(g_hDevice);
+		g_hDevice = INVALID_HANDLE_VALUE;
+	}
+#endif
+	g_Initialised = FALSE;
+	g_Source = DtrSourceNone;
+}
+
+_Use_decl_annotations_
+VOID DtrReadInstruction(
+	_Out_ PDTR_INFORMATION pInformation
+) {
+	SGDT_OUT Gdtr = { 0x00 };
+	SGDT_OUT Idtr = { 0x00 };
+	_get_gdtr(&Gdtr);
+	_get_idtr(&Idtr);
+	UINT16 Ldtr = _get_ldtr();
+	UINT16 Tr = _get_tr();
+
+	pInformation->Source = DtrSourceInstruction;
+	pInformation->Gdtr.Base = Gdtr.Address;
+	pInformation->Gdtr.Limit = Gdtr.Limit;
+	pInformation->Idtr.Base = Idtr.Address;
+	pInformation->Idtr.Limit = Idtr.Limit;
+	pInformation->Ldtr = Ldtr;
+	pInformation->Tr = Tr;
+}
+
+_Use_decl_annotations_
+BOOL DtrReadDriver(
+	_Out_ PDTR_INFORMATION pInformation
+) {
+	RtlZeroMemory(pInformation, sizeof(DTR_INFORMATION));
+#if defined(_WIN32)
+	// 1. Get an handle to the device object if not already done.
+	if (g_hDevice == INVALID_HANDLE_VALUE) {
+		g_hDevice = CreateFileW(
+			KSEG_DEVICE_PATH,
+			GENERIC_READ | GENERIC_WRITE,
+			FILE_SHARE_READ | FILE_SHARE_WRITE,
+			NULL,
+			OPEN_EXISTING,
+			0x00,
+			NULL
+		);
+		if (g_hDevice == INVALID_HANDLE_VALUE)
+			return FALSE;
+	}
+
+	// 2. Query the device
+	KSEG_DTR_OUT DataOut = { 0x00 };
+	DWORD dwBytesReturned = 0x00;
+	BOOL bSuccess = DeviceIoControl(
+		g_hDevice,
+		IOCTL_KSEG_QUERY_DTR,
+		NULL,
+		0x00,
+		&DataOut,
+		sizeof(KSEG_DTR_OUT),
+		&dwBytesReturned,
+		NULL
+	);
+	if (!bSuccess || dwBytesReturned < sizeof(KSEG_DTR_OUT))
+		return FALSE;
+
+	// 3. Return the data
+	pInformation->Source = DtrSourceDriver;
+	pInformation->Gdtr.Base = DataOut.GdtBase;
+	pInformation->Gdtr.Limit = DataOut.GdtLimit;
+	pInformation->Idtr.Base = DataOut.IdtBase;
+	pInformation->Idtr.Limit = DataOut.IdtLimit;
+	pInformation->Ldtr = DataOut.Ldtr;
+	pInformation->Tr = DataOut.Tr;
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+_Use_decl_annotations_
+BOOL DtrRead(
+	_Out_ PDTR_INFORMATION pInformation
+) {
+	if (pInformation == NULL)
+		return FALSE;
+
+	switch (DtrInitialise()) {
+		case DtrSourceInstruction:
+			DtrReadInstruction(pInformation);
+			return TRUE;
+		case DtrSourceEmulated:
+			DtrReadInstruction(pInformation);
+			pInformation->Source = DtrSourceEmulated;
+			return TRUE;
+		case DtrSourceDriver:
+			return DtrReadDriver(pInformation);
+		default:
+			RtlZeroMemory(pInformation, sizeof(DTR_INFORMATION));
+			return FALSE;
+	}
+}
@@ -0,0 +1,86 @@
+/// @file    dtr.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __DTR_H_GUARD__
+#define __DTR_H_GUARD__
+#include "ost.h"
+
+/// Dummy values returned by the Linux kernel when it emulates SGDT/SIDT for a process (UMIP enabled).
+#define DTR_LINUX_UMIP_DUMMY_GDT_BASE 0xFFFFFFFFFFFE0000
+#define DTR_LINUX_UMIP_DUMMY_IDT_BASE 0xFFFFFFFFFFFF0000
+
+/// <summary>
+/// Where the descriptor table registers are read from.
+/// </summary>
+typedef enum _DTR_SOURCE {
+	DtrSourceNone        = 0x00, // No way to read the registers on this system.
+	DtrSourceInstruction = 0x01, // SGDT/SIDT/SLDT/STR executed directly in user mode.
+	DtrSourceEmulated    = 0x02, // UMIP is enforced and the kernel returns dummy values on our behalf.
+	DtrSourceDriver      = 0x03  // Round trip to the \\.\KSeg driver.
+} DTR_SOURCE;
+
+/// <summary>
+/// C data structure representing the content of either the GDTR or the IDTR.
+/// </summary>
+typedef struct _DTR_TABLE {
+	UINT64 Base;
+	UINT16 Limit;
+} DTR_TABLE, * PDTR_TABLE;
+
+/// <summary>
+/// Content of the descriptor table registers of the processor the caller was running on.
+/// </summary>
+typedef struct _DTR_INFORMATION {
+	DTR_SOURCE Source;
+	DTR_TABLE  Gdtr;
+	DTR_TABLE  Idtr;
+	UINT16     Ldtr;
+	UINT16     Tr;
+} DTR_INFORMATION, * PDTR_INFORMATION;
+
+/// <summary>
+/// Select how the descriptor table registers will be read. UMIP is checked once via CPUID and, if the
+/// processor supports it, the instructions are probed once to know whether the OS enforces it.
+/// </summary>
+/// <returns>The source that will be used by DtrRead.</returns>
+DTR_SOURCE DtrInitialise();
+
+/// <summary>
+/// Release the handle to the driver, if any has been opened.
+/// </summary>
+VOID DtrUninitialise();
+
+/// <summary>
+/// Read the descriptor table registers via the fastest source available.
+/// </summary>
+/// <param name="pInformation">Pointer to the structure receiving the registers.</param>
+/// <returns>Whether the registers have been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL DtrRead(
+	_Out_ PDTR_INFORMATION pInformation
+);
+
+/// <summary>
+/// Read the descriptor table registers by executing SGDT/SIDT/SLDT/STR in user mode. Must only be called
+/// once DtrInitialise returned either DtrSourceInstruction or DtrSourceEmulated.
+/// </summary>
+/// <param name="pInformation">Pointer to the structure receiving the registers.</param>
+VOID DtrReadInstruction(
+	_Out_ PDTR_INFORMATION pInformation
+);
+
+/// <summary>
+/// Read the descriptor table registers via the \\.\KSeg driver. Windows only.
+/// </summary>
+/// <param name="pInformation">Pointer to the structure receiving the registers.</param>
+/// <returns>Whether the driver has been queried successfully.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL DtrReadDriver(
+	_Out_ PDTR_INFORMATION pInformation
+);
+
+#endif // !__DTR_H_GUARD__
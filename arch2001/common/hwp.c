@@ -0,0 +1,314 @@
+/// @file    hwp.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "hwp.h"
+#include "thread.h"
+
+_Use_decl_annotations_
+BOOL HwpQuery(
+	_In_  PCPUID_BACKEND pBackend,
+	_Out_ PHWP_FEATURES  pFeatures
+) {
+	if (pBackend == NULL || pFeatures == NULL)
+		return FALSE;
+	RtlZeroMemory(pFeatures, sizeof(HWP_FEATURES));
+
+	// 1. Legacy performance states
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers))
+		return FALSE;
+	UINT MaximumLeaf = Registers[0];
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_BASIC_INFORMATION, 0x00, Registers))
+		return FALSE;
+	BasicInformationEcx Basic = { .value = Registers[2] };
+	pFeatures->Eist = Basic.elem.EIST;
+
+	// 2. Thermal and power management leaf
+	if (MaximumLeaf >= CPUID_LEAF_THERMAL_POWER && CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_THERMAL_POWER, 0x00, Registers)) {
+		pFeatures->Turbo = (Registers[0] & HWP_CPUID_TURBO) != 0x00;
+		pFeatures->Hwp = (Registers[0] & HWP_CPUID_HWP) != 0x00;
+		pFeatures->ActivityWindow = pFeatures->Hwp && (Registers[0] & HWP_CPUID_ACTIVITY_WINDOW) != 0x00;
+		pFeatures->Epp = pFeatures->Hwp && (Registers[0] & HWP_CPUID_EPP) != 0x00;
+		pFeatures->PackageRequest = pFeatures->Hwp && (Registers[0] & HWP_CPUID_PACKAGE_REQUEST) != 0x00;
+		pFeatures->AperfMperf = (Registers[2] & HWP_CPUID_APERF_MPERF) != 0x00;
+	}
+	return pFeatures->Hwp || pFeatures->Eist;
+}
+
+_Use_decl_annotations_
+BOOL HwpOpen(
+	_Out_ PHWP_CONTROL        pControl,
+	_In_  PMSR_BACKEND        pMsr,
+	_In_  const HWP_FEATURES* pFeatures,
+	_In_  UINT32              uiCpuCount
+) {
+	RtlZeroMemory(pControl, sizeof(HWP_CONTROL));
+	pControl->Msr = pMsr;
+	pControl->Features = *pFeatures;
+	pControl->CpuCount = uiCpuCount;
+
+	// 1. Once the OS enabled HWP, IA32_PERF_CTL is ignored
+	UINT64 Enable = 0x00;
+	if (pFeatures->Hwp && MsrRead(pMsr, 0x00, IA32_PM_ENABLE, &Enable) && (Enable & HWP_PM_ENABLE)) {
+		pControl->Mode = HwpModeHwp;
+		pControl->Address = IA32_HWP_REQUEST;
+	}
+	else if (pFeatures->Eist) {
+		pControl->Mode = HwpModeLegacy;
+		pControl->Address = IA32_PERF_CTL;
+	}
+	else {
+		return FALSE;
+	}
+
+	// 2. Save every processor
+	pControl->Original = (PUINT64)calloc(uiCpuCount, sizeof(UINT64));
+	pControl->Modified = (PBOOL)calloc(uiCpuCount, sizeof(BOOL));
+	BOOL bSuccess = pControl->Original != NULL && pControl->Modified != NULL;
+	for (UINT32 Cpu = 0x00; bSuccess && Cpu < uiCpuCount; Cpu++)
+		bSuccess = MsrRead(pMsr, Cpu, pControl->Address, &pControl->Original[Cpu]);
+	if (!bSuccess) {
+		free(pControl->Original);
+		free(pControl->Modified);
+		RtlZeroMemory(pControl, sizeof(HWP_CONTROL));
+	}
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+VOID HwpClose(
+	_Inout_ PHWP_CONTROL pControl
+) {
+	if (pControl->Original == NULL)
+		return;
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++) {
+		if (pControl->Modified[Cpu])
+			(VOID)MsrWrite(pControl->Msr, Cpu, pControl->Address, pControl->Original[Cpu]);
+	}
+	free(pControl->Original);
+	free(pControl->Modified);
+	RtlZeroMemory(pControl, sizeof(HWP_CONTROL));
+}
+
+_Use_decl_annotations_
+BOOL HwpGetCapabilities(
+	_In_  PHWP_CONTROL      pControl,
+	_In_  UINT32            uiCpu,
+	_Out_ PHWP_CAPABILITIES pCapabilities
+) {
+	RtlZeroMemory(pCapabilities, sizeof(HWP_CAPABILITIES));
+	UINT64 Value = 0x00;
+	if (pControl->Mode == HwpModeHwp) {
+		if (!MsrRead(pControl->Msr, uiCpu, IA32_HWP_CAP_MSR, &Value))
+			return FALSE;
+		pCapabilities->Highest = (UINT8)Value;
+		pCapabilities->Guaranteed = (UINT8)(Value >> 8);
+		pCapabilities->Efficient = (UINT8)(Value >> 16);
+		pCapabilities->Lowest = (UINT8)(Value >> 24);
+		return TRUE;
+	}
+
+	// Legacy processors: the turbo ratio is optional, some models do not have the MSR
+	if (!MsrRead(pControl->Msr, uiCpu, MSR_PLATFORM_INFO, &Value))
+		return FALSE;
+	pCapabilities->Guaranteed = (UINT8)(Value >> 8);
+	pCapabilities->Efficient = (UINT8)(Value >> 40);
+	pCapabilities->Lowest = pCapabilities->Efficient;
+	pCapabilities->Highest = pCapabilities->Guaranteed;
+	if (pControl->Features.Turbo && MsrRead(pControl->Msr, uiCpu, MSR_TURBO_RATIO_LIMIT, &Value) && (UINT8)Value > pCapabilities->Highest)
+		pCapabilities->Highest = (UINT8)Value;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID HwpDecodeRequest(
+	_In_  UINT64       Value,
+	_Out_ PHWP_REQUEST pRequest
+) {
+	pRequest->Minimum = (UINT8)Value;
+	pRequest->Maximum = (UINT8)(Value >> 8);
+	pRequest->Desired = (UINT8)(Value >> 16);
+	pRequest->Epp = (UINT8)(Value >> 24);
+	pRequest->ActivityWindow = (UINT16)((Value >> HWP_REQUEST_ACTIVITY_SHIFT) & HWP_REQUEST_ACTIVITY_MASK);
+	pRequest->bPackageControl = (Value & HWP_REQUEST_PACKAGE) != 0x00;
+}
+
+_Use_decl_annotations_
+UINT64 HwpEncodeRequest(
+	_In_ const HWP_REQUEST* pRequest,
+	_In_ UINT64             Previous
+) {
+	UINT64 Value = Previous & ~HWP_REQUEST_KNOWN;
+	Value |= (UINT64)pRequest->Minimum;
+	Value |= (UINT64)pRequest->Maximum << 8;
+	Value |= (UINT64)pRequest->Desired << 16;
+	Value |= (UINT64)pRequest->Epp << 24;
+	Value |= (UINT64)(pRequest->ActivityWindow & HWP_REQUEST_ACTIVITY_MASK) << HWP_REQUEST_ACTIVITY_SHIFT;
+	if (pRequest->bPackageControl)
+		Value |= HWP_REQUEST_PACKAGE;
+	return Value;
+}
+
+_Use_decl_annotations_
+BOOL HwpGetRequest(
+	_In_  PHWP_CONTROL pControl,
+	_In_  UINT32       uiCpu,
+	_Out_ PHWP_REQUEST pRequest
+) {
+	RtlZeroMemory(pRequest, sizeof(HWP_REQUEST));
+	UINT64 Value = 0x00;
+	if (!MsrRead(pControl->Msr, uiCpu, pControl->Address, &Value))
+		return FALSE;
+	if (pControl->Mode == HwpModeHwp)
+		HwpDecodeRequest(Value, pRequest);
+	else
+		pRequest->Desired = (UINT8)((Value >> HWP_PERF_RATIO_SHIFT) & HWP_PERF_RATIO_MASK);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL HwpSetRequest(
+	_Inout_ PHWP_CONTROL       pControl,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_    UINT32             uiCpuCount,
+	_In_    const HWP_REQUEST* pRequest
+) {
+	for (UINT32 Index = 0x00; Index < uiCpuCount; Index++) {
+		UINT32 Cpu = pCpus[Index];
+		UINT64 Value = 0x00;
+		if (Cpu >= pControl->CpuCount || !MsrRead(pControl->Msr, Cpu, pControl->Address, &Value))
+			return FALSE;
+
+		// The fields the processor does not enumerate are written as zero, as the SDM requires
+		if (pControl->Mode == HwpModeHwp) {
+			HWP_REQUEST Request = *pRequest;
+			Request.Epp = pControl->Features.Epp ? Request.Epp : 0x00;
+			Request.ActivityWindow = pControl->Features.ActivityWindow ? Request.ActivityWindow : 0x00;
+			Request.bPackageControl = pControl->Features.PackageRequest && Request.bPackageControl;
+			Value = HwpEncodeRequest(&Request, Value);
+		}
+		else {
+			Value &= ~((UINT64)HWP_PERF_RATIO_MASK << HWP_PERF_RATIO_SHIFT);
+			Value |= (UINT64)pRequest->Desired << HWP_PERF_RATIO_SHIFT;
+		}
+		pControl->Modified[Cpu] = TRUE;
+		if (!MsrWrite(pControl->Msr, Cpu, pControl->Address, Value))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL HwpApplyPolicy(
+	_Inout_ PHWP_CONTROL      pControl,
+	_In_reads_(pControl->CpuCount) const HWP_CLASS* pClasses,
+	_In_    const HWP_POLICY* pPolicy
+) {
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++) {
+		if (pClasses[Cpu] == HwpClassUnmanaged)
+			continue;
+
+		// 1. Levels of the processor itself, they differ between the cores of hybrid processors
+		HWP_CAPABILITIES Capabilities = { 0x00 };
+		HWP_REQUEST Request = { 0x00 };
+		if (!HwpGetCapabilities(pControl, Cpu, &Capabilities) || !HwpGetRequest(pControl, Cpu, &Request))
+			return FALSE;
+
+		// 2. Legacy processors cannot float by themselves, the OS governor keeps the batch processors
+		if (pControl->Mode == HwpModeLegacy) {
+			if (pClasses[Cpu] == HwpClassBatch)
+				continue;
+			Request.Desired = Capabilities.Highest;
+		}
+		else if (pClasses[Cpu] == HwpClassLatency) {
+			Request.Minimum = Capabilities.Guaranteed;
+			Request.Maximum = Capabilities.Highest;
+			Request.Desired = Capabilities.Highest;
+			Request.Epp = pPolicy->LatencyEpp;
+		}
+		else {
+			Request.Minimum = Capabilities.Lowest;
+			Request.Maximum = Capabilities.Highest;
+			Request.Desired = 0x00;
+			Request.Epp = pPolicy->BatchEpp;
+		}
+		Request.bPackageControl = FALSE;
+		if (!HwpSetRequest(pControl, &Cpu, 0x01, &Request))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL HwpSample(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_Out_ PHWP_SAMPLE  pSample
+) {
+	RtlZeroMemory(pSample, sizeof(HWP_SAMPLE));
+
+	// One batch, so that every counter covers the same interval
+	static const UINT32 Msrs[] = { IA32_TSC_MSR, IA32_MPERF, IA32_APERF };
+	UINT64 Values[ARRAYSIZE(Msrs)] = { 0x00 };
+	pSample->Time = ThreadGetTime();
+	if (!MsrReadBatch(pMsr, uiCpu, Msrs, (UINT32)ARRAYSIZE(Msrs), Values))
+		return FALSE;
+	pSample->Tsc = Values[0];
+	pSample->Mperf = Values[1];
+	pSample->Aperf = Values[2];
+	pSample->bValid = TRUE;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID HwpComputeFrequency(
+	_In_  const HWP_SAMPLE* pStart,
+	_In_  const HWP_SAMPLE* pEnd,
+	_Out_ PHWP_FREQUENCY    pFrequency
+) {
+	RtlZeroMemory(pFrequency, sizeof(HWP_FREQUENCY));
+	if (!pStart->bValid || !pEnd->bValid || pEnd->Time <= pStart->Time || pEnd->Tsc <= pStart->Tsc || pEnd->Mperf <= pStart->Mperf)
+		return;
+
+	// MPERF counts at the TSC rate in C0 only, APERF at the actual clock in C0 only
+	double Tsc = (double)(pEnd->Tsc - pStart->Tsc);
+	double Mperf = (double)(pEnd->Mperf - pStart->Mperf);
+	double Aperf = (double)(pEnd->Aperf - pStart->Aperf);
+	pFrequency->TscMhz = Tsc * 1000.0 / (double)(pEnd->Time - pStart->Time);
+	pFrequency->Busy = 100.0 * Mperf / Tsc;
+	pFrequency->ActiveMhz = pFrequency->TscMhz * Aperf / Mperf;
+	pFrequency->AverageMhz = pFrequency->TscMhz * Aperf / Tsc;
+	pFrequency->bValid = TRUE;
+}
+
+_Use_decl_annotations_
+BOOL HwpObserve(
+	_In_  PHWP_CONTROL   pControl,
+	_In_  UINT32         uiMilliseconds,
+	_Out_writes_(pControl->CpuCount) PHWP_FREQUENCY pFrequencies
+) {
+	RtlZeroMemory(pFrequencies, sizeof(HWP_FREQUENCY) * pControl->CpuCount);
+	PHWP_SAMPLE pSamples = (PHWP_SAMPLE)calloc(pControl->CpuCount, sizeof(HWP_SAMPLE));
+	if (pSamples == NULL)
+		return FALSE;
+
+	// Sampling every processor is longer than the interval on large machines, but the same for both passes
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++)
+		(VOID)HwpSample(pControl->Msr, Cpu, &pSamples[Cpu]);
+	ThreadSleep(uiMilliseconds);
+
+	BOOL bObserved = FALSE;
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++) {
+		HWP_SAMPLE End = { 0x00 };
+		(VOID)HwpSample(pControl->Msr, Cpu, &End);
+		HwpComputeFrequency(&pSamples[Cpu], &End, &pFrequencies[Cpu]);
+		bObserved = bObserved || pFrequencies[Cpu].bValid;
+	}
+	free(pSamples);
+	return bObserved;
+}
@@ -0,0 +1,306 @@
+/// @file    hwp.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __HWP_H_GUARD__
+#define __HWP_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+#include "msr.h"
+
+/// Bits of CPUID.06H:EAX
+#define HWP_CPUID_TURBO           0x00000002
+#define HWP_CPUID_HWP             0x00000080
+#define HWP_CPUID_NOTIFICATION    0x00000100
+#define HWP_CPUID_ACTIVITY_WINDOW 0x00000200
+#define HWP_CPUID_EPP             0x00000400
+#define HWP_CPUID_PACKAGE_REQUEST 0x00000800
+
+/// Bits of CPUID.06H:ECX
+#define HWP_CPUID_APERF_MPERF     0x00000001
+
+/// Model specific MSRs giving the ratios of the legacy performance states
+#define MSR_PLATFORM_INFO     0x000000CE // Intel, maximum non-turbo ratio in [15:8], minimum ratio in [47:40].
+#define MSR_TURBO_RATIO_LIMIT 0x000001AD // Intel, single core turbo ratio in [7:0].
+
+/// Bit of IA32_PM_ENABLE
+#define HWP_PM_ENABLE 0x00000001
+
+/// Fields of IA32_HWP_REQUEST, the same for every performance level as in IA32_HWP_CAPABILITIES
+#define HWP_REQUEST_ACTIVITY_SHIFT 32
+#define HWP_REQUEST_ACTIVITY_MASK  0x3FF
+#define HWP_REQUEST_PACKAGE        0x0000040000000000 // Bit 42, follow IA32_HWP_REQUEST_PKG.
+#define HWP_REQUEST_KNOWN          0x000007FFFFFFFFFF // Bits 0 to 42.
+
+/// Field of IA32_PERF_CTL and IA32_PERF_STATUS
+#define HWP_PERF_RATIO_SHIFT 8
+#define HWP_PERF_RATIO_MASK  0xFF
+
+/// Energy-performance preferences, as named by the Linux intel_pstate driver
+#define HWP_EPP_PERFORMANCE         0x00
+#define HWP_EPP_BALANCE_PERFORMANCE 0x80
+#define HWP_EPP_BALANCE_POWER       0xC0
+#define HWP_EPP_POWER               0xFF
+
+/// Ratio of the legacy performance states to MHz, 100 MHz on every processor since Nehalem
+#define HWP_BUS_CLOCK_MHZ 100
+
+/// <summary>
+/// Power management features of the processor (CPUID.06H and CPUID.01H).
+/// </summary>
+typedef struct _HWP_FEATURES {
+	BOOL Hwp;              // CPUID.06H:EAX[7]
+	BOOL Epp;              // CPUID.06H:EAX[10], else the EPP field is ignored.
+	BOOL ActivityWindow;   // CPUID.06H:EAX[9]
+	BOOL PackageRequest;   // CPUID.06H:EAX[11]
+	BOOL Turbo;            // CPUID.06H:EAX[1]
+	BOOL AperfMperf;       // CPUID.06H:ECX[0]
+	BOOL Eist;             // CPUID.01H:ECX[7], IA32_PERF_CTL is available.
+} HWP_FEATURES, * PHWP_FEATURES;
+
+/// <summary>
+/// How the performance of the processors is controlled.
+/// </summary>
+typedef enum _HWP_MODE {
+	HwpModeNone   = 0x00,
+	HwpModeLegacy = 0x01, // IA32_PERF_CTL, the OS picks the performance state.
+	HwpModeHwp    = 0x02  // IA32_HWP_REQUEST, the processor picks within the limits of the OS.
+} HWP_MODE;
+
+/// <summary>
+/// Performance levels of a processor. Legacy processors have no such MSR, the levels are read from
+/// MSR_PLATFORM_INFO and MSR_TURBO_RATIO_LIMIT instead, as ratios of HWP_BUS_CLOCK_MHZ.
+/// </summary>
+typedef struct _HWP_CAPABILITIES {
+	UINT8 Highest;      // Turbo included, not sustainable on every core.
+	UINT8 Guaranteed;   // Sustainable, may change with the TDP.
+	UINT8 Efficient;    // Best performance per watt.
+	UINT8 Lowest;
+} HWP_CAPABILITIES, * PHWP_CAPABILITIES;
+
+/// <summary>
+/// Performance request of a processor. In legacy mode only Desired is used, as the target ratio.
+/// </summary>
+typedef struct _HWP_REQUEST {
+	UINT8  Minimum;
+	UINT8  Maximum;
+	UINT8  Desired;          // 0 lets the processor pick between Minimum and Maximum.
+	UINT8  Epp;              // HWP_EPP_*, or anything between 0 (performance) and 255 (energy).
+	UINT16 ActivityWindow;   // Raw 10-bit field, 0 lets the processor pick.
+	BOOL   bPackageControl;  // Follow the package request rather than this one.
+} HWP_REQUEST, * PHWP_REQUEST;
+
+/// <summary>
+/// Performance control of the processors and the settings found when opened.
+/// </summary>
+typedef struct _HWP_CONTROL {
+	PMSR_BACKEND Msr;
+	HWP_FEATURES Features;
+	HWP_MODE     Mode;
+	UINT32       Address;    // IA32_HWP_REQUEST or IA32_PERF_CTL.
+	UINT32       CpuCount;
+	PUINT64      Original;   // Value of the MSR of every processor when opened.
+	PBOOL        Modified;
+} HWP_CONTROL, * PHWP_CONTROL;
+
+/// <summary>
+/// Role of a processor in a policy.
+/// </summary>
+typedef enum _HWP_CLASS {
+	HwpClassUnmanaged = 0x00, // Left as found.
+	HwpClassLatency   = 0x01, // Held at high performance so that requests never wait for the clock to ramp up.
+	HwpClassBatch     = 0x02  // Free to float over the whole range, leaving power headroom to the others.
+} HWP_CLASS;
+
+/// <summary>
+/// Energy-performance preferences of a policy.
+/// </summary>
+typedef struct _HWP_POLICY {
+	UINT8 LatencyEpp;
+	UINT8 BatchEpp;
+} HWP_POLICY, * PHWP_POLICY;
+
+/// <summary>
+/// Counters read at once on a processor.
+/// </summary>
+typedef struct _HWP_SAMPLE {
+	BOOL   bValid;
+	UINT64 Time;    // ThreadGetTime when read.
+	UINT64 Tsc;
+	UINT64 Mperf;
+	UINT64 Aperf;
+} HWP_SAMPLE, * PHWP_SAMPLE;
+
+/// <summary>
+/// Frequency of a processor observed between two samples.
+/// </summary>
+typedef struct _HWP_FREQUENCY {
+	BOOL   bValid;
+	double Busy;          // Share of the time spent in C0, in percent.
+	double TscMhz;        // Rate of the TSC, the reference of MPERF.
+	double ActiveMhz;     // Average frequency while in C0.
+	double AverageMhz;    // Average frequency over the whole interval, idle time included.
+} HWP_FREQUENCY, * PHWP_FREQUENCY;
+
+/// <summary>
+/// Enumerate the power management features.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pFeatures">Pointer to the structure receiving the features.</param>
+/// <returns>Whether the performance can be controlled, through HWP or IA32_PERF_CTL.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpQuery(
+	_In_  PCPUID_BACKEND pBackend,
+	_Out_ PHWP_FEATURES  pFeatures
+);
+
+/// <summary>
+/// Select the control used by the OS and save the request of every processor. HWP is only used when
+/// the OS enabled it, as enabling it cannot be undone before the next reset.
+/// </summary>
+/// <param name="pControl">Pointer to the structure to initialise.</param>
+/// <param name="pMsr">Pointer to an opened MSR backend.</param>
+/// <param name="pFeatures">Pointer to the features returned by HwpQuery.</param>
+/// <param name="uiCpuCount">Number of processors.</param>
+/// <returns>Whether the request of every processor has been saved.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpOpen(
+	_Out_ PHWP_CONTROL        pControl,
+	_In_  PMSR_BACKEND        pMsr,
+	_In_  const HWP_FEATURES* pFeatures,
+	_In_  UINT32              uiCpuCount
+);
+
+/// <summary>
+/// Restore the request of every processor modified and release the control.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+VOID HwpClose(
+	_Inout_ PHWP_CONTROL pControl
+);
+
+/// <summary>
+/// Get the performance levels of a processor.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="pCapabilities">Pointer receiving the levels.</param>
+/// <returns>Whether the levels have been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpGetCapabilities(
+	_In_  PHWP_CONTROL      pControl,
+	_In_  UINT32            uiCpu,
+	_Out_ PHWP_CAPABILITIES pCapabilities
+);
+
+/// <summary>
+/// Get the request of a processor.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="pRequest">Pointer receiving the request.</param>
+/// <returns>Whether the request has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpGetRequest(
+	_In_  PHWP_CONTROL pControl,
+	_In_  UINT32       uiCpu,
+	_Out_ PHWP_REQUEST pRequest
+);
+
+/// <summary>
+/// Set the request of a set of processors, leaving the reserved bits of the MSR untouched.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="pCpus">Indices of the processors.</param>
+/// <param name="uiCpuCount">Number of processors.</param>
+/// <param name="pRequest">Pointer to the request.</param>
+/// <returns>Whether every processor has been configured.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpSetRequest(
+	_Inout_ PHWP_CONTROL       pControl,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_    UINT32             uiCpuCount,
+	_In_    const HWP_REQUEST* pRequest
+);
+
+/// <summary>
+/// Decode the value of IA32_HWP_REQUEST.
+/// </summary>
+/// <param name="Value">Value of the MSR.</param>
+/// <param name="pRequest">Pointer receiving the request.</param>
+VOID HwpDecodeRequest(
+	_In_  UINT64       Value,
+	_Out_ PHWP_REQUEST pRequest
+);
+
+/// <summary>
+/// Encode a request into IA32_HWP_REQUEST.
+/// </summary>
+/// <param name="pRequest">Pointer to the request.</param>
+/// <param name="Previous">Previous value of the MSR, whose reserved bits are kept.</param>
+/// <returns>Value of the MSR.</returns>
+UINT64 HwpEncodeRequest(
+	_In_ const HWP_REQUEST* pRequest,
+	_In_ UINT64             Previous
+);
+
+/// <summary>
+/// Apply a policy: latency processors are kept between the guaranteed and the highest level with a
+/// desired level at the highest, batch processors may go anywhere from the lowest to the highest level
+/// and let the processor decide. Legacy processors only pin the ratio of the latency processors.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="pClasses">Class of every processor of the control.</param>
+/// <param name="pPolicy">Energy-performance preferences, ignored without HWP EPP.</param>
+/// <returns>Whether every managed processor has been configured.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpApplyPolicy(
+	_Inout_ PHWP_CONTROL      pControl,
+	_In_reads_(pControl->CpuCount) const HWP_CLASS* pClasses,
+	_In_    const HWP_POLICY* pPolicy
+);
+
+/// <summary>
+/// Read the TSC, MPERF and APERF of a processor.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend.</param>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="pSample">Pointer receiving the counters.</param>
+/// <returns>Whether every counter has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpSample(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_Out_ PHWP_SAMPLE  pSample
+);
+
+/// <summary>
+/// Compute the frequency observed between two samples of a processor.
+/// </summary>
+/// <param name="pStart">Pointer to the first sample.</param>
+/// <param name="pEnd">Pointer to the second sample.</param>
+/// <param name="pFrequency">Pointer receiving the frequency.</param>
+VOID HwpComputeFrequency(
+	_In_  const HWP_SAMPLE* pStart,
+	_In_  const HWP_SAMPLE* pEnd,
+	_Out_ PHWP_FREQUENCY    pFrequency
+);
+
+/// <summary>
+/// Observe the frequency of every processor of the control over an interval.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="uiMilliseconds">Length of the interval.</param>
+/// <param name="pFrequencies">Array receiving the frequency of every processor.</param>
+/// <returns>Whether at least one processor has been observed.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HwpObserve(
+	_In_  PHWP_CONTROL   pControl,
+	_In_  UINT32         uiMilliseconds,
+	_Out_writes_(pControl->CpuCount) PHWP_FREQUENCY pFrequencies
+);
+
+#endif // !__HWP_H_GUARD__
@@ -0,0 +1,355 @@
+/// @file    hybrid.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hybrid.h"
+#include "atomic.h"
+
+/// <summary>
+/// Topology of this machine, built once per process.
+/// </summary>
+static HYBRID_TOPOLOGY g_HybridTopology = { 0x00 };
+static volatile INT32 g_HybridState = 0x00; // 0: not built, 1: being built, 2: built.
+
+/// <summary>
+/// Count the processors of each core type.
+/// </summary>
+static VOID HybridCount(
+	_Inout_ PHYBRID_TOPOLOGY pTopology
+) {
+	pTopology->PerformanceCount = 0x00;
+	pTopology->EfficiencyCount = 0x00;
+	for (UINT32 Index = 0x00; Index < pTopology->CpuCount; Index++) {
+		if (pTopology->Cpus[Index].CoreType == HYBRID_CORE_TYPE_CORE)
+			pTopology->PerformanceCount++;
+		else if (pTopology->Cpus[Index].CoreType == HYBRID_CORE_TYPE_ATOM)
+			pTopology->EfficiencyCount++;
+	}
+}
+
+_Use_decl_annotations_
+BOOL HybridBuild(
+	_In_  PCPUID_BACKEND   pBackend,
+	_Out_ PHYBRID_TOPOLOGY pTopology
+) {
+	if (pBackend == NULL || pTopology == NULL)
+		return FALSE;
+	RtlZeroMemory(pTopology, sizeof(HYBRID_TOPOLOGY));
+	if (pBackend->CpuCount == 0x00)
+		return FALSE;
+
+	pTopology->Cpus = (PHYBRID_CPU)calloc(pBackend->CpuCount, sizeof(HYBRID_CPU));
+	if (pTopology->Cpus == NULL)
+		return FALSE;
+	pTopology->CpuCount = pBackend->CpuCount;
+
+	// 1. Check the hybrid flag. Leaf 0x1A is only meaningful when it is set.
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers) || Registers[0] < CPUID_LEAF_HYBRID_INFORMATION)
+		return TRUE;
+	StructuredExtendedFeatureEdx Features = { 0x00 };
+	if (CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_FEATURES, 0x00, Registers))
+		Features.value = Registers[3];
+	pTopology->Hybrid = Features.elem.Hybrid;
+	if (!pTopology->Hybrid)
+		return TRUE;
+
+	// 2. The core type is a property of the core, hence leaf 0x1A has to run on every processor
+	for (UINT32 Index = 0x00; Index < pTopology->CpuCount; Index++) {
+		if (!CpuidBackendQuery(pBackend, Index, CPUID_LEAF_HYBRID_INFORMATION, 0x00, Registers))
+			continue;
+		HybridInformationEax Information = { .value = Registers[0] };
+		pTopology->Cpus[Index].CoreType = (UINT8)Information.elem.CoreType;
+		pTopology->Cpus[Index].NativeModel = Information.elem.NativeModelId;
+	}
+	HybridCount(pTopology);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID HybridFree(
+	_Inout_ PHYBRID_TOPOLOGY pTopology
+) {
+	if (pTopology == NULL)
+		return;
+	free(pTopology->Cpus);
+	RtlZeroMemory(pTopology, sizeof(HYBRID_TOPOLOGY));
+}
+
+/// <summary>
+/// Get an identifier that changes on every boot.
+/// </summary>
+static BOOL HybridGetBootId(
+	_Out_writes_(40) PCHAR szBootId
+) {
+	RtlZeroMemory(szBootId, 40);
+#if defined(_WIN32)
+	// The boot time is rounded to 16 seconds to absorb the jitter between both clocks. A mismatch
+	// only costs a new sweep.
+	FILETIME Now = { 0x00 };
+	GetSystemTimeAsFileTime(&Now);
+	UINT64 uiNow = ((UINT64)Now.dwHighDateTime << 32) | Now.dwLowDateTime;
+	UINT64 uiBoot = (uiNow - GetTickCount64() * 10000) / 10000000;
+	snprintf(szBootId, 40, "%llx", (unsigned long long)(uiBoot >> 4));
+	return TRUE;
+#else
+	FILE* pFile = fopen("/proc/sys/kernel/random/boot_id", "r");
+	if (pFile == NULL)
+		return FALSE;
+	BOOL bSuccess = fgets(szBootId, 40, pFile) != NULL;
+	fclose(pFile);
+	szBootId[strcspn(szBootId, "\n")] = 0x00;
+	return bSuccess && szBootId[0] != 0x00;
+#endif
+}
+
+/// <summary>
+/// Get the path of the cache file. The temporary directory of Windows and XDG_RUNTIME_DIR are private to the
+/// user, the fallback in /tmp is not and its file is only trusted if it belongs to the user.
+/// </summary>
+static BOOL HybridGetCachePath(
+	_Out_writes_(uiSize) PCHAR szPath,
+	_In_  UINT32 uiSize
+) {
+#if defined(_WIN32)
+	CHAR szDirectory[MAX_PATH] = { 0x00 };
+	DWORD dwLength = GetTempPathA(MAX_PATH, szDirectory);
+	if (dwLength == 0x00 || dwLength >= MAX_PATH)
+		return FALSE;
+	return snprintf(szPath, uiSize, "%sost-hybrid.cache", szDirectory) < (INT)uiSize;
+#else
+	LPCSTR szDirectory = getenv("XDG_RUNTIME_DIR");
+	if (szDirectory != NULL && szDirectory[0] != 0x00)
+		return snprintf(szPath, uiSize, "%s/ost-hybrid.cache", szDirectory) < (INT)uiSize;
+	return snprintf(szPath, uiSize, "/tmp/ost-hybrid-%u.cache", (UINT32)getuid()) < (INT)uiSize;
+#endif
+}
+
+/// <summary>
+/// Load the topology swept earlier during this boot.
+/// </summary>
+static BOOL HybridLoadCache(
+	_In_  LPCSTR           szPath,
+	_In_  LPCSTR           szBootId,
+	_Out_ PHYBRID_TOPOLOGY pTopology
+) {
+	RtlZeroMemory(pTopology, sizeof(HYBRID_TOPOLOGY));
+#if defined(_WIN32)
+	FILE* pFile = fopen(szPath, "rb");
+#else
+	// Anyone can create the file in /tmp: only a regular file of the user, that nobody else can write, is read
+	FILE* pFile = NULL;
+	struct stat Status = { 0x00 };
+	int Descriptor = open(szPath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (Descriptor >= 0) {
+		if (fstat(Descriptor, &Status) == 0x00 && S_ISREG(Status.st_mode) && Status.st_uid == getuid()
+			&& (Status.st_mode & (S_IWGRP | S_IWOTH)) == 0x00)
+			pFile = fdopen(Descriptor, "rb");
+		if (pFile == NULL)
+			close(Descriptor);
+	}
+#endif
+	if (pFile == NULL)
+		return FALSE;
+
+	// 1. Check the header. Processors brought online since the sweep invalidate the cache.
+	HYBRID_CACHE_HEADER Header = { 0x00 };
+	BOOL bSuccess = fread(&Header, sizeof(Header), 0x01, pFile) == 0x01
+		&& Header.Magic == HYBRID_CACHE_MAGIC
+		&& Header.Version == HYBRID_CACHE_VERSION
+		&& Header.EntrySize == sizeof(HYBRID_CPU)
+		&& strncmp(Header.BootId, szBootId, sizeof(Header.BootId)) == 0x00
+		&& Header.CpuCount == ThreadGetCpuCount();
+
+	// 2. Read the entries
+	if (bSuccess) {
+		pTopology->Cpus = (PHYBRID_CPU)calloc(Header.CpuCount, sizeof(HYBRID_CPU));
+		bSuccess = pTopology->Cpus != NULL
+			&& fread(pTopology->Cpus, sizeof(HYBRID_CPU), Header.CpuCount, pFile) == Header.CpuCount;
+	}
+	fclose(pFile);
+	if (!bSuccess) {
+		HybridFree(pTopology);
+		return FALSE;
+	}
+
+	pTopology->Hybrid = Header.Hybrid != 0x00;
+	pTopology->CpuCount = Header.CpuCount;
+	HybridCount(pTopology);
+	return TRUE;
+}
+
+/// <summary>
+/// Save the topology. The file is written aside and renamed so that readers never see a partial one. On
+/// Linux, the temporary file is created by mkstemp, readable by the user only and never through a link.
+/// </summary>
+static VOID HybridSaveCache(
+	_In_ LPCSTR                 szPath,
+	_In_reads_(40) LPCSTR       szBootId,
+	_In_ const HYBRID_TOPOLOGY* pTopology
+) {
+	CHAR szTemporary[MAX_PATH + 16] = { 0x00 };
+#if defined(_WIN32)
+	snprintf(szTemporary, sizeof(szTemporary), "%s.%lu", szPath, GetCurrentProcessId());
+#else
+	snprintf(szTemporary, sizeof(szTemporary), "%s.XXXXXX", szPath);
+#endif
+
+	// 1. Write the header and the entries
+	HYBRID_CACHE_HEADER Header = { 0x00 };
+	Header.Magic = HYBRID_CACHE_MAGIC;
+	Header.Version = HYBRID_CACHE_VERSION;
+	Header.EntrySize = sizeof(HYBRID_CPU);
+	RtlCopyMemory(Header.BootId, szBootId, sizeof(Header.BootId));
+	Header.CpuCount = pTopology->CpuCount;
+	Header.Hybrid = pTopology->Hybrid;
+
+#if defined(_WIN32)
+	FILE* pFile = fopen(szTemporary, "wb");
+#else
+	FILE* pFile = NULL;
+	int Descriptor = mkstemp(szTemporary);
+	if (Descriptor < 0)
+		return;
+	pFile = fdopen(Descriptor, "wb");
+	if (pFile == NULL) {
+		close(Descriptor);
+		remove(szTemporary);
+	}
+#endif
+	if (pFile == NULL)
+		return;
+	BOOL bSuccess = fwrite(&Header, sizeof(Header), 0x01, pFile) == 0x01
+		&& fwrite(pTopology->Cpus, sizeof(HYBRID_CPU), pTopology->CpuCount, pFile) == pTopology->CpuCount;
+	bSuccess = fclose(pFile) == 0x00 && bSuccess;
+
+	// 2. Replace the previous cache
+#if defined(_WIN32)
+	bSuccess = bSuccess && MoveFileExA(szTemporary, szPath, MOVEFILE_REPLACE_EXISTING);
+#else
+	bSuccess = bSuccess && rename(szTemporary, szPath) == 0x00;
+#endif
+	if (!bSuccess)
+		remove(szTemporary);
+}
+
+const HYBRID_TOPOLOGY* HybridGetTopology() {
+	// 1. Only the first caller builds the topology, the others wait for it
+	if (AtomicLoad32(&g_HybridState) == 0x02)
+		return g_HybridTopology.Cpus != NULL ? &g_HybridTopology : NULL;
+	if (!AtomicCompareExchange32(&g_HybridState, 0x00, 0x01)) {
+		while (AtomicLoad32(&g_HybridState) != 0x02)
+			AtomicPause();
+		return g_HybridTopology.Cpus != NULL ? &g_HybridTopology : NULL;
+	}
+
+	// 2. Use the sweep of this boot if there is one
+	CHAR szBootId[40] = { 0x00 };
+	CHAR szPath[MAX_PATH] = { 0x00 };
+	BOOL bCache = HybridGetBootId(szBootId) && HybridGetCachePath(szPath, sizeof(szPath));
+	if (!bCache || !HybridLoadCache(szPath, szBootId, &g_HybridTopology)) {
+
+		// 3. Otherwise sweep the processors and save the result
+		CPUID_BACKEND Backend = { 0x00 };
+		if (CpuidOpen(&Backend)) {
+			if (HybridBuild(&Backend, &g_HybridTopology) && bCache)
+				HybridSaveCache(szPath, szBootId, &g_HybridTopology);
+			CpuidClose(&Backend);
+		}
+	}
+
+	AtomicStore32(&g_HybridState, 0x02);
+	return g_HybridTopology.Cpus != NULL ? &g_HybridTopology : NULL;
+}
+
+_Use_decl_annotations_
+UINT32 HybridGetCpus(
+	_In_  const HYBRID_TOPOLOGY* pTopology,
+	_In_  UINT32                 uiPlacement,
+	_Out_writes_opt_(uiMaximum) PUINT32 pCpus,
+	_In_  UINT32                 uiMaximum
+) {
+	if (pTopology == NULL)
+		return 0x00;
+
+	// 1. Select the core type. Without cores of that type, fall back to all the processors.
+	UINT8 uiCoreType = uiPlacement == HYBRID_PLACE_EFFICIENCY ? HYBRID_CORE_TYPE_ATOM : HYBRID_CORE_TYPE_CORE;
+	UINT32 uiTypeCount = uiCoreType == HYBRID_CORE_TYPE_ATOM ? pTopology->EfficiencyCount : pTopology->PerformanceCount;
+	BOOL bAll = uiTypeCount == 0x00;
+
+	// 2. Collect the processors
+	UINT32 uiCount = 0x00;
+	for (UINT32 Index = 0x00; Index < pTopology->CpuCount; Index++) {
+		if (!bAll && pTopology->Cpus[Index].CoreType != uiCoreType)
+			continue;
+		if (pCpus != NULL && uiCount < uiMaximum)
+			pCpus[uiCount] = Index;
+		uiCount++;
+	}
+	return uiCount;
+}
+
+_Use_decl_annotations_
+BOOL HybridPlace(
+	_In_      const HYBRID_TOPOLOGY* pTopology,
+	_In_      UINT32                 uiPlacement,
+	_Out_opt_ PTHREAD_AFFINITY       pPrevious
+) {
+	if (pTopology == NULL)
+		return FALSE;
+	PUINT32 pCpus = (PUINT32)calloc(pTopology->CpuCount, sizeof(UINT32));
+	if (pCpus == NULL)
+		return FALSE;
+
+	UINT32 uiCount = HybridGetCpus(pTopology, uiPlacement, pCpus, pTopology->CpuCount);
+	BOOL bSuccess = ThreadSetAffinity(pCpus, uiCount, pPrevious);
+	free(pCpus);
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+BOOL HybridPlaceWorker(
+	_In_      const HYBRID_TOPOLOGY* pTopology,
+	_In_      UINT32                 uiPlacement,
+	_In_      UINT32                 uiWorker,
+	_Out_opt_ PTHREAD_AFFINITY       pPrevious
+) {
+	if (pTopology == NULL)
+		return FALSE;
+	PUINT32 pCpus = (PUINT32)calloc(pTopology->CpuCount, sizeof(UINT32));
+	if (pCpus == NULL)
+		return FALSE;
+
+	UINT32 uiCount = HybridGetCpus(pTopology, uiPlacement, pCpus, pTopology->CpuCount);
+	BOOL bSuccess = uiCount != 0x00 && ThreadPin(pCpus[uiWorker % uiCount], pPrevious);
+	free(pCpus);
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+LPCSTR HybridGetCoreTypeName(
+	_In_ UINT8 uiCoreType
+) {
+	switch (uiCoreType) {
+	case HYBRID_CORE_TYPE_ATOM:
+		return "efficiency";
+	case HYBRID_CORE_TYPE_CORE:
+		return "performance";
+	default:
+		return "unknown";
+	}
+}
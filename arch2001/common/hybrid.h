@@ -0,0 +1,145 @@
+/// @file    hybrid.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __HYBRID_H_GUARD__
+#define __HYBRID_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+#include "thread.h"
+
+/// Core types reported by CPUID leaf 0x1A
+#define HYBRID_CORE_TYPE_UNKNOWN 0x00
+#define HYBRID_CORE_TYPE_ATOM    0x20 // Efficiency core
+#define HYBRID_CORE_TYPE_CORE    0x40 // Performance core
+
+/// Where to place a thread
+#define HYBRID_PLACE_PERFORMANCE 0x00 // Latency-critical work.
+#define HYBRID_PLACE_EFFICIENCY  0x01 // Batch work.
+
+/// Identification of the boot-time cache
+#define HYBRID_CACHE_MAGIC   0x52425948 // "HYBR"
+#define HYBRID_CACHE_VERSION 0x01
+
+/// <summary>
+/// Core type of a logical processor.
+/// </summary>
+typedef struct _HYBRID_CPU {
+	UINT8  CoreType;    // HYBRID_CORE_TYPE_*
+	UINT8  Reserved[3];
+	UINT32 NativeModel; // Native model ID of the core.
+} HYBRID_CPU, * PHYBRID_CPU;
+
+/// <summary>
+/// Core type of every logical processor. On a processor that is not hybrid all the processors are
+/// HYBRID_CORE_TYPE_UNKNOWN and both placements use all of them.
+/// </summary>
+typedef struct _HYBRID_TOPOLOGY {
+	BOOL        Hybrid;           // CPUID.07H:EDX[15]
+	UINT32      CpuCount;
+	UINT32      PerformanceCount;
+	UINT32      EfficiencyCount;
+	PHYBRID_CPU Cpus;
+} HYBRID_TOPOLOGY, * PHYBRID_TOPOLOGY;
+
+/// <summary>
+/// Header of the cache file, followed by CpuCount HYBRID_CPU entries.
+/// </summary>
+typedef struct _HYBRID_CACHE_HEADER {
+	UINT32 Magic;     // HYBRID_CACHE_MAGIC
+	UINT16 Version;   // HYBRID_CACHE_VERSION
+	UINT16 EntrySize; // sizeof(HYBRID_CPU)
+	CHAR   BootId[40];
+	UINT32 CpuCount;
+	UINT32 Hybrid;
+} HYBRID_CACHE_HEADER, * PHYBRID_CACHE_HEADER;
+
+C_ASSERT(sizeof(HYBRID_CPU) == 8);
+C_ASSERT(sizeof(HYBRID_CACHE_HEADER) == 56);
+
+/// <summary>
+/// Run leaf 0x1A on every processor described by a backend.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pTopology">Pointer to the topology to build. Released with HybridFree.</param>
+/// <returns>Whether the topology has been built.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HybridBuild(
+	_In_  PCPUID_BACKEND   pBackend,
+	_Out_ PHYBRID_TOPOLOGY pTopology
+);
+
+/// <summary>
+/// Release a topology built by HybridBuild.
+/// </summary>
+/// <param name="pTopology">Pointer to the topology.</param>
+VOID HybridFree(
+	_Inout_ PHYBRID_TOPOLOGY pTopology
+);
+
+/// <summary>
+/// Get the topology of this machine. The sweep runs once per boot: its result is kept in a cache file
+/// keyed by the boot identifier and in memory for the lifetime of the process.
+/// </summary>
+/// <returns>Pointer to the cached topology, or NULL if it cannot be built.</returns>
+const HYBRID_TOPOLOGY* HybridGetTopology();
+
+/// <summary>
+/// Get the processors used by a placement.
+/// </summary>
+/// <param name="pTopology">Pointer to the topology.</param>
+/// <param name="uiPlacement">HYBRID_PLACE_* value.</param>
+/// <param name="pCpus">Optional array receiving the processor indexes.</param>
+/// <param name="uiMaximum">Size of the array.</param>
+/// <returns>Number of processors used by the placement.</returns>
+UINT32 HybridGetCpus(
+	_In_  const HYBRID_TOPOLOGY* pTopology,
+	_In_  UINT32                 uiPlacement,
+	_Out_writes_opt_(uiMaximum) PUINT32 pCpus,
+	_In_  UINT32                 uiMaximum
+);
+
+/// <summary>
+/// Restrict the calling thread to the processors of a placement.
+/// </summary>
+/// <param name="pTopology">Pointer to the topology.</param>
+/// <param name="uiPlacement">HYBRID_PLACE_* value.</param>
+/// <param name="pPrevious">Optional pointer receiving the previous affinity.</param>
+/// <returns>Whether the affinity has been changed.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HybridPlace(
+	_In_      const HYBRID_TOPOLOGY* pTopology,
+	_In_      UINT32                 uiPlacement,
+	_Out_opt_ PTHREAD_AFFINITY       pPrevious
+);
+
+/// <summary>
+/// Pin a worker of a pool to one processor of a placement, spreading consecutive workers over
+/// consecutive processors.
+/// </summary>
+/// <param name="pTopology">Pointer to the topology.</param>
+/// <param name="uiPlacement">HYBRID_PLACE_* value.</param>
+/// <param name="uiWorker">Index of the worker.</param>
+/// <param name="pPrevious">Optional pointer receiving the previous affinity.</param>
+/// <returns>Whether the thread is now running on the processor.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HybridPlaceWorker(
+	_In_      const HYBRID_TOPOLOGY* pTopology,
+	_In_      UINT32                 uiPlacement,
+	_In_      UINT32                 uiWorker,
+	_Out_opt_ PTHREAD_AFFINITY       pPrevious
+);
+
+/// <summary>
+/// Get the name of a core type.
+/// </summary>
+/// <param name="uiCoreType">HYBRID_CORE_TYPE_* value.</param>
+/// <returns>Name of the core type.</returns>
+LPCSTR HybridGetCoreTypeName(
+	_In_ UINT8 uiCoreType
+);
+
+#endif // !__HYBRID_H_GUARD__
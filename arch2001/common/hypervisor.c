@@ -0,0 +1,297 @@
+/// @file    hypervisor.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "hypervisor.h"
+#include "intrinsics.h"
+
+/// Hyper-V interface signature "Hv#1", CPUID.(base+1):EAX
+#define HV_INTERFACE_SIGNATURE 0x31237648
+
+/// Executions of a probe between two reads of the TSC
+#define HYPERVISOR_PROFILE_BATCH 16
+
+/// Known signatures, in EBX, ECX and EDX order
+static const struct {
+	HYPERVISOR_VENDOR Vendor;
+	CHAR              Signature[13];
+} g_HypervisorSignatures[] = {
+	{ HypervisorVendorKvm,    "KVMKVMKVM\0\0\0" },
+	{ HypervisorVendorHyperV, "Microsoft Hv" },
+	{ HypervisorVendorXen,    "XenVMMXenVMM" }
+};
+
+/// <summary>
+/// Decode the KVM leaves.
+/// </summary>
+static VOID HypervisorDecodeKvm(
+	_In_    PCPUID_BACKEND              pBackend,
+	_In_    const HYPERVISOR_INTERFACE* pInterface,
+	_Inout_ PHYPERVISOR_INFORMATION     pInformation
+) {
+	UINT Registers[4] = { 0x00 };
+	if (pInterface->MaximumLeaf < pInterface->Base + HYPERVISOR_LEAF_FEATURES
+		|| !CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_FEATURES, 0x00, Registers))
+		return;
+	pInformation->KvmFeatures = Registers[0];
+	pInformation->KvmHints = Registers[3];
+	if (Registers[0] & (KVM_FEATURE_CLOCKSOURCE | KVM_FEATURE_CLOCKSOURCE2))
+		pInformation->Clocks |= HYPERVISOR_CLOCK_KVMCLOCK;
+	if (Registers[0] & KVM_FEATURE_CLOCKSOURCE_STABLE)
+		pInformation->Clocks |= HYPERVISOR_CLOCK_KVMCLOCK_STABLE;
+}
+
+/// <summary>
+/// Decode the Hyper-V leaves, which KVM and Xen may also expose for Windows guests.
+/// </summary>
+static VOID HypervisorDecodeHyperV(
+	_In_     PCPUID_BACKEND              pBackend,
+	_In_opt_ PMSR_BACKEND                pMsr,
+	_In_     const HYPERVISOR_INTERFACE* pInterface,
+	_Inout_  PHYPERVISOR_INFORMATION     pInformation
+) {
+	// 1. The other leaves only follow the specification if the interface is "Hv#1"
+	UINT Registers[4] = { 0x00 };
+	if (pInterface->MaximumLeaf < pInterface->Base + HYPERVISOR_LEAF_HV_FEATURES
+		|| !CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_FEATURES, 0x00, Registers)
+		|| Registers[0] != HV_INTERFACE_SIGNATURE)
+		return;
+
+	// 2. Version and privileges
+	if (CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_HV_VERSION, 0x00, Registers)) {
+		pInformation->HvBuild = Registers[0];
+		pInformation->HvMajor = (UINT16)(Registers[1] >> 16);
+		pInformation->HvMinor = (UINT16)(Registers[1] & 0xFFFF);
+	}
+	if (!CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_HV_FEATURES, 0x00, Registers))
+		return;
+	pInformation->HvPrivileges = Registers[0];
+	pInformation->HvFeatures = Registers[3];
+	if (Registers[0] & HV_ACCESS_REFERENCE_COUNTER)
+		pInformation->Clocks |= HYPERVISOR_CLOCK_HV_COUNTER;
+	if (Registers[0] & HV_ACCESS_REFERENCE_TSC)
+		pInformation->Clocks |= HYPERVISOR_CLOCK_HV_TSC_PAGE;
+	if (Registers[0] & HV_ACCESS_TSC_INVARIANT)
+		pInformation->Clocks |= HYPERVISOR_CLOCK_TSC_INVARIANT;
+
+	// 3. Frequencies, only readable from ring 0
+	UINT64 Frequency = 0x00;
+	if (pMsr != NULL && (Registers[0] & HV_ACCESS_FREQUENCY_MSRS)) {
+		if (pInformation->TscFrequency == 0x00 && MsrRead(pMsr, MSR_CURRENT_CPU, HV_X64_MSR_TSC_FREQUENCY, &Frequency))
+			pInformation->TscFrequency = Frequency;
+		if (pInformation->ApicFrequency == 0x00 && MsrRead(pMsr, MSR_CURRENT_CPU, HV_X64_MSR_APIC_FREQUENCY, &Frequency))
+			pInformation->ApicFrequency = Frequency;
+	}
+}
+
+/// <summary>
+/// Decode the Xen leaves.
+/// </summary>
+static VOID HypervisorDecodeXen(
+	_In_    PCPUID_BACKEND              pBackend,
+	_In_    const HYPERVISOR_INTERFACE* pInterface,
+	_Inout_ PHYPERVISOR_INFORMATION     pInformation
+) {
+	// The time information of every vCPU is always in the shared info page
+	UINT Registers[4] = { 0x00 };
+	pInformation->Clocks |= HYPERVISOR_CLOCK_XEN_PVCLOCK;
+	if (pInterface->MaximumLeaf >= pInterface->Base + HYPERVISOR_LEAF_FEATURES
+		&& CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_FEATURES, 0x00, Registers)) {
+		pInformation->XenMajor = (UINT16)(Registers[0] >> 16);
+		pInformation->XenMinor = (UINT16)(Registers[0] & 0xFFFF);
+	}
+	if (pInterface->MaximumLeaf >= pInterface->Base + HYPERVISOR_LEAF_XEN_TIME
+		&& CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_XEN_TIME, 0x00, Registers)) {
+		pInformation->XenTscFlags = Registers[0];
+		pInformation->XenTscMode = Registers[1];
+		if (pInformation->TscFrequency == 0x00)
+			pInformation->TscFrequency = (UINT64)Registers[2] * 1000;
+	}
+}
+
+_Use_decl_annotations_
+BOOL HypervisorQuery(
+	_In_opt_ PCPUID_BACKEND          pBackend,
+	_In_opt_ PMSR_BACKEND            pMsr,
+	_Out_    PHYPERVISOR_INFORMATION pInformation
+) {
+	RtlZeroMemory(pInformation, sizeof(HYPERVISOR_INFORMATION));
+
+	// 1. Open the local processor if no backend is given
+	CPUID_BACKEND Local = { 0x00 };
+	if (pBackend == NULL) {
+		if (!CpuidOpen(&Local))
+			return FALSE;
+		pBackend = &Local;
+	}
+
+	// 2. Hypervisor-present bit. Unknown leaves return the highest basic leaf on bare metal, so the ranges are
+	// only meaningful when it is set.
+	UINT Registers[4] = { 0x00 };
+	BOOL bSuccess = CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers);
+	if (bSuccess && Registers[0] >= CPUID_LEAF_BASIC_INFORMATION
+		&& CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_BASIC_INFORMATION, 0x00, Registers)) {
+		BasicInformationEcx Features = { .value = Registers[2] };
+		pInformation->bPresent = Features.elem.Hypervisor;
+	}
+
+	// 3. Every interface exposed
+	for (UINT32 Index = 0x00; pInformation->bPresent && Index < HYPERVISOR_MAX_INTERFACES; Index++) {
+		UINT32 Base = CPUID_LEAF_HYPERVISOR + Index * HYPERVISOR_LEAF_STRIDE;
+		if (!CpuidBackendQuery(pBackend, 0x00, Base, 0x00, Registers) || Registers[0] < Base || Registers[0] >= Base + HYPERVISOR_LEAF_STRIDE)
+			continue;
+
+		PHYPERVISOR_INTERFACE pInterface = &pInformation->Interfaces[pInformation->InterfaceCount++];
+		pInterface->Base = Base;
+		pInterface->MaximumLeaf = Registers[0];
+		pInterface->Vendor = HypervisorVendorUnknown;
+		RtlCopyMemory(&pInterface->Signature[0], &Registers[1], sizeof(UINT));
+		RtlCopyMemory(&pInterface->Signature[4], &Registers[2], sizeof(UINT));
+		RtlCopyMemory(&pInterface->Signature[8], &Registers[3], sizeof(UINT));
+		for (UINT32 Known = 0x00; Known < ARRAYSIZE(g_HypervisorSignatures); Known++) {
+			if (memcmp(pInterface->Signature, g_HypervisorSignatures[Known].Signature, 12) == 0x00)
+				pInterface->Vendor = g_HypervisorSignatures[Known].Vendor;
+		}
+		if (pInformation->Vendor == HypervisorVendorNone)
+			pInformation->Vendor = pInterface->Vendor;
+	}
+
+	// 4. Vendor specific leaves, the preferred interface first for the frequencies
+	for (UINT32 Index = 0x00; Index < pInformation->InterfaceCount; Index++) {
+		const HYPERVISOR_INTERFACE* pInterface = &pInformation->Interfaces[Index];
+		if (pInterface->MaximumLeaf >= pInterface->Base + HYPERVISOR_LEAF_TIMING
+			&& CpuidBackendQuery(pBackend, 0x00, pInterface->Base + HYPERVISOR_LEAF_TIMING, 0x00, Registers)) {
+			if (pInformation->TscFrequency == 0x00)
+				pInformation->TscFrequency = (UINT64)Registers[0] * 1000;
+			if (pInformation->ApicFrequency == 0x00)
+				pInformation->ApicFrequency = (UINT64)Registers[1] * 1000;
+		}
+		switch (pInterface->Vendor) {
+		case HypervisorVendorKvm:
+			HypervisorDecodeKvm(pBackend, pInterface, pInformation);
+			break;
+		case HypervisorVendorHyperV:
+			HypervisorDecodeHyperV(pBackend, pMsr, pInterface, pInformation);
+			break;
+		case HypervisorVendorXen:
+			HypervisorDecodeXen(pBackend, pInterface, pInformation);
+			break;
+		default:
+			break;
+		}
+	}
+
+	CpuidClose(&Local);
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+LPCSTR HypervisorGetVendorName(
+	_In_ HYPERVISOR_VENDOR Vendor
+) {
+	switch (Vendor) {
+	case HypervisorVendorNone:   return "none";
+	case HypervisorVendorKvm:    return "KVM";
+	case HypervisorVendorHyperV: return "Hyper-V";
+	case HypervisorVendorXen:    return "Xen";
+	default:                     return "unknown";
+	}
+}
+
+_Use_decl_annotations_
+LPCSTR HypervisorGetProbeName(
+	_In_ HYPERVISOR_PROBE Probe
+) {
+	switch (Probe) {
+	case HypervisorProbeBaseline: return "(measure overhead)";
+	case HypervisorProbeRdtsc:    return "RDTSC";
+	case HypervisorProbeRdtscp:   return "RDTSCP";
+	case HypervisorProbeCpuid:    return "CPUID";
+	case HypervisorProbeMsr:      return "RDMSR via backend";
+	default:                      return "unknown";
+	}
+}
+
+/// <summary>
+/// Time batches of a statement, in TSC ticks per execution.
+/// </summary>
+#define HYPERVISOR_MEASURE(pSamples, uiRuns, Statement) \
+	for (UINT32 _Run = 0x00; _Run < (uiRuns); _Run++) { \
+		UINT64 _Start = _read_tsc_fenced(); \
+		for (UINT32 _Index = 0x00; _Index < HYPERVISOR_PROFILE_BATCH; _Index++) { Statement; } \
+		(pSamples)[_Run] = (_read_tsc_fenced() - _Start) / HYPERVISOR_PROFILE_BATCH; \
+	}
+
+static INT HypervisorCompare(
+	_In_ const void* a,
+	_In_ const void* b
+) {
+	UINT64 Left = *(const UINT64*)a;
+	UINT64 Right = *(const UINT64*)b;
+	return Left < Right ? -1 : Left > Right ? 1 : 0;
+}
+
+/// <summary>
+/// Reduce the batches of a probe to its minimum and median.
+/// </summary>
+static VOID HypervisorSummarise(
+	_Inout_ PUINT64          pSamples,
+	_In_    UINT32           uiRuns,
+	_Out_   PHYPERVISOR_COST pCost
+) {
+	qsort(pSamples, uiRuns, sizeof(UINT64), HypervisorCompare);
+	pCost->bMeasured = TRUE;
+	pCost->Minimum = pSamples[0];
+	pCost->Median = pSamples[uiRuns / 2];
+}
+
+_Use_decl_annotations_
+VOID HypervisorProfile(
+	_In_opt_ PMSR_BACKEND        pMsr,
+	_In_     UINT32              uiRuns,
+	_Out_    PHYPERVISOR_PROFILE pProfile
+) {
+	RtlZeroMemory(pProfile, sizeof(HYPERVISOR_PROFILE));
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	pProfile->bVirtualised = Cpuid->BasicEcx.elem.Hypervisor;
+	if (uiRuns == 0x00)
+		uiRuns = HYPERVISOR_PROFILE_RUNS;
+	PUINT64 pSamples = (PUINT64)calloc(uiRuns, sizeof(UINT64));
+	if (pSamples == NULL)
+		return;
+
+	// 1. Instructions available to user mode
+	volatile UINT64 Sink = 0x00;
+	UINT Registers[4] = { 0x00 };
+	HYPERVISOR_MEASURE(pSamples, uiRuns, (VOID)0x00);
+	HypervisorSummarise(pSamples, uiRuns, &pProfile->Costs[HypervisorProbeBaseline]);
+	HYPERVISOR_MEASURE(pSamples, uiRuns, Sink = _read_tsc());
+	HypervisorSummarise(pSamples, uiRuns, &pProfile->Costs[HypervisorProbeRdtsc]);
+	if (Cpuid->ExtendedInfoEdx.elem.RDTSCP) {
+		HYPERVISOR_MEASURE(pSamples, uiRuns, Sink = _rdtscp_aux());
+		HypervisorSummarise(pSamples, uiRuns, &pProfile->Costs[HypervisorProbeRdtscp]);
+	}
+	HYPERVISOR_MEASURE(pSamples, uiRuns, _cpuid_query(CPUID_LEAF_VENDOR, 0x00, Registers));
+	HypervisorSummarise(pSamples, uiRuns, &pProfile->Costs[HypervisorProbeCpuid]);
+
+	// 2. RDMSR is privileged, so it is measured the way the tools issue it
+	UINT64 Value = 0x00;
+	if (pMsr != NULL && MsrRead(pMsr, MSR_CURRENT_CPU, IA32_MTRRCAP, &Value)) {
+		HYPERVISOR_MEASURE(pSamples, uiRuns, (VOID)MsrRead(pMsr, MSR_CURRENT_CPU, IA32_MTRRCAP, &Value));
+		HypervisorSummarise(pSamples, uiRuns, &pProfile->Costs[HypervisorProbeMsr]);
+	}
+	free(pSamples);
+	(VOID)Sink;
+
+	// 3. CPUID always exits, so anything in the same range does too. The OS round trip of the MSR probe
+	// hides the exit, but a guest kernel reading IA32_MTRRCAP is always intercepted.
+	UINT64 ExitCost = pProfile->Costs[HypervisorProbeCpuid].Median;
+	for (UINT32 Probe = HypervisorProbeRdtsc; pProfile->bVirtualised && Probe < HypervisorProbeCount; Probe++) {
+		PHYPERVISOR_COST pCost = &pProfile->Costs[Probe];
+		pCost->bExits = pCost->bMeasured && (Probe == HypervisorProbeCpuid || Probe == HypervisorProbeMsr || pCost->Median * 2 >= ExitCost);
+	}
+}
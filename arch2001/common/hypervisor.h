@@ -0,0 +1,186 @@
+/// @file    hypervisor.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __HYPERVISOR_H_GUARD__
+#define __HYPERVISOR_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+#include "msr.h"
+
+/// Hypervisors may expose several interfaces, e.g. Xen or KVM emulating Hyper-V, each at 0x40000000 + n * 0x100
+#define HYPERVISOR_LEAF_STRIDE    0x100
+#define HYPERVISOR_MAX_INTERFACES 16
+
+/// Default number of batches measured per probe by HypervisorProfile
+#define HYPERVISOR_PROFILE_RUNS 201
+
+/// Offsets of the leaves from the base of an interface
+#define HYPERVISOR_LEAF_FEATURES    0x01 // KVM features, Hyper-V interface signature, Xen version.
+#define HYPERVISOR_LEAF_HV_VERSION  0x02 // Hyper-V build and version.
+#define HYPERVISOR_LEAF_HV_FEATURES 0x03 // Hyper-V partition privileges and features.
+#define HYPERVISOR_LEAF_XEN_TIME    0x03 // Xen TSC mode and frequencies.
+#define HYPERVISOR_LEAF_TIMING      0x10 // TSC and APIC bus frequencies in kHz, KVM and VMware.
+
+/// Hyper-V synthetic MSRs giving the frequencies in Hz
+#define HV_X64_MSR_TSC_FREQUENCY  0x40000022
+#define HV_X64_MSR_APIC_FREQUENCY 0x40000023
+
+/// KVM features, CPUID.(base+1):EAX
+#define KVM_FEATURE_CLOCKSOURCE        0x00000001 // kvmclock at MSRs 0x11 and 0x12.
+#define KVM_FEATURE_CLOCKSOURCE2       0x00000008 // kvmclock at MSRs 0x4B564D00 and 0x4B564D01.
+#define KVM_FEATURE_ASYNC_PF           0x00000010
+#define KVM_FEATURE_STEAL_TIME         0x00000020
+#define KVM_FEATURE_PV_EOI             0x00000040
+#define KVM_FEATURE_PV_UNHALT          0x00000080
+#define KVM_FEATURE_PV_TLB_FLUSH       0x00000200
+#define KVM_FEATURE_PV_SEND_IPI        0x00000800
+#define KVM_FEATURE_POLL_CONTROL       0x00001000
+#define KVM_FEATURE_PV_SCHED_YIELD     0x00002000
+#define KVM_FEATURE_CLOCKSOURCE_STABLE 0x01000000 // kvmclock is the same on every vCPU.
+
+/// Hyper-V partition privileges, CPUID.(base+3):EAX
+#define HV_ACCESS_REFERENCE_COUNTER 0x00000002 // 100 ns partition reference counter MSR.
+#define HV_ACCESS_SYNTHETIC_TIMERS  0x00000008
+#define HV_ACCESS_HYPERCALL         0x00000020
+#define HV_ACCESS_REFERENCE_TSC     0x00000200 // Reference TSC page.
+#define HV_ACCESS_FREQUENCY_MSRS    0x00000800
+#define HV_ACCESS_TSC_INVARIANT     0x00008000
+
+/// Xen TSC flags, CPUID.(base+3,0):EAX
+#define XEN_TSC_EMULATED 0x00000001 // RDTSC exits to the hypervisor.
+#define XEN_TSC_RELIABLE 0x00000002
+#define XEN_TSC_RDTSCP   0x00000004
+
+/// Clock sources offered by the hypervisor
+#define HYPERVISOR_CLOCK_KVMCLOCK        0x00000001
+#define HYPERVISOR_CLOCK_KVMCLOCK_STABLE 0x00000002
+#define HYPERVISOR_CLOCK_HV_COUNTER      0x00000004
+#define HYPERVISOR_CLOCK_HV_TSC_PAGE     0x00000008
+#define HYPERVISOR_CLOCK_XEN_PVCLOCK     0x00000010
+#define HYPERVISOR_CLOCK_TSC_INVARIANT   0x00000020 // The hypervisor guarantees the TSC rate across migrations.
+
+/// <summary>
+/// Known hypervisors.
+/// </summary>
+typedef enum _HYPERVISOR_VENDOR {
+	HypervisorVendorNone    = 0x00,
+	HypervisorVendorUnknown = 0x01,
+	HypervisorVendorKvm     = 0x02, // "KVMKVMKVM\0\0\0"
+	HypervisorVendorHyperV  = 0x03, // "Microsoft Hv"
+	HypervisorVendorXen     = 0x04  // "XenVMMXenVMM"
+} HYPERVISOR_VENDOR;
+
+/// <summary>
+/// Interface found at one of the hypervisor leaf ranges.
+/// </summary>
+typedef struct _HYPERVISOR_INTERFACE {
+	HYPERVISOR_VENDOR Vendor;
+	CHAR              Signature[13];
+	UINT32            Base;           // First leaf of the range.
+	UINT32            MaximumLeaf;
+} HYPERVISOR_INTERFACE, * PHYPERVISOR_INTERFACE;
+
+/// <summary>
+/// Decoded hypervisor leaves. The vendor specific fields are zero when the interface is not exposed.
+/// </summary>
+typedef struct _HYPERVISOR_INFORMATION {
+	BOOL                 bPresent;        // CPUID.01H:ECX[31]
+	UINT32               InterfaceCount;
+	HYPERVISOR_INTERFACE Interfaces[HYPERVISOR_MAX_INTERFACES];
+	HYPERVISOR_VENDOR    Vendor;          // Vendor of the first interface, i.e. the one the hypervisor prefers.
+	UINT32               KvmFeatures;     // KVM_FEATURE_*
+	UINT32               KvmHints;
+	UINT32               HvPrivileges;    // HV_ACCESS_*
+	UINT32               HvFeatures;
+	UINT16               HvMajor;
+	UINT16               HvMinor;
+	UINT32               HvBuild;
+	UINT16               XenMajor;
+	UINT16               XenMinor;
+	UINT32               XenTscFlags;     // XEN_TSC_*
+	UINT32               XenTscMode;
+	UINT32               Clocks;          // HYPERVISOR_CLOCK_*
+	UINT64               TscFrequency;    // Hz, 0 when the hypervisor does not give it.
+	UINT64               ApicFrequency;   // Hz, 0 when the hypervisor does not give it.
+} HYPERVISOR_INFORMATION, * PHYPERVISOR_INFORMATION;
+
+/// <summary>
+/// Instructions and accesses whose cost is measured by HypervisorProfile.
+/// </summary>
+typedef enum _HYPERVISOR_PROBE {
+	HypervisorProbeBaseline = 0x00, // Empty batch, i.e. the overhead of the measure itself.
+	HypervisorProbeRdtsc    = 0x01,
+	HypervisorProbeRdtscp   = 0x02,
+	HypervisorProbeCpuid    = 0x03, // Always intercepted by VT-x, and by every hypervisor on AMD-V.
+	HypervisorProbeMsr      = 0x04, // Read of IA32_MTRRCAP via the MSR backend, OS round trip included.
+	HypervisorProbeCount    = 0x05
+} HYPERVISOR_PROBE;
+
+/// <summary>
+/// Cost of one probe in TSC ticks.
+/// </summary>
+typedef struct _HYPERVISOR_COST {
+	BOOL   bMeasured;
+	UINT64 Minimum;
+	UINT64 Median;
+	BOOL   bExits;      // Costs as much as an exit to the hypervisor.
+} HYPERVISOR_COST, * PHYPERVISOR_COST;
+
+/// <summary>
+/// Cost of every probe.
+/// </summary>
+typedef struct _HYPERVISOR_PROFILE {
+	BOOL            bVirtualised;
+	HYPERVISOR_COST Costs[HypervisorProbeCount];
+} HYPERVISOR_PROFILE, * PHYPERVISOR_PROFILE;
+
+/// <summary>
+/// Decode the hypervisor-present bit and the hypervisor leaves of every interface exposed.
+/// </summary>
+/// <param name="pBackend">Optional pointer to an opened CPUID backend, the local processor otherwise.</param>
+/// <param name="pMsr">Optional pointer to an opened MSR backend to read the Hyper-V frequency MSRs.</param>
+/// <param name="pInformation">Pointer to the structure receiving the information.</param>
+/// <returns>Whether the leaves have been queried.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL HypervisorQuery(
+	_In_opt_ PCPUID_BACKEND          pBackend,
+	_In_opt_ PMSR_BACKEND            pMsr,
+	_Out_    PHYPERVISOR_INFORMATION pInformation
+);
+
+/// <summary>
+/// Get the name of a hypervisor.
+/// </summary>
+/// <param name="Vendor">Vendor of the hypervisor.</param>
+/// <returns>Name of the hypervisor.</returns>
+LPCSTR HypervisorGetVendorName(
+	_In_ HYPERVISOR_VENDOR Vendor
+);
+
+/// <summary>
+/// Get the name of a probe.
+/// </summary>
+/// <param name="Probe">Probe measured by HypervisorProfile.</param>
+/// <returns>Name of the probe.</returns>
+LPCSTR HypervisorGetProbeName(
+	_In_ HYPERVISOR_PROBE Probe
+);
+
+/// <summary>
+/// Measure the cost of the instructions a hypervisor may intercept on the calling processor. Under a
+/// hypervisor, a probe costing at least half of CPUID, which always exits, is deemed to exit too.
+/// </summary>
+/// <param name="pMsr">Optional pointer to an opened MSR backend for the MSR probe.</param>
+/// <param name="uiRuns">Number of batches measured per probe, 0 for HYPERVISOR_PROFILE_RUNS.</param>
+/// <param name="pProfile">Pointer to the structure receiving the costs.</param>
+VOID HypervisorProfile(
+	_In_opt_ PMSR_BACKEND        pMsr,
+	_In_     UINT32              uiRuns,
+	_Out_    PHYPERVISOR_PROFILE pProfile
+);
+
+#endif // !__HYPERVISOR_H_GUARD__
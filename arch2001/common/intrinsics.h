@@ -0,0 +1,177 @@
+/// @file    intrinsics.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __INTRINSICS_H_GUARD__
+#define __INTRINSICS_H_GUARD__
+#include "ost.h"
+#if defined(_WIN32)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+/// <summary>
+/// Inline versions of the instructions used across the code base, so that the compiler can schedule
+/// around them and knows exactly which registers they modify. GCC and Clang use inline assembly, MSVC
+/// uses its intrinsics. MSVC has no intrinsic for MOV from a segment register, SLDT and STR, so these
+/// still call the MASM procedures, as does everything else when OST_INTRIN_MASM is defined.
+/// </summary>
+
+#pragma pack(push, 1)
+/// <summary>
+/// C data structure representing the returned value of SGDT and SIDT instructions.
+/// </summary>
+typedef struct _SGDT_OUT {
+	UINT16 Limit;
+	UINT64 Address;
+} SGDT_OUT, * PSGDT_OUT;
+#pragma pack(pop)
+
+#if defined(_WIN32)
+EXTERN_C UINT STDMETHODCALLTYPE CPUIDEX(PUINT pEAX, PUINT pECX, PUINT pEBX, PUINT pEDX);
+EXTERN_C VOID STDMETHODCALLTYPE _read_cs(PUINT16 cs);
+EXTERN_C VOID STDMETHODCALLTYPE _read_ss(PUINT16 ss);
+EXTERN_C VOID STDMETHODCALLTYPE _read_ds(PUINT16 ds);
+EXTERN_C VOID STDMETHODCALLTYPE _read_es(PUINT16 es);
+EXTERN_C VOID STDMETHODCALLTYPE _read_fs(PUINT16 fs);
+EXTERN_C VOID STDMETHODCALLTYPE _read_gs(PUINT16 gs);
+EXTERN_C VOID STDMETHODCALLTYPE _read_gdtr(PSGDT_OUT gdtr);
+EXTERN_C VOID STDMETHODCALLTYPE _read_idtr(PSGDT_OUT idtr);
+EXTERN_C VOID STDMETHODCALLTYPE _read_ldtr(PUINT16 ldtr);
+EXTERN_C VOID STDMETHODCALLTYPE _read_tr(PUINT16 tr);
+EXTERN_C BOOL STDMETHODCALLTYPE _read_lar(UINT16 selector, PUINT32 access);
+
+/// Generate a getter calling a MASM procedure
+#define INTRIN_MASM_GETTER(Name, Procedure) \
+	FORCEINLINE UINT16 Name() { UINT16 Value = 0x00; Procedure(&Value); return Value; }
+#endif
+
+/// <summary>
+/// Execute CPUID for a leaf and sub-leaf.
+/// </summary>
+/// <param name="uiLeaf">Leaf to query (EAX).</param>
+/// <param name="uiSubLeaf">Sub-leaf to query (ECX).</param>
+/// <param name="pRegisters">Array receiving EAX, EBX, ECX and EDX in that order.</param>
+FORCEINLINE VOID _cpuid_query(
+	_In_  UINT  uiLeaf,
+	_In_  UINT  uiSubLeaf,
+	_Out_writes_(4) PUINT pRegisters
+) {
+#if defined(_WIN32) && defined(OST_INTRIN_MASM)
+	pRegisters[0] = uiLeaf;
+	pRegisters[2] = uiSubLeaf;
+	(VOID)CPUIDEX(&pRegisters[0], &pRegisters[2], &pRegisters[1], &pRegisters[3]);
+#elif defined(_WIN32)
+	__cpuidex((int*)pRegisters, (int)uiLeaf, (int)uiSubLeaf);
+#else
+	__asm__ volatile (
+		"cpuid"
+		: "=a" (pRegisters[0]), "=b" (pRegisters[1]), "=c" (pRegisters[2]), "=d" (pRegisters[3])
+		: "a" (uiLeaf), "c" (uiSubLeaf)
+	);
+#endif
+}
+
+/// Visible part of the segment registers
+#if defined(_WIN32)
+INTRIN_MASM_GETTER(_get_cs, _read_cs)
+INTRIN_MASM_GETTER(_get_ss, _read_ss)
+INTRIN_MASM_GETTER(_get_ds, _read_ds)
+INTRIN_MASM_GETTER(_get_es, _read_es)
+INTRIN_MASM_GETTER(_get_fs, _read_fs)
+INTRIN_MASM_GETTER(_get_gs, _read_gs)
+INTRIN_MASM_GETTER(_get_ldtr, _read_ldtr)
+INTRIN_MASM_GETTER(_get_tr, _read_tr)
+#else
+FORCEINLINE UINT16 _get_cs() { UINT16 Value; __asm__ volatile ("mov %%cs, %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_ss() { UINT16 Value; __asm__ volatile ("mov %%ss, %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_ds() { UINT16 Value; __asm__ volatile ("mov %%ds, %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_es() { UINT16 Value; __asm__ volatile ("mov %%es, %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_fs() { UINT16 Value; __asm__ volatile ("mov %%fs, %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_gs() { UINT16 Value; __asm__ volatile ("mov %%gs, %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_ldtr() { UINT16 Value; __asm__ volatile ("sldt %0" : "=r" (Value)); return Value; }
+FORCEINLINE UINT16 _get_tr() { UINT16 Value; __asm__ volatile ("str %0" : "=r" (Value)); return Value; }
+#endif
+
+/// Access rights of the descriptor of a selector, masked with 0x00F0FF00 as in bytes 5 and 6 of the descriptor.
+/// Fails for null selectors, and for the descriptors whose DPL is below the current privilege level.
+#if defined(_WIN32)
+#define _get_lar(Selector, pAccess) _read_lar((Selector), (pAccess))
+#else
+FORCEINLINE BOOL _get_lar(UINT16 Selector, PUINT32 pAccess) {
+	UINT8 Valid;
+	UINT32 Access = 0x00;
+	__asm__ volatile ("lar %2, %1; setz %0" : "=r" (Valid), "+r" (Access) : "r" ((UINT32)Selector) : "cc");
+	*pAccess = Valid ? Access : 0x00;
+	return Valid;
+}
+#endif
+
+/// Descriptor table registers. Fault or return dummy values in user mode when UMIP is enforced.
+#if defined(_WIN32) && defined(OST_INTRIN_MASM)
+FORCEINLINE VOID _get_gdtr(_Out_ PSGDT_OUT gdtr) { _read_gdtr(gdtr); }
+FORCEINLINE VOID _get_idtr(_Out_ PSGDT_OUT idtr) { _read_idtr(idtr); }
+#elif defined(_WIN32)
+FORCEINLINE VOID _get_gdtr(_Out_ PSGDT_OUT gdtr) { _sgdt(gdtr); }
+FORCEINLINE VOID _get_idtr(_Out_ PSGDT_OUT idtr) { __sidt(idtr); }
+#else
+FORCEINLINE VOID _get_gdtr(_Out_ PSGDT_OUT gdtr) { __asm__ volatile ("sgdt %0" : "=m" (*gdtr)); }
+FORCEINLINE VOID _get_idtr(_Out_ PSGDT_OUT idtr) { __asm__ volatile ("sidt %0" : "=m" (*idtr)); }
+#endif
+
+/// IA32_TSC_AUX and FS/GS base addresses
+#if defined(_WIN32)
+#define _rdpid() _rdpid_u32()
+#define _rdfsbase() _readfsbase_u64()
+#define _rdgsbase() _readgsbase_u64()
+FORCEINLINE UINT32 _rdtscp_aux() { UINT32 Aux; __rdtscp(&Aux); return Aux; }
+#else
+FORCEINLINE UINT32 _rdpid() { UINT64 Aux; __asm__ volatile ("rdpid %0" : "=r" (Aux)); return (UINT32)Aux; }
+FORCEINLINE UINT32 _rdtscp_aux() { UINT32 Aux; __asm__ volatile ("rdtscp" : "=c" (Aux) : : "eax", "edx"); return Aux; }
+FORCEINLINE UINT64 _rdfsbase() { UINT64 Base; __asm__ volatile ("rdfsbase %0" : "=r" (Base)); return Base; }
+FORCEINLINE UINT64 _rdgsbase() { UINT64 Base; __asm__ volatile ("rdgsbase %0" : "=r" (Base)); return Base; }
+#endif
+
+/// Time-stamp and performance counters, and user-mode wait instructions: UMONITOR, UMWAIT and TPAUSE (WAITPKG), MONITORX and MWAITX (AMD).
+/// _read_tsc_fenced cannot be reordered with the loads and stores around it.
+/// UMWAIT and TPAUSE return whether the wait was cut short by the OS time limit of IA32_UMWAIT_CONTROL.
+#if defined(_WIN32)
+#define _read_tsc() __rdtsc()
+FORCEINLINE UINT64 _read_tsc_fenced() { _mm_lfence(); UINT64 Tsc = __rdtsc(); _mm_lfence(); return Tsc; }
+#define _read_pmc(Counter) __readpmc(Counter)
+FORCEINLINE VOID _wait_umonitor(const volatile void* Address) { _umonitor((void*)Address); }
+FORCEINLINE BOOL _wait_umwait(UINT32 Control, UINT64 Deadline) { return _umwait(Control, Deadline); }
+FORCEINLINE BOOL _wait_tpause(UINT32 Control, UINT64 Deadline) { return _tpause(Control, Deadline); }
+FORCEINLINE VOID _wait_monitorx(const volatile void* Address) { _mm_monitorx((void const*)Address, 0x00, 0x00); }
+FORCEINLINE VOID _wait_mwaitx(UINT32 Ticks) { _mm_mwaitx(0x02, 0xF0, Ticks); }
+#else
+FORCEINLINE UINT64 _read_tsc() { UINT32 Low, High; __asm__ volatile ("rdtsc" : "=a" (Low), "=d" (High)); return ((UINT64)High << 32) | Low; }
+FORCEINLINE UINT64 _read_tsc_fenced() { UINT32 Low, High; __asm__ volatile ("lfence; rdtsc; lfence" : "=a" (Low), "=d" (High) : : "memory"); return ((UINT64)High << 32) | Low; }
+FORCEINLINE UINT64 _read_pmc(UINT32 Counter) { UINT32 Low, High; __asm__ volatile ("rdpmc" : "=a" (Low), "=d" (High) : "c" (Counter)); return ((UINT64)High << 32) | Low; }
+FORCEINLINE VOID _wait_umonitor(const volatile void* Address) { __asm__ volatile ("umonitor %0" : : "r" (Address) : "memory"); }
+FORCEINLINE BOOL _wait_umwait(UINT32 Control, UINT64 Deadline) {
+	UINT8 Limited;
+	__asm__ volatile ("umwait %1; setc %0" : "=r" (Limited) : "r" (Control), "a" ((UINT32)Deadline), "d" ((UINT32)(Deadline >> 32)) : "memory", "cc");
+	return Limited;
+}
+FORCEINLINE BOOL _wait_tpause(UINT32 Control, UINT64 Deadline) {
+	UINT8 Limited;
+	__asm__ volatile ("tpause %1; setc %0" : "=r" (Limited) : "r" (Control), "a" ((UINT32)Deadline), "d" ((UINT32)(Deadline >> 32)) : "memory", "cc");
+	return Limited;
+}
+FORCEINLINE VOID _wait_monitorx(const volatile void* Address) { __asm__ volatile ("monitorx %%rax, %%ecx, %%edx" : : "a" (Address), "c" (0x00), "d" (0x00) : "memory"); }
+FORCEINLINE VOID _wait_mwaitx(UINT32 Ticks) { __asm__ volatile ("mwaitx %%eax, %%ecx, %%ebx" : : "a" (0xF0), "c" (0x02), "b" (Ticks) : "memory"); }
+#endif
+
+/// Extended control registers, XCR0 being register 0. XGETBV raises #UD unless CR4.OSXSAVE is set,
+/// as reported by CPUID.01H:ECX.OSXSAVE.
+#if defined(_WIN32)
+#define _read_xcr(Register) _xgetbv(Register)
+#else
+FORCEINLINE UINT64 _read_xcr(UINT32 Register) { UINT32 Low, High; __asm__ volatile ("xgetbv" : "=a" (Low), "=d" (High) : "c" (Register)); return ((UINT64)High << 32) | Low; }
+#endif
+
+#endif // !__INTRINSICS_H_GUARD__
@@ -0,0 +1,268 @@
+/// @file    mitigation.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#pragma comment(lib, "Advapi32.lib")
+#else
+#include <dirent.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include "mitigation.h"
+#include "cpuid.h"
+#include "thread.h"
+
+/// Vendor strings
+#define MITIGATION_VENDOR_INTEL "GenuineIntel"
+#define MITIGATION_VENDOR_AMD   "AuthenticAMD"
+
+/// <summary>
+/// Bits of IA32_ARCH_CAPABILITIES reported by the audit.
+/// </summary>
+static const struct {
+	UINT64 Mask;
+	LPCSTR Name;
+	LPCSTR Description;
+} g_MitigationCapabilities[] = {
+	{ ARCH_CAP_RDCL_NO,      "RDCL_NO",       "Not affected by Rogue Data Cache Load (Meltdown)" },
+	{ ARCH_CAP_IBRS_ALL,     "IBRS_ALL",      "Enhanced IBRS, set once and left on" },
+	{ ARCH_CAP_RSBA,         "RSBA",          "RET may be predicted from the BTB on RSB underflow" },
+	{ ARCH_CAP_SKIP_L1DFL,   "SKIP_L1DFL",    "No L1D flush needed on VM entry" },
+	{ ARCH_CAP_SSB_NO,       "SSB_NO",        "Not affected by Speculative Store Bypass" },
+	{ ARCH_CAP_MDS_NO,       "MDS_NO",        "Not affected by Microarchitectural Data Sampling" },
+	{ ARCH_CAP_PSCHANGE_MC,  "PSCHANGE_MC_NO","No machine check on instruction fetch after a page size change" },
+	{ ARCH_CAP_TSX_CTRL,     "TSX_CTRL",      "IA32_TSX_CTRL can disable TSX" },
+	{ ARCH_CAP_TAA_NO,       "TAA_NO",        "Not affected by TSX Asynchronous Abort" },
+	{ ARCH_CAP_SBDR_SSDP_NO, "SBDR_SSDP_NO",  "Not affected by Shared Buffers Data Read and Sideband Stale Data Propagator" },
+	{ ARCH_CAP_FBSDP_NO,     "FBSDP_NO",      "Not affected by Fill Buffer Stale Data Propagator" },
+	{ ARCH_CAP_PSDP_NO,      "PSDP_NO",       "Not affected by Primary Stale Data Propagator" },
+	{ ARCH_CAP_FB_CLEAR,     "FB_CLEAR",      "VERW clears the fill buffers" },
+	{ ARCH_CAP_RRSBA,        "RRSBA",         "RET may use alternate predictors on RSB underflow" },
+	{ ARCH_CAP_BHI_NO,       "BHI_NO",        "Not affected by Branch History Injection" },
+	{ ARCH_CAP_PBRSB_NO,     "PBRSB_NO",      "Not affected by Post-Barrier RSB predictions" },
+	{ ARCH_CAP_GDS_NO,       "GDS_NO",        "Not affected by Gather Data Sampling" },
+	{ ARCH_CAP_RFDS_NO,      "RFDS_NO",       "Not affected by Register File Data Sampling" }
+};
+
+/// <summary>
+/// Add a control to the audit.
+/// </summary>
+static VOID MitigationAddControl(
+	_Inout_ PMITIGATION_AUDIT pAudit,
+	_In_    LPCSTR            szName,
+	_In_    LPCSTR            szDescription,
+	_In_    BOOL              bEnumerated,
+	_In_    UINT64            SpecCtrlMask
+) {
+	if (pAudit->ControlCount >= MITIGATION_MAX_CONTROLS)
+		return;
+	PMITIGATION_CONTROL pControl = &pAudit->Controls[pAudit->ControlCount++];
+	pControl->Name = szName;
+	pControl->Description = szDescription;
+	pControl->bEnumerated = bEnumerated;
+	pControl->SpecCtrlMask = SpecCtrlMask;
+	pControl->bActive = pAudit->bSpecCtrl && SpecCtrlMask != 0x00 && (pAudit->SpecCtrl & SpecCtrlMask) == SpecCtrlMask;
+}
+
+/// <summary>
+/// Get the microcode revision from IA32_BIOS_SIGN_ID. The register holds the revision latched by the last
+/// microcode update or CPUID, which the OS keeps current.
+/// </summary>
+static BOOL MitigationReadMicrocode(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_In_  BOOL         bIntel,
+	_Out_ PUINT32      pRevision
+) {
+	UINT64 Value = 0x00;
+	*pRevision = 0x00;
+	if (!MsrRead(pMsr, uiCpu, IA32_BIOS_SIGN_ID, &Value))
+		return FALSE;
+	*pRevision = bIntel ? (UINT32)(Value >> 32) : (UINT32)Value;
+	return TRUE;
+}
+
+/// <summary>
+/// Get the microcode revision of the first processor as reported by the OS.
+/// </summary>
+static BOOL MitigationQueryMicrocodeFromOs(
+	_In_  BOOL    bIntel,
+	_Out_ PUINT32 pRevision
+) {
+	*pRevision = 0x00;
+#if defined(_WIN32)
+	// REG_BINARY copy of IA32_BIOS_SIGN_ID
+	UINT64 Value = 0x00;
+	DWORD dwSize = sizeof(Value);
+	if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "Update Revision",
+		RRF_RT_REG_BINARY, NULL, &Value, &dwSize) != ERROR_SUCCESS || dwSize != sizeof(Value))
+		return FALSE;
+	*pRevision = bIntel ? (UINT32)(Value >> 32) : (UINT32)Value;
+	return TRUE;
+#else
+	(VOID)bIntel;
+	unsigned int Value = 0x00;
+	FILE* pFile = fopen("/sys/devices/system/cpu/cpu0/microcode/version", "r");
+	if (pFile == NULL)
+		return FALSE;
+	BOOL bRead = fscanf(pFile, "%x", &Value) == 0x01;
+	fclose(pFile);
+	*pRevision = (UINT32)Value;
+	return bRead;
+#endif
+}
+
+/// <summary>
+/// Get the status of every vulnerability known to the OS.
+/// </summary>
+static VOID MitigationQueryOs(
+	_Inout_ PMITIGATION_AUDIT pAudit
+) {
+#if defined(_WIN32)
+	// Windows only exposes them through the undocumented NtQuerySystemInformation classes
+	(VOID)pAudit;
+#else
+	DIR* pDirectory = opendir("/sys/devices/system/cpu/vulnerabilities");
+	if (pDirectory == NULL)
+		return;
+
+	struct dirent* pEntry = NULL;
+	while ((pEntry = readdir(pDirectory)) != NULL && pAudit->VulnerabilityCount < MITIGATION_MAX_VULNERABILITIES) {
+		if (pEntry->d_name[0] == '.')
+			continue;
+
+		// 1. One file per vulnerability, holding a single line
+		CHAR szPath[320] = { 0x00 };
+		snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/vulnerabilities/%s", pEntry->d_name);
+		FILE* pFile = fopen(szPath, "r");
+		if (pFile == NULL)
+			continue;
+		PMITIGATION_VULNERABILITY pVulnerability = &pAudit->Vulnerabilities[pAudit->VulnerabilityCount];
+		BOOL bRead = fgets(pVulnerability->Status, sizeof(pVulnerability->Status), pFile) != NULL;
+		fclose(pFile);
+		if (!bRead)
+			continue;
+
+		// 2. Strip the new line
+		pVulnerability->Status[strcspn(pVulnerability->Status, "\r\n")] = '\0';
+		snprintf(pVulnerability->Name, sizeof(pVulnerability->Name), "%.*s", (INT)sizeof(pVulnerability->Name) - 1, pEntry->d_name);
+		pAudit->VulnerabilityCount++;
+	}
+	closedir(pDirectory);
+
+	// 3. readdir order is arbitrary, sort by name for stable reports
+	for (UINT32 i = 0x01; i < pAudit->VulnerabilityCount; i++) {
+		MITIGATION_VULNERABILITY Current = pAudit->Vulnerabilities[i];
+		UINT32 j = i;
+		for (; j > 0x00 && strcmp(pAudit->Vulnerabilities[j - 1].Name, Current.Name) > 0x00; j--)
+			pAudit->Vulnerabilities[j] = pAudit->Vulnerabilities[j - 1];
+		pAudit->Vulnerabilities[j] = Current;
+	}
+#endif
+}
+
+_Use_decl_annotations_
+BOOL MitigationAudit(
+	_In_opt_ PMSR_BACKEND      pMsr,
+	_Out_    PMITIGATION_AUDIT pAudit
+) {
+	RtlZeroMemory(pAudit, sizeof(MITIGATION_AUDIT));
+
+	// 1. Key: vendor, display family, model and stepping
+	const CPUID_INFORMATION* pCpuid = CpuidGetInformation();
+	UINT Registers[4] = { 0x00 };
+	if (!pCpuid->Supported || !CpuidQuery(CPUID_LEAF_BASIC_INFORMATION, 0x00, Registers))
+		return FALSE;
+	PMITIGATION_KEY pKey = &pAudit->Key;
+	RtlCopyMemory(pKey->Vendor, pCpuid->Vendor, sizeof(pKey->Vendor));
+	BOOL bIntel = strcmp(pKey->Vendor, MITIGATION_VENDOR_INTEL) == 0x00;
+	BOOL bAmd = strcmp(pKey->Vendor, MITIGATION_VENDOR_AMD) == 0x00;
+	UINT32 Family = (Registers[0] >> 8) & 0x0F;
+	UINT32 Model = (Registers[0] >> 4) & 0x0F;
+	pKey->Stepping = Registers[0] & 0x0F;
+	pKey->Family = Family == 0x0F ? Family + ((Registers[0] >> 20) & 0xFF) : Family;
+	pKey->Model = (Family == 0x06 || Family == 0x0F) ? Model + (((Registers[0] >> 16) & 0x0F) << 4) : Model;
+
+	// 2. Microcode of every processor, a mixed revision is a configuration issue of its own
+	if (pMsr != NULL) {
+		UINT32 CpuCount = ThreadGetCpuCount();
+		for (UINT32 Cpu = 0x00; Cpu < CpuCount; Cpu++) {
+			UINT32 Revision = 0x00;
+			if (!MitigationReadMicrocode(pMsr, Cpu, bIntel, &Revision))
+				break;
+			if (!pKey->bMicrocode) {
+				pKey->bMicrocode = TRUE;
+				pKey->Microcode = Revision;
+			}
+			else if (Revision != pKey->Microcode) {
+				pKey->bMicrocodeMixed = TRUE;
+			}
+		}
+	}
+	if (!pKey->bMicrocode)
+		pKey->bMicrocode = MitigationQueryMicrocodeFromOs(bIntel, &pKey->Microcode);
+
+	// 3. MSRs, only readable when enumerated
+	UINT64 Value = 0x00;
+	StructuredExtendedFeatureEdx Edx = pCpuid->ExtendedEdx;
+	UINT AmdEbx = 0x00;
+	if (bAmd && pCpuid->MaximumExtendedLeaf >= CPUID_LEAF_ADDRESS_SIZES && CpuidQuery(CPUID_LEAF_ADDRESS_SIZES, 0x00, Registers))
+		AmdEbx = Registers[1];
+	BOOL bSpecCtrl = Edx.elem.IBRS_IBPB || Edx.elem.STIBP || Edx.elem.SSBD || (AmdEbx & (CPUID_AMD_IBRS | CPUID_AMD_STIBP | CPUID_AMD_SSBD));
+	if (pMsr != NULL && bSpecCtrl && MsrRead(pMsr, MSR_CURRENT_CPU, IA32_SPEC_CTRL, &Value)) {
+		pAudit->bSpecCtrl = TRUE;
+		pAudit->SpecCtrl = Value;
+	}
+	if (pMsr != NULL && Edx.elem.IA32_ARCH_CAPABILITIES && MsrRead(pMsr, MSR_CURRENT_CPU, IA32_ARCH_CAP_MSR, &Value)) {
+		pAudit->bArchCapabilities = TRUE;
+		pAudit->ArchCapabilities = Value;
+	}
+
+	// 4. Controls of CPUID.(07H,2):EDX
+	UINT Edx72 = 0x00;
+	if (pCpuid->MaximumLeaf >= CPUID_LEAF_EXTENDED_FEATURES && CpuidQuery(CPUID_LEAF_EXTENDED_FEATURES, 0x00, Registers)
+		&& Registers[0] >= 0x02 && CpuidQuery(CPUID_LEAF_EXTENDED_FEATURES, 0x02, Registers))
+		Edx72 = Registers[3];
+
+	// 5. Controls, AMD enumerates the same bits of IA32_SPEC_CTRL in another leaf
+	MitigationAddControl(pAudit, "IBRS", "Indirect Branch Restricted Speculation", Edx.elem.IBRS_IBPB || (AmdEbx & CPUID_AMD_IBRS), SPEC_CTRL_IBRS);
+	MitigationAddControl(pAudit, "IBPB", "Indirect Branch Predictor Barrier, written to IA32_PRED_CMD", Edx.elem.IBRS_IBPB || (AmdEbx & CPUID_AMD_IBPB), 0x00);
+	MitigationAddControl(pAudit, "STIBP", "Single Thread Indirect Branch Predictors", Edx.elem.STIBP || (AmdEbx & CPUID_AMD_STIBP), SPEC_CTRL_STIBP);
+	MitigationAddControl(pAudit, "SSBD", "Speculative Store Bypass Disable", Edx.elem.SSBD || (AmdEbx & CPUID_AMD_SSBD), SPEC_CTRL_SSBD);
+	MitigationAddControl(pAudit, "PSFD", "Predictive Store Forwarding Disable", (Edx72 & CPUID_7_2_PSFD) || (AmdEbx & CPUID_AMD_PSFD), SPEC_CTRL_PSFD);
+	MitigationAddControl(pAudit, "IPRED_DIS", "Indirect predictions disabled in user and supervisor modes", Edx72 & CPUID_7_2_IPRED_CTRL, SPEC_CTRL_IPRED_DIS_U | SPEC_CTRL_IPRED_DIS_S);
+	MitigationAddControl(pAudit, "RRSBA_DIS", "Alternate RET predictors disabled in user and supervisor modes", Edx72 & CPUID_7_2_RRSBA_CTRL, SPEC_CTRL_RRSBA_DIS_U | SPEC_CTRL_RRSBA_DIS_S);
+	MitigationAddControl(pAudit, "BHI_DIS_S", "Branch history not used for predictions in supervisor mode", Edx72 & CPUID_7_2_BHI_CTRL, SPEC_CTRL_BHI_DIS_S);
+	MitigationAddControl(pAudit, "L1D_FLUSH", "L1D flush through IA32_FLUSH_CMD", Edx.elem.L1D_FLUSH, 0x00);
+	MitigationAddControl(pAudit, "MD_CLEAR", "VERW clears the microarchitectural buffers", Edx.elem.MD_CLEAR, 0x00);
+	MitigationAddControl(pAudit, "SRBDS_CTRL", "RDRAND and RDSEED mitigation control", Edx.elem.SRBDS_CTRL, 0x00);
+
+	// 6. Immunities
+	for (UINT32 Index = 0x00; Index < ARRAYSIZE(g_MitigationCapabilities) && Index < MITIGATION_MAX_CAPABILITIES; Index++) {
+		PMITIGATION_CAPABILITY pCapability = &pAudit->Capabilities[pAudit->CapabilityCount++];
+		pCapability->Name = g_MitigationCapabilities[Index].Name;
+		pCapability->Description = g_MitigationCapabilities[Index].Description;
+		pCapability->bSet = (pAudit->ArchCapabilities & g_MitigationCapabilities[Index].Mask) != 0x00;
+	}
+
+	// 7. What the OS made of all of it
+	MitigationQueryOs(pAudit);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID MitigationFormatKey(
+	_In_                 const MITIGATION_KEY* pKey,
+	_Out_writes_(uiSize) LPSTR                 szBuffer,
+	_In_                 UINT32                uiSize
+) {
+	if (pKey->bMicrocode)
+		snprintf(szBuffer, uiSize, "%s-%02X-%02X-%X-0x%x", pKey->Vendor, pKey->Family, pKey->Model, pKey->Stepping, pKey->Microcode);
+	else
+		snprintf(szBuffer, uiSize, "%s-%02X-%02X-%X-unknown", pKey->Vendor, pKey->Family, pKey->Model, pKey->Stepping);
+}
@@ -0,0 +1,148 @@
+/// @file    mitigation.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __MITIGATION_H_GUARD__
+#define __MITIGATION_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// Bits of IA32_SPEC_CTRL
+#define SPEC_CTRL_IBRS        0x00000001
+#define SPEC_CTRL_STIBP       0x00000002
+#define SPEC_CTRL_SSBD        0x00000004
+#define SPEC_CTRL_IPRED_DIS_U 0x00000008
+#define SPEC_CTRL_IPRED_DIS_S 0x00000010
+#define SPEC_CTRL_RRSBA_DIS_U 0x00000020
+#define SPEC_CTRL_RRSBA_DIS_S 0x00000040
+#define SPEC_CTRL_PSFD        0x00000080
+#define SPEC_CTRL_BHI_DIS_S   0x00000400
+
+/// Bits of IA32_ARCH_CAPABILITIES
+#define ARCH_CAP_RDCL_NO      0x00000001 // Not affected by Meltdown.
+#define ARCH_CAP_IBRS_ALL     0x00000002 // Enhanced IBRS.
+#define ARCH_CAP_RSBA         0x00000004 // RET may use the BTB when the RSB underflows.
+#define ARCH_CAP_SKIP_L1DFL   0x00000008 // No L1D flush needed on VM entry.
+#define ARCH_CAP_SSB_NO       0x00000010 // Not affected by Speculative Store Bypass.
+#define ARCH_CAP_MDS_NO       0x00000020 // Not affected by Microarchitectural Data Sampling.
+#define ARCH_CAP_PSCHANGE_MC  0x00000040 // No machine check on page size changes.
+#define ARCH_CAP_TSX_CTRL     0x00000080 // IA32_TSX_CTRL is available.
+#define ARCH_CAP_TAA_NO       0x00000100 // Not affected by TSX Asynchronous Abort.
+#define ARCH_CAP_SBDR_SSDP_NO 0x00002000 // Not affected by the MMIO stale data issues.
+#define ARCH_CAP_FBSDP_NO     0x00004000
+#define ARCH_CAP_PSDP_NO      0x00008000
+#define ARCH_CAP_FB_CLEAR     0x00020000 // VERW clears the fill buffers.
+#define ARCH_CAP_RRSBA        0x00080000
+#define ARCH_CAP_BHI_NO       0x00100000 // Not affected by Branch History Injection.
+#define ARCH_CAP_PBRSB_NO     0x01000000 // Not affected by Post-Barrier RSB predictions.
+#define ARCH_CAP_GDS_NO       0x04000000 // Not affected by Gather Data Sampling.
+#define ARCH_CAP_RFDS_NO      0x08000000 // Not affected by Register File Data Sampling.
+
+/// CPUID.(07H,2):EDX
+#define CPUID_7_2_PSFD       0x00000001
+#define CPUID_7_2_IPRED_CTRL 0x00000002
+#define CPUID_7_2_RRSBA_CTRL 0x00000004
+#define CPUID_7_2_BHI_CTRL   0x00000010
+
+/// CPUID.80000008H:EBX, AMD
+#define CPUID_AMD_IBPB       0x00001000
+#define CPUID_AMD_IBRS       0x00004000
+#define CPUID_AMD_STIBP      0x00008000
+#define CPUID_AMD_SSBD       0x01000000
+#define CPUID_AMD_VIRT_SSBD  0x02000000
+#define CPUID_AMD_SSB_NO     0x04000000
+#define CPUID_AMD_PSFD       0x10000000
+
+/// Capacities of the audit
+#define MITIGATION_MAX_CONTROLS        16
+#define MITIGATION_MAX_CAPABILITIES    24
+#define MITIGATION_MAX_VULNERABILITIES 32
+
+/// <summary>
+/// Processor the results are keyed by, so that hosts can be compared.
+/// </summary>
+typedef struct _MITIGATION_KEY {
+	CHAR   Vendor[13];
+	UINT32 Family;          // Display family, extended family included.
+	UINT32 Model;           // Display model, extended model included.
+	UINT32 Stepping;
+	BOOL   bMicrocode;      // The microcode revision could be read.
+	UINT32 Microcode;
+	BOOL   bMicrocodeMixed; // Processors run different revisions.
+} MITIGATION_KEY, * PMITIGATION_KEY;
+
+/// <summary>
+/// Hardware mitigation the processor may enumerate and the OS may enable.
+/// </summary>
+typedef struct _MITIGATION_CONTROL {
+	LPCSTR Name;
+	LPCSTR Description;
+	BOOL   bEnumerated;  // Reported by CPUID.
+	UINT64 SpecCtrlMask; // Bits enabling it in IA32_SPEC_CTRL, 0 when it is not controlled there.
+	BOOL   bActive;      // Enabled in IA32_SPEC_CTRL of the current processor.
+} MITIGATION_CONTROL, * PMITIGATION_CONTROL;
+
+/// <summary>
+/// Bit of IA32_ARCH_CAPABILITIES.
+/// </summary>
+typedef struct _MITIGATION_CAPABILITY {
+	LPCSTR Name;
+	LPCSTR Description;
+	BOOL   bSet;
+} MITIGATION_CAPABILITY, * PMITIGATION_CAPABILITY;
+
+/// <summary>
+/// Status of a vulnerability as reported by the OS. Linux only.
+/// </summary>
+typedef struct _MITIGATION_VULNERABILITY {
+	CHAR Name[32];
+	CHAR Status[160];
+} MITIGATION_VULNERABILITY, * PMITIGATION_VULNERABILITY;
+
+/// <summary>
+/// Result of an audit.
+/// </summary>
+typedef struct _MITIGATION_AUDIT {
+	MITIGATION_KEY           Key;
+	BOOL                     bSpecCtrl;          // IA32_SPEC_CTRL could be read.
+	UINT64                   SpecCtrl;
+	BOOL                     bArchCapabilities;  // IA32_ARCH_CAPABILITIES could be read.
+	UINT64                   ArchCapabilities;
+	UINT32                   ControlCount;
+	MITIGATION_CONTROL       Controls[MITIGATION_MAX_CONTROLS];
+	UINT32                   CapabilityCount;
+	MITIGATION_CAPABILITY    Capabilities[MITIGATION_MAX_CAPABILITIES];
+	UINT32                   VulnerabilityCount;
+	MITIGATION_VULNERABILITY Vulnerabilities[MITIGATION_MAX_VULNERABILITIES];
+} MITIGATION_AUDIT, * PMITIGATION_AUDIT;
+
+/// <summary>
+/// Audit the speculative execution mitigations: the controls enumerated by CPUID, those enabled in
+/// IA32_SPEC_CTRL, the immunities of IA32_ARCH_CAPABILITIES and the microcode revision. Without a MSR
+/// backend, the microcode revision comes from the OS when it exposes it.
+/// </summary>
+/// <param name="pMsr">Optional pointer to an opened MSR backend.</param>
+/// <param name="pAudit">Pointer to the structure receiving the audit.</param>
+/// <returns>Whether the processor could be identified.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MitigationAudit(
+	_In_opt_ PMSR_BACKEND      pMsr,
+	_Out_    PMITIGATION_AUDIT pAudit
+);
+
+/// <summary>
+/// Format the key of a processor as "vendor-family-model-stepping-microcode", e.g. "GenuineIntel-06-8F-8-0x2b000590".
+/// </summary>
+/// <param name="pKey">Pointer to the key.</param>
+/// <param name="szBuffer">Buffer receiving the key.</param>
+/// <param name="uiSize">Size of the buffer in bytes.</param>
+VOID MitigationFormatKey(
+	_In_                 const MITIGATION_KEY* pKey,
+	_Out_writes_(uiSize) LPSTR                 szBuffer,
+	_In_                 UINT32                uiSize
+);
+
+#endif // !__MITIGATION_H_GUARD__
@@ -0,0 +1,409 @@
+/// @file    msr.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+#include <stdlib.h>
+#include "msr.h"
+#include "thread.h"
+
+#if defined(_WIN32)
+/// General information about the driver
+#define KMSR_DEVICE_PATH L"\\\\.\\KMsr"
+#define KMSR_DEVICE_TYPE 0x8000
+
+/// List of IOCTL exposed by this driver
+#define IOCTL_KMSR_READ       CTL_CODE(KMSR_DEVICE_TYPE, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_KMSR_WRITE      CTL_CODE(KMSR_DEVICE_TYPE, 0x801, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+#define IOCTL_KMSR_READ_BATCH CTL_CODE(KMSR_DEVICE_TYPE, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+typedef UINT32 RDMSR_IN;
+typedef PUINT32 PRDMSR_IN;
+
+typedef struct _RDMSR_OUT {
+	UINT32 EAX;
+	UINT32 EDX;
+} RDMSR_OUT, * PRDMSR_OUT;
+
+typedef struct _WRMSR_IN {
+	UINT32 Msr;
+	UINT32 EAX;
+	UINT32 EDX;
+} WRMSR_IN, * PWRMSR_IN;
+
+/// <summary>
+/// Read a MSR via the \\.\KMsr driver. The IOCTL is dispatched in the context of the calling thread,
+/// hence on the processor the thread is pinned to.
+/// </summary>
+static BOOL MsrDriverRead(
+	_In_  PMSR_BACKEND Backend,
+	_In_  UINT32       Cpu,
+	_In_  UINT32       Msr,
+	_Out_ PUINT64      pValue
+) {
+	*pValue = 0x00;
+
+	// 1. Move to the requested processor
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (Cpu != MSR_CURRENT_CPU && !ThreadPin(Cpu, &Previous))
+		return FALSE;
+
+	// 2. Query the device
+	RDMSR_IN  InData = Msr;
+	RDMSR_OUT OutData = { 0x00 };
+	DWORD dwBytesReturned = 0x00;
+	BOOL bSuccess = DeviceIoControl(
+		(HANDLE)Backend->Context,
+		IOCTL_KMSR_READ,
+		&InData,
+		sizeof(RDMSR_IN),
+		&OutData,
+		sizeof(OutData),
+		&dwBytesReturned,
+		NULL
+	);
+
+	// 3. Restore the affinity and return the data
+	if (Cpu != MSR_CURRENT_CPU)
+		ThreadRestore(&Previous);
+	if (!bSuccess)
+		return FALSE;
+	*pValue = (UINT64)OutData.EDX << 32 | (UINT64)OutData.EAX;
+	return TRUE;
+}
+
+/// <summary>
+/// Read several MSRs via the \\.\KMsr driver: one affinity change and one IOCTL for all of them.
+/// </summary>
+static BOOL MsrDriverReadBatch(
+	_In_  PMSR_BACKEND  Backend,
+	_In_  UINT32        Cpu,
+	_In_reads_(Count) const UINT32* pMsrs,
+	_In_  UINT32        Count,
+	_Out_writes_(Count) PUINT64 pValues
+) {
+	RtlZeroMemory(pValues, Count * sizeof(UINT64));
+	if (Count == 0x00 || Count > MSR_BATCH_MAX)
+		return FALSE;
+
+	// 1. Move to the requested processor
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (Cpu != MSR_CURRENT_CPU && !ThreadPin(Cpu, &Previous))
+		return FALSE;
+
+	// 2. Query the device, the values come back in the order of the addresses
+	RDMSR_OUT OutData[MSR_BATCH_MAX] = { 0x00 };
+	DWORD dwBytesReturned = 0x00;
+	BOOL bSuccess = DeviceIoControl(
+		(HANDLE)Backend->Context,
+		IOCTL_KMSR_READ_BATCH,
+		(LPVOID)pMsrs,
+		Count * sizeof(RDMSR_IN),
+		OutData,
+		Count * sizeof(RDMSR_OUT),
+		&dwBytesReturned,
+		NULL
+	);
+
+	// 3. Restore the affinity and return the data
+	if (Cpu != MSR_CURRENT_CPU)
+		ThreadRestore(&Previous);
+	if (!bSuccess || dwBytesReturned != Count * sizeof(RDMSR_OUT))
+		return FALSE;
+	for (UINT32 Index = 0x00; Index < Count; Index++)
+		pValues[Index] = (UINT64)OutData[Index].EDX << 32 | (UINT64)OutData[Index].EAX;
+	return TRUE;
+}
+
+/// <summary>
+/// Write a MSR via the \\.\KMsr driver. The driver only accepts the MSRs it knows to be safe to write.
+/// </summary>
+static BOOL MsrDriverWrite(
+	_In_ PMSR_BACKEND Backend,
+	_In_ UINT32       Cpu,
+	_In_ UINT32       Msr,
+	_In_ UINT64       Value
+) {
+	// 1. Move to the requested processor
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (Cpu != MSR_CURRENT_CPU && !ThreadPin(Cpu, &Previous))
+		return FALSE;
+
+	// 2. Query the device
+	WRMSR_IN InData = { 0x00 };
+	InData.Msr = Msr;
+	InData.EAX = (UINT32)Value;
+	InData.EDX = (UINT32)(Value >> 32);
+	DWORD dwBytesReturned = 0x00;
+	BOOL bSuccess = DeviceIoControl(
+		(HANDLE)Backend->Context,
+		IOCTL_KMSR_WRITE,
+		&InData,
+		sizeof(WRMSR_IN),
+		NULL,
+		0x00,
+		&dwBytesReturned,
+		NULL
+	);
+
+	// 3. Restore the affinity
+	if (Cpu != MSR_CURRENT_CPU)
+		ThreadRestore(&Previous);
+	return bSuccess;
+}
+
+static VOID MsrDriverClose(
+	_In_ PMSR_BACKEND Backend
+) {
+	CloseHandle((HANDLE)Backend->Context);
+	Backend->Context = NULL;
+}
+#else
+/// <summary>
+/// One lazily opened /dev/cpu/N/msr file descriptor per processor.
+/// </summary>
+typedef struct _MSR_DEVICE_CONTEXT {
+	UINT32 Count;
+	INT    Descriptors[1];
+} MSR_DEVICE_CONTEXT, * PMSR_DEVICE_CONTEXT;
+
+static INT MsrDeviceGet(
+	_In_ PMSR_DEVICE_CONTEXT Context,
+	_In_ UINT32              Cpu
+) {
+	if (Cpu >= Context->Count)
+		return -1;
+	if (Context->Descriptors[Cpu] < 0) {
+		CHAR szPath[64] = { 0x00 };
+		snprintf(szPath, sizeof(szPath), "/dev/cpu/%u/msr", Cpu);
+		Context->Descriptors[Cpu] = open(szPath, O_RDWR | O_CLOEXEC);
+		if (Context->Descriptors[Cpu] < 0)
+			Context->Descriptors[Cpu] = open(szPath, O_RDONLY | O_CLOEXEC);
+	}
+	return Context->Descriptors[Cpu];
+}
+
+/// <summary>
+/// Execute a read or a write via /dev/cpu/N/msr. For the current processor the thread is pinned for the
+/// duration of the access so that thread specific MSRs belong to the caller.
+/// </summary>
+static BOOL MsrDeviceAccess(
+	_In_    PMSR_BACKEND Backend,
+	_In_    UINT32       Cpu,
+	_In_    UINT32       Msr,
+	_Inout_ PUINT64      pValue,
+	_In_    BOOL         bWrite
+) {
+	PMSR_DEVICE_CONTEXT Context = (PMSR_DEVICE_CONTEXT)Backend->Context;
+
+	// 1. Resolve the processor
+	THREAD_AFFINITY Previous = { 0x00 };
+	BOOL bPinned = FALSE;
+	if (Cpu == MSR_CURRENT_CPU) {
+		INT iCpu = sched_getcpu();
+		if (iCpu < 0)
+			return FALSE;
+		Cpu = (UINT32)iCpu;
+		bPinned = ThreadPin(Cpu, &Previous);
+	}
+
+	// 2. The MSR address is the offset in the file
+	INT fd = MsrDeviceGet(Context, Cpu);
+	ssize_t Result = -1;
+	if (fd >= 0) {
+		Result = bWrite
+			? pwrite(fd, pValue, sizeof(UINT64), (off_t)Msr)
+			: pread(fd, pValue, sizeof(UINT64), (off_t)Msr);
+	}
+
+	if (bPinned)
+		ThreadRestore(&Previous);
+	return Result == sizeof(UINT64);
+}
+
+static BOOL MsrDeviceRead(
+	_In_  PMSR_BACKEND Backend,
+	_In_  UINT32       Cpu,
+	_In_  UINT32       Msr,
+	_Out_ PUINT64      pValue
+) {
+	*pValue = 0x00;
+	return MsrDeviceAccess(Backend, Cpu, Msr, pValue, FALSE);
+}
+
+/// <summary>
+/// Read several MSRs via /dev/cpu/N/msr. The driver reads a MSR of another processor through an IPI,
+/// so the thread moves to the processor once and every read is then local.
+/// </summary>
+static BOOL MsrDeviceReadBatch(
+	_In_  PMSR_BACKEND  Backend,
+	_In_  UINT32        Cpu,
+	_In_reads_(Count) const UINT32* pMsrs,
+	_In_  UINT32        Count,
+	_Out_writes_(Count) PUINT64 pValues
+) {
+	PMSR_DEVICE_CONTEXT Context = (PMSR_DEVICE_CONTEXT)Backend->Context;
+	RtlZeroMemory(pValues, Count * sizeof(UINT64));
+
+	// 1. Resolve the processor and move to it
+	if (Cpu == MSR_CURRENT_CPU) {
+		INT iCpu = sched_getcpu();
+		if (iCpu < 0)
+			return FALSE;
+		Cpu = (UINT32)iCpu;
+	}
+	THREAD_AFFINITY Previous = { 0x00 };
+	BOOL bPinned = ThreadPin(Cpu, &Previous);
+
+	// 2. Read every MSR, still correct through IPIs when the thread could not be pinned
+	INT fd = MsrDeviceGet(Context, Cpu);
+	BOOL bSuccess = fd >= 0;
+	for (UINT32 Index = 0x00; bSuccess && Index < Count; Index++)
+		bSuccess = pread(fd, &pValues[Index], sizeof(UINT64), (off_t)pMsrs[Index]) == sizeof(UINT64);
+
+	if (bPinned)
+		ThreadRestore(&Previous);
+	return bSuccess;
+}
+
+static BOOL MsrDeviceWrite(
+	_In_ PMSR_BACKEND Backend,
+	_In_ UINT32       Cpu,
+	_In_ UINT32       Msr,
+	_In_ UINT64       Value
+) {
+	return MsrDeviceAccess(Backend, Cpu, Msr, &Value, TRUE);
+}
+
+static VOID MsrDeviceClose(
+	_In_ PMSR_BACKEND Backend
+) {
+	PMSR_DEVICE_CONTEXT Context = (PMSR_DEVICE_CONTEXT)Backend->Context;
+	for (UINT32 Index = 0x00; Index < Context->Count; Index++) {
+		if (Context->Descriptors[Index] >= 0)
+			close(Context->Descriptors[Index]);
+	}
+	free(Context);
+	Backend->Context = NULL;
+}
+#endif
+
+_Use_decl_annotations_
+BOOL MsrOpen(
+	_Out_ PMSR_BACKEND pBackend
+) {
+	if (pBackend == NULL)
+		return FALSE;
+	RtlZeroMemory(pBackend, sizeof(MSR_BACKEND));
+
+#if defined(_WIN32)
+	// 1. Get an handle to the device object.
+	HANDLE hDevice = CreateFileW(
+		KMSR_DEVICE_PATH,
+		GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL,
+		OPEN_EXISTING,
+		0x00,
+		NULL
+	);
+	if (hDevice == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	// 2. Initialise the backend
+	pBackend->Name = "\\\\.\\KMsr";
+	pBackend->Read = MsrDriverRead;
+	pBackend->Write = MsrDriverWrite;
+	pBackend->ReadBatch = MsrDriverReadBatch;
+	pBackend->Close = MsrDriverClose;
+	pBackend->Context = (PVOID)hDevice;
+#else
+	// 1. Check that the msr module is loaded
+	if (access("/dev/cpu/0/msr", F_OK) != 0x00)
+		return FALSE;
+
+	// 2. Allocate the table of file descriptors
+	UINT32 Count = ThreadGetCpuCount();
+	PMSR_DEVICE_CONTEXT Context = (PMSR_DEVICE_CONTEXT)calloc(1, sizeof(MSR_DEVICE_CONTEXT) + Count * sizeof(INT));
+	if (Context == NULL)
+		return FALSE;
+	Context->Count = Count;
+	for (UINT32 Index = 0x00; Index < Count; Index++)
+		Context->Descriptors[Index] = -1;
+
+	// 3. Initialise the backend
+	pBackend->Name = "/dev/cpu/N/msr";
+	pBackend->Read = MsrDeviceRead;
+	pBackend->Write = MsrDeviceWrite;
+	pBackend->ReadBatch = MsrDeviceReadBatch;
+	pBackend->Close = MsrDeviceClose;
+	pBackend->Context = Context;
+#endif
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL MsrRead(
+	_In_  PMSR_BACKEND pBackend,
+	_In_  UINT32       uiCpu,
+	_In_  UINT32       uiMsr,
+	_Out_ PUINT64      pValue
+) {
+	if (pBackend == NULL || pBackend->Read == NULL || pValue == NULL)
+		return FALSE;
+	return pBackend->Read(pBackend, uiCpu, uiMsr, pValue);
+}
+
+_Use_decl_annotations_
+BOOL MsrReadBatch(
+	_In_  PMSR_BACKEND pBackend,
+	_In_  UINT32       uiCpu,
+	_In_reads_(uiCount) const UINT32* pMsrs,
+	_In_  UINT32       uiCount,
+	_Out_writes_(uiCount) PUINT64 pValues
+) {
+	if (pBackend == NULL || pBackend->Read == NULL || pMsrs == NULL || pValues == NULL || uiCount > MSR_BATCH_MAX)
+		return FALSE;
+	if (pBackend->ReadBatch != NULL)
+		return pBackend->ReadBatch(pBackend, uiCpu, pMsrs, uiCount, pValues);
+
+	// One read per MSR
+	BOOL bSuccess = TRUE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++)
+		bSuccess = pBackend->Read(pBackend, uiCpu, pMsrs[Index], &pValues[Index]) && bSuccess;
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+BOOL MsrWrite(
+	_In_ PMSR_BACKEND pBackend,
+	_In_ UINT32       uiCpu,
+	_In_ UINT32       uiMsr,
+	_In_ UINT64       Value
+) {
+	if (pBackend == NULL || pBackend->Write == NULL)
+		return FALSE;
+	return pBackend->Write(pBackend, uiCpu, uiMsr, Value);
+}
+
+_Use_decl_annotations_
+VOID MsrClose(
+	_In_ PMSR_BACKEND pBackend
+) {
+	if (pBackend == NULL || pBackend->Close == NULL)
+		return;
+	pBackend->Close(pBackend);
+	pBackend->Close = NULL;
+	pBackend->Read = NULL;
+	pBackend->Write = NULL;
+	pBackend->ReadBatch = NULL;
+}
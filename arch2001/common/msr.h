@@ -0,0 +1,209 @@
+/// @file    msr.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __MSR_H_GUARD__
+#define __MSR_H_GUARD__
+#include "ost.h"
+
+/// Example of IA-32 Architectural MSRs
+#define IA32_TSC_MSR        0x00000010 // IA32_TIME_STAMP_COUNTER, Time-Stamp Counter of the processor (R/W)
+#define IA32_TSC_ADJUST_MSR 0x0000003B // Per-processor adjustment added to the TSC, named so as not to clash with the CPUID bit (R/W)
+#define IA32_SPEC_CTRL      0x00000048 // Speculation Control (R/W)
+#define IA32_BIOS_SIGN_ID   0x0000008B // Microcode revision in EDX on Intel, patch level in EAX on AMD (RO)
+#define IA32_UMWAIT_CONTROL 0x000000E1 // UMWAIT Control (R/W)
+#define IA32_MPERF          0x000000E7 // Maximum Performance Frequency Clock Count, TSC rate while in C0 (R/W)
+#define IA32_APERF          0x000000E8 // Actual Performance Frequency Clock Count, core clock while in C0 (R/W)
+#define IA32_MTRRCAP        0x000000FE // MTRR Capability (RO)
+#define IA32_ARCH_CAP_MSR   0x0000010A // IA32_ARCH_CAPABILITIES, hardware immunities to speculative execution issues (RO)
+#define IA32_PERF_STATUS    0x00000198 // Current performance state, ratio in [15:8] on Intel (RO)
+#define IA32_PERF_CTL       0x00000199 // Target performance state, ratio in [15:8] on Intel, ignored once HWP is enabled (R/W)
+#define IA32_MTRR_PHYSBASE0 0x00000200 // Variable Range Base of MTRR 0, IA32_MTRR_PHYSMASK0 follows, one pair per MTRR (R/W)
+#define IA32_MTRR_FIX64K    0x00000250 // Fixed Range MTRR of 00000H-7FFFFH (R/W)
+#define IA32_MTRR_FIX16K    0x00000258 // Fixed Range MTRRs of 80000H-BFFFFH, two MSRs (R/W)
+#define IA32_MTRR_FIX4K     0x00000268 // Fixed Range MTRRs of C0000H-FFFFFH, eight MSRs (R/W)
+#define IA32_PAT            0x00000277 // Page Attribute Table (R/W)
+#define IA32_MTRR_DEF_TYPE  0x000002FF // MTRR Default Memory Type (R/W)
+#define IA32_PM_ENABLE      0x00000770 // Enable of HWP, cannot be cleared before reset (R/W)
+#define IA32_HWP_CAP_MSR    0x00000771 // IA32_HWP_CAPABILITIES, highest, guaranteed, most efficient and lowest performance levels (RO)
+#define IA32_HWP_REQUEST    0x00000774 // Minimum, maximum and desired performance, energy-performance preference (R/W)
+#define IA32_EFER           0xC0000080 // Extended Feature Enables (R/W)
+#define IA32_STAR           0xC0000081 // System Call Target Address (R/W)
+#define IA32_LSTAR          0xC0000082 // IA-32e Mode System Call Target Address (R/W). Target RIP for the called procedure when SYSCALL is executed in 64-bit mode.
+#define IA32_CSTAR          0xC0000083 // IA-32e Mode System Call Target Address (R/W). Not used, as the SYSCALL instruction is not recognized in compatibility mode.
+#define IA32_FMASK          0xC0000084 // System Call Flag Mask (R/W)
+#define IA32_FS_BASE        0xC0000100 // Map of BASE Address of FS (R/W)
+#define IA32_GS_BASE        0xC0000101 // Map of BASE Address of GS (R/W)
+#define IA32_KERNEL_GS_BASE 0xC0000102 // Swap Target of BASE Address of GS (R/W
+#define IA32_TSC_AUX        0xC0000103 // Auxiliary TSC (RW)
+#define IA32_QM_EVTSEL      0x00000C8D // QoS Monitoring Event Select (R/W)
+#define IA32_QM_CTR         0x00000C8E // QoS Monitoring Counter Data (RO)
+#define IA32_PQR_ASSOC      0x00000C8F // Resource Association Register (R/W)
+#define IA32_L3_MASK_0      0x00000C90 // L3 Cache Allocation Mask of COS 0, one MSR per COS (R/W)
+#define IA32_L2_MASK_0      0x00000D10 // L2 Cache Allocation Mask of COS 0, one MSR per COS (R/W)
+#define IA32_MBA_THRTL_0    0x00000D50 // Memory Bandwidth Allocation Delay of COS 0, one MSR per COS (R/W)
+
+/// Processor index meaning "the processor the caller is running on"
+#define MSR_CURRENT_CPU 0xFFFFFFFF
+
+/// Largest number of MSRs read by MsrReadBatch, the limit of IOCTL_KMSR_READ_BATCH
+#define MSR_BATCH_MAX 64
+
+typedef struct _MSR_BACKEND MSR_BACKEND, * PMSR_BACKEND;
+
+/// <summary>
+/// Way to access the MSRs. The default backend goes through the \\.\KMsr driver on Windows and through
+/// /dev/cpu/N/msr on Linux, other backends only have to provide the same routines.
+/// </summary>
+struct _MSR_BACKEND {
+	/// <summary>
+	/// Name of the backend, for display purpose.
+	/// </summary>
+	LPCSTR Name;
+	/// <summary>
+	/// Read a MSR on a given processor.
+	/// </summary>
+	BOOL(*Read)(
+		_In_  PMSR_BACKEND Backend,
+		_In_  UINT32       Cpu,
+		_In_  UINT32       Msr,
+		_Out_ PUINT64      pValue
+	);
+	/// <summary>
+	/// Write a MSR on a given processor. NULL if the backend is read-only.
+	/// </summary>
+	BOOL(*Write)(
+		_In_ PMSR_BACKEND Backend,
+		_In_ UINT32       Cpu,
+		_In_ UINT32       Msr,
+		_In_ UINT64       Value
+	);
+	/// <summary>
+	/// Read several MSRs on a given processor at once. NULL if the backend has no cheaper way than one
+	/// Read per MSR.
+	/// </summary>
+	BOOL(*ReadBatch)(
+		_In_  PMSR_BACKEND  Backend,
+		_In_  UINT32        Cpu,
+		_In_reads_(Count) const UINT32* pMsrs,
+		_In_  UINT32        Count,
+		_Out_writes_(Count) PUINT64 pValues
+	);
+	/// <summary>
+	/// Release the resources of the backend.
+	/// </summary>
+	VOID(*Close)(
+		_In_ PMSR_BACKEND Backend
+	);
+	/// <summary>
+	/// Backend specific data.
+	/// </summary>
+	PVOID Context;
+};
+
+/// <summary>
+/// Open the default MSR backend of the platform.
+/// </summary>
+/// <param name="pBackend">Pointer to the backend to initialise.</param>
+/// <returns>Whether the backend can be used.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MsrOpen(
+	_Out_ PMSR_BACKEND pBackend
+);
+
+/// <summary>
+/// Read a MSR via a backend.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened backend.</param>
+/// <param name="uiCpu">Index of the processor or MSR_CURRENT_CPU.</param>
+/// <param name="uiMsr">Address of the MSR.</param>
+/// <param name="pValue">Pointer to the variable receiving EDX:EAX.</param>
+/// <returns>Whether the MSR has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MsrRead(
+	_In_  PMSR_BACKEND pBackend,
+	_In_  UINT32       uiCpu,
+	_In_  UINT32       uiMsr,
+	_Out_ PUINT64      pValue
+);
+
+/// <summary>
+/// Read several MSRs of the same processor via a backend, moving to the processor once for all of them.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened backend.</param>
+/// <param name="uiCpu">Index of the processor or MSR_CURRENT_CPU.</param>
+/// <param name="pMsrs">Addresses of the MSRs.</param>
+/// <param name="uiCount">Number of MSRs, at most MSR_BATCH_MAX.</param>
+/// <param name="pValues">Array receiving EDX:EAX of every MSR.</param>
+/// <returns>Whether every MSR has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MsrReadBatch(
+	_In_  PMSR_BACKEND pBackend,
+	_In_  UINT32       uiCpu,
+	_In_reads_(uiCount) const UINT32* pMsrs,
+	_In_  UINT32       uiCount,
+	_Out_writes_(uiCount) PUINT64 pValues
+);
+
+/// <summary>
+/// Write a MSR via a backend.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened backend.</param>
+/// <param name="uiCpu">Index of the processor or MSR_CURRENT_CPU.</param>
+/// <param name="uiMsr">Address of the MSR.</param>
+/// <param name="Value">Value to write in EDX:EAX.</param>
+/// <returns>Whether the MSR has been written.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MsrWrite(
+	_In_ PMSR_BACKEND pBackend,
+	_In_ UINT32       uiCpu,
+	_In_ UINT32       uiMsr,
+	_In_ UINT64       Value
+);
+
+/// <summary>
+/// Close a backend.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened backend.</param>
+VOID MsrClose(
+	_In_ PMSR_BACKEND pBackend
+);
+
+/// <summary>
+/// Routine emulating the side effects of a MSR access on the mock backend.
+/// </summary>
+/// <param name="Context">Context given to MsrMockOpen.</param>
+/// <param name="Cpu">Index of the processor.</param>
+/// <param name="Msr">Address of the MSR.</param>
+/// <param name="bWrite">Whether the access is a write.</param>
+/// <param name="pValue">Value written, or value to return for a read.</param>
+/// <returns>Whether the access has been handled. Unhandled accesses use the stored values.</returns>
+typedef BOOL(*MSR_MOCK_HANDLER)(
+	_In_    PVOID   Context,
+	_In_    UINT32  Cpu,
+	_In_    UINT32  Msr,
+	_In_    BOOL    bWrite,
+	_Inout_ PUINT64 pValue
+);
+
+/// <summary>
+/// Open a backend keeping the MSRs in memory, to exercise code using MSRs without the driver or the
+/// hardware. Reads of a MSR never written fail the same way as a missing MSR.
+/// </summary>
+/// <param name="pBackend">Pointer to the backend to initialise.</param>
+/// <param name="uiCpuCount">Number of processors to emulate.</param>
+/// <param name="Handler">Optional routine emulating side effects.</param>
+/// <param name="Context">Context passed to the routine.</param>
+/// <returns>Whether the backend can be used.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MsrMockOpen(
+	_Out_    PMSR_BACKEND     pBackend,
+	_In_     UINT32           uiCpuCount,
+	_In_opt_ MSR_MOCK_HANDLER Handler,
+	_In_opt_ PVOID            Context
+);
+
+#endif // !__MSR_H_GUARD__
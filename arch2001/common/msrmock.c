@@ -0,0 +1,174 @@
+/// @file    msrmock.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "msr.h"
+#include "thread.h"
+
+/// <summary>
+/// Value of a MSR on a processor.
+/// </summary>
+typedef struct _MSR_MOCK_ENTRY {
+	UINT32 Cpu;
+	UINT32 Msr;
+	UINT64 Value;
+} MSR_MOCK_ENTRY, * PMSR_MOCK_ENTRY;
+
+/// <summary>
+/// State of the mock backend. Accesses are not synchronised, the backend is meant to be used by a
+/// single thread.
+/// </summary>
+typedef struct _MSR_MOCK_CONTEXT {
+	UINT32           CpuCount;
+	MSR_MOCK_HANDLER Handler;
+	PVOID            HandlerContext;
+	PMSR_MOCK_ENTRY  Entries;
+	UINT32           Count;
+	UINT32           Capacity;
+} MSR_MOCK_CONTEXT, * PMSR_MOCK_CONTEXT;
+
+/// <summary>
+/// Find the value of a MSR, optionally creating it.
+/// </summary>
+static PMSR_MOCK_ENTRY MsrMockFind(
+	_In_ PMSR_MOCK_CONTEXT Context,
+	_In_ UINT32            Cpu,
+	_In_ UINT32            Msr,
+	_In_ BOOL              bCreate
+) {
+	for (UINT32 Index = 0x00; Index < Context->Count; Index++) {
+		if (Context->Entries[Index].Cpu == Cpu && Context->Entries[Index].Msr == Msr)
+			return &Context->Entries[Index];
+	}
+	if (!bCreate)
+		return NULL;
+
+	if (Context->Count == Context->Capacity) {
+		UINT32 uiCapacity = Context->Capacity ? Context->Capacity * 2 : 64;
+		PMSR_MOCK_ENTRY Entries = (PMSR_MOCK_ENTRY)realloc(Context->Entries, uiCapacity * sizeof(MSR_MOCK_ENTRY));
+		if (Entries == NULL)
+			return NULL;
+		Context->Entries = Entries;
+		Context->Capacity = uiCapacity;
+	}
+	PMSR_MOCK_ENTRY Entry = &Context->Entries[Context->Count++];
+	Entry->Cpu = Cpu;
+	Entry->Msr = Msr;
+	Entry->Value = 0x00;
+	return Entry;
+}
+
+/// <summary>
+/// Resolve MSR_CURRENT_CPU the same way the other backends do.
+/// </summary>
+static BOOL MsrMockResolve(
+	_In_    PMSR_MOCK_CONTEXT Context,
+	_Inout_ PUINT32           pCpu
+) {
+	if (*pCpu == MSR_CURRENT_CPU)
+		*pCpu = ThreadGetCurrentCpu() % Context->CpuCount;
+	return *pCpu < Context->CpuCount;
+}
+
+static BOOL MsrMockRead(
+	_In_  PMSR_BACKEND Backend,
+	_In_  UINT32       Cpu,
+	_In_  UINT32       Msr,
+	_Out_ PUINT64      pValue
+) {
+	PMSR_MOCK_CONTEXT Context = (PMSR_MOCK_CONTEXT)Backend->Context;
+	*pValue = 0x00;
+	if (!MsrMockResolve(Context, &Cpu))
+		return FALSE;
+
+	// 1. Emulated MSRs
+	if (Context->Handler != NULL && Context->Handler(Context->HandlerContext, Cpu, Msr, FALSE, pValue))
+		return TRUE;
+
+	// 2. Stored MSRs
+	PMSR_MOCK_ENTRY Entry = MsrMockFind(Context, Cpu, Msr, FALSE);
+	if (Entry == NULL)
+		return FALSE;
+	*pValue = Entry->Value;
+	return TRUE;
+}
+
+static BOOL MsrMockWrite(
+	_In_ PMSR_BACKEND Backend,
+	_In_ UINT32       Cpu,
+	_In_ UINT32       Msr,
+	_In_ UINT64       Value
+) {
+	PMSR_MOCK_CONTEXT Context = (PMSR_MOCK_CONTEXT)Backend->Context;
+	if (!MsrMockResolve(Context, &Cpu))
+		return FALSE;
+
+	// 1. The handler sees every write, and may reject it
+	if (Context->Handler != NULL && !Context->Handler(Context->HandlerContext, Cpu, Msr, TRUE, &Value))
+		return FALSE;
+
+	// 2. Keep the value so that it can be read back
+	PMSR_MOCK_ENTRY Entry = MsrMockFind(Context, Cpu, Msr, TRUE);
+	if (Entry == NULL)
+		return FALSE;
+	Entry->Value = Value;
+	return TRUE;
+}
+
+static VOID MsrMockClose(
+	_In_ PMSR_BACKEND Backend
+) {
+	PMSR_MOCK_CONTEXT Context = (PMSR_MOCK_CONTEXT)Backend->Context;
+	if (Context == NULL)
+		return;
+	free(Context->Entries);
+	free(Context);
+	Backend->Context = NULL;
+}
+
+/// <summary>
+/// Accept every write when no handler is given.
+/// </summary>
+static BOOL MsrMockDefaultHandler(
+	_In_    PVOID   Context,
+	_In_    UINT32  Cpu,
+	_In_    UINT32  Msr,
+	_In_    BOOL    bWrite,
+	_Inout_ PUINT64 pValue
+) {
+	(VOID)Context;
+	(VOID)Cpu;
+	(VOID)Msr;
+	(VOID)pValue;
+	return bWrite;
+}
+
+_Use_decl_annotations_
+BOOL MsrMockOpen(
+	_Out_    PMSR_BACKEND     pBackend,
+	_In_     UINT32           uiCpuCount,
+	_In_opt_ MSR_MOCK_HANDLER Handler,
+	_In_opt_ PVOID            Context
+) {
+	if (pBackend == NULL || uiCpuCount == 0x00)
+		return FALSE;
+	RtlZeroMemory(pBackend, sizeof(MSR_BACKEND));
+
+	PMSR_MOCK_CONTEXT MockContext = (PMSR_MOCK_CONTEXT)calloc(0x01, sizeof(MSR_MOCK_CONTEXT));
+	if (MockContext == NULL)
+		return FALSE;
+	MockContext->CpuCount = uiCpuCount;
+	MockContext->Handler = Handler != NULL ? Handler : MsrMockDefaultHandler;
+	MockContext->HandlerContext = Context;
+
+	pBackend->Name = "mock";
+	pBackend->Read = MsrMockRead;
+	pBackend->Write = MsrMockWrite;
+	pBackend->Close = MsrMockClose;
+	pBackend->Context = MockContext;
+	return TRUE;
+}
@@ -0,0 +1,301 @@
+/// @file    mtrr.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "mtrr.h"
+
+/// End of the range covered by the fixed-range MTRRs
+#define MTRR_FIXED_END 0x100000ULL
+
+/// Bits of IA32_MTRR_PHYSMASKn
+#define MTRR_MASK_VALID (1ULL << 11)
+
+/// Value of IA32_PAT at reset: WB, WT, UC-, UC, repeated
+#define MTRR_PAT_DEFAULT 0x0007040600070406ULL
+
+/// <summary>
+/// Get the memory type of the fixed-range MTRRs for an address below 1 MiB.
+/// </summary>
+static UINT8 MtrrGetFixedType(
+	_In_ const MTRR_MAP* pMap,
+	_In_ UINT64          Address
+) {
+	UINT32 uiRegister = 0x00;
+	UINT32 uiByte = 0x00;
+	if (Address < 0x80000) {
+		uiByte = (UINT32)(Address >> 16);
+	}
+	else if (Address < 0xC0000) {
+		uiRegister = 1 + (UINT32)((Address - 0x80000) >> 17);
+		uiByte = (UINT32)((Address - 0x80000) >> 14) & 0x07;
+	}
+	else {
+		uiRegister = 3 + (UINT32)((Address - 0xC0000) >> 15);
+		uiByte = (UINT32)((Address - 0xC0000) >> 12) & 0x07;
+	}
+	return (UINT8)(pMap->Fixed[uiRegister] >> (uiByte * 8));
+}
+
+/// <summary>
+/// Apply the precedence rules of the SDM, section 11.11.4.1. Overlaps with undefined results are reported and
+/// resolved as UC.
+/// </summary>
+static UINT8 MtrrResolveType(
+	_In_      const MTRR_MAP* pMap,
+	_In_      UINT64          Address,
+	_Out_opt_ PBOOL           pbConflict
+) {
+	if (pbConflict != NULL)
+		*pbConflict = FALSE;
+
+	// 1. Everything is UC when the MTRRs are disabled
+	if (!pMap->DefaultType.elem.Enable)
+		return MEMORY_TYPE_UC;
+
+	// 2. The fixed-range MTRRs take precedence over the variable-range ones
+	if (Address < MTRR_FIXED_END && pMap->Capabilities.elem.Fixed && pMap->DefaultType.elem.FixedEnable)
+		return MtrrGetFixedType(pMap, Address);
+
+	// 3. Combine the matching variable-range MTRRs
+	BOOL bMatch = FALSE;
+	UINT8 Type = (UINT8)pMap->DefaultType.elem.Type;
+	for (UINT32 Index = 0x00; Index < pMap->VariableCount; Index++) {
+		const MTRR_VARIABLE* pVariable = &pMap->Variables[Index];
+		if (!pVariable->Valid || (Address & pVariable->Mask) != (pVariable->Base & pVariable->Mask))
+			continue;
+		if (!bMatch || Type == pVariable->Type) {
+			Type = pVariable->Type;
+		}
+		else if (Type == MEMORY_TYPE_UC || pVariable->Type == MEMORY_TYPE_UC) {
+			Type = MEMORY_TYPE_UC;
+		}
+		else if ((Type == MEMORY_TYPE_WT && pVariable->Type == MEMORY_TYPE_WB) || (Type == MEMORY_TYPE_WB && pVariable->Type == MEMORY_TYPE_WT)) {
+			Type = MEMORY_TYPE_WT;
+		}
+		else {
+			Type = MEMORY_TYPE_UC;
+			if (pbConflict != NULL)
+				*pbConflict = TRUE;
+		}
+		bMatch = TRUE;
+	}
+	return Type;
+}
+
+/// <summary>
+/// Compare two addresses for qsort.
+/// </summary>
+static int MtrrCompareAddresses(
+	_In_ const void* First,
+	_In_ const void* Second
+) {
+	UINT64 A = *(const UINT64*)First;
+	UINT64 B = *(const UINT64*)Second;
+	return A < B ? -1 : A > B;
+}
+
+_Use_decl_annotations_
+BOOL MtrrBuild(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_In_  UINT32       uiPhysicalBits,
+	_Out_ PMTRR_MAP    pMap
+) {
+	if (pMsr == NULL || pMap == NULL)
+		return FALSE;
+	RtlZeroMemory(pMap, sizeof(MTRR_MAP));
+	pMap->PhysicalBits = uiPhysicalBits != 0x00 && uiPhysicalBits <= 52 ? uiPhysicalBits : MTRR_DEFAULT_PHYSICAL_BITS;
+	UINT64 Top = 1ULL << pMap->PhysicalBits;
+	UINT64 AddressMask = (Top - 1) & ~0xFFFULL;
+
+	// 1. Read the capabilities, the default type and the PAT
+	if (!MsrRead(pMsr, uiCpu, IA32_MTRRCAP, &pMap->Capabilities.value)
+		|| !MsrRead(pMsr, uiCpu, IA32_MTRR_DEF_TYPE, &pMap->DefaultType.value))
+		return FALSE;
+	if (!MsrRead(pMsr, uiCpu, IA32_PAT, &pMap->Pat))
+		pMap->Pat = MTRR_PAT_DEFAULT;
+
+	// 2. Read the fixed-range MTRRs
+	for (UINT32 Index = 0x00; pMap->Capabilities.elem.Fixed && Index < MTRR_FIXED_COUNT; Index++) {
+		UINT32 uiMsr = Index == 0x00 ? IA32_MTRR_FIX64K : Index < 3 ? IA32_MTRR_FIX16K + Index - 1 : IA32_MTRR_FIX4K + Index - 3;
+		if (!MsrRead(pMsr, uiCpu, uiMsr, &pMap->Fixed[Index]))
+			return FALSE;
+	}
+
+	// 3. Read the variable-range MTRRs
+	pMap->VariableCount = (UINT32)pMap->Capabilities.elem.VariableCount;
+	pMap->Variables = (PMTRR_VARIABLE)calloc(pMap->VariableCount + 1, sizeof(MTRR_VARIABLE));
+	if (pMap->Variables == NULL)
+		return FALSE;
+	for (UINT32 Index = 0x00; Index < pMap->VariableCount; Index++) {
+		PMTRR_VARIABLE pVariable = &pMap->Variables[Index];
+		UINT64 Base = 0x00;
+		UINT64 Mask = 0x00;
+		if (!MsrRead(pMsr, uiCpu, IA32_MTRR_PHYSBASE0 + Index * 2, &Base)
+			|| !MsrRead(pMsr, uiCpu, IA32_MTRR_PHYSBASE0 + Index * 2 + 1, &Mask)) {
+			MtrrFree(pMap);
+			return FALSE;
+		}
+		pVariable->Type = (UINT8)Base;
+		pVariable->Base = Base & AddressMask;
+		pVariable->Mask = Mask & AddressMask;
+		pVariable->Valid = (Mask & MTRR_MASK_VALID) != 0x00;
+
+		UINT64 Inverse = ~pVariable->Mask & (Top - 1);
+		pVariable->Contiguous = (Inverse & (Inverse + 1)) == 0x00;
+		if (pVariable->Valid && !pVariable->Contiguous)
+			pMap->bIrregular = TRUE;
+	}
+
+	// 4. Collect the addresses where the memory type may change
+	UINT32 uiCount = 0x00;
+	PUINT64 Boundaries = (PUINT64)calloc(88 + 3 + pMap->VariableCount * 2, sizeof(UINT64));
+	if (Boundaries == NULL) {
+		MtrrFree(pMap);
+		return FALSE;
+	}
+	Boundaries[uiCount++] = 0x00;
+	Boundaries[uiCount++] = MTRR_FIXED_END;
+	Boundaries[uiCount++] = Top;
+	for (UINT64 Address = 0x00; Address < MTRR_FIXED_END; Address += Address < 0x80000 ? 0x10000 : Address < 0xC0000 ? 0x4000 : 0x1000)
+		Boundaries[uiCount++] = Address;
+	for (UINT32 Index = 0x00; Index < pMap->VariableCount; Index++) {
+		const MTRR_VARIABLE* pVariable = &pMap->Variables[Index];
+		if (!pVariable->Valid || !pVariable->Contiguous)
+			continue;
+		UINT64 Start = pVariable->Base & pVariable->Mask;
+		Boundaries[uiCount++] = Start;
+		Boundaries[uiCount++] = Start + ((~pVariable->Mask & (Top - 1)) + 1);
+	}
+	qsort(Boundaries, uiCount, sizeof(UINT64), MtrrCompareAddresses);
+
+	// 5. Resolve the type of each interval and merge the adjacent ones of the same type
+	pMap->Ranges = (PMTRR_RANGE)calloc(uiCount, sizeof(MTRR_RANGE));
+	if (pMap->Ranges == NULL) {
+		free(Boundaries);
+		MtrrFree(pMap);
+		return FALSE;
+	}
+	for (UINT32 Index = 0x00; Index + 1 < uiCount && Boundaries[Index] < Top; Index++) {
+		UINT64 Start = Boundaries[Index];
+		UINT64 End = Boundaries[Index + 1] < Top ? Boundaries[Index + 1] : Top;
+		if (Start == End)
+			continue;
+
+		BOOL bConflict = FALSE;
+		UINT8 Type = MtrrResolveType(pMap, Start, &bConflict);
+		pMap->bIrregular |= bConflict;
+		if (pMap->RangeCount != 0x00 && pMap->Ranges[pMap->RangeCount - 1].Type == Type) {
+			pMap->Ranges[pMap->RangeCount - 1].End = End;
+			continue;
+		}
+		pMap->Ranges[pMap->RangeCount].Start = Start;
+		pMap->Ranges[pMap->RangeCount].End = End;
+		pMap->Ranges[pMap->RangeCount].Type = Type;
+		pMap->RangeCount++;
+	}
+	free(Boundaries);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID MtrrFree(
+	_Inout_ PMTRR_MAP pMap
+) {
+	if (pMap == NULL)
+		return;
+	free(pMap->Variables);
+	free(pMap->Ranges);
+	pMap->Variables = NULL;
+	pMap->Ranges = NULL;
+	pMap->VariableCount = 0x00;
+	pMap->RangeCount = 0x00;
+}
+
+_Use_decl_annotations_
+UINT8 MtrrResolve(
+	_In_ const MTRR_MAP* pMap,
+	_In_ UINT64          Address
+) {
+	return MtrrResolveType(pMap, Address, NULL);
+}
+
+_Use_decl_annotations_
+BOOL MtrrLookup(
+	_In_  const MTRR_MAP* pMap,
+	_In_  UINT64          Start,
+	_In_  UINT64          End,
+	_Out_ PUINT8          pType
+) {
+	*pType = MEMORY_TYPE_MIXED;
+	if (pMap->RangeCount == 0x00 || Start >= End || End > pMap->Ranges[pMap->RangeCount - 1].End)
+		return FALSE;
+
+	// 1. Find the range holding the first address
+	UINT32 uiLow = 0x00;
+	UINT32 uiHigh = pMap->RangeCount - 1;
+	while (uiLow < uiHigh) {
+		UINT32 uiMiddle = (uiLow + uiHigh) / 2;
+		if (pMap->Ranges[uiMiddle].End <= Start)
+			uiLow = uiMiddle + 1;
+		else
+			uiHigh = uiMiddle;
+	}
+
+	// 2. Adjacent ranges have different types, the lookup range is mixed if it goes beyond the first one
+	*pType = End <= pMap->Ranges[uiLow].End ? pMap->Ranges[uiLow].Type : MEMORY_TYPE_MIXED;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+UINT8 MtrrGetPatType(
+	_In_ UINT64 Pat,
+	_In_ UINT32 uiIndex
+) {
+	return (UINT8)(Pat >> ((uiIndex & 0x07) * 8)) & 0x07;
+}
+
+_Use_decl_annotations_
+UINT8 MtrrCombine(
+	_In_ UINT8 MtrrType,
+	_In_ UINT8 PatType
+) {
+	if (MtrrType == MEMORY_TYPE_MIXED)
+		return MEMORY_TYPE_MIXED;
+
+	// Table 11-7 of the SDM, the PAT type selects the row
+	switch (PatType) {
+	case MEMORY_TYPE_WC:
+		return MEMORY_TYPE_WC;
+	case MEMORY_TYPE_UC_MINUS:
+		return MtrrType == MEMORY_TYPE_WC || MtrrType == MEMORY_TYPE_WP ? MEMORY_TYPE_WC : MEMORY_TYPE_UC;
+	case MEMORY_TYPE_WT:
+		return MtrrType == MEMORY_TYPE_UC || MtrrType == MEMORY_TYPE_WC ? MEMORY_TYPE_UC : MEMORY_TYPE_WT;
+	case MEMORY_TYPE_WP:
+		return MtrrType == MEMORY_TYPE_UC || MtrrType == MEMORY_TYPE_WC ? MEMORY_TYPE_UC : MEMORY_TYPE_WP;
+	case MEMORY_TYPE_WB:
+		return MtrrType;
+	default:
+		return MEMORY_TYPE_UC;
+	}
+}
+
+_Use_decl_annotations_
+LPCSTR MtrrGetTypeName(
+	_In_ UINT8 Type
+) {
+	switch (Type) {
+	case MEMORY_TYPE_UC:       return "UC";
+	case MEMORY_TYPE_WC:       return "WC";
+	case MEMORY_TYPE_WT:       return "WT";
+	case MEMORY_TYPE_WP:       return "WP";
+	case MEMORY_TYPE_WB:       return "WB";
+	case MEMORY_TYPE_UC_MINUS: return "UC-";
+	case MEMORY_TYPE_MIXED:    return "mixed";
+	default:                   return "reserved";
+	}
+}
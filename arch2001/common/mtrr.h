@@ -0,0 +1,175 @@
+/// @file    mtrr.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __MTRR_H_GUARD__
+#define __MTRR_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// Memory types of the MTRRs and of the PAT
+#define MEMORY_TYPE_UC       0x00 // Uncacheable
+#define MEMORY_TYPE_WC       0x01 // Write Combining
+#define MEMORY_TYPE_WT       0x04 // Write Through
+#define MEMORY_TYPE_WP       0x05 // Write Protected
+#define MEMORY_TYPE_WB       0x06 // Write Back
+#define MEMORY_TYPE_UC_MINUS 0x07 // Uncacheable, overridable by a WC MTRR. PAT only.
+#define MEMORY_TYPE_MIXED    0xFF // Range covering several memory types.
+
+/// Number of fixed-range MTRRs, each one holding eight types
+#define MTRR_FIXED_COUNT 11
+
+/// Default width of the physical addresses when CPUID.80000008H is not available
+#define MTRR_DEFAULT_PHYSICAL_BITS 36
+
+/// <summary>
+/// Bits of IA32_MTRRCAP.
+/// </summary>
+typedef union _MTRR_CAPABILITIES {
+	struct {
+		UINT64 VariableCount : 8; // Number of variable-range MTRRs.
+		UINT64 Fixed : 1;
+		UINT64 Reserved1 : 1;
+		UINT64 WriteCombining : 1;
+		UINT64 Smrr : 1;
+		UINT64 Reserved2 : 52;
+	} elem;
+	UINT64 value;
+} MTRR_CAPABILITIES;
+
+/// <summary>
+/// Bits of IA32_MTRR_DEF_TYPE.
+/// </summary>
+typedef union _MTRR_DEFAULT_TYPE {
+	struct {
+		UINT64 Type : 8;
+		UINT64 Reserved1 : 2;
+		UINT64 FixedEnable : 1;
+		UINT64 Enable : 1;
+		UINT64 Reserved2 : 52;
+	} elem;
+	UINT64 value;
+} MTRR_DEFAULT_TYPE;
+
+/// <summary>
+/// Variable-range MTRR, as a pair of IA32_MTRR_PHYSBASEn and IA32_MTRR_PHYSMASKn.
+/// </summary>
+typedef struct _MTRR_VARIABLE {
+	UINT64 Base;
+	UINT64 Mask;
+	UINT8  Type;
+	BOOL   Valid;
+	BOOL   Contiguous; // Whether the mask describes a single range. Other masks are legal but never used in practice.
+} MTRR_VARIABLE, * PMTRR_VARIABLE;
+
+/// <summary>
+/// Physical range with a single memory type.
+/// </summary>
+typedef struct _MTRR_RANGE {
+	UINT64 Start;
+	UINT64 End;   // Exclusive.
+	UINT8  Type;
+} MTRR_RANGE, * PMTRR_RANGE;
+
+/// <summary>
+/// MTRRs and PAT of a processor, with the physical address space split into ranges of a single memory type.
+/// </summary>
+typedef struct _MTRR_MAP {
+	MTRR_CAPABILITIES Capabilities;
+	MTRR_DEFAULT_TYPE DefaultType;
+	UINT64            Pat;
+	UINT64            Fixed[MTRR_FIXED_COUNT];
+	PMTRR_VARIABLE    Variables;
+	UINT32            VariableCount;
+	UINT32            PhysicalBits;
+	PMTRR_RANGE       Ranges;       // Sorted and adjacent, from 0 to the top of the physical address space.
+	UINT32            RangeCount;
+	BOOL              bIrregular;   // Non-contiguous masks or overlaps with undefined results were found.
+} MTRR_MAP, * PMTRR_MAP;
+
+/// <summary>
+/// Read the MTRRs and the PAT of a processor and build the map of the physical address space.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend.</param>
+/// <param name="uiCpu">Index of the processor or MSR_CURRENT_CPU. The MTRRs are identical on every processor.</param>
+/// <param name="uiPhysicalBits">Width of the physical addresses, CPUID.80000008H:EAX[7:0], or 0 for the default.</param>
+/// <param name="pMap">Pointer to the map to build.</param>
+/// <returns>Whether the MSRs have been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MtrrBuild(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_In_  UINT32       uiPhysicalBits,
+	_Out_ PMTRR_MAP    pMap
+);
+
+/// <summary>
+/// Release the memory allocated for a map.
+/// </summary>
+/// <param name="pMap">Pointer to the map.</param>
+VOID MtrrFree(
+	_Inout_ PMTRR_MAP pMap
+);
+
+/// <summary>
+/// Get the memory type the MTRRs give to a physical address, applying the precedence rules of the SDM.
+/// </summary>
+/// <param name="pMap">Pointer to the map.</param>
+/// <param name="Address">Physical address.</param>
+/// <returns>The MEMORY_TYPE_* value.</returns>
+UINT8 MtrrResolve(
+	_In_ const MTRR_MAP* pMap,
+	_In_ UINT64          Address
+);
+
+/// <summary>
+/// Get the memory type the MTRRs give to a physical range, with a binary search of the map.
+/// </summary>
+/// <param name="pMap">Pointer to the map.</param>
+/// <param name="Start">First physical address of the range.</param>
+/// <param name="End">Physical address following the range.</param>
+/// <param name="pType">Pointer receiving the MEMORY_TYPE_* value, or MEMORY_TYPE_MIXED.</param>
+/// <returns>Whether the range is within the physical address space.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL MtrrLookup(
+	_In_  const MTRR_MAP* pMap,
+	_In_  UINT64          Start,
+	_In_  UINT64          End,
+	_Out_ PUINT8          pType
+);
+
+/// <summary>
+/// Get the memory type of an entry of the PAT.
+/// </summary>
+/// <param name="Pat">Value of IA32_PAT.</param>
+/// <param name="uiIndex">Index of the entry, PAT:PCD:PWT bits of the paging structure entry.</param>
+/// <returns>The MEMORY_TYPE_* value.</returns>
+UINT8 MtrrGetPatType(
+	_In_ UINT64 Pat,
+	_In_ UINT32 uiIndex
+);
+
+/// <summary>
+/// Combine the memory types of the MTRRs and of the PAT into the effective memory type.
+/// </summary>
+/// <param name="MtrrType">Memory type of the MTRRs.</param>
+/// <param name="PatType">Memory type of the PAT entry.</param>
+/// <returns>The effective MEMORY_TYPE_* value, or MEMORY_TYPE_MIXED if the MTRR type is mixed.</returns>
+UINT8 MtrrCombine(
+	_In_ UINT8 MtrrType,
+	_In_ UINT8 PatType
+);
+
+/// <summary>
+/// Get the name of a memory type.
+/// </summary>
+/// <param name="Type">MEMORY_TYPE_* value.</param>
+/// <returns>Short name of the type.</returns>
+LPCSTR MtrrGetTypeName(
+	_In_ UINT8 Type
+);
+
+#endif // !__MTRR_H_GUARD__
@@ -0,0 +1,80 @@
+/// @file    ost.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __OST_H_GUARD__
+#define __OST_H_GUARD__
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// Windows data types used across the code base.
+typedef void           VOID, *PVOID;
+typedef char           CHAR, *PCHAR;
+typedef const char*    LPCSTR;
+typedef char*          LPSTR;
+typedef int            INT, *PINT;
+typedef unsigned int   UINT, *PUINT;
+typedef int            BOOL, *PBOOL;
+typedef uint8_t        BYTE, *PBYTE;
+typedef uint16_t       WORD, *PWORD;
+typedef uint32_t       DWORD, *PDWORD;
+typedef uint64_t       DWORD64, *PDWORD64;
+typedef int8_t         INT8, *PINT8;
+typedef int16_t        INT16, *PINT16;
+typedef int32_t        INT32, *PINT32;
+typedef int64_t        INT64, *PINT64;
+typedef uint8_t        UINT8, *PUINT8;
+typedef uint16_t       UINT16, *PUINT16;
+typedef uint32_t       UINT32, *PUINT32;
+typedef uint64_t       UINT64, *PUINT64;
+typedef uint32_t       ULONG, *PULONG;
+typedef size_t         SIZE_T, *PSIZE_T;
+typedef uintptr_t      ULONG_PTR;
+typedef int            HANDLE, *PHANDLE;
+
+#define TRUE  1
+#define FALSE 0
+#define INVALID_HANDLE_VALUE (-1)
+
+#ifdef __cplusplus
+#define EXTERN_C extern "C"
+#else
+#define EXTERN_C extern
+#endif
+#define STDMETHODCALLTYPE
+#define FORCEINLINE static inline __attribute__((always_inline))
+#define DECLSPEC_ALIGN(x) __attribute__((aligned(x)))
+
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0x00, (Length))
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define MAX_PATH 260
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define C_ASSERT(e) _Static_assert(e, #e)
+
+/// Source code annotation language (SAL) is only understood by the Microsoft compiler.
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _In_reads_(x)
+#define _In_reads_bytes_(x)
+#define _Out_writes_(x)
+#define _Out_writes_opt_(x)
+#define _Out_writes_bytes_(x)
+#define _Inout_updates_(x)
+#define _Success_(x)
+#define _Must_inspect_result_
+#define _Use_decl_annotations_
+#endif // !_WIN32
+
+#endif // !__OST_H_GUARD__
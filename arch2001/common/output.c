@@ -0,0 +1,493 @@
+/// @file    output.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "output.h"
+#include <string.h>
+
+/// Pairs of decimal digits, so that the integers are formatted two digits per division
+static const CHAR g_OutputDigits[201] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const CHAR g_OutputHexDigits[17] = "0123456789abcdef";
+
+static LPCSTR g_OutputFormatNames[OutputFormatCount] = { "text", "jsonl", "csv", "binary" };
+
+/// <summary>
+/// Pass bytes to the sink. After a failure, the bytes are discarded.
+/// </summary>
+static VOID OutputWrite(
+	_Inout_ POUTPUT pOutput,
+	_In_reads_bytes_(Size) const VOID* pData,
+	_In_    SIZE_T  Size
+) {
+	if (Size == 0x00 || pOutput->bFailed)
+		return;
+	if (pOutput->Sink(pOutput->Context, pData, Size))
+		pOutput->Bytes += Size;
+	else
+		pOutput->bFailed = TRUE;
+}
+
+/// <summary>
+/// Pass the completed records to the sink and move the record being written to the beginning of the buffer.
+/// </summary>
+static VOID OutputDrain(
+	_Inout_ POUTPUT pOutput
+) {
+	OutputWrite(pOutput, pOutput->Buffer, pOutput->Record);
+	memmove(pOutput->Buffer, pOutput->Buffer + pOutput->Record, pOutput->Length - pOutput->Record);
+	pOutput->Length -= pOutput->Record;
+	pOutput->Record = 0x00;
+}
+
+/// <summary>
+/// Get room for a number of bytes at the end of the buffer, draining it if needed.
+/// </summary>
+/// <returns>Pointer to the room, or NULL if the record does not fit in the buffer.</returns>
+static PCHAR OutputReserve(
+	_Inout_ POUTPUT pOutput,
+	_In_    SIZE_T  Size
+) {
+	if (pOutput->bDropped)
+		return NULL;
+	if (pOutput->Length + Size > pOutput->Capacity) {
+		OutputDrain(pOutput);
+		if (pOutput->Length + Size > pOutput->Capacity) {
+			pOutput->bDropped = TRUE;
+			return NULL;
+		}
+	}
+	return pOutput->Buffer + pOutput->Length;
+}
+
+/// <summary>
+/// Write the separator and the name of a field, and get room for its value.
+/// </summary>
+/// <returns>Pointer to the room for the value, or NULL if the record has been dropped.</returns>
+static PCHAR OutputField(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    SIZE_T  ValueSize
+) {
+	SIZE_T cchName = strlen(szName);
+	PCHAR Cursor = OutputReserve(pOutput, cchName + ValueSize + 0x04);
+	if (Cursor == NULL)
+		return NULL;
+
+	pOutput->Fields++;
+	switch (pOutput->Format) {
+	case OutputText:
+		*Cursor++ = ' ';
+		memcpy(Cursor, szName, cchName);
+		Cursor += cchName;
+		*Cursor++ = '=';
+		break;
+	case OutputJsonLines:
+		*Cursor++ = ',';
+		*Cursor++ = '"';
+		memcpy(Cursor, szName, cchName);
+		Cursor += cchName;
+		*Cursor++ = '"';
+		*Cursor++ = ':';
+		break;
+	case OutputCsv:
+		*Cursor++ = ',';
+		if (pOutput->bHeader) {
+			// A header without the name would not match the values, the record is dropped as when too large
+			if (pOutput->HeaderLength + cchName + 0x02 >= OUTPUT_HEADER_SIZE) {
+				pOutput->bDropped = TRUE;
+				return NULL;
+			}
+			pOutput->Header[pOutput->HeaderLength++] = ',';
+			memcpy(&pOutput->Header[pOutput->HeaderLength], szName, cchName);
+			pOutput->HeaderLength += cchName;
+		}
+		break;
+	default:
+		break;
+	}
+	return Cursor;
+}
+
+/// <summary>
+/// Write a 64-bit value of the binary format.
+/// </summary>
+static PCHAR OutputPut64(
+	_Out_writes_bytes_(8) PCHAR Cursor,
+	_In_ UINT64 Value
+) {
+	memcpy(Cursor, &Value, sizeof(UINT64));
+	return Cursor + sizeof(UINT64);
+}
+
+_Use_decl_annotations_
+BOOL OutputOpen(
+	_Out_ POUTPUT       pOutput,
+	_In_  OUTPUT_FORMAT Format,
+	_Out_writes_bytes_(Capacity) PVOID pBuffer,
+	_In_  SIZE_T        Capacity,
+	_In_  OUTPUT_SINK   Sink,
+	_In_opt_ PVOID      Context
+) {
+	RtlZeroMemory(pOutput, sizeof(OUTPUT));
+	if ((UINT32)Format >= OutputFormatCount || pBuffer == NULL || Capacity == 0x00 || Sink == NULL)
+		return FALSE;
+
+	pOutput->Format = Format;
+	pOutput->Sink = Sink;
+	pOutput->Context = Context;
+	pOutput->Buffer = (PCHAR)pBuffer;
+	pOutput->Capacity = Capacity;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL OutputFileSink(
+	_In_ PVOID                    Context,
+	_In_reads_bytes_(Size) const VOID* pData,
+	_In_ SIZE_T                   Size
+) {
+	return fwrite(pData, 0x01, Size, (FILE*)Context) == Size;
+}
+
+_Use_decl_annotations_
+VOID OutputBegin(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szRecord
+) {
+	pOutput->Record = pOutput->Length;
+	pOutput->Fields = 0x00;
+	pOutput->bDropped = pOutput->bFailed;
+
+	SIZE_T cchRecord = strlen(szRecord);
+	cchRecord = cchRecord < OUTPUT_NAME_SIZE - 1 ? cchRecord : OUTPUT_NAME_SIZE - 1;
+	PCHAR Cursor = OutputReserve(pOutput, cchRecord + sizeof(OUTPUT_BINARY_HEADER) + 0x10);
+	if (Cursor == NULL)
+		return;
+
+	switch (pOutput->Format) {
+	case OutputJsonLines:
+		memcpy(Cursor, "{\"record\":\"", 11);
+		Cursor += 11;
+		memcpy(Cursor, szRecord, cchRecord);
+		Cursor += cchRecord;
+		*Cursor++ = '"';
+		break;
+	case OutputCsv:
+		// The header line is built with the fields and written with the first record of a new name
+		pOutput->bHeader = strncmp(pOutput->Schema, szRecord, OUTPUT_NAME_SIZE - 1) != 0x00 || pOutput->Schema[cchRecord] != '\0';
+		if (pOutput->bHeader) {
+			memcpy(pOutput->Header, "record", 6);
+			pOutput->HeaderLength = 6;
+		}
+		// fallthrough
+	case OutputText:
+		memcpy(Cursor, szRecord, cchRecord);
+		Cursor += cchRecord;
+		break;
+	case OutputBinary: {
+		OUTPUT_BINARY_HEADER Header = { 0x00 };
+		Header.Tag = 0x811C9DC5;
+		for (SIZE_T Index = 0x00; Index < cchRecord; Index++)
+			Header.Tag = (Header.Tag ^ (BYTE)szRecord[Index]) * 0x01000193;
+		memcpy(Cursor, &Header, sizeof(Header));
+		Cursor += sizeof(Header);
+		break;
+	}
+	default:
+		break;
+	}
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+}
+
+_Use_decl_annotations_
+VOID OutputUnsigned(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    UINT64  Value
+) {
+	PCHAR Cursor = OutputField(pOutput, szName, OUTPUT_UNSIGNED_DIGITS);
+	if (Cursor == NULL)
+		return;
+	if (pOutput->Format == OutputBinary)
+		Cursor = OutputPut64(Cursor, Value);
+	else
+		Cursor += OutputFormatUnsigned(Value, Cursor);
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+}
+
+_Use_decl_annotations_
+VOID OutputSigned(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    INT64   Value
+) {
+	PCHAR Cursor = OutputField(pOutput, szName, OUTPUT_UNSIGNED_DIGITS + 0x01);
+	if (Cursor == NULL)
+		return;
+	if (pOutput->Format == OutputBinary) {
+		Cursor = OutputPut64(Cursor, (UINT64)Value);
+	}
+	else {
+		if (Value < 0x00)
+			*Cursor++ = '-';
+		Cursor += OutputFormatUnsigned(Value < 0x00 ? 0x00 - (UINT64)Value : (UINT64)Value, Cursor);
+	}
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+}
+
+_Use_decl_annotations_
+VOID OutputHex(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    UINT64  Value,
+	_In_    UINT32  uiDigits
+) {
+	PCHAR Cursor = OutputField(pOutput, szName, OUTPUT_HEX_DIGITS + 0x04);
+	if (Cursor == NULL)
+		return;
+	if (pOutput->Format == OutputBinary) {
+		Cursor = OutputPut64(Cursor, Value);
+	}
+	else {
+		if (pOutput->Format == OutputJsonLines)
+			*Cursor++ = '"';
+		*Cursor++ = '0';
+		*Cursor++ = 'x';
+		Cursor += OutputFormatHex(Value, uiDigits, Cursor);
+		if (pOutput->Format == OutputJsonLines)
+			*Cursor++ = '"';
+	}
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+}
+
+_Use_decl_annotations_
+VOID OutputBool(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    BOOL    bValue
+) {
+	PCHAR Cursor = OutputField(pOutput, szName, 0x08);
+	if (Cursor == NULL)
+		return;
+	if (pOutput->Format == OutputBinary) {
+		Cursor = OutputPut64(Cursor, bValue ? 0x01 : 0x00);
+	}
+	else {
+		memcpy(Cursor, bValue ? "true" : "false", bValue ? 4 : 5);
+		Cursor += bValue ? 4 : 5;
+	}
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+}
+
+_Use_decl_annotations_
+VOID OutputString(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_reads_(cchMaximum) LPCSTR szValue,
+	_In_    SIZE_T  cchMaximum
+) {
+	// 1. Length of the value and room for the worst case: every character escaped as \u00XX in JSON
+	LPCSTR szEnd = (LPCSTR)memchr(szValue, '\0', cchMaximum);
+	SIZE_T cchValue = szEnd != NULL ? (SIZE_T)(szEnd - szValue) : cchMaximum;
+	PCHAR Cursor = OutputField(pOutput, szName, cchValue * 6 + sizeof(UINT64) * 2);
+	if (Cursor == NULL)
+		return;
+
+	// 2. Value, escaped according to the format
+	switch (pOutput->Format) {
+	case OutputJsonLines:
+		*Cursor++ = '"';
+		for (SIZE_T Index = 0x00; Index < cchValue; Index++) {
+			BYTE Character = (BYTE)szValue[Index];
+			if (Character == '"' || Character == '\\') {
+				*Cursor++ = '\\';
+				*Cursor++ = (CHAR)Character;
+			}
+			else if (Character < 0x20) {
+				memcpy(Cursor, "\\u00", 4);
+				Cursor[4] = g_OutputHexDigits[Character >> 4];
+				Cursor[5] = g_OutputHexDigits[Character & 0x0F];
+				Cursor += 6;
+			}
+			else {
+				*Cursor++ = (CHAR)Character;
+			}
+		}
+		*Cursor++ = '"';
+		break;
+	case OutputCsv: {
+		BOOL bQuoted = FALSE;
+		for (SIZE_T Index = 0x00; Index < cchValue && !bQuoted; Index++)
+			bQuoted = szValue[Index] == ',' || szValue[Index] == '"' || szValue[Index] == '\n' || szValue[Index] == '\r';
+		if (bQuoted)
+			*Cursor++ = '"';
+		for (SIZE_T Index = 0x00; Index < cchValue; Index++) {
+			if (szValue[Index] == '"')
+				*Cursor++ = '"';
+			*Cursor++ = szValue[Index];
+		}
+		if (bQuoted)
+			*Cursor++ = '"';
+		break;
+	}
+	case OutputBinary: {
+		SIZE_T Padded = (cchValue + sizeof(UINT64) - 1) & ~(sizeof(UINT64) - 1);
+		Cursor = OutputPut64(Cursor, cchValue);
+		memcpy(Cursor, szValue, cchValue);
+		RtlZeroMemory(Cursor + cchValue, Padded - cchValue);
+		Cursor += Padded;
+		break;
+	}
+	default:
+		memcpy(Cursor, szValue, cchValue);
+		Cursor += cchValue;
+		break;
+	}
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+}
+
+_Use_decl_annotations_
+BOOL OutputEnd(
+	_Inout_ POUTPUT pOutput
+) {
+	// 1. Terminate the record
+	PCHAR Cursor = OutputReserve(pOutput, 0x02);
+	SIZE_T Size = pOutput->Length - pOutput->Record;
+	if (Cursor == NULL || pOutput->bFailed || (pOutput->Format == OutputBinary && Size > 0xFFFF)) {
+		pOutput->Length = pOutput->Record;
+		pOutput->bDropped = FALSE;
+		pOutput->Dropped++;
+		return FALSE;
+	}
+
+	switch (pOutput->Format) {
+	case OutputJsonLines:
+		*Cursor++ = '}';
+		// fallthrough
+	case OutputText:
+	case OutputCsv:
+		*Cursor++ = '\n';
+		break;
+	case OutputBinary: {
+		POUTPUT_BINARY_HEADER Header = (POUTPUT_BINARY_HEADER)(pOutput->Buffer + pOutput->Record);
+		Header->Size = (UINT16)Size;
+		Header->Fields = (UINT16)pOutput->Fields;
+		break;
+	}
+	default:
+		break;
+	}
+	pOutput->Length = (SIZE_T)(Cursor - pOutput->Buffer);
+
+	// 2. Insert the CSV header line before the first record of a new name
+	if (pOutput->Format == OutputCsv && pOutput->bHeader) {
+		PCHAR szRecord = pOutput->Buffer + pOutput->Record;
+		SIZE_T cchRecord = 0x00;
+		while (cchRecord < OUTPUT_NAME_SIZE - 1 && szRecord[cchRecord] != ',' && szRecord[cchRecord] != '\n')
+			cchRecord++;
+		RtlZeroMemory(pOutput->Schema, sizeof(pOutput->Schema));
+		memcpy(pOutput->Schema, szRecord, cchRecord);
+
+		pOutput->Header[pOutput->HeaderLength++] = '\n';
+		OutputWrite(pOutput, pOutput->Buffer, pOutput->Record);
+		OutputWrite(pOutput, pOutput->Header, pOutput->HeaderLength);
+		memmove(pOutput->Buffer, szRecord, pOutput->Length - pOutput->Record);
+		pOutput->Length -= pOutput->Record;
+		pOutput->bHeader = FALSE;
+	}
+	pOutput->Record = pOutput->Length;
+	pOutput->Records++;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL OutputFlush(
+	_Inout_ POUTPUT pOutput
+) {
+	OutputDrain(pOutput);
+	return !pOutput->bFailed;
+}
+
+_Use_decl_annotations_
+BOOL OutputClose(
+	_Inout_ POUTPUT pOutput
+) {
+	pOutput->Length = pOutput->Record;
+	BOOL bSuccess = OutputFlush(pOutput);
+	pOutput->Buffer = NULL;
+	pOutput->Capacity = 0x00;
+	pOutput->Length = 0x00;
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+BOOL OutputGetFormat(
+	_In_  LPCSTR         szName,
+	_Out_ OUTPUT_FORMAT* pFormat
+) {
+	for (UINT32 Index = 0x00; Index < OutputFormatCount; Index++) {
+		if (strcmp(szName, g_OutputFormatNames[Index]) == 0x00) {
+			*pFormat = (OUTPUT_FORMAT)Index;
+			return TRUE;
+		}
+	}
+	*pFormat = OutputText;
+	return FALSE;
+}
+
+_Use_decl_annotations_
+UINT32 OutputFormatUnsigned(
+	_In_ UINT64 Value,
+	_Out_writes_(OUTPUT_UNSIGNED_DIGITS) PCHAR szBuffer
+) {
+	// Right to left, two digits at a time, then copied to the beginning of the buffer
+	CHAR Digits[OUTPUT_UNSIGNED_DIGITS];
+	PCHAR Cursor = Digits + OUTPUT_UNSIGNED_DIGITS;
+	while (Value >= 100) {
+		UINT32 Pair = (UINT32)(Value % 100) * 2;
+		Value /= 100;
+		Cursor -= 2;
+		Cursor[0] = g_OutputDigits[Pair];
+		Cursor[1] = g_OutputDigits[Pair + 1];
+	}
+	if (Value >= 10) {
+		Cursor -= 2;
+		Cursor[0] = g_OutputDigits[Value * 2];
+		Cursor[1] = g_OutputDigits[Value * 2 + 1];
+	}
+	else {
+		*--Cursor = (CHAR)('0' + Value);
+	}
+
+	UINT32 cchDigits = (UINT32)(Digits + OUTPUT_UNSIGNED_DIGITS - Cursor);
+	memcpy(szBuffer, Cursor, cchDigits);
+	return cchDigits;
+}
+
+_Use_decl_annotations_
+UINT32 OutputFormatHex(
+	_In_ UINT64 Value,
+	_In_ UINT32 uiDigits,
+	_Out_writes_(OUTPUT_HEX_DIGITS) PCHAR szBuffer
+) {
+	// The number of digits is known upfront, so they are written in place from the right
+	UINT32 cchDigits = uiDigits < OUTPUT_HEX_DIGITS ? uiDigits : OUTPUT_HEX_DIGITS;
+	cchDigits = cchDigits != 0x00 ? cchDigits : 0x01;
+	while (cchDigits < OUTPUT_HEX_DIGITS && (Value >> (cchDigits * 4)) != 0x00)
+		cchDigits++;
+
+	for (UINT32 Index = cchDigits; Index > 0x00; Index--) {
+		szBuffer[Index - 1] = g_OutputHexDigits[Value & 0x0F];
+		Value >>= 4;
+	}
+	return cchDigits;
+}
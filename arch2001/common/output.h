@@ -0,0 +1,257 @@
+/// @file    output.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __OUTPUT_H_GUARD__
+#define __OUTPUT_H_GUARD__
+#include "ost.h"
+#include <stdio.h>
+
+/// Maximum number of characters written by OutputFormatUnsigned and OutputFormatHex
+#define OUTPUT_UNSIGNED_DIGITS 20
+#define OUTPUT_HEX_DIGITS      16
+
+/// Maximum size of the CSV header line and of the name of a record
+#define OUTPUT_HEADER_SIZE 4096
+#define OUTPUT_NAME_SIZE   32
+
+/// Recommended size of the buffer of an output. A record must fit in the buffer, and in 64 KiB with the
+/// binary format.
+#define OUTPUT_DEFAULT_BUFFER (64 * 1024)
+
+/// <summary>
+/// Formats of the records.
+/// </summary>
+typedef enum _OUTPUT_FORMAT {
+	OutputText       = 0x00, // record name=value name=value
+	OutputJsonLines  = 0x01, // {"record":"record","name":value,"name":"0x..."} per line.
+	OutputCsv        = 0x02, // One header line every time the name of the records changes.
+	OutputBinary     = 0x03, // OUTPUT_BINARY_HEADER followed by one 64-bit value per field.
+	OutputFormatCount
+} OUTPUT_FORMAT;
+
+/// <summary>
+/// Header of a record in the binary format, little-endian. Each number is followed by 8 bytes, each
+/// string by its length on 8 bytes then its characters padded to a multiple of 8 bytes. The fields are
+/// not named, the tag identifies the layout.
+/// </summary>
+typedef struct _OUTPUT_BINARY_HEADER {
+	UINT16 Size;   // Size of the record with its header.
+	UINT16 Fields; // Number of fields.
+	UINT32 Tag;    // FNV-1a hash of the name of the record.
+} OUTPUT_BINARY_HEADER, * POUTPUT_BINARY_HEADER;
+
+C_ASSERT(sizeof(OUTPUT_BINARY_HEADER) == 8);
+
+/// <summary>
+/// Destination of the bytes of an output, e.g. OutputFileSink.
+/// </summary>
+/// <param name="Context">Context given to OutputOpen.</param>
+/// <param name="pData">Bytes to write.</param>
+/// <param name="Size">Number of bytes.</param>
+/// <returns>Whether all the bytes have been written.</returns>
+typedef BOOL(*OUTPUT_SINK)(
+	_In_ PVOID                    Context,
+	_In_reads_bytes_(Size) const VOID* pData,
+	_In_ SIZE_T                   Size
+);
+
+/// <summary>
+/// Stream of records formatted in a buffer provided by the caller, and passed to the sink only when the
+/// buffer is full or flushed. Records of the same name must have the same fields in the same order.
+/// </summary>
+typedef struct _OUTPUT {
+	OUTPUT_FORMAT Format;
+	OUTPUT_SINK   Sink;
+	PVOID         Context;
+	PCHAR         Buffer;
+	SIZE_T        Capacity;
+	SIZE_T        Length;
+	SIZE_T        Record;                   // Offset of the record being written.
+	UINT32        Fields;                   // Number of fields of the record being written.
+	BOOL          bDropped;                 // The record being written, or its CSV header, does not fit.
+	BOOL          bFailed;                  // The sink failed, every record is dropped from then on.
+	UINT64        Records;                  // Records written.
+	UINT64        Dropped;                  // Records dropped.
+	UINT64        Bytes;                    // Bytes passed to the sink.
+	BOOL          bHeader;                  // The CSV header of the record being written is pending.
+	SIZE_T        HeaderLength;
+	CHAR          Schema[OUTPUT_NAME_SIZE]; // Name of the records described by the last CSV header.
+	CHAR          Header[OUTPUT_HEADER_SIZE];
+} OUTPUT, * POUTPUT;
+
+/// <summary>
+/// Initialise an output. Nothing is allocated, the buffer is used until OutputClose.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="Format">Format of the records.</param>
+/// <param name="pBuffer">Buffer in which the records are formatted.</param>
+/// <param name="Capacity">Size of the buffer in bytes.</param>
+/// <param name="Sink">Destination of the records.</param>
+/// <param name="Context">Context of the sink, e.g. a FILE* with OutputFileSink.</param>
+/// <returns>Whether the output has been initialised.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL OutputOpen(
+	_Out_ POUTPUT       pOutput,
+	_In_  OUTPUT_FORMAT Format,
+	_Out_writes_bytes_(Capacity) PVOID pBuffer,
+	_In_  SIZE_T        Capacity,
+	_In_  OUTPUT_SINK   Sink,
+	_In_opt_ PVOID      Context
+);
+
+/// <summary>
+/// Sink writing to a FILE* given as context. The file is expected to be opened in binary mode.
+/// </summary>
+/// <param name="Context">FILE* receiving the bytes.</param>
+/// <param name="pData">Bytes to write.</param>
+/// <param name="Size">Number of bytes.</param>
+/// <returns>Whether all the bytes have been written.</returns>
+BOOL OutputFileSink(
+	_In_ PVOID                    Context,
+	_In_reads_bytes_(Size) const VOID* pData,
+	_In_ SIZE_T                   Size
+);
+
+/// <summary>
+/// Start a record.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="szRecord">Name of the record, at most OUTPUT_NAME_SIZE - 1 characters.</param>
+VOID OutputBegin(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szRecord
+);
+
+/// <summary>
+/// Add an unsigned decimal field to the record.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="szName">Name of the field.</param>
+/// <param name="Value">Value of the field.</param>
+VOID OutputUnsigned(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    UINT64  Value
+);
+
+/// <summary>
+/// Add a signed decimal field to the record.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="szName">Name of the field.</param>
+/// <param name="Value">Value of the field.</param>
+VOID OutputSigned(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    INT64   Value
+);
+
+/// <summary>
+/// Add a hexadecimal field to the record, written as a "0x" string in JSON since JSON numbers lose the
+/// precision of 64-bit values.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="szName">Name of the field.</param>
+/// <param name="Value">Value of the field.</param>
+/// <param name="uiDigits">Minimum number of digits, padded with zeros.</param>
+VOID OutputHex(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    UINT64  Value,
+	_In_    UINT32  uiDigits
+);
+
+/// <summary>
+/// Add a boolean field to the record.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="szName">Name of the field.</param>
+/// <param name="bValue">Value of the field.</param>
+VOID OutputBool(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_    BOOL    bValue
+);
+
+/// <summary>
+/// Add a string field to the record, escaped for JSON and quoted for CSV when needed.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="szName">Name of the field.</param>
+/// <param name="szValue">Value of the field, not necessarily terminated.</param>
+/// <param name="cchMaximum">Maximum number of characters of the value.</param>
+VOID OutputString(
+	_Inout_ POUTPUT pOutput,
+	_In_    LPCSTR  szName,
+	_In_reads_(cchMaximum) LPCSTR szValue,
+	_In_    SIZE_T  cchMaximum
+);
+
+/// <summary>
+/// Complete a record.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <returns>Whether the record has been written, FALSE if it has been dropped.</returns>
+BOOL OutputEnd(
+	_Inout_ POUTPUT pOutput
+);
+
+/// <summary>
+/// Pass the completed records to the sink.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <returns>Whether the sink accepted them.</returns>
+BOOL OutputFlush(
+	_Inout_ POUTPUT pOutput
+);
+
+/// <summary>
+/// Flush the completed records. The buffer can be released afterwards.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <returns>Whether every record has been written.</returns>
+BOOL OutputClose(
+	_Inout_ POUTPUT pOutput
+);
+
+/// <summary>
+/// Get a format from its name: text, jsonl, csv or binary.
+/// </summary>
+/// <param name="szName">Name of the format.</param>
+/// <param name="pFormat">Pointer receiving the format.</param>
+/// <returns>Whether the name is known.</returns>
+_Success_(return != 0x00)
+BOOL OutputGetFormat(
+	_In_  LPCSTR         szName,
+	_Out_ OUTPUT_FORMAT* pFormat
+);
+
+/// <summary>
+/// Write the decimal digits of a value, without terminating null character.
+/// </summary>
+/// <param name="Value">Value.</param>
+/// <param name="szBuffer">Buffer of at least OUTPUT_UNSIGNED_DIGITS characters.</param>
+/// <returns>Number of characters written.</returns>
+UINT32 OutputFormatUnsigned(
+	_In_ UINT64 Value,
+	_Out_writes_(OUTPUT_UNSIGNED_DIGITS) PCHAR szBuffer
+);
+
+/// <summary>
+/// Write the lowercase hexadecimal digits of a value, without prefix nor terminating null character.
+/// </summary>
+/// <param name="Value">Value.</param>
+/// <param name="uiDigits">Minimum number of digits, padded with zeros.</param>
+/// <param name="szBuffer">Buffer of at least OUTPUT_HEX_DIGITS characters.</param>
+/// <returns>Number of characters written.</returns>
+UINT32 OutputFormatHex(
+	_In_ UINT64 Value,
+	_In_ UINT32 uiDigits,
+	_Out_writes_(OUTPUT_HEX_DIGITS) PCHAR szBuffer
+);
+
+#endif // !__OUTPUT_H_GUARD__
@@ -0,0 +1,696 @@
+/// @file    paging.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include "paging.h"
+
+#if defined(_WIN32)
+/// General information about the driver
+#define KSEG_DEVICE_TYPE 0x8000
+#define KSEG_DEVICE_PATH L"\\\\.\\KSeg"
+
+/// List of IOCTL exposed by this driver
+#define IOCTL_KSEG_READ_PHYSICAL CTL_CODE(KSEG_DEVICE_TYPE, 0x803, METHOD_BUFFERED, FILE_READ_ACCESS)
+
+/// <summary>
+/// Data sent with the physical memory read, limited to the paging structures of this process
+/// </summary>
+typedef struct _KSEG_PHYSICAL_IN {
+	UINT64 Address;
+	UINT32 Size;
+	UINT32 Reserved;
+	UINT64 VirtualAddress;
+} KSEG_PHYSICAL_IN, * PKSEG_PHYSICAL_IN;
+#else
+/// Bits of the entries of /proc/self/pagemap
+#define PAGEMAP_PRESENT  (1ULL << 63)
+#define PAGEMAP_PFN_MASK ((1ULL << 55) - 1)
+
+/// Bits of the entries of /proc/kpageflags
+#define KPAGEFLAGS_HUGE (1ULL << 17) // hugetlbfs page.
+#define KPAGEFLAGS_THP  (1ULL << 22) // Transparent huge page.
+
+/// Entries of /proc/self/pagemap read at once, 4 KiB mapping 2 MiB
+#define PAGING_PAGEMAP_ENTRIES 512
+
+/// <summary>
+/// Entries of pagemap read ahead.
+/// </summary>
+typedef struct _PAGING_PAGEMAP_CHUNK {
+	UINT64 First;     // Index of the first entry.
+	UINT32 Count;     // Number of entries read, 0 if none.
+	UINT64 Entries[PAGING_PAGEMAP_ENTRIES];
+} PAGING_PAGEMAP_CHUNK, * PPAGING_PAGEMAP_CHUNK;
+
+/// <summary>
+/// Files of the Linux source.
+/// </summary>
+typedef struct _PAGING_PAGEMAP_CONTEXT {
+	int                  Pagemap;
+	int                  Kpageflags;   // -1 if not readable.
+	PAGING_PAGEMAP_CHUNK Pages;        // Entries of pagemap, indexed by virtual page.
+} PAGING_PAGEMAP_CONTEXT, * PPAGING_PAGEMAP_CONTEXT;
+#endif
+
+/// <summary>
+/// Shift of the region mapped by an entry of a given level, 12 for a PTE up to 48 for a PML5E.
+/// </summary>
+static UINT32 PagingGetShift(
+	_In_ UINT32 Level
+) {
+	return 12 + 9 * (Level - 1);
+}
+
+/// <summary>
+/// Level of the leaf entry mapping a size of page, 0x00 if the size is not one.
+/// </summary>
+static UINT32 PagingGetLeafLevel(
+	_In_ UINT64 PageSize
+) {
+	switch (PageSize) {
+		case PAGING_SIZE_4K: return 0x01;
+		case PAGING_SIZE_2M: return 0x02;
+		case PAGING_SIZE_1G: return 0x03;
+		default: return 0x00;
+	}
+}
+
+/// <summary>
+/// Fill a translation from its leaf entry.
+/// </summary>
+static VOID PagingFill(
+	_Out_ PPAGING_TRANSLATION pTranslation,
+	_In_  UINT64 VirtualAddress,
+	_In_  UINT64 Frame,
+	_In_  UINT64 Entry,
+	_In_  UINT64 Flags,
+	_In_  UINT32 Level
+) {
+	UINT64 PageSize = 1ULL << PagingGetShift(Level);
+	UINT64 Pat = Level == 0x01 ? (Entry & PAGING_PAT) : (Entry & PAGING_PAT_LARGE);
+
+	pTranslation->VirtualAddress = VirtualAddress;
+	pTranslation->PhysicalAddress = Frame | (VirtualAddress & (PageSize - 1));
+	pTranslation->PageSize = PageSize;
+	pTranslation->Entry = Entry;
+	pTranslation->Flags = Flags;
+	pTranslation->Status = PagingStatusOk;
+	pTranslation->Level = Level;
+	pTranslation->PatIndex = (Pat != 0x00 ? 0x04 : 0x00) | (UINT32)((Entry & (PAGING_PCD | PAGING_PWT)) >> 3);
+}
+
+/// <summary>
+/// Insert a leaf into the software TLB, replacing the entry of the same set.
+/// </summary>
+static VOID PagingTlbInsert(
+	_Inout_ PPAGING_WALKER pWalker,
+	_In_    UINT64 VirtualAddress,
+	_In_    UINT64 Frame,
+	_In_    UINT64 Entry,
+	_In_    UINT64 Flags,
+	_In_    UINT32 Level
+) {
+	UINT64 Page = VirtualAddress >> PagingGetShift(Level);
+	PPAGING_TLB_ENTRY pEntry = &pWalker->Tlb[Level - 1][Page & (PAGING_TLB_ENTRIES - 1)];
+	pEntry->bValid = TRUE;
+	pEntry->Page = Page;
+	pEntry->Frame = Frame;
+	pEntry->Entry = Entry;
+	pEntry->Flags = Flags;
+	pEntry->Level = Level;
+}
+
+/// <summary>
+/// Read an entry of a paging structure, from the copy of the whole structure during a batch.
+/// </summary>
+static BOOL PagingReadEntry(
+	_Inout_ PPAGING_WALKER pWalker,
+	_In_    UINT64  VirtualAddress,
+	_In_    UINT32  Level,
+	_In_    UINT64  Table,
+	_Out_   PUINT64 pEntry
+) {
+	UINT32 Index = (UINT32)(VirtualAddress >> PagingGetShift(Level)) & (PAGING_TABLE_ENTRIES - 1);
+	*pEntry = 0x00;
+	if (!pWalker->bBatch) {
+		pWalker->Statistics.EntryReads++;
+		return pWalker->Memory->Read(pWalker->Memory, Table + Index * sizeof(UINT64), VirtualAddress, pEntry, sizeof(UINT64));
+	}
+
+	PPAGING_TABLE pTable = &pWalker->Tables[Level - 1];
+	if (!pTable->bValid || pTable->Address != Table) {
+		pWalker->Statistics.TableReads++;
+		pTable->bValid = pWalker->Memory->Read(pWalker->Memory, Table, VirtualAddress, pTable->Entries, sizeof(pTable->Entries));
+		pTable->Address = Table;
+		if (!pTable->bValid)
+			return FALSE;
+	}
+	*pEntry = pTable->Entries[Index];
+	return TRUE;
+}
+
+/// <summary>
+/// Forget the paging structures read whole, at the end of a batch.
+/// </summary>
+static VOID PagingEndBatch(
+	_Inout_ PPAGING_WALKER pWalker
+) {
+	if (pWalker->Memory->Invalidate != NULL)
+		pWalker->Memory->Invalidate(pWalker->Memory);
+	pWalker->bBatch = FALSE;
+	for (UINT32 Level = 0x00; Level < PAGING_LEVEL_MAX; Level++)
+		pWalker->Tables[Level].bValid = FALSE;
+}
+
+#if defined(_WIN32)
+/// <summary>
+/// Read physical memory via the \\.\KSeg driver.
+/// </summary>
+static BOOL PagingDriverRead(
+	_In_  PPAGING_MEMORY Memory,
+	_In_  UINT64         PhysicalAddress,
+	_In_  UINT64         VirtualAddress,
+	_Out_writes_bytes_(Size) PVOID pBuffer,
+	_In_  UINT32         Size
+) {
+	if ((PhysicalAddress & (PAGING_SIZE_4K - 1)) + Size > PAGING_SIZE_4K)
+		return FALSE;
+
+	KSEG_PHYSICAL_IN InData = { PhysicalAddress, Size, 0x00, VirtualAddress };
+	DWORD dwBytesReturned = 0x00;
+	BOOL bSuccess = DeviceIoControl(
+		(HANDLE)Memory->Context,
+		IOCTL_KSEG_READ_PHYSICAL,
+		&InData,
+		sizeof(KSEG_PHYSICAL_IN),
+		pBuffer,
+		Size,
+		&dwBytesReturned,
+		NULL
+	);
+	return bSuccess && dwBytesReturned == Size;
+}
+
+/// <summary>
+/// Close the handle to the \\.\KSeg driver.
+/// </summary>
+static VOID PagingDriverClose(
+	_In_ PPAGING_MEMORY Memory
+) {
+	CloseHandle((HANDLE)Memory->Context);
+}
+#else
+/// <summary>
+/// Read an entry of pagemap, with the 4 KiB around it. A coverage of 4 KiB pages then costs one read of
+/// pagemap per 2 MiB instead of one per page. kpageflags is still read per frame: the frames of a range are
+/// scattered and reading ahead of them is mostly wasted.
+/// </summary>
+static BOOL PagingPagemapRead(
+	_In_    int                   File,
+	_Inout_ PPAGING_PAGEMAP_CHUNK pChunk,
+	_In_    UINT64                Index,
+	_Out_   PUINT64               pEntry
+) {
+	if (pChunk->Count == 0x00 || Index < pChunk->First || Index - pChunk->First >= pChunk->Count) {
+		pChunk->First = Index & ~(UINT64)(PAGING_PAGEMAP_ENTRIES - 1);
+		ssize_t Read = pread(File, pChunk->Entries, sizeof(pChunk->Entries), (off_t)(pChunk->First * sizeof(UINT64)));
+		pChunk->Count = Read > 0x00 ? (UINT32)((SIZE_T)Read / sizeof(UINT64)) : 0x00;
+		if (Index - pChunk->First >= pChunk->Count) {
+			pChunk->Count = 0x00;
+			return FALSE;
+		}
+	}
+	*pEntry = pChunk->Entries[Index - pChunk->First];
+	return TRUE;
+}
+
+/// <summary>
+/// Forget the entries read ahead.
+/// </summary>
+static VOID PagingPagemapInvalidate(
+	_In_ PPAGING_MEMORY Memory
+) {
+	PPAGING_PAGEMAP_CONTEXT Context = (PPAGING_PAGEMAP_CONTEXT)Memory->Context;
+	Context->Pages.Count = 0x00;
+}
+
+/// <summary>
+/// Translate an address of the current process via /proc/self/pagemap. The kernel only reports the frame of
+/// every 4 KiB, the size of the page comes from /proc/kpageflags. Huge pages of hugetlbfs are reported as
+/// 2 MiB pages whatever their size.
+/// </summary>
+static BOOL PagingPagemapTranslate(
+	_In_  PPAGING_MEMORY      Memory,
+	_In_  UINT64              VirtualAddress,
+	_Out_ PPAGING_TRANSLATION pTranslation
+) {
+	PPAGING_PAGEMAP_CONTEXT Context = (PPAGING_PAGEMAP_CONTEXT)Memory->Context;
+	RtlZeroMemory(pTranslation, sizeof(PAGING_TRANSLATION));
+	pTranslation->VirtualAddress = VirtualAddress;
+	pTranslation->Level = 0x01;
+
+	// 1. One entry per 4 KiB page
+	UINT64 Entry = 0x00;
+	if (!PagingPagemapRead(Context->Pagemap, &Context->Pages, VirtualAddress / PAGING_SIZE_4K, &Entry)) {
+		pTranslation->Status = PagingStatusReadFailure;
+		return FALSE;
+	}
+	if ((Entry & PAGEMAP_PRESENT) == 0x00) {
+		pTranslation->Status = PagingStatusNotPresent;
+		return FALSE;
+	}
+
+	// 2. The frame is zero without CAP_SYS_ADMIN, and then the size of the page is unknown as well. There is no
+	//    paging structure entry to report.
+	UINT64 Pfn = Entry & PAGEMAP_PFN_MASK;
+	pTranslation->Flags = PAGING_PRESENT | PAGING_USER;
+	pTranslation->Status = PagingStatusOk;
+	if (Pfn == 0x00)
+		return TRUE;
+	pTranslation->PhysicalAddress = Pfn * PAGING_SIZE_4K | (VirtualAddress & (PAGING_SIZE_4K - 1));
+	pTranslation->PageSize = PAGING_SIZE_4K;
+
+	// 3. A huge page mapped by 4 KiB entries, e.g. split by mprotect, is not aligned like its virtual address
+	UINT64 Flags = 0x00;
+	if (Context->Kpageflags >= 0
+		&& pread(Context->Kpageflags, &Flags, sizeof(Flags), (off_t)(Pfn * sizeof(Flags))) == sizeof(Flags)
+		&& (Flags & (KPAGEFLAGS_HUGE | KPAGEFLAGS_THP)) != 0x00
+		&& ((pTranslation->PhysicalAddress - (VirtualAddress & (PAGING_SIZE_2M - 1))) & (PAGING_SIZE_2M - 1)) == 0x00) {
+		pTranslation->PageSize = PAGING_SIZE_2M;
+		pTranslation->Level = 0x02;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Close the files of the Linux source.
+/// </summary>
+static VOID PagingPagemapClose(
+	_In_ PPAGING_MEMORY Memory
+) {
+	PPAGING_PAGEMAP_CONTEXT Context = (PPAGING_PAGEMAP_CONTEXT)Memory->Context;
+	close(Context->Pagemap);
+	if (Context->Kpageflags >= 0)
+		close(Context->Kpageflags);
+	free(Context);
+}
+#endif
+
+/// <summary>
+/// Read a synthetic image.
+/// </summary>
+static BOOL PagingImageRead(
+	_In_  PPAGING_MEMORY Memory,
+	_In_  UINT64         PhysicalAddress,
+	_In_  UINT64         VirtualAddress,
+	_Out_writes_bytes_(Size) PVOID pBuffer,
+	_In_  UINT32         Size
+) {
+	(VOID)VirtualAddress;
+	PPAGING_IMAGE pImage = (PPAGING_IMAGE)Memory->Context;
+	if (PhysicalAddress >= pImage->Size || Size > pImage->Size - PhysicalAddress)
+		return FALSE;
+	memcpy(pBuffer, pImage->Data + PhysicalAddress, Size);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL PagingMemoryOpen(
+	_Out_ PPAGING_MEMORY pMemory
+) {
+	RtlZeroMemory(pMemory, sizeof(PAGING_MEMORY));
+#if defined(_WIN32)
+	HANDLE hDevice = CreateFileW(
+		KSEG_DEVICE_PATH,
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL,
+		OPEN_EXISTING,
+		0x00,
+		NULL
+	);
+	if (hDevice == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	pMemory->Name = "KSeg driver";
+	pMemory->Read = PagingDriverRead;
+	pMemory->Close = PagingDriverClose;
+	pMemory->Context = (PVOID)hDevice;
+	return TRUE;
+#else
+	PPAGING_PAGEMAP_CONTEXT Context = (PPAGING_PAGEMAP_CONTEXT)calloc(0x01, sizeof(PAGING_PAGEMAP_CONTEXT));
+	if (Context == NULL)
+		return FALSE;
+	Context->Pagemap = open("/proc/self/pagemap", O_RDONLY);
+	if (Context->Pagemap < 0) {
+		free(Context);
+		return FALSE;
+	}
+	Context->Kpageflags = open("/proc/kpageflags", O_RDONLY);
+
+	pMemory->Name = "/proc/self/pagemap";
+	pMemory->Translate = PagingPagemapTranslate;
+	pMemory->Invalidate = PagingPagemapInvalidate;
+	pMemory->Close = PagingPagemapClose;
+	pMemory->Context = Context;
+	return TRUE;
+#endif
+}
+
+_Use_decl_annotations_
+VOID PagingMemoryClose(
+	_Inout_ PPAGING_MEMORY pMemory
+) {
+	if (pMemory->Close != NULL)
+		pMemory->Close(pMemory);
+	RtlZeroMemory(pMemory, sizeof(PAGING_MEMORY));
+}
+
+_Use_decl_annotations_
+BOOL PagingImageCreate(
+	_Out_ PPAGING_IMAGE pImage,
+	_In_  UINT64        Size,
+	_In_  BOOL          bFiveLevel
+) {
+	RtlZeroMemory(pImage, sizeof(PAGING_IMAGE));
+	if (Size < 0x02 * PAGING_SIZE_4K || (Size & (PAGING_SIZE_4K - 1)) != 0x00)
+		return FALSE;
+	pImage->Data = (PUINT8)calloc(0x01, (size_t)Size);
+	if (pImage->Data == NULL)
+		return FALSE;
+
+	// The first page is left unused, a physical address of zero is more likely a bug than a table
+	pImage->Size = Size;
+	pImage->Cr3 = PAGING_SIZE_4K;
+	pImage->Next = 0x02 * PAGING_SIZE_4K;
+	pImage->bFiveLevel = bFiveLevel;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL PagingImageMap(
+	_Inout_ PPAGING_IMAGE pImage,
+	_In_    UINT64        VirtualAddress,
+	_In_    UINT64        PhysicalAddress,
+	_In_    UINT64        PageSize,
+	_In_    UINT64        Flags
+) {
+	UINT32 LeafLevel = PagingGetLeafLevel(PageSize);
+	if (LeafLevel == 0x00 || (VirtualAddress & (PageSize - 1)) != 0x00 || (PhysicalAddress & (PageSize - 1)) != 0x00)
+		return FALSE;
+
+	// 1. Walk down to the paging structure of the leaf, allocating the missing ones
+	UINT64 Table = pImage->Cr3;
+	for (UINT32 Level = pImage->bFiveLevel ? 0x05 : 0x04; Level > LeafLevel; Level--) {
+		UINT32 Index = (UINT32)(VirtualAddress >> PagingGetShift(Level)) & (PAGING_TABLE_ENTRIES - 1);
+		PUINT64 pEntry = (PUINT64)(pImage->Data + Table) + Index;
+		if ((*pEntry & PAGING_PRESENT) == 0x00) {
+			if (pImage->Next + PAGING_SIZE_4K > pImage->Size)
+				return FALSE;
+			*pEntry = pImage->Next | PAGING_PRESENT | PAGING_WRITABLE | PAGING_USER;
+			pImage->Next += PAGING_SIZE_4K;
+		}
+		else if (*pEntry & PAGING_LARGE) {
+			return FALSE;
+		}
+		Table = *pEntry & PAGING_ADDRESS_MASK;
+	}
+
+	// 2. The PAT bit moves to bit 12 in the entries mapping a large page, where PS takes its place
+	UINT64 Entry = (PhysicalAddress & PAGING_ADDRESS_MASK) | (Flags & ~(PAGING_PAT | PAGING_PAT_LARGE | PAGING_ADDRESS_MASK)) | PAGING_PRESENT;
+	if (LeafLevel > 0x01)
+		Entry |= PAGING_LARGE | ((Flags & PAGING_PAT) ? PAGING_PAT_LARGE : 0x00);
+	else
+		Entry |= Flags & PAGING_PAT;
+	((PUINT64)(pImage->Data + Table))[(VirtualAddress >> PagingGetShift(LeafLevel)) & (PAGING_TABLE_ENTRIES - 1)] = Entry;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID PagingImageOpen(
+	_Out_ PPAGING_MEMORY pMemory,
+	_In_  PPAGING_IMAGE  pImage
+) {
+	RtlZeroMemory(pMemory, sizeof(PAGING_MEMORY));
+	pMemory->Name = "synthetic image";
+	pMemory->Read = PagingImageRead;
+	pMemory->Context = pImage;
+}
+
+_Use_decl_annotations_
+VOID PagingImageFree(
+	_Inout_ PPAGING_IMAGE pImage
+) {
+	free(pImage->Data);
+	RtlZeroMemory(pImage, sizeof(PAGING_IMAGE));
+}
+
+_Use_decl_annotations_
+BOOL PagingOpen(
+	_Out_ PPAGING_WALKER pWalker,
+	_In_  PPAGING_MEMORY pMemory,
+	_In_  UINT64         Cr3,
+	_In_  BOOL           bFiveLevel
+) {
+	RtlZeroMemory(pWalker, sizeof(PAGING_WALKER));
+	if (pMemory->Read == NULL && pMemory->Translate == NULL)
+		return FALSE;
+	pWalker->Memory = pMemory;
+	pWalker->Cr3 = Cr3;
+	pWalker->bFiveLevel = bFiveLevel;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL PagingTranslate(
+	_Inout_ PPAGING_WALKER      pWalker,
+	_In_    UINT64              VirtualAddress,
+	_Out_   PPAGING_TRANSLATION pTranslation
+) {
+	RtlZeroMemory(pTranslation, sizeof(PAGING_TRANSLATION));
+	pTranslation->VirtualAddress = VirtualAddress;
+	pWalker->Statistics.Translations++;
+
+	// 1. Bits 63:47, or 63:56 with 5-level paging, must all be equal
+	UINT32 Levels = pWalker->bFiveLevel ? 0x05 : 0x04;
+	UINT32 Unused = 64 - (PagingGetShift(Levels) + 9);
+	if ((UINT64)((INT64)(VirtualAddress << Unused) >> Unused) != VirtualAddress) {
+		pTranslation->Status = PagingStatusNonCanonical;
+		pWalker->Statistics.Faults++;
+		return FALSE;
+	}
+
+	// 2. Software TLB, largest pages first
+	for (UINT32 Level = 0x03; Level >= 0x01; Level--) {
+		UINT64 Page = VirtualAddress >> PagingGetShift(Level);
+		PPAGING_TLB_ENTRY pEntry = &pWalker->Tlb[Level - 1][Page & (PAGING_TLB_ENTRIES - 1)];
+		if (pEntry->bValid && pEntry->Page == Page) {
+			PagingFill(pTranslation, VirtualAddress, pEntry->Frame, pEntry->Entry, pEntry->Flags, pEntry->Level);
+			pWalker->Statistics.TlbHits++;
+			return TRUE;
+		}
+	}
+
+	// 3. Sources knowing the translations, without paging structures to read
+	if (pWalker->Memory->Read == NULL) {
+		BOOL bTranslated = pWalker->Memory->Translate(pWalker->Memory, VirtualAddress, pTranslation);
+		if (!pWalker->bBatch && pWalker->Memory->Invalidate != NULL)
+			pWalker->Memory->Invalidate(pWalker->Memory);
+		if (!bTranslated) {
+			pWalker->Statistics.Faults++;
+			return FALSE;
+		}
+		UINT32 Level = PagingGetLeafLevel(pTranslation->PageSize);
+		if (Level != 0x00) {
+			UINT64 Frame = pTranslation->PhysicalAddress - (VirtualAddress & (pTranslation->PageSize - 1));
+			PagingTlbInsert(pWalker, VirtualAddress, Frame, pTranslation->Entry, pTranslation->Flags, Level);
+		}
+		return TRUE;
+	}
+
+	// 4. Paging-structure caches, the lowest level skips the most reads
+	UINT32 Level = Levels;
+	UINT64 Table = pWalker->Cr3 & PAGING_ADDRESS_MASK;
+	UINT64 Flags = PAGING_WRITABLE | PAGING_USER;
+	for (UINT32 Cached = 0x02; Cached <= Levels; Cached++) {
+		UINT64 Tag = VirtualAddress >> PagingGetShift(Cached);
+		PPAGING_STRUCTURE_ENTRY pEntry = &pWalker->Structures[Cached - 2][Tag & (PAGING_STRUCTURE_ENTRIES - 1)];
+		if (pEntry->bValid && pEntry->Tag == Tag) {
+			Level = Cached - 1;
+			Table = pEntry->Table;
+			Flags = pEntry->Flags;
+			pWalker->Statistics.StructureHits++;
+			break;
+		}
+	}
+
+	// 5. Walk down to the leaf: every entry must allow writes and user accesses, any entry can forbid execution
+	UINT64 Entry = 0x00;
+	for (;;) {
+		pTranslation->Level = Level;
+		if (!PagingReadEntry(pWalker, VirtualAddress, Level, Table, &Entry)) {
+			pTranslation->Status = PagingStatusReadFailure;
+			pWalker->Statistics.Faults++;
+			return FALSE;
+		}
+		pTranslation->Entry = Entry;
+		if ((Entry & PAGING_PRESENT) == 0x00) {
+			pTranslation->Status = PagingStatusNotPresent;
+			pWalker->Statistics.Faults++;
+			return FALSE;
+		}
+		Flags = (Flags & Entry & (PAGING_WRITABLE | PAGING_USER)) | ((Flags | Entry) & PAGING_NX);
+
+		if (Level == 0x01 || (Entry & PAGING_LARGE))
+			break;
+		PPAGING_STRUCTURE_ENTRY pCached = &pWalker->Structures[Level - 2][(VirtualAddress >> PagingGetShift(Level)) & (PAGING_STRUCTURE_ENTRIES - 1)];
+		pCached->bValid = TRUE;
+		pCached->Tag = VirtualAddress >> PagingGetShift(Level);
+		pCached->Table = Entry & PAGING_ADDRESS_MASK;
+		pCached->Flags = Flags;
+		Table = Entry & PAGING_ADDRESS_MASK;
+		Level--;
+	}
+	if (Level > 0x03) {
+		pTranslation->Status = PagingStatusReserved;
+		pWalker->Statistics.Faults++;
+		return FALSE;
+	}
+
+	// 6. Frame of the page, bits below the size of the page hold the PAT bit of the large pages
+	UINT64 Frame = Entry & PAGING_ADDRESS_MASK & ~((1ULL << PagingGetShift(Level)) - 1);
+	Flags |= Entry & ~(PAGING_WRITABLE | PAGING_USER | PAGING_NX);
+	PagingFill(pTranslation, VirtualAddress, Frame, Entry, Flags, Level);
+	PagingTlbInsert(pWalker, VirtualAddress, Frame, Entry, Flags, Level);
+	return TRUE;
+}
+
+/// <summary>
+/// Bucket of an address in a batch, its 2 MiB region modulo PAGING_BATCH_BUCKETS: the addresses mapped by the
+/// same page table share a bucket, and the buckets of a range up to 8 GiB are distinct and ascending.
+/// </summary>
+static UINT32 PagingGetBucket(
+	_In_ UINT64 VirtualAddress
+) {
+	return (UINT32)(VirtualAddress >> PagingGetShift(0x02)) & (PAGING_BATCH_BUCKETS - 1);
+}
+
+_Use_decl_annotations_
+UINT32 PagingTranslateBatch(
+	_Inout_ PPAGING_WALKER pWalker,
+	_In_reads_(uiCount) const UINT64* pAddresses,
+	_In_    UINT32         uiCount,
+	_Out_writes_(uiCount) PPAGING_TRANSLATION pTranslations
+) {
+	// 1. Group the addresses by bucket with a counting sort, so that the addresses sharing a paging structure
+	//    follow each other and it is read once
+	PUINT32 pOrder = (PUINT32)malloc((SIZE_T)uiCount * sizeof(UINT32));
+	PUINT32 pStarts = (PUINT32)calloc(PAGING_BATCH_BUCKETS + 1, sizeof(UINT32));
+	if (pOrder != NULL && pStarts != NULL) {
+		for (UINT32 Index = 0x00; Index < uiCount; Index++)
+			pStarts[PagingGetBucket(pAddresses[Index]) + 1]++;
+		for (UINT32 Bucket = 0x00; Bucket < PAGING_BATCH_BUCKETS; Bucket++)
+			pStarts[Bucket + 1] += pStarts[Bucket];
+		for (UINT32 Index = 0x00; Index < uiCount; Index++)
+			pOrder[pStarts[PagingGetBucket(pAddresses[Index])]++] = Index;
+	}
+	else {
+		free(pOrder);
+		pOrder = NULL;
+	}
+	free(pStarts);
+
+	// 2. Without memory for the order, the addresses are translated as they come
+	UINT32 Mapped = 0x00;
+	pWalker->bBatch = TRUE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		UINT32 Position = pOrder != NULL ? pOrder[Index] : Index;
+		Mapped += PagingTranslate(pWalker, pAddresses[Position], &pTranslations[Position]) ? 0x01 : 0x00;
+	}
+	PagingEndBatch(pWalker);
+	free(pOrder);
+	return Mapped;
+}
+
+_Use_decl_annotations_
+VOID PagingCoverage(
+	_Inout_ PPAGING_WALKER   pWalker,
+	_In_    UINT64           Start,
+	_In_    UINT64           Length,
+	_Out_   PPAGING_COVERAGE pCoverage
+) {
+	RtlZeroMemory(pCoverage, sizeof(PAGING_COVERAGE));
+	UINT64 End = Start + Length < Start ? ~0x00ULL : Start + Length;
+	UINT64 Address = Start & ~(PAGING_SIZE_4K - 1);
+	pWalker->bBatch = TRUE;
+
+	while (Address < End) {
+		PAGING_TRANSLATION Translation = { 0x00 };
+		BOOL bMapped = PagingTranslate(pWalker, Address, &Translation);
+
+		// 1. Move to the end of the page, or of the region of the entry not present
+		UINT64 Next = 0x00;
+		if (Translation.Status == PagingStatusNonCanonical) {
+			UINT32 Bits = PagingGetShift(pWalker->bFiveLevel ? 0x05 : 0x04) + 8;
+			Next = ~((1ULL << Bits) - 1);
+		}
+		else {
+			UINT64 Size = bMapped && Translation.PageSize != 0x00 ? Translation.PageSize : PAGING_SIZE_4K;
+			if (Translation.Status == PagingStatusNotPresent || Translation.Status == PagingStatusReserved)
+				Size = 1ULL << PagingGetShift(Translation.Level);
+			Next = (Address & ~(Size - 1)) + Size;
+		}
+		if (Next <= Address)
+			Next = End;
+
+		// 2. Only count the part of the page inside the range
+		UINT64 Bytes = (Next < End ? Next : End) - (Address > Start ? Address : Start);
+		if (Translation.Status == PagingStatusReadFailure)
+			pCoverage->BytesFailed += Bytes;
+		else if (!bMapped)
+			pCoverage->BytesNotPresent += Bytes;
+		else if (Translation.PageSize == PAGING_SIZE_1G)
+			pCoverage->Bytes1G += Bytes;
+		else if (Translation.PageSize == PAGING_SIZE_2M)
+			pCoverage->Bytes2M += Bytes;
+		else if (Translation.PageSize == PAGING_SIZE_4K)
+			pCoverage->Bytes4K += Bytes;
+		else
+			pCoverage->BytesUnknown += Bytes;
+		Address = Next;
+	}
+	PagingEndBatch(pWalker);
+}
+
+_Use_decl_annotations_
+VOID PagingFlush(
+	_Inout_ PPAGING_WALKER pWalker
+) {
+	RtlZeroMemory(pWalker->Tlb, sizeof(pWalker->Tlb));
+	RtlZeroMemory(pWalker->Structures, sizeof(pWalker->Structures));
+	PagingEndBatch(pWalker);
+}
+
+_Use_decl_annotations_
+LPCSTR PagingGetStatusName(
+	_In_ PAGING_STATUS Status
+) {
+	switch (Status) {
+		case PagingStatusOk:           return "ok";
+		case PagingStatusNotPresent:   return "not present";
+		case PagingStatusNonCanonical: return "non-canonical";
+		case PagingStatusReserved:     return "reserved";
+		case PagingStatusReadFailure:  return "read failure";
+		default:                       return "?";
+	}
+}
@@ -0,0 +1,349 @@
+/// @file    paging.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __PAGING_H_GUARD__
+#define __PAGING_H_GUARD__
+#include "ost.h"
+
+/// Bits of the paging structure entries
+#define PAGING_PRESENT   (1ULL << 0)
+#define PAGING_WRITABLE  (1ULL << 1)
+#define PAGING_USER      (1ULL << 2)  // U/S, supervisor-only access if clear in any entry of the walk.
+#define PAGING_PWT       (1ULL << 3)
+#define PAGING_PCD       (1ULL << 4)
+#define PAGING_ACCESSED  (1ULL << 5)
+#define PAGING_DIRTY     (1ULL << 6)  // Leaf entries only.
+#define PAGING_LARGE     (1ULL << 7)  // PS, maps a 1 GiB page in a PDPTE and a 2 MiB page in a PDE.
+#define PAGING_PAT       (1ULL << 7)  // PAT bit of a PTE, at the position of PS.
+#define PAGING_GLOBAL    (1ULL << 8)  // Leaf entries only.
+#define PAGING_PAT_LARGE (1ULL << 12) // PAT bit of a PDPTE or PDE mapping a page.
+#define PAGING_NX        (1ULL << 63) // Execute-disable, if IA32_EFER.NXE is set.
+
+/// Physical address of the next paging structure or of the page, bits 51:12
+#define PAGING_ADDRESS_MASK 0x000FFFFFFFFFF000ULL
+
+/// Sizes of the pages
+#define PAGING_SIZE_4K 0x0000000000001000ULL
+#define PAGING_SIZE_2M 0x0000000000200000ULL
+#define PAGING_SIZE_1G 0x0000000040000000ULL
+
+/// Entries per paging structure and levels, the PTE is level 1 and the PML5E level 5
+#define PAGING_TABLE_ENTRIES 512
+#define PAGING_LEVEL_MAX     5
+
+/// Sizes of the software TLB and of the paging-structure caches, powers of two
+#define PAGING_TLB_ENTRIES       64
+#define PAGING_STRUCTURE_ENTRIES 16
+
+/// Buckets used to order a batch, a power of two
+#define PAGING_BATCH_BUCKETS     4096
+
+/// <summary>
+/// Outcome of a translation.
+/// </summary>
+typedef enum _PAGING_STATUS {
+	PagingStatusOk           = 0x00,
+	PagingStatusNotPresent   = 0x01, // The entry at Level is not present.
+	PagingStatusNonCanonical = 0x02,
+	PagingStatusReserved     = 0x03, // PS set in a PML4E or PML5E.
+	PagingStatusReadFailure  = 0x04  // The physical memory could not be read.
+} PAGING_STATUS;
+
+/// <summary>
+/// Translation of a virtual address.
+/// </summary>
+typedef struct _PAGING_TRANSLATION {
+	UINT64        VirtualAddress;
+	UINT64        PhysicalAddress;
+	UINT64        PageSize;   // 0x00 if the source does not know it.
+	UINT64        Entry;      // Raw leaf entry, or the entry not present.
+	UINT64        Flags;      // Leaf entry with R/W and U/S cleared and NX set as the whole walk decides.
+	PAGING_STATUS Status;
+	UINT32        Level;      // Level of the leaf, or of the entry not present.
+	UINT32        PatIndex;   // PAT:PCD:PWT, index of the entry of IA32_PAT giving the memory type.
+} PAGING_TRANSLATION, * PPAGING_TRANSLATION;
+
+typedef struct _PAGING_MEMORY PAGING_MEMORY, * PPAGING_MEMORY;
+
+/// <summary>
+/// Source of the paging structures. The walker reads physical memory when the source can, the \\.\KSeg driver
+/// on Windows or a synthetic image, otherwise it asks the source for the final translation, as with
+/// /proc/self/pagemap on Linux.
+/// </summary>
+struct _PAGING_MEMORY {
+	/// <summary>
+	/// Name of the source, for display purpose.
+	/// </summary>
+	LPCSTR Name;
+	/// <summary>
+	/// Read physical memory, never across a 4 KiB boundary, to translate a virtual address. The driver only
+	/// reads the paging structures walked for that address. NULL if the source cannot.
+	/// </summary>
+	BOOL(*Read)(
+		_In_  PPAGING_MEMORY Memory,
+		_In_  UINT64         PhysicalAddress,
+		_In_  UINT64         VirtualAddress,
+		_Out_writes_bytes_(Size) PVOID pBuffer,
+		_In_  UINT32         Size
+	);
+	/// <summary>
+	/// Translate a virtual address of the current process without walking. NULL if the source cannot.
+	/// </summary>
+	BOOL(*Translate)(
+		_In_  PPAGING_MEMORY      Memory,
+		_In_  UINT64              VirtualAddress,
+		_Out_ PPAGING_TRANSLATION pTranslation
+	);
+	/// <summary>
+	/// Forget what Translate read ahead, at the end of a batch and on a flush. NULL if the source does not read
+	/// ahead.
+	/// </summary>
+	VOID(*Invalidate)(
+		_In_ PPAGING_MEMORY Memory
+	);
+	/// <summary>
+	/// Release the resources of the source.
+	/// </summary>
+	VOID(*Close)(
+		_In_ PPAGING_MEMORY Memory
+	);
+	/// <summary>
+	/// Source specific data.
+	/// </summary>
+	PVOID Context;
+};
+
+/// <summary>
+/// Synthetic physical memory, built with PagingImageMap. Physical address 0 is the first byte of the image.
+/// </summary>
+typedef struct _PAGING_IMAGE {
+	PUINT8 Data;
+	UINT64 Size;
+	UINT64 Next;       // Next free 4 KiB page, for the paging structures.
+	UINT64 Cr3;        // Physical address of the root paging structure.
+	BOOL   bFiveLevel;
+} PAGING_IMAGE, * PPAGING_IMAGE;
+
+/// <summary>
+/// Leaf entry of the software TLB.
+/// </summary>
+typedef struct _PAGING_TLB_ENTRY {
+	BOOL   bValid;
+	UINT64 Page;       // Virtual address shifted by the size of the page.
+	UINT64 Frame;      // Physical address of the page.
+	UINT64 Entry;
+	UINT64 Flags;
+	UINT32 Level;
+} PAGING_TLB_ENTRY, * PPAGING_TLB_ENTRY;
+
+/// <summary>
+/// Entry of a paging-structure cache, an upper-level entry referencing the paging structure below it.
+/// </summary>
+typedef struct _PAGING_STRUCTURE_ENTRY {
+	BOOL   bValid;
+	UINT64 Tag;        // Virtual address shifted by the region the entry maps.
+	UINT64 Table;      // Physical address of the paging structure of the level below.
+	UINT64 Flags;      // R/W, U/S and NX of the walk up to this entry.
+} PAGING_STRUCTURE_ENTRY, * PPAGING_STRUCTURE_ENTRY;
+
+/// <summary>
+/// Paging structure read in one go by the batch translations.
+/// </summary>
+typedef struct _PAGING_TABLE {
+	BOOL   bValid;
+	UINT64 Address;
+	UINT64 Entries[PAGING_TABLE_ENTRIES];
+} PAGING_TABLE, * PPAGING_TABLE;
+
+/// <summary>
+/// Counters of the walker.
+/// </summary>
+typedef struct _PAGING_STATISTICS {
+	UINT64 Translations;
+	UINT64 TlbHits;
+	UINT64 StructureHits;  // Walks started below the root thanks to a paging-structure cache.
+	UINT64 EntryReads;     // Reads of a single entry.
+	UINT64 TableReads;     // Reads of a whole paging structure, batch translations only.
+	UINT64 Faults;         // Translations not successful.
+} PAGING_STATISTICS, * PPAGING_STATISTICS;
+
+/// <summary>
+/// Walker of the paging structures of an address space.
+/// </summary>
+typedef struct _PAGING_WALKER {
+	PPAGING_MEMORY         Memory;
+	UINT64                 Cr3;
+	BOOL                   bFiveLevel;
+	BOOL                   bBatch;       // Whether the paging structures, or the source's entries, are read ahead.
+	PAGING_TLB_ENTRY       Tlb[0x03][PAGING_TLB_ENTRIES];                        // 4 KiB, 2 MiB and 1 GiB pages.
+	PAGING_STRUCTURE_ENTRY Structures[PAGING_LEVEL_MAX - 1][PAGING_STRUCTURE_ENTRIES]; // PDE to PML5E.
+	PAGING_TABLE           Tables[PAGING_LEVEL_MAX];
+	PAGING_STATISTICS      Statistics;
+} PAGING_WALKER, * PPAGING_WALKER;
+
+/// <summary>
+/// Virtual memory of a range by size of page.
+/// </summary>
+typedef struct _PAGING_COVERAGE {
+	UINT64 Bytes4K;
+	UINT64 Bytes2M;
+	UINT64 Bytes1G;
+	UINT64 BytesUnknown;    // Present, with a page size the source does not know.
+	UINT64 BytesNotPresent;
+	UINT64 BytesFailed;
+} PAGING_COVERAGE, * PPAGING_COVERAGE;
+
+/// <summary>
+/// Open the default source of the platform: the \\.\KSeg driver on Windows, /proc/self/pagemap on Linux.
+/// The page sizes are only known on Linux if /proc/kpageflags can be read, i.e. as root.
+/// </summary>
+/// <param name="pMemory">Pointer to the source to initialise.</param>
+/// <returns>Whether the source has been opened.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PagingMemoryOpen(
+	_Out_ PPAGING_MEMORY pMemory
+);
+
+/// <summary>
+/// Release a source.
+/// </summary>
+/// <param name="pMemory">Pointer to the source.</param>
+VOID PagingMemoryClose(
+	_Inout_ PPAGING_MEMORY pMemory
+);
+
+/// <summary>
+/// Allocate a synthetic physical memory with an empty root paging structure.
+/// </summary>
+/// <param name="pImage">Pointer to the image to initialise.</param>
+/// <param name="Size">Size of the image, multiple of 4 KiB.</param>
+/// <param name="bFiveLevel">Whether the paging structures are those of 5-level paging.</param>
+/// <returns>Whether the image has been allocated.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PagingImageCreate(
+	_Out_ PPAGING_IMAGE pImage,
+	_In_  UINT64        Size,
+	_In_  BOOL          bFiveLevel
+);
+
+/// <summary>
+/// Map a page in a synthetic image, allocating the missing paging structures. The upper-level entries allow
+/// everything, the leaf entry decides.
+/// </summary>
+/// <param name="pImage">Pointer to the image.</param>
+/// <param name="VirtualAddress">Virtual address of the page.</param>
+/// <param name="PhysicalAddress">Physical address of the page, which does not have to be in the image.</param>
+/// <param name="PageSize">PAGING_SIZE_4K, PAGING_SIZE_2M or PAGING_SIZE_1G.</param>
+/// <param name="Flags">PAGING_* bits of the leaf entry, with PAGING_PAT for the PAT bit whatever the size.</param>
+/// <returns>Whether the page has been mapped.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PagingImageMap(
+	_Inout_ PPAGING_IMAGE pImage,
+	_In_    UINT64        VirtualAddress,
+	_In_    UINT64        PhysicalAddress,
+	_In_    UINT64        PageSize,
+	_In_    UINT64        Flags
+);
+
+/// <summary>
+/// Open a source reading a synthetic image. The image must outlive the source.
+/// </summary>
+/// <param name="pMemory">Pointer to the source to initialise.</param>
+/// <param name="pImage">Pointer to the image.</param>
+VOID PagingImageOpen(
+	_Out_ PPAGING_MEMORY pMemory,
+	_In_  PPAGING_IMAGE  pImage
+);
+
+/// <summary>
+/// Release a synthetic image.
+/// </summary>
+/// <param name="pImage">Pointer to the image.</param>
+VOID PagingImageFree(
+	_Inout_ PPAGING_IMAGE pImage
+);
+
+/// <summary>
+/// Initialise a walker. The structure is large, better not on the stack.
+/// </summary>
+/// <param name="pWalker">Pointer to the walker to initialise.</param>
+/// <param name="pMemory">Pointer to an opened source.</param>
+/// <param name="Cr3">Value of CR3 of the address space, ignored by the sources translating themselves.</param>
+/// <param name="bFiveLevel">Whether CR4.LA57 is set.</param>
+/// <returns>Whether the source can be used.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PagingOpen(
+	_Out_ PPAGING_WALKER pWalker,
+	_In_  PPAGING_MEMORY pMemory,
+	_In_  UINT64         Cr3,
+	_In_  BOOL           bFiveLevel
+);
+
+/// <summary>
+/// Translate a virtual address, from the software TLB if possible.
+/// </summary>
+/// <param name="pWalker">Pointer to the walker.</param>
+/// <param name="VirtualAddress">Virtual address to translate.</param>
+/// <param name="pTranslation">Pointer receiving the translation.</param>
+/// <returns>Whether the address is mapped.</returns>
+_Success_(return != 0x00)
+BOOL PagingTranslate(
+	_Inout_ PPAGING_WALKER      pWalker,
+	_In_    UINT64              VirtualAddress,
+	_Out_   PPAGING_TRANSLATION pTranslation
+);
+
+/// <summary>
+/// Translate many virtual addresses. They are grouped by 2 MiB region, the paging structures are read whole
+/// and kept for the duration of the batch, hence read once however many addresses they map. This pays off when
+/// a read is expensive, e.g. with the driver; the synthetic image is faster translated one by one.
+/// </summary>
+/// <param name="pWalker">Pointer to the walker.</param>
+/// <param name="pAddresses">Virtual addresses to translate.</param>
+/// <param name="uiCount">Number of addresses.</param>
+/// <param name="pTranslations">Translation of every address.</param>
+/// <returns>Number of addresses mapped.</returns>
+UINT32 PagingTranslateBatch(
+	_Inout_ PPAGING_WALKER pWalker,
+	_In_reads_(uiCount) const UINT64* pAddresses,
+	_In_    UINT32         uiCount,
+	_Out_writes_(uiCount) PPAGING_TRANSLATION pTranslations
+);
+
+/// <summary>
+/// Measure which sizes of page map a virtual range, one translation per page and none for the regions not
+/// present at an upper level.
+/// </summary>
+/// <param name="pWalker">Pointer to the walker.</param>
+/// <param name="Start">First virtual address of the range.</param>
+/// <param name="Length">Length of the range in bytes.</param>
+/// <param name="pCoverage">Pointer receiving the coverage.</param>
+VOID PagingCoverage(
+	_Inout_ PPAGING_WALKER   pWalker,
+	_In_    UINT64           Start,
+	_In_    UINT64           Length,
+	_Out_   PPAGING_COVERAGE pCoverage
+);
+
+/// <summary>
+/// Invalidate the software TLB and the paging-structure caches, after the paging structures changed.
+/// </summary>
+/// <param name="pWalker">Pointer to the walker.</param>
+VOID PagingFlush(
+	_Inout_ PPAGING_WALKER pWalker
+);
+
+/// <summary>
+/// Get the name of a translation status.
+/// </summary>
+/// <param name="Status">Status.</param>
+/// <returns>Name of the status.</returns>
+LPCSTR PagingGetStatusName(
+	_In_ PAGING_STATUS Status
+);
+
+#endif // !__PAGING_H_GUARD__
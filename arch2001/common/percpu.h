@@ -0,0 +1,81 @@
+/// @file    percpu.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __PERCPU_H_GUARD__
+#define __PERCPU_H_GUARD__
+#include <stdlib.h>
+#include "ost.h"
+#include "atomic.h"
+#include "cpunum.h"
+#include "thread.h"
+
+#if defined(_WIN32)
+#define PerCpuAlloc(Size) _aligned_malloc((Size), CACHE_LINE_SIZE)
+#define PerCpuFree(p)     _aligned_free(p)
+#else
+#define PerCpuAlloc(Size) aligned_alloc(CACHE_LINE_SIZE, (Size))
+#define PerCpuFree(p)     free(p)
+#endif
+
+/// <summary>
+/// Define an array holding one value of a type per processor, each in its own cache line so that
+/// processors updating their own value never share a line. The value of the current processor is
+/// selected with CpuNumCurrent, so the caller may be migrated between the lookup and the update: values
+/// must still be updated atomically, but the line is almost always already owned by the processor.
+///
+/// PERCPU_DEFINE(Name, Type) defines:
+///  - Name##_SLOT and Name, the array;
+///  - Name##Create and Name##Destroy;
+///  - Name##Local, the value of the current processor;
+///  - Name##At, the value of a given processor.
+/// </summary>
+#define PERCPU_DEFINE(Name, Type)                                                              \
+	typedef union DECLSPEC_ALIGN(CACHE_LINE_SIZE) _##Name##_SLOT {                             \
+		Type  Value;                                                                           \
+		UINT8 Padding[(sizeof(Type) + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1)];          \
+	} Name##_SLOT;                                                                             \
+	typedef struct _##Name {                                                                   \
+		UINT32        Count;                                                                   \
+		Name##_SLOT*  Slots;                                                                   \
+	} Name, * P##Name;                                                                         \
+	FORCEINLINE BOOL Name##Create(_Out_ P##Name p) {                                           \
+		CpuNumInitialise();                                                                    \
+		p->Count = ThreadGetCpuCount();                                                        \
+		p->Slots = (Name##_SLOT*)PerCpuAlloc(p->Count * sizeof(Name##_SLOT));                  \
+		if (p->Slots != NULL)                                                                  \
+			RtlZeroMemory(p->Slots, p->Count * sizeof(Name##_SLOT));                           \
+		return p->Slots != NULL;                                                               \
+	}                                                                                          \
+	FORCEINLINE VOID Name##Destroy(_Inout_ P##Name p) {                                        \
+		PerCpuFree(p->Slots);                                                                  \
+		p->Slots = NULL;                                                                       \
+		p->Count = 0x00;                                                                       \
+	}                                                                                          \
+	FORCEINLINE Type* Name##At(_In_ P##Name p, _In_ UINT32 uiCpu) {                            \
+		return &p->Slots[uiCpu < p->Count ? uiCpu : uiCpu % p->Count].Value;                   \
+	}                                                                                          \
+	FORCEINLINE Type* Name##Local(_In_ P##Name p) {                                            \
+		return Name##At(p, CpuNumCurrent());                                                   \
+	}
+
+/// <summary>
+/// Counter split across processors. Incrementing it only touches the line of the current processor;
+/// reading it sums every line and is therefore much slower.
+/// </summary>
+PERCPU_DEFINE(PERCPU_COUNTER, volatile INT64)
+
+FORCEINLINE BOOL PerCpuCounterCreate(_Out_ PPERCPU_COUNTER p) { return PERCPU_COUNTERCreate(p); }
+FORCEINLINE VOID PerCpuCounterDestroy(_Inout_ PPERCPU_COUNTER p) { PERCPU_COUNTERDestroy(p); }
+FORCEINLINE VOID PerCpuCounterAdd(_In_ PPERCPU_COUNTER p, _In_ INT64 v) { AtomicAdd64(PERCPU_COUNTERLocal(p), v); }
+FORCEINLINE INT64 PerCpuCounterSum(_In_ PPERCPU_COUNTER p) {
+	INT64 Sum = 0x00;
+	for (UINT32 Index = 0x00; Index < p->Count; Index++)
+		Sum += AtomicLoad64(PERCPU_COUNTERAt(p, Index));
+	return Sum;
+}
+
+#endif // !__PERCPU_H_GUARD__
@@ -0,0 +1,407 @@
+/// @file    pmc.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "pmc.h"
+#include "atomic.h"
+#include "intrinsics.h"
+
+/// Slice of the sleep of the flusher thread, bounding the time taken to stop it
+#define PMC_FLUSHER_SLICE 10
+
+static const LPCSTR g_PmcEventNames[PMC_EVENT_COUNT] = {
+	"cycles", "instructions", "ref-cycles", "llc-references", "llc-misses", "branches", "branch-misses"
+};
+
+#if !defined(_WIN32)
+/// Generic perf events the kernel maps to the architectural events
+static const UINT64 g_PmcPerfEvents[PMC_EVENT_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_REF_CPU_CYCLES,
+	PERF_COUNT_HW_CACHE_REFERENCES,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/// <summary>
+/// Read a counter with the OS, with the times of its group when requested.
+/// </summary>
+static UINT64 PmcReadCounterSyscall(
+	_In_      PPMC_COUNTER pCounter,
+	_Out_opt_ PUINT64      pEnabled,
+	_Out_opt_ PUINT64      pRunning
+) {
+	// Value, then PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING
+	UINT64 Values[3] = { 0x00 };
+	if (read(pCounter->Fd, Values, sizeof(Values)) != sizeof(Values))
+		RtlZeroMemory(Values, sizeof(Values));
+	if (pEnabled != NULL)
+		*pEnabled = Values[1];
+	if (pRunning != NULL)
+		*pRunning = Values[2];
+	return Values[0];
+}
+
+/// <summary>
+/// Read a counter with the protocol of the perf mmap page: the kernel publishes the index of the hardware
+/// counter, the count accumulated before it was loaded and the times of the group as of its last switch,
+/// extended to now with the TSC, under a sequence lock.
+/// </summary>
+static UINT64 PmcReadCounter(
+	_In_      PPMC_COUNTER            pCounter,
+	_In_      const PMC_CAPABILITIES* pCapabilities,
+	_Out_opt_ PUINT64                 pEnabled,
+	_Out_opt_ PUINT64                 pRunning
+) {
+	struct perf_event_mmap_page* Page = (struct perf_event_mmap_page*)pCounter->Page;
+	if (Page == NULL)
+		return PmcReadCounterSyscall(pCounter, pEnabled, pRunning);
+
+	UINT32 Sequence = 0x00;
+	UINT32 Index = 0x00;
+	UINT64 Count = 0x00;
+	UINT64 Enabled = 0x00;
+	UINT64 Running = 0x00;
+	do {
+		Sequence = (UINT32)AtomicLoad32((volatile INT32*)&Page->lock);
+		Index = Page->index;
+		Count = Page->offset;
+		if (Page->cap_user_rdpmc && Index != 0x00) {
+			UINT32 Width = Page->pmc_width != 0x00 ? Page->pmc_width : pCapabilities->CounterWidth;
+			INT64 Value = (INT64)_read_pmc(Index - 1);
+			if (Width != 0x00 && Width < 64) {
+				Value = (INT64)((UINT64)Value << (64 - Width));
+				Value >>= 64 - Width;
+			}
+			Count += (UINT64)Value;
+		}
+		Enabled = Page->time_enabled;
+		Running = Page->time_running;
+		if (pEnabled != NULL && Page->cap_user_time) {
+			UINT64 Tsc = _read_tsc();
+			UINT64 Quotient = Tsc >> Page->time_shift;
+			UINT64 Remainder = Tsc & ((1ULL << Page->time_shift) - 1);
+			UINT64 Delta = Page->time_offset + Quotient * Page->time_mult + ((Remainder * Page->time_mult) >> Page->time_shift);
+			Enabled += Delta;
+			if (Index != 0x00)
+				Running += Delta;
+		}
+	} while ((UINT32)AtomicLoad32((volatile INT32*)&Page->lock) != Sequence);
+
+	// Not loaded in the PMU, e.g. multiplexed out, or times unknown to user mode: the kernel has them
+	if (!Page->cap_user_rdpmc || Index == 0x00 || (pEnabled != NULL && !Page->cap_user_time))
+		return PmcReadCounterSyscall(pCounter, pEnabled, pRunning);
+	if (pEnabled != NULL)
+		*pEnabled = Enabled;
+	if (pRunning != NULL)
+		*pRunning = Running;
+	return Count;
+}
+#endif
+
+_Use_decl_annotations_
+BOOL PmcQuery(
+	_In_  PCPUID_BACKEND    pBackend,
+	_Out_ PPMC_CAPABILITIES pCapabilities
+) {
+	if (pBackend == NULL || pCapabilities == NULL)
+		return FALSE;
+	RtlZeroMemory(pCapabilities, sizeof(PMC_CAPABILITIES));
+
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers))
+		return FALSE;
+	if (Registers[0] < CPUID_LEAF_PERF_MONITORING)
+		return TRUE;
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_PERF_MONITORING, 0x00, Registers))
+		return FALSE;
+
+	// 1. General-purpose counters
+	PerformanceMonitoringEax Eax = { .value = Registers[0] };
+	PerformanceMonitoringEdx Edx = { .value = Registers[3] };
+	pCapabilities->Version = Eax.elem.Version;
+	if (pCapabilities->Version == 0x00)
+		return TRUE;
+	pCapabilities->Counters = Eax.elem.Counters;
+	pCapabilities->CounterWidth = Eax.elem.CounterWidth;
+
+	// 2. Fixed counters are enumerated from version 2
+	if (pCapabilities->Version > 0x01) {
+		pCapabilities->FixedCounters = Edx.elem.FixedCounters;
+		pCapabilities->FixedCounterWidth = Edx.elem.FixedCounterWidth;
+	}
+
+	// 3. Events beyond the length of the EBX vector are not available either
+	UINT32 Length = Eax.elem.EventsLength < PMC_EVENT_COUNT ? Eax.elem.EventsLength : PMC_EVENT_COUNT;
+	pCapabilities->Unavailable = (Registers[1] & (PMC_EVENT_BIT(Length) - 1)) | ((PMC_EVENT_BIT(PMC_EVENT_COUNT) - 1) & ~(PMC_EVENT_BIT(Length) - 1));
+	return TRUE;
+}
+
+_Use_decl_annotations_
+LPCSTR PmcGetEventName(
+	_In_ UINT32 uiEvent
+) {
+	return uiEvent < PMC_EVENT_COUNT ? g_PmcEventNames[uiEvent] : "unknown";
+}
+
+static VOID PmcFlusherRoutine(
+	_In_ PVOID Parameter
+) {
+	PPMC_SESSION pSession = (PPMC_SESSION)Parameter;
+	while (!AtomicLoad32(&pSession->bStop)) {
+		for (UINT32 Slept = 0x00; Slept < pSession->Interval && !AtomicLoad32(&pSession->bStop); Slept += PMC_FLUSHER_SLICE)
+			ThreadSleep(PMC_FLUSHER_SLICE);
+		PmcFlush(pSession);
+	}
+}
+
+_Use_decl_annotations_
+BOOL PmcSessionCreate(
+	_Out_    PPMC_SESSION      pSession,
+	_In_     PCPUID_BACKEND    pBackend,
+	_In_     UINT32            uiEvents,
+	_In_     UINT32            uiInterval,
+	_In_     PMC_FLUSH_ROUTINE Routine,
+	_In_opt_ PVOID             Context
+) {
+	if (pSession == NULL || Routine == NULL)
+		return FALSE;
+	RtlZeroMemory(pSession, sizeof(PMC_SESSION));
+	if (!PmcQuery(pBackend, &pSession->Capabilities))
+		return FALSE;
+
+	// 1. Drop the events the processor does not have
+	pSession->Events = uiEvents & (PMC_EVENT_BIT(PMC_EVENT_COUNT) - 1);
+	if (pSession->Capabilities.Version != 0x00)
+		pSession->Events &= ~pSession->Capabilities.Unavailable;
+	pSession->Routine = Routine;
+	pSession->Context = Context;
+
+	// 2. Start the flusher
+	pSession->Interval = uiInterval;
+	if (uiInterval != 0x00 && !ThreadCreate(&pSession->Flusher, PmcFlusherRoutine, pSession)) {
+		pSession->Interval = 0x00;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+UINT32 PmcRegionRegister(
+	_Inout_ PPMC_SESSION pSession,
+	_In_    LPCSTR       szName
+) {
+	INT32 Index = AtomicAdd32(&pSession->RegionCount, 1) - 1;
+	if (Index >= PMC_MAX_REGIONS)
+		return PMC_INVALID_REGION;
+	pSession->Regions[Index] = szName;
+	return (UINT32)Index;
+}
+
+_Use_decl_annotations_
+BOOL PmcThreadAttach(
+	_Inout_ PPMC_SESSION pSession,
+	_Out_   PPMC_THREAD  pThread
+) {
+	if (pSession == NULL || pThread == NULL)
+		return FALSE;
+	RtlZeroMemory(pThread, sizeof(PMC_THREAD));
+	pThread->Session = pSession;
+
+#if defined(_WIN32)
+	return FALSE;
+#else
+	// 1. One perf event per counter, counting the user-mode execution of the calling thread on any processor.
+	// The first event opened, the cycles when requested, leads a group the others join: the kernel schedules
+	// a group as a whole, so the counts of a region always cover the same time. A group that does not fit in
+	// the counters left by the kernel is refused, the event is then left out.
+	SIZE_T PageSize = (SIZE_T)sysconf(_SC_PAGESIZE);
+	INT Leader = -1;
+	pThread->bRdpmc = TRUE;
+	for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++) {
+		if ((pSession->Events & PMC_EVENT_BIT(Event)) == 0x00)
+			continue;
+		struct perf_event_attr Attributes = { 0x00 };
+		Attributes.type = PERF_TYPE_HARDWARE;
+		Attributes.size = sizeof(Attributes);
+		Attributes.config = g_PmcPerfEvents[Event];
+		Attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		Attributes.exclude_kernel = 1;
+		Attributes.exclude_hv = 1;
+		INT Fd = (INT)syscall(SYS_perf_event_open, &Attributes, 0, -1, Leader, PERF_FLAG_FD_CLOEXEC);
+		if (Fd < 0)
+			continue;
+		if (Leader < 0) {
+			Leader = Fd;
+			pThread->Leader = Event;
+		}
+
+		// 2. The mmap page gives the index of the hardware counter to RDPMC
+		PPMC_COUNTER pCounter = &pThread->Counters[Event];
+		pCounter->Fd = Fd;
+		pCounter->Page = mmap(NULL, PageSize, PROT_READ, MAP_SHARED, Fd, 0x00);
+		if (pCounter->Page == MAP_FAILED)
+			pCounter->Page = NULL;
+		if (pCounter->Page == NULL || !((struct perf_event_mmap_page*)pCounter->Page)->cap_user_rdpmc)
+			pThread->bRdpmc = FALSE;
+		pThread->Events |= PMC_EVENT_BIT(Event);
+	}
+	if (pThread->Events == 0x00) {
+		pThread->bRdpmc = FALSE;
+		return FALSE;
+	}
+
+	// 3. Publish the thread to the flusher
+	INT64 Head = 0x00;
+	do {
+		Head = AtomicLoad64(&pSession->Threads);
+		pThread->Next = (PPMC_THREAD)(ULONG_PTR)Head;
+	} while (!AtomicCompareExchange64(&pSession->Threads, Head, (INT64)(ULONG_PTR)pThread));
+	return TRUE;
+#endif
+}
+
+_Use_decl_annotations_
+VOID PmcThreadDetach(
+	_Inout_ PPMC_THREAD pThread
+) {
+	if (pThread == NULL)
+		return;
+#if !defined(_WIN32)
+	SIZE_T PageSize = (SIZE_T)sysconf(_SC_PAGESIZE);
+	for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++) {
+		if ((pThread->Events & PMC_EVENT_BIT(Event)) == 0x00)
+			continue;
+		if (pThread->Counters[Event].Page != NULL)
+			munmap(pThread->Counters[Event].Page, PageSize);
+		close(pThread->Counters[Event].Fd);
+		pThread->Counters[Event].Page = NULL;
+	}
+#endif
+	pThread->Events = 0x00;
+	pThread->bRdpmc = FALSE;
+}
+
+_Use_decl_annotations_
+VOID PmcRead(
+	_In_  PPMC_THREAD pThread,
+	_Out_ PPMC_SAMPLE pSample
+) {
+	RtlZeroMemory(pSample, sizeof(PMC_SAMPLE));
+#if !defined(_WIN32)
+	for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++) {
+		if ((pThread->Events & PMC_EVENT_BIT(Event)) == 0x00)
+			continue;
+		BOOL bLeader = Event == pThread->Leader;
+		pSample->Values[Event] = PmcReadCounter(&pThread->Counters[Event], &pThread->Session->Capabilities,
+			bLeader ? &pSample->Enabled : NULL, bLeader ? &pSample->Running : NULL);
+	}
+#else
+	UNREFERENCED_PARAMETER(pThread);
+#endif
+}
+
+_Use_decl_annotations_
+VOID PmcReadSyscall(
+	_In_  PPMC_THREAD pThread,
+	_Out_ PPMC_SAMPLE pSample
+) {
+	RtlZeroMemory(pSample, sizeof(PMC_SAMPLE));
+#if !defined(_WIN32)
+	for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++) {
+		if ((pThread->Events & PMC_EVENT_BIT(Event)) == 0x00)
+			continue;
+		BOOL bLeader = Event == pThread->Leader;
+		pSample->Values[Event] = PmcReadCounterSyscall(&pThread->Counters[Event],
+			bLeader ? &pSample->Enabled : NULL, bLeader ? &pSample->Running : NULL);
+	}
+#else
+	UNREFERENCED_PARAMETER(pThread);
+#endif
+}
+
+_Use_decl_annotations_
+VOID PmcRegionLeave(
+	_Inout_ PPMC_THREAD       pThread,
+	_In_    UINT32            uiRegion,
+	_In_    const PMC_SAMPLE* pStart
+) {
+	if (uiRegion >= PMC_MAX_REGIONS)
+		return;
+	PMC_SAMPLE End = { 0x00 };
+	PmcRead(pThread, &End);
+
+	// Only this thread writes the accumulator: plain read-modify-write, published with release stores
+	PPMC_ACCUMULATOR pAccumulator = &pThread->Accumulators[uiRegion];
+	for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++) {
+		if (pThread->Events & PMC_EVENT_BIT(Event))
+			AtomicStore64(&pAccumulator->Values[Event], pAccumulator->Values[Event] + (INT64)(End.Values[Event] - pStart->Values[Event]));
+	}
+	AtomicStore64(&pAccumulator->Enabled, pAccumulator->Enabled + (INT64)(End.Enabled - pStart->Enabled));
+	AtomicStore64(&pAccumulator->Running, pAccumulator->Running + (INT64)(End.Running - pStart->Running));
+	AtomicStore64(&pAccumulator->Calls, pAccumulator->Calls + 1);
+}
+
+_Use_decl_annotations_
+VOID PmcFlush(
+	_Inout_ PPMC_SESSION pSession
+) {
+	INT32 Count = AtomicLoad32(&pSession->RegionCount);
+	if (Count > PMC_MAX_REGIONS)
+		Count = PMC_MAX_REGIONS;
+
+	for (INT32 Region = 0x00; Region < Count; Region++) {
+		if (pSession->Regions[Region] == NULL)
+			continue;
+
+		// 1. Sum the accumulators of every thread
+		PMC_TOTALS Totals = { 0x00 };
+		for (PPMC_THREAD pThread = (PPMC_THREAD)(ULONG_PTR)AtomicLoad64(&pSession->Threads); pThread != NULL; pThread = pThread->Next) {
+			Totals.Calls += (UINT64)AtomicLoad64(&pThread->Accumulators[Region].Calls);
+			for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++)
+				Totals.Values[Event] += (UINT64)AtomicLoad64(&pThread->Accumulators[Region].Values[Event]);
+			Totals.Enabled += (UINT64)AtomicLoad64(&pThread->Accumulators[Region].Enabled);
+			Totals.Running += (UINT64)AtomicLoad64(&pThread->Accumulators[Region].Running);
+		}
+
+		// 2. Report the difference with the previous flush
+		PMC_TOTALS Delta = { 0x00 };
+		Delta.Calls = Totals.Calls - pSession->Previous[Region].Calls;
+		for (UINT32 Event = 0x00; Event < PMC_EVENT_COUNT; Event++)
+			Delta.Values[Event] = Totals.Values[Event] - pSession->Previous[Region].Values[Event];
+		Delta.Enabled = Totals.Enabled - pSession->Previous[Region].Enabled;
+		Delta.Running = Totals.Running - pSession->Previous[Region].Running;
+		pSession->Previous[Region] = Totals;
+		if (Delta.Calls != 0x00)
+			pSession->Routine(pSession->Context, pSession->Regions[Region], &Delta);
+	}
+}
+
+_Use_decl_annotations_
+VOID PmcSessionDestroy(
+	_Inout_ PPMC_SESSION pSession
+) {
+	if (pSession == NULL)
+		return;
+	if (pSession->Interval != 0x00) {
+		AtomicStore32(&pSession->bStop, TRUE);
+		ThreadJoin(&pSession->Flusher);
+		pSession->Interval = 0x00;
+	}
+	PmcFlush(pSession);
+	for (PPMC_THREAD pThread = (PPMC_THREAD)(ULONG_PTR)AtomicLoad64(&pSession->Threads); pThread != NULL; pThread = pThread->Next)
+		PmcThreadDetach(pThread);
+	AtomicStore64(&pSession->Threads, 0x00);
+}
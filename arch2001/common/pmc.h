@@ -0,0 +1,260 @@
+/// @file    pmc.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __PMC_H_GUARD__
+#define __PMC_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+#include "thread.h"
+
+/// Architectural events, in the order of the bits of CPUID.0AH:EBX
+#define PMC_EVENT_CYCLES         0x00
+#define PMC_EVENT_INSTRUCTIONS   0x01
+#define PMC_EVENT_REF_CYCLES     0x02
+#define PMC_EVENT_LLC_REFERENCES 0x03
+#define PMC_EVENT_LLC_MISSES     0x04
+#define PMC_EVENT_BRANCHES       0x05
+#define PMC_EVENT_BRANCH_MISSES  0x06
+#define PMC_EVENT_COUNT          0x07
+
+/// Bit of an event in a mask of events
+#define PMC_EVENT_BIT(Event) (1UL << (Event))
+
+/// Maximum number of regions of a session
+#define PMC_MAX_REGIONS    32
+#define PMC_INVALID_REGION 0xFFFFFFFF
+
+/// <summary>
+/// Architectural performance monitoring of the processor (CPUID.0AH). Zero on processors without it, e.g. AMD,
+/// whose counters can still be used through the OS.
+/// </summary>
+typedef struct _PMC_CAPABILITIES {
+	UINT32 Version;
+	UINT32 Counters;           // General-purpose counters per logical processor.
+	UINT32 CounterWidth;       // Width of the general-purpose counters in bits.
+	UINT32 FixedCounters;
+	UINT32 FixedCounterWidth;
+	UINT32 Unavailable;        // PMC_EVENT_BIT of the architectural events not available.
+} PMC_CAPABILITIES, * PPMC_CAPABILITIES;
+
+/// <summary>
+/// Counter opened for the calling thread. On Linux, a perf event and its mmap page.
+/// </summary>
+typedef struct _PMC_COUNTER {
+	INT   Fd;
+	PVOID Page;
+} PMC_COUNTER, * PPMC_COUNTER;
+
+/// <summary>
+/// Values of the counters at a point in time.
+/// </summary>
+typedef struct _PMC_SAMPLE {
+	UINT64 Values[PMC_EVENT_COUNT];
+	UINT64 Enabled;  // Nanoseconds the group of counters has been enabled.
+	UINT64 Running;  // Nanoseconds it has been counting, less than Enabled once multiplexed.
+} PMC_SAMPLE, * PPMC_SAMPLE;
+
+/// <summary>
+/// Number of executions of a region and sum of the counters.
+/// </summary>
+typedef struct _PMC_TOTALS {
+	UINT64 Calls;
+	UINT64 Values[PMC_EVENT_COUNT];
+	UINT64 Enabled;  // Running below Enabled: the counts only cover part of the calls, their ratios still hold.
+	UINT64 Running;
+} PMC_TOTALS, * PPMC_TOTALS;
+
+/// <summary>
+/// Totals of a region on one thread. Written by the thread only, read at any time by the flusher, so that
+/// no lock nor atomic read-modify-write is needed. A flush may see the counts of a call before the call itself.
+/// </summary>
+typedef struct DECLSPEC_ALIGN(64) _PMC_ACCUMULATOR {
+	volatile INT64 Calls;
+	volatile INT64 Values[PMC_EVENT_COUNT];
+	volatile INT64 Enabled;
+	volatile INT64 Running;
+} PMC_ACCUMULATOR, * PPMC_ACCUMULATOR;
+
+typedef struct _PMC_SESSION PMC_SESSION, * PPMC_SESSION;
+
+/// <summary>
+/// Counters and accumulators of a thread. Must stay valid until the session is destroyed.
+/// </summary>
+typedef struct _PMC_THREAD {
+	struct _PMC_THREAD* Next;
+	PPMC_SESSION        Session;
+	PMC_COUNTER         Counters[PMC_EVENT_COUNT];
+	UINT32              Events;       // PMC_EVENT_BIT of the counters opened.
+	UINT32              Leader;       // Event leading the group, whose times are those of every counter.
+	BOOL                bRdpmc;       // Every counter can be read with RDPMC.
+	PMC_ACCUMULATOR     Accumulators[PMC_MAX_REGIONS];
+} PMC_THREAD, * PPMC_THREAD;
+
+/// <summary>
+/// Routine receiving the counts of a region since the previous flush.
+/// </summary>
+typedef VOID(*PMC_FLUSH_ROUTINE)(
+	_In_opt_ PVOID             Context,
+	_In_     LPCSTR            szRegion,
+	_In_     const PMC_TOTALS* pDelta
+);
+
+/// <summary>
+/// Set of regions and of the threads executing them.
+/// </summary>
+struct _PMC_SESSION {
+	PMC_CAPABILITIES  Capabilities;
+	UINT32            Events;                     // PMC_EVENT_BIT of the events requested.
+	volatile INT32    RegionCount;
+	LPCSTR            Regions[PMC_MAX_REGIONS];
+	volatile INT64    Threads;                    // Lock-free list of PMC_THREAD.
+	PMC_TOTALS        Previous[PMC_MAX_REGIONS];  // Totals at the previous flush.
+	PMC_FLUSH_ROUTINE Routine;
+	PVOID             Context;
+	UINT32            Interval;                   // Milliseconds between two flushes, 0 without a flusher thread.
+	THREAD            Flusher;
+	volatile INT32    bStop;
+};
+
+/// <summary>
+/// Decode the architectural performance monitoring leaf.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pCapabilities">Pointer to the structure receiving the capabilities.</param>
+/// <returns>Whether the processor has been queried.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PmcQuery(
+	_In_  PCPUID_BACKEND    pBackend,
+	_Out_ PPMC_CAPABILITIES pCapabilities
+);
+
+/// <summary>
+/// Get the name of an event.
+/// </summary>
+/// <param name="uiEvent">PMC_EVENT_* value.</param>
+/// <returns>Name of the event.</returns>
+LPCSTR PmcGetEventName(
+	_In_ UINT32 uiEvent
+);
+
+/// <summary>
+/// Create a session. Events the processor reports as unavailable are dropped.
+/// </summary>
+/// <param name="pSession">Pointer to the session.</param>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="uiEvents">PMC_EVENT_BIT of the events to count.</param>
+/// <param name="uiInterval">Milliseconds between two flushes by a background thread, 0 to flush with PmcFlush only.</param>
+/// <param name="Routine">Routine receiving the counts.</param>
+/// <param name="Context">Parameter passed to the routine.</param>
+/// <returns>Whether the session has been created.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PmcSessionCreate(
+	_Out_    PPMC_SESSION      pSession,
+	_In_     PCPUID_BACKEND    pBackend,
+	_In_     UINT32            uiEvents,
+	_In_     UINT32            uiInterval,
+	_In_     PMC_FLUSH_ROUTINE Routine,
+	_In_opt_ PVOID             Context
+);
+
+/// <summary>
+/// Register a region.
+/// </summary>
+/// <param name="pSession">Pointer to the session.</param>
+/// <param name="szName">Name of the region, must stay valid for the lifetime of the session.</param>
+/// <returns>Identifier of the region, or PMC_INVALID_REGION if the session is full.</returns>
+UINT32 PmcRegionRegister(
+	_Inout_ PPMC_SESSION pSession,
+	_In_    LPCSTR       szName
+);
+
+/// <summary>
+/// Open the counters of the calling thread and add it to a session. The counters only count the user-mode
+/// execution of the thread. They form one group led by the cycles, so that the kernel schedules them
+/// together and the ratios between them hold when it multiplexes the group. Events that do not fit in the
+/// group are left out. Linux only: Windows gives no user-mode access to the counters.
+/// </summary>
+/// <param name="pSession">Pointer to the session.</param>
+/// <param name="pThread">Pointer to the thread structure.</param>
+/// <returns>Whether the counters have been opened.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PmcThreadAttach(
+	_Inout_ PPMC_SESSION pSession,
+	_Out_   PPMC_THREAD  pThread
+);
+
+/// <summary>
+/// Close the counters of a thread. Its accumulators are still flushed.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure.</param>
+VOID PmcThreadDetach(
+	_Inout_ PPMC_THREAD pThread
+);
+
+/// <summary>
+/// Read the counters of the calling thread with RDPMC, falling back to the OS for counters not currently
+/// loaded in the PMU.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure of the caller.</param>
+/// <param name="pSample">Pointer to the sample.</param>
+VOID PmcRead(
+	_In_  PPMC_THREAD pThread,
+	_Out_ PPMC_SAMPLE pSample
+);
+
+/// <summary>
+/// Read the counters of the calling thread with the OS only, e.g. to compare with PmcRead.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure of the caller.</param>
+/// <param name="pSample">Pointer to the sample.</param>
+VOID PmcReadSyscall(
+	_In_  PPMC_THREAD pThread,
+	_Out_ PPMC_SAMPLE pSample
+);
+
+/// <summary>
+/// Start measuring a region.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure of the caller.</param>
+/// <param name="pStart">Pointer to the sample receiving the counters.</param>
+FORCEINLINE VOID PmcRegionEnter(
+	_In_  PPMC_THREAD pThread,
+	_Out_ PPMC_SAMPLE pStart
+) {
+	PmcRead(pThread, pStart);
+}
+
+/// <summary>
+/// Stop measuring a region and add the counts to the accumulator of the thread.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure of the caller.</param>
+/// <param name="uiRegion">Identifier of the region.</param>
+/// <param name="pStart">Pointer to the sample returned by PmcRegionEnter.</param>
+VOID PmcRegionLeave(
+	_Inout_ PPMC_THREAD       pThread,
+	_In_    UINT32            uiRegion,
+	_In_    const PMC_SAMPLE* pStart
+);
+
+/// <summary>
+/// Sum the accumulators of every thread and pass the counts since the previous flush to the routine.
+/// Must not be called concurrently with the flusher thread.
+/// </summary>
+/// <param name="pSession">Pointer to the session.</param>
+VOID PmcFlush(
+	_Inout_ PPMC_SESSION pSession
+);
+
+/// <summary>
+/// Stop the flusher thread, flush one last time and close the counters still opened.
+/// </summary>
+/// <param name="pSession">Pointer to the session.</param>
+VOID PmcSessionDestroy(
+	_Inout_ PPMC_SESSION pSession
+);
+
+#endif // !__PMC_H_GUARD__
@@ -0,0 +1,306 @@
+/// @file    pool.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "pool.h"
+#include "percpu.h"
+
+/// Number of empty rounds spinning before yielding the processor
+#define POOL_SPIN_ROUNDS 256
+
+/// Result of a steal that lost the race against another thief or the owner
+#define POOL_ABORT ((PPOOL_TASK)(ULONG_PTR)0x01)
+
+/// <summary>
+/// Push a task at the bottom of the deque. Only called by the owner.
+/// </summary>
+static BOOL PoolDequePush(
+	_Inout_ PPOOL_DEQUE pDeque,
+	_In_    PPOOL_TASK  pTask
+) {
+	INT64 Bottom = pDeque->Bottom;
+	INT64 Top = AtomicLoad64(&pDeque->Top);
+	if (Bottom - Top >= POOL_DEQUE_CAPACITY)
+		return FALSE;
+
+	// The task must be visible before the new bottom
+	pDeque->Tasks[Bottom & (POOL_DEQUE_CAPACITY - 1)] = pTask;
+	AtomicStore64(&pDeque->Bottom, Bottom + 1);
+	return TRUE;
+}
+
+/// <summary>
+/// Take the last pushed task. Only called by the owner.
+/// </summary>
+static PPOOL_TASK PoolDequeTake(
+	_Inout_ PPOOL_DEQUE pDeque
+) {
+	// 1. Reserve the bottom task. The fence orders the store with the load of the top, against which
+	//    thieves race.
+	INT64 Bottom = pDeque->Bottom - 1;
+	AtomicStore64(&pDeque->Bottom, Bottom);
+	AtomicFence();
+	INT64 Top = AtomicLoad64(&pDeque->Top);
+	if (Top > Bottom) {
+		AtomicStore64(&pDeque->Bottom, Bottom + 1);
+		return NULL;
+	}
+
+	// 2. When a single task is left, the owner competes with the thieves for it
+	PPOOL_TASK pTask = pDeque->Tasks[Bottom & (POOL_DEQUE_CAPACITY - 1)];
+	if (Top == Bottom) {
+		if (!AtomicCompareExchange64(&pDeque->Top, Top, Top + 1))
+			pTask = NULL;
+		AtomicStore64(&pDeque->Bottom, Bottom + 1);
+	}
+	return pTask;
+}
+
+/// <summary>
+/// Steal the first pushed task. Called by any thread.
+/// </summary>
+static PPOOL_TASK PoolDequeSteal(
+	_Inout_ PPOOL_DEQUE pDeque
+) {
+	INT64 Top = AtomicLoad64(&pDeque->Top);
+	AtomicFence();
+	INT64 Bottom = AtomicLoad64(&pDeque->Bottom);
+	if (Top >= Bottom)
+		return NULL;
+
+	PPOOL_TASK pTask = pDeque->Tasks[Top & (POOL_DEQUE_CAPACITY - 1)];
+	if (!AtomicCompareExchange64(&pDeque->Top, Top, Top + 1))
+		return POOL_ABORT;
+	return pTask;
+}
+
+/// <summary>
+/// Run a task and account for it.
+/// </summary>
+static VOID PoolRun(
+	_Inout_ PPOOL_WORKER pWorker,
+	_In_    PPOOL_TASK   pTask
+) {
+	pTask->Routine(pWorker, pTask);
+	pWorker->Executed++;
+	AtomicAdd64(&pWorker->Pool->Pending, -1);
+}
+
+/// <summary>
+/// Move the tasks submitted from outside the pool into the deque of a worker.
+/// </summary>
+static PPOOL_TASK PoolTakeInjected(
+	_Inout_ PPOOL_WORKER pWorker
+) {
+	// Detaching the whole stack at once avoids the ABA problem of popping a single node.
+	PPOOL pPool = pWorker->Pool;
+	if (AtomicLoad64(&pPool->Injected) == 0x00)
+		return NULL;
+	PPOOL_TASK pTask = (PPOOL_TASK)(ULONG_PTR)AtomicExchange64(&pPool->Injected, 0x00);
+	if (pTask == NULL)
+		return NULL;
+
+	PPOOL_TASK pNext = pTask->Next;
+	while (pNext != NULL) {
+		PPOOL_TASK pCurrent = pNext;
+		pNext = pCurrent->Next;
+		if (!PoolDequePush(&pWorker->Deque, pCurrent))
+			PoolRun(pWorker, pCurrent);
+	}
+	return pTask;
+}
+
+/// <summary>
+/// Steal a task, trying every victim of a distance before moving to the next distance.
+/// </summary>
+static PPOOL_TASK PoolSteal(
+	_Inout_ PPOOL_WORKER pWorker
+) {
+	PPOOL pPool = pWorker->Pool;
+	UINT32 uiFirst = 0x00;
+	pWorker->Rotation++;
+
+	for (UINT32 Distance = 0x00; Distance < POOL_DISTANCE_COUNT; Distance++) {
+		UINT32 uiCount = pWorker->Tiers[Distance] - uiFirst;
+		BOOL bRetry = TRUE;
+		while (uiCount != 0x00 && bRetry) {
+			bRetry = FALSE;
+			for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+				UINT32 uiVictim = pWorker->Victims[uiFirst + (Index + pWorker->Rotation) % uiCount];
+				PPOOL_TASK pTask = PoolDequeSteal(&pPool->Workers[uiVictim].Deque);
+				if (pTask == POOL_ABORT) {
+					bRetry = TRUE;
+					continue;
+				}
+				if (pTask != NULL) {
+					pWorker->Steals[Distance]++;
+					return pTask;
+				}
+			}
+		}
+		uiFirst = pWorker->Tiers[Distance];
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Routine of the workers.
+/// </summary>
+static VOID PoolWorkerMain(
+	_In_ PVOID Parameter
+) {
+	PPOOL_WORKER pWorker = (PPOOL_WORKER)Parameter;
+	PPOOL pPool = pWorker->Pool;
+	if (pPool->bTopology)
+		(VOID)ThreadPin(pWorker->Cpu, NULL);
+
+	UINT32 uiIdle = 0x00;
+	while (!AtomicLoad32(&pPool->bStop)) {
+		// 1. Own tasks first, then the tasks from outside, then the tasks of the other workers
+		PPOOL_TASK pTask = PoolDequeTake(&pWorker->Deque);
+		if (pTask == NULL)
+			pTask = PoolTakeInjected(pWorker);
+		if (pTask == NULL)
+			pTask = PoolSteal(pWorker);
+		if (pTask != NULL) {
+			PoolRun(pWorker, pTask);
+			uiIdle = 0x00;
+			continue;
+		}
+
+		// 2. Starved
+		if (++uiIdle < POOL_SPIN_ROUNDS)
+			AtomicPause();
+		else
+			ThreadYield();
+	}
+}
+
+/// <summary>
+/// Order the other workers by distance.
+/// </summary>
+static BOOL PoolOrderVictims(
+	_Inout_  PPOOL_WORKER    pWorker,
+	_In_opt_ const TOPOLOGY* pTopology,
+	_In_     UINT32          uiWorkers
+) {
+	pWorker->Victims = (PUINT32)calloc(uiWorkers, sizeof(UINT32));
+	if (pWorker->Victims == NULL)
+		return FALSE;
+
+	// Victims are listed from the next worker on so that neighbours do not all hit the same victim
+	for (UINT32 Distance = 0x00; Distance < POOL_DISTANCE_COUNT; Distance++) {
+		for (UINT32 Offset = 0x01; Offset < uiWorkers; Offset++) {
+			UINT32 uiVictim = (pWorker->Index + Offset) % uiWorkers;
+			UINT32 uiDistance = POOL_DISTANCE_COUNT - 1;
+			if (pTopology != NULL)
+				uiDistance = TopologyGetDistance(pTopology, pWorker->Cpu, uiVictim % pTopology->CpuCount);
+			if (uiDistance == Distance)
+				pWorker->Victims[pWorker->VictimCount++] = uiVictim;
+		}
+		pWorker->Tiers[Distance] = pWorker->VictimCount;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL PoolCreate(
+	_Out_    PPOOL           pPool,
+	_In_opt_ const TOPOLOGY* pTopology,
+	_In_     UINT32          uiWorkers
+) {
+	if (pPool == NULL)
+		return FALSE;
+	RtlZeroMemory(pPool, sizeof(POOL));
+	if (uiWorkers == 0x00)
+		uiWorkers = pTopology != NULL ? pTopology->CpuCount : ThreadGetCpuCount();
+
+	// 1. Allocate the workers, each in its own cache lines
+	pPool->Workers = (PPOOL_WORKER)PerCpuAlloc(uiWorkers * sizeof(POOL_WORKER));
+	if (pPool->Workers == NULL)
+		return FALSE;
+	RtlZeroMemory(pPool->Workers, uiWorkers * sizeof(POOL_WORKER));
+	pPool->WorkerCount = uiWorkers;
+	pPool->bTopology = pTopology != NULL;
+
+	// 2. Place the workers and order their victims
+	for (UINT32 Index = 0x00; Index < uiWorkers; Index++) {
+		PPOOL_WORKER pWorker = &pPool->Workers[Index];
+		pWorker->Pool = pPool;
+		pWorker->Index = Index;
+		pWorker->Cpu = pTopology != NULL ? Index % pTopology->CpuCount : Index;
+		if (!PoolOrderVictims(pWorker, pTopology, uiWorkers)) {
+			PoolDestroy(pPool);
+			return FALSE;
+		}
+	}
+
+	// 3. Start the workers
+	for (UINT32 Index = 0x00; Index < uiWorkers; Index++) {
+		if (!ThreadCreate(&pPool->Workers[Index].Thread, PoolWorkerMain, &pPool->Workers[Index])) {
+			PoolDestroy(pPool);
+			return FALSE;
+		}
+		pPool->StartedCount++;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID PoolSubmit(
+	_Inout_ PPOOL      pPool,
+	_In_    PPOOL_TASK pTask
+) {
+	AtomicAdd64(&pPool->Pending, 1);
+	INT64 Head = 0x00;
+	do {
+		Head = AtomicLoad64(&pPool->Injected);
+		pTask->Next = (PPOOL_TASK)(ULONG_PTR)Head;
+	} while (!AtomicCompareExchange64(&pPool->Injected, Head, (INT64)(ULONG_PTR)pTask));
+}
+
+_Use_decl_annotations_
+VOID PoolSpawn(
+	_Inout_ PPOOL_WORKER pWorker,
+	_In_    PPOOL_TASK   pTask
+) {
+	AtomicAdd64(&pWorker->Pool->Pending, 1);
+	if (!PoolDequePush(&pWorker->Deque, pTask))
+		PoolRun(pWorker, pTask);
+}
+
+_Use_decl_annotations_
+VOID PoolWait(
+	_Inout_ PPOOL pPool
+) {
+	UINT32 uiIdle = 0x00;
+	while (AtomicLoad64(&pPool->Pending) != 0x00) {
+		if (++uiIdle < POOL_SPIN_ROUNDS)
+			AtomicPause();
+		else
+			ThreadYield();
+	}
+}
+
+_Use_decl_annotations_
+VOID PoolDestroy(
+	_Inout_ PPOOL pPool
+) {
+	if (pPool == NULL || pPool->Workers == NULL)
+		return;
+
+	// 1. Stop the workers
+	AtomicStore32(&pPool->bStop, TRUE);
+	for (UINT32 Index = 0x00; Index < pPool->StartedCount; Index++)
+		ThreadJoin(&pPool->Workers[Index].Thread);
+
+	// 2. Release the memory
+	for (UINT32 Index = 0x00; Index < pPool->WorkerCount; Index++)
+		free(pPool->Workers[Index].Victims);
+	PerCpuFree(pPool->Workers);
+	RtlZeroMemory(pPool, sizeof(POOL));
+}
@@ -0,0 +1,132 @@
+/// @file    pool.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __POOL_H_GUARD__
+#define __POOL_H_GUARD__
+#include "ost.h"
+#include "atomic.h"
+#include "thread.h"
+#include "topology.h"
+
+/// Number of tasks a worker can queue, must be a power of two
+#define POOL_DEQUE_CAPACITY 4096
+
+/// Number of distances returned by TopologyGetDistance
+#define POOL_DISTANCE_COUNT 4
+
+typedef struct _POOL POOL, * PPOOL;
+typedef struct _POOL_WORKER POOL_WORKER, * PPOOL_WORKER;
+typedef struct _POOL_TASK POOL_TASK, * PPOOL_TASK;
+
+/// <summary>
+/// Unit of work, owned by the caller until its routine returns.
+/// </summary>
+struct _POOL_TASK {
+	VOID(*Routine)(
+		_In_ PPOOL_WORKER Worker,
+		_In_ PPOOL_TASK   Task
+	);
+	PVOID      Parameter;
+	PPOOL_TASK Next; // Used by the pool while the task is submitted from outside.
+};
+
+/// <summary>
+/// Chase-Lev deque. The owner pushes and takes at the bottom, thieves steal at the top. Both ends
+/// live in their own cache line.
+/// </summary>
+typedef struct DECLSPEC_ALIGN(CACHE_LINE_SIZE) _POOL_DEQUE {
+	volatile INT64      Top;
+	UINT8               Padding0[CACHE_LINE_SIZE - sizeof(INT64)];
+	volatile INT64      Bottom;
+	UINT8               Padding1[CACHE_LINE_SIZE - sizeof(INT64)];
+	PPOOL_TASK volatile Tasks[POOL_DEQUE_CAPACITY];
+} POOL_DEQUE, * PPOOL_DEQUE;
+
+/// <summary>
+/// Worker of a pool. Victims are ordered by distance so that a starved worker first steals from the
+/// workers sharing its caches.
+/// </summary>
+struct DECLSPEC_ALIGN(CACHE_LINE_SIZE) _POOL_WORKER {
+	POOL_DEQUE Deque;
+	PPOOL      Pool;
+	THREAD     Thread;
+	UINT32     Index;
+	UINT32     Cpu;
+	PUINT32    Victims;
+	UINT32     VictimCount;
+	UINT32     Tiers[POOL_DISTANCE_COUNT]; // Index of the first victim after each distance.
+	UINT32     Rotation;
+	UINT64     Executed;
+	UINT64     Steals[POOL_DISTANCE_COUNT];
+};
+
+/// <summary>
+/// Work-stealing pool. Without a topology the pool is flat: workers are not pinned and steal from
+/// every other worker in turn.
+/// </summary>
+struct _POOL {
+	PPOOL_WORKER   Workers;
+	UINT32         WorkerCount;
+	UINT32         StartedCount;
+	BOOL           bTopology;
+	volatile INT64 Injected; // Lock-free stack of tasks submitted from outside the pool.
+	volatile INT64 Pending;  // Submitted tasks whose routine has not returned yet.
+	volatile INT32 bStop;
+};
+
+/// <summary>
+/// Start a pool.
+/// </summary>
+/// <param name="pPool">Pointer to the pool.</param>
+/// <param name="pTopology">Optional topology. Workers are pinned to its processors and steal by distance.</param>
+/// <param name="uiWorkers">Number of workers, or zero for one per logical processor.</param>
+/// <returns>Whether the pool has been started.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PoolCreate(
+	_Out_    PPOOL           pPool,
+	_In_opt_ const TOPOLOGY* pTopology,
+	_In_     UINT32          uiWorkers
+);
+
+/// <summary>
+/// Submit a task from a thread that does not belong to the pool.
+/// </summary>
+/// <param name="pPool">Pointer to the pool.</param>
+/// <param name="pTask">Pointer to the task.</param>
+VOID PoolSubmit(
+	_Inout_ PPOOL      pPool,
+	_In_    PPOOL_TASK pTask
+);
+
+/// <summary>
+/// Submit a task from a running task. The task is queued on the worker and runs there unless a
+/// starved worker steals it. It runs immediately when the queue of the worker is full.
+/// </summary>
+/// <param name="pWorker">Worker running the calling task.</param>
+/// <param name="pTask">Pointer to the task.</param>
+VOID PoolSpawn(
+	_Inout_ PPOOL_WORKER pWorker,
+	_In_    PPOOL_TASK   pTask
+);
+
+/// <summary>
+/// Wait until all the submitted tasks, and the tasks they spawned, have returned.
+/// </summary>
+/// <param name="pPool">Pointer to the pool.</param>
+VOID PoolWait(
+	_Inout_ PPOOL pPool
+);
+
+/// <summary>
+/// Stop the workers and release the pool. Queued tasks are dropped.
+/// </summary>
+/// <param name="pPool">Pointer to the pool.</param>
+VOID PoolDestroy(
+	_Inout_ PPOOL pPool
+);
+
+#endif // !__POOL_H_GUARD__
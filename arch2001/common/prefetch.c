@@ -0,0 +1,439 @@
+/// @file    prefetch.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <signal.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prefetch.h"
+#include "atomic.h"
+#include "cpuid.h"
+#include "thread.h"
+
+/// CPUID.80000021H:EAX[13], MSR_AMD_PREFETCH_CONTROL is available
+#define PREFETCH_AMD_CPUID_BIT 0x00002000
+
+/// Largest number of runs of a configuration
+#define PREFETCH_MAX_RUNS 64
+
+/// Prefetchers of Intel processors
+static const PREFETCHER g_PrefetchIntel[] = {
+	{ "l2-stream",   "L2 hardware streamer",                 PREFETCH_INTEL_L2_STREAMER },
+	{ "l2-adjacent", "L2 adjacent cache line prefetcher",    PREFETCH_INTEL_L2_ADJACENT },
+	{ "l1-stream",   "L1 data cache next line prefetcher",   PREFETCH_INTEL_DCU_STREAMER },
+	{ "l1-ip",       "L1 data cache IP stride prefetcher",   PREFETCH_INTEL_DCU_IP }
+};
+
+/// Prefetchers of AMD processors
+static const PREFETCHER g_PrefetchAmd[] = {
+	{ "l1-stream", "L1 data cache stream prefetcher",      PREFETCH_AMD_L1_STREAM },
+	{ "l1-stride", "L1 data cache stride prefetcher",      PREFETCH_AMD_L1_STRIDE },
+	{ "l1-region", "L1 data cache region prefetcher",      PREFETCH_AMD_L1_REGION },
+	{ "l2-stream", "L2 stream prefetcher",                 PREFETCH_AMD_L2_STREAM },
+	{ "up-down",   "L2 up/down adjacent line prefetcher",  PREFETCH_AMD_UP_DOWN }
+};
+
+/// Control whose settings are restored when the process exits
+static PPREFETCH_CONTROL g_PrefetchActive = NULL;
+static BOOL              g_PrefetchHooked = FALSE;
+#if !defined(_WIN32)
+static volatile sig_atomic_t g_PrefetchSignal = 0x00; // Signal received, handled outside of the handler.
+#endif
+
+/// <summary>
+/// Thread running the workload on one processor.
+/// </summary>
+typedef struct _PREFETCH_THREAD {
+	THREAD                Thread;
+	struct _PREFETCH_RUN* Run;
+	UINT32                Index;
+	UINT32                Cpu;
+	BOOL                  bPinned;
+	UINT64                Operations;
+	UINT64                End;
+} PREFETCH_THREAD, * PPREFETCH_THREAD;
+
+/// <summary>
+/// One run of the workload on every processor.
+/// </summary>
+typedef struct _PREFETCH_RUN {
+	PREFETCH_WORKLOAD Workload;
+	PVOID             Context;
+	DECLSPEC_ALIGN(CACHE_LINE_SIZE) volatile INT32 Ready;
+	DECLSPEC_ALIGN(CACHE_LINE_SIZE) volatile INT32 Go;
+} PREFETCH_RUN, * PPREFETCH_RUN;
+
+/// <summary>
+/// Write the original value back to every processor modified.
+/// </summary>
+static VOID PrefetchRestore(
+	_Inout_ PPREFETCH_CONTROL pControl
+) {
+	for (UINT32 Cpu = 0x00; Cpu < pControl->CpuCount; Cpu++) {
+		if (pControl->Modified[Cpu] && MsrWrite(pControl->Msr, Cpu, pControl->Address, pControl->Original[Cpu]))
+			pControl->Modified[Cpu] = FALSE;
+	}
+}
+
+static VOID PrefetchAtExit() {
+	if (g_PrefetchActive != NULL)
+		PrefetchRestore(g_PrefetchActive);
+}
+
+#if defined(_WIN32)
+static BOOL WINAPI PrefetchCtrlHandler(DWORD dwCtrlType) {
+	(VOID)dwCtrlType;
+	PrefetchAtExit();
+	return FALSE;
+}
+#else
+/// <summary>
+/// Only record the signal: MsrWrite is not async-signal-safe, the settings are restored by PrefetchHandleSignal.
+/// </summary>
+static void PrefetchSignalHandler(int Signal) {
+	g_PrefetchSignal = Signal;
+}
+#endif
+
+/// <summary>
+/// Once a signal has been received, restore the settings and end the process with that signal. Called before
+/// every write of the MSR and when the control is closed.
+/// </summary>
+static VOID PrefetchHandleSignal() {
+#if !defined(_WIN32)
+	INT Signal = (INT)g_PrefetchSignal;
+	if (Signal == 0x00)
+		return;
+	PrefetchAtExit();
+
+	struct sigaction Action = { 0x00 };
+	Action.sa_handler = SIG_DFL;
+	sigemptyset(&Action.sa_mask);
+	sigaction(Signal, &Action, NULL);
+	raise(Signal);
+#endif
+}
+
+/// <summary>
+/// Restore the settings however the process ends: exit, Ctrl+C or termination request. On Linux, a signal
+/// is acted upon at the next write of the MSR or when the control is closed, at most one run later.
+/// </summary>
+static VOID PrefetchHook() {
+	if (g_PrefetchHooked)
+		return;
+	g_PrefetchHooked = TRUE;
+	atexit(PrefetchAtExit);
+#if defined(_WIN32)
+	SetConsoleCtrlHandler(PrefetchCtrlHandler, TRUE);
+#else
+	struct sigaction Action = { 0x00 };
+	Action.sa_handler = PrefetchSignalHandler;
+	Action.sa_flags = SA_RESTART;
+	sigemptyset(&Action.sa_mask);
+	sigaction(SIGINT, &Action, NULL);
+	sigaction(SIGTERM, &Action, NULL);
+	sigaction(SIGHUP, &Action, NULL);
+#endif
+}
+
+_Use_decl_annotations_
+BOOL PrefetchOpen(
+	_Out_ PPREFETCH_CONTROL pControl,
+	_In_  PMSR_BACKEND      pMsr
+) {
+	RtlZeroMemory(pControl, sizeof(PREFETCH_CONTROL));
+	if (g_PrefetchActive != NULL)
+		return FALSE;
+
+	// 1. The MSR and its bits depend on the vendor
+	const CPUID_INFORMATION* pCpuid = CpuidGetInformation();
+	UINT Registers[4] = { 0x00 };
+	if (strcmp(pCpuid->Vendor, "GenuineIntel") == 0x00) {
+		pControl->Address = MSR_MISC_FEATURE_CONTROL;
+		pControl->Prefetchers = g_PrefetchIntel;
+		pControl->Count = ARRAYSIZE(g_PrefetchIntel);
+	}
+	else if (strcmp(pCpuid->Vendor, "AuthenticAMD") == 0x00 && pCpuid->MaximumExtendedLeaf >= CPUID_LEAF_EXTENDED_FEATURES_2
+		&& CpuidQuery(CPUID_LEAF_EXTENDED_FEATURES_2, 0x00, Registers) && (Registers[0] & PREFETCH_AMD_CPUID_BIT)) {
+		pControl->Address = MSR_AMD_PREFETCH_CONTROL;
+		pControl->Prefetchers = g_PrefetchAmd;
+		pControl->Count = ARRAYSIZE(g_PrefetchAmd);
+	}
+	else {
+		return FALSE;
+	}
+
+	// 2. Save every processor, the MSR is missing on some models of the vendor
+	pControl->Msr = pMsr;
+	pControl->CpuCount = ThreadGetCpuCount();
+	pControl->Original = (PUINT64)calloc(pControl->CpuCount, sizeof(UINT64));
+	pControl->Modified = (PBOOL)calloc(pControl->CpuCount, sizeof(BOOL));
+	BOOL bSuccess = pControl->Original != NULL && pControl->Modified != NULL;
+	for (UINT32 Cpu = 0x00; bSuccess && Cpu < pControl->CpuCount; Cpu++)
+		bSuccess = MsrRead(pMsr, Cpu, pControl->Address, &pControl->Original[Cpu]);
+	if (!bSuccess) {
+		free(pControl->Original);
+		free(pControl->Modified);
+		RtlZeroMemory(pControl, sizeof(PREFETCH_CONTROL));
+		return FALSE;
+	}
+
+	// 3. From now on, whatever happens, the settings are put back
+	g_PrefetchActive = pControl;
+	PrefetchHook();
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID PrefetchClose(
+	_Inout_ PPREFETCH_CONTROL pControl
+) {
+	if (pControl->Original == NULL)
+		return;
+	PrefetchRestore(pControl);
+	if (g_PrefetchActive == pControl)
+		g_PrefetchActive = NULL;
+	free(pControl->Original);
+	free(pControl->Modified);
+	RtlZeroMemory(pControl, sizeof(PREFETCH_CONTROL));
+	PrefetchHandleSignal();
+}
+
+_Use_decl_annotations_
+BOOL PrefetchGet(
+	_In_  PPREFETCH_CONTROL pControl,
+	_In_  UINT32            uiCpu,
+	_Out_ PUINT32           pDisabled
+) {
+	UINT64 Value = 0x00;
+	*pDisabled = 0x00;
+	if (!MsrRead(pControl->Msr, uiCpu, pControl->Address, &Value))
+		return FALSE;
+	for (UINT32 Index = 0x00; Index < pControl->Count; Index++) {
+		if (Value & pControl->Prefetchers[Index].Bit)
+			*pDisabled |= 1U << Index;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL PrefetchSet(
+	_Inout_ PPREFETCH_CONTROL       pControl,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_    UINT32                  uiCpuCount,
+	_In_    UINT32                  uiDisabled
+) {
+	PrefetchHandleSignal();
+	UINT64 Mask = 0x00;
+	UINT64 Bits = 0x00;
+	for (UINT32 Index = 0x00; Index < pControl->Count; Index++) {
+		Mask |= pControl->Prefetchers[Index].Bit;
+		if (uiDisabled & (1U << Index))
+			Bits |= pControl->Prefetchers[Index].Bit;
+	}
+
+	for (UINT32 Index = 0x00; Index < uiCpuCount; Index++) {
+		UINT32 Cpu = pCpus[Index];
+		if (Cpu >= pControl->CpuCount)
+			return FALSE;
+
+		// Reserved and unrelated bits keep the value the firmware gave them
+		UINT64 Value = uiDisabled == PREFETCH_ORIGINAL ? pControl->Original[Cpu] : (pControl->Original[Cpu] & ~Mask) | Bits;
+		pControl->Modified[Cpu] = TRUE;
+		if (!MsrWrite(pControl->Msr, Cpu, pControl->Address, Value))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL PrefetchParse(
+	_In_  const PREFETCH_CONTROL* pControl,
+	_In_  LPCSTR                  szConfiguration,
+	_Out_ PUINT32                 pDisabled
+) {
+	*pDisabled = 0x00;
+	if (strcmp(szConfiguration, "original") == 0x00) {
+		*pDisabled = PREFETCH_ORIGINAL;
+		return TRUE;
+	}
+	if (strcmp(szConfiguration, "none") == 0x00)
+		return TRUE;
+	if (strcmp(szConfiguration, "all") == 0x00) {
+		*pDisabled = (1U << pControl->Count) - 1;
+		return TRUE;
+	}
+
+	// Comma separated names
+	for (LPCSTR szName = szConfiguration; *szName != '\0';) {
+		SIZE_T Length = strcspn(szName, ",");
+		UINT32 Index = 0x00;
+		for (; Index < pControl->Count; Index++) {
+			if (strlen(pControl->Prefetchers[Index].Name) == Length && strncmp(pControl->Prefetchers[Index].Name, szName, Length) == 0x00)
+				break;
+		}
+		if (Index == pControl->Count)
+			return FALSE;
+		*pDisabled |= 1U << Index;
+		szName += Length;
+		if (*szName == ',')
+			szName++;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID PrefetchFormat(
+	_In_                 const PREFETCH_CONTROL* pControl,
+	_In_                 UINT32                  uiDisabled,
+	_Out_writes_(uiSize) LPSTR                   szBuffer,
+	_In_                 UINT32                  uiSize
+) {
+	if (uiDisabled == PREFETCH_ORIGINAL) {
+		snprintf(szBuffer, uiSize, "original");
+		return;
+	}
+	if (uiDisabled == 0x00) {
+		snprintf(szBuffer, uiSize, "none");
+		return;
+	}
+	UINT32 Length = 0x00;
+	szBuffer[0] = '\0';
+	for (UINT32 Index = 0x00; Index < pControl->Count; Index++) {
+		if ((uiDisabled & (1U << Index)) == 0x00)
+			continue;
+		INT Written = snprintf(szBuffer + Length, uiSize - Length, "%s%s", Length == 0x00 ? "" : ",", pControl->Prefetchers[Index].Name);
+		if (Written < 0x00 || (UINT32)Written >= uiSize - Length)
+			break;
+		Length += (UINT32)Written;
+	}
+}
+
+static VOID PrefetchThreadRoutine(
+	_In_ PVOID Parameter
+) {
+	PPREFETCH_THREAD pThread = (PPREFETCH_THREAD)Parameter;
+	PPREFETCH_RUN pRun = pThread->Run;
+	pThread->bPinned = ThreadPin(pThread->Cpu, NULL);
+
+	// Start together, so that the threads compete for the shared caches and memory as in production
+	AtomicAdd32(&pRun->Ready, 1);
+	while (AtomicLoad32(&pRun->Go) == 0x00)
+		AtomicPause();
+	pThread->Operations = pRun->Workload(pRun->Context, pThread->Index);
+	pThread->End = ThreadGetTime();
+}
+
+/// <summary>
+/// Run the workload once on every processor.
+/// </summary>
+static BOOL PrefetchRunOnce(
+	_In_    PREFETCH_WORKLOAD Workload,
+	_In_opt_ PVOID            Context,
+	_Inout_ PPREFETCH_THREAD  pThreads,
+	_In_    UINT32            uiCpuCount,
+	_Out_   PUINT64           pOperations,
+	_Out_   PUINT64           pNanoseconds
+) {
+	PREFETCH_RUN Run;
+	RtlZeroMemory((PVOID)&Run, sizeof(Run));
+	Run.Workload = Workload;
+	Run.Context = Context;
+	*pOperations = 0x00;
+	*pNanoseconds = 0x00;
+
+	UINT32 Started = 0x00;
+	for (; Started < uiCpuCount; Started++) {
+		pThreads[Started].Run = &Run;
+		pThreads[Started].Index = Started;
+		if (!ThreadCreate(&pThreads[Started].Thread, PrefetchThreadRoutine, &pThreads[Started]))
+			break;
+	}
+	while (AtomicLoad32(&Run.Ready) != (INT32)Started)
+		ThreadYield();
+	UINT64 Start = ThreadGetTime();
+	AtomicStore32(&Run.Go, 1);
+
+	BOOL bSuccess = Started == uiCpuCount;
+	for (UINT32 Index = 0x00; Index < Started; Index++) {
+		ThreadJoin(&pThreads[Index].Thread);
+		bSuccess = bSuccess && pThreads[Index].bPinned;
+		*pOperations += pThreads[Index].Operations;
+		if (pThreads[Index].End - Start > *pNanoseconds)
+			*pNanoseconds = pThreads[Index].End - Start;
+	}
+	return bSuccess;
+}
+
+static INT PrefetchCompareTime(
+	_In_ const void* a,
+	_In_ const void* b
+) {
+	const UINT64* Left = (const UINT64*)a;
+	const UINT64* Right = (const UINT64*)b;
+	return Left[0] < Right[0] ? -1 : Left[0] > Right[0] ? 1 : 0;
+}
+
+_Use_decl_annotations_
+BOOL PrefetchCompare(
+	_Inout_ PPREFETCH_CONTROL       pControl,
+	_In_    PREFETCH_WORKLOAD       Workload,
+	_In_opt_ PVOID                  Context,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_    UINT32                  uiCpuCount,
+	_In_reads_(uiCount) const UINT32* pConfigurations,
+	_In_    UINT32                  uiCount,
+	_In_    UINT32                  uiRuns,
+	_Out_writes_(uiCount) PPREFETCH_RESULT pResults
+) {
+	RtlZeroMemory(pResults, sizeof(PREFETCH_RESULT) * uiCount);
+	if (uiRuns == 0x00 || uiRuns > PREFETCH_MAX_RUNS || uiCpuCount == 0x00 || uiCount == 0x00)
+		return FALSE;
+
+	// 1. Time and operations of every run, in pairs so that they are sorted together
+	PUINT64 pSamples = (PUINT64)calloc((SIZE_T)uiCount * uiRuns * 2, sizeof(UINT64));
+	PPREFETCH_THREAD pThreads = (PPREFETCH_THREAD)calloc(uiCpuCount, sizeof(PREFETCH_THREAD));
+	BOOL bSuccess = pSamples != NULL && pThreads != NULL;
+	for (UINT32 Index = 0x00; bSuccess && Index < uiCpuCount; Index++)
+		pThreads[Index].Cpu = pCpus[Index];
+
+	// 2. A B C A B C ... rather than A A A B B B ...
+	for (UINT32 Run = 0x00; bSuccess && Run < uiRuns; Run++) {
+		for (UINT32 Configuration = 0x00; bSuccess && Configuration < uiCount; Configuration++) {
+			PUINT64 pSample = &pSamples[((SIZE_T)Configuration * uiRuns + Run) * 2];
+			bSuccess = PrefetchSet(pControl, pCpus, uiCpuCount, pConfigurations[Configuration])
+				&& PrefetchRunOnce(Workload, Context, pThreads, uiCpuCount, &pSample[1], &pSample[0]);
+		}
+	}
+	(VOID)PrefetchSet(pControl, pCpus, uiCpuCount, PREFETCH_ORIGINAL);
+
+	// 3. Median run of every configuration, compared with the first one
+	for (UINT32 Configuration = 0x00; bSuccess && Configuration < uiCount; Configuration++) {
+		PUINT64 pSample = &pSamples[(SIZE_T)Configuration * uiRuns * 2];
+		qsort(pSample, uiRuns, sizeof(UINT64) * 2, PrefetchCompareTime);
+		pSample += (uiRuns / 2) * 2;
+
+		PPREFETCH_RESULT pResult = &pResults[Configuration];
+		pResult->Disabled = pConfigurations[Configuration];
+		pResult->Nanoseconds = pSample[0];
+		pResult->Operations = pSample[1];
+		if (pResult->Nanoseconds != 0x00)
+			pResult->Throughput = (double)pResult->Operations * 1e9 / (double)pResult->Nanoseconds;
+		if (pResult->Operations != 0x00)
+			pResult->Latency = (double)pResult->Nanoseconds * uiCpuCount / (double)pResult->Operations;
+		if (pResults[0].Throughput != 0.0)
+			pResult->ThroughputDelta = 100.0 * (pResult->Throughput - pResults[0].Throughput) / pResults[0].Throughput;
+		if (pResults[0].Latency != 0.0)
+			pResult->LatencyDelta = 100.0 * (pResult->Latency - pResults[0].Latency) / pResults[0].Latency;
+	}
+	free(pSamples);
+	free(pThreads);
+	return bSuccess;
+}
@@ -0,0 +1,186 @@
+/// @file    prefetch.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __PREFETCH_H_GUARD__
+#define __PREFETCH_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// Model specific MSRs controlling the hardware prefetchers, a set bit disables a prefetcher
+#define MSR_MISC_FEATURE_CONTROL 0x000001A4 // Intel, per core.
+#define MSR_AMD_PREFETCH_CONTROL 0xC0000108 // AMD, enumerated by CPUID.80000021H:EAX[13].
+
+/// Bits of MSR_MISC_FEATURE_CONTROL
+#define PREFETCH_INTEL_L2_STREAMER  0x00000001
+#define PREFETCH_INTEL_L2_ADJACENT  0x00000002 // Fetches the other line of the 128-byte pair.
+#define PREFETCH_INTEL_DCU_STREAMER 0x00000004 // L1D next line.
+#define PREFETCH_INTEL_DCU_IP       0x00000008 // L1D stride, per instruction.
+
+/// Bits of MSR_AMD_PREFETCH_CONTROL
+#define PREFETCH_AMD_L1_STREAM 0x00000001
+#define PREFETCH_AMD_L1_STRIDE 0x00000002
+#define PREFETCH_AMD_L1_REGION 0x00000004
+#define PREFETCH_AMD_L2_STREAM 0x00000008
+#define PREFETCH_AMD_UP_DOWN   0x00000020 // L2 up/down, adjacent line in either direction.
+
+/// Configuration meaning "the settings found by PrefetchOpen"
+#define PREFETCH_ORIGINAL 0xFFFFFFFF
+
+/// <summary>
+/// Hardware prefetcher of the processor.
+/// </summary>
+typedef struct _PREFETCHER {
+	LPCSTR Name;        // Short name used on the command line, e.g. "l2-stream".
+	LPCSTR Description;
+	UINT64 Bit;         // Bit of the MSR disabling it.
+} PREFETCHER, * PPREFETCHER;
+
+/// <summary>
+/// Prefetcher control of the processors. Configurations are masks of indices into Prefetchers, a set
+/// bit meaning the prefetcher is disabled, so that the same mask means the same thing on any vendor.
+/// </summary>
+typedef struct _PREFETCH_CONTROL {
+	PMSR_BACKEND      Msr;
+	UINT32            Address;     // MSR holding the controls.
+	const PREFETCHER* Prefetchers;
+	UINT32            Count;
+	UINT32            CpuCount;
+	PUINT64           Original;    // MSR value of every processor when opened.
+	PBOOL             Modified;    // Whether the MSR of a processor has been written since.
+} PREFETCH_CONTROL, * PPREFETCH_CONTROL;
+
+/// <summary>
+/// Workload run by PrefetchCompare on every processor at the same time.
+/// </summary>
+/// <param name="Context">Context given to PrefetchCompare.</param>
+/// <param name="uiThread">Index of the thread, from 0 to the number of processors minus one.</param>
+/// <returns>Number of operations performed, e.g. loads or requests.</returns>
+typedef UINT64(*PREFETCH_WORKLOAD)(
+	_In_ PVOID  Context,
+	_In_ UINT32 uiThread
+);
+
+/// <summary>
+/// Result of a configuration in PrefetchCompare, from the median run.
+/// </summary>
+typedef struct _PREFETCH_RESULT {
+	UINT32 Disabled;         // Configuration, or PREFETCH_ORIGINAL.
+	UINT64 Operations;       // Operations of all the threads.
+	UINT64 Nanoseconds;      // Wall time until the last thread finished.
+	double Throughput;       // Operations per second.
+	double Latency;          // Nanoseconds per operation and thread.
+	double ThroughputDelta;  // Relative to the first configuration, in percent.
+	double LatencyDelta;
+} PREFETCH_RESULT, * PPREFETCH_RESULT;
+
+/// <summary>
+/// Select the prefetcher MSR of the vendor and save the settings of every processor. The settings are
+/// restored by PrefetchClose, and also when the process exits or is interrupted before that.
+/// </summary>
+/// <param name="pControl">Pointer to the structure to initialise.</param>
+/// <param name="pMsr">Pointer to an opened MSR backend able to write.</param>
+/// <returns>Whether the prefetchers can be controlled. Only one control can be opened at a time.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PrefetchOpen(
+	_Out_ PPREFETCH_CONTROL pControl,
+	_In_  PMSR_BACKEND      pMsr
+);
+
+/// <summary>
+/// Restore the settings of every processor modified and release the control.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+VOID PrefetchClose(
+	_Inout_ PPREFETCH_CONTROL pControl
+);
+
+/// <summary>
+/// Get the configuration of a processor.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="pDisabled">Pointer receiving the mask of disabled prefetchers.</param>
+/// <returns>Whether the MSR has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PrefetchGet(
+	_In_  PPREFETCH_CONTROL pControl,
+	_In_  UINT32            uiCpu,
+	_Out_ PUINT32           pDisabled
+);
+
+/// <summary>
+/// Apply a configuration to a set of processors, leaving the other bits of the MSR untouched.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="pCpus">Indices of the processors.</param>
+/// <param name="uiCpuCount">Number of processors.</param>
+/// <param name="uiDisabled">Mask of prefetchers to disable, or PREFETCH_ORIGINAL.</param>
+/// <returns>Whether every processor has been configured.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PrefetchSet(
+	_Inout_ PPREFETCH_CONTROL       pControl,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_    UINT32                  uiCpuCount,
+	_In_    UINT32                  uiDisabled
+);
+
+/// <summary>
+/// Parse a configuration: "none", "all", or a comma separated list of prefetchers to disable.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="szConfiguration">Configuration to parse. "original" selects the settings found by PrefetchOpen.</param>
+/// <param name="pDisabled">Pointer receiving the mask of disabled prefetchers.</param>
+/// <returns>Whether every name is known.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PrefetchParse(
+	_In_  const PREFETCH_CONTROL* pControl,
+	_In_  LPCSTR                  szConfiguration,
+	_Out_ PUINT32                 pDisabled
+);
+
+/// <summary>
+/// Format a configuration as PrefetchParse reads it.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="uiDisabled">Mask of disabled prefetchers.</param>
+/// <param name="szBuffer">Buffer receiving the configuration.</param>
+/// <param name="uiSize">Size of the buffer in bytes.</param>
+VOID PrefetchFormat(
+	_In_                 const PREFETCH_CONTROL* pControl,
+	_In_                 UINT32                  uiDisabled,
+	_Out_writes_(uiSize) LPSTR                   szBuffer,
+	_In_                 UINT32                  uiSize
+);
+
+/// <summary>
+/// Run a workload on pinned processors under each configuration in turn, interleaving the configurations
+/// run after run so that drifts of the machine affect all of them alike, then restore the processors.
+/// </summary>
+/// <param name="pControl">Pointer to the control.</param>
+/// <param name="Workload">Routine run by one thread per processor.</param>
+/// <param name="Context">Context passed to the routine.</param>
+/// <param name="pCpus">Indices of the processors.</param>
+/// <param name="uiCpuCount">Number of processors.</param>
+/// <param name="pConfigurations">Configurations, the first one being the reference of the deltas.</param>
+/// <param name="uiCount">Number of configurations.</param>
+/// <param name="uiRuns">Runs per configuration, the median one is reported.</param>
+/// <param name="pResults">Array receiving one result per configuration.</param>
+/// <returns>Whether every run has been executed.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL PrefetchCompare(
+	_Inout_ PPREFETCH_CONTROL       pControl,
+	_In_    PREFETCH_WORKLOAD       Workload,
+	_In_opt_ PVOID                  Context,
+	_In_reads_(uiCpuCount) const UINT32* pCpus,
+	_In_    UINT32                  uiCpuCount,
+	_In_reads_(uiCount) const UINT32* pConfigurations,
+	_In_    UINT32                  uiCount,
+	_In_    UINT32                  uiRuns,
+	_Out_writes_(uiCount) PPREFETCH_RESULT pResults
+);
+
+#endif // !__PREFETCH_H_GUARD__
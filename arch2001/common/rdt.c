@@ -0,0 +1,473 @@
+/// @file    rdt.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include "rdt.h"
+#include "thread.h"
+
+_Use_decl_annotations_
+BOOL RdtMonitorQuery(
+	_In_  PCPUID_BACKEND            pBackend,
+	_Out_ PRDT_MONITOR_CAPABILITIES pCapabilities
+) {
+	if (pBackend == NULL || pCapabilities == NULL)
+		return FALSE;
+	RtlZeroMemory(pCapabilities, sizeof(RDT_MONITOR_CAPABILITIES));
+
+	// 1. Check the feature flag
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers) || Registers[0] < CPUID_LEAF_RDT_MONITORING)
+		return FALSE;
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_FEATURES, 0x00, Registers))
+		return FALSE;
+	StructuredExtendedFeatureEbx Features = { .value = Registers[1] };
+	if (!Features.elem.RDTM)
+		return FALSE;
+
+	// 2. Check that the L3 cache can be monitored
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_RDT_MONITORING, 0x00, Registers) || (Registers[3] & 0x02) == 0x00)
+		return FALSE;
+
+	// 3. Get the events of the L3 cache
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_RDT_MONITORING, 0x01, Registers))
+		return FALSE;
+	pCapabilities->CounterWidth = 24 + (Registers[0] & 0xFF);
+	pCapabilities->Scale = Registers[1];
+	pCapabilities->MaximumRmid = Registers[2];
+	pCapabilities->Occupancy = (Registers[3] & 0x01) != 0x00;
+	pCapabilities->TotalBandwidth = (Registers[3] & 0x02) != 0x00;
+	pCapabilities->LocalBandwidth = (Registers[3] & 0x04) != 0x00;
+	pCapabilities->Supported = pCapabilities->MaximumRmid != 0x00;
+	return pCapabilities->Supported;
+}
+
+_Use_decl_annotations_
+BOOL RdtReadEvent(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_In_  UINT32       uiRmid,
+	_In_  UINT32       uiEvent,
+	_Out_ PUINT64      pValue
+) {
+	*pValue = 0x00;
+
+	// 1. Select the event and the RMID, then read the counter on the same processor
+	UINT64 Counter = 0x00;
+	if (!MsrWrite(pMsr, uiCpu, IA32_QM_EVTSEL, ((UINT64)uiRmid << 32) | uiEvent)
+		|| !MsrRead(pMsr, uiCpu, IA32_QM_CTR, &Counter))
+		return FALSE;
+
+	// 2. Check the status of the counter
+	if (Counter & (RDT_CTR_ERROR | RDT_CTR_UNAVAILABLE))
+		return FALSE;
+	*pValue = Counter & RDT_CTR_DATA_MASK;
+	return TRUE;
+}
+
+/// <summary>
+/// Change some bits of IA32_PQR_ASSOC on a processor, keeping the others.
+/// </summary>
+static BOOL RdtWriteAssociation(
+	_In_ PMSR_BACKEND pMsr,
+	_In_ UINT32       uiCpu,
+	_In_ UINT64       Mask,
+	_In_ UINT64       Value
+) {
+	UINT64 Association = 0x00;
+	if (!MsrRead(pMsr, uiCpu, IA32_PQR_ASSOC, &Association))
+		Association = 0x00;
+	Association = (Association & ~Mask) | (Value & Mask);
+	return MsrWrite(pMsr, uiCpu, IA32_PQR_ASSOC, Association);
+}
+
+/// <summary>
+/// Change the RMID of a processor, keeping its class of service.
+/// </summary>
+static BOOL RdtAssociate(
+	_In_ PMSR_BACKEND pMsr,
+	_In_ UINT32       uiCpu,
+	_In_ UINT32       uiRmid
+) {
+	return RdtWriteAssociation(pMsr, uiCpu, RDT_PQR_RMID_MASK, uiRmid);
+}
+
+/// <summary>
+/// Select one processor per L3 cache the workload runs on, the counters being kept per L3 cache.
+/// </summary>
+static BOOL RdtSelectReadCpus(
+	_Inout_  PRDT_WORKLOAD   pWorkload,
+	_In_opt_ const TOPOLOGY* pTopology
+) {
+	pWorkload->ReadCpus = (PUINT32)calloc(pWorkload->CpuCount, sizeof(UINT32));
+	pWorkload->PreviousTotal = (PUINT64)calloc(pWorkload->CpuCount, sizeof(UINT64));
+	pWorkload->PreviousLocal = (PUINT64)calloc(pWorkload->CpuCount, sizeof(UINT64));
+	if (pWorkload->ReadCpus == NULL || pWorkload->PreviousTotal == NULL || pWorkload->PreviousLocal == NULL)
+		return FALSE;
+
+	pWorkload->ReadCount = 0x00;
+	for (UINT32 Index = 0x00; Index < pWorkload->CpuCount; Index++) {
+		UINT32 uiCpu = pWorkload->Cpus[Index];
+		BOOL bNew = TRUE;
+		for (UINT32 Read = 0x00; bNew && Read < pWorkload->ReadCount; Read++) {
+			UINT32 uiRead = pWorkload->ReadCpus[Read];
+			if (pTopology == NULL || uiCpu >= pTopology->CpuCount || uiRead >= pTopology->CpuCount
+				|| TopologyGetDistance(pTopology, uiCpu, uiRead) <= 1)
+				bNew = FALSE;
+		}
+		if (bNew)
+			pWorkload->ReadCpus[pWorkload->ReadCount++] = uiCpu;
+	}
+	return TRUE;
+}
+
+/// <summary>
+/// Release the memory allocated for a workload.
+/// </summary>
+static VOID RdtReleaseWorkload(
+	_Inout_ PRDT_WORKLOAD pWorkload
+) {
+	free(pWorkload->ReadCpus);
+	free(pWorkload->PreviousTotal);
+	free(pWorkload->PreviousLocal);
+	pWorkload->ReadCpus = NULL;
+	pWorkload->PreviousTotal = NULL;
+	pWorkload->PreviousLocal = NULL;
+	pWorkload->ReadCount = 0x00;
+}
+
+_Use_decl_annotations_
+BOOL RdtMonitorStart(
+	_Out_    PRDT_MONITOR                    pMonitor,
+	_In_     PMSR_BACKEND                    pMsr,
+	_In_     const RDT_MONITOR_CAPABILITIES* pCapabilities,
+	_In_opt_ const TOPOLOGY*                 pTopology,
+	_Inout_updates_(uiCount) PRDT_WORKLOAD   pWorkloads,
+	_In_     UINT32                          uiCount
+) {
+	if (pMonitor == NULL || pMsr == NULL || pCapabilities == NULL || pWorkloads == NULL)
+		return FALSE;
+	RtlZeroMemory(pMonitor, sizeof(RDT_MONITOR));
+	if (!pCapabilities->Supported || uiCount > pCapabilities->MaximumRmid)
+		return FALSE;
+
+	pMonitor->Msr = pMsr;
+	pMonitor->Topology = pTopology;
+	pMonitor->Capabilities = *pCapabilities;
+	pMonitor->Workloads = pWorkloads;
+	pMonitor->WorkloadCount = uiCount;
+
+	// 1. Associate the processors of each workload with its RMID
+	BOOL bSuccess = TRUE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		PRDT_WORKLOAD pWorkload = &pWorkloads[Index];
+		pWorkload->Rmid = Index + 1;
+		bSuccess = bSuccess && RdtSelectReadCpus(pWorkload, pTopology);
+		for (UINT32 Cpu = 0x00; bSuccess && Cpu < pWorkload->CpuCount; Cpu++)
+			bSuccess = RdtAssociate(pMsr, pWorkload->Cpus[Cpu], pWorkload->Rmid);
+	}
+	if (!bSuccess) {
+		RdtMonitorStop(pMonitor);
+		return FALSE;
+	}
+
+	// 2. The first sample only sets the reference of the bandwidth counters
+	(VOID)RdtMonitorSample(pMonitor);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL RdtMonitorSample(
+	_Inout_ PRDT_MONITOR pMonitor
+) {
+	UINT64 Now = ThreadGetTime();
+	UINT64 Elapsed = pMonitor->Timestamp != 0x00 ? Now - pMonitor->Timestamp : 0x00;
+	UINT64 Mask = pMonitor->Capabilities.CounterWidth >= 62 ? RDT_CTR_DATA_MASK : (1ULL << pMonitor->Capabilities.CounterWidth) - 1;
+	UINT64 Scale = pMonitor->Capabilities.Scale;
+	BOOL bSuccess = TRUE;
+
+	for (UINT32 Index = 0x00; Index < pMonitor->WorkloadCount; Index++) {
+		PRDT_WORKLOAD pWorkload = &pMonitor->Workloads[Index];
+		UINT64 Occupancy = 0x00;
+		UINT64 Total = 0x00;
+		UINT64 Local = 0x00;
+
+		for (UINT32 Read = 0x00; Read < pWorkload->ReadCount; Read++) {
+			UINT32 uiCpu = pWorkload->ReadCpus[Read];
+			UINT64 Value = 0x00;
+
+			// 1. Occupancy is an instantaneous value
+			if (pMonitor->Capabilities.Occupancy) {
+				if (RdtReadEvent(pMonitor->Msr, uiCpu, pWorkload->Rmid, RDT_EVENT_L3_OCCUPANCY, &Value))
+					Occupancy += Value * Scale;
+				else
+					bSuccess = FALSE;
+			}
+
+			// 2. Bandwidth counters are free running and wrap at their width
+			if (pMonitor->Capabilities.TotalBandwidth) {
+				if (RdtReadEvent(pMonitor->Msr, uiCpu, pWorkload->Rmid, RDT_EVENT_TOTAL_BANDWIDTH, &Value)) {
+					Total += ((Value - pWorkload->PreviousTotal[Read]) & Mask) * Scale;
+					pWorkload->PreviousTotal[Read] = Value;
+				}
+				else
+					bSuccess = FALSE;
+			}
+			if (pMonitor->Capabilities.LocalBandwidth) {
+				if (RdtReadEvent(pMonitor->Msr, uiCpu, pWorkload->Rmid, RDT_EVENT_LOCAL_BANDWIDTH, &Value)) {
+					Local += ((Value - pWorkload->PreviousLocal[Read]) & Mask) * Scale;
+					pWorkload->PreviousLocal[Read] = Value;
+				}
+				else
+					bSuccess = FALSE;
+			}
+		}
+
+		// 3. Convert into bytes per second
+		pWorkload->Occupancy = Occupancy;
+		pWorkload->TotalRate = Elapsed != 0x00 ? (UINT64)((double)Total * 1e9 / (double)Elapsed) : 0x00;
+		pWorkload->LocalRate = Elapsed != 0x00 ? (UINT64)((double)Local * 1e9 / (double)Elapsed) : 0x00;
+	}
+
+	pMonitor->Timestamp = Now;
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+VOID RdtMonitorStop(
+	_Inout_ PRDT_MONITOR pMonitor
+) {
+	if (pMonitor == NULL || pMonitor->Workloads == NULL)
+		return;
+	for (UINT32 Index = 0x00; Index < pMonitor->WorkloadCount; Index++) {
+		PRDT_WORKLOAD pWorkload = &pMonitor->Workloads[Index];
+		for (UINT32 Cpu = 0x00; Cpu < pWorkload->CpuCount; Cpu++)
+			(VOID)RdtAssociate(pMonitor->Msr, pWorkload->Cpus[Cpu], 0x00);
+		RdtReleaseWorkload(pWorkload);
+	}
+	pMonitor->Workloads = NULL;
+	pMonitor->WorkloadCount = 0x00;
+}
+
+_Use_decl_annotations_
+BOOL RdtAllocationQuery(
+	_In_  PCPUID_BACKEND               pBackend,
+	_Out_ PRDT_ALLOCATION_CAPABILITIES pCapabilities
+) {
+	if (pBackend == NULL || pCapabilities == NULL)
+		return FALSE;
+	RtlZeroMemory(pCapabilities, sizeof(RDT_ALLOCATION_CAPABILITIES));
+
+	// 1. Check the feature flag
+	UINT Registers[4] = { 0x00 };
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers) || Registers[0] < CPUID_LEAF_RDT_ALLOCATION)
+		return FALSE;
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_FEATURES, 0x00, Registers))
+		return FALSE;
+	StructuredExtendedFeatureEbx Features = { .value = Registers[1] };
+	if (!Features.elem.RDTA)
+		return FALSE;
+
+	// 2. Get the resources that can be allocated
+	if (!CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_RDT_ALLOCATION, 0x00, Registers))
+		return FALSE;
+	UINT32 uiResources = Registers[1];
+
+	// 3. Get the capacity masks of the L3 and L2 caches, sub-leaves 1 and 2
+	for (UINT32 Resource = RDT_RESOURCE_L3; Resource <= RDT_RESOURCE_L2; Resource++) {
+		PRDT_CACHE_CAPABILITIES pCache = &pCapabilities->Cache[Resource];
+		if ((uiResources & (0x02 << Resource)) == 0x00
+			|| !CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_RDT_ALLOCATION, Resource + 1, Registers))
+			continue;
+		pCache->MaskLength = (Registers[0] & 0x1F) + 1;
+		pCache->ShareableMask = Registers[1];
+		pCache->Cdp = (Registers[2] & 0x04) != 0x00;
+		pCache->MaximumCos = Registers[3] & 0xFFFF;
+		pCache->MinimumWidth = 1; // Not enumerated. Some early processors need 2 bits.
+		pCache->Supported = TRUE;
+	}
+
+	// 4. Get the throttling values of the memory bandwidth, sub-leaf 3
+	if ((uiResources & 0x08) != 0x00 && CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_RDT_ALLOCATION, 0x03, Registers)) {
+		pCapabilities->MbaMaximumDelay = (Registers[0] & 0xFFF) + 1;
+		pCapabilities->MbaLinear = (Registers[2] & 0x04) != 0x00;
+		pCapabilities->MbaMaximumCos = Registers[3] & 0xFFFF;
+		pCapabilities->Mba = TRUE;
+	}
+	return pCapabilities->Cache[RDT_RESOURCE_L3].Supported || pCapabilities->Cache[RDT_RESOURCE_L2].Supported || pCapabilities->Mba;
+}
+
+_Use_decl_annotations_
+BOOL RdtValidateMask(
+	_In_ const RDT_CACHE_CAPABILITIES* pCache,
+	_In_ UINT64                        Mask
+) {
+	if (!pCache->Supported || Mask == 0x00 || pCache->MaskLength >= 64)
+		return FALSE;
+	if (Mask >> pCache->MaskLength)
+		return FALSE;
+
+	// Contiguous bits once the trailing zeros are removed
+	UINT32 uiWidth = 0x00;
+	while ((Mask & 0x01) == 0x00)
+		Mask >>= 1;
+	if (Mask & (Mask + 1))
+		return FALSE;
+	for (; Mask != 0x00; Mask >>= 1)
+		uiWidth++;
+	return uiWidth >= pCache->MinimumWidth;
+}
+
+_Use_decl_annotations_
+BOOL RdtGetDelay(
+	_In_  const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_  UINT32                             uiBandwidth,
+	_Out_ PUINT32                            puiDelay
+) {
+	*puiDelay = 0x00;
+	if (!pCapabilities->Mba || uiBandwidth == 0x00 || uiBandwidth > 100)
+		return FALSE;
+	if (uiBandwidth == 100)
+		return TRUE;
+
+	// Only the linear scale maps to percentages. Its granularity is the smallest bandwidth, e.g. 90 gives steps
+	// of 10%. The delay is rounded up to never exceed the requested bandwidth.
+	if (!pCapabilities->MbaLinear || pCapabilities->MbaMaximumDelay >= 100)
+		return FALSE;
+	UINT32 uiGranularity = 100 - pCapabilities->MbaMaximumDelay;
+	UINT32 uiDelay = (100 - uiBandwidth + uiGranularity - 1) / uiGranularity * uiGranularity;
+	if (uiDelay > pCapabilities->MbaMaximumDelay)
+		return FALSE;
+	*puiDelay = uiDelay;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL RdtSetMask(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_ UINT32                             uiResource,
+	_In_ UINT32                             uiCpu,
+	_In_ UINT32                             uiCos,
+	_In_ UINT64                             Mask
+) {
+	if (uiResource > RDT_RESOURCE_L2)
+		return FALSE;
+	const RDT_CACHE_CAPABILITIES* pCache = &pCapabilities->Cache[uiResource];
+	if (uiCos > pCache->MaximumCos || !RdtValidateMask(pCache, Mask))
+		return FALSE;
+	return MsrWrite(pMsr, uiCpu, (uiResource == RDT_RESOURCE_L3 ? IA32_L3_MASK_0 : IA32_L2_MASK_0) + uiCos, Mask);
+}
+
+_Use_decl_annotations_
+BOOL RdtSetCos(
+	_In_ PMSR_BACKEND pMsr,
+	_In_ UINT32       uiCpu,
+	_In_ UINT32       uiCos
+) {
+	return RdtWriteAssociation(pMsr, uiCpu, RDT_PQR_COS_MASK, (UINT64)uiCos << RDT_PQR_COS_SHIFT);
+}
+
+_Use_decl_annotations_
+BOOL RdtAllocationApply(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_Inout_updates_(uiCount) PRDT_TENANT    pTenants,
+	_In_ UINT32                             uiCount
+) {
+	if (pMsr == NULL || pCapabilities == NULL || (pTenants == NULL && uiCount != 0x00))
+		return FALSE;
+	const RDT_CACHE_CAPABILITIES* pL3 = &pCapabilities->Cache[RDT_RESOURCE_L3];
+	UINT64 Full = pL3->Supported && pL3->MaskLength < 64 ? (1ULL << pL3->MaskLength) - 1 : 0x00;
+	UINT64 Shared = Full;
+	UINT32 uiCos = 0x00;
+	BOOL bThrottle = FALSE;
+
+	// 1. Dedicated ways are taken from the bottom of the mask. Class of service 0 keeps the top ways, where the
+	//    ways shared with other agents usually are.
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		PRDT_TENANT pTenant = &pTenants[Index];
+		pTenant->Cos = 0x00;
+		pTenant->Mask = Full;
+		pTenant->Delay = 0x00;
+		if (pTenant->Ways == 0x00 && (pTenant->Bandwidth == 0x00 || pTenant->Bandwidth == 100))
+			continue;
+		pTenant->Cos = ++uiCos;
+
+		if (pTenant->Ways != 0x00) {
+			UINT32 uiLowest = 0x00;
+			UINT32 uiShared = 0x00;
+			while (uiLowest < 64 && (Shared & (1ULL << uiLowest)) == 0x00)
+				uiLowest++;
+			for (UINT64 Bits = Shared >> uiLowest; Bits != 0x00; Bits >>= 1)
+				uiShared++;
+			if (!pL3->Supported || pTenant->Ways >= uiShared)
+				return FALSE;
+			pTenant->Mask = ((1ULL << pTenant->Ways) - 1) << uiLowest;
+			Shared &= ~pTenant->Mask;
+		}
+		if (pTenant->Bandwidth != 0x00 && pTenant->Bandwidth != 100) {
+			if (!RdtGetDelay(pCapabilities, pTenant->Bandwidth, &pTenant->Delay) || pTenant->Cos > pCapabilities->MbaMaximumCos)
+				return FALSE;
+			bThrottle = TRUE;
+		}
+	}
+
+	// 2. Validate every mask before the first write. The L3 masks are written whenever the cache supports
+	//    allocation, even for a bandwidth-only policy: a class of service reused from an earlier policy would
+	//    otherwise keep its dedicated ways.
+	if (pL3->Supported && (!RdtValidateMask(pL3, Shared) || uiCos > pL3->MaximumCos))
+		return FALSE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		if (pTenants[Index].Ways == 0x00)
+			pTenants[Index].Mask = Shared;
+		if (pL3->Supported && !RdtValidateMask(pL3, pTenants[Index].Mask))
+			return FALSE;
+	}
+
+	// 3. Program the classes of service on the caches the tenants run on
+	BOOL bSuccess = TRUE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		for (UINT32 Cpu = 0x00; Cpu < pTenants[Index].CpuCount; Cpu++) {
+			UINT32 uiCpu = pTenants[Index].Cpus[Cpu];
+			if (pL3->Supported)
+				bSuccess &= RdtSetMask(pMsr, pCapabilities, RDT_RESOURCE_L3, uiCpu, 0x00, Shared);
+			for (UINT32 Tenant = 0x00; Tenant < uiCount; Tenant++) {
+				if (pTenants[Tenant].Cos == 0x00)
+					continue;
+				if (pL3->Supported)
+					bSuccess &= RdtSetMask(pMsr, pCapabilities, RDT_RESOURCE_L3, uiCpu, pTenants[Tenant].Cos, pTenants[Tenant].Mask);
+				if (bThrottle)
+					bSuccess &= MsrWrite(pMsr, uiCpu, IA32_MBA_THRTL_0 + pTenants[Tenant].Cos, pTenants[Tenant].Delay);
+			}
+		}
+	}
+
+	// 4. Associate the processors with the classes of service
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		for (UINT32 Cpu = 0x00; Cpu < pTenants[Index].CpuCount; Cpu++)
+			bSuccess &= RdtSetCos(pMsr, pTenants[Index].Cpus[Cpu], pTenants[Index].Cos);
+	}
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+VOID RdtAllocationReset(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_ UINT32                             uiCpuCount
+) {
+	for (UINT32 Cpu = 0x00; Cpu < uiCpuCount; Cpu++) {
+		for (UINT32 Resource = RDT_RESOURCE_L3; Resource <= RDT_RESOURCE_L2; Resource++) {
+			const RDT_CACHE_CAPABILITIES* pCache = &pCapabilities->Cache[Resource];
+			for (UINT32 Cos = 0x00; pCache->Supported && Cos <= pCache->MaximumCos; Cos++)
+				(VOID)RdtSetMask(pMsr, pCapabilities, Resource, Cpu, Cos, (1ULL << pCache->MaskLength) - 1);
+		}
+		for (UINT32 Cos = 0x00; pCapabilities->Mba && Cos <= pCapabilities->MbaMaximumCos; Cos++)
+			(VOID)MsrWrite(pMsr, Cpu, IA32_MBA_THRTL_0 + Cos, 0x00);
+		(VOID)RdtSetCos(pMsr, Cpu, 0x00);
+	}
+}
@@ -0,0 +1,283 @@
+/// @file    rdt.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __RDT_H_GUARD__
+#define __RDT_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+#include "msr.h"
+#include "topology.h"
+
+/// Monitoring events of IA32_QM_EVTSEL
+#define RDT_EVENT_L3_OCCUPANCY    0x01
+#define RDT_EVENT_TOTAL_BANDWIDTH 0x02
+#define RDT_EVENT_LOCAL_BANDWIDTH 0x03
+
+/// Bits of IA32_QM_CTR
+#define RDT_CTR_ERROR       (1ULL << 63) // Unsupported RMID or event.
+#define RDT_CTR_UNAVAILABLE (1ULL << 62) // No data for the RMID yet.
+#define RDT_CTR_DATA_MASK   ((1ULL << 62) - 1)
+
+/// Bits of IA32_PQR_ASSOC
+#define RDT_PQR_RMID_MASK 0x3FFULL
+#define RDT_PQR_COS_SHIFT 32
+#define RDT_PQR_COS_MASK  (0xFFFFFFFFULL << RDT_PQR_COS_SHIFT)
+
+/// Cache resources of the allocation technology
+#define RDT_RESOURCE_L3 0x00
+#define RDT_RESOURCE_L2 0x01
+
+/// <summary>
+/// Monitoring capabilities of the L3 cache (CPUID.0FH).
+/// </summary>
+typedef struct _RDT_MONITOR_CAPABILITIES {
+	BOOL   Supported;      // CPUID.07H:EBX[12] and CPUID.(0FH,0):EDX[1]
+	UINT32 MaximumRmid;    // Highest RMID of the L3 cache.
+	UINT32 Scale;          // Bytes per unit of IA32_QM_CTR.
+	UINT32 CounterWidth;   // Width of the bandwidth counters in bits.
+	BOOL   Occupancy;
+	BOOL   TotalBandwidth;
+	BOOL   LocalBandwidth;
+} RDT_MONITOR_CAPABILITIES, * PRDT_MONITOR_CAPABILITIES;
+
+/// <summary>
+/// Workload monitored with its own RMID. RMIDs are associated with logical processors, hence a workload
+/// is the set of processors its threads are pinned to.
+/// </summary>
+typedef struct _RDT_WORKLOAD {
+	LPCSTR  Name;
+	PUINT32 Cpus;
+	UINT32  CpuCount;
+	UINT32  Rmid;          // Assigned by RdtMonitorStart.
+	UINT64  Occupancy;     // Results of the last sample, in bytes and bytes per second.
+	UINT64  TotalRate;
+	UINT64  LocalRate;
+	PUINT32 ReadCpus;      // One processor per L3 cache the workload runs on.
+	UINT32  ReadCount;
+	PUINT64 PreviousTotal; // Raw counters of each L3 cache at the previous sample.
+	PUINT64 PreviousLocal;
+} RDT_WORKLOAD, * PRDT_WORKLOAD;
+
+/// <summary>
+/// Set of monitored workloads.
+/// </summary>
+typedef struct _RDT_MONITOR {
+	PMSR_BACKEND             Msr;
+	const TOPOLOGY*          Topology;
+	RDT_MONITOR_CAPABILITIES Capabilities;
+	PRDT_WORKLOAD            Workloads;
+	UINT32                   WorkloadCount;
+	UINT64                   Timestamp;   // Time of the previous sample in nanoseconds.
+} RDT_MONITOR, * PRDT_MONITOR;
+
+/// <summary>
+/// Allocation capabilities of a cache (CPUID.(10H,1) for the L3 cache and CPUID.(10H,2) for the L2 cache).
+/// </summary>
+typedef struct _RDT_CACHE_CAPABILITIES {
+	BOOL   Supported;
+	UINT32 MaskLength;     // Number of bits of the capacity masks.
+	UINT32 ShareableMask;  // Ways also used by other agents of the system, such as the GPU or I/O.
+	UINT32 MaximumCos;     // Highest class of service.
+	UINT32 MinimumWidth;   // Smallest number of contiguous bits of a mask.
+	BOOL   Cdp;            // Code and data prioritisation.
+} RDT_CACHE_CAPABILITIES, * PRDT_CACHE_CAPABILITIES;
+
+/// <summary>
+/// Allocation capabilities of the processor (CPUID.10H).
+/// </summary>
+typedef struct _RDT_ALLOCATION_CAPABILITIES {
+	RDT_CACHE_CAPABILITIES Cache[2]; // Indexed by RDT_RESOURCE_*.
+	BOOL   Mba;                      // Memory bandwidth allocation, CPUID.(10H,3).
+	UINT32 MbaMaximumDelay;          // Highest throttling value.
+	UINT32 MbaMaximumCos;
+	BOOL   MbaLinear;                // Delay values are percentages of the bandwidth.
+} RDT_ALLOCATION_CAPABILITIES, * PRDT_ALLOCATION_CAPABILITIES;
+
+/// <summary>
+/// Tenant of a cache allocation policy, running on a set of processors.
+/// </summary>
+typedef struct _RDT_TENANT {
+	LPCSTR  Name;
+	PUINT32 Cpus;
+	UINT32  CpuCount;
+	UINT32  Ways;      // LLC ways dedicated to the tenant, or 0 to share the ways of the rest of the system.
+	UINT32  Bandwidth; // Percentage of the memory bandwidth, or 0 to leave the bandwidth unthrottled.
+	UINT32  Cos;       // Assigned by RdtAllocationApply.
+	UINT64  Mask;      // Capacity mask assigned by RdtAllocationApply.
+	UINT32  Delay;     // Throttling value assigned by RdtAllocationApply.
+} RDT_TENANT, * PRDT_TENANT;
+
+/// <summary>
+/// Enumerate the monitoring capabilities.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pCapabilities">Pointer to the structure receiving the capabilities.</param>
+/// <returns>Whether L3 monitoring is supported.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL RdtMonitorQuery(
+	_In_  PCPUID_BACKEND            pBackend,
+	_Out_ PRDT_MONITOR_CAPABILITIES pCapabilities
+);
+
+/// <summary>
+/// Read a monitoring event on the L3 cache of a processor.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend.</param>
+/// <param name="uiCpu">Index of a processor sharing the L3 cache.</param>
+/// <param name="uiRmid">RMID to read.</param>
+/// <param name="uiEvent">RDT_EVENT_* value.</param>
+/// <param name="pValue">Pointer receiving the raw counter, without the error bits.</param>
+/// <returns>Whether the counter holds valid data.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL RdtReadEvent(
+	_In_  PMSR_BACKEND pMsr,
+	_In_  UINT32       uiCpu,
+	_In_  UINT32       uiRmid,
+	_In_  UINT32       uiEvent,
+	_Out_ PUINT64      pValue
+);
+
+/// <summary>
+/// Assign a RMID to each workload, RMID 0 staying with the rest of the system, and take the first sample.
+/// </summary>
+/// <param name="pMonitor">Pointer to the monitor.</param>
+/// <param name="pMsr">Pointer to an opened MSR backend able to write.</param>
+/// <param name="pCapabilities">Pointer to the capabilities returned by RdtMonitorQuery.</param>
+/// <param name="pTopology">Optional topology. Workloads spanning several L3 caches are read on each of them.</param>
+/// <param name="pWorkloads">Array of workloads, owned by the caller.</param>
+/// <param name="uiCount">Number of workloads.</param>
+/// <returns>Whether every workload has been associated with its RMID.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL RdtMonitorStart(
+	_Out_    PRDT_MONITOR                    pMonitor,
+	_In_     PMSR_BACKEND                    pMsr,
+	_In_     const RDT_MONITOR_CAPABILITIES* pCapabilities,
+	_In_opt_ const TOPOLOGY*                 pTopology,
+	_Inout_updates_(uiCount) PRDT_WORKLOAD   pWorkloads,
+	_In_     UINT32                          uiCount
+);
+
+/// <summary>
+/// Read the counters of every workload and compute the occupancy and the bandwidth since the previous sample.
+/// </summary>
+/// <param name="pMonitor">Pointer to the monitor.</param>
+/// <returns>Whether all the counters have been read.</returns>
+BOOL RdtMonitorSample(
+	_Inout_ PRDT_MONITOR pMonitor
+);
+
+/// <summary>
+/// Give the processors of the workloads back to RMID 0.
+/// </summary>
+/// <param name="pMonitor">Pointer to the monitor.</param>
+VOID RdtMonitorStop(
+	_Inout_ PRDT_MONITOR pMonitor
+);
+
+/// <summary>
+/// Enumerate the allocation capabilities.
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pCapabilities">Pointer to the structure receiving the capabilities.</param>
+/// <returns>Whether cache or memory bandwidth allocation is supported.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL RdtAllocationQuery(
+	_In_  PCPUID_BACKEND               pBackend,
+	_Out_ PRDT_ALLOCATION_CAPABILITIES pCapabilities
+);
+
+/// <summary>
+/// Check that a capacity mask can be written: not empty, within the mask length, made of contiguous bits and
+/// at least as wide as the minimum width.
+/// </summary>
+/// <param name="pCache">Pointer to the capabilities of the cache.</param>
+/// <param name="Mask">Capacity mask.</param>
+/// <returns>Whether the mask is valid.</returns>
+BOOL RdtValidateMask(
+	_In_ const RDT_CACHE_CAPABILITIES* pCache,
+	_In_ UINT64                        Mask
+);
+
+/// <summary>
+/// Convert a percentage of the memory bandwidth into a throttling value.
+/// </summary>
+/// <param name="pCapabilities">Pointer to the allocation capabilities.</param>
+/// <param name="uiBandwidth">Percentage of the bandwidth, from 1 to 100.</param>
+/// <param name="puiDelay">Pointer receiving the throttling value.</param>
+/// <returns>Whether the percentage can be programmed.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL RdtGetDelay(
+	_In_  const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_  UINT32                             uiBandwidth,
+	_Out_ PUINT32                            puiDelay
+);
+
+/// <summary>
+/// Program the capacity mask of a class of service on the cache of a processor.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend able to write.</param>
+/// <param name="pCapabilities">Pointer to the allocation capabilities.</param>
+/// <param name="uiResource">RDT_RESOURCE_* value.</param>
+/// <param name="uiCpu">Index of a processor sharing the cache.</param>
+/// <param name="uiCos">Class of service.</param>
+/// <param name="Mask">Capacity mask, validated before being written.</param>
+/// <returns>Whether the mask is valid and has been written.</returns>
+_Success_(return != 0x00)
+BOOL RdtSetMask(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_ UINT32                             uiResource,
+	_In_ UINT32                             uiCpu,
+	_In_ UINT32                             uiCos,
+	_In_ UINT64                             Mask
+);
+
+/// <summary>
+/// Associate a processor with a class of service, keeping its RMID.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend able to write.</param>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="uiCos">Class of service.</param>
+/// <returns>Whether IA32_PQR_ASSOC has been written.</returns>
+_Success_(return != 0x00)
+BOOL RdtSetCos(
+	_In_ PMSR_BACKEND pMsr,
+	_In_ UINT32       uiCpu,
+	_In_ UINT32       uiCos
+);
+
+/// <summary>
+/// Apply a policy: tenants with dedicated ways get them from the bottom of the L3 cache, the other tenants and the rest of the
+/// system sharing the remaining ways in class of service 0, and tenants with a bandwidth get throttled. Every
+/// mask and throttling value is computed and validated before the first write.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend able to write.</param>
+/// <param name="pCapabilities">Pointer to the allocation capabilities.</param>
+/// <param name="pTenants">Array of tenants, receiving their class of service, mask and throttling value.</param>
+/// <param name="uiCount">Number of tenants.</param>
+/// <returns>Whether the policy is valid and has been applied.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL RdtAllocationApply(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_Inout_updates_(uiCount) PRDT_TENANT    pTenants,
+	_In_ UINT32                             uiCount
+);
+
+/// <summary>
+/// Give every class of service the whole caches and bandwidth back and associate processors with class of service 0.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend able to write.</param>
+/// <param name="pCapabilities">Pointer to the allocation capabilities.</param>
+/// <param name="uiCpuCount">Number of processors.</param>
+VOID RdtAllocationReset(
+	_In_ PMSR_BACKEND                       pMsr,
+	_In_ const RDT_ALLOCATION_CAPABILITIES* pCapabilities,
+	_In_ UINT32                             uiCpuCount
+);
+
+#endif // !__RDT_H_GUARD__
@@ -37,5 +37,17 @@ _read_gs PROC PUBLIC
 	ret
 _read_gs ENDP
 
+;; Access rights of the descriptor a selector points to, i.e. bytes 5 and 6 of the descriptor. ZF is clear
+;; when the descriptor is not visible from the current privilege level.
+_read_lar PROC PUBLIC
+	xor eax, eax
+	lar r8d, cx
+	jnz @F
+	mov dword ptr [rdx], r8d
+	inc eax
+@@:
+	ret
+_read_lar ENDP
+
 ;; End of file
 end
\ No newline at end of file
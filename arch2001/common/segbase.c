@@ -0,0 +1,123 @@
+/// @file    segbase.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <sys/auxv.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "segbase.h"
+#include "cpuid.h"
+#include "msr.h"
+
+#if !defined(_WIN32)
+/// Linux specific constants, from asm/prctl.h and asm/hwcap2.h
+#define ARCH_GET_FS       0x1003
+#define ARCH_GET_GS       0x1004
+#define HWCAP2_FSGSBASE   (1 << 1)
+#ifndef AT_HWCAP2
+#define AT_HWCAP2         26
+#endif
+#endif
+
+SEGBASE_SOURCE g_SegBaseSource[2] = { SegBaseSourceNone, SegBaseSourceNone };
+
+/// <summary>
+/// MSR backend used as the last resort.
+/// </summary>
+static MSR_BACKEND g_MsrBackend = { 0x00 };
+static BOOL g_Initialised = FALSE;
+
+/// <summary>
+/// Check whether the OS has set CR4.FSGSBASE, which cannot be read from user mode.
+/// </summary>
+/// <returns>Whether RDFSBASE/RDGSBASE can be executed.</returns>
+static BOOL SegBaseIsInstructionEnabled() {
+	// 1. The processor must support the instructions
+	if (!CpuidGetInformation()->ExtendedEbx.elem.FSGSBASE)
+		return FALSE;
+
+#if defined(_WIN32)
+	// 2. Execute the instructions once, #UD is raised if the OS did not enable them.
+	__try {
+		volatile UINT64 Base = _rdfsbase();
+		Base = _rdgsbase();
+	}
+	__except (GetExceptionCode() == EXCEPTION_ILLEGAL_INSTRUCTION ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+		return FALSE;
+	}
+	return TRUE;
+#else
+	// 2. The kernel advertises it once CR4.FSGSBASE is set (Linux 5.9 and later)
+	return (getauxval(AT_HWCAP2) & HWCAP2_FSGSBASE) != 0x00;
+#endif
+}
+
+SEGBASE_SOURCE SegBaseInitialise() {
+	if (g_Initialised)
+		return g_SegBaseSource[SEGBASE_GS];
+	g_Initialised = TRUE;
+
+	// 1. Instructions enabled by the OS.
+	if (SegBaseIsInstructionEnabled()) {
+		g_SegBaseSource[SEGBASE_FS] = SegBaseSourceInstruction;
+		g_SegBaseSource[SEGBASE_GS] = SegBaseSourceInstruction;
+		return g_SegBaseSource[SEGBASE_GS];
+	}
+
+#if defined(_WIN32)
+	// 2. GS points to the TEB which contains a pointer to itself. FS is only reachable via the driver.
+	g_SegBaseSource[SEGBASE_GS] = SegBaseSourceOs;
+	g_SegBaseSource[SEGBASE_FS] = MsrOpen(&g_MsrBackend) ? SegBaseSourceMsr : SegBaseSourceNone;
+#else
+	// 2. arch_prctl is always available in 64-bit mode.
+	g_SegBaseSource[SEGBASE_FS] = SegBaseSourceOs;
+	g_SegBaseSource[SEGBASE_GS] = SegBaseSourceOs;
+#endif
+	return g_SegBaseSource[SEGBASE_GS];
+}
+
+VOID SegBaseUninitialise() {
+	MsrClose(&g_MsrBackend);
+	g_SegBaseSource[SEGBASE_FS] = SegBaseSourceNone;
+	g_SegBaseSource[SEGBASE_GS] = SegBaseSourceNone;
+	g_Initialised = FALSE;
+}
+
+_Use_decl_annotations_
+BOOL SegBaseReadSlow(
+	_In_  UINT32  uiSegment,
+	_Out_ PUINT64 pBase
+) {
+	*pBase = 0x00;
+	if (uiSegment > SEGBASE_GS)
+		return FALSE;
+	if (!g_Initialised)
+		SegBaseInitialise();
+
+	switch (g_SegBaseSource[uiSegment]) {
+		case SegBaseSourceInstruction:
+			*pBase = uiSegment == SEGBASE_FS ? _rdfsbase() : _rdgsbase();
+			return TRUE;
+
+		case SegBaseSourceOs:
+#if defined(_WIN32)
+			*pBase = (UINT64)NtCurrentTeb();
+			return TRUE;
+#else
+			return syscall(SYS_arch_prctl, uiSegment == SEGBASE_FS ? ARCH_GET_FS : ARCH_GET_GS, pBase) == 0x00;
+#endif
+
+		case SegBaseSourceMsr:
+			// While in the kernel the user mode GS base has been swapped into IA32_KERNEL_GS_BASE.
+			return MsrRead(&g_MsrBackend, MSR_CURRENT_CPU, uiSegment == SEGBASE_FS ? IA32_FS_BASE : IA32_KERNEL_GS_BASE, pBase);
+
+		default:
+			return FALSE;
+	}
+}
@@ -0,0 +1,77 @@
+/// @file    segbase.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __SEGBASE_H_GUARD__
+#define __SEGBASE_H_GUARD__
+#include "ost.h"
+#include "intrinsics.h"
+
+/// Index of the segment registers having a base address in 64-bit mode
+#define SEGBASE_FS 0x00
+#define SEGBASE_GS 0x01
+
+/// <summary>
+/// Where the base address of a segment register is read from.
+/// </summary>
+typedef enum _SEGBASE_SOURCE {
+	SegBaseSourceNone        = 0x00, // Not initialised or no way to read it.
+	SegBaseSourceInstruction = 0x01, // RDFSBASE/RDGSBASE, enabled by the OS via CR4.FSGSBASE.
+	SegBaseSourceOs          = 0x02, // arch_prctl on Linux, TEB on Windows.
+	SegBaseSourceMsr         = 0x03  // MSR backend: IA32_FS_BASE or IA32_KERNEL_GS_BASE while in the kernel.
+} SEGBASE_SOURCE;
+
+/// <summary>
+/// Source selected for FS and GS. Set by SegBaseInitialise.
+/// </summary>
+EXTERN_C SEGBASE_SOURCE g_SegBaseSource[2];
+
+/// <summary>
+/// Select how the base addresses are read. Called implicitly by the first read.
+/// </summary>
+/// <returns>The source used for the GS base address.</returns>
+SEGBASE_SOURCE SegBaseInitialise();
+
+/// <summary>
+/// Release the MSR backend, if it has been opened.
+/// </summary>
+VOID SegBaseUninitialise();
+
+/// <summary>
+/// Read a base address via the source selected, when RDFSBASE/RDGSBASE cannot be used.
+/// </summary>
+/// <param name="uiSegment">Either SEGBASE_FS or SEGBASE_GS.</param>
+/// <param name="pBase">Pointer to the variable receiving the base address.</param>
+/// <returns>Whether the base address has been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SegBaseReadSlow(
+	_In_  UINT32  uiSegment,
+	_Out_ PUINT64 pBase
+);
+
+/// <summary>
+/// Get the base address of FS for the calling thread. A single instruction when FSGSBASE is enabled.
+/// </summary>
+/// <returns>The base address, 0 if it cannot be read.</returns>
+FORCEINLINE UINT64 SegBaseReadFs() {
+	UINT64 Base = 0x00;
+	if (g_SegBaseSource[SEGBASE_FS] == SegBaseSourceInstruction)
+		return _rdfsbase();
+	return SegBaseReadSlow(SEGBASE_FS, &Base) ? Base : 0x00;
+}
+
+/// <summary>
+/// Get the base address of GS for the calling thread, i.e. the TEB on Windows.
+/// </summary>
+/// <returns>The base address, 0 if it cannot be read.</returns>
+FORCEINLINE UINT64 SegBaseReadGs() {
+	UINT64 Base = 0x00;
+	if (g_SegBaseSource[SEGBASE_GS] == SegBaseSourceInstruction)
+		return _rdgsbase();
+	return SegBaseReadSlow(SEGBASE_GS, &Base) ? Base : 0x00;
+}
+
+#endif // !__SEGBASE_H_GUARD__
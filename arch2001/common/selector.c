@@ -0,0 +1,21 @@
+/// @file    selector.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "selector.h"
+#include "intrinsics.h"
+
+_Use_decl_annotations_
+VOID SelectorReadAll(
+	_Out_writes_(SELECTOR_COUNT) PUINT16 pSelectors
+) {
+	pSelectors[SELECTOR_CS] = _get_cs();
+	pSelectors[SELECTOR_SS] = _get_ss();
+	pSelectors[SELECTOR_DS] = _get_ds();
+	pSelectors[SELECTOR_ES] = _get_es();
+	pSelectors[SELECTOR_FS] = _get_fs();
+	pSelectors[SELECTOR_GS] = _get_gs();
+}
@@ -0,0 +1,29 @@
+/// @file    selector.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __SELECTOR_H_GUARD__
+#define __SELECTOR_H_GUARD__
+#include "ost.h"
+
+/// List of the different segment register types
+#define SELECTOR_CS    0x00
+#define SELECTOR_SS    0x01
+#define SELECTOR_DS    0x02
+#define SELECTOR_ES    0x03
+#define SELECTOR_FS    0x04
+#define SELECTOR_GS    0x05
+#define SELECTOR_COUNT 0x06
+
+/// <summary>
+/// Read the visible part of the six segment registers of the calling thread.
+/// </summary>
+/// <param name="pSelectors">Array receiving CS, SS, DS, ES, FS and GS in that order.</param>
+VOID SelectorReadAll(
+	_Out_writes_(SELECTOR_COUNT) PUINT16 pSelectors
+);
+
+#endif // !__SELECTOR_H_GUARD__
@@ -0,0 +1,478 @@
+/// @file    snapshot.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include "snapshot.h"
+#include "cpuid.h"
+#include "dtr.h"
+#include "thread.h"
+
+/// <summary>
+/// Leaves captured by version 1 of the record.
+/// </summary>
+static const UINT32 g_SnapshotLeaves[SNAPSHOT_CPUID_LEAVES][2] = {
+	{ 0x00000000, 0x00 }, // Maximum leaf and vendor
+	{ 0x00000001, 0x00 }, // Basic information
+	{ 0x00000007, 0x00 }, // Structured extended features
+	{ 0x00000007, 0x01 },
+	{ 0x0000000D, 0x00 }, // XSAVE features
+	{ 0x0000000D, 0x01 },
+	{ 0x80000000, 0x00 }, // Maximum extended leaf
+	{ 0x80000001, 0x00 }, // Extended information
+	{ 0x80000007, 0x00 }, // Advanced power management
+	{ 0x80000008, 0x00 }  // Address sizes
+};
+
+/// <summary>
+/// Names of the fields written by SnapshotWrite. The CPUID fields are prefixed with the position of the leaf.
+/// </summary>
+static LPCSTR g_SnapshotSelectorNames[SELECTOR_COUNT] = { "cs", "ss", "ds", "es", "fs", "gs" };
+static LPCSTR g_SnapshotCpuidNames[6] = { "leaf", "subleaf", "eax", "ebx", "ecx", "edx" };
+C_ASSERT(SNAPSHOT_CPUID_LEAVES <= 10);
+
+/// <summary>
+/// Get the wall clock time.
+/// </summary>
+/// <returns>Nanoseconds since the Unix epoch.</returns>
+static UINT64 SnapshotGetTime() {
+#if defined(_WIN32)
+	FILETIME Time = { 0x00 };
+	GetSystemTimePreciseAsFileTime(&Time);
+	UINT64 Ticks = ((UINT64)Time.dwHighDateTime << 32) | Time.dwLowDateTime;
+	return (Ticks - 116444736000000000ULL) * 100;
+#else
+	struct timespec Time = { 0x00 };
+	clock_gettime(CLOCK_REALTIME, &Time);
+	return (UINT64)Time.tv_sec * 1000000000ULL + (UINT64)Time.tv_nsec;
+#endif
+}
+
+/// <summary>
+/// Check the header of an existing snapshot file.
+/// </summary>
+static BOOL SnapshotCheckHeader(
+	_In_ const SNAPSHOT_FILE_HEADER* pHeader
+) {
+	return pHeader->Magic == SNAPSHOT_FILE_MAGIC
+		&& pHeader->HeaderSize >= sizeof(SNAPSHOT_FILE_HEADER)
+		&& pHeader->RecordSize >= sizeof(SNAPSHOT_RECORD);
+}
+
+/// <summary>
+/// Fill the header of a new snapshot file.
+/// </summary>
+static VOID SnapshotInitialiseHeader(
+	_Out_ PSNAPSHOT_FILE_HEADER pHeader
+) {
+	RtlZeroMemory(pHeader, sizeof(SNAPSHOT_FILE_HEADER));
+	pHeader->Magic = SNAPSHOT_FILE_MAGIC;
+	pHeader->Version = SNAPSHOT_VERSION;
+	pHeader->HeaderSize = sizeof(SNAPSHOT_FILE_HEADER);
+	pHeader->RecordSize = sizeof(SNAPSHOT_RECORD);
+	pHeader->Created = SnapshotGetTime();
+}
+
+/// <summary>
+/// Read the MSRs of the current processor into a record, by group.
+/// </summary>
+static VOID SnapshotReadMsrs(
+	_In_    PSNAPSHOT_CONTEXT pContext,
+	_Inout_ PSNAPSHOT_RECORD  pRecord
+) {
+	pRecord->Valid &= ~SNAPSHOT_VALID_MSRS;
+	if (!pContext->bMsr)
+		return;
+
+	PMSR_BACKEND Msr = &pContext->Msr;
+	if (MsrRead(Msr, MSR_CURRENT_CPU, IA32_EFER, &pRecord->Efer))
+		pRecord->Valid |= SNAPSHOT_VALID_EFER;
+	if (MsrRead(Msr, MSR_CURRENT_CPU, IA32_STAR, &pRecord->Star)
+		&& MsrRead(Msr, MSR_CURRENT_CPU, IA32_LSTAR, &pRecord->Lstar)
+		&& MsrRead(Msr, MSR_CURRENT_CPU, IA32_CSTAR, &pRecord->Cstar)
+		&& MsrRead(Msr, MSR_CURRENT_CPU, IA32_FMASK, &pRecord->Fmask))
+		pRecord->Valid |= SNAPSHOT_VALID_SYSCALL;
+	if (MsrRead(Msr, MSR_CURRENT_CPU, IA32_FS_BASE, &pRecord->FsBase)
+		&& MsrRead(Msr, MSR_CURRENT_CPU, IA32_GS_BASE, &pRecord->GsBase)
+		&& MsrRead(Msr, MSR_CURRENT_CPU, IA32_KERNEL_GS_BASE, &pRecord->KernelGsBase))
+		pRecord->Valid |= SNAPSHOT_VALID_SEGBASE;
+	if (MsrRead(Msr, MSR_CURRENT_CPU, IA32_TSC_AUX, &pRecord->TscAux))
+		pRecord->Valid |= SNAPSHOT_VALID_TSC_AUX;
+}
+
+_Use_decl_annotations_
+VOID SnapshotOpen(
+	_Out_ PSNAPSHOT_CONTEXT pContext
+) {
+	RtlZeroMemory(pContext, sizeof(SNAPSHOT_CONTEXT));
+
+	// 1. Open the sources kept for the lifetime of the context
+	pContext->bMsr = MsrOpen(&pContext->Msr);
+	pContext->bCtlreg = CtlregOpen(&pContext->Ctlreg, pContext->bMsr ? &pContext->Msr : NULL);
+	(VOID)CpuidGetInformation();
+	(VOID)DtrInitialise();
+
+	// 2. Get the name of the host
+#if defined(_WIN32)
+	DWORD dwSize = sizeof(pContext->HostName);
+	if (!GetComputerNameA(pContext->HostName, &dwSize))
+		pContext->HostName[0] = '\0';
+#else
+	if (gethostname(pContext->HostName, sizeof(pContext->HostName) - 1) != 0x00)
+		pContext->HostName[0] = '\0';
+#endif
+}
+
+_Use_decl_annotations_
+VOID SnapshotClose(
+	_Inout_ PSNAPSHOT_CONTEXT pContext
+) {
+	if (pContext->bCtlreg)
+		CtlregClose(&pContext->Ctlreg);
+	pContext->bCtlreg = FALSE;
+	if (pContext->bMsr)
+		MsrClose(&pContext->Msr);
+	pContext->bMsr = FALSE;
+	DtrUninitialise();
+}
+
+_Use_decl_annotations_
+BOOL SnapshotCapture(
+	_In_  PSNAPSHOT_CONTEXT pContext,
+	_In_  UINT32            uiCpu,
+	_Out_ PSNAPSHOT_RECORD  pRecord
+) {
+	RtlZeroMemory(pRecord, sizeof(SNAPSHOT_RECORD));
+
+	// 1. Run on the processor to capture. The current processor is pinned as well, otherwise the thread could
+	//    migrate between two registers and mix the state of two processors in the record.
+	if (uiCpu == MSR_CURRENT_CPU)
+		uiCpu = ThreadGetCurrentCpu();
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (!ThreadPin(uiCpu, &Previous))
+		return FALSE;
+
+	pRecord->Magic = SNAPSHOT_RECORD_MAGIC;
+	pRecord->Version = SNAPSHOT_VERSION;
+	pRecord->Size = sizeof(SNAPSHOT_RECORD);
+	pRecord->Timestamp = SnapshotGetTime();
+	pRecord->Cpu = uiCpu;
+	RtlCopyMemory(pRecord->HostName, pContext->HostName, sizeof(pRecord->HostName));
+
+	// 2. Segment and descriptor table registers
+	SelectorReadAll(pRecord->Selectors);
+	pRecord->Valid |= SNAPSHOT_VALID_SELECTORS;
+
+	DTR_INFORMATION Dtr = { 0x00 };
+	if (DtrRead(&Dtr)) {
+		pRecord->GdtBase = Dtr.Gdtr.Base;
+		pRecord->GdtLimit = Dtr.Gdtr.Limit;
+		pRecord->IdtBase = Dtr.Idtr.Base;
+		pRecord->IdtLimit = Dtr.Idtr.Limit;
+		pRecord->Ldtr = Dtr.Ldtr;
+		pRecord->Tr = Dtr.Tr;
+		pRecord->Valid |= SNAPSHOT_VALID_DTR;
+		if (Dtr.Source == DtrSourceEmulated)
+			pRecord->Valid |= SNAPSHOT_VALID_DTR_EMULATED;
+	}
+
+	// 3. MSRs and control registers, the latter only from the driver
+	SnapshotReadMsrs(pContext, pRecord);
+
+	CTLREG_STATE Control = { 0x00 };
+	UINT32 uiCaptured = 0x00;
+	if (pContext->bCtlreg
+		&& CtlregCapture(&pContext->Ctlreg, CTLREG_CURRENT_CPU, &Control, 0x01, &uiCaptured)
+		&& (Control.Valid & CTLREG_VALID_CR)) {
+		pRecord->Cr0 = Control.Cr0;
+		pRecord->Cr3 = Control.Cr3;
+		pRecord->Cr4 = Control.Cr4;
+		pRecord->Valid |= SNAPSHOT_VALID_CR;
+	}
+
+	// 4. CPUID leaves, left to zero when above the maximum leaf
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	if (Cpuid->Supported) {
+		for (UINT32 Index = 0x00; Index < SNAPSHOT_CPUID_LEAVES; Index++) {
+			PSNAPSHOT_CPUID_LEAF Leaf = &pRecord->Cpuid[Index];
+			Leaf->Leaf = g_SnapshotLeaves[Index][0];
+			Leaf->SubLeaf = g_SnapshotLeaves[Index][1];
+
+			UINT Maximum = Leaf->Leaf >= 0x80000000 ? Cpuid->MaximumExtendedLeaf : Cpuid->MaximumLeaf;
+			UINT Registers[4] = { 0x00 };
+			if (Leaf->Leaf <= Maximum && CpuidQuery(Leaf->Leaf, Leaf->SubLeaf, Registers)) {
+				Leaf->Eax = Registers[0];
+				Leaf->Ebx = Registers[1];
+				Leaf->Ecx = Registers[2];
+				Leaf->Edx = Registers[3];
+			}
+		}
+		pRecord->Valid |= SNAPSHOT_VALID_CPUID;
+	}
+
+	// 5. Restore the affinity of the thread
+	ThreadRestore(&Previous);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL SnapshotRefresh(
+	_In_    PSNAPSHOT_CONTEXT pContext,
+	_Inout_ PSNAPSHOT_RECORD  pRecord
+) {
+	// 1. Run on the processor of the record
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (!ThreadPin(pRecord->Cpu, &Previous))
+		return FALSE;
+
+	// 2. Read the MSRs again
+	pRecord->Timestamp = SnapshotGetTime();
+	SnapshotReadMsrs(pContext, pRecord);
+
+	ThreadRestore(&Previous);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL SnapshotWrite(
+	_Inout_ POUTPUT                pOutput,
+	_In_    const SNAPSHOT_RECORD* pRecord
+) {
+	// 1. Identification and segments
+	OutputBegin(pOutput, "snapshot");
+	OutputString(pOutput, "host", pRecord->HostName, sizeof(pRecord->HostName));
+	OutputUnsigned(pOutput, "cpu", pRecord->Cpu);
+	OutputUnsigned(pOutput, "timestamp", pRecord->Timestamp);
+	OutputHex(pOutput, "valid", pRecord->Valid, 8);
+	for (UINT32 Index = 0x00; Index < SELECTOR_COUNT; Index++)
+		OutputHex(pOutput, g_SnapshotSelectorNames[Index], pRecord->Selectors[Index], 2);
+	OutputHex(pOutput, "gdt_base", pRecord->GdtBase, 16);
+	OutputHex(pOutput, "gdt_limit", pRecord->GdtLimit, 4);
+	OutputHex(pOutput, "idt_base", pRecord->IdtBase, 16);
+	OutputHex(pOutput, "idt_limit", pRecord->IdtLimit, 4);
+	OutputHex(pOutput, "ldtr", pRecord->Ldtr, 2);
+	OutputHex(pOutput, "tr", pRecord->Tr, 2);
+
+	// 2. Control registers and MSRs
+	OutputHex(pOutput, "cr0", pRecord->Cr0, 16);
+	OutputHex(pOutput, "cr3", pRecord->Cr3, 16);
+	OutputHex(pOutput, "cr4", pRecord->Cr4, 16);
+	OutputHex(pOutput, "efer", pRecord->Efer, 16);
+	OutputHex(pOutput, "star", pRecord->Star, 16);
+	OutputHex(pOutput, "lstar", pRecord->Lstar, 16);
+	OutputHex(pOutput, "cstar", pRecord->Cstar, 16);
+	OutputHex(pOutput, "fmask", pRecord->Fmask, 16);
+	OutputHex(pOutput, "fs_base", pRecord->FsBase, 16);
+	OutputHex(pOutput, "gs_base", pRecord->GsBase, 16);
+	OutputHex(pOutput, "kernel_gs_base", pRecord->KernelGsBase, 16);
+	OutputHex(pOutput, "tsc_aux", pRecord->TscAux, 16);
+
+	// 3. CPUID leaves, named after their position, e.g. cpuid3_ebx, so that the columns never change
+	for (UINT32 Leaf = 0x00; Leaf < SNAPSHOT_CPUID_LEAVES; Leaf++) {
+		const SNAPSHOT_CPUID_LEAF* pLeaf = &pRecord->Cpuid[Leaf];
+		UINT32 Values[6] = { pLeaf->Leaf, pLeaf->SubLeaf, pLeaf->Eax, pLeaf->Ebx, pLeaf->Ecx, pLeaf->Edx };
+		for (UINT32 Field = 0x00; Field < (UINT32)ARRAYSIZE(Values); Field++) {
+			CHAR szName[0x10] = "cpuid0_";
+			szName[5] = (CHAR)('0' + Leaf);
+			memcpy(&szName[7], g_SnapshotCpuidNames[Field], strlen(g_SnapshotCpuidNames[Field]) + 1);
+			OutputHex(pOutput, szName, Values[Field], 8);
+		}
+	}
+	return OutputEnd(pOutput);
+}
+
+/// <summary>
+/// Create a snapshot file with its header, unless it already exists. The header is written aside and the file
+/// linked into place, so that readers and a crash never leave a file without its header.
+/// </summary>
+static BOOL SnapshotFileCreate(
+	_In_ LPCSTR                      szPath,
+	_In_ const SNAPSHOT_FILE_HEADER* pHeader
+) {
+	CHAR szTemporary[MAX_PATH + 16] = { 0x00 };
+#if defined(_WIN32)
+	snprintf(szTemporary, sizeof(szTemporary), "%s.%lu", szPath, GetCurrentProcessId());
+
+	// 1. Write the header aside
+	HANDLE hFile = CreateFileA(szTemporary, GENERIC_WRITE, 0x00, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+	DWORD dwWritten = 0x00;
+	BOOL bSuccess = WriteFile(hFile, pHeader, sizeof(SNAPSHOT_FILE_HEADER), &dwWritten, NULL) && dwWritten == sizeof(SNAPSHOT_FILE_HEADER);
+	CloseHandle(hFile);
+
+	// 2. Move it into place, unless another writer created the file first
+	if (bSuccess && !MoveFileExA(szTemporary, szPath, 0x00)) {
+		DWORD dwError = GetLastError();
+		bSuccess = dwError == ERROR_ALREADY_EXISTS || dwError == ERROR_FILE_EXISTS;
+	}
+	DeleteFileA(szTemporary);
+	return bSuccess;
+#else
+	snprintf(szTemporary, sizeof(szTemporary), "%s.XXXXXX", szPath);
+
+	// 1. Write the header aside
+	INT fd = mkstemp(szTemporary);
+	if (fd < 0x00)
+		return FALSE;
+	BOOL bSuccess = fchmod(fd, 0644) == 0x00
+		&& write(fd, pHeader, sizeof(SNAPSHOT_FILE_HEADER)) == sizeof(SNAPSHOT_FILE_HEADER);
+	bSuccess = close(fd) == 0x00 && bSuccess;
+
+	// 2. Link it into place, unless another writer created the file first
+	if (bSuccess && link(szTemporary, szPath) != 0x00)
+		bSuccess = errno == EEXIST;
+	unlink(szTemporary);
+	return bSuccess;
+#endif
+}
+
+_Use_decl_annotations_
+BOOL SnapshotFileOpen(
+	_In_  LPCSTR         szPath,
+	_Out_ PSNAPSHOT_FILE pFile
+) {
+	SNAPSHOT_FILE_HEADER Header = { 0x00 };
+	SnapshotInitialiseHeader(&Header);
+
+	// 1. Create the file with its header, unless it already exists
+	pFile->hFile = INVALID_HANDLE_VALUE;
+	if (!SnapshotFileCreate(szPath, &Header))
+		return FALSE;
+
+#if defined(_WIN32)
+	// 2. Open it for appending and check its header. Without FILE_WRITE_DATA, every write goes to the end of
+	// the file.
+	pFile->hFile = CreateFileA(szPath, FILE_GENERIC_READ | FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (pFile->hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	DWORD dwRead = 0x00;
+	if (!ReadFile(pFile->hFile, &Header, sizeof(Header), &dwRead, NULL) || dwRead != sizeof(Header)
+		|| !SnapshotCheckHeader(&Header) || Header.RecordSize != sizeof(SNAPSHOT_RECORD)) {
+		CloseHandle(pFile->hFile);
+		pFile->hFile = INVALID_HANDLE_VALUE;
+		return FALSE;
+	}
+#else
+	// 2. Open it for appending and check its header
+	pFile->hFile = open(szPath, O_RDWR | O_APPEND | O_CLOEXEC);
+	if (pFile->hFile < 0x00)
+		return FALSE;
+
+	if (pread(pFile->hFile, &Header, sizeof(Header), 0x00) != sizeof(Header)
+		|| !SnapshotCheckHeader(&Header) || Header.RecordSize != sizeof(SNAPSHOT_RECORD)) {
+		close(pFile->hFile);
+		pFile->hFile = INVALID_HANDLE_VALUE;
+		return FALSE;
+	}
+#endif
+	return TRUE;
+}
+
+_Use_decl_annotations_
+BOOL SnapshotFileAppend(
+	_In_ PSNAPSHOT_FILE          pFile,
+	_In_reads_(uiCount) const SNAPSHOT_RECORD* pRecords,
+	_In_ UINT32                  uiCount
+) {
+	SIZE_T Size = (SIZE_T)uiCount * sizeof(SNAPSHOT_RECORD);
+#if defined(_WIN32)
+	DWORD dwWritten = 0x00;
+	return WriteFile(pFile->hFile, pRecords, (DWORD)Size, &dwWritten, NULL) && dwWritten == Size;
+#else
+	return write(pFile->hFile, pRecords, Size) == (ssize_t)Size;
+#endif
+}
+
+_Use_decl_annotations_
+VOID SnapshotFileClose(
+	_Inout_ PSNAPSHOT_FILE pFile
+) {
+	if (pFile->hFile == INVALID_HANDLE_VALUE)
+		return;
+#if defined(_WIN32)
+	CloseHandle(pFile->hFile);
+#else
+	close(pFile->hFile);
+#endif
+	pFile->hFile = INVALID_HANDLE_VALUE;
+}
+
+_Use_decl_annotations_
+BOOL SnapshotViewOpen(
+	_In_  LPCSTR         szPath,
+	_Out_ PSNAPSHOT_VIEW pView
+) {
+	RtlZeroMemory(pView, sizeof(SNAPSHOT_VIEW));
+
+	// 1. Map the whole file
+#if defined(_WIN32)
+	LARGE_INTEGER Size = { 0x00 };
+	pView->hFile = CreateFileA(szPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (pView->hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+	if (!GetFileSizeEx(pView->hFile, &Size) || (UINT64)Size.QuadPart < sizeof(SNAPSHOT_FILE_HEADER)) {
+		SnapshotViewClose(pView);
+		return FALSE;
+	}
+	pView->Size = (SIZE_T)Size.QuadPart;
+	pView->hMapping = CreateFileMappingA(pView->hFile, NULL, PAGE_READONLY, 0x00, 0x00, NULL);
+	if (pView->hMapping != NULL)
+		pView->Header = (const SNAPSHOT_FILE_HEADER*)MapViewOfFile(pView->hMapping, FILE_MAP_READ, 0x00, 0x00, pView->Size);
+#else
+	struct stat Stat = { 0x00 };
+	INT fd = open(szPath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0x00)
+		return FALSE;
+	if (fstat(fd, &Stat) == 0x00 && (UINT64)Stat.st_size >= sizeof(SNAPSHOT_FILE_HEADER)) {
+		pView->Size = (SIZE_T)Stat.st_size;
+		PVOID Base = mmap(NULL, pView->Size, PROT_READ, MAP_SHARED, fd, 0x00);
+		pView->Header = Base == MAP_FAILED ? NULL : (const SNAPSHOT_FILE_HEADER*)Base;
+	}
+	close(fd);
+#endif
+	if (pView->Header == NULL) {
+		SnapshotViewClose(pView);
+		return FALSE;
+	}
+
+	// 2. Check the header and count the complete records
+	if (!SnapshotCheckHeader(pView->Header) || pView->Header->HeaderSize > pView->Size) {
+		SnapshotViewClose(pView);
+		return FALSE;
+	}
+	pView->Count = (pView->Size - pView->Header->HeaderSize) / pView->Header->RecordSize;
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID SnapshotViewClose(
+	_Inout_ PSNAPSHOT_VIEW pView
+) {
+#if defined(_WIN32)
+	if (pView->Header != NULL)
+		UnmapViewOfFile(pView->Header);
+	if (pView->hMapping != NULL)
+		CloseHandle(pView->hMapping);
+	if (pView->hFile != NULL && pView->hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(pView->hFile);
+#else
+	if (pView->Header != NULL)
+		munmap((PVOID)pView->Header, pView->Size);
+#endif
+	RtlZeroMemory(pView, sizeof(SNAPSHOT_VIEW));
+}
@@ -0,0 +1,259 @@
+/// @file    snapshot.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __SNAPSHOT_H_GUARD__
+#define __SNAPSHOT_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+#include "ctlreg.h"
+#include "output.h"
+#include "selector.h"
+
+/// Identification of the file and of the records. All the values are stored little-endian.
+#define SNAPSHOT_FILE_MAGIC   0x50414E53 // "SNAP"
+#define SNAPSHOT_RECORD_MAGIC 0x43455253 // "SREC"
+#define SNAPSHOT_VERSION      0x0001
+
+/// Number of CPUID leaves captured by version 1 of the record
+#define SNAPSHOT_CPUID_LEAVES 10
+
+/// Bits of SNAPSHOT_RECORD.Valid, set for each group of fields that has been captured
+#define SNAPSHOT_VALID_SELECTORS    0x00000001
+#define SNAPSHOT_VALID_DTR          0x00000002 // GDTR, IDTR, LDTR and TR.
+#define SNAPSHOT_VALID_DTR_EMULATED 0x00000004 // GDTR and IDTR are dummy values returned by the UMIP emulation.
+#define SNAPSHOT_VALID_CR           0x00000008 // CR0, CR3 and CR4. Requires the \\.\KSeg driver.
+#define SNAPSHOT_VALID_EFER         0x00000010
+#define SNAPSHOT_VALID_SYSCALL      0x00000020 // IA32_STAR, IA32_LSTAR, IA32_CSTAR and IA32_FMASK.
+#define SNAPSHOT_VALID_SEGBASE      0x00000040 // IA32_FS_BASE, IA32_GS_BASE and IA32_KERNEL_GS_BASE.
+#define SNAPSHOT_VALID_TSC_AUX      0x00000080
+#define SNAPSHOT_VALID_CPUID        0x00000100
+
+/// Groups read from the MSR backend, refreshed by SnapshotRefresh
+#define SNAPSHOT_VALID_MSRS (SNAPSHOT_VALID_EFER | SNAPSHOT_VALID_SYSCALL | SNAPSHOT_VALID_SEGBASE | SNAPSHOT_VALID_TSC_AUX)
+
+/// <summary>
+/// Header at the beginning of a snapshot file, followed by records of RecordSize bytes each.
+/// </summary>
+typedef struct _SNAPSHOT_FILE_HEADER {
+	UINT32 Magic;      // SNAPSHOT_FILE_MAGIC
+	UINT16 Version;    // Version of the writer that created the file.
+	UINT16 HeaderSize; // Offset of the first record.
+	UINT32 RecordSize; // Distance between two records, at least the size of a version 1 record.
+	UINT32 Reserved;
+	UINT64 Created;    // Nanoseconds since the Unix epoch.
+} SNAPSHOT_FILE_HEADER, * PSNAPSHOT_FILE_HEADER;
+
+/// <summary>
+/// Raw output of CPUID for a leaf and sub-leaf.
+/// </summary>
+typedef struct _SNAPSHOT_CPUID_LEAF {
+	UINT32 Leaf;
+	UINT32 SubLeaf;
+	UINT32 Eax;
+	UINT32 Ebx;
+	UINT32 Ecx;
+	UINT32 Edx;
+} SNAPSHOT_CPUID_LEAF, * PSNAPSHOT_CPUID_LEAF;
+
+/// <summary>
+/// Architectural state of one processor. The layout is fixed: fields are only ever appended by new
+/// versions, so a reader can use any record whose Size covers the fields it knows about.
+/// </summary>
+typedef struct _SNAPSHOT_RECORD {
+	UINT32              Magic;                            // SNAPSHOT_RECORD_MAGIC
+	UINT16              Version;                          // SNAPSHOT_VERSION of the writer.
+	UINT16              Size;                             // Number of bytes written by the writer.
+	UINT64              Timestamp;                        // Nanoseconds since the Unix epoch.
+	UINT32              Cpu;                              // Index of the processor.
+	UINT32              Valid;                            // SNAPSHOT_VALID_* bits.
+	UINT16              Selectors[SELECTOR_COUNT];        // CS, SS, DS, ES, FS and GS.
+	UINT16              Ldtr;
+	UINT16              Tr;
+	UINT16              GdtLimit;
+	UINT16              IdtLimit;
+	UINT32              Reserved;
+	UINT64              GdtBase;
+	UINT64              IdtBase;
+	UINT64              Cr0;
+	UINT64              Cr3;
+	UINT64              Cr4;
+	UINT64              Efer;
+	UINT64              Star;
+	UINT64              Lstar;
+	UINT64              Cstar;
+	UINT64              Fmask;
+	UINT64              FsBase;
+	UINT64              GsBase;
+	UINT64              KernelGsBase;
+	UINT64              TscAux;
+	SNAPSHOT_CPUID_LEAF Cpuid[SNAPSHOT_CPUID_LEAVES];
+	CHAR                HostName[64];
+} SNAPSHOT_RECORD, * PSNAPSHOT_RECORD;
+
+/// The layout is part of the file format
+C_ASSERT(sizeof(SNAPSHOT_FILE_HEADER) == 24);
+C_ASSERT(sizeof(SNAPSHOT_RECORD) == 464);
+C_ASSERT(offsetof(SNAPSHOT_RECORD, GdtBase) == 48);
+C_ASSERT(offsetof(SNAPSHOT_RECORD, Cpuid) == 160);
+
+/// <summary>
+/// Resources kept open between two captures.
+/// </summary>
+typedef struct _SNAPSHOT_CONTEXT {
+	BOOL          bMsr;
+	MSR_BACKEND   Msr;
+	BOOL          bCtlreg;
+	CTLREG_SOURCE Ctlreg;    // Uses Msr, the context must not be moved once opened.
+	CHAR          HostName[64];
+} SNAPSHOT_CONTEXT, * PSNAPSHOT_CONTEXT;
+
+/// <summary>
+/// Snapshot file opened for appending.
+/// </summary>
+typedef struct _SNAPSHOT_FILE {
+	HANDLE hFile;
+} SNAPSHOT_FILE, * PSNAPSHOT_FILE;
+
+/// <summary>
+/// Snapshot file mapped in memory for reading.
+/// </summary>
+typedef struct _SNAPSHOT_VIEW {
+	const SNAPSHOT_FILE_HEADER* Header;
+	SIZE_T                      Size;
+	UINT64                      Count;
+#if defined(_WIN32)
+	HANDLE                      hFile;
+	HANDLE                      hMapping;
+#endif
+} SNAPSHOT_VIEW, * PSNAPSHOT_VIEW;
+
+/// <summary>
+/// Open the sources used by SnapshotCapture. Sources that are not available only leave their fields
+/// invalid in the records.
+/// </summary>
+/// <param name="pContext">Pointer to the context to initialise.</param>
+VOID SnapshotOpen(
+	_Out_ PSNAPSHOT_CONTEXT pContext
+);
+
+/// <summary>
+/// Release the sources opened by SnapshotOpen.
+/// </summary>
+/// <param name="pContext">Pointer to the context.</param>
+VOID SnapshotClose(
+	_Inout_ PSNAPSHOT_CONTEXT pContext
+);
+
+/// <summary>
+/// Capture the state of a processor. The calling thread is pinned to it for the duration of the call.
+/// </summary>
+/// <param name="pContext">Pointer to the context.</param>
+/// <param name="uiCpu">Index of the processor, or MSR_CURRENT_CPU.</param>
+/// <param name="pRecord">Pointer to the record receiving the state.</param>
+/// <returns>Whether the thread could run on the processor.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SnapshotCapture(
+	_In_  PSNAPSHOT_CONTEXT pContext,
+	_In_  UINT32            uiCpu,
+	_Out_ PSNAPSHOT_RECORD  pRecord
+);
+
+/// <summary>
+/// Read again the fields that change while the system runs, i.e. the MSRs, of a record returned by
+/// SnapshotCapture. The CPUID leaves and descriptor tables are left as they are.
+/// </summary>
+/// <param name="pContext">Pointer to the context.</param>
+/// <param name="pRecord">Pointer to the record to refresh.</param>
+/// <returns>Whether the thread could run on the processor of the record.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SnapshotRefresh(
+	_In_    PSNAPSHOT_CONTEXT pContext,
+	_Inout_ PSNAPSHOT_RECORD  pRecord
+);
+
+/// <summary>
+/// Write a record as a "snapshot" record of an output. Every field is written whatever its validity, so
+/// that all the records have the same columns.
+/// </summary>
+/// <param name="pOutput">Pointer to the output.</param>
+/// <param name="pRecord">Pointer to the record.</param>
+/// <returns>Whether the record has been written.</returns>
+BOOL SnapshotWrite(
+	_Inout_ POUTPUT                pOutput,
+	_In_    const SNAPSHOT_RECORD* pRecord
+);
+
+/// <summary>
+/// Open a snapshot file for appending, creating it with its header if needed.
+/// </summary>
+/// <param name="szPath">Path of the file.</param>
+/// <param name="pFile">Pointer to the structure receiving the file.</param>
+/// <returns>Whether the file has been opened and has a compatible header.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SnapshotFileOpen(
+	_In_  LPCSTR         szPath,
+	_Out_ PSNAPSHOT_FILE pFile
+);
+
+/// <summary>
+/// Append records at the end of the file with a single write, so that processes appending to the same
+/// file never interleave their records.
+/// </summary>
+/// <param name="pFile">Pointer to the file.</param>
+/// <param name="pRecords">Array of records.</param>
+/// <param name="uiCount">Number of records.</param>
+/// <returns>Whether all the records have been written.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SnapshotFileAppend(
+	_In_ PSNAPSHOT_FILE          pFile,
+	_In_reads_(uiCount) const SNAPSHOT_RECORD* pRecords,
+	_In_ UINT32                  uiCount
+);
+
+/// <summary>
+/// Close a snapshot file.
+/// </summary>
+/// <param name="pFile">Pointer to the file.</param>
+VOID SnapshotFileClose(
+	_Inout_ PSNAPSHOT_FILE pFile
+);
+
+/// <summary>
+/// Map a snapshot file read-only. Records are then accessed in place with SnapshotViewAt, without any
+/// parsing or allocation. A truncated record at the end of the file is ignored.
+/// </summary>
+/// <param name="szPath">Path of the file.</param>
+/// <param name="pView">Pointer to the structure receiving the view.</param>
+/// <returns>Whether the file has been mapped and has a compatible header.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SnapshotViewOpen(
+	_In_  LPCSTR         szPath,
+	_Out_ PSNAPSHOT_VIEW pView
+);
+
+/// <summary>
+/// Unmap a snapshot file.
+/// </summary>
+/// <param name="pView">Pointer to the view.</param>
+VOID SnapshotViewClose(
+	_Inout_ PSNAPSHOT_VIEW pView
+);
+
+/// <summary>
+/// Get a record of a mapped snapshot file.
+/// </summary>
+/// <param name="pView">Pointer to the view.</param>
+/// <param name="Index">Index of the record, lower than pView->Count.</param>
+/// <returns>Pointer to the record within the mapping.</returns>
+FORCEINLINE const SNAPSHOT_RECORD* SnapshotViewAt(
+	_In_ PSNAPSHOT_VIEW pView,
+	_In_ UINT64         Index
+) {
+	return (const SNAPSHOT_RECORD*)((const UINT8*)pView->Header + pView->Header->HeaderSize + Index * pView->Header->RecordSize);
+}
+
+#endif // !__SNAPSHOT_H_GUARD__
@@ -0,0 +1,331 @@
+/// @file    sysentry.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include "sysentry.h"
+#include "intrinsics.h"
+#include "thread.h"
+
+#if defined(_WIN32)
+/// General information about the driver
+#define KSEG_DEVICE_TYPE 0x8000
+#define KSEG_DEVICE_PATH L"\\\\.\\KSeg"
+
+/// List of IOCTL exposed by this driver
+#define IOCTL_KSEG_QUERY_DESCRIPTOR CTL_CODE(KSEG_DEVICE_TYPE, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/// <summary>
+/// Data returned by the descriptor query, i.e. the selector and the 16 bytes from its offset in the GDT.
+/// </summary>
+typedef struct _KSEG_DESCRIPTOR_OUT {
+	UINT16 Selector;
+	UINT64 DataLow;
+	UINT64 DataHigh;
+} KSEG_DESCRIPTOR_OUT, * PKSEG_DESCRIPTOR_OUT;
+#endif
+
+/// Bits of the descriptors returned by LAR
+#define SYSENTRY_ACCESS_MASK 0x00F0FF00
+
+/// Round trips executed before measuring, to warm the caches and the predictors
+#define SYSENTRY_WARMUP 1000
+
+/// Names of the RFLAGS bits, NULL for the reserved ones
+static const LPCSTR g_SysEntryFlags[22] = {
+	"CF", NULL, "PF", NULL, "AF", NULL, "ZF", "SF", "TF", "IF", "DF", "OF",
+	"IOPL0", "IOPL1", "NT", NULL, "RF", "VM", "AC", "VIF", "VIP", "ID"
+};
+
+/// Names of the selectors of IA32_STAR
+static const LPCSTR g_SysEntrySelectors[SYSENTRY_SELECTOR_COUNT] = {
+	"kernel CS", "kernel SS", "user CS (32-bit)", "user SS", "user CS (64-bit)"
+};
+
+/// <summary>
+/// Execute a system call which does nothing but enter and leave the kernel.
+/// </summary>
+static VOID SysEntryNullCall() {
+#if defined(_WIN32)
+	(VOID)WaitForSingleObject(GetCurrentProcess(), 0x00);
+#else
+	(VOID)syscall(SYS_getppid);
+#endif
+}
+
+/// <summary>
+/// Set the selector and the attributes its descriptor must have.
+/// </summary>
+static VOID SysEntrySetSelector(
+	_Out_ PSYSENTRY_SELECTOR pSelector,
+	_In_  UINT16             uiSelector,
+	_In_  BOOL               bCode,
+	_In_  BOOL               bLong,
+	_In_  UINT32             uiDpl
+) {
+	RtlZeroMemory(pSelector, sizeof(SYSENTRY_SELECTOR));
+	pSelector->Selector = uiSelector;
+	pSelector->Mask = SYSENTRY_ACCESS_S | SYSENTRY_ACCESS_PRESENT | SYSENTRY_ACCESS_CODE | SYSENTRY_ACCESS_DPL;
+	pSelector->Expected = SYSENTRY_ACCESS_S | SYSENTRY_ACCESS_PRESENT | (uiDpl << 13);
+
+	// Code must be 64-bit or 32-bit as SYSRET expects, data must be writable for a stack
+	if (bCode) {
+		pSelector->Mask |= SYSENTRY_ACCESS_L | SYSENTRY_ACCESS_DB;
+		pSelector->Expected |= SYSENTRY_ACCESS_CODE | (bLong ? SYSENTRY_ACCESS_L : SYSENTRY_ACCESS_DB);
+	}
+	else {
+		pSelector->Mask |= SYSENTRY_ACCESS_WRITE;
+		pSelector->Expected |= SYSENTRY_ACCESS_WRITE;
+	}
+}
+
+#if defined(_WIN32)
+/// <summary>
+/// Get the access rights of a descriptor from the GDT of the current processor via the \\.\KSeg driver.
+/// </summary>
+static BOOL SysEntryReadDriver(
+	_In_  HANDLE  hDevice,
+	_In_  UINT16  uiSelector,
+	_Out_ PUINT32 pAccess
+) {
+	KSEG_DESCRIPTOR_OUT DataOut = { 0x00 };
+	DWORD dwBytesReturned = 0x00;
+	*pAccess = 0x00;
+	UINT16 Selector = uiSelector & 0xFFFC;
+	if (!DeviceIoControl(hDevice, IOCTL_KSEG_QUERY_DESCRIPTOR, &Selector, sizeof(Selector), &DataOut, sizeof(DataOut), &dwBytesReturned, NULL)
+		|| dwBytesReturned < sizeof(DataOut))
+		return FALSE;
+	*pAccess = (UINT32)(DataOut.DataLow >> 32) & SYSENTRY_ACCESS_MASK;
+	return TRUE;
+}
+#endif
+
+/// <summary>
+/// Compare every selector with its descriptor in the GDT of the calling processor.
+/// </summary>
+static VOID SysEntryCheckDescriptors(
+	_Inout_ PSYSENTRY_INFORMATION pInformation
+) {
+	// 1. The driver reads any descriptor, LAR only those of DPL 3 from user mode
+	BOOL bDriver = FALSE;
+#if defined(_WIN32)
+	HANDLE hDevice = CreateFileW(KSEG_DEVICE_PATH, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0x00, NULL);
+	bDriver = hDevice != INVALID_HANDLE_VALUE;
+#endif
+	pInformation->Source = bDriver ? "\\\\.\\KSeg" : "LAR";
+
+	for (UINT32 Index = 0x00; Index < SYSENTRY_SELECTOR_COUNT; Index++) {
+		PSYSENTRY_SELECTOR pSelector = &pInformation->Selectors[Index];
+#if defined(_WIN32)
+		BOOL bRead = bDriver ? SysEntryReadDriver(hDevice, pSelector->Selector, &pSelector->Access) : _get_lar(pSelector->Selector | 0x03, &pSelector->Access);
+#else
+		BOOL bRead = _get_lar(pSelector->Selector | 0x03, &pSelector->Access);
+#endif
+
+		// 2. LAR fails on DPL 0 descriptors, which is what the kernel ones must be
+		if (bRead)
+			pSelector->Check = (pSelector->Access & pSelector->Mask) == pSelector->Expected ? SysEntryCheckMatch : SysEntryCheckMismatch;
+		else if (bDriver)
+			pSelector->Check = SysEntryCheckNotRead;
+		else if ((pSelector->Expected & SYSENTRY_ACCESS_DPL) == 0x00)
+			pSelector->Check = SysEntryCheckPrivileged;
+		else
+			pSelector->Check = SysEntryCheckMismatch;
+	}
+#if defined(_WIN32)
+	if (bDriver)
+		CloseHandle(hDevice);
+#endif
+	pInformation->bDescriptors = TRUE;
+}
+
+_Use_decl_annotations_
+VOID SysEntryDecode(
+	_In_  UINT64                Star,
+	_In_  UINT64                Lstar,
+	_In_  UINT64                Cstar,
+	_In_  UINT64                Fmask,
+	_Out_ PSYSENTRY_INFORMATION pInformation
+) {
+	RtlZeroMemory(pInformation, sizeof(SYSENTRY_INFORMATION));
+	pInformation->Star = Star;
+	pInformation->Lstar = Lstar;
+	pInformation->Cstar = Cstar;
+	pInformation->Fmask = Fmask;
+	pInformation->MaskedFlags = (UINT32)Fmask;
+
+	// SYSCALL forces RPL 0, SYSRET forces RPL 3
+	UINT16 Kernel = (UINT16)(Star >> 32) & 0xFFFC;
+	UINT16 User = (UINT16)(Star >> 48) & 0xFFFC;
+	SysEntrySetSelector(&pInformation->Selectors[SYSENTRY_KERNEL_CS], Kernel, TRUE, TRUE, 0x00);
+	SysEntrySetSelector(&pInformation->Selectors[SYSENTRY_KERNEL_SS], Kernel + 0x08, FALSE, FALSE, 0x00);
+	SysEntrySetSelector(&pInformation->Selectors[SYSENTRY_USER_CS32], User | 0x03, TRUE, FALSE, 0x03);
+	SysEntrySetSelector(&pInformation->Selectors[SYSENTRY_USER_SS], (User + 0x08) | 0x03, FALSE, FALSE, 0x03);
+	SysEntrySetSelector(&pInformation->Selectors[SYSENTRY_USER_CS64], (User + 0x10) | 0x03, TRUE, TRUE, 0x03);
+}
+
+_Use_decl_annotations_
+BOOL SysEntryQuery(
+	_In_  PMSR_BACKEND          pMsr,
+	_In_  UINT32                uiCpu,
+	_Out_ PSYSENTRY_INFORMATION pInformation
+) {
+	RtlZeroMemory(pInformation, sizeof(SYSENTRY_INFORMATION));
+
+	// 1. Move to the processor, so that the descriptors come from its GDT
+	THREAD_AFFINITY Previous = { 0x00 };
+	BOOL bPinned = uiCpu != MSR_CURRENT_CPU && ThreadPin(uiCpu, &Previous);
+
+	// 2. MSRs
+	UINT64 Star = 0x00;
+	UINT64 Lstar = 0x00;
+	UINT64 Cstar = 0x00;
+	UINT64 Fmask = 0x00;
+	BOOL bSuccess = MsrRead(pMsr, uiCpu, IA32_STAR, &Star)
+		&& MsrRead(pMsr, uiCpu, IA32_LSTAR, &Lstar)
+		&& MsrRead(pMsr, uiCpu, IA32_CSTAR, &Cstar)
+		&& MsrRead(pMsr, uiCpu, IA32_FMASK, &Fmask);
+	if (bSuccess) {
+		SysEntryDecode(Star, Lstar, Cstar, Fmask, pInformation);
+
+		// 3. Descriptors, only meaningful on the processor the MSRs come from
+		if (uiCpu == MSR_CURRENT_CPU || bPinned)
+			SysEntryCheckDescriptors(pInformation);
+
+		// 4. The selectors of this thread were loaded by SYSRET on the way back from the last system call
+		pInformation->CurrentCs = _get_cs();
+		pInformation->CurrentSs = _get_ss();
+		pInformation->bCurrentMatch = pInformation->CurrentCs == pInformation->Selectors[SYSENTRY_USER_CS64].Selector
+			&& pInformation->CurrentSs == pInformation->Selectors[SYSENTRY_USER_SS].Selector;
+	}
+	if (bPinned)
+		ThreadRestore(&Previous);
+	return bSuccess;
+}
+
+_Use_decl_annotations_
+VOID SysEntryFormatFlags(
+	_In_                 UINT32 uiFlags,
+	_Out_writes_(uiSize) LPSTR  szBuffer,
+	_In_                 UINT32 uiSize
+) {
+	UINT32 Length = 0x00;
+	szBuffer[0] = '\0';
+	for (UINT32 Bit = 0x00; Bit < 32; Bit++) {
+		if ((uiFlags & (1U << Bit)) == 0x00)
+			continue;
+		CHAR szUnknown[0x10] = { 0x00 };
+		LPCSTR szName = Bit < ARRAYSIZE(g_SysEntryFlags) ? g_SysEntryFlags[Bit] : NULL;
+		if (szName == NULL) {
+			snprintf(szUnknown, sizeof(szUnknown), "bit%u", Bit);
+			szName = szUnknown;
+		}
+		INT Written = snprintf(szBuffer + Length, uiSize - Length, "%s%s", Length == 0x00 ? "" : " ", szName);
+		if (Written < 0x00 || (UINT32)Written >= uiSize - Length)
+			break;
+		Length += (UINT32)Written;
+	}
+}
+
+_Use_decl_annotations_
+LPCSTR SysEntryGetSelectorName(
+	_In_ UINT32 uiSelector
+) {
+	return uiSelector < SYSENTRY_SELECTOR_COUNT ? g_SysEntrySelectors[uiSelector] : "unknown";
+}
+
+/// <summary>
+/// Get the bucket counting a latency: exact below 4 ticks, four buckets per power of two above.
+/// </summary>
+static UINT32 SysEntryGetBucket(
+	_In_ UINT64 Ticks
+) {
+	if (Ticks < SYSENTRY_BUCKETS_PER_OCTAVE)
+		return (UINT32)Ticks;
+	UINT32 Exponent = 0x00;
+	while ((Ticks >> (Exponent + 1)) != 0x00)
+		Exponent++;
+	return SYSENTRY_BUCKETS_PER_OCTAVE * (Exponent - 1) + (UINT32)((Ticks >> (Exponent - 2)) & 0x03);
+}
+
+_Use_decl_annotations_
+UINT64 SysEntryGetBucketFloor(
+	_In_ UINT32 uiBucket
+) {
+	if (uiBucket < SYSENTRY_BUCKETS_PER_OCTAVE)
+		return uiBucket;
+	UINT32 Exponent = uiBucket / SYSENTRY_BUCKETS_PER_OCTAVE + 1;
+	return (UINT64)(SYSENTRY_BUCKETS_PER_OCTAVE + uiBucket % SYSENTRY_BUCKETS_PER_OCTAVE) << (Exponent - 2);
+}
+
+static INT SysEntryCompare(
+	_In_ const void* a,
+	_In_ const void* b
+) {
+	UINT64 Left = *(const UINT64*)a;
+	UINT64 Right = *(const UINT64*)b;
+	return Left < Right ? -1 : Left > Right ? 1 : 0;
+}
+
+_Use_decl_annotations_
+BOOL SysEntryProfile(
+	_In_  UINT32            uiCpu,
+	_In_  UINT32            uiSamples,
+	_Out_ PSYSENTRY_PROFILE pProfile
+) {
+	RtlZeroMemory(pProfile, sizeof(SYSENTRY_PROFILE));
+	pProfile->Cpu = uiCpu;
+	if (uiSamples == 0x00)
+		uiSamples = SYSENTRY_DEFAULT_SAMPLES;
+	PUINT64 pSamples = (PUINT64)malloc(sizeof(UINT64) * uiSamples);
+	if (pSamples == NULL)
+		return FALSE;
+
+	// 1. Every round trip is measured on the processor
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (!ThreadPin(uiCpu, &Previous)) {
+		free(pSamples);
+		return FALSE;
+	}
+
+	// 2. Cost of the measure itself, the smallest one is the closest to the truth
+	UINT64 Overhead = ~0ULL;
+	for (UINT32 Index = 0x00; Index < SYSENTRY_WARMUP; Index++) {
+		UINT64 Start = _read_tsc_fenced();
+		UINT64 Elapsed = _read_tsc_fenced() - Start;
+		if (Elapsed < Overhead)
+			Overhead = Elapsed;
+		SysEntryNullCall();
+	}
+
+	// 3. Round trips, one per sample so that the outliers show in the histogram
+	for (UINT32 Index = 0x00; Index < uiSamples; Index++) {
+		UINT64 Start = _read_tsc_fenced();
+		SysEntryNullCall();
+		UINT64 Elapsed = _read_tsc_fenced() - Start;
+		pSamples[Index] = Elapsed > Overhead ? Elapsed - Overhead : 0x00;
+		pProfile->Buckets[SysEntryGetBucket(pSamples[Index])]++;
+	}
+	ThreadRestore(&Previous);
+
+	// 4. Summary
+	qsort(pSamples, uiSamples, sizeof(UINT64), SysEntryCompare);
+	pProfile->bMeasured = TRUE;
+	pProfile->Samples = uiSamples;
+	pProfile->Overhead = Overhead;
+	pProfile->Minimum = pSamples[0];
+	pProfile->Median = pSamples[uiSamples / 2];
+	pProfile->P99 = pSamples[(UINT64)uiSamples * 99 / 100];
+	pProfile->Maximum = pSamples[uiSamples - 1];
+	free(pSamples);
+	return TRUE;
+}
@@ -0,0 +1,166 @@
+/// @file    sysentry.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __SYSENTRY_H_GUARD__
+#define __SYSENTRY_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// Selectors derived from IA32_STAR by SYSCALL and SYSRET
+#define SYSENTRY_KERNEL_CS      0x00 // STAR[47:32]
+#define SYSENTRY_KERNEL_SS      0x01 // STAR[47:32] + 8
+#define SYSENTRY_USER_CS32      0x02 // STAR[63:48], SYSRET to compatibility mode
+#define SYSENTRY_USER_SS        0x03 // STAR[63:48] + 8
+#define SYSENTRY_USER_CS64      0x04 // STAR[63:48] + 16, SYSRET to 64-bit mode
+#define SYSENTRY_SELECTOR_COUNT 0x05
+
+/// Access rights of a descriptor, as returned by LAR
+#define SYSENTRY_ACCESS_CODE    0x00000800 // Type[3], code rather than data.
+#define SYSENTRY_ACCESS_WRITE   0x00000200 // Type[1], writable data or readable code.
+#define SYSENTRY_ACCESS_S       0x00001000 // Code or data rather than system descriptor.
+#define SYSENTRY_ACCESS_DPL     0x00006000
+#define SYSENTRY_ACCESS_PRESENT 0x00008000
+#define SYSENTRY_ACCESS_L       0x00200000 // 64-bit code.
+#define SYSENTRY_ACCESS_DB      0x00400000 // 32-bit code or stack.
+
+/// Quarter octave buckets of the latency histogram, enough for any 64-bit count of ticks
+#define SYSENTRY_BUCKETS_PER_OCTAVE 4
+#define SYSENTRY_BUCKETS            (64 * SYSENTRY_BUCKETS_PER_OCTAVE)
+
+/// Default number of round trips measured per processor
+#define SYSENTRY_DEFAULT_SAMPLES 20000
+
+/// <summary>
+/// Outcome of the comparison of a selector of IA32_STAR with the descriptor it indexes in the GDT.
+/// </summary>
+typedef enum _SYSENTRY_CHECK {
+	SysEntryCheckNotRead    = 0x00, // The descriptor could not be read.
+	SysEntryCheckMatch      = 0x01, // The descriptor has the attributes SYSCALL and SYSRET load.
+	SysEntryCheckMismatch   = 0x02,
+	SysEntryCheckPrivileged = 0x03  // LAR refused the descriptor in user mode, as expected from DPL 0.
+} SYSENTRY_CHECK;
+
+/// <summary>
+/// Selector loaded by SYSCALL or SYSRET and the descriptor it indexes.
+/// </summary>
+typedef struct _SYSENTRY_SELECTOR {
+	UINT16         Selector;
+	UINT32         Mask;        // SYSENTRY_ACCESS_* bits compared.
+	UINT32         Expected;    // Value these bits must have.
+	UINT32         Access;      // Access rights of the descriptor, when read.
+	SYSENTRY_CHECK Check;
+} SYSENTRY_SELECTOR, * PSYSENTRY_SELECTOR;
+
+/// <summary>
+/// Decoded SYSCALL and SYSRET configuration of a processor.
+/// </summary>
+typedef struct _SYSENTRY_INFORMATION {
+	UINT64            Star;
+	UINT64            Lstar;         // 64-bit entry point.
+	UINT64            Cstar;         // Compatibility mode entry point, unused on Intel.
+	UINT64            Fmask;
+	UINT32            MaskedFlags;   // RFLAGS bits cleared on entry.
+	SYSENTRY_SELECTOR Selectors[SYSENTRY_SELECTOR_COUNT];
+	BOOL              bDescriptors;  // The descriptors have been compared.
+	LPCSTR            Source;        // Where the descriptors have been read from.
+	UINT16            CurrentCs;     // Selectors of the calling thread, which SYSRET loaded.
+	UINT16            CurrentSs;
+	BOOL              bCurrentMatch;
+} SYSENTRY_INFORMATION, * PSYSENTRY_INFORMATION;
+
+/// <summary>
+/// Latency of null system calls on one processor, in TSC ticks, the cost of reading the TSC excluded.
+/// </summary>
+typedef struct _SYSENTRY_PROFILE {
+	UINT32 Cpu;
+	BOOL   bMeasured;
+	UINT32 Samples;
+	UINT64 Overhead;    // Cost of the two fenced reads of the TSC, subtracted from every sample.
+	UINT64 Minimum;
+	UINT64 Median;
+	UINT64 P99;
+	UINT64 Maximum;
+	UINT32 Buckets[SYSENTRY_BUCKETS];
+} SYSENTRY_PROFILE, * PSYSENTRY_PROFILE;
+
+/// <summary>
+/// Decode IA32_STAR, IA32_LSTAR, IA32_CSTAR and IA32_FMASK without reading anything.
+/// </summary>
+/// <param name="Star">Value of IA32_STAR.</param>
+/// <param name="Lstar">Value of IA32_LSTAR.</param>
+/// <param name="Cstar">Value of IA32_CSTAR.</param>
+/// <param name="Fmask">Value of IA32_FMASK.</param>
+/// <param name="pInformation">Pointer to the structure receiving the decoded values.</param>
+VOID SysEntryDecode(
+	_In_  UINT64                Star,
+	_In_  UINT64                Lstar,
+	_In_  UINT64                Cstar,
+	_In_  UINT64                Fmask,
+	_Out_ PSYSENTRY_INFORMATION pInformation
+);
+
+/// <summary>
+/// Read and decode the SYSCALL MSRs of a processor, then compare the selectors with the GDT of that
+/// processor: through the \\.\KSeg driver on Windows when loaded, with LAR otherwise, which only sees
+/// the user mode descriptors.
+/// </summary>
+/// <param name="pMsr">Pointer to an opened MSR backend.</param>
+/// <param name="uiCpu">Index of the processor, or MSR_CURRENT_CPU.</param>
+/// <param name="pInformation">Pointer to the structure receiving the decoded values.</param>
+/// <returns>Whether the MSRs have been read.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SysEntryQuery(
+	_In_  PMSR_BACKEND          pMsr,
+	_In_  UINT32                uiCpu,
+	_Out_ PSYSENTRY_INFORMATION pInformation
+);
+
+/// <summary>
+/// Write the names of the RFLAGS bits set in a mask, e.g. "TF IF DF".
+/// </summary>
+/// <param name="uiFlags">Mask of RFLAGS bits.</param>
+/// <param name="szBuffer">Buffer receiving the names.</param>
+/// <param name="uiSize">Size of the buffer in bytes.</param>
+VOID SysEntryFormatFlags(
+	_In_                 UINT32 uiFlags,
+	_Out_writes_(uiSize) LPSTR  szBuffer,
+	_In_                 UINT32 uiSize
+);
+
+/// <summary>
+/// Get the name of a selector of IA32_STAR.
+/// </summary>
+/// <param name="uiSelector">SYSENTRY_KERNEL_CS to SYSENTRY_USER_CS64.</param>
+/// <returns>Name of the selector.</returns>
+LPCSTR SysEntryGetSelectorName(
+	_In_ UINT32 uiSelector
+);
+
+/// <summary>
+/// Measure null system call round trips from a thread pinned on a processor.
+/// </summary>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="uiSamples">Round trips measured, 0 for SYSENTRY_DEFAULT_SAMPLES.</param>
+/// <param name="pProfile">Pointer to the structure receiving the latencies.</param>
+/// <returns>Whether the thread could be pinned on the processor.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL SysEntryProfile(
+	_In_  UINT32            uiCpu,
+	_In_  UINT32            uiSamples,
+	_Out_ PSYSENTRY_PROFILE pProfile
+);
+
+/// <summary>
+/// Get the lowest latency counted by a bucket of the histogram.
+/// </summary>
+/// <param name="uiBucket">Index of the bucket.</param>
+/// <returns>Lower bound of the bucket in TSC ticks.</returns>
+UINT64 SysEntryGetBucketFloor(
+	_In_ UINT32 uiBucket
+);
+
+#endif // !__SYSENTRY_H_GUARD__
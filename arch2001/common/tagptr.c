@@ -0,0 +1,91 @@
+/// @file    tagptr.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include "tagptr.h"
+
+/// Width of the addresses without 5-level paging
+#define TAGPTR_LINEAR_BITS_LA48 48
+#define TAGPTR_LINEAR_BITS_LA57 57
+
+TAGPTR_LAYOUT g_TagPtrLayout = { 0x00 };
+
+_Use_decl_annotations_
+BOOL TagPtrInitialise(
+	_In_opt_ PCPUID_BACKEND pBackend,
+	_In_     UINT32         uiRequiredBits
+) {
+	// 1. Open the local processor if no backend is given
+	CPUID_BACKEND Local = { 0x00 };
+	if (pBackend == NULL) {
+		if (!CpuidOpen(&Local))
+			return FALSE;
+		pBackend = &Local;
+	}
+
+	// 2. Get the address widths and the 5-level paging flag
+	TAGPTR_LAYOUT Layout = { 0x00 };
+	UINT Registers[4] = { 0x00 };
+	Layout.LinearBits = TAGPTR_LINEAR_BITS_LA48;
+	Layout.PhysicalBits = 36;
+	if (CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_MAXIMUM, 0x00, Registers) && Registers[0] >= CPUID_LEAF_ADDRESS_SIZES
+		&& CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_ADDRESS_SIZES, 0x00, Registers)) {
+		Layout.PhysicalBits = Registers[0] & 0xFF;
+		Layout.LinearBits = (Registers[0] >> 8) & 0xFF;
+	}
+	if (CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers) && Registers[0] >= CPUID_LEAF_EXTENDED_FEATURES
+		&& CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_FEATURES, 0x00, Registers)) {
+		StructuredExtendedFeatureEcx Features = { .value = Registers[2] };
+		Layout.La57 = Features.elem.LA57;
+	}
+	if (Layout.La57 && Layout.LinearBits < TAGPTR_LINEAR_BITS_LA57)
+		Layout.LinearBits = TAGPTR_LINEAR_BITS_LA57;
+	if (Layout.LinearBits < TAGPTR_LINEAR_BITS_LA48 || Layout.LinearBits > 64)
+		Layout.LinearBits = Layout.La57 ? TAGPTR_LINEAR_BITS_LA57 : TAGPTR_LINEAR_BITS_LA48;
+	CpuidClose(&Local);
+
+	// 3. User-mode pointers are canonical with the top bit of the linear address cleared
+	Layout.AddressBits = Layout.LinearBits - 1;
+	Layout.TagBits = 64 - Layout.AddressBits;
+	Layout.AddressMask = (1ULL << Layout.AddressBits) - 1;
+	Layout.Initialised = TRUE;
+	g_TagPtrLayout = Layout;
+	return Layout.TagBits >= uiRequiredBits;
+}
+
+_Use_decl_annotations_
+BOOL CompPtrRegionInitialise(
+	_Out_ PCOMPPTR_REGION pRegion,
+	_In_  PVOID           Base,
+	_In_  SIZE_T          Size,
+	_In_  SIZE_T          Alignment
+) {
+	if (pRegion == NULL)
+		return FALSE;
+	RtlZeroMemory(pRegion, sizeof(COMPPTR_REGION));
+	if (!g_TagPtrLayout.Initialised && !TagPtrInitialise(NULL, 0x00))
+		return FALSE;
+
+	// 1. The alignment gives the number of low bits dropped
+	if (Alignment == 0x00 || (Alignment & (Alignment - 1)) != 0x00 || ((ULONG_PTR)Base & (Alignment - 1)) != 0x00)
+		return FALSE;
+	UINT32 uiShift = 0x00;
+	while (((SIZE_T)1 << uiShift) < Alignment)
+		uiShift++;
+
+	// 2. Every slot must have an index, 0 being reserved for NULL
+	if (((UINT64)Size >> uiShift) > 0xFFFFFFFEULL)
+		return FALSE;
+
+	// 3. The region must be made of user-mode addresses of this host
+	if (!TagPtrIsRepresentable(Base) || (UINT64)Size > g_TagPtrLayout.AddressMask - (UINT64)(ULONG_PTR)Base)
+		return FALSE;
+
+	pRegion->Base = (ULONG_PTR)Base;
+	pRegion->Size = Size;
+	pRegion->Shift = uiShift;
+	return TRUE;
+}
@@ -0,0 +1,154 @@
+/// @file    tagptr.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __TAGPTR_H_GUARD__
+#define __TAGPTR_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+
+/// <summary>
+/// Width of the addresses of this host and the pointer bits left for tags.
+/// </summary>
+typedef struct _TAGPTR_LAYOUT {
+	BOOL   Initialised;
+	UINT32 PhysicalBits;  // CPUID.80000008H:EAX[7:0]
+	UINT32 LinearBits;    // CPUID.80000008H:EAX[15:8], 57 when 5-level paging is supported.
+	BOOL   La57;          // CPUID.(07H,0):ECX[16]
+	UINT32 AddressBits;   // Bits of a user-mode pointer, the upper half of the canonical space belonging to the kernel.
+	UINT32 TagBits;       // High bits of a user-mode pointer always zero, hence free for a tag.
+	UINT64 AddressMask;
+} TAGPTR_LAYOUT, * PTAGPTR_LAYOUT;
+
+/// <summary>
+/// Layout of this host. Set by TagPtrInitialise.
+/// </summary>
+EXTERN_C TAGPTR_LAYOUT g_TagPtrLayout;
+
+/// <summary>
+/// Derive the pointer layout from the processor. 5-level paging is assumed whenever the processor supports it,
+/// because the OS may hand out addresses above 47 bits to any library of the process.
+/// </summary>
+/// <param name="pBackend">Optional CPUID backend, the local processor by default.</param>
+/// <param name="uiRequiredBits">Number of tag bits the caller needs.</param>
+/// <returns>Whether the host leaves at least the required number of tag bits.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL TagPtrInitialise(
+	_In_opt_ PCPUID_BACKEND pBackend,
+	_In_     UINT32         uiRequiredBits
+);
+
+/// <summary>
+/// Pointer with a tag in its free high bits, e.g. an ABA counter. The tag wraps at 2^g_TagPtrLayout.TagBits.
+/// </summary>
+typedef UINT64 TAGPTR;
+
+/// <summary>
+/// Check that a pointer fits in the address bits of the layout.
+/// </summary>
+FORCEINLINE BOOL TagPtrIsRepresentable(
+	_In_opt_ const void* Pointer
+) {
+	return ((UINT64)(ULONG_PTR)Pointer & ~g_TagPtrLayout.AddressMask) == 0x00;
+}
+
+FORCEINLINE TAGPTR TagPtrMake(
+	_In_opt_ const void* Pointer,
+	_In_     UINT64      Tag
+) {
+	return ((UINT64)(ULONG_PTR)Pointer & g_TagPtrLayout.AddressMask) | (Tag << g_TagPtrLayout.AddressBits);
+}
+
+FORCEINLINE PVOID TagPtrGetPointer(
+	_In_ TAGPTR Value
+) {
+	return (PVOID)(ULONG_PTR)(Value & g_TagPtrLayout.AddressMask);
+}
+
+FORCEINLINE UINT64 TagPtrGetTag(
+	_In_ TAGPTR Value
+) {
+	return Value >> g_TagPtrLayout.AddressBits;
+}
+
+/// <summary>
+/// Replace the pointer and increment the tag, as done by every successful compare-and-swap of a lock-free structure.
+/// </summary>
+FORCEINLINE TAGPTR TagPtrNext(
+	_In_     TAGPTR      Previous,
+	_In_opt_ const void* Pointer
+) {
+	return TagPtrMake(Pointer, TagPtrGetTag(Previous) + 1);
+}
+
+/// <summary>
+/// Define a tagged pointer to a given type: Name, NameMake, NameGet, NameTag and NameNext.
+/// </summary>
+#define TAGPTR_DEFINE(Name, Type) \
+	typedef struct _##Name { TAGPTR Value; } Name; \
+	FORCEINLINE Name Name##Make(Type* Pointer, UINT64 Tag) { Name Result = { TagPtrMake(Pointer, Tag) }; return Result; } \
+	FORCEINLINE Type* Name##Get(Name Value) { return (Type*)TagPtrGetPointer(Value.Value); } \
+	FORCEINLINE UINT64 Name##Tag(Name Value) { return TagPtrGetTag(Value.Value); } \
+	FORCEINLINE Name Name##Next(Name Previous, Type* Pointer) { Name Result = { TagPtrNext(Previous.Value, Pointer) }; return Result; }
+
+/// <summary>
+/// Region addressed by 32-bit compressed pointers: index of an aligned slot from the base, 0 being NULL.
+/// </summary>
+typedef struct _COMPPTR_REGION {
+	ULONG_PTR Base;
+	SIZE_T    Size;
+	UINT32    Shift; // Log2 of the alignment of the objects.
+} COMPPTR_REGION, * PCOMPPTR_REGION;
+
+/// <summary>
+/// Compressed pointer.
+/// </summary>
+typedef UINT32 COMPPTR;
+
+/// <summary>
+/// Describe a region addressed by compressed pointers, typically an arena. The region must fit in the address bits of
+/// the host and in 2^32 - 1 slots of the given alignment.
+/// </summary>
+/// <param name="pRegion">Pointer to the region.</param>
+/// <param name="Base">First address of the region, aligned.</param>
+/// <param name="Size">Size of the region.</param>
+/// <param name="Alignment">Alignment of every object of the region, a power of two.</param>
+/// <returns>Whether every address of the region can be compressed.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL CompPtrRegionInitialise(
+	_Out_ PCOMPPTR_REGION pRegion,
+	_In_  PVOID           Base,
+	_In_  SIZE_T          Size,
+	_In_  SIZE_T          Alignment
+);
+
+FORCEINLINE COMPPTR CompPtrCompress(
+	_In_     const COMPPTR_REGION* pRegion,
+	_In_opt_ const void*           Pointer
+) {
+	if (Pointer == NULL)
+		return 0x00;
+	return (COMPPTR)(((ULONG_PTR)Pointer - pRegion->Base) >> pRegion->Shift) + 1;
+}
+
+FORCEINLINE PVOID CompPtrDecompress(
+	_In_ const COMPPTR_REGION* pRegion,
+	_In_ COMPPTR               Value
+) {
+	if (Value == 0x00)
+		return NULL;
+	return (PVOID)(pRegion->Base + ((ULONG_PTR)(Value - 1) << pRegion->Shift));
+}
+
+/// <summary>
+/// Define a compressed pointer to a given type: Name, NameCompress and NameDecompress.
+/// </summary>
+#define COMPPTR_DEFINE(Name, Type) \
+	typedef struct _##Name { COMPPTR Value; } Name; \
+	FORCEINLINE Name Name##Compress(const COMPPTR_REGION* pRegion, Type* Pointer) { Name Result = { CompPtrCompress(pRegion, Pointer) }; return Result; } \
+	FORCEINLINE Type* Name##Decompress(const COMPPTR_REGION* pRegion, Name Value) { return (Type*)CompPtrDecompress(pRegion, Value.Value); }
+
+#endif // !__TAGPTR_H_GUARD__
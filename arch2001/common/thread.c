@@ -0,0 +1,247 @@
+/// @file    thread.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include "thread.h"
+
+UINT32 ThreadGetCpuCount() {
+#if defined(_WIN32)
+	return GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+	long lCount = sysconf(_SC_NPROCESSORS_CONF);
+	return lCount > 0 ? (UINT32)lCount : 1;
+#endif
+}
+
+UINT32 ThreadGetCurrentCpu() {
+#if defined(_WIN32)
+	// 1. Get the processor number relative to its group
+	PROCESSOR_NUMBER Number = { 0x00 };
+	GetCurrentProcessorNumberEx(&Number);
+
+	// 2. Add the processors of the previous groups
+	UINT32 uiCpu = Number.Number;
+	for (WORD wGroup = 0x00; wGroup < Number.Group; wGroup++)
+		uiCpu += GetActiveProcessorCount(wGroup);
+	return uiCpu;
+#else
+	INT iCpu = sched_getcpu();
+	return iCpu < 0 ? 0x00 : (UINT32)iCpu;
+#endif
+}
+
+#if defined(_WIN32)
+/// <summary>
+/// Convert a processor index into a group and an index relative to that group.
+/// </summary>
+static BOOL ThreadFindGroup(
+	_Inout_ PUINT32 puiCpu,
+	_Out_   PWORD   pwGroup
+) {
+	WORD wGroupCount = GetActiveProcessorGroupCount();
+	for (WORD wGroup = 0x00; wGroup < wGroupCount; wGroup++) {
+		DWORD dwCount = GetActiveProcessorCount(wGroup);
+		if (*puiCpu < dwCount) {
+			*pwGroup = wGroup;
+			return TRUE;
+		}
+		*puiCpu -= dwCount;
+	}
+	return FALSE;
+}
+#endif
+
+_Use_decl_annotations_
+BOOL ThreadPin(
+	_In_      UINT32           uiCpu,
+	_Out_opt_ PTHREAD_AFFINITY pPrevious
+) {
+#if defined(_WIN32)
+	// 1. Find the group of the processor
+	WORD wGroup = 0x00;
+	if (!ThreadFindGroup(&uiCpu, &wGroup))
+		return FALSE;
+
+	// 2. Change the affinity of the thread
+	GROUP_AFFINITY Affinity = { 0x00 };
+	Affinity.Group = wGroup;
+	Affinity.Mask = (KAFFINITY)1 << uiCpu;
+	return SetThreadGroupAffinity(GetCurrentThread(), &Affinity, pPrevious != NULL ? &pPrevious->Affinity : NULL);
+#else
+	if (uiCpu >= CPU_SETSIZE)
+		return FALSE;
+
+	// 1. Save the current affinity
+	if (pPrevious != NULL) {
+		cpu_set_t Previous;
+		CPU_ZERO(&Previous);
+		if (sched_getaffinity(0x00, sizeof(cpu_set_t), &Previous) != 0x00)
+			return FALSE;
+		RtlCopyMemory(pPrevious->Mask, &Previous, sizeof(pPrevious->Mask) < sizeof(cpu_set_t) ? sizeof(pPrevious->Mask) : sizeof(cpu_set_t));
+	}
+
+	// 2. Change the affinity of the thread. The scheduler migrates it before returning.
+	cpu_set_t Set;
+	CPU_ZERO(&Set);
+	CPU_SET(uiCpu, &Set);
+	return sched_setaffinity(0x00, sizeof(cpu_set_t), &Set) == 0x00;
+#endif
+}
+
+_Use_decl_annotations_
+BOOL ThreadSetAffinity(
+	_In_reads_(uiCount) const UINT32* pCpus,
+	_In_      UINT32           uiCount,
+	_Out_opt_ PTHREAD_AFFINITY pPrevious
+) {
+	if (pCpus == NULL || uiCount == 0x00)
+		return FALSE;
+#if defined(_WIN32)
+	// 1. Keep the processors of the group of the first one
+	GROUP_AFFINITY Affinity = { 0x00 };
+	UINT32 uiFirst = pCpus[0];
+	if (!ThreadFindGroup(&uiFirst, &Affinity.Group))
+		return FALSE;
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		UINT32 uiCpu = pCpus[Index];
+		WORD wGroup = 0x00;
+		if (ThreadFindGroup(&uiCpu, &wGroup) && wGroup == Affinity.Group)
+			Affinity.Mask |= (KAFFINITY)1 << uiCpu;
+	}
+
+	// 2. Change the affinity of the thread
+	return SetThreadGroupAffinity(GetCurrentThread(), &Affinity, pPrevious != NULL ? &pPrevious->Affinity : NULL);
+#else
+	// 1. Save the current affinity
+	if (pPrevious != NULL) {
+		cpu_set_t Previous;
+		CPU_ZERO(&Previous);
+		if (sched_getaffinity(0x00, sizeof(cpu_set_t), &Previous) != 0x00)
+			return FALSE;
+		RtlCopyMemory(pPrevious->Mask, &Previous, sizeof(pPrevious->Mask) < sizeof(cpu_set_t) ? sizeof(pPrevious->Mask) : sizeof(cpu_set_t));
+	}
+
+	// 2. Change the affinity of the thread
+	cpu_set_t Set;
+	CPU_ZERO(&Set);
+	for (UINT32 Index = 0x00; Index < uiCount; Index++) {
+		if (pCpus[Index] < CPU_SETSIZE)
+			CPU_SET(pCpus[Index], &Set);
+	}
+	return CPU_COUNT(&Set) != 0x00 && sched_setaffinity(0x00, sizeof(cpu_set_t), &Set) == 0x00;
+#endif
+}
+
+_Use_decl_annotations_
+VOID ThreadRestore(
+	_In_ PTHREAD_AFFINITY pPrevious
+) {
+#if defined(_WIN32)
+	SetThreadGroupAffinity(GetCurrentThread(), &pPrevious->Affinity, NULL);
+#else
+	cpu_set_t Set;
+	CPU_ZERO(&Set);
+	RtlCopyMemory(&Set, pPrevious->Mask, sizeof(pPrevious->Mask) < sizeof(cpu_set_t) ? sizeof(pPrevious->Mask) : sizeof(cpu_set_t));
+	sched_setaffinity(0x00, sizeof(cpu_set_t), &Set);
+#endif
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI ThreadStart(
+	_In_ LPVOID lpParameter
+) {
+	PTHREAD pThread = (PTHREAD)lpParameter;
+	pThread->Routine(pThread->Parameter);
+	return 0x00;
+}
+#else
+static void* ThreadStart(
+	_In_ void* lpParameter
+) {
+	PTHREAD pThread = (PTHREAD)lpParameter;
+	pThread->Routine(pThread->Parameter);
+	return NULL;
+}
+#endif
+
+_Use_decl_annotations_
+BOOL ThreadCreate(
+	_Out_    PTHREAD pThread,
+	_In_     VOID(*Routine)(PVOID),
+	_In_opt_ PVOID   Parameter
+) {
+	if (pThread == NULL || Routine == NULL)
+		return FALSE;
+	pThread->Routine = Routine;
+	pThread->Parameter = Parameter;
+
+#if defined(_WIN32)
+	pThread->hThread = CreateThread(NULL, 0x00, ThreadStart, pThread, 0x00, NULL);
+	return pThread->hThread != NULL;
+#else
+	pthread_t Thread;
+	if (pthread_create(&Thread, NULL, ThreadStart, pThread) != 0x00)
+		return FALSE;
+	pThread->Thread = (UINT64)Thread;
+	return TRUE;
+#endif
+}
+
+_Use_decl_annotations_
+VOID ThreadJoin(
+	_In_ PTHREAD pThread
+) {
+#if defined(_WIN32)
+	WaitForSingleObject(pThread->hThread, INFINITE);
+	CloseHandle(pThread->hThread);
+	pThread->hThread = NULL;
+#else
+	pthread_join((pthread_t)pThread->Thread, NULL);
+	pThread->Thread = 0x00;
+#endif
+}
+
+_Use_decl_annotations_
+VOID ThreadSleep(
+	_In_ UINT32 uiMilliseconds
+) {
+#if defined(_WIN32)
+	Sleep(uiMilliseconds);
+#else
+	usleep((useconds_t)uiMilliseconds * 1000);
+#endif
+}
+
+VOID ThreadYield() {
+#if defined(_WIN32)
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+UINT64 ThreadGetTime() {
+#if defined(_WIN32)
+	static LARGE_INTEGER Frequency = { 0x00 };
+	if (Frequency.QuadPart == 0x00)
+		QueryPerformanceFrequency(&Frequency);
+	LARGE_INTEGER Counter = { 0x00 };
+	QueryPerformanceCounter(&Counter);
+	return (UINT64)(Counter.QuadPart / Frequency.QuadPart) * 1000000000ULL
+		+ (UINT64)(Counter.QuadPart % Frequency.QuadPart) * 1000000000ULL / (UINT64)Frequency.QuadPart;
+#else
+	struct timespec Time = { 0x00 };
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (UINT64)Time.tv_sec * 1000000000ULL + (UINT64)Time.tv_nsec;
+#endif
+}
@@ -0,0 +1,125 @@
+/// @file    thread.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __THREAD_H_GUARD__
+#define __THREAD_H_GUARD__
+#include "ost.h"
+
+/// <summary>
+/// Affinity of a thread, saved before pinning it so that it can be restored afterwards.
+/// </summary>
+typedef struct _THREAD_AFFINITY {
+#if defined(_WIN32)
+	GROUP_AFFINITY Affinity;
+#else
+	UINT64 Mask[16];
+#endif
+} THREAD_AFFINITY, * PTHREAD_AFFINITY;
+
+/// <summary>
+/// Thread created by ThreadCreate. Must stay valid until ThreadJoin returns.
+/// </summary>
+typedef struct _THREAD {
+#if defined(_WIN32)
+	HANDLE hThread;
+#else
+	UINT64 Thread;
+#endif
+	VOID(*Routine)(PVOID);
+	PVOID Parameter;
+} THREAD, * PTHREAD;
+
+/// <summary>
+/// Get the number of logical processors. Processors are indexed from 0 to this value minus one,
+/// across all processor groups on Windows.
+/// </summary>
+/// <returns>Number of logical processors.</returns>
+UINT32 ThreadGetCpuCount();
+
+/// <summary>
+/// Get the index of the processor the calling thread is running on, as reported by the OS.
+/// </summary>
+/// <returns>Index of the processor.</returns>
+UINT32 ThreadGetCurrentCpu();
+
+/// <summary>
+/// Pin the calling thread to a logical processor.
+/// </summary>
+/// <param name="uiCpu">Index of the processor.</param>
+/// <param name="pPrevious">Optional pointer receiving the previous affinity.</param>
+/// <returns>Whether the thread is now running on the processor.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL ThreadPin(
+	_In_      UINT32           uiCpu,
+	_Out_opt_ PTHREAD_AFFINITY pPrevious
+);
+
+/// <summary>
+/// Restrict the calling thread to a set of logical processors and let the OS schedule it among them.
+/// On Windows the set is limited to the processor group of its first processor.
+/// </summary>
+/// <param name="pCpus">Array of processor indexes.</param>
+/// <param name="uiCount">Number of processors in the array.</param>
+/// <param name="pPrevious">Optional pointer receiving the previous affinity.</param>
+/// <returns>Whether the affinity has been changed.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL ThreadSetAffinity(
+	_In_reads_(uiCount) const UINT32* pCpus,
+	_In_      UINT32           uiCount,
+	_Out_opt_ PTHREAD_AFFINITY pPrevious
+);
+
+/// <summary>
+/// Restore the affinity of the calling thread.
+/// </summary>
+/// <param name="pPrevious">Pointer to the affinity returned by ThreadPin.</param>
+VOID ThreadRestore(
+	_In_ PTHREAD_AFFINITY pPrevious
+);
+
+/// <summary>
+/// Create a thread.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure, owned by the caller.</param>
+/// <param name="Routine">Routine executed by the thread.</param>
+/// <param name="Parameter">Parameter passed to the routine.</param>
+/// <returns>Whether the thread has been created.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL ThreadCreate(
+	_Out_    PTHREAD pThread,
+	_In_     VOID(*Routine)(PVOID),
+	_In_opt_ PVOID   Parameter
+);
+
+/// <summary>
+/// Wait for a thread to exit and release its resources.
+/// </summary>
+/// <param name="pThread">Pointer to the thread structure.</param>
+VOID ThreadJoin(
+	_In_ PTHREAD pThread
+);
+
+/// <summary>
+/// Suspend the calling thread.
+/// </summary>
+/// <param name="uiMilliseconds">Duration in milliseconds.</param>
+VOID ThreadSleep(
+	_In_ UINT32 uiMilliseconds
+);
+
+/// <summary>
+/// Give the rest of the time slice of the calling thread to another ready thread.
+/// </summary>
+VOID ThreadYield();
+
+/// <summary>
+/// Get a monotonic timestamp.
+/// </summary>
+/// <returns>Timestamp in nanoseconds.</returns>
+UINT64 ThreadGetTime();
+
+#endif // !__THREAD_H_GUARD__
@@ -0,0 +1,167 @@
+/// @file    topology.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#include <stdlib.h>
+#include <string.h>
+#include "topology.h"
+
+/// <summary>
+/// Get the number of bits needed to number a given count of items.
+/// </summary>
+static UINT32 TopologyGetShift(
+	_In_ UINT32 uiCount
+) {
+	UINT32 uiShift = 0x00;
+	while (uiShift < 32 && ((UINT64)1 << uiShift) < uiCount)
+		uiShift++;
+	return uiShift;
+}
+
+/// <summary>
+/// Get the APIC ID of a processor and the shift giving its package identifier.
+/// </summary>
+static VOID TopologyGetApicId(
+	_In_  PCPUID_BACKEND pBackend,
+	_In_  UINT32         uiCpu,
+	_In_  UINT32         uiMaximumLeaf,
+	_Out_ PUINT32        puiApicId,
+	_Out_ PUINT32        puiPackageShift
+) {
+	UINT Registers[4] = { 0x00 };
+	*puiApicId = 0x00;
+	*puiPackageShift = 0x00;
+
+	// 1. The x2APIC ID and the width of each level come from the extended topology leaf
+	if (uiMaximumLeaf >= CPUID_LEAF_EXTENDED_TOPOLOGY
+		&& CpuidBackendQuery(pBackend, uiCpu, CPUID_LEAF_EXTENDED_TOPOLOGY, 0x00, Registers)
+		&& Registers[1] != 0x00) {
+		*puiApicId = Registers[3];
+		for (UINT SubLeaf = 0x00; SubLeaf < 0x08; SubLeaf++) {
+			if (!CpuidBackendQuery(pBackend, uiCpu, CPUID_LEAF_EXTENDED_TOPOLOGY, SubLeaf, Registers))
+				break;
+			ExtendedTopologyEcx Level = { .value = Registers[2] };
+			if (Level.elem.LevelType == TOPOLOGY_LEVEL_INVALID)
+				break;
+			ExtendedTopologyEax Width = { .value = Registers[0] };
+			*puiPackageShift = Width.elem.Shift;
+		}
+		return;
+	}
+
+	// 2. Otherwise use the initial APIC ID and the number of addressable processors of the package
+	if (CpuidBackendQuery(pBackend, uiCpu, CPUID_LEAF_BASIC_INFORMATION, 0x00, Registers)) {
+		BasicInformationEdx Features = { .value = Registers[3] };
+		*puiApicId = Registers[1] >> 24;
+		if (Features.elem.HTT)
+			*puiPackageShift = TopologyGetShift((Registers[1] >> 16) & 0xFF);
+	}
+}
+
+_Use_decl_annotations_
+BOOL TopologyBuild(
+	_In_  PCPUID_BACKEND pBackend,
+	_Out_ PTOPOLOGY      pTopology
+) {
+	if (pBackend == NULL || pTopology == NULL)
+		return FALSE;
+	RtlZeroMemory(pTopology, sizeof(TOPOLOGY));
+
+	// 1. Select the cache leaf of the vendor
+	UINT Registers[4] = { 0x00 };
+	if (pBackend->CpuCount == 0x00 || !CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_VENDOR, 0x00, Registers))
+		return FALSE;
+	UINT32 uiMaximumLeaf = Registers[0];
+	BOOL bAmd = Registers[1] == 0x68747541; // "Auth"enticAMD
+	UINT32 uiCacheLeaf = uiMaximumLeaf >= CPUID_LEAF_CACHE_PARAMETERS ? CPUID_LEAF_CACHE_PARAMETERS : 0x00;
+	if (bAmd) {
+		uiCacheLeaf = 0x00;
+		if (CpuidBackendQuery(pBackend, 0x00, CPUID_LEAF_EXTENDED_MAXIMUM, 0x00, Registers) && Registers[0] >= CPUID_LEAF_CACHE_TOPOLOGY)
+			uiCacheLeaf = CPUID_LEAF_CACHE_TOPOLOGY;
+	}
+
+	pTopology->Cpus = (PTOPOLOGY_CPU)calloc(pBackend->CpuCount, sizeof(TOPOLOGY_CPU));
+	if (pTopology->Cpus == NULL)
+		return FALSE;
+	pTopology->CpuCount = pBackend->CpuCount;
+
+	for (UINT32 Index = 0x00; Index < pTopology->CpuCount; Index++) {
+		PTOPOLOGY_CPU Cpu = &pTopology->Cpus[Index];
+
+		// 2. Get the position of the processor in its package
+		UINT32 uiPackageShift = 0x00;
+		TopologyGetApicId(pBackend, Index, uiMaximumLeaf, &Cpu->ApicId, &uiPackageShift);
+		Cpu->PackageId = (UINT32)((UINT64)Cpu->ApicId >> uiPackageShift);
+		Cpu->L2Id = Cpu->ApicId;
+		Cpu->LlcId = Cpu->PackageId;
+
+		// 3. Processors sharing a cache have the same APIC ID once the bits numbering the sharing
+		//    processors are removed
+		UINT32 uiLevel = 0x00;
+		for (UINT SubLeaf = 0x00; uiCacheLeaf != 0x00 && SubLeaf < 0x10; SubLeaf++) {
+			if (!CpuidBackendQuery(pBackend, Index, uiCacheLeaf, SubLeaf, Registers))
+				break;
+			CacheParametersEax Cache = { .value = Registers[0] };
+			if (Cache.elem.CacheType == TOPOLOGY_CACHE_NULL)
+				break;
+			if (Cache.elem.CacheType == TOPOLOGY_CACHE_INSTRUCTION || Cache.elem.CacheLevel < 2)
+				continue;
+
+			UINT32 uiId = (UINT32)((UINT64)Cpu->ApicId >> TopologyGetShift(Cache.elem.MaximumSharing + 1));
+			if (Cache.elem.CacheLevel == 2)
+				Cpu->L2Id = uiId;
+			if (Cache.elem.CacheLevel >= uiLevel) {
+				uiLevel = Cache.elem.CacheLevel;
+				Cpu->LlcId = uiId;
+			}
+		}
+		if (uiLevel > pTopology->LlcLevel)
+			pTopology->LlcLevel = uiLevel;
+	}
+
+	// 4. Count the distinct caches and packages
+	for (UINT32 Index = 0x00; Index < pTopology->CpuCount; Index++) {
+		BOOL bNewLlc = TRUE;
+		BOOL bNewPackage = TRUE;
+		for (UINT32 Previous = 0x00; Previous < Index; Previous++) {
+			if (pTopology->Cpus[Previous].PackageId == pTopology->Cpus[Index].PackageId) {
+				bNewPackage = FALSE;
+				if (pTopology->Cpus[Previous].LlcId == pTopology->Cpus[Index].LlcId)
+					bNewLlc = FALSE;
+			}
+		}
+		pTopology->LlcCount += bNewLlc;
+		pTopology->PackageCount += bNewPackage;
+	}
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID TopologyFree(
+	_Inout_ PTOPOLOGY pTopology
+) {
+	if (pTopology == NULL)
+		return;
+	free(pTopology->Cpus);
+	RtlZeroMemory(pTopology, sizeof(TOPOLOGY));
+}
+
+_Use_decl_annotations_
+UINT32 TopologyGetDistance(
+	_In_ const TOPOLOGY* pTopology,
+	_In_ UINT32          uiFirst,
+	_In_ UINT32          uiSecond
+) {
+	const TOPOLOGY_CPU* First = &pTopology->Cpus[uiFirst];
+	const TOPOLOGY_CPU* Second = &pTopology->Cpus[uiSecond];
+	if (First->PackageId != Second->PackageId)
+		return 3;
+	if (First->LlcId != Second->LlcId)
+		return 2;
+	if (First->L2Id != Second->L2Id)
+		return 1;
+	return 0;
+}
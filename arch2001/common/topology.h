@@ -0,0 +1,80 @@
+/// @file    topology.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __TOPOLOGY_H_GUARD__
+#define __TOPOLOGY_H_GUARD__
+#include "ost.h"
+#include "cpuid.h"
+
+/// Cache types of CPUID leaf 4
+#define TOPOLOGY_CACHE_NULL        0x00
+#define TOPOLOGY_CACHE_DATA        0x01
+#define TOPOLOGY_CACHE_INSTRUCTION 0x02
+#define TOPOLOGY_CACHE_UNIFIED     0x03
+
+/// Level types of CPUID leaf 0xB
+#define TOPOLOGY_LEVEL_INVALID 0x00
+#define TOPOLOGY_LEVEL_SMT     0x01
+#define TOPOLOGY_LEVEL_CORE    0x02
+
+/// <summary>
+/// Position of a logical processor. Identifiers are only meaningful when compared with each other.
+/// </summary>
+typedef struct _TOPOLOGY_CPU {
+	UINT32 ApicId;    // x2APIC ID, or initial APIC ID without leaf 0xB.
+	UINT32 L2Id;      // Processors sharing the L2 cache have the same identifier.
+	UINT32 LlcId;     // Processors sharing the last level cache have the same identifier.
+	UINT32 PackageId;
+} TOPOLOGY_CPU, * PTOPOLOGY_CPU;
+
+/// <summary>
+/// Cache topology of the logical processors described by a CPUID backend.
+/// </summary>
+typedef struct _TOPOLOGY {
+	UINT32        CpuCount;
+	UINT32        LlcLevel;     // Level of the last level cache.
+	UINT32        LlcCount;     // Number of distinct last level caches.
+	UINT32        PackageCount;
+	PTOPOLOGY_CPU Cpus;
+} TOPOLOGY, * PTOPOLOGY;
+
+/// <summary>
+/// Build the cache topology from the APIC IDs and the number of logical processors sharing each cache
+/// (leaf 4 on Intel, leaf 0x8000001D on AMD).
+/// </summary>
+/// <param name="pBackend">Pointer to an opened CPUID backend.</param>
+/// <param name="pTopology">Pointer to the topology to build. Released with TopologyFree.</param>
+/// <returns>Whether the topology has been built.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL TopologyBuild(
+	_In_  PCPUID_BACKEND pBackend,
+	_Out_ PTOPOLOGY      pTopology
+);
+
+/// <summary>
+/// Release a topology built by TopologyBuild.
+/// </summary>
+/// <param name="pTopology">Pointer to the topology.</param>
+VOID TopologyFree(
+	_Inout_ PTOPOLOGY pTopology
+);
+
+/// <summary>
+/// Get the distance between two logical processors: 0 when they share the L2 cache, 1 when they share
+/// the last level cache, 2 within the same package and 3 across packages.
+/// </summary>
+/// <param name="pTopology">Pointer to the topology.</param>
+/// <param name="uiFirst">Index of the first processor.</param>
+/// <param name="uiSecond">Index of the second processor.</param>
+/// <returns>Distance between both processors.</returns>
+UINT32 TopologyGetDistance(
+	_In_ const TOPOLOGY* pTopology,
+	_In_ UINT32          uiFirst,
+	_In_ UINT32          uiSecond
+);
+
+#endif // !__TOPOLOGY_H_GUARD__
@@ -0,0 +1,351 @@
+/// @file    tscsync.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if !defined(_WIN32)
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include "tscsync.h"
+#include "atomic.h"
+#include "cpuid.h"
+#include "intrinsics.h"
+#include "percpu.h"
+#include "thread.h"
+
+/// Duration of the calibration of the TSC frequency in milliseconds
+#define TSC_SYNC_CALIBRATION_MS 50
+
+/// Spins on a cache line before giving the processor away, in case the other thread is not running
+#define TSC_SYNC_SPINS_BEFORE_YIELD 0x10000
+
+/// <summary>
+/// Cache line bounced between the two processors of a pair. Odd sequences are requests, even sequences replies.
+/// </summary>
+typedef struct DECLSPEC_ALIGN(CACHE_LINE_SIZE) _TSC_SYNC_LINE {
+	volatile INT64 Sequence;
+	volatile INT64 Tsc;      // Timestamp of the responder for the current reply.
+} TSC_SYNC_LINE, * PTSC_SYNC_LINE;
+
+typedef struct _TSC_SYNC_WORKER TSC_SYNC_WORKER, * PTSC_SYNC_WORKER;
+
+/// <summary>
+/// State shared by the threads of a measurement.
+/// </summary>
+typedef struct _TSC_SYNC_SHARED {
+	PTSC_SYNC        Sync;
+	PTSC_SYNC_LINE   Lines;        // One per processor, used by the pairs whose lowest processor is that one.
+	PTSC_SYNC_WORKER Workers;
+	DECLSPEC_ALIGN(CACHE_LINE_SIZE) volatile INT32 Arrived;
+	DECLSPEC_ALIGN(CACHE_LINE_SIZE) volatile INT32 Generation;
+	volatile INT32   bFailed;
+} TSC_SYNC_SHARED, * PTSC_SYNC_SHARED;
+
+/// <summary>
+/// Thread pinned on a processor.
+/// </summary>
+struct _TSC_SYNC_WORKER {
+	THREAD           Thread;
+	PTSC_SYNC_SHARED Shared;
+	UINT32           Cpu;
+};
+
+/// <summary>
+/// Wait for a 64-bit value to reach a given value.
+/// </summary>
+static VOID TscSyncWaitFor(
+	_In_ volatile INT64* Address,
+	_In_ INT64           Value
+) {
+	UINT32 uiSpins = 0x00;
+	while (AtomicLoad64(Address) != Value) {
+		AtomicPause();
+		if (++uiSpins % TSC_SYNC_SPINS_BEFORE_YIELD == 0x00)
+			ThreadYield();
+	}
+}
+
+/// <summary>
+/// Wait for every worker to reach the same point. Arrivals may be made on behalf of workers that do not exist.
+/// </summary>
+static VOID TscSyncBarrier(
+	_Inout_ PTSC_SYNC_SHARED pShared,
+	_In_    UINT32           uiArrivals
+) {
+	INT32 Generation = AtomicLoad32(&pShared->Generation);
+	if (AtomicAdd32(&pShared->Arrived, (INT32)uiArrivals) == (INT32)pShared->Sync->CpuCount) {
+		AtomicStore32(&pShared->Arrived, 0x00);
+		AtomicStore32(&pShared->Generation, Generation + 1);
+		return;
+	}
+	UINT32 uiSpins = 0x00;
+	while (AtomicLoad32(&pShared->Generation) == Generation) {
+		AtomicPause();
+		if (++uiSpins % TSC_SYNC_SPINS_BEFORE_YIELD == 0x00)
+			ThreadYield();
+	}
+}
+
+/// <summary>
+/// Get the partner of a processor in a round of the circle method: processor m-1 stays put while the others
+/// rotate, so that every pair meets exactly once over m-1 rounds, with m the processor count rounded up to even.
+/// A partner beyond the processor count means that the processor sits the round out.
+/// </summary>
+static UINT32 TscSyncGetPartner(
+	_In_ UINT32 uiCpu,
+	_In_ UINT32 uiRound,
+	_In_ UINT32 uiCount
+) {
+	if (uiCpu == uiCount - 1)
+		return uiRound;
+	if (uiCpu == uiRound)
+		return uiCount - 1;
+	return (2 * uiRound + (uiCount - 1) - uiCpu) % (uiCount - 1);
+}
+
+/// <summary>
+/// Send requests and record the bounds of the offset of the partner relative to the caller.
+/// </summary>
+static VOID TscSyncInitiate(
+	_Inout_ PTSC_SYNC      pSync,
+	_Inout_ PTSC_SYNC_LINE pLine,
+	_In_    UINT32         uiCpu,
+	_In_    UINT32         uiPartner
+) {
+	INT64 Lower = INT64_MIN;
+	INT64 Upper = INT64_MAX;
+
+	// The partner read its TSC between t1 and t3 of ours, so t2 - t3 <= offset <= t2 - t1. Slow round
+	// trips only loosen their own bounds, so the minimum and maximum need no filtering of outliers.
+	for (UINT32 Sample = 0x00; Sample < pSync->Samples; Sample++) {
+		INT64 Request = (INT64)Sample * 2 + 1;
+		INT64 T1 = (INT64)_read_tsc_fenced();
+		AtomicStore64(&pLine->Sequence, Request);
+		TscSyncWaitFor(&pLine->Sequence, Request + 1);
+		INT64 T3 = (INT64)_read_tsc_fenced();
+		INT64 T2 = AtomicLoad64(&pLine->Tsc);
+
+		if (T2 - T3 > Lower)
+			Lower = T2 - T3;
+		if (T2 - T1 < Upper)
+			Upper = T2 - T1;
+	}
+
+	// Workers measure disjoint pairs, so both entries are only written here
+	UINT32 Count = pSync->CpuCount;
+	pSync->Pairs[(SIZE_T)uiCpu * Count + uiPartner].Lower = Lower;
+	pSync->Pairs[(SIZE_T)uiCpu * Count + uiPartner].Upper = Upper;
+	pSync->Pairs[(SIZE_T)uiPartner * Count + uiCpu].Lower = -Upper;
+	pSync->Pairs[(SIZE_T)uiPartner * Count + uiCpu].Upper = -Lower;
+}
+
+/// <summary>
+/// Timestamp the requests of the initiator.
+/// </summary>
+static VOID TscSyncRespond(
+	_In_    const TSC_SYNC* pSync,
+	_Inout_ PTSC_SYNC_LINE  pLine
+) {
+	for (UINT32 Sample = 0x00; Sample < pSync->Samples; Sample++) {
+		INT64 Request = (INT64)Sample * 2 + 1;
+		TscSyncWaitFor(&pLine->Sequence, Request);
+		AtomicStore64(&pLine->Tsc, (INT64)_read_tsc_fenced());
+		AtomicStore64(&pLine->Sequence, Request + 1);
+	}
+}
+
+/// <summary>
+/// Routine of the thread pinned on a processor.
+/// </summary>
+static VOID TscSyncWorker(
+	_In_ PVOID Parameter
+) {
+	PTSC_SYNC_WORKER pWorker = (PTSC_SYNC_WORKER)Parameter;
+	PTSC_SYNC_SHARED pShared = pWorker->Shared;
+	PTSC_SYNC pSync = pShared->Sync;
+	UINT32 Count = pSync->CpuCount;
+
+	// 1. Every thread must be on its own processor, otherwise the pairs would be measured on the wrong ones
+	THREAD_AFFINITY Previous = { 0x00 };
+	if (!ThreadPin(pWorker->Cpu, &Previous))
+		AtomicStore32(&pShared->bFailed, TRUE);
+	TscSyncBarrier(pShared, 0x01);
+	if (AtomicLoad32(&pShared->bFailed))
+		return;
+
+	// 2. One pair per round, each using the line of its lowest processor
+	UINT32 Rounds = (Count + 1) & ~0x01U;
+	for (UINT32 Round = 0x00; Round < Rounds - 1; Round++) {
+		PTSC_SYNC_LINE pOwn = &pShared->Lines[pWorker->Cpu];
+		AtomicStore64(&pOwn->Sequence, 0x00);
+		AtomicStore64(&pOwn->Tsc, 0x00);
+		TscSyncBarrier(pShared, 0x01);
+
+		UINT32 Partner = TscSyncGetPartner(pWorker->Cpu, Round, Rounds);
+		if (Partner >= Count)
+			continue;
+		if (pWorker->Cpu < Partner)
+			TscSyncInitiate(pSync, pOwn, pWorker->Cpu, Partner);
+		else
+			TscSyncRespond(pSync, &pShared->Lines[Partner]);
+	}
+	ThreadRestore(&Previous);
+}
+
+/// <summary>
+/// Measure the frequency of the TSC against the monotonic clock of the OS.
+/// </summary>
+static UINT64 TscSyncCalibrate() {
+	UINT64 StartTime = ThreadGetTime();
+	UINT64 StartTsc = _read_tsc_fenced();
+	ThreadSleep(TSC_SYNC_CALIBRATION_MS);
+	UINT64 EndTsc = _read_tsc_fenced();
+	UINT64 EndTime = ThreadGetTime();
+	if (EndTime == StartTime)
+		return 0x00;
+	return (UINT64)((double)(EndTsc - StartTsc) * 1e9 / (double)(EndTime - StartTime));
+}
+
+/// <summary>
+/// Read IA32_TSC_ADJUST on every processor.
+/// </summary>
+static VOID TscSyncReadAdjust(
+	_Inout_  PTSC_SYNC    pSync,
+	_In_opt_ PMSR_BACKEND pMsr
+) {
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	if (pMsr == NULL || !Cpuid->ExtendedEbx.elem.IA32_TSC_ADJUST)
+		return;
+
+	pSync->bAdjust = TRUE;
+	pSync->bAdjustEqual = TRUE;
+	for (UINT32 Cpu = 0x00; Cpu < pSync->CpuCount; Cpu++) {
+		UINT64 Value = 0x00;
+		if (!MsrRead(pMsr, Cpu, IA32_TSC_ADJUST_MSR, &Value)) {
+			pSync->bAdjust = FALSE;
+			pSync->bAdjustEqual = FALSE;
+			return;
+		}
+		pSync->Adjust[Cpu] = (INT64)Value;
+		if (pSync->Adjust[Cpu] != pSync->Adjust[0])
+			pSync->bAdjustEqual = FALSE;
+	}
+}
+
+/// <summary>
+/// Find the worst pairs and give the verdict.
+/// </summary>
+static VOID TscSyncSummarise(
+	_Inout_ PTSC_SYNC pSync
+) {
+	for (UINT32 Row = 0x00; Row < pSync->CpuCount; Row++) {
+		for (UINT32 Column = Row + 1; Column < pSync->CpuCount; Column++) {
+			const TSC_PAIR* pPair = TscSyncGetPair(pSync, Row, Column);
+			if (pPair->Lower > pPair->Upper) {
+				pSync->Inconsistent++;
+				continue;
+			}
+			INT64 Skew = TscSyncGetSkew(pPair);
+			if (Skew > pSync->MaxSkew) {
+				pSync->MaxSkew = Skew;
+				pSync->WorstRow = Row;
+				pSync->WorstColumn = Column;
+			}
+			INT64 Uncertainty = (pPair->Upper - pPair->Lower) / 2;
+			if (Uncertainty > pSync->MaxUncertainty)
+				pSync->MaxUncertainty = Uncertainty;
+		}
+	}
+
+	// Safe if the TSC keeps ticking at the same rate everywhere, nobody moved it and no offset can be seen
+	pSync->bSafe = pSync->bInvariant
+		&& (!pSync->bAdjust || pSync->bAdjustEqual)
+		&& pSync->Inconsistent == 0x00
+		&& pSync->MaxSkew <= pSync->Tolerance;
+}
+
+_Use_decl_annotations_
+BOOL TscSyncMeasure(
+	_Out_    PTSC_SYNC    pSync,
+	_In_opt_ PMSR_BACKEND pMsr,
+	_In_     UINT32       uiSamples,
+	_In_     UINT32       uiToleranceNs
+) {
+	RtlZeroMemory(pSync, sizeof(TSC_SYNC));
+	pSync->CpuCount = ThreadGetCpuCount();
+	pSync->Samples = uiSamples != 0x00 ? uiSamples : TSC_SYNC_DEFAULT_SAMPLES;
+
+	// 1. Invariant TSC and frequency
+	UINT Registers[4] = { 0x00 };
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	if (Cpuid->MaximumExtendedLeaf >= CPUID_LEAF_ADVANCED_POWER && CpuidQuery(CPUID_LEAF_ADVANCED_POWER, 0x00, Registers))
+		pSync->bInvariant = (Registers[3] >> 8) & 0x01;
+	pSync->Frequency = TscSyncCalibrate();
+	pSync->Tolerance = (INT64)((double)uiToleranceNs * (double)pSync->Frequency / 1e9);
+
+	// 2. IA32_TSC_ADJUST of every processor
+	pSync->Adjust = (PINT64)calloc(pSync->CpuCount, sizeof(INT64));
+	pSync->Pairs = (PTSC_PAIR)calloc((SIZE_T)pSync->CpuCount * pSync->CpuCount, sizeof(TSC_PAIR));
+	if (pSync->Adjust == NULL || pSync->Pairs == NULL) {
+		TscSyncFree(pSync);
+		return FALSE;
+	}
+	TscSyncReadAdjust(pSync, pMsr);
+	if (pSync->CpuCount < 2) {
+		TscSyncSummarise(pSync);
+		return TRUE;
+	}
+
+	// 3. One thread per processor
+	TSC_SYNC_SHARED Shared = { 0x00 };
+	Shared.Sync = pSync;
+	Shared.Lines = (PTSC_SYNC_LINE)PerCpuAlloc(pSync->CpuCount * sizeof(TSC_SYNC_LINE));
+	Shared.Workers = (PTSC_SYNC_WORKER)calloc(pSync->CpuCount, sizeof(TSC_SYNC_WORKER));
+	if (Shared.Lines == NULL || Shared.Workers == NULL) {
+		PerCpuFree(Shared.Lines);
+		free(Shared.Workers);
+		TscSyncFree(pSync);
+		return FALSE;
+	}
+	RtlZeroMemory(Shared.Lines, pSync->CpuCount * sizeof(TSC_SYNC_LINE));
+
+	// A thread that cannot be created still has to reach the barriers, so the others are told to stop
+	UINT32 Created = 0x00;
+	for (; Created < pSync->CpuCount; Created++) {
+		Shared.Workers[Created].Shared = &Shared;
+		Shared.Workers[Created].Cpu = Created;
+		if (!ThreadCreate(&Shared.Workers[Created].Thread, TscSyncWorker, &Shared.Workers[Created]))
+			break;
+	}
+	if (Created != pSync->CpuCount) {
+		AtomicStore32(&Shared.bFailed, TRUE);
+		TscSyncBarrier(&Shared, pSync->CpuCount - Created);
+	}
+	for (UINT32 Index = 0x00; Index < Created; Index++)
+		ThreadJoin(&Shared.Workers[Index].Thread);
+
+	BOOL bSuccess = !Shared.bFailed;
+	PerCpuFree(Shared.Lines);
+	free(Shared.Workers);
+	if (!bSuccess) {
+		TscSyncFree(pSync);
+		return FALSE;
+	}
+
+	// 4. Verdict
+	TscSyncSummarise(pSync);
+	return TRUE;
+}
+
+_Use_decl_annotations_
+VOID TscSyncFree(
+	_Inout_ PTSC_SYNC pSync
+) {
+	free(pSync->Adjust);
+	free(pSync->Pairs);
+	pSync->Adjust = NULL;
+	pSync->Pairs = NULL;
+}
@@ -0,0 +1,104 @@
+/// @file    tscsync.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __TSCSYNC_H_GUARD__
+#define __TSCSYNC_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// Default number of round trips measured per pair of processors
+#define TSC_SYNC_DEFAULT_SAMPLES 2000
+
+/// <summary>
+/// Bounds of the offset of the TSC of a processor relative to another one, in TSC ticks. Every round trip
+/// between the two processors narrows the bounds: the reply is timestamped after the request was sent and
+/// before the answer was received, so the true offset is always within them.
+/// </summary>
+typedef struct _TSC_PAIR {
+	INT64 Lower;
+	INT64 Upper;
+} TSC_PAIR, * PTSC_PAIR;
+
+/// <summary>
+/// TSC_ADJUST of every processor and offsets of every pair of processors.
+/// </summary>
+typedef struct _TSC_SYNC {
+	UINT32    CpuCount;
+	UINT32    Samples;            // Round trips per pair.
+	BOOL      bInvariant;         // Constant rate in every P-state and C-state, CPUID.80000007H:EDX[8].
+	UINT64    Frequency;          // TSC ticks per second, calibrated against the OS clock.
+	BOOL      bAdjust;            // IA32_TSC_ADJUST could be read on every processor.
+	BOOL      bAdjustEqual;       // Every IA32_TSC_ADJUST holds the same value.
+	PINT64    Adjust;             // IA32_TSC_ADJUST of every processor.
+	PTSC_PAIR Pairs;              // CpuCount * CpuCount pairs, see TscSyncGetPair.
+	INT64     Tolerance;          // Largest offset accepted by the verdict, in TSC ticks.
+	INT64     MaxSkew;            // Largest offset proven by the bounds, i.e. distance between zero and the bounds.
+	INT64     MaxUncertainty;     // Largest half width of the bounds.
+	UINT32    WorstRow;           // Pair with the largest offset proven.
+	UINT32    WorstColumn;
+	UINT32    Inconsistent;       // Pairs whose lower bound is above their upper bound, i.e. the TSC is not monotonic between them.
+	BOOL      bSafe;              // The TSC can be compared across processors.
+} TSC_SYNC, * PTSC_SYNC;
+
+/// <summary>
+/// Get the bounds of the offset of the TSC of a processor relative to another one, i.e. the value
+/// subtracted from a timestamp of the column processor to get the timestamp of the row processor.
+/// </summary>
+/// <param name="pSync">Pointer to the result of TscSyncMeasure.</param>
+/// <param name="uiRow">Index of the reference processor.</param>
+/// <param name="uiColumn">Index of the other processor.</param>
+/// <returns>Pointer to the bounds.</returns>
+FORCEINLINE const TSC_PAIR* TscSyncGetPair(
+	_In_ const TSC_SYNC* pSync,
+	_In_ UINT32          uiRow,
+	_In_ UINT32          uiColumn
+) {
+	return &pSync->Pairs[(SIZE_T)uiRow * pSync->CpuCount + uiColumn];
+}
+
+/// <summary>
+/// Get the smallest offset compatible with the bounds of a pair, zero when the TSCs may be synchronised.
+/// </summary>
+/// <param name="pPair">Pointer to the bounds.</param>
+/// <returns>Offset proven by the bounds in TSC ticks.</returns>
+FORCEINLINE INT64 TscSyncGetSkew(
+	_In_ const TSC_PAIR* pPair
+) {
+	if (pPair->Lower > 0x00)
+		return pPair->Lower;
+	if (pPair->Upper < 0x00)
+		return -pPair->Upper;
+	return 0x00;
+}
+
+/// <summary>
+/// Read IA32_TSC_ADJUST on every processor and measure the offsets of every pair of processors with
+/// threads pinned on each processor bouncing a cache line. Disjoint pairs are measured at the same time,
+/// so that the whole machine is covered in CpuCount rounds.
+/// </summary>
+/// <param name="pSync">Pointer to the structure receiving the results, released with TscSyncFree.</param>
+/// <param name="pMsr">Optional pointer to an opened MSR backend to read IA32_TSC_ADJUST.</param>
+/// <param name="uiSamples">Round trips per pair, 0 for TSC_SYNC_DEFAULT_SAMPLES.</param>
+/// <param name="uiToleranceNs">Largest offset in nanoseconds for the TSC to be deemed safe.</param>
+/// <returns>Whether the offsets have been measured.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL TscSyncMeasure(
+	_Out_    PTSC_SYNC    pSync,
+	_In_opt_ PMSR_BACKEND pMsr,
+	_In_     UINT32       uiSamples,
+	_In_     UINT32       uiToleranceNs
+);
+
+/// <summary>
+/// Release the results of TscSyncMeasure.
+/// </summary>
+/// <param name="pSync">Pointer to the results.</param>
+VOID TscSyncFree(
+	_Inout_ PTSC_SYNC pSync
+);
+
+#endif // !__TSCSYNC_H_GUARD__
@@ -0,0 +1,294 @@
+/// @file    wait.c
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#if defined(_WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#pragma comment(lib, "Synchronization.lib")
+#else
+#define _GNU_SOURCE
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include "wait.h"
+#include "atomic.h"
+#include "cpuid.h"
+#include "intrinsics.h"
+
+/// Longest run of PAUSE between two loads of the PAUSE method
+#define WAIT_PAUSE_BACKOFF_MAX 64
+
+WAIT_CAPABILITIES g_WaitCapabilities = { 0x00 };
+WAIT_METHOD       g_WaitMethod = WaitMethodNone;
+
+#if !defined(_WIN32)
+/// <summary>
+/// Read a number from a file of sysfs.
+/// </summary>
+static BOOL WaitReadNumber(
+	_In_  LPCSTR  szPath,
+	_Out_ PUINT64 pValue
+) {
+	unsigned long long Value = 0x00;
+	FILE* pFile = fopen(szPath, "r");
+	*pValue = 0x00;
+	if (pFile == NULL)
+		return FALSE;
+	BOOL bRead = fscanf(pFile, "%llu", &Value) == 0x01;
+	fclose(pFile);
+	*pValue = (UINT64)Value;
+	return bRead;
+}
+#endif
+
+/// <summary>
+/// Get the limits of UMWAIT and TPAUSE set by the OS.
+/// </summary>
+static VOID WaitQueryControl(
+	_In_opt_ PMSR_BACKEND       pMsr,
+	_Inout_  PWAIT_CAPABILITIES pCapabilities
+) {
+	UINT64 Control = 0x00;
+	if (pMsr != NULL && MsrRead(pMsr, MSR_CURRENT_CPU, IA32_UMWAIT_CONTROL, &Control)) {
+		pCapabilities->bControl = TRUE;
+		pCapabilities->bC02 = (Control & WAIT_CONTROL_C02_DISABLE) == 0x00;
+		pCapabilities->MaxTicks = (UINT32)(Control & WAIT_CONTROL_TIME_MASK);
+		return;
+	}
+#if !defined(_WIN32)
+	UINT64 C02 = 0x00;
+	UINT64 MaxTime = 0x00;
+	if (WaitReadNumber("/sys/devices/system/cpu/umwait_control/enable_c02", &C02)
+		&& WaitReadNumber("/sys/devices/system/cpu/umwait_control/max_time", &MaxTime)) {
+		pCapabilities->bControl = TRUE;
+		pCapabilities->bC02 = C02 != 0x00;
+		pCapabilities->MaxTicks = (UINT32)(MaxTime & WAIT_CONTROL_TIME_MASK);
+	}
+#endif
+}
+
+_Use_decl_annotations_
+WAIT_METHOD WaitInitialise(
+	_In_opt_ PMSR_BACKEND pMsr
+) {
+	// 1. Get the wait instructions of the processor
+	const CPUID_INFORMATION* Cpuid = CpuidGetInformation();
+	WAIT_CAPABILITIES Capabilities = { 0x00 };
+	Capabilities.bWaitpkg = Cpuid->ExtendedEcx.elem.WAITPKG;
+	Capabilities.bMonitorx = Cpuid->ExtendedInfoEcx.elem.MONITORX;
+	Capabilities.bMonitor = Cpuid->BasicEcx.elem.MONITOR;
+
+	UINT Registers[4] = { 0x00 };
+	if ((Capabilities.bMonitor || Capabilities.bMonitorx) && Cpuid->MaximumLeaf >= CPUID_LEAF_MONITOR_MWAIT
+		&& CpuidQuery(CPUID_LEAF_MONITOR_MWAIT, 0x00, Registers)) {
+		Capabilities.LineMin = (UINT16)(Registers[0] & 0xFFFF);
+		Capabilities.LineMax = (UINT16)(Registers[1] & 0xFFFF);
+	}
+
+	// 2. Get the limits of the OS
+	if (Capabilities.bWaitpkg)
+		WaitQueryControl(pMsr, &Capabilities);
+	g_WaitCapabilities = Capabilities;
+
+	// 3. UMWAIT unless the OS cuts it too short to be worth it, then MWAITX, then PAUSE
+	if (Capabilities.bWaitpkg && (!Capabilities.bControl || Capabilities.MaxTicks == 0x00 || Capabilities.MaxTicks >= WAIT_UMWAIT_MIN_TICKS))
+		g_WaitMethod = WaitMethodUmwait;
+	else if (Capabilities.bMonitorx)
+		g_WaitMethod = WaitMethodMwaitx;
+	else
+		g_WaitMethod = WaitMethodPause;
+	return g_WaitMethod;
+}
+
+_Use_decl_annotations_
+BOOL WaitSetMethod(
+	_In_ WAIT_METHOD Method
+) {
+	if (g_WaitMethod == WaitMethodNone)
+		(VOID)WaitInitialise(NULL);
+	if ((Method == WaitMethodUmwait && !g_WaitCapabilities.bWaitpkg)
+		|| (Method == WaitMethodMwaitx && !g_WaitCapabilities.bMonitorx)
+		|| Method == WaitMethodNone || Method > WaitMethodPark)
+		return FALSE;
+	g_WaitMethod = Method;
+	return TRUE;
+}
+
+/// <summary>
+/// Spin until a value changes or a TSC deadline passes.
+/// </summary>
+static BOOL WaitSpinUntil(
+	_In_        volatile INT32*  Address,
+	_In_        INT32            Current,
+	_In_        UINT64           Deadline,
+	_Inout_opt_ PWAIT_STATISTICS pStatistics
+) {
+	UINT64 Start = _read_tsc();
+	UINT64 Now = Start;
+	UINT64 Sleep = 0x00;
+	UINT32 uiBackoff = 0x01;
+	BOOL bChanged = FALSE;
+
+	while (!(bChanged = AtomicLoad32(Address) != Current) && Now < Deadline) {
+		switch (g_WaitMethod) {
+		case WaitMethodUmwait: {
+			// The line is armed before the value is checked again, so that a write in between wakes up UMWAIT
+			_wait_umonitor(Address);
+			if (AtomicLoad32(Address) != Current)
+				continue;
+			BOOL bC02 = g_WaitCapabilities.bC02 && Now - Start >= WAIT_SPIN_TICKS;
+			(VOID)_wait_umwait(bC02 ? WAIT_STATE_C02 : WAIT_STATE_C01, Deadline);
+			UINT64 After = _read_tsc();
+			Sleep += After - Now;
+			Now = After;
+			break;
+		}
+		case WaitMethodMwaitx: {
+			_wait_monitorx(Address);
+			if (AtomicLoad32(Address) != Current)
+				continue;
+			UINT64 Remaining = Deadline - Now;
+			_wait_mwaitx(Remaining > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)Remaining);
+			UINT64 After = _read_tsc();
+			Sleep += After - Now;
+			Now = After;
+			break;
+		}
+		case WaitMethodPause:
+			for (UINT32 Index = 0x00; Index < uiBackoff; Index++)
+				AtomicPause();
+			if (uiBackoff < WAIT_PAUSE_BACKOFF_MAX)
+				uiBackoff <<= 1;
+			Now = _read_tsc();
+			break;
+		default:
+			Now = Deadline;
+			break;
+		}
+	}
+
+	if (pStatistics != NULL) {
+		pStatistics->SleepTicks += Sleep;
+		pStatistics->SpinTicks += (Now > Start ? Now - Start : 0x00) - Sleep;
+	}
+	return bChanged;
+}
+
+/// <summary>
+/// Park the calling thread while a value is unchanged. May return spuriously.
+/// </summary>
+static VOID WaitPark(
+	_In_ volatile INT32* Address,
+	_In_ INT32           Current
+) {
+#if defined(_WIN32)
+	(VOID)WaitOnAddress(Address, &Current, sizeof(INT32), INFINITE);
+#else
+	(VOID)syscall(SYS_futex, Address, FUTEX_WAIT_PRIVATE, Current, NULL, NULL, 0x00);
+#endif
+}
+
+_Use_decl_annotations_
+BOOL WaitSpinForChange(
+	_In_        volatile INT32*  Address,
+	_In_        INT32            Current,
+	_In_        UINT64           Ticks,
+	_Inout_opt_ PWAIT_STATISTICS pStatistics
+) {
+	if (g_WaitMethod == WaitMethodNone)
+		(VOID)WaitInitialise(NULL);
+	if (pStatistics != NULL)
+		pStatistics->Waits++;
+	return WaitSpinUntil(Address, Current, _read_tsc() + Ticks, pStatistics);
+}
+
+_Use_decl_annotations_
+VOID WaitForChange(
+	_In_        volatile INT32*  Address,
+	_In_        INT32            Current,
+	_In_        UINT64           Ticks,
+	_Inout_opt_ PWAIT_STATISTICS pStatistics
+) {
+	if (WaitSpinForChange(Address, Current, Ticks, pStatistics))
+		return;
+
+	if (pStatistics != NULL)
+		pStatistics->Parks++;
+	while (AtomicLoad32(Address) == Current)
+		WaitPark(Address, Current);
+}
+
+_Use_decl_annotations_
+VOID WaitWake(
+	_In_ volatile INT32* Address,
+	_In_ BOOL            bAll
+) {
+#if defined(_WIN32)
+	if (bAll)
+		WakeByAddressAll((PVOID)Address);
+	else
+		WakeByAddressSingle((PVOID)Address);
+#else
+	(VOID)syscall(SYS_futex, Address, FUTEX_WAKE_PRIVATE, bAll ? 0x7FFFFFFF : 0x01, NULL, NULL, 0x00);
+#endif
+}
+
+_Use_decl_annotations_
+VOID WaitDelay(
+	_In_ UINT64 Ticks
+) {
+	if (g_WaitMethod == WaitMethodNone)
+		(VOID)WaitInitialise(NULL);
+	UINT64 Deadline = _read_tsc() + Ticks;
+
+	// TPAUSE returns early when the OS time limit is reached
+	if (g_WaitCapabilities.bWaitpkg) {
+		while (_read_tsc() < Deadline)
+			(VOID)_wait_tpause(WAIT_STATE_C01, Deadline);
+		return;
+	}
+	while (_read_tsc() < Deadline)
+		AtomicPause();
+}
+
+_Use_decl_annotations_
+VOID WaitLockAcquire(
+	_Inout_ PWAIT_LOCK pLock
+) {
+	// 1. Uncontended
+	if (AtomicCompareExchange32(&pLock->State, 0x00, 0x01))
+		return;
+	if (g_WaitMethod == WaitMethodNone)
+		(VOID)WaitInitialise(NULL);
+
+	// 2. Spin on the cache line of the lock until the holder releases it
+	UINT64 Deadline = _read_tsc() + WAIT_SPIN_TICKS;
+	do {
+		INT32 State = AtomicLoad32(&pLock->State);
+		if (State == 0x00) {
+			if (AtomicCompareExchange32(&pLock->State, 0x00, 0x01))
+				return;
+			continue;
+		}
+		if (State == 0x02)
+			break;
+		(VOID)WaitSpinUntil(&pLock->State, State, Deadline, NULL);
+	} while (_read_tsc() < Deadline);
+
+	// 3. Park, marking the lock as contended so that the holder wakes a waiter on release
+	while (AtomicExchange32(&pLock->State, 0x02) != 0x00)
+		WaitPark(&pLock->State, 0x02);
+}
+
+_Use_decl_annotations_
+VOID WaitLockRelease(
+	_Inout_ PWAIT_LOCK pLock
+) {
+	if (AtomicExchange32(&pLock->State, 0x00) == 0x02)
+		WaitWake(&pLock->State, FALSE);
+}
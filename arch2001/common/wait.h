@@ -0,0 +1,159 @@
+/// @file    wait.h
+/// @author  Paul L. (@am0nsec)
+/// @version 1.0
+/// @link    https://github.com/am0nsec/ost
+/// @brief   Windows and Linux code for the OpenSecurityTraining2 Architecture 2001 class
+///          https://x.ost.fyi/courses/course-v1:OpenSecurityTraining+Arch2001_x86-64_OS_Internals+2021_V1/about
+///
+#ifndef __WAIT_H_GUARD__
+#define __WAIT_H_GUARD__
+#include "ost.h"
+#include "msr.h"
+
+/// <summary>
+/// How a thread waits for a value to change before asking the OS to park it.
+/// </summary>
+typedef enum _WAIT_METHOD {
+	WaitMethodNone   = 0x00, // Not initialised yet.
+	WaitMethodUmwait = 0x01, // UMONITOR and UMWAIT, the processor stays in C0.1 or C0.2 until the line is written.
+	WaitMethodMwaitx = 0x02, // MONITORX and MWAITX, the AMD equivalent.
+	WaitMethodPause  = 0x03, // Loads separated by an exponential number of PAUSE.
+	WaitMethodPark   = 0x04  // No spinning, the thread is parked by the OS straight away.
+} WAIT_METHOD;
+
+/// Value of ECX for UMWAIT and TPAUSE
+#define WAIT_STATE_C02 0x00 // Deeper, slower to wake up.
+#define WAIT_STATE_C01 0x01
+
+/// Fields of IA32_UMWAIT_CONTROL
+#define WAIT_CONTROL_C02_DISABLE 0x00000001
+#define WAIT_CONTROL_TIME_MASK   0xFFFFFFFC
+
+/// Below this OS limit, UMWAIT returns before it saves anything over PAUSE
+#define WAIT_UMWAIT_MIN_TICKS 1000
+
+/// Spin budget of the locks and default budget of the callers, in TSC ticks: a few microseconds
+#define WAIT_SPIN_TICKS 20000
+
+/// <summary>
+/// Wait instructions of the processor and limits set by the OS.
+/// </summary>
+typedef struct _WAIT_CAPABILITIES {
+	BOOL   bWaitpkg;     // UMONITOR, UMWAIT and TPAUSE, CPUID.(07H,0):ECX[5]
+	BOOL   bMonitorx;    // MONITORX and MWAITX, CPUID.80000001H:ECX[29]
+	BOOL   bMonitor;     // MONITOR and MWAIT, CPUID.01H:ECX[3]. Ring 0 only unless the OS allows it, which neither Windows nor Linux does.
+	UINT16 LineMin;      // Smallest monitor-line size in bytes, CPUID.05H:EAX[15:0]
+	UINT16 LineMax;      // Largest monitor-line size in bytes, CPUID.05H:EBX[15:0]
+	BOOL   bControl;     // IA32_UMWAIT_CONTROL could be read, directly or from the OS.
+	BOOL   bC02;         // C0.2 allowed by IA32_UMWAIT_CONTROL.
+	UINT32 MaxTicks;     // Longest UMWAIT or TPAUSE allowed by the OS in TSC ticks, 0 when unlimited.
+} WAIT_CAPABILITIES, * PWAIT_CAPABILITIES;
+
+/// <summary>
+/// Where the time of the waits went, for the callers measuring them.
+/// </summary>
+typedef struct _WAIT_STATISTICS {
+	UINT64 Waits;
+	UINT64 Parks;      // Waits that ended in the OS.
+	UINT64 SleepTicks; // Spent in UMWAIT, MWAITX or TPAUSE.
+	UINT64 SpinTicks;  // Spent executing loads and PAUSE.
+} WAIT_STATISTICS, * PWAIT_STATISTICS;
+
+/// <summary>
+/// Lock spinning on its cache line before parking: 0 free, 1 held, 2 held with parked waiters.
+/// </summary>
+typedef struct DECLSPEC_ALIGN(64) _WAIT_LOCK {
+	volatile INT32 State;
+} WAIT_LOCK, * PWAIT_LOCK;
+
+/// <summary>
+/// Capabilities and method selected by WaitInitialise.
+/// </summary>
+EXTERN_C WAIT_CAPABILITIES g_WaitCapabilities;
+EXTERN_C WAIT_METHOD       g_WaitMethod;
+
+/// <summary>
+/// Select the wait method from the CPUID information and the limits of IA32_UMWAIT_CONTROL. The MSR is
+/// read via the backend if given, otherwise from /sys/devices/system/cpu/umwait_control on Linux.
+/// </summary>
+/// <param name="pMsr">Optional pointer to an opened MSR backend.</param>
+/// <returns>The method selected.</returns>
+WAIT_METHOD WaitInitialise(
+	_In_opt_ PMSR_BACKEND pMsr
+);
+
+/// <summary>
+/// Force a method, e.g. to compare them.
+/// </summary>
+/// <param name="Method">Method to use from now on.</param>
+/// <returns>Whether the processor supports the method.</returns>
+_Success_(return != 0x00) _Must_inspect_result_
+BOOL WaitSetMethod(
+	_In_ WAIT_METHOD Method
+);
+
+/// <summary>
+/// Wait for a value to change without involving the OS.
+/// </summary>
+/// <param name="Address">Address of the value, whose cache line is monitored.</param>
+/// <param name="Current">Value to wait to change.</param>
+/// <param name="Ticks">Maximum duration in TSC ticks.</param>
+/// <param name="pStatistics">Optional pointer to statistics to update.</param>
+/// <returns>Whether the value has changed.</returns>
+BOOL WaitSpinForChange(
+	_In_        volatile INT32*  Address,
+	_In_        INT32            Current,
+	_In_        UINT64           Ticks,
+	_Inout_opt_ PWAIT_STATISTICS pStatistics
+);
+
+/// <summary>
+/// Wait for a value to change, spinning first then parking in the OS. The thread changing the value must
+/// call WaitWake for the parked waiters.
+/// </summary>
+/// <param name="Address">Address of the value.</param>
+/// <param name="Current">Value to wait to change.</param>
+/// <param name="Ticks">Spin budget in TSC ticks before parking.</param>
+/// <param name="pStatistics">Optional pointer to statistics to update.</param>
+VOID WaitForChange(
+	_In_        volatile INT32*  Address,
+	_In_        INT32            Current,
+	_In_        UINT64           Ticks,
+	_Inout_opt_ PWAIT_STATISTICS pStatistics
+);
+
+/// <summary>
+/// Wake up the threads parked on a value by WaitForChange.
+/// </summary>
+/// <param name="Address">Address of the value.</param>
+/// <param name="bAll">Wake every waiter rather than one.</param>
+VOID WaitWake(
+	_In_ volatile INT32* Address,
+	_In_ BOOL            bAll
+);
+
+/// <summary>
+/// Delay the calling thread without yielding the processor, with TPAUSE when available.
+/// </summary>
+/// <param name="Ticks">Duration in TSC ticks.</param>
+VOID WaitDelay(
+	_In_ UINT64 Ticks
+);
+
+/// <summary>
+/// Acquire a lock, spinning for WAIT_SPIN_TICKS before parking.
+/// </summary>
+/// <param name="pLock">Pointer to the lock, zero initialised.</param>
+VOID WaitLockAcquire(
+	_Inout_ PWAIT_LOCK pLock
+);
+
+/// <summary>
+/// Release a lock, waking one parked waiter if any.
+/// </summary>
+/// <param name="pLock">Pointer to the lock.</param>
+VOID WaitLockRelease(
+	_Inout_ PWAIT_LOCK pLock
+);
+
+#endif // !__WAIT_H_GUARD__